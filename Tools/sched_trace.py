@@ -0,0 +1,367 @@
+#!/usr/bin/env python
+############################################################################
+#
+#   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in
+#    the documentation and/or other materials provided with the
+#    distribution.
+# 3. Neither the name PX4 nor the names of its contributors may be
+#    used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+# OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+# AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+
+#
+# Timeline and statistics from a scheduler trace
+#
+# "sched_trace start" records context switches, task start/stop, interrupt
+# handlers and HRT callouts in a RAM ring on the vehicle; "sched_trace dump"
+# writes it to /fs/microsd/sched.trc. This tool reads that file and prints
+# per task, interrupt and callout statistics, lists priority inheritance
+# (a task running boosted because a higher priority task waits on it) and
+# late activations, and can write an event listing or a Chrome trace
+# (chrome://tracing) for a graphical timeline.
+#
+# The file layout is defined in apps/systemlib/sched_trace.h.
+#
+
+import sys
+import argparse
+import struct
+
+HEADER = struct.Struct('<IHHIIIIQII')
+TASK = struct.Struct('<hBB24s')
+EVENT = struct.Struct('<IBBhI')
+
+MAGIC = 0x43525453
+VERSION = 1
+
+# longest list of priority inheritance or late activations printed
+REPORT_LINES = 50
+
+START, STOP, SWITCH, IRQ_ENTER, IRQ_EXIT, CALLOUT_ENTER, CALLOUT_EXIT = range(1, 8)
+
+class trace(object):
+	'''A decoded trace file'''
+
+	def __init__(self, data):
+		(magic, version, event_size, self.hz, count, self.dropped, task_count,
+		 self.sync_time, self.sync_cycles, _) = HEADER.unpack_from(data, 0)
+
+		if magic != MAGIC:
+			raise ValueError("not a scheduler trace")
+		if version != VERSION or event_size != EVENT.size:
+			raise ValueError("unsupported trace version %u" % version)
+
+		offset = HEADER.size
+		self.names = {}
+		self.base_priority = {}
+		for i in range(task_count):
+			pid, priority, _, name = TASK.unpack_from(data, offset)
+			offset += TASK.size
+			self.names[pid] = name.split(b'\0')[0].decode('ascii', 'replace')
+			self.base_priority[pid] = priority
+
+		# unwrap the 32 bit cycle counter; there are always events more
+		# often than once per counter period (25s at 168MHz)
+		self.events = []
+		cycles = None
+		last = 0
+		for i in range(count):
+			c, kind, priority, ident, arg = EVENT.unpack_from(data, offset)
+			offset += EVENT.size
+			if cycles is None:
+				cycles = c
+			else:
+				cycles += (c - last) & 0xffffffff
+			last = c
+			self.events.append((cycles, kind, priority, ident, arg))
+
+		self.start = self.events[0][0] if self.events else 0
+
+	def us(self, cycles):
+		'''Time since the first event, in microseconds'''
+		return (cycles - self.start) * 1000000.0 / self.hz
+
+	def name(self, pid):
+		return "%s(%d)" % (self.names.get(pid, "?"), pid)
+
+class symbols(object):
+	'''Callout addresses to names, from "arm-none-eabi-nm firmware.elf" output'''
+
+	def __init__(self, path):
+		self.table = {}
+		if path is None:
+			return
+		for line in open(path):
+			fields = line.split()
+			if len(fields) == 3 and fields[1] in 'tT':
+				# clear the thumb bit, callouts are called through it
+				self.table[int(fields[0], 16) & ~1] = fields[2]
+
+	def name(self, address):
+		return self.table.get(address & ~1, "0x%08x" % address)
+
+class stats(object):
+	'''Count, total and extremes of a series of durations'''
+
+	def __init__(self):
+		self.count = 0
+		self.total = 0.0
+		self.total_sq = 0.0
+		self.most = 0.0
+
+	def add(self, value):
+		self.count += 1
+		self.total += value
+		self.total_sq += value * value
+		self.most = max(self.most, value)
+
+	def mean(self):
+		return self.total / self.count if self.count else 0.0
+
+	def stddev(self):
+		if self.count < 2:
+			return 0.0
+		m = self.mean()
+		return max(self.total_sq / self.count - m * m, 0.0) ** 0.5
+
+class analysis(object):
+	'''Replays the events into task, interrupt and callout statistics'''
+
+	def __init__(self, t, syms):
+		self.t = t
+		self.syms = syms
+		self.run = {}		# pid -> run slice stats
+		self.gap = {}		# pid -> time between runs
+		self.irq = {}		# irq -> handler stats
+		self.callout = {}	# address -> run time stats
+		self.period = {}	# address -> interval stats
+		self.intervals = {}	# address -> [(time, interval)]
+		self.boosted = []	# (time, pid, priority, base priority, duration)
+		self.slices = []	# (pid, start, end) for the timeline
+		self.irq_slices = []	# (irq, start, end)
+		self.callout_slices = []	# (address, start, end)
+		self.late = []		# (time, description)
+
+		running = None
+		run_start = None
+		run_priority = None
+		last_end = {}
+		irq_start = {}
+		irq_time = 0.0
+		callout_start = {}
+		last_callout = {}
+
+		for cycles, kind, priority, ident, arg in t.events:
+			now = t.us(cycles)
+
+			if kind == SWITCH:
+				prev = arg & 0xffff
+				if prev & 0x8000:
+					prev -= 0x10000
+				if running is not None and running == prev:
+					self.end_slice(running, run_start, now, run_priority, irq_time)
+				last_end[prev] = now
+				if ident in last_end:
+					self.gap.setdefault(ident, stats()).add(now - last_end[ident])
+				running = ident
+				run_start = now
+				run_priority = priority
+				irq_time = 0.0
+				base = (arg >> 24) & 0xff
+				t.base_priority.setdefault(ident, base)
+
+			elif kind == IRQ_ENTER:
+				irq_start[ident] = now
+
+			elif kind == IRQ_EXIT and ident in irq_start:
+				duration = now - irq_start.pop(ident)
+				self.irq.setdefault(ident, stats()).add(duration)
+				self.irq_slices.append((ident, now - duration, now))
+				irq_time += duration
+
+			elif kind == CALLOUT_ENTER:
+				callout_start[arg] = now
+				if arg in last_callout:
+					interval = now - last_callout[arg]
+					self.period.setdefault(arg, stats()).add(interval)
+					self.intervals.setdefault(arg, []).append((now, interval))
+				last_callout[arg] = now
+
+			elif kind == CALLOUT_EXIT and arg in callout_start:
+				duration = now - callout_start.pop(arg)
+				self.callout.setdefault(arg, stats()).add(duration)
+				self.callout_slices.append((arg, now - duration, now))
+
+			elif kind == STOP:
+				if running == ident:
+					self.end_slice(running, run_start, now, run_priority, irq_time)
+					running = None
+
+		self.duration = t.us(t.events[-1][0]) if t.events else 0.0
+
+		# a periodic callout that started much later than its usual period missed its deadline
+		for address, series in self.intervals.items():
+			typical = sorted(i for _, i in series)[len(series) // 2]
+			for when, interval in series:
+				if interval > 1.5 * typical:
+					self.late.append((when, "callout %s started %.0fus after the previous run, usually %.0fus" %
+							  (syms.name(address), interval, typical)))
+
+	def end_slice(self, pid, start, end, priority, irq_time):
+		self.run.setdefault(pid, stats()).add(end - start - irq_time)
+		self.slices.append((pid, start, end))
+		base = self.t.base_priority.get(pid)
+		if base is not None and priority > base:
+			self.boosted.append((start, pid, priority, base, end - start))
+
+	def deadlines(self, limits):
+		'''Activations of named tasks later than the given limit after the previous run'''
+		for name, limit in limits:
+			pids = [pid for pid, n in self.t.names.items() if n == name]
+			for pid in pids:
+				last = None
+				for p, start, end in self.slices:
+					if p != pid:
+						continue
+					if last is not None and start - last > limit:
+						self.late.append((start, "%s ran %.0fus after its previous run, limit %.0fus" %
+								  (self.t.name(pid), start - last, limit)))
+					last = end
+
+	def report(self):
+		t = self.t
+		print("%u events over %.3fs, %u dropped, %uHz cycle counter" %
+		      (len(t.events), self.duration / 1000000.0, t.dropped, t.hz))
+
+		print("\ntasks:")
+		print("  %-28s %4s %8s %7s %10s %10s %10s" % ("name", "prio", "runs", "cpu%", "run avg", "run max", "gap max"))
+		for pid in sorted(self.run, key=lambda p: -self.run[p].total):
+			r = self.run[pid]
+			gap = self.gap.get(pid, stats())
+			print("  %-28s %4s %8u %7.2f %8.1fus %8.1fus %8.1fus" %
+			      (t.name(pid), t.base_priority.get(pid, "?"), r.count,
+			       100.0 * r.total / self.duration if self.duration else 0.0,
+			       r.mean(), r.most, gap.most))
+
+		if self.irq:
+			print("\ninterrupts:")
+			print("  %4s %8s %7s %10s %10s" % ("irq", "count", "cpu%", "avg", "max"))
+			for irq in sorted(self.irq):
+				s = self.irq[irq]
+				print("  %4d %8u %7.2f %8.1fus %8.1fus" %
+				      (irq, s.count, 100.0 * s.total / self.duration if self.duration else 0.0, s.mean(), s.most))
+
+		if self.callout:
+			print("\nhrt callouts:")
+			print("  %-32s %8s %10s %10s %10s %10s" % ("callout", "count", "run avg", "run max", "period", "jitter"))
+			for address in sorted(self.callout, key=lambda a: -self.callout[a].total):
+				s = self.callout[address]
+				p = self.period.get(address, stats())
+				print("  %-32s %8u %8.1fus %8.1fus %8.1fus %8.1fus" %
+				      (self.syms.name(address), s.count, s.mean(), s.most, p.mean(), p.stddev()))
+
+		if self.boosted:
+			print("\npriority inheritance (task ran above its base priority), %u slices:" % len(self.boosted))
+			for start, pid, priority, base, duration in self.boosted[:REPORT_LINES]:
+				print("  %12.1fus %s at %u (base %u) for %.1fus" % (start, t.name(pid), priority, base, duration))
+
+		if self.late:
+			print("\nlate activations, %u:" % len(self.late))
+			for when, text in sorted(self.late)[:REPORT_LINES]:
+				print("  %12.1fus %s" % (when, text))
+
+	def listing(self, out):
+		t = self.t
+		for cycles, kind, priority, ident, arg in t.events:
+			now = t.us(cycles)
+			if kind == SWITCH:
+				text = "switch %s -> %s at %u" % (t.name(arg & 0xffff), t.name(ident), priority)
+			elif kind == START:
+				text = "start %s at %u" % (t.name(ident), priority)
+			elif kind == STOP:
+				text = "stop %s" % t.name(ident)
+			elif kind == IRQ_ENTER:
+				text = "irq %d enter" % ident
+			elif kind == IRQ_EXIT:
+				text = "irq %d exit" % ident
+			elif kind == CALLOUT_ENTER:
+				text = "callout %s enter" % self.syms.name(arg)
+			elif kind == CALLOUT_EXIT:
+				text = "callout %s exit" % self.syms.name(arg)
+			else:
+				text = "unknown event %u" % kind
+			out.write("%14.3fus  %s\n" % (now, text))
+
+	def chrome(self, out):
+		'''Chrome trace event format, one row per task plus interrupts and callouts'''
+		import json
+		events = []
+		for pid, name in self.t.names.items():
+			events.append({"ph": "M", "name": "thread_name", "pid": 0, "tid": pid, "args": {"name": name}})
+		events.append({"ph": "M", "name": "thread_name", "pid": 0, "tid": -1, "args": {"name": "interrupts"}})
+		events.append({"ph": "M", "name": "thread_name", "pid": 0, "tid": -2, "args": {"name": "hrt callouts"}})
+		for pid, start, end in self.slices:
+			events.append({"ph": "X", "name": self.t.name(pid), "pid": 0, "tid": pid, "ts": start, "dur": end - start})
+		for irq, start, end in self.irq_slices:
+			events.append({"ph": "X", "name": "irq %d" % irq, "pid": 0, "tid": -1, "ts": start, "dur": end - start})
+		for address, start, end in self.callout_slices:
+			events.append({"ph": "X", "name": self.syms.name(address), "pid": 0, "tid": -2, "ts": start, "dur": end - start})
+		json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, out)
+
+def deadline(text):
+	name, _, limit = text.rpartition('=')
+	if not name:
+		raise argparse.ArgumentTypeError("expected <task>=<us>")
+	return (name, float(limit))
+
+def main():
+	parser = argparse.ArgumentParser(description="Show a PX4FMU scheduler trace.")
+	parser.add_argument("trace", help="trace file written by 'sched_trace dump'")
+	parser.add_argument("--symbols", help="output of 'arm-none-eabi-nm' for the firmware, to name callouts")
+	parser.add_argument("--deadline", type=deadline, action="append", default=[], metavar="TASK=US",
+			    help="report runs of TASK later than US after its previous run; may be repeated")
+	parser.add_argument("--list", action="store_true", help="print every event")
+	parser.add_argument("--chrome", metavar="FILE", help="write a Chrome trace (chrome://tracing) to FILE")
+	args = parser.parse_args()
+
+	with open(args.trace, 'rb') as f:
+		t = trace(f.read())
+
+	a = analysis(t, symbols(args.symbols))
+	a.deadlines(args.deadline)
+
+	if args.list:
+		a.listing(sys.stdout)
+
+	a.report()
+
+	if args.chrome:
+		with open(args.chrome, 'w') as out:
+			a.chrome(out)
+		print("\ntimeline written to %s" % args.chrome)
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,291 @@
+#!/usr/bin/env python
+############################################################################
+#
+#   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in
+#    the documentation and/or other materials provided with the
+#    distribution.
+# 3. Neither the name PX4 nor the names of its contributors may be
+#    used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+# OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+# AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+
+#
+# Receiver for the MAVLink log stream
+#
+# With "sdlog start -t" the vehicle streams the sdlog records over USB instead
+# of writing them to the microSD card. This tool reassembles the stream into
+# a sysvector.bin file identical to the one sdlog writes, asking the vehicle
+# to resend packets that went missing.
+#
+# The stream is a byte stream cut into ENCAPSULATED_DATA packets, packet n
+# carrying bytes n * payload onwards. The packet number is sent in the low 15
+# bits of seqnr; packets with bit 15 set are parameter blocks and ignored. DATA_TRANSMISSION_HANDSHAKE messages
+# announce the start (record size, resend window) and the end (total length)
+# of the stream and carry the resend requests; see
+# apps/mavlink/mavlink_logstream.h for the details.
+#
+# Records touched by a packet that could not be recovered are left out and
+# counted. Other MAVLink traffic on the port is ignored.
+#
+
+import sys
+import argparse
+import serial
+import struct
+import time
+
+MAVLINK_STX = 254
+MSG_ID_DATA_TRANSMISSION_HANDSHAKE = 193
+MSG_ID_ENCAPSULATED_DATA = 194
+CRC_EXTRA = {MSG_ID_DATA_TRANSMISSION_HANDSHAKE: 23, MSG_ID_ENCAPSULATED_DATA: 223}
+LOGSTREAM_DATA_TYPE = 16
+
+# seconds until a missing packet is requested again, and how often
+RESEND_TIMEOUT = 0.05
+RESEND_ATTEMPTS = 3
+
+def x25crc(data, crc=0xffff):
+	'''MAVLink checksum'''
+	for b in bytearray(data):
+		tmp = b ^ (crc & 0xff)
+		tmp = (tmp ^ (tmp << 4)) & 0xff
+		crc = (crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4)
+		crc &= 0xffff
+	return crc
+
+class logstream(object):
+	'''Reassembles the log stream and writes complete records out'''
+
+	def __init__(self, port, output):
+		self.port = port
+		self.output = output
+		self.rxbuf = bytearray()
+		self.txseq = 0
+		self.reset(0, 0)
+
+	def reset(self, record_size, window):
+		self.record_size = record_size
+		self.window = window
+		self.payload = 253
+		self.started = record_size > 0
+		self.total = None
+		self.packets = {}		# packet index -> data, not yet written out
+		self.missing = {}		# packet index -> [last request time, attempts]
+		self.lost = set()		# packets given up on
+		self.highest = -1		# highest packet index seen
+		self.next_record = 0
+		self.records = 0
+		self.records_lost = 0
+		self.resent = 0
+
+	def send_handshake(self, first, count):
+		payload = struct.pack('<IHHBBBB', 0, first & 0x7fff, count, LOGSTREAM_DATA_TYPE, 0, 0, 0)
+		header = struct.pack('<BBBBBB', MAVLINK_STX, len(payload), self.txseq & 0xff, 255, 0,
+				     MSG_ID_DATA_TRANSMISSION_HANDSHAKE)
+		crc = x25crc(header[1:] + payload)
+		crc = x25crc(bytearray([CRC_EXTRA[MSG_ID_DATA_TRANSMISSION_HANDSHAKE]]), crc)
+		self.port.write(header + payload + struct.pack('<H', crc))
+		self.txseq += 1
+
+	def feed(self, data):
+		'''Parse incoming bytes, handle complete frames'''
+		self.rxbuf += data
+		buf = self.rxbuf
+		pos = 0
+
+		while True:
+			pos = buf.find(bytearray([MAVLINK_STX]), pos)
+
+			if pos < 0:
+				pos = len(buf)
+				break
+
+			if len(buf) - pos < 6:
+				break
+
+			length = buf[pos + 1]
+			msgid = buf[pos + 5]
+
+			if len(buf) - pos < length + 8:
+				break
+
+			if msgid in CRC_EXTRA:
+				frame = buf[pos:pos + length + 8]
+				crc = x25crc(frame[1:6 + length])
+				crc = x25crc(bytearray([CRC_EXTRA[msgid]]), crc)
+
+				if struct.unpack('<H', bytes(frame[6 + length:]))[0] != crc:
+					# not a frame, resync on the next STX
+					pos += 1
+					continue
+
+				self.handle(msgid, bytes(frame[6:6 + length]))
+
+			pos += length + 8
+
+		del buf[:pos]
+
+	def handle(self, msgid, payload):
+		if msgid == MSG_ID_DATA_TRANSMISSION_HANDSHAKE:
+			(size, width, height, dtype, packets, psize, quality) = struct.unpack('<IHHBBBB', payload)
+
+			if dtype != LOGSTREAM_DATA_TYPE:
+				return
+
+			if size == 0:
+				print("stream started, %u byte records, resend window %u packets" % (width, packets))
+				self.reset(width, packets)
+				self.payload = psize
+
+			else:
+				self.total = size
+				last = (size + self.payload - 1) // self.payload - 1
+
+				for n in range(self.highest + 1, last + 1):
+					self.missing[n] = [0, 0]
+
+				self.highest = max(self.highest, last)
+
+		elif msgid == MSG_ID_ENCAPSULATED_DATA and self.started:
+			(seqnr,) = struct.unpack('<H', payload[0:2])
+
+			if seqnr & 0x8000:
+				return
+
+			# unwrap the 15 bit sequence number around the highest packet seen
+			ref = max(self.highest, 0)
+			n = ref + ((seqnr - ref + 16384) & 0x7fff) - 16384
+
+			if n < self.next_record * self.record_size // self.payload or n in self.lost:
+				return
+
+			if n in self.missing:
+				del self.missing[n]
+				self.resent += 1
+
+			for m in range(self.highest + 1, n):
+				# gap, ask for these when the next request is due
+				self.missing[m] = [0, 0]
+
+			self.highest = max(self.highest, n)
+			self.packets[n] = payload[2:2 + self.payload]
+
+	def request_missing(self, now):
+		'''Ask for missing packets, give up on the ones out of reach'''
+		due = []
+
+		for n in sorted(self.missing):
+			state = self.missing[n]
+
+			if self.highest - n >= self.window or state[1] >= RESEND_ATTEMPTS:
+				# out of the vehicle's window or not coming
+				del self.missing[n]
+				self.lost.add(n)
+
+			elif now - state[0] >= RESEND_TIMEOUT:
+				state[0] = now
+				state[1] += 1
+				due.append(n)
+
+		# one request per run of consecutive packets
+		while due:
+			first = due[0]
+			count = 1
+
+			while count < len(due) and due[count] == first + count:
+				count += 1
+
+			self.send_handshake(first, count)
+			due = due[count:]
+
+	def flush(self):
+		'''Write out records whose packets are all resolved'''
+		if not self.started:
+			return
+
+		while True:
+			start = self.next_record * self.record_size
+			end = start + self.record_size
+
+			if self.total is not None and end > self.total:
+				break
+
+			first = start // self.payload
+			last = (end - 1) // self.payload
+
+			if any(n in self.missing or n > self.highest for n in range(first, last + 1)):
+				break
+
+			if any(n in self.lost for n in range(first, last + 1)):
+				self.records_lost += 1
+
+			else:
+				record = b''.join(self.packets[n] for n in range(first, last + 1))
+				offset = start - first * self.payload
+				self.output.write(record[offset:offset + self.record_size])
+				self.records += 1
+
+			self.next_record += 1
+
+			# drop packets entirely before the next record
+			for n in range(first, (self.next_record * self.record_size) // self.payload):
+				self.packets.pop(n, None)
+				self.lost.discard(n)
+
+	def done(self):
+		return self.total is not None and not self.missing and \
+			self.next_record * self.record_size + self.record_size > self.total
+
+def main():
+	parser = argparse.ArgumentParser(description="Receive the sdlog stream of a tethered PX4FMU.")
+	parser.add_argument('--baud', action="store", type=int, default=921600, help="Baud rate of the serial port (ignored on USB).")
+	parser.add_argument('--output', action="store", default="sysvector.bin", help="File to write the records to.")
+	parser.add_argument('port', action="store", help="Serial port the vehicle is connected to, e.g. /dev/ttyACM0.")
+	args = parser.parse_args()
+
+	port = serial.Serial(args.port, args.baud, timeout=0.01)
+	output = open(args.output, 'wb')
+	stream = logstream(port, output)
+
+	print("waiting for the stream on %s, stop with Ctrl-C" % args.port)
+
+	try:
+		while not stream.done():
+			stream.feed(port.read(4096))
+			stream.request_missing(time.time())
+			stream.flush()
+
+	except KeyboardInterrupt:
+		pass
+
+	output.close()
+	port.close()
+
+	print("%u records written to %s, %u lost, %u packets recovered by resending" %
+	      (stream.records, args.output, stream.records_lost, stream.resent))
+
+if __name__ == '__main__':
+	main()
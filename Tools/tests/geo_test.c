@@ -0,0 +1,210 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file geo_test.c
+ *
+ * Host test for the map projection in systemlib/geo/geo.c.
+ *
+ * Projects random points around random references, some of them next to
+ * the antimeridian, and checks the result against the double precision
+ * get_distance_to_next_waypoint() and get_bearing_to_next_waypoint():
+ * distance and bearing in the plane are the great circle distance and
+ * the initial bearing, the azimuthal equidistant projection preserves
+ * both. Radially and laterally the projected point has to be within
+ * 1 ppm of its distance plus 1 mm (the float resolution close to the
+ * reference), up to 1000 km from the reference, and so does the point
+ * that map_projection_ref_reproject() returns. The batch and the static
+ * reference interface have to give exactly the single point results.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <systemlib/geo/geo.h>
+
+#define REFS		200		/* references per range */
+#define POINTS		100		/* points per reference */
+#define MIN_DISTANCE	1.0		/* m */
+#define MAX_LAT		70.0		/* of the references, deg */
+#define BOUND_REL	1e-6
+#define BOUND_ABS	1e-3		/* m */
+
+static const double ranges[] = { 100.0, 10e3, 100e3, 1000e3 };
+
+static double
+drand(void)
+{
+	return (double)random() / RAND_MAX;
+}
+
+static double
+wrap_180(double deg)
+{
+	while (deg >= 180.0)
+		deg -= 360.0;
+
+	while (deg < -180.0)
+		deg += 360.0;
+
+	return deg;
+}
+
+/**
+ * The point at distance and initial bearing from lat/lon on the sphere of
+ * get_distance_to_next_waypoint().
+ */
+static void
+destination(double lat, double lon, double bearing, double distance, double *lat_dest, double *lon_dest)
+{
+	double c = distance / 6371000.0;
+	double phi = lat * M_DEG_TO_RAD;
+	double sin_phi2 = sin(phi) * cos(c) + cos(phi) * sin(c) * cos(bearing);
+	double phi2 = asin(sin_phi2);
+	double d_lambda = atan2(sin(bearing) * sin(c) * cos(phi), cos(c) - sin(phi) * sin_phi2);
+
+	*lat_dest = phi2 * M_RAD_TO_DEG;
+	*lon_dest = wrap_180(lon + d_lambda * M_RAD_TO_DEG);
+}
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned failed = 0;
+	double t_batch = 0, t_helpers = 0;
+	volatile float sink = 0.0f;
+
+	srandom(11);
+
+	for (unsigned r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+		double max_radial = 0, max_lateral = 0, max_round_trip = 0;	/* relative to the bound */
+
+		for (unsigned k = 0; k < REFS; k++) {
+			struct map_projection_reference_s ref;
+			double lat[POINTS], lon[POINTS];
+			float x[POINTS], y[POINTS];
+			double lat_0 = (2.0 * drand() - 1.0) * MAX_LAT;
+			double lon_0 = (2.0 * drand() - 1.0) * 180.0;
+			double t0;
+
+			/* every fourth reference on the antimeridian, half of its points on the other side */
+			if ((k % 4) == 0)
+				lon_0 = (k % 8) ? 179.999 : -179.999;
+
+			map_projection_ref_init(&ref, lat_0, lon_0);
+			map_projection_init(lat_0, lon_0);
+
+			for (unsigned i = 0; i < POINTS; i++) {
+				double distance = MIN_DISTANCE * pow(ranges[r] / MIN_DISTANCE, drand());
+
+				destination(lat_0, lon_0, (2.0 * drand() - 1.0) * M_PI, distance, &lat[i], &lon[i]);
+			}
+
+			t0 = now_ns();
+			map_projection_ref_project_batch(&ref, lat, lon, x, y, POINTS);
+			t_batch += now_ns() - t0;
+
+			t0 = now_ns();
+
+			for (unsigned i = 0; i < POINTS; i++) {
+				sink += get_distance_to_next_waypoint(lat_0, lon_0, lat[i], lon[i]);
+				sink += get_bearing_to_next_waypoint(lat_0, lon_0, lat[i], lon[i]);
+			}
+
+			t_helpers += now_ns() - t0;
+
+			for (unsigned i = 0; i < POINTS; i++) {
+				float px, py, gx, gy;
+				double lat_back, lon_back;
+
+				map_projection_ref_project(&ref, lat[i], lon[i], &px, &py);
+				map_projection_project(lat[i], lon[i], &gx, &gy);
+
+				if (px != x[i] || py != y[i] || gx != x[i] || gy != y[i]) {
+					fprintf(stderr, "%.7f %.7f: single %f %f, static %f %f, batch %f %f\n",
+						lat[i], lon[i], (double)px, (double)py, (double)gx, (double)gy,
+						(double)x[i], (double)y[i]);
+					failed++;
+				}
+
+				double d_helper = get_distance_to_next_waypoint(lat_0, lon_0, lat[i], lon[i]);
+				double b_helper = get_bearing_to_next_waypoint(lat_0, lon_0, lat[i], lon[i]);
+				double d = sqrt((double)x[i] * x[i] + (double)y[i] * y[i]);
+				double b = atan2(y[i], x[i]);
+				double bound = BOUND_REL * d_helper + BOUND_ABS;
+
+				double radial = fabs(d - d_helper);
+				double lateral = d_helper * fabs(M_DEG_TO_RAD * wrap_180((b - b_helper) * M_RAD_TO_DEG));
+
+				map_projection_ref_reproject(&ref, x[i], y[i], &lat_back, &lon_back);
+				double round_trip = get_distance_to_next_waypoint(lat[i], lon[i], lat_back, lon_back);
+
+				if (radial > bound || lateral > bound || round_trip > bound) {
+					fprintf(stderr, "ref %.7f %.7f, %.7f %.7f at %.3f m: off by %.4f m radially, "
+						"%.4f m laterally, %.4f m after the round trip\n",
+						lat_0, lon_0, lat[i], lon[i], d_helper, radial, lateral, round_trip);
+					failed++;
+				}
+
+				max_radial = fmax(max_radial, radial / bound);
+				max_lateral = fmax(max_lateral, lateral / bound);
+				max_round_trip = fmax(max_round_trip, round_trip / bound);
+			}
+		}
+
+		printf("geo: <= %7.0f m: max error %3.0f%% of the bound radially, %3.0f%% laterally, %3.0f%% round trip\n",
+		       ranges[r], max_radial * 100, max_lateral * 100, max_round_trip * 100);
+	}
+
+	printf("geo: batch projection %.1f ns/point, distance plus bearing %.1f ns/point\n",
+	       t_batch / ((double)REFS * POINTS * (sizeof(ranges) / sizeof(ranges[0]))),
+	       t_helpers / ((double)REFS * POINTS * (sizeof(ranges) / sizeof(ranges[0]))));
+
+	if (failed)
+		fprintf(stderr, "geo: %u failures\n", failed);
+
+	return failed ? 1 : 0;
+}
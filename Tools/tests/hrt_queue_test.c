@@ -0,0 +1,254 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file hrt_queue_test.c
+ *
+ * Host test for the HRT callout queue in drivers/stm32/hrt_queue.c.
+ *
+ *   hrt_queue_test [<steps>]
+ *
+ * Runs a simulated timer: a set of one-shot and periodic calls is
+ * scheduled, cancelled and rescheduled at random while the clock
+ * advances and due calls fire, as drv_hrt.c does from the compare
+ * interrupt. Every call taken from the queue is checked against a
+ * reference model that scans all calls for the earliest deadline, ties
+ * going to the earliest scheduled. The queue sequence number starts
+ * just short of wrapping, and every record is filled with garbage and
+ * cancelled before it is first scheduled.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hrt_queue.h"
+
+#define NUM_CALLS	200
+#define DEFAULT_STEPS	1000000
+
+static struct hrt_queue	queue;
+static struct hrt_call	calls[NUM_CALLS];
+static hrt_abstime	now;
+
+/* reference model */
+static bool		queued[NUM_CALLS];
+static uint64_t		scheduled_seq[NUM_CALLS];
+static uint64_t		next_seq;
+
+static unsigned		fired;
+static unsigned		errors;
+
+static void
+callout(void *arg)
+{
+	fired++;
+}
+
+static int
+reference_earliest(void)
+{
+	int best = -1;
+
+	for (int i = 0; i < NUM_CALLS; i++) {
+		if (!queued[i])
+			continue;
+
+		if (best < 0 ||
+		    calls[i].deadline < calls[best].deadline ||
+		    (calls[i].deadline == calls[best].deadline && scheduled_seq[i] < scheduled_seq[best]))
+			best = i;
+	}
+
+	return best;
+}
+
+static void
+cancel(int i)
+{
+	hrt_queue_remove(&queue, &calls[i]);
+	queued[i] = false;
+}
+
+/**
+ * (Re)schedule a call, as hrt_call_internal does: cancel, then insert.
+ */
+static void
+schedule(int i, hrt_abstime deadline, hrt_abstime period)
+{
+	cancel(i);
+
+	calls[i].deadline = deadline;
+	calls[i].period = period;
+	calls[i].callout = callout;
+	calls[i].arg = &calls[i];
+	hrt_queue_insert(&queue, &calls[i]);
+
+	queued[i] = true;
+	scheduled_seq[i] = next_seq++;
+}
+
+/**
+ * Fire everything due at the current time, as hrt_call_invoke does:
+ * take the earliest call, run it and put periodic calls back.
+ */
+static void
+invoke(void)
+{
+	for (;;) {
+		struct hrt_call *call = hrt_queue_peek(&queue);
+		int expected = reference_earliest();
+
+		if ((call == NULL) != (expected < 0) || (call != NULL && call != &calls[expected])) {
+			fprintf(stderr, "at %llu: queue gives call %d, expected %d\n",
+				(unsigned long long)now, call ? (int)(call - calls) : -1, expected);
+			errors++;
+			return;
+		}
+
+		if (call == NULL || call->deadline > now)
+			return;
+
+		hrt_queue_pop(&queue);
+		queued[expected] = false;
+
+		if (hrt_queue_contains(&queue, call)) {
+			fprintf(stderr, "at %llu: call %d still queued after pop\n", (unsigned long long)now, expected);
+			errors++;
+		}
+
+		call->callout(call->arg);
+
+		if (call->period != 0)
+			schedule(expected, call->deadline + call->period, call->period);
+	}
+}
+
+static void
+check_membership(void)
+{
+	for (int i = 0; i < NUM_CALLS; i++) {
+		if (hrt_queue_contains(&queue, &calls[i]) != queued[i]) {
+			fprintf(stderr, "at %llu: call %d queued %d, expected %d\n",
+				(unsigned long long)now, i, !queued[i], queued[i]);
+			errors++;
+		}
+	}
+}
+
+static int
+test_queue(unsigned steps)
+{
+	unsigned cancels = 0, reschedules = 0;
+
+	hrt_queue_init(&queue);
+	queue.seq = UINT32_MAX - 1000;
+	srandom(48);
+
+	for (int i = 0; i < NUM_CALLS; i++) {
+		/*
+		 * A record that was never zeroed, cancelled before it is first
+		 * scheduled (as ToneAlarm::start_tune does), must leave the
+		 * calls already queued alone.
+		 */
+		memset(&calls[i], 0xa5 ^ i, sizeof(calls[i]));
+		cancel(i);
+		check_membership();
+
+		schedule(i, random() % 10000, (i % 3) ? (random() % 5000 + 100) : 0);
+	}
+
+	for (unsigned step = 0; step < steps && errors == 0; step++) {
+		unsigned r = random() % 100;
+		int i = random() % NUM_CALLS;
+
+		if (r < 70) {
+			/* the compare interrupt: advance to the next deadline */
+			struct hrt_call *next = hrt_queue_peek(&queue);
+
+			if (next != NULL && next->deadline > now)
+				now = next->deadline;
+
+			invoke();
+
+		} else if (r < 85) {
+			/* hrt_cancel, possibly of a call that is not queued */
+			cancel(i);
+			cancels++;
+
+		} else {
+			/* hrt_call_at / hrt_call_every, often onto a busy deadline */
+			hrt_abstime deadline = now + ((r & 1) ? random() % 3000 : 1000);
+
+			schedule(i, deadline, (random() % 2) ? (random() % 2000 + 1) : 0);
+			reschedules++;
+		}
+
+		if (step % 1000 == 0)
+			check_membership();
+	}
+
+	/* drain: one-shot calls only, everything must come out in order */
+	for (int i = 0; i < NUM_CALLS; i++) {
+		if (queued[i])
+			calls[i].period = 0;
+	}
+
+	while (errors == 0 && hrt_queue_peek(&queue) != NULL) {
+		now = hrt_queue_peek(&queue)->deadline;
+		invoke();
+	}
+
+	check_membership();
+
+	printf("hrt queue: %u steps, %u calls fired, %u cancels, %u reschedules, %u errors\n",
+	       steps, fired, cancels, reschedules, errors);
+
+	return errors != 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned steps = DEFAULT_STEPS;
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: hrt_queue_test [<steps>]\n");
+		return 1;
+	}
+
+	if (argc == 2)
+		steps = strtoul(argv[1], NULL, 0);
+
+	return test_queue(steps);
+}
@@ -0,0 +1,93 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file drv_hrt.h
+ *
+ * Host stand-in for the high resolution timer interface, providing just
+ * what the host tests need to build code that includes it.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef __EXPORT
+# define __EXPORT
+#endif
+#ifndef __BEGIN_DECLS
+# define __BEGIN_DECLS
+# define __END_DECLS
+#endif
+
+typedef uint64_t	hrt_abstime;
+
+typedef void	(* hrt_callout)(void *arg);
+
+/*
+ * Callout record, as in apps/drivers/drv_hrt.h without the work queue
+ * entry. Keep the queue links in step with it.
+ */
+struct hrt_queue;
+
+typedef struct hrt_call {
+	struct hrt_queue	*queue_owner;
+	struct hrt_call		*queue_child;
+	struct hrt_call		*queue_next;
+	struct hrt_call		*queue_prev;
+	uint32_t		queue_seq;
+
+	hrt_abstime		deadline;
+	hrt_abstime		period;
+	hrt_callout		callout;
+	void			*arg;
+	unsigned		flags;
+
+	uint32_t		runs;
+	uint32_t		overruns;
+	uint32_t		run_time_max;
+	uint32_t		latency_max;
+	uint64_t		run_time_total;
+	uint64_t		latency_total;
+} *hrt_call_t;
+
+__BEGIN_DECLS
+
+/*
+ * Provided by the test that needs it.
+ */
+__EXPORT extern hrt_abstime	hrt_absolute_time(void);
+
+__END_DECLS
@@ -0,0 +1,81 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file stm32_dma.h
+ *
+ * Host stand-in for the STM32 DMA interface. Channels are emulated by
+ * the test that needs them; addresses are host pointers, so they are
+ * passed as uintptr_t rather than uint32_t.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+typedef void			*DMA_HANDLE;
+typedef void			(*dma_callback_t)(DMA_HANDLE handle, uint8_t status, void *arg);
+
+#define DMACHAN_USART2_RX	5
+#define DMACHAN_USART2_TX	6
+
+#define DMA_CCR_DIR		(1 << 4)
+#define DMA_CCR_CIRC		(1 << 5)
+#define DMA_CCR_MINC		(1 << 7)
+#define DMA_CCR_PSIZE_8BITS	(0 << 8)
+#define DMA_CCR_PSIZE_16BITS	(1 << 8)
+#define DMA_CCR_PSIZE_32BITS	(2 << 8)
+#define DMA_CCR_MSIZE_8BITS	(0 << 10)
+#define DMA_CCR_MSIZE_16BITS	(1 << 10)
+#define DMA_CCR_MSIZE_32BITS	(2 << 10)
+#define DMA_CCR_PRILO		(0 << 12)
+#define DMA_CCR_PRIMED		(1 << 12)
+#define DMA_CCR_PRIHI		(2 << 12)
+
+#define DMA_STATUS_TCIF		(1 << 1)
+#define DMA_STATUS_HTIF		(1 << 2)
+
+__BEGIN_DECLS
+
+extern DMA_HANDLE	stm32_dmachannel(unsigned chan);
+extern void		stm32_dmasetup(DMA_HANDLE handle, uintptr_t paddr, uintptr_t maddr,
+				       size_t ntransfers, uint32_t ccr);
+extern void		stm32_dmastart(DMA_HANDLE handle, dma_callback_t callback, void *arg, bool half);
+extern void		stm32_dmastop(DMA_HANDLE handle);
+extern size_t		stm32_dmaresidual(DMA_HANDLE handle);
+
+__END_DECLS
@@ -0,0 +1,93 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file stm32_internal.h
+ *
+ * Host stand-in for the STM32 chip definitions used by the IO firmware.
+ * Clock and reset registers are only ever written with modifyreg32(),
+ * and GPIOs go through the calls below, both provided by the test that
+ * needs them.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+#include "stm32_dma.h"
+#include "stm32_uart.h"
+
+#define STM32_RCC_APB1RSTR	0x40021010
+#define STM32_RCC_APB1ENR	0x4002101c
+#define RCC_APB1RSTR_USART2RST	(1 << 17)
+#define RCC_APB1ENR_USART2EN	(1 << 17)
+
+#define STM32_IRQ_USART2	54
+
+#define GPIO_INPUT		(0 << 16)
+#define GPIO_OUTPUT		(1 << 16)
+#define GPIO_CNF_ANALOGIN	(0 << 14)
+#define GPIO_CNF_INFLOAT	(1 << 14)
+#define GPIO_CNF_INPULLUP	(2 << 14)
+#define GPIO_CNF_OUTPP		(0 << 14)
+#define GPIO_CNF_AFPP		(2 << 14)
+#define GPIO_MODE_INPUT		(0 << 12)
+#define GPIO_MODE_50MHz		(3 << 12)
+#define GPIO_OUTPUT_CLEAR	(0 << 7)
+#define GPIO_PORTA		(0 << 4)
+#define GPIO_PORTB		(1 << 4)
+#define GPIO_PORTC		(2 << 4)
+#define GPIO_PIN2		2
+#define GPIO_PIN3		3
+#define GPIO_PIN4		4
+#define GPIO_PIN5		5
+#define GPIO_PIN10		10
+#define GPIO_PIN11		11
+#define GPIO_PIN12		12
+#define GPIO_PIN13		13
+#define GPIO_PIN14		14
+#define GPIO_PIN15		15
+
+#define GPIO_USART2_TX		(GPIO_OUTPUT|GPIO_CNF_AFPP|GPIO_MODE_50MHz|GPIO_PORTA|GPIO_PIN2)
+#define GPIO_USART2_RX		(GPIO_INPUT|GPIO_CNF_INFLOAT|GPIO_MODE_INPUT|GPIO_PORTA|GPIO_PIN3)
+
+__BEGIN_DECLS
+
+extern int		stm32_configgpio(uint32_t cfgset);
+extern void		stm32_gpiowrite(uint32_t pinset, bool value);
+extern bool		stm32_gpioread(uint32_t pinset);
+
+__END_DECLS
@@ -0,0 +1,71 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file stm32_uart.h
+ *
+ * Host stand-in for the STM32 USART definitions. The USART2 registers
+ * are plain memory provided by the test that needs them.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+extern volatile uint32_t	stm32_usart2[];
+__END_DECLS
+
+#define STM32_USART2_BASE	((uintptr_t)&stm32_usart2[0])
+
+#define STM32_USART_SR_OFFSET	0x0000
+#define STM32_USART_DR_OFFSET	0x0004
+#define STM32_USART_BRR_OFFSET	0x0008
+#define STM32_USART_CR1_OFFSET	0x000c
+#define STM32_USART_CR2_OFFSET	0x0010
+#define STM32_USART_CR3_OFFSET	0x0014
+
+#define USART_SR_FE		(1 << 1)
+#define USART_SR_NE		(1 << 2)
+#define USART_SR_ORE		(1 << 3)
+#define USART_SR_IDLE		(1 << 4)
+
+#define USART_CR1_RE		(1 << 2)
+#define USART_CR1_TE		(1 << 3)
+#define USART_CR1_IDLEIE	(1 << 4)
+#define USART_CR1_UE		(1 << 13)
+
+#define USART_CR3_DMAR		(1 << 6)
+#define USART_CR3_DMAT		(1 << 7)
@@ -1,7 +1,6 @@
 /****************************************************************************
  *
  *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
- *   Author: @author Lorenz Meier <lm@inf.ethz.ch>
  *
  * Redistribution and use in source and binary forms, with or without
  * modification, are permitted provided that the following conditions
@@ -32,23 +31,24 @@
  *
  ****************************************************************************/
 
+
 /**
- * @file util.h
- * Utility and helper functions and data.
+ * @file systemlib.h
+ *
+ * Host stand-in for the system library, providing just what the host
+ * tests need to build code that includes it.
  */
 
 #pragma once
 
-#include "orb_topics.h"
-
-/** MAVLink communications channel */
-extern uint8_t chan;
+#ifndef OK
+# define OK	0		/* normally from the NuttX <sys/types.h> */
+#endif
+#ifndef ERROR
+# define ERROR	-1
+#endif
 
-/** Shutdown marker */
-extern volatile bool thread_should_exit;
-
-/**
- * Translate the custom state into standard mavlink modes and state.
+/*
+ * Provided by the test that needs it.
  */
-extern void get_mavlink_mode_and_state(const struct vehicle_status_s *v_status, const struct actuator_armed_s *armed,
-	uint8_t *mavlink_state, uint8_t *mavlink_mode);
+extern void	up_systemreset(void);
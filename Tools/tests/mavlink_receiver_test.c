@@ -0,0 +1,581 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file mavlink_receiver_test.c
+ *
+ * Host test and benchmark for the MAVLink frame parser in
+ * mavlink/mavlink_receiver.c.
+ *
+ *   mavlink_receiver_test	check the parser on generated streams
+ *   mavlink_receiver_test -b	time the parser
+ *
+ * Generates the traffic of a HIL simulation with offboard control:
+ * HIGHRES_IMU, HIL_STATE and attitude setpoints at 50 Hz, pressure,
+ * GPS and manual control at lower rates, heartbeats, commands and
+ * parameter and mission requests. The stream goes through a pipe into
+ * the receive thread of link 0 in random pieces. Link 0 forwards, so
+ * every frame the parser accepts arrives unchanged at the stand-in for
+ * link 1, and it must be exactly the frames that were sent intact.
+ *
+ * The same traffic is then sent with checksum errors, and with noise,
+ * false start bytes and truncated frames between the frames, which the
+ * parser has to resynchronise on. Each stream is also parsed with
+ * mavlink_parse_char() for comparison.
+ *
+ * The parse time per byte covers receive_parse() with the dispatch to
+ * the message handlers. The benchmark turns forwarding and HIL off, so
+ * it is mostly the frame parser.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "mavlink_bridge_header.h"
+#include <v1.0/common/mavlink.h>
+#include <systemlib/perf_counter.h>
+#include <uORB/uORB.h>
+
+#include "orb_topics.h"
+#include "waypoints.h"
+#include "mavlink_parameters.h"
+#include "mavlink_logstream.h"
+#include "mavlink_streams.h"
+#include "util.h"
+
+#define STEPS		2000		/* 40 s at 50 Hz */
+#define BENCH_STEPS	20000
+#define STREAM_MAX	(BENCH_STEPS * 8 * MAVLINK_MAX_PACKET_LEN)
+#define PIECE_MAX	600		/* largest random write */
+#define BENCH_PIECE	4096
+#define GCS_SYSID	255
+#define SENTINEL_COMMAND 31337		/* marks the end of a stream */
+
+enum noise {
+	NOISE_NONE,
+	NOISE_CRC,			/**< a byte of some frames corrupted */
+	NOISE_RESYNC			/**< noise, false starts and truncated frames between frames */
+};
+
+struct stream {
+	uint8_t		data[STREAM_MAX];
+	unsigned	length;
+	uint8_t		intact[STREAM_MAX];	/**< the frames that were sent intact, back to back */
+	unsigned	intact_length;
+	unsigned	frames;
+	unsigned	intact_frames;
+};
+
+pthread_t receive_start(mavlink_channel_t channel);
+
+/*
+ * Test doubles for the rest of the mavlink app and the system.
+ */
+mavlink_system_t mavlink_system = { .sysid = 1, .compid = 50 };
+struct mavlink_link mavlink_links[MAVLINK_LINKS_MAX];
+unsigned mavlink_link_count = 2;
+volatile bool thread_should_exit;
+bool mavlink_hil_enabled = true;
+bool gcs_link = true;
+struct vehicle_global_position_s global_pos;
+struct vehicle_local_position_s local_pos;
+
+#define ORB_STANDIN(_name)	const struct orb_metadata __orb_##_name = { #_name, 0 }
+
+ORB_STANDIN(manual_control_setpoint);
+ORB_STANDIN(offboard_control_setpoint);
+ORB_STANDIN(optical_flow);
+ORB_STANDIN(rc_channels);
+ORB_STANDIN(sensor_combined);
+ORB_STANDIN(vehicle_attitude);
+ORB_STANDIN(vehicle_command);
+ORB_STANDIN(vehicle_global_position);
+ORB_STANDIN(vehicle_gps_position);
+ORB_STANDIN(vehicle_vicon_position);
+
+orb_advert_t
+orb_advertise(const struct orb_metadata *meta, const void *data)
+{
+	return 1;
+}
+
+static volatile bool sentinel_seen;
+
+int
+orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const void *data)
+{
+	if (meta == ORB_ID(vehicle_command) && ((const struct vehicle_command_s *)data)->command == SENTINEL_COMMAND)
+		sentinel_seen = true;
+
+	return 0;
+}
+
+int
+orb_subscribe(const struct orb_metadata *meta)
+{
+	return 1;
+}
+
+int
+orb_copy(const struct orb_metadata *meta, int handle, void *buffer)
+{
+	return 0;
+}
+
+hrt_abstime
+hrt_absolute_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void
+mavlink_wpm_message_handler(mavlink_channel_t chan, const mavlink_message_t *msg,
+			    const struct vehicle_global_position_s *global_pos,
+			    struct vehicle_local_position_s *local_pos)
+{
+}
+
+void
+mavlink_pm_message_handler(const mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+}
+
+void
+mavlink_pm_bulk_request(mavlink_channel_t chan, uint32_t cached_hash, uint16_t first, uint16_t count)
+{
+}
+
+void
+mavlink_logstream_resend(mavlink_channel_t chan, uint16_t first, uint16_t count)
+{
+}
+
+bool
+mavlink_stream_permit(mavlink_channel_t channel, enum mavlink_stream_id stream)
+{
+	return true;
+}
+
+static mavlink_status_t channel_status[MAVLINK_COMM_NUM_BUFFERS];
+static mavlink_message_t channel_buffer[MAVLINK_COMM_NUM_BUFFERS];
+
+mavlink_status_t *
+mavlink_get_channel_status(uint8_t channel)
+{
+	return &channel_status[channel];
+}
+
+mavlink_message_t *
+mavlink_get_channel_buffer(uint8_t channel)
+{
+	return &channel_buffer[channel];
+}
+
+/* what link 0 forwarded to link 1 */
+static uint8_t forwarded[STREAM_MAX];
+static unsigned forwarded_length;
+
+void
+mavlink_send_uart_bytes(mavlink_channel_t chan, uint8_t *ch, int length)
+{
+	if (forwarded_length + length <= sizeof(forwarded)) {
+		memcpy(&forwarded[forwarded_length], ch, length);
+		forwarded_length += length;
+	}
+}
+
+struct perf_ctr_header {
+	uint64_t	event_count;
+	double		start;
+	double		elapsed;	/**< ns */
+};
+
+static perf_counter_t parse_perf;
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+perf_counter_t
+perf_alloc(enum perf_counter_type type, const char *name)
+{
+	perf_counter_t handle = calloc(1, sizeof(struct perf_ctr_header));
+
+	if (!strcmp(name, "mavlink rx parse"))
+		parse_perf = handle;
+
+	return handle;
+}
+
+void
+perf_count(perf_counter_t handle)
+{
+	handle->event_count++;
+}
+
+void
+perf_begin(perf_counter_t handle)
+{
+	handle->start = now_ns();
+}
+
+void
+perf_end(perf_counter_t handle)
+{
+	handle->elapsed += now_ns() - handle->start;
+	handle->event_count++;
+}
+
+static unsigned
+rnd(unsigned n)
+{
+	return random() % n;
+}
+
+static float
+frnd(float range)
+{
+	return ((float)random() / RAND_MAX * 2.0f - 1.0f) * range;
+}
+
+static void
+append_noise(struct stream *s)
+{
+	unsigned n = 1 + rnd(20);
+
+	for (unsigned i = 0; i < n; i++)
+		s->data[s->length++] = rnd(4) ? rnd(256) : MAVLINK_STX;
+}
+
+static void
+append(struct stream *s, const mavlink_message_t *msg, enum noise noise)
+{
+	uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+	unsigned len = mavlink_msg_to_send_buffer(frame, msg);
+
+	s->frames++;
+
+	if (noise == NOISE_CRC && rnd(100) < 5) {
+		/* any byte after the start byte, the checksum catches it */
+		unsigned pos = 1 + rnd(len - 1);
+		frame[pos] ^= 1 + rnd(255);
+
+		memcpy(&s->data[s->length], frame, len);
+		s->length += len;
+		return;
+	}
+
+	if (noise == NOISE_RESYNC) {
+		if (rnd(100) < 5)
+			append_noise(s);
+
+		if (rnd(100) < 3) {
+			/* cut short, the next frame starts within its claimed length */
+			unsigned cut = 1 + rnd(len - 1);
+
+			memcpy(&s->data[s->length], frame, cut);
+			s->length += cut;
+			return;
+		}
+	}
+
+	memcpy(&s->data[s->length], frame, len);
+	s->length += len;
+	memcpy(&s->intact[s->intact_length], frame, len);
+	s->intact_length += len;
+	s->intact_frames++;
+}
+
+/**
+ * Generate the traffic of a HIL simulation with offboard control.
+ */
+static void
+generate(struct stream *s, unsigned steps, enum noise noise)
+{
+	mavlink_message_t msg;
+	uint8_t id = MAV_COMP_ID_ALL;
+
+	s->length = 0;
+	s->intact_length = 0;
+	s->frames = 0;
+	s->intact_frames = 0;
+
+	for (unsigned step = 0; step < steps; step++) {
+		uint64_t t = 1000000ULL + step * 20000ULL;
+
+		mavlink_msg_highres_imu_pack(GCS_SYSID, id, &msg, t,
+					     frnd(1.0f), frnd(1.0f), -9.81f + frnd(1.0f),
+					     frnd(0.5f), frnd(0.5f), frnd(0.5f),
+					     0.2f + frnd(0.1f), frnd(0.1f), 0.4f + frnd(0.1f),
+					     1013.0f + frnd(1.0f), frnd(0.5f), 488.0f + frnd(1.0f), 21.0f, 0x1fff);
+		append(s, &msg, noise);
+
+		mavlink_msg_hil_state_pack(GCS_SYSID, id, &msg, t,
+					   frnd(0.5f), frnd(0.5f), frnd(3.14f), frnd(1.0f), frnd(1.0f), frnd(1.0f),
+					   473977420 + rnd(10000), 85455940 + rnd(10000), 488000 + rnd(1000),
+					   rnd(2000), rnd(2000), rnd(200), rnd(100), rnd(100), -1000 + rnd(100));
+		append(s, &msg, noise);
+
+		int16_t roll[6] = { frnd(1000), 0, 0, 0, 0, 0 };
+		int16_t pitch[6] = { frnd(1000), 0, 0, 0, 0, 0 };
+		int16_t yaw[6] = { frnd(1000), 0, 0, 0, 0, 0 };
+		uint16_t thrust[6] = { rnd(10000), 0, 0, 0, 0, 0 };
+		mavlink_msg_set_quad_swarm_roll_pitch_yaw_thrust_pack(GCS_SYSID, id, &msg, 0, 1, roll, pitch, yaw, thrust);
+		append(s, &msg, noise);
+
+		if ((step % 2) == 0) {
+			mavlink_msg_raw_pressure_pack(GCS_SYSID, id, &msg, t, 1013 + rnd(3), rnd(10), 0, 2100);
+			append(s, &msg, noise);
+		}
+
+		if ((step % 5) == 0) {
+			mavlink_msg_manual_control_pack(GCS_SYSID, id, &msg, mavlink_system.sysid,
+							frnd(1000), frnd(1000), rnd(1000), frnd(1000), 0);
+			append(s, &msg, noise);
+		}
+
+		if ((step % 10) == 0) {
+			mavlink_msg_gps_raw_int_pack(GCS_SYSID, id, &msg, t, 3,
+						     473977420 + rnd(10000), 85455940 + rnd(10000), 488000 + rnd(1000),
+						     120, 180, rnd(2000), rnd(36000), 9);
+			append(s, &msg, noise);
+		}
+
+		if ((step % 50) == 0) {
+			mavlink_msg_heartbeat_pack(GCS_SYSID, id, &msg, MAV_TYPE_GCS, MAV_AUTOPILOT_INVALID, 0, 0, 0);
+			append(s, &msg, noise);
+		}
+
+		if ((step % 100) == 0) {
+			mavlink_msg_command_long_pack(GCS_SYSID, id, &msg, mavlink_system.sysid, MAV_COMP_ID_ALL,
+						      MAV_CMD_DO_SET_MODE, 0, 1, 0, 0, 0, 0, 0, 0);
+			append(s, &msg, noise);
+		}
+
+		if ((step % 250) == 0) {
+			char param_id[16] = "";
+			mavlink_msg_param_request_read_pack(GCS_SYSID, id, &msg, mavlink_system.sysid, MAV_COMP_ID_ALL,
+							    param_id, rnd(200));
+			append(s, &msg, noise);
+			mavlink_msg_mission_request_list_pack(GCS_SYSID, id, &msg, mavlink_system.sysid, MAV_COMP_ID_ALL);
+			append(s, &msg, noise);
+		}
+	}
+}
+
+/**
+ * Feed a stream to the receive thread of link 0 and check what it forwards.
+ *
+ * @param piece		bytes per write, 0 for random pieces
+ * @param check		forward and decode HIL messages, and check the forwarded frames
+ * @param ns_per_byte	parse time per byte
+ * @return		number of errors
+ */
+static unsigned
+replay(const struct stream *s, unsigned piece, bool check, double *ns_per_byte)
+{
+	uint8_t tail[MAVLINK_MAX_PACKET_LEN * 2];
+	unsigned tail_length;
+	mavlink_message_t msg;
+	unsigned errors = 0;
+	int fds[2];
+
+	if (pipe(fds) != 0) {
+		perror("pipe");
+		exit(1);
+	}
+
+	/* a truncated frame at the end waits for its claimed length, then the end marker */
+	memset(tail, 0, MAVLINK_MAX_PACKET_LEN);
+	mavlink_msg_command_long_pack(GCS_SYSID, 0, &msg, mavlink_system.sysid, MAV_COMP_ID_ALL,
+				      SENTINEL_COMMAND, 0, 0, 0, 0, 0, 0, 0, 0);
+	tail_length = MAVLINK_MAX_PACKET_LEN + mavlink_msg_to_send_buffer(&tail[MAVLINK_MAX_PACKET_LEN], &msg);
+
+	forwarded_length = 0;
+	sentinel_seen = false;
+	thread_should_exit = false;
+	mavlink_links[0].fd = fds[0];
+	mavlink_links[0].forward = check;
+	mavlink_links[1].forward = check;
+	mavlink_hil_enabled = check;
+
+	double elapsed = parse_perf ? parse_perf->elapsed : 0;
+	pthread_t thread = receive_start(MAVLINK_COMM_0);
+
+	for (unsigned pos = 0; pos < s->length;) {
+		unsigned n = piece ? piece : 1 + rnd(PIECE_MAX);
+
+		if (n > s->length - pos)
+			n = s->length - pos;
+
+		if (write(fds[1], &s->data[pos], n) != (ssize_t)n) {
+			perror("write");
+			exit(1);
+		}
+
+		pos += n;
+	}
+
+	if (write(fds[1], tail, tail_length) != (ssize_t)tail_length) {
+		perror("write");
+		exit(1);
+	}
+
+	for (unsigned waited = 0; !sentinel_seen; waited++) {
+		if (waited == 5000) {
+			fprintf(stderr, "end of stream not received\n");
+			errors++;
+			break;
+		}
+
+		usleep(1000);
+	}
+
+	thread_should_exit = true;
+	close(fds[1]);
+	pthread_join(thread, NULL);
+	close(fds[0]);
+
+	*ns_per_byte = (parse_perf->elapsed - elapsed) / (s->length + tail_length);
+
+	/* the intact frames, then the end marker */
+	unsigned marker_length = tail_length - MAVLINK_MAX_PACKET_LEN;
+
+	if (check && (forwarded_length != s->intact_length + marker_length ||
+		      memcmp(forwarded, s->intact, s->intact_length) ||
+		      memcmp(&forwarded[s->intact_length], &tail[MAVLINK_MAX_PACKET_LEN], marker_length))) {
+		unsigned i;
+
+		for (i = 0; i < forwarded_length && i < s->intact_length; i++) {
+			if (forwarded[i] != s->intact[i])
+				break;
+		}
+
+		fprintf(stderr, "forwarded %u bytes for %u intact and a %u byte end marker, first difference at %u\n",
+			forwarded_length, s->intact_length, marker_length, i);
+		errors++;
+	}
+
+	return errors;
+}
+
+/**
+ * The stock parser on the same stream, for comparison.
+ *
+ * @return		number of frames it recovered
+ */
+static unsigned
+parse_char(const struct stream *s, double *ns_per_byte)
+{
+	mavlink_message_t msg;
+	mavlink_status_t status;
+	unsigned frames = 0;
+
+	memset(&channel_status[MAVLINK_COMM_1], 0, sizeof(channel_status[0]));
+
+	double t0 = now_ns();
+
+	for (unsigned i = 0; i < s->length; i++) {
+		if (mavlink_parse_char(MAVLINK_COMM_1, s->data[i], &msg, &status))
+			frames++;
+	}
+
+	*ns_per_byte = (now_ns() - t0) / s->length;
+
+	return frames;
+}
+
+static unsigned
+run(struct stream *s, unsigned steps, unsigned piece, bool check)
+{
+	static const char *names[] = { "clean", "crc errors", "noise/truncated" };
+	unsigned errors = 0;
+
+	for (enum noise noise = NOISE_NONE; noise <= NOISE_RESYNC; noise++) {
+		double ns_parse, ns_char;
+
+		generate(s, steps, noise);
+		errors += replay(s, piece, check, &ns_parse);
+		unsigned stock = parse_char(s, &ns_char);
+
+		printf("mavlink rx: %-16s %5u/%5u frames intact, parser %5.1f ns/byte, "
+		       "mavlink_parse_char %5.1f ns/byte recovering %u\n",
+		       names[noise], s->intact_frames, s->frames, ns_parse, ns_char, stock);
+	}
+
+	return errors;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: mavlink_receiver_test [-b]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct stream s;
+	unsigned errors;
+
+	srandom(33);
+
+	if (argc == 2 && !strcmp(argv[1], "-b")) {
+		run(&s, BENCH_STEPS, BENCH_PIECE, false);
+		return 0;
+	}
+
+	if (argc != 1)
+		usage();
+
+	errors = run(&s, STEPS, 0, true);
+
+	if (errors)
+		fprintf(stderr, "mavlink rx: %u errors\n", errors);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,388 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file mavlink_tx_test.c
+ *
+ * Host test for the MAVLink transmit ring in mavlink/mavlink_tx.c.
+ *
+ * The writer thread writes to the slave end of a pseudo terminal in raw
+ * mode, as it does to a UART, and a reader thread parses what comes out
+ * of the master end with mavlink_parse_char(). Several sender threads
+ * queue messages of different lengths through the generated send
+ * helpers, and one writes ready-made frames with unbracketed
+ * mavlink_send_uart_bytes() calls, the way forwarded frames are sent.
+ * The ring is a few frames long, so it wraps all the time.
+ *
+ * The commit of a message charges it to the link; that stand-in records
+ * which messages made it into the ring. Exactly those have to arrive,
+ * intact, in order per sender, and with no stray bytes between frames.
+ * In the first phase the reader keeps up. In the second it is slow, the
+ * ring fills and messages have to be dropped whole.
+ *
+ * Each phase ends by stopping the writer and freeing the queue as the
+ * mavlink app does; messages sent after that must go nowhere, and the
+ * next phase starts a new queue on the same channel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <termios.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdbool.h>
+
+#include "mavlink_bridge_header.h"
+#include <v1.0/common/mavlink.h>
+
+#include "mavlink_tx.h"
+
+#define SENDERS		4		/* the last one sends unbracketed frames */
+#define MESSAGES	3000		/* per sender and phase */
+#define CHANNEL		MAVLINK_COMM_0
+#define PARSE_CHANNEL	MAVLINK_COMM_1
+
+/*
+ * Test doubles for the rest of the mavlink app.
+ */
+mavlink_system_t mavlink_system = { .sysid = 1, .compid = 50 };
+volatile bool thread_should_exit;
+
+static mavlink_status_t channel_status[MAVLINK_COMM_NUM_BUFFERS];
+static mavlink_message_t channel_buffer[MAVLINK_COMM_NUM_BUFFERS];
+
+mavlink_status_t *
+mavlink_get_channel_status(uint8_t channel)
+{
+	return &channel_status[channel];
+}
+
+mavlink_message_t *
+mavlink_get_channel_buffer(uint8_t channel)
+{
+	return &channel_buffer[channel];
+}
+
+/* the message the calling sender is queueing, see mavlink_streams_charge() */
+static __thread int current_sender = -1;
+static __thread unsigned current_seq;
+
+static bool committed[SENDERS][MESSAGES];
+static volatile unsigned committed_total;
+static volatile unsigned charges_after_free;
+static volatile bool queue_freed;
+
+void
+mavlink_streams_charge(mavlink_channel_t channel, unsigned bytes)
+{
+	if (queue_freed)
+		charges_after_free++;
+
+	/* called with the queue locked */
+	if (current_sender >= 0) {
+		committed[current_sender][current_seq] = true;
+		committed_total++;
+	}
+}
+
+/* what the reader parsed */
+static unsigned received[SENDERS][MESSAGES];
+static unsigned received_count[SENDERS];
+static volatile unsigned received_total;
+static volatile unsigned bytes_read;
+static unsigned frame_bytes;
+static unsigned foreign_frames;
+static volatile bool reader_slow;
+static int pty_master;
+
+static void
+message_received(const mavlink_message_t *msg)
+{
+	unsigned sender, seq;
+
+	frame_bytes += msg->len + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+
+	switch (msg->msgid) {
+	case MAVLINK_MSG_ID_DEBUG:
+		sender = mavlink_msg_debug_get_ind(msg);
+		seq = mavlink_msg_debug_get_time_boot_ms(msg);
+		break;
+
+	case MAVLINK_MSG_ID_DEBUG_VECT:
+		sender = mavlink_msg_debug_vect_get_x(msg);
+		seq = mavlink_msg_debug_vect_get_time_usec(msg);
+		break;
+
+	case MAVLINK_MSG_ID_STATUSTEXT: {
+			char text[51];
+
+			mavlink_msg_statustext_get_text(msg, text);
+			text[50] = '\0';
+
+			if (sscanf(text, "sender %u message %u", &sender, &seq) != 2)
+				sender = SENDERS;
+
+			break;
+		}
+
+	default:
+		sender = SENDERS;
+		break;
+	}
+
+	if (sender >= SENDERS || received_count[sender] >= MESSAGES) {
+		foreign_frames++;
+		return;
+	}
+
+	received[sender][received_count[sender]++] = seq;
+	received_total++;
+}
+
+static void *
+reader(void *arg)
+{
+	uint8_t buf[4096];
+	mavlink_message_t msg;
+	mavlink_status_t status;
+
+	for (;;) {
+		ssize_t n = read(pty_master, buf, reader_slow ? 16 : sizeof(buf));
+
+		if (n < 0 && errno == EINTR)
+			continue;
+
+		/* EIO once the slave end is closed */
+		if (n <= 0)
+			break;
+
+		for (ssize_t i = 0; i < n; i++) {
+			if (mavlink_parse_char(PARSE_CHANNEL, buf[i], &msg, &status))
+				message_received(&msg);
+		}
+
+		bytes_read += n;
+
+		if (reader_slow)
+			usleep(1000);
+	}
+
+	return NULL;
+}
+
+static void *
+sender(void *arg)
+{
+	unsigned id = (uintptr_t)arg;
+
+	current_sender = id;
+
+	for (unsigned seq = 0; seq < MESSAGES; seq++) {
+		current_seq = seq;
+
+		if (id == SENDERS - 1) {
+			/* a ready-made frame, as forwarded frames are sent */
+			mavlink_message_t msg;
+			uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+
+			mavlink_msg_debug_pack(mavlink_system.sysid, mavlink_system.compid, &msg, seq, id, 0.0f);
+			unsigned len = mavlink_msg_to_send_buffer(frame, &msg);
+			mavlink_send_uart_bytes(CHANNEL, frame, len);
+
+		} else {
+			char text[50];
+			char name[10] = "tx";
+
+			switch ((seq + id) % 3) {
+			case 0:
+				mavlink_msg_debug_send(CHANNEL, seq, id, 1.0f);
+				break;
+
+			case 1:
+				mavlink_msg_debug_vect_send(CHANNEL, name, seq, id, 2.0f, 3.0f);
+				break;
+
+			default:
+				memset(text, 0, sizeof(text));
+				snprintf(text, sizeof(text), "sender %u message %u", id, seq);
+				mavlink_msg_statustext_send(CHANNEL, 0, text);
+				break;
+			}
+		}
+
+		if ((seq % 16) == 0)
+			usleep(reader_slow ? 100 : 500);
+	}
+
+	current_sender = -1;
+	return NULL;
+}
+
+/**
+ * Compare what arrived with what was committed.
+ */
+static unsigned
+check_received(const char *phase)
+{
+	unsigned errors = 0;
+
+	for (unsigned id = 0; id < SENDERS; id++) {
+		unsigned n = 0;
+
+		for (unsigned seq = 0; seq < MESSAGES; seq++) {
+			if (!committed[id][seq])
+				continue;
+
+			if (n >= received_count[id] || received[id][n] != seq) {
+				fprintf(stderr, "%s: sender %u: committed message %u, received %d as number %u\n",
+					phase, id, seq, n < received_count[id] ? (int)received[id][n] : -1, n);
+				errors++;
+				break;
+			}
+
+			n++;
+		}
+
+		if (n != received_count[id]) {
+			fprintf(stderr, "%s: sender %u: %u messages received, %u committed\n",
+				phase, id, received_count[id], n);
+			errors++;
+		}
+	}
+
+	if (foreign_frames > 0 || frame_bytes != bytes_read) {
+		fprintf(stderr, "%s: %u unexpected frames, %u bytes outside of frames\n",
+			phase, foreign_frames, bytes_read - frame_bytes);
+		errors++;
+	}
+
+	return errors;
+}
+
+static unsigned
+phase(const char *name, int slave, unsigned ring_size, bool slow)
+{
+	pthread_t senders[SENDERS];
+	unsigned errors = 0;
+
+	memset(committed, 0, sizeof(committed));
+	memset(received_count, 0, sizeof(received_count));
+	committed_total = 0;
+	received_total = 0;
+	frame_bytes = 0;
+	bytes_read = 0;
+	reader_slow = slow;
+	thread_should_exit = false;
+	queue_freed = false;
+
+	pthread_t writer = mavlink_tx_start(CHANNEL, slave, ring_size);
+
+	for (unsigned id = 0; id < SENDERS; id++)
+		pthread_create(&senders[id], NULL, sender, (void *)(uintptr_t)id);
+
+	for (unsigned id = 0; id < SENDERS; id++)
+		pthread_join(senders[id], NULL);
+
+	/* let the writer and reader drain the ring */
+	for (unsigned waited = 0; received_total < committed_total && waited < 5000; waited++)
+		usleep(1000);
+
+	/* as the mavlink app does on exit */
+	thread_should_exit = true;
+	mavlink_tx_stop(CHANNEL);
+	pthread_join(writer, NULL);
+	mavlink_tx_free(CHANNEL);
+	queue_freed = true;
+
+	/* too late, must neither be queued nor crash */
+	unsigned read_before = bytes_read;
+	mavlink_msg_debug_send(CHANNEL, 0, 0, 0.0f);
+	usleep(20000);
+
+	if (charges_after_free > 0 || bytes_read != read_before) {
+		fprintf(stderr, "%s: message sent after the queue was freed\n", name);
+		errors++;
+	}
+
+	errors += check_received(name);
+
+	unsigned total = SENDERS * MESSAGES;
+	printf("mavlink tx: %-6s %5u/%u messages committed and received, %u dropped whole, %u bytes\n",
+	       name, committed_total, total, total - committed_total, bytes_read);
+
+	if (slow && committed_total == total) {
+		fprintf(stderr, "%s: the ring never filled\n", name);
+		errors++;
+	}
+
+	return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct termios tio;
+	pthread_t reader_thread;
+	unsigned errors = 0;
+	int slave;
+
+	if (openpty(&pty_master, &slave, NULL, NULL, NULL) != 0) {
+		perror("openpty");
+		return 1;
+	}
+
+	/* as the mavlink app configures its UART */
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	pthread_create(&reader_thread, NULL, reader, NULL);
+
+	errors += phase("fast", slave, 4096, false);
+	errors += phase("slow", slave, 512, true);
+
+	close(slave);
+	pthread_join(reader_thread, NULL);
+	close(pty_master);
+
+	if (errors)
+		fprintf(stderr, "mavlink tx: %u errors\n", errors);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,872 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file px4io_serial_test.cpp
+ *
+ * Host test for the PX4IO serial link, with both ends of it.
+ *
+ * The FMU end is the driver's PX4IO_serial transport, on the slave side
+ * of a pseudo terminal. The IO end is the IO firmware's serial.c and
+ * registers.c, on the master side; a thread emulates the USART2 DMA
+ * channels and the idle interrupt that drive serial.c. Requests are
+ * decoded into the real register space, and replies are queued while
+ * earlier ones are still going out.
+ *
+ * Random batches of reads and writes go through transfer(), several
+ * requests per window. On a clean link every read has to match a model
+ * of the registers written before it in the batch, including reads of
+ * the bulk page, which depend on the last bulk write, and reads of a
+ * missing page must fail on their own. In the fault phase the emulator
+ * flips bits in both directions and stalls replies past the timeout, so
+ * frames are lost and stale replies arrive late, and the transport has
+ * to retry. With IO silent, transfers must time out after the retries;
+ * afterwards the link must recover. After each phase the IO registers
+ * are compared with the model directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <drivers/drv_hrt.h>
+#include <drivers/px4io/px4io_serial.h>
+
+extern "C" {
+#include <crc32.h>
+#include <nuttx/arch.h>
+#include <px4io/px4io.h>
+}
+
+#define TRANSFERS	2000		/* per phase */
+#define MAX_REQUESTS	12		/* per transfer */
+#define BAD_PAGE	77
+
+#define RC_CONFIG_SIZE	(MAX_CONTROL_CHANNELS * PX4IO_P_RC_CONFIG_STRIDE)
+
+/*
+ * Emulated IO hardware. Everything on the IO side, interrupts included,
+ * runs on the emulator thread, so interrupts never nest.
+ */
+volatile uint32_t stm32_usart2[8];
+
+struct dma_channel {
+	uint8_t		*mem;
+	size_t		size;
+	size_t		residual;
+	uint32_t	ccr;
+	dma_callback_t	callback;
+	bool		half;
+	bool		running;
+};
+
+static struct dma_channel dma[7];
+static xcpt_t usart2_isr;
+
+/* faults injected by the emulator, set by the test between phases */
+static volatile unsigned flip_rate;		/* one bit flip per this many bytes, 0 for none */
+static volatile unsigned stall_rate;		/* one reply stall per this many loops, 0 for none */
+static volatile bool io_silent;
+static volatile bool io_exit;
+static unsigned io_flips;
+static unsigned io_stalls;
+
+static int io_fd;
+
+extern "C" {
+
+struct sys_state_s system_state;
+
+hrt_abstime
+hrt_absolute_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (hrt_abstime)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* as in NuttX, without pre- or post-inversion */
+uint32_t
+crc32(const uint8_t *src, size_t len)
+{
+	uint32_t crc = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= src[i];
+
+		for (unsigned bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+	}
+
+	return crc;
+}
+
+irqstate_t irqsave(void) { return 0; }
+void irqrestore(irqstate_t flags) {}
+void up_enable_irq(int irq) {}
+void modifyreg32(uintptr_t addr, uint32_t clearbits, uint32_t setbits) {}
+
+int
+irq_attach(int irq, xcpt_t isr)
+{
+	if (irq == STM32_IRQ_USART2)
+		usart2_isr = isr;
+
+	return 0;
+}
+
+int stm32_configgpio(uint32_t cfgset) { return 0; }
+void stm32_gpiowrite(uint32_t pinset, bool value) {}
+bool stm32_gpioread(uint32_t pinset) { return false; }
+
+DMA_HANDLE
+stm32_dmachannel(unsigned chan)
+{
+	return &dma[chan];
+}
+
+void
+stm32_dmasetup(DMA_HANDLE handle, uintptr_t paddr, uintptr_t maddr, size_t ntransfers, uint32_t ccr)
+{
+	struct dma_channel *ch = (struct dma_channel *)handle;
+
+	ch->mem = (uint8_t *)maddr;
+	ch->size = ntransfers;
+	ch->residual = ntransfers;
+	ch->ccr = ccr;
+}
+
+void
+stm32_dmastart(DMA_HANDLE handle, dma_callback_t callback, void *arg, bool half)
+{
+	struct dma_channel *ch = (struct dma_channel *)handle;
+
+	ch->callback = callback;
+	ch->half = half;
+	ch->running = true;
+}
+
+void
+stm32_dmastop(DMA_HANDLE handle)
+{
+	((struct dma_channel *)handle)->running = false;
+}
+
+size_t
+stm32_dmaresidual(DMA_HANDLE handle)
+{
+	return ((struct dma_channel *)handle)->residual;
+}
+
+/* the rest of the IO firmware */
+void mixer_schedule(void) {}
+void mixer_handle_text(const void *buffer, size_t length) {}
+void isr_debug(uint8_t level, const char *fmt, ...) {}
+uint16_t adc_measure(unsigned channel) { return 0; }
+uint32_t up_pwm_servo_get_rate_group(unsigned group) { return 0; }
+int up_pwm_servo_set_rate_group_update(unsigned group, unsigned rate) { return OK; }
+
+}
+
+struct perf_ctr_header {
+	const char	*name;
+	uint64_t	event_count;
+};
+
+static perf_counter_t counters[16];
+
+perf_counter_t
+perf_alloc(enum perf_counter_type type, const char *name)
+{
+	perf_counter_t handle = (perf_counter_t)calloc(1, sizeof(struct perf_ctr_header));
+
+	handle->name = name;
+
+	for (unsigned i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+		if (counters[i] == nullptr) {
+			counters[i] = handle;
+			break;
+		}
+	}
+
+	return handle;
+}
+
+void
+perf_free(perf_counter_t handle)
+{
+	for (unsigned i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+		if (counters[i] == handle)
+			counters[i] = nullptr;
+	}
+
+	free(handle);
+}
+
+/* IO passes no counters to its stream */
+void perf_count(perf_counter_t handle) { if (handle != nullptr) handle->event_count++; }
+void perf_begin(perf_counter_t handle) {}
+void perf_end(perf_counter_t handle) { handle->event_count++; }
+void perf_print_counter(perf_counter_t handle) {}
+
+static uint64_t
+counter(const char *name)
+{
+	for (unsigned i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+		if ((counters[i] != nullptr) && !strcmp(counters[i]->name, name))
+			return counters[i]->event_count;
+	}
+
+	return 0;
+}
+
+static unsigned
+rnd(unsigned n)
+{
+	return random() % n;
+}
+
+/**
+ * A byte arrives on the IO USART; the circular receive channel stores it
+ * and interrupts at the half and full marks.
+ */
+static void
+io_rx_byte(uint8_t c)
+{
+	struct dma_channel *ch = &dma[DMACHAN_USART2_RX];
+
+	if (!ch->running)
+		return;
+
+	ch->mem[ch->size - ch->residual] = c;
+
+	if (--ch->residual == 0) {
+		ch->residual = ch->size;
+		ch->callback(ch, DMA_STATUS_TCIF, nullptr);
+
+	} else if (ch->half && (ch->residual == ch->size / 2)) {
+		ch->callback(ch, DMA_STATUS_HTIF, nullptr);
+	}
+}
+
+/**
+ * The line has gone idle after a burst.
+ */
+static void
+io_rx_idle(void)
+{
+	if (!(stm32_usart2[STM32_USART_CR1_OFFSET / 4] & USART_CR1_IDLEIE))
+		return;
+
+	stm32_usart2[STM32_USART_SR_OFFSET / 4] |= USART_SR_IDLE;
+	usart2_isr(STM32_IRQ_USART2, nullptr);
+	stm32_usart2[STM32_USART_SR_OFFSET / 4] &= ~USART_SR_IDLE;
+}
+
+/**
+ * The transmit channel moves up to max bytes to the line.
+ */
+static void
+io_tx(unsigned max)
+{
+	struct dma_channel *ch = &dma[DMACHAN_USART2_TX];
+
+	if (!ch->running || (ch->residual == 0))
+		return;
+
+	uint8_t buf[64];
+	unsigned n = (ch->residual < max) ? ch->residual : max;
+
+	if (n > sizeof(buf))
+		n = sizeof(buf);
+
+	memcpy(buf, &ch->mem[ch->size - ch->residual], n);
+
+	for (unsigned i = 0; i < n; i++) {
+		if (flip_rate && (rnd(flip_rate) == 0)) {
+			buf[i] ^= 1 << rnd(8);
+			io_flips++;
+		}
+	}
+
+	if (write(io_fd, buf, n) != (ssize_t)n)
+		perror("io write");
+
+	ch->residual -= n;
+
+	if (ch->residual == 0)
+		ch->callback(ch, DMA_STATUS_TCIF, nullptr);
+}
+
+static void *
+io_thread(void *arg)
+{
+	hrt_abstime stalled_until = 0;
+	bool burst = false;
+
+	serial_init();
+
+	while (!io_exit) {
+		struct dma_channel *tx = &dma[DMACHAN_USART2_TX];
+		bool sending = tx->running && (hrt_absolute_time() >= stalled_until);
+		struct pollfd fds;
+
+		fds.fd = io_fd;
+		fds.events = POLLIN;
+
+		if (poll(&fds, 1, sending ? 0 : 1) > 0) {
+			uint8_t buf[64];
+			unsigned want = 1 + rnd(sizeof(buf));
+			ssize_t n = read(io_fd, buf, want);
+
+			for (ssize_t i = 0; i < n; i++) {
+				if (io_silent)
+					continue;
+
+				if (flip_rate && (rnd(flip_rate) == 0)) {
+					buf[i] ^= 1 << rnd(8);
+					io_flips++;
+				}
+
+				io_rx_byte(buf[i]);
+				burst = true;
+			}
+
+			/* nothing more on the line for now */
+			if ((n < (ssize_t)want) && burst) {
+				io_rx_idle();
+				burst = false;
+			}
+
+		} else if (burst) {
+			io_rx_idle();
+			burst = false;
+		}
+
+		/* hold the replies back for longer than FMU waits for them */
+		if (stall_rate && (rnd(stall_rate) == 0)) {
+			stalled_until = hrt_absolute_time() + 15000;
+			io_stalls++;
+		}
+
+		if (sending)
+			io_tx(1 + rnd(64));
+	}
+
+	return nullptr;
+}
+
+/*
+ * Model of the IO registers, as written by FMU.
+ */
+struct model {
+	uint16_t	rc_config[RC_CONFIG_SIZE];
+	uint16_t	failsafe[IO_SERVO_COUNT];
+	uint16_t	controls[PX4IO_CONTROL_CHANNELS];
+
+	/* the GET segment of the last bulk write, gathered when the bulk page is read */
+	uint8_t		bulk_page;
+	unsigned	bulk_offset;
+	unsigned	bulk_count;
+};
+
+static struct model model;
+
+static uint16_t *
+model_page(struct model *m, uint8_t page, unsigned *size)
+{
+	switch (page) {
+	case PX4IO_PAGE_RC_CONFIG:
+		*size = RC_CONFIG_SIZE;
+		return m->rc_config;
+
+	case PX4IO_PAGE_FAILSAFE_PWM:
+		*size = IO_SERVO_COUNT;
+		return m->failsafe;
+
+	case PX4IO_PAGE_CONTROLS:
+		*size = PX4IO_CONTROL_CHANNELS;
+		return m->controls;
+
+	default:
+		*size = 0;
+		return nullptr;
+	}
+}
+
+static const uint8_t model_pages[] = { PX4IO_PAGE_RC_CONFIG, PX4IO_PAGE_FAILSAFE_PWM, PX4IO_PAGE_CONTROLS };
+
+static void
+model_write(uint8_t page, unsigned offset, uint16_t *values, unsigned count)
+{
+	unsigned size;
+	uint16_t *regs = model_page(&model, page, &size);
+
+	for (unsigned i = 0; i < count; i++) {
+		/* options are checked as they are written, keep them off */
+		if ((page == PX4IO_PAGE_RC_CONFIG) &&
+		    (((offset + i) % PX4IO_P_RC_CONFIG_STRIDE) == PX4IO_P_RC_CONFIG_OPTIONS))
+			values[i] = 0;
+
+		regs[offset + i] = values[i];
+	}
+}
+
+/*
+ * A random batch of requests, with the model before the batch and after
+ * each of its requests.
+ */
+struct batch {
+	PX4IO_serial::Request	rq[MAX_REQUESTS];
+	uint16_t		values[MAX_REQUESTS][PX4IO_SERIAL_MAX_REGS];
+	int			expect_result[MAX_REQUESTS];
+	struct model		state[MAX_REQUESTS + 1];
+	unsigned		count;
+};
+
+static void
+random_range(uint8_t page, unsigned max, unsigned *offset, unsigned *count)
+{
+	unsigned size;
+
+	model_page(&model, page, &size);
+
+	*offset = rnd(size);
+	*count = 1 + rnd(size - *offset);
+
+	if (*count > max)
+		*count = max;
+}
+
+/**
+ * Fill a batch with writes and reads of the modelled pages, at most one
+ * bulk write followed by reads of the bulk page, and the odd read of a
+ * page that does not exist.
+ */
+static void
+make_batch(struct batch *b)
+{
+	bool bulk_written = false;
+
+	b->count = 1 + rnd(MAX_REQUESTS);
+	b->state[0] = model;
+
+	for (unsigned i = 0; i < b->count; i++) {
+		PX4IO_serial::Request &rq = b->rq[i];
+		unsigned offset, count;
+		uint8_t page = model_pages[rnd(sizeof(model_pages))];
+
+		rq.values = b->values[i];
+		b->expect_result[i] = OK;
+
+		switch (rnd(8)) {
+		case 0:
+		case 1:
+		case 2:
+			random_range(page, PX4IO_SERIAL_MAX_REGS, &offset, &count);
+
+			for (unsigned j = 0; j < count; j++)
+				b->values[i][j] = random();
+
+			model_write(page, offset, b->values[i], count);
+			rq.write = true;
+			break;
+
+		case 3:
+		case 4:
+			random_range(page, PX4IO_SERIAL_MAX_REGS, &offset, &count);
+			rq.write = false;
+			break;
+
+		case 5: {
+				if (bulk_written) {
+					i--;
+					continue;
+				}
+
+				/* SET a run of one page, GET a run of another */
+				uint8_t get_page = model_pages[rnd(sizeof(model_pages))];
+				uint16_t *p = b->values[i];
+				struct px4io_bulk_segment *seg = (struct px4io_bulk_segment *)p;
+				unsigned set_offset, set_count;
+
+				random_range(page, 20, &set_offset, &set_count);
+				seg->page = page;
+				seg->offset = set_offset;
+				seg->count = set_count;
+				seg->op = PX4IO_BULK_OP_SET;
+				p += sizeof(*seg) / 2;
+
+				for (unsigned j = 0; j < set_count; j++)
+					p[j] = random();
+
+				model_write(page, set_offset, p, set_count);
+				p += set_count;
+
+				seg = (struct px4io_bulk_segment *)p;
+				random_range(get_page, 20, &offset, &count);
+				seg->page = get_page;
+				seg->offset = offset;
+				seg->count = count;
+				seg->op = PX4IO_BULK_OP_GET;
+				p += sizeof(*seg) / 2;
+
+				model.bulk_page = get_page;
+				model.bulk_offset = offset;
+				model.bulk_count = count;
+				bulk_written = true;
+
+				page = PX4IO_PAGE_BULK;
+				offset = 0;
+				count = p - b->values[i];
+				rq.write = true;
+				break;
+			}
+
+		case 6:
+			/* the failure mask and the registers of the GET segment */
+			if (!bulk_written) {
+				i--;
+				continue;
+			}
+
+			page = PX4IO_PAGE_BULK;
+			offset = 0;
+			count = 1 + model.bulk_count;
+			rq.write = false;
+			break;
+
+		default:
+			if (rnd(4) != 0) {
+				i--;
+				continue;
+			}
+
+			page = BAD_PAGE;
+			offset = 0;
+			count = 1;
+			b->expect_result[i] = -EINVAL;
+			rq.write = false;
+			break;
+		}
+
+		rq.page = page;
+		rq.offset = offset;
+		rq.count = count;
+		b->state[i + 1] = model;
+	}
+}
+
+/**
+ * Check the result of a batch.
+ *
+ * A read has to return the registers as written by the requests before
+ * it. When a request is lost, the transport sends it again with all the
+ * requests after it, so that IO applies writes in order; a read retried
+ * that way may already see the writes that follow it in the batch.
+ *
+ * @param in_order	Whether reads have to match exactly.
+ */
+static unsigned
+check_batch(const char *phase, unsigned n, struct batch *b, int ret, bool in_order)
+{
+	int expect_ret = OK;
+	unsigned errors = 0;
+
+	for (unsigned i = 0; i < b->count; i++) {
+		PX4IO_serial::Request &rq = b->rq[i];
+
+		if ((expect_ret == OK) && (b->expect_result[i] != OK))
+			expect_ret = b->expect_result[i];
+
+		if (rq.result != b->expect_result[i]) {
+			fprintf(stderr, "%s: transfer %u request %u/%u (%s page %u offset %u count %u): result %d, expected %d\n",
+				phase, n, i, b->count, rq.write ? "write" : "read", rq.page, rq.offset, rq.count,
+				rq.result, b->expect_result[i]);
+			errors++;
+			continue;
+		}
+
+		if (rq.write || (rq.result != OK))
+			continue;
+
+		unsigned last = in_order ? i : b->count;
+
+		for (unsigned r = 0; r < rq.count; r++) {
+			bool match = false;
+
+			for (unsigned s = i; (s <= last) && !match; s++) {
+				struct model *m = &b->state[s];
+				unsigned size;
+
+				if (rq.page != PX4IO_PAGE_BULK)
+					match = (model_page(m, rq.page, &size)[rq.offset + r] == rq.values[r]);
+				else if (r == 0)
+					match = (rq.values[r] == 0);
+				else
+					match = (model_page(m, m->bulk_page, &size)[m->bulk_offset + r - 1] == rq.values[r]);
+			}
+
+			if (!match) {
+				fprintf(stderr, "%s: transfer %u request %u/%u (read page %u offset %u count %u): wrong value at %u\n",
+					phase, n, i, b->count, rq.page, rq.offset, rq.count, r);
+				errors++;
+				break;
+			}
+		}
+	}
+
+	if (ret != expect_ret) {
+		fprintf(stderr, "%s: transfer %u returned %d, expected %d\n", phase, n, ret, expect_ret);
+		errors++;
+	}
+
+	return errors;
+}
+
+/**
+ * Compare the IO registers themselves with the model. Once a transfer
+ * has been answered, IO has handled every request sent before it.
+ */
+static unsigned
+check_registers(const char *phase)
+{
+	unsigned errors = 0;
+
+	if (memcmp(r_page_rc_input_config, model.rc_config, sizeof(model.rc_config)) ||
+	    memcmp(r_page_servo_failsafe, model.failsafe, sizeof(model.failsafe))) {
+		fprintf(stderr, "%s: IO registers differ from what FMU wrote\n", phase);
+		errors++;
+	}
+
+	for (unsigned i = 0; i < PX4IO_CONTROL_CHANNELS; i++) {
+		if (r_page_controls[i] != model.controls[i]) {
+			fprintf(stderr, "%s: IO control %u is %u, FMU wrote %u\n", phase, i, r_page_controls[i], model.controls[i]);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+static unsigned
+phase(PX4IO_serial &link, const char *name, unsigned flips, unsigned stalls)
+{
+	static struct batch b;
+	unsigned errors = 0;
+	unsigned requests = 0;
+	uint64_t timeouts = counter("px4io serial timeouts");
+	uint64_t rx_errors = counter("px4io serial rx errors");
+	unsigned io_errors = serial_errors;
+	unsigned flips_before = io_flips;
+	unsigned stalls_before = io_stalls;
+	unsigned bad_pages = 0;
+
+	flip_rate = flips;
+	stall_rate = stalls;
+
+	hrt_abstime start = hrt_absolute_time();
+
+	for (unsigned n = 0; n < TRANSFERS; n++) {
+		make_batch(&b);
+
+		int ret = link.transfer(b.rq, b.count);
+
+		errors += check_batch(name, n, &b, ret, (flips == 0) && (stalls == 0));
+		requests += b.count;
+
+		for (unsigned i = 0; i < b.count; i++) {
+			if (b.rq[i].page == BAD_PAGE)
+				bad_pages++;
+		}
+	}
+
+	double elapsed = (hrt_absolute_time() - start) / 1e6;
+
+	flip_rate = 0;
+	stall_rate = 0;
+
+	errors += check_registers(name);
+
+	timeouts = counter("px4io serial timeouts") - timeouts;
+	rx_errors = counter("px4io serial rx errors") - rx_errors;
+	io_errors = serial_errors - io_errors;
+
+	printf("px4io serial: %-6s %u transfers, %5u requests, %6.0f requests/s, %3u bits flipped, %3u stalls, "
+	       "%3llu retries, %3llu bad replies, %3u IO errors\n",
+	       name, TRANSFERS, requests, requests / elapsed, io_flips - flips_before, io_stalls - stalls_before,
+	       (unsigned long long)timeouts, (unsigned long long)rx_errors, io_errors);
+
+	if (flips || stalls) {
+		/* the faults must actually have been exercised */
+		if ((timeouts == 0) || (rx_errors == 0)) {
+			fprintf(stderr, "%s: no request was retried or no reply was damaged\n", name);
+			errors++;
+		}
+
+	} else {
+		/* error replies only, IO never ran out of room for replies */
+		if (io_errors != bad_pages) {
+			fprintf(stderr, "%s: IO counted %u errors, %u requests were for a bad page\n", name, io_errors, bad_pages);
+			errors++;
+		}
+
+		/* nothing is lost on a clean link; allow for the odd scheduling delay */
+		if (timeouts > TRANSFERS / 100) {
+			fprintf(stderr, "%s: %llu retries on a clean link\n", name, (unsigned long long)timeouts);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+/**
+ * IO does not answer at all: a transfer gives up after the retries.
+ */
+static unsigned
+silent(PX4IO_serial &link)
+{
+	uint16_t values[3][4];
+	PX4IO_serial::Request rq[3];
+	unsigned errors = 0;
+
+	for (unsigned i = 0; i < 3; i++) {
+		rq[i].write = (i == 1);
+		rq[i].page = PX4IO_PAGE_FAILSAFE_PWM;
+		rq[i].offset = 0;
+		rq[i].count = 4;
+		rq[i].values = values[i];
+		memcpy(values[i], model.failsafe, sizeof(values[i]));
+	}
+
+	io_silent = true;
+	link.retries = 2;
+
+	hrt_abstime start = hrt_absolute_time();
+	int ret = link.transfer(rq, 3);
+	hrt_abstime elapsed = hrt_absolute_time() - start;
+
+	io_silent = false;
+
+	if (ret != -ETIMEDOUT) {
+		fprintf(stderr, "silent: transfer returned %d\n", ret);
+		errors++;
+	}
+
+	for (unsigned i = 0; i < 3; i++) {
+		if (rq[i].result != -ETIMEDOUT) {
+			fprintf(stderr, "silent: request %u result %d\n", i, rq[i].result);
+			errors++;
+		}
+	}
+
+	/* three attempts of one window each */
+	if (elapsed < 3 * 10000) {
+		fprintf(stderr, "silent: gave up after %llu us\n", (unsigned long long)elapsed);
+		errors++;
+	}
+
+	printf("px4io serial: silent gave up after %.1f ms\n", elapsed / 1e3);
+
+	return errors;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char path[64];
+	int slave;
+	unsigned errors = 0;
+	pthread_t io;
+
+	if (openpty(&io_fd, &slave, path, nullptr, nullptr) != 0) {
+		perror("openpty");
+		return 1;
+	}
+
+	PX4IO_serial link(path);
+	int ret = link.init();
+
+	if (ret != OK) {
+		fprintf(stderr, "init: %s\n", strerror(-ret));
+		return 1;
+	}
+
+	pthread_create(&io, nullptr, io_thread, nullptr);
+
+	/* the static configuration page */
+	uint16_t config[PX4IO_P_CONFIG_RELAY_COUNT + 1];
+
+	ret = link.get_regs(PX4IO_PAGE_CONFIG, 0, config, sizeof(config) / sizeof(config[0]));
+
+	if ((ret != OK) ||
+	    (config[PX4IO_P_CONFIG_PROTOCOL_VERSION] != PX4IO_PROTOCOL_VERSION_BULK) ||
+	    (config[PX4IO_P_CONFIG_ACTUATOR_COUNT] != IO_SERVO_COUNT) ||
+	    (config[PX4IO_P_CONFIG_RELAY_COUNT] != PX4IO_RELAY_CHANNELS)) {
+		fprintf(stderr, "config page: %d\n", ret);
+		errors++;
+	}
+
+	errors += phase(link, "clean", 0, 0);
+
+	/* enough retries that no transfer runs out of them */
+	link.retries = 20;
+	errors += phase(link, "faults", 2000, 300);
+
+	errors += silent(link);
+
+	link.retries = 2;
+	errors += phase(link, "after", 0, 0);
+
+	io_exit = true;
+	pthread_join(io, nullptr);
+
+	close(slave);
+	close(io_fd);
+
+	if (errors)
+		fprintf(stderr, "px4io serial: %u errors\n", errors);
+
+	return errors ? 1 : 0;
+}
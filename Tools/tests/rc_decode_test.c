@@ -0,0 +1,484 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file rc_decode_test.c
+ *
+ * Host test harness for the R/C input decoders in systemlib/rc_decode.c.
+ *
+ *   rc_decode_test <trace> ...	replay recorded input and check the frames
+ *   rc_decode_test -f <count>	feed random input, check for overruns
+ *   rc_decode_test -b		time the decoders
+ *
+ * A trace names its decoder on the first line (ppm, dsm or sbus), then
+ * lists the input one call per line: the capture time of a PPM pulse, or
+ * the receive time of a serial read followed by its bytes in hex. A line
+ * starting with '=' gives the channel values the decoder must report
+ * for the input line before it; input without one must not complete a
+ * frame. Times are in microseconds, '#' starts a comment.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <systemlib/rc_decode.h>
+
+#define MAX_VALUES	18		/* enough for S.bus with its switch channels */
+#define GUARD		0xa5a5		/* fill beyond max_values, must survive every call */
+
+enum decoder_type {
+	DECODER_NONE,
+	DECODER_PPM,
+	DECODER_DSM,
+	DECODER_SBUS
+};
+
+struct decoders {
+	enum decoder_type	type;
+	struct ppm_decoder	ppm;
+	struct dsm_decoder	dsm;
+	struct sbus_decoder	sbus;
+	uint16_t		values[MAX_VALUES];
+	uint16_t		num_values;
+};
+
+static bool
+decoders_input(struct decoders *d, hrt_abstime now, const uint8_t *bytes, unsigned count)
+{
+	unsigned n;
+	bool ret;
+
+	switch (d->type) {
+	case DECODER_PPM:
+		ret = ppm_decoder_edge(&d->ppm, (uint16_t)now, d->values, &n);
+
+		if (ret)
+			d->num_values = n;
+
+		return ret;
+
+	case DECODER_DSM:
+		return dsm_decoder_input(&d->dsm, now, bytes, count, d->values, &d->num_values, MAX_VALUES);
+
+	case DECODER_SBUS:
+		return sbus_decoder_input(&d->sbus, now, bytes, count, d->values, &d->num_values, MAX_VALUES);
+
+	default:
+		return false;
+	}
+}
+
+static int
+replay(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	struct decoders d;
+	char line[512];
+	unsigned lineno = 0;
+	unsigned frames = 0;
+	unsigned errors = 0;
+	bool pending = false;		/* last input completed a frame not yet checked */
+	unsigned pending_line = 0;
+
+	if (fp == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	memset(&d, 0, sizeof(d));
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *p = strchr(line, '#');
+
+		lineno++;
+
+		if (p != NULL)
+			*p = '\0';
+
+		p = line + strspn(line, " \t\r\n");
+
+		if (*p == '\0')
+			continue;
+
+		if (d.type == DECODER_NONE) {
+			if (!strncmp(p, "ppm", 3)) {
+				d.type = DECODER_PPM;
+				ppm_decoder_init(&d.ppm);
+
+			} else if (!strncmp(p, "dsm", 3)) {
+				d.type = DECODER_DSM;
+				dsm_decoder_init(&d.dsm, 0);
+
+			} else if (!strncmp(p, "sbus", 4)) {
+				d.type = DECODER_SBUS;
+				sbus_decoder_init(&d.sbus, 0);
+
+			} else {
+				fprintf(stderr, "%s:%u: unknown decoder\n", path, lineno);
+				fclose(fp);
+				return 1;
+			}
+
+			continue;
+		}
+
+		if (*p == '=') {
+			uint16_t expect[MAX_VALUES];
+			unsigned n = 0;
+			char *end;
+
+			p++;
+
+			for (;;) {
+				unsigned long v = strtoul(p, &end, 0);
+
+				if (end == p || n == MAX_VALUES)
+					break;
+
+				expect[n++] = v;
+				p = end;
+			}
+
+			if (!pending) {
+				fprintf(stderr, "%s:%u: expected a frame, none was reported\n", path, lineno);
+				errors++;
+
+			} else if (n != d.num_values || memcmp(expect, d.values, n * sizeof(expect[0]))) {
+				fprintf(stderr, "%s:%u: frame differs, got %u values:", path, lineno, d.num_values);
+
+				for (unsigned i = 0; i < d.num_values; i++)
+					fprintf(stderr, " %u", d.values[i]);
+
+				fprintf(stderr, "\n");
+				errors++;
+			}
+
+			pending = false;
+			frames++;
+			continue;
+		}
+
+		if (pending) {
+			fprintf(stderr, "%s:%u: unexpected frame reported\n", path, pending_line);
+			errors++;
+		}
+
+		/* input: time, then for serial decoders the bytes read */
+		uint8_t bytes[64];
+		unsigned count = 0;
+		char *end;
+		hrt_abstime now = strtoull(p, &end, 0);
+
+		p = end;
+
+		for (;;) {
+			unsigned long v = strtoul(p, &end, 16);
+
+			if (end == p || count == sizeof(bytes))
+				break;
+
+			bytes[count++] = v;
+			p = end;
+		}
+
+		pending = decoders_input(&d, now, bytes, count);
+		pending_line = lineno;
+	}
+
+	if (pending) {
+		fprintf(stderr, "%s:%u: unexpected frame reported\n", path, pending_line);
+		errors++;
+	}
+
+	fclose(fp);
+
+	printf("%s: %u frames, %u errors\n", path, frames, errors);
+	return errors ? 1 : 0;
+}
+
+static unsigned
+rnd(unsigned n)
+{
+	return (unsigned)(random() % n);
+}
+
+static bool
+guard_intact(const uint16_t *values, unsigned from, unsigned to)
+{
+	for (unsigned i = from; i < to; i++)
+		if (values[i] != GUARD)
+			return false;
+
+	return true;
+}
+
+/**
+ * Feed random input to all decoders with a random number of output
+ * slots, checking nothing is written past them and the reported channel
+ * counts stay in range.
+ */
+static int
+fuzz(unsigned iterations)
+{
+	struct ppm_decoder ppm;
+	struct dsm_decoder dsm;
+	struct sbus_decoder sbus;
+	uint16_t values[32];
+	uint16_t num_values;
+	unsigned ppm_frames = 0, dsm_frames = 0, sbus_frames = 0;
+	hrt_abstime now = 0;
+
+	ppm_decoder_init(&ppm);
+	dsm_decoder_init(&dsm, now);
+	sbus_decoder_init(&sbus, now);
+
+	for (unsigned i = 0; i < iterations; i++) {
+		unsigned max_values = rnd(MAX_VALUES + 2);
+		uint8_t bytes[64];
+		unsigned count = rnd(sizeof(bytes) + 1);
+
+		for (unsigned j = 0; j < count; j++)
+			bytes[j] = rnd(256);
+
+		now += rnd(8000);
+
+		/* DSM only ever raises the count it is given */
+		for (unsigned j = 0; j < 32; j++)
+			values[j] = GUARD;
+
+		num_values = rnd(2) ? 0 : max_values;
+
+		if (dsm_decoder_input(&dsm, now, bytes, count, values, &num_values, max_values))
+			dsm_frames++;
+
+		if (num_values > max_values || !guard_intact(values, max_values, 32)) {
+			fprintf(stderr, "dsm: overrun at iteration %u\n", i);
+			return 1;
+		}
+
+		/* make some of the S.bus input look like frames */
+		if (count >= SBUS_FRAME_SIZE && rnd(4) == 0) {
+			bytes[0] = 0x0f;
+			bytes[SBUS_FRAME_SIZE - 1] = 0x00;
+		}
+
+		for (unsigned j = 0; j < 32; j++)
+			values[j] = GUARD;
+
+		num_values = 0;
+
+		if (sbus_decoder_input(&sbus, now, bytes, count, values, &num_values, max_values))
+			sbus_frames++;
+
+		if (num_values > max_values || !guard_intact(values, max_values, 32)) {
+			fprintf(stderr, "sbus: overrun at iteration %u\n", i);
+			return 1;
+		}
+
+		/* pulses mostly in channel range, with some frame gaps and noise */
+		for (unsigned j = 0; j < 8; j++) {
+			uint16_t edge;
+			unsigned n;
+
+			if (rnd(30) == 0) {
+				edge = ppm.last_edge + 3000 + rnd(20000);
+
+			} else if (rnd(4) == 0) {
+				edge = ppm.last_edge + rnd(65536);
+
+			} else {
+				edge = ppm.last_edge + 700 + rnd(1700);
+			}
+
+			for (unsigned k = 0; k < 32; k++)
+				values[k] = GUARD;
+
+			if (ppm_decoder_edge(&ppm, edge, values, &n)) {
+				ppm_frames++;
+
+				if (n > PPM_DECODE_MAX_CHANNELS) {
+					fprintf(stderr, "ppm: %u channels at iteration %u\n", n, i);
+					return 1;
+				}
+			}
+
+			if (!guard_intact(values, PPM_DECODE_MAX_CHANNELS, 32)) {
+				fprintf(stderr, "ppm: overrun at iteration %u\n", i);
+				return 1;
+			}
+		}
+	}
+
+	printf("fuzz: %u iterations, frames ppm %u dsm %u sbus %u, no overruns\n",
+	       iterations, ppm_frames, dsm_frames, sbus_frames);
+	return 0;
+}
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define BENCH_FRAMES	100000
+
+/**
+ * Time the decoders on well formed input: 8 channel PPM, 12 channel
+ * 11-bit DSM in two frame phases and 16 channel S.bus, each frame in
+ * a single read.
+ */
+static int
+bench(void)
+{
+	static uint8_t stream[BENCH_FRAMES * SBUS_FRAME_SIZE];
+	uint16_t values[MAX_VALUES];
+	uint16_t num_values = 0;
+	unsigned n;
+	double t0, t1;
+
+	struct ppm_decoder ppm;
+	uint16_t edge = 0;
+
+	ppm_decoder_init(&ppm);
+	t0 = now_ns();
+
+	for (unsigned f = 0; f < BENCH_FRAMES; f++) {
+		uint16_t start = edge;
+
+		for (unsigned c = 0; c < 8; c++) {
+			edge += 1000 + ((f + c) * 37) % 1000;
+			ppm_decoder_edge(&ppm, edge, values, &n);
+		}
+
+		edge = start + 22500;
+		ppm_decoder_edge(&ppm, edge, values, &n);
+	}
+
+	t1 = now_ns();
+	printf("ppm:  %6.1f ns/pulse\n", (t1 - t0) / (BENCH_FRAMES * 9.0));
+
+	struct dsm_decoder dsm;
+
+	for (unsigned f = 0; f < BENCH_FRAMES; f++) {
+		uint8_t *frame = &stream[f * DSM_FRAME_SIZE];
+
+		frame[0] = 0;
+		frame[1] = 0x12;
+
+		for (unsigned i = 0; i < 7; i++) {
+			unsigned channel = (f & 1) * 7 + i;
+			uint16_t raw = (channel < 12) ? ((channel << 11) | ((f * 13 + i * 101) & 0x7ff)) : 0xffff;
+
+			frame[2 + 2 * i] = raw >> 8;
+			frame[3 + 2 * i] = raw & 0xff;
+		}
+	}
+
+	dsm_decoder_init(&dsm, 0);
+	t0 = now_ns();
+
+	for (unsigned f = 0; f < BENCH_FRAMES; f++)
+		dsm_decoder_input(&dsm, (f + 1) * 11000ULL, &stream[f * DSM_FRAME_SIZE], DSM_FRAME_SIZE,
+				  values, &num_values, MAX_VALUES);
+
+	t1 = now_ns();
+	printf("dsm:  %6.1f ns/byte, %6.1f ns/frame\n",
+	       (t1 - t0) / (BENCH_FRAMES * (double)DSM_FRAME_SIZE), (t1 - t0) / BENCH_FRAMES);
+
+	struct sbus_decoder sbus;
+
+	for (unsigned f = 0; f < BENCH_FRAMES; f++) {
+		uint8_t *frame = &stream[f * SBUS_FRAME_SIZE];
+
+		frame[0] = 0x0f;
+
+		for (unsigned i = 1; i < 23; i++)
+			frame[i] = (f * 31 + i * 7) & 0xff;
+
+		frame[23] = 0;
+		frame[24] = 0;
+	}
+
+	sbus_decoder_init(&sbus, 0);
+	t0 = now_ns();
+
+	for (unsigned f = 0; f < BENCH_FRAMES; f++)
+		sbus_decoder_input(&sbus, (f + 1) * 7000ULL, &stream[f * SBUS_FRAME_SIZE], SBUS_FRAME_SIZE,
+				   values, &num_values, MAX_VALUES);
+
+	t1 = now_ns();
+	printf("sbus: %6.1f ns/byte, %6.1f ns/frame\n",
+	       (t1 - t0) / (BENCH_FRAMES * (double)SBUS_FRAME_SIZE), (t1 - t0) / BENCH_FRAMES);
+
+	return 0;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: rc_decode_test <trace> ...\n"
+		"       rc_decode_test -f <iterations>\n"
+		"       rc_decode_test -b\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int ret = 0;
+
+	if (argc < 2)
+		usage();
+
+	if (!strcmp(argv[1], "-f")) {
+		if (argc != 3)
+			usage();
+
+		srandom(1);
+		return fuzz(strtoul(argv[2], NULL, 0));
+	}
+
+	if (!strcmp(argv[1], "-b"))
+		return bench();
+
+	for (int i = 1; i < argc; i++)
+		ret |= replay(argv[i]);
+
+	return ret;
+}
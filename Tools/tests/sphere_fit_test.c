@@ -0,0 +1,330 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file sphere_fit_test.c
+ *
+ * Host test for the streaming sphere fit in commander/calibration_routines.c.
+ *
+ * Simulates the guided magnetometer calibration, three rotations around
+ * the body axes with some wobble and sensor noise, and checks that the
+ * streaming fit, solved along the way as commander does, ends up with
+ * exactly the result of the original batch fit over the buffered samples,
+ * and close to the true offsets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "calibration_routines.h"
+
+#define RUNS		200
+#define SAMPLES		500
+#define SOLVE_EVERY	11		/* about once a second at the calibration sample rate */
+#define MAX_OFFSET_ERROR 0.01f		/* Ga */
+
+/**
+ * The batch least-squares fit as it was before the streaming version,
+ * summing over buffered samples; the reference for the streaming fit.
+ */
+static int
+reference_sphere_fit(const float x[], const float y[], const float z[],
+		     unsigned int size, unsigned int max_iterations, float delta,
+		     float *sphere_x, float *sphere_y, float *sphere_z, float *sphere_radius)
+{
+	float x_sumplain = 0.0f;
+	float x_sumsq = 0.0f;
+	float x_sumcube = 0.0f;
+
+	float y_sumplain = 0.0f;
+	float y_sumsq = 0.0f;
+	float y_sumcube = 0.0f;
+
+	float z_sumplain = 0.0f;
+	float z_sumsq = 0.0f;
+	float z_sumcube = 0.0f;
+
+	float xy_sum = 0.0f;
+	float xz_sum = 0.0f;
+	float yz_sum = 0.0f;
+
+	float x2y_sum = 0.0f;
+	float x2z_sum = 0.0f;
+	float y2x_sum = 0.0f;
+	float y2z_sum = 0.0f;
+	float z2x_sum = 0.0f;
+	float z2y_sum = 0.0f;
+
+	for (unsigned int i = 0; i < size; i++) {
+
+		float x2 = x[i] * x[i];
+		float y2 = y[i] * y[i];
+		float z2 = z[i] * z[i];
+
+		x_sumplain += x[i];
+		x_sumsq += x2;
+		x_sumcube += x2 * x[i];
+
+		y_sumplain += y[i];
+		y_sumsq += y2;
+		y_sumcube += y2 * y[i];
+
+		z_sumplain += z[i];
+		z_sumsq += z2;
+		z_sumcube += z2 * z[i];
+
+		xy_sum += x[i] * y[i];
+		xz_sum += x[i] * z[i];
+		yz_sum += y[i] * z[i];
+
+		x2y_sum += x2 * y[i];
+		x2z_sum += x2 * z[i];
+
+		y2x_sum += y2 * x[i];
+		y2z_sum += y2 * z[i];
+
+		z2x_sum += z2 * x[i];
+		z2y_sum += z2 * y[i];
+	}
+
+	float x_sum = x_sumplain / size;
+	float x_sum2 = x_sumsq / size;
+	float x_sum3 = x_sumcube / size;
+	float y_sum = y_sumplain / size;
+	float y_sum2 = y_sumsq / size;
+	float y_sum3 = y_sumcube / size;
+	float z_sum = z_sumplain / size;
+	float z_sum2 = z_sumsq / size;
+	float z_sum3 = z_sumcube / size;
+
+	float XY = xy_sum / size;
+	float XZ = xz_sum / size;
+	float YZ = yz_sum / size;
+	float X2Y = x2y_sum / size;
+	float X2Z = x2z_sum / size;
+	float Y2X = y2x_sum / size;
+	float Y2Z = y2z_sum / size;
+	float Z2X = z2x_sum / size;
+	float Z2Y = z2y_sum / size;
+
+	float F0 = x_sum2 + y_sum2 + z_sum2;
+	float F1 =  0.5f * F0;
+	float F2 = -8.0f * (x_sum3 + Y2X + Z2X);
+	float F3 = -8.0f * (X2Y + y_sum3 + Z2Y);
+	float F4 = -8.0f * (X2Z + Y2Z + z_sum3);
+
+	float A = x_sum;
+	float B = y_sum;
+	float C = z_sum;
+
+	float A2 = A * A;
+	float B2 = B * B;
+	float C2 = C * C;
+	float QS = A2 + B2 + C2;
+	float QB = -2.0f * (A * x_sum + B * y_sum + C * z_sum);
+
+	float Rsq = F0 + QB + QS;
+
+	float Q0 = 0.5f * (QS - Rsq);
+	float Q1 = F1 + Q0;
+	float Q2 = 8.0f * (QS - Rsq + QB + F0);
+	float aA, aB, aC, nA, nB, nC, dA, dB, dC;
+
+	unsigned int n = 0;
+
+	while (n < max_iterations) {
+		n++;
+
+		aA = Q2 + 16.0f * (A2 - 2.0f * A * x_sum + x_sum2);
+		aB = Q2 + 16.0f * (B2 - 2.0f * B * y_sum + y_sum2);
+		aC = Q2 + 16.0f * (C2 - 2.0f * C * z_sum + z_sum2);
+		aA = (aA == 0.0f) ? 1.0f : aA;
+		aB = (aB == 0.0f) ? 1.0f : aB;
+		aC = (aC == 0.0f) ? 1.0f : aC;
+
+		nA = A - ((F2 + 16.0f * (B * XY + C * XZ + x_sum * (-A2 - Q0) + A * (x_sum2 + Q1 - C * z_sum - B * y_sum))) / aA);
+		nB = B - ((F3 + 16.0f * (A * XY + C * YZ + y_sum * (-B2 - Q0) + B * (y_sum2 + Q1 - A * x_sum - C * z_sum))) / aB);
+		nC = C - ((F4 + 16.0f * (A * XZ + B * YZ + z_sum * (-C2 - Q0) + C * (z_sum2 + Q1 - A * x_sum - B * y_sum))) / aC);
+
+		dA = (nA - A);
+		dB = (nB - B);
+		dC = (nC - C);
+
+		if ((dA * dA + dB * dB + dC * dC) <= delta) { break; }
+
+		A = nA;
+		B = nB;
+		C = nC;
+		A2 = A * A;
+		B2 = B * B;
+		C2 = C * C;
+		QS = A2 + B2 + C2;
+		QB = -2.0f * (A * x_sum + B * y_sum + C * z_sum);
+		Rsq = F0 + QB + QS;
+		Q0 = 0.5f * (QS - Rsq);
+		Q1 = F1 + Q0;
+		Q2 = 8.0f * (QS - Rsq + QB + F0);
+	}
+
+	*sphere_x = A;
+	*sphere_y = B;
+	*sphere_z = C;
+	*sphere_radius = sqrtf(Rsq);
+
+	return 0;
+}
+
+static float
+frand(void)
+{
+	return (float)random() / RAND_MAX;
+}
+
+static float
+gauss(void)
+{
+	float u = frand() + 1e-7f;
+	float v = frand();
+
+	return sqrtf(-2.0f * logf(u)) * cosf(2.0f * (float)M_PI * v);
+}
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static float x[SAMPLES], y[SAMPLES], z[SAMPLES];
+	unsigned identical = 0;
+	unsigned covered = 0;
+	unsigned failed = 0;
+	float max_error = 0.0f;
+	double t_batch = 0, t_add = 0, t_solve = 0;
+	unsigned solves = 0;
+
+	srandom(7);
+
+	for (unsigned run = 0; run < RUNS; run++) {
+		float ox = (frand() - 0.5f) * 0.6f;
+		float oy = (frand() - 0.5f) * 0.6f;
+		float oz = (frand() - 0.5f) * 0.6f;
+		float radius = 0.4f + frand() * 0.3f;
+		struct sphere_fit_state fit;
+		float sx, sy, sz, sr;
+		double t0;
+
+		sphere_fit_init(&fit);
+
+		for (unsigned i = 0; i < SAMPLES; i++) {
+			/* one third of the samples per axis, three turns each, tilting back and forth */
+			unsigned turn = SAMPLES / 3;
+			float a = 2.0f * (float)M_PI * 3.0f * (i % turn) / turn;
+			float w = 0.5f * sinf(i * 0.13f);
+			float u[3];
+			unsigned axis = (i / turn < 3) ? i / turn : 2;
+
+			u[axis] = sinf(w);
+			u[(axis + 1) % 3] = cosf(w) * cosf(a);
+			u[(axis + 2) % 3] = cosf(w) * sinf(a);
+
+			x[i] = ox + radius * u[0] + 0.005f * gauss();
+			y[i] = oy + radius * u[1] + 0.005f * gauss();
+			z[i] = oz + radius * u[2] + 0.005f * gauss();
+
+			t0 = now_ns();
+			sphere_fit_add(&fit, x[i], y[i], z[i]);
+			t_add += now_ns() - t0;
+
+			/* intermediate estimates, as the calibration reports them */
+			if ((i % SOLVE_EVERY) == SOLVE_EVERY - 1) {
+				t0 = now_ns();
+				sphere_fit_solve(&fit, 100, 0.0f, &sx, &sy, &sz, &sr);
+				t_solve += now_ns() - t0;
+				solves++;
+			}
+		}
+
+		float bx, by, bz, br;
+
+		t0 = now_ns();
+		reference_sphere_fit(x, y, z, SAMPLES, 100, 0.0f, &bx, &by, &bz, &br);
+		t_batch += now_ns() - t0;
+
+		if (sphere_fit_solve(&fit, 100, 0.0f, &sx, &sy, &sz, &sr) != 0) {
+			fprintf(stderr, "run %u: solve failed\n", run);
+			failed++;
+			continue;
+		}
+
+		if (sx == bx && sy == by && sz == bz && sr == br) {
+			identical++;
+
+		} else {
+			fprintf(stderr, "run %u: streaming %f %f %f r %f, batch %f %f %f r %f\n",
+				run, (double)sx, (double)sy, (double)sz, (double)sr,
+				(double)bx, (double)by, (double)bz, (double)br);
+			failed++;
+		}
+
+		float error = fmaxf(fabsf(sx - ox), fmaxf(fabsf(sy - oy), fabsf(sz - oz)));
+
+		if (error > max_error)
+			max_error = error;
+
+		if (error > MAX_OFFSET_ERROR) {
+			fprintf(stderr, "run %u: offset off by %f Ga\n", run, (double)error);
+			failed++;
+		}
+
+		if (sphere_fit_coverage(&fit) == SPHERE_FIT_COVERAGE_BINS)
+			covered++;
+	}
+
+	printf("sphere fit: %u/%u runs identical to the batch fit, %u fully covered, max offset error %.4f Ga\n",
+	       identical, RUNS, covered, (double)max_error);
+	printf("sphere fit: batch over %u samples %.1f us, streaming add %.1f ns/sample, solve %.2f us\n",
+	       SAMPLES, t_batch / RUNS / 1e3, t_add / ((double)RUNS * SAMPLES), t_solve / solves / 1e3);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,446 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file state_machine_test.c
+ *
+ * Host test for the commander state machine in state_machine_helper.c.
+ *
+ *   state_machine_test <table>		check every transition against the table
+ *   state_machine_test -w <table>	write the table from the code under test
+ *
+ * Every state is combined with every event the commander can raise and
+ * with a set of vehicle status variants (HIL, vector flight mode, airframe,
+ * armed, manual control mode and flight mode). The table holds one line per
+ * (state, event) pair, listing the outcome of each variant in order as
+ * run-length encoded tokens, see outcome_token(). It was written from the
+ * if/else implementation the transition tables replaced, so any change to
+ * the behaviour shows up as a diff against it.
+ *
+ * Independent of the table, no transition may touch status fields the state
+ * machine does not own, and a published status must match the one returned
+ * to the caller.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <drivers/drv_hrt.h>
+#include <uORB/uORB.h>
+#include <uORB/topics/vehicle_status.h>
+#include <uORB/topics/actuator_controls.h>
+
+#include "state_machine_helper.h"
+
+#define STATUS_PUB	1
+#define MAVLINK_FD	-1
+#define VARIANTS	96
+#define LINE_MAX_LEN	4096
+#define TOKEN_MAX_LEN	48
+
+/*
+ * Stand-ins for the commander and the system.
+ */
+ORB_DEFINE(vehicle_status, struct vehicle_status_s);
+ORB_DEFINE(actuator_armed, struct actuator_armed_s);
+
+static unsigned status_publishes;
+static unsigned armed_publishes;
+static struct vehicle_status_s published;
+
+orb_advert_t
+orb_advertise(const struct orb_metadata *meta, const void *data)
+{
+	orb_publish(meta, 1, data);
+	return 1;
+}
+
+int
+orb_publish(const struct orb_metadata *meta, orb_advert_t handle, const void *data)
+{
+	if (meta == ORB_ID(vehicle_status)) {
+		memcpy(&published, data, sizeof(published));
+		status_publishes++;
+
+	} else if (meta == ORB_ID(actuator_armed)) {
+		armed_publishes++;
+	}
+
+	return 0;
+}
+
+hrt_abstime
+hrt_absolute_time(void)
+{
+	static hrt_abstime now;
+
+	return now += 1000;
+}
+
+int usleep(useconds_t usec) { return 0; }
+void up_systemreset(void) {}
+void tune_confirm(void) {}
+void tune_error(void) {}
+
+/*
+ * The events, as raised by the commander.
+ */
+typedef void (*event_fn)(int, struct vehicle_status_s *, const int);
+
+static const struct {
+	const char	*name;
+	event_fn	fn;
+} events[] = {
+	{ "position_fix",		update_state_machine_got_position_fix },
+	{ "position_fix_lost",		update_state_machine_no_position_fix },
+	{ "arm",			update_state_machine_arm },
+	{ "disarm",			update_state_machine_disarm },
+	{ "mode_manual",		update_state_machine_mode_manual },
+	{ "mode_stabilized",		update_state_machine_mode_stabilized },
+	{ "mode_guided",		update_state_machine_mode_guided },
+	{ "mode_auto",			update_state_machine_mode_auto },
+	{ "emergency",			state_machine_emergency },
+	{ "emergency_critical",		state_machine_emergency_always_critical },
+};
+#define NUM_EVENTS	((unsigned)(sizeof(events) / sizeof(events[0])))
+
+/* MAV_CMD_DO_SET_MODE base modes, as sent by a ground station */
+static const uint8_t request_modes[] = {
+	0,
+	VEHICLE_MODE_FLAG_SAFETY_ARMED,
+	VEHICLE_MODE_FLAG_SAFETY_ARMED | VEHICLE_MODE_FLAG_AUTO_ENABLED,
+	VEHICLE_MODE_FLAG_STABILIZED_ENABLED,
+	VEHICLE_MODE_FLAG_SAFETY_ARMED | VEHICLE_MODE_FLAG_GUIDED_ENABLED,
+	VEHICLE_MODE_FLAG_MANUAL_INPUT_ENABLED,
+	VEHICLE_MODE_FLAG_SAFETY_ARMED | VEHICLE_MODE_FLAG_MANUAL_INPUT_ENABLED,
+	VEHICLE_MODE_FLAG_HIL_ENABLED,
+	VEHICLE_MODE_FLAG_SAFETY_ARMED | VEHICLE_MODE_FLAG_HIL_ENABLED,
+};
+#define NUM_REQUEST_MODES	((unsigned)(sizeof(request_modes) / sizeof(request_modes[0])))
+
+/* custom modes are system states, plus one past the last */
+#define NUM_CUSTOM_MODES	(SYSTEM_STATE_REBOOT + 2)
+
+#define NUM_ALL_EVENTS		(NUM_EVENTS + NUM_REQUEST_MODES + NUM_CUSTOM_MODES)
+
+static void
+event_name(unsigned event, char *buf, size_t len)
+{
+	if (event < NUM_EVENTS) {
+		snprintf(buf, len, "%s", events[event].name);
+
+	} else if (event < NUM_EVENTS + NUM_REQUEST_MODES) {
+		snprintf(buf, len, "mode_request_%02x", request_modes[event - NUM_EVENTS]);
+
+	} else {
+		snprintf(buf, len, "custom_mode_request_%u", event - NUM_EVENTS - NUM_REQUEST_MODES);
+	}
+}
+
+/**
+ * Build the status the variant describes, consistent with what the
+ * commander would hold in the given state.
+ */
+static void
+variant_status(struct vehicle_status_s *status, unsigned state, unsigned variant)
+{
+	static const enum VEHICLE_FLIGHT_MODE flight_modes[] = {
+		VEHICLE_FLIGHT_MODE_MANUAL,
+		VEHICLE_FLIGHT_MODE_STAB,
+		VEHICLE_FLIGHT_MODE_AUTO
+	};
+
+	memset(status, 0, sizeof(*status));
+	status->state_machine = state;
+	status->flag_hil_enabled = variant & 1;
+	status->flag_vector_flight_mode_ok = (variant >> 1) & 1;
+	status->system_type = ((variant >> 2) & 1) ? VEHICLE_TYPE_QUADROTOR : VEHICLE_TYPE_FIXED_WING;
+	status->flag_system_armed = (variant >> 3) & 1;
+	status->manual_control_mode = ((variant >> 4) & 1) ? VEHICLE_MANUAL_CONTROL_MODE_SAS : VEHICLE_MANUAL_CONTROL_MODE_DIRECT;
+	status->flight_mode = flight_modes[(variant >> 5) % 3];
+
+	status->flag_control_manual_enabled = (status->flight_mode == VEHICLE_FLIGHT_MODE_MANUAL);
+	status->flag_control_attitude_enabled = !(status->flight_mode == VEHICLE_FLIGHT_MODE_MANUAL &&
+						  status->manual_control_mode == VEHICLE_MANUAL_CONTROL_MODE_DIRECT);
+	status->flag_control_rates_enabled = status->flag_control_attitude_enabled;
+}
+
+/**
+ * Copy the fields the state machine owns from one status to another.
+ */
+static void
+copy_owned(struct vehicle_status_s *to, const struct vehicle_status_s *from)
+{
+	to->state_machine = from->state_machine;
+	to->flag_system_armed = from->flag_system_armed;
+	to->flag_hil_enabled = from->flag_hil_enabled;
+	to->flight_mode = from->flight_mode;
+	to->manual_control_mode = from->manual_control_mode;
+	to->flag_control_attitude_enabled = from->flag_control_attitude_enabled;
+	to->flag_control_rates_enabled = from->flag_control_rates_enabled;
+	to->flag_control_manual_enabled = from->flag_control_manual_enabled;
+	to->flag_control_position_enabled = from->flag_control_position_enabled;
+	to->flag_control_velocity_enabled = from->flag_control_velocity_enabled;
+	to->onboard_control_sensors_present = from->onboard_control_sensors_present;
+	to->onboard_control_sensors_enabled = from->onboard_control_sensors_enabled;
+	to->onboard_control_sensors_health = from->onboard_control_sensors_health;
+	to->counter = from->counter;
+	to->timestamp = from->timestamp;
+}
+
+/**
+ * Encode the outcome of one transition.
+ *
+ * The token lists what changed, as a letter followed by the new value in
+ * hex: S state, A armed, F flight mode, M manual control mode, C control
+ * flags (attitude 1, rates 2, manual 4, position 8, velocity 10), H HIL,
+ * and the onboard sensor bits 0x400..0x4000 shifted down, P present,
+ * E enabled, Z health. Then p1 and a1 mark that the status and the armed
+ * state were published (how often is an implementation detail, as long as
+ * the last status published is the one the caller ends up with), and r
+ * gives the return value of a mode request. A transition without any
+ * effect is ".".
+ */
+static void
+outcome_token(char *buf, size_t len, const struct vehicle_status_s *before,
+	      const struct vehicle_status_s *after, int ret)
+{
+	size_t pos = 0;
+
+#define CONTROLS(_s)	(((_s)->flag_control_attitude_enabled ? 0x01 : 0) | \
+			 ((_s)->flag_control_rates_enabled ? 0x02 : 0) | \
+			 ((_s)->flag_control_manual_enabled ? 0x04 : 0) | \
+			 ((_s)->flag_control_position_enabled ? 0x08 : 0) | \
+			 ((_s)->flag_control_velocity_enabled ? 0x10 : 0))
+#define SENSORS(_x)	(((_x) >> 10) & 0x1f)
+#define CHANGED(_c, _v0, _v1) \
+	do { \
+		if ((unsigned)(_v0) != (unsigned)(_v1)) \
+			pos += snprintf(buf + pos, len - pos, "%c%x", _c, (unsigned)(_v1)); \
+	} while (0)
+
+	buf[0] = '\0';
+	CHANGED('S', before->state_machine, after->state_machine);
+	CHANGED('A', before->flag_system_armed, after->flag_system_armed);
+	CHANGED('F', before->flight_mode, after->flight_mode);
+	CHANGED('M', before->manual_control_mode, after->manual_control_mode);
+	CHANGED('C', CONTROLS(before), CONTROLS(after));
+	CHANGED('H', before->flag_hil_enabled, after->flag_hil_enabled);
+	CHANGED('P', SENSORS(before->onboard_control_sensors_present), SENSORS(after->onboard_control_sensors_present));
+	CHANGED('E', SENSORS(before->onboard_control_sensors_enabled), SENSORS(after->onboard_control_sensors_enabled));
+	CHANGED('Z', SENSORS(before->onboard_control_sensors_health), SENSORS(after->onboard_control_sensors_health));
+	CHANGED('p', 0, status_publishes > 0);
+	CHANGED('a', 0, armed_publishes > 0);
+
+	if (ret >= 0)
+		pos += snprintf(buf + pos, len - pos, "r%x", ret);
+
+	if (pos == 0)
+		snprintf(buf, len, ".");
+
+#undef CONTROLS
+#undef SENSORS
+#undef CHANGED
+}
+
+/**
+ * Run every variant of one (state, event) pair and build its table line.
+ *
+ * @return		the number of invariant violations
+ */
+static unsigned
+walk_pair(unsigned state, unsigned event, char *line, size_t len)
+{
+	char last[TOKEN_MAX_LEN] = "";
+	unsigned run = 0;
+	unsigned errors = 0;
+	size_t pos;
+	char name[32];
+
+	event_name(event, name, sizeof(name));
+	pos = snprintf(line, len, "%u %s", state, name);
+
+	for (unsigned variant = 0; variant <= VARIANTS; variant++) {
+		char token[TOKEN_MAX_LEN] = "";
+
+		if (variant < VARIANTS) {
+			struct vehicle_status_s before, after, check;
+			int ret = -1;
+
+			variant_status(&before, state, variant);
+			after = before;
+			status_publishes = 0;
+			armed_publishes = 0;
+
+			if (event < NUM_EVENTS) {
+				events[event].fn(STATUS_PUB, &after, MAVLINK_FD);
+
+			} else if (event < NUM_EVENTS + NUM_REQUEST_MODES) {
+				ret = update_state_machine_mode_request(STATUS_PUB, &after, MAVLINK_FD,
+									request_modes[event - NUM_EVENTS]);
+
+			} else {
+				ret = update_state_machine_custom_mode_request(STATUS_PUB, &after, MAVLINK_FD,
+									       event - NUM_EVENTS - NUM_REQUEST_MODES);
+			}
+
+			check = before;
+			copy_owned(&check, &after);
+
+			if (memcmp(&check, &after, sizeof(check))) {
+				fprintf(stderr, "%s: state %u variant %u changed a field it does not own\n",
+					name, state, variant);
+				errors++;
+			}
+
+			if (status_publishes > 0) {
+				/* the caller's copy may only differ in the bookkeeping */
+				check = after;
+				check.counter = published.counter;
+				check.timestamp = published.timestamp;
+
+				if (memcmp(&check, &published, sizeof(check))) {
+					fprintf(stderr, "%s: state %u variant %u published a different status\n",
+						name, state, variant);
+					errors++;
+				}
+			}
+
+			outcome_token(token, sizeof(token), &before, &after, ret);
+
+			if (run > 0 && !strcmp(token, last)) {
+				run++;
+				continue;
+			}
+		}
+
+		if (pos < len && run > 1)
+			pos += snprintf(line + pos, len - pos, " %u*%s", run, last);
+
+		else if (pos < len && run == 1)
+			pos += snprintf(line + pos, len - pos, " %s", last);
+
+		strcpy(last, token);
+		run = 1;
+	}
+
+	if (pos >= len) {
+		fprintf(stderr, "%s: state %u line too long\n", name, state);
+		errors++;
+	}
+
+	return errors;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: state_machine_test <table>\n"
+		"       state_machine_test -w <table>\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *path;
+	bool write = false;
+	FILE *fp;
+	char line[LINE_MAX_LEN];
+	char expected[LINE_MAX_LEN];
+	unsigned pairs = 0;
+	unsigned mismatches = 0;
+	unsigned errors = 0;
+
+	if (argc == 3 && !strcmp(argv[1], "-w")) {
+		write = true;
+		path = argv[2];
+
+	} else if (argc == 2) {
+		path = argv[1];
+
+	} else {
+		usage();
+	}
+
+	fp = fopen(path, write ? "w" : "r");
+
+	if (fp == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	/* the state machine narrates on stdout */
+	if (freopen("/dev/null", "w", stdout) == NULL) {
+		perror("/dev/null");
+		return 1;
+	}
+
+	if (write)
+		fprintf(fp, "# commander state machine transitions, see state_machine_test.c\n");
+
+	for (unsigned state = 0; state <= SYSTEM_STATE_REBOOT; state++) {
+		for (unsigned event = 0; event < NUM_ALL_EVENTS; event++) {
+			errors += walk_pair(state, event, line, sizeof(line));
+			pairs++;
+
+			if (write) {
+				fprintf(fp, "%s\n", line);
+				continue;
+			}
+
+			do {
+				if (fgets(expected, sizeof(expected), fp) == NULL) {
+					strcpy(expected, "(end of table)");
+					break;
+				}
+			} while (expected[0] == '#');
+
+			expected[strcspn(expected, "\r\n")] = '\0';
+
+			if (strcmp(line, expected)) {
+				if (mismatches++ < 10)
+					fprintf(stderr, "expected: %s\n     got: %s\n", expected, line);
+			}
+		}
+	}
+
+	fclose(fp);
+
+	fprintf(stderr, "state_machine_test: %u transitions in %u state/event pairs, %u mismatches, %u errors\n",
+		pairs * VARIANTS, pairs, mismatches, errors);
+
+	return (mismatches || errors) ? 1 : 0;
+}
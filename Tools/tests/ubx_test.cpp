@@ -0,0 +1,577 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file ubx_test.cpp
+ *
+ * Host test for the UBX frame parser in drivers/gps/ubx.cpp.
+ *
+ *   ubx_test		check the parser on generated streams
+ *   ubx_test -b	time the parser
+ *
+ * Generates a u-blox output stream, navigation epochs of NAV-POSLLH,
+ * VELNED, SOL and TIMEUTC with NAV-SVINFO, messages the driver does not
+ * handle, NMEA sentences and stray sync bytes in between, and feeds it
+ * to UBX::receive() through a pipe: a byte at a time, in random pieces
+ * and in large writes that the driver splits into its own chunked reads.
+ * Every epoch must be reported once, with its own values.
+ *
+ * The same stream is then sent with a payload, checksum or length byte
+ * of some frames corrupted. Each corrupted frame must count exactly one
+ * checksum error, the epochs it belonged to must not be reported, and
+ * all others must be, so the parser has to find the frames again that
+ * a corrupted length made it wait for.
+ *
+ * Payloads of the generated frames never contain a sync byte, so after
+ * a corrupted frame the parser cannot lock onto a frame start inside
+ * it and the checksum errors are exact.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <systemlib/perf_counter.h>
+
+#include "ubx.h"
+
+#define EPOCHS		500
+#define BENCH_EPOCHS	5000
+#define BENCH_RUNS	20
+#define CORRUPT_PERCENT	5
+#define STREAM_MAX	(BENCH_EPOCHS * 400 + RECV_BUFFER_SIZE)
+#define SVINFO_CHANNELS	12
+#define PIPE_CHUNK	4096		/* largest write, well within the pipe buffer */
+
+/**
+ * What the driver has to report for an epoch.
+ */
+struct expected {
+	int32_t		lat;
+	int32_t		lon;
+	float		vel_n_m_s;
+	uint8_t		fix_type;
+	uint8_t		satellites_used;	/**< of the last intact NAV-SVINFO */
+	uint8_t		satellite_prn;		/**< first channel of it */
+};
+
+struct stream {
+	uint8_t		data[STREAM_MAX];
+	unsigned	length;
+	struct expected	epochs[BENCH_EPOCHS];
+	unsigned	num_epochs;		/**< epochs that must be reported */
+	unsigned	corrupted;		/**< frames with a corrupted byte */
+};
+
+/*
+ * Test doubles for the driver's environment.
+ */
+static hrt_abstime fake_time;
+
+hrt_abstime
+hrt_absolute_time(void)
+{
+	return fake_time;
+}
+
+int
+GPS_Helper::set_baudrate(const int &fd, unsigned baud)
+{
+	return 0;
+}
+
+struct perf_ctr_header {
+	uint64_t	event_count;
+	double		start;
+	double		elapsed;	/**< ns */
+};
+
+static perf_counter_t parse_perf;
+static perf_counter_t checksum_errors;
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+perf_counter_t
+perf_alloc(enum perf_counter_type type, const char *name)
+{
+	perf_counter_t handle = (perf_counter_t)calloc(1, sizeof(struct perf_ctr_header));
+
+	if (!strcmp(name, "ubx parse"))
+		parse_perf = handle;
+
+	if (!strcmp(name, "ubx checksum errors"))
+		checksum_errors = handle;
+
+	return handle;
+}
+
+void
+perf_free(perf_counter_t handle)
+{
+	free(handle);
+}
+
+void
+perf_count(perf_counter_t handle)
+{
+	handle->event_count++;
+}
+
+void
+perf_begin(perf_counter_t handle)
+{
+	handle->start = now_ns();
+}
+
+void
+perf_end(perf_counter_t handle)
+{
+	handle->elapsed += now_ns() - handle->start;
+	handle->event_count++;
+}
+
+static unsigned
+rnd(unsigned n)
+{
+	return random() % n;
+}
+
+/**
+ * Keep sync bytes out of a payload; values are read back from the
+ * payload afterwards, so they stay consistent.
+ */
+static void
+desync(void *payload, unsigned length)
+{
+	uint8_t *p = (uint8_t *)payload;
+
+	for (unsigned i = 0; i < length; i++) {
+		if (p[i] == UBX_SYNC1)
+			p[i]--;
+	}
+}
+
+/**
+ * Append a frame, corrupting one byte after the sync bytes if asked to.
+ *
+ * @return		true if the frame was corrupted
+ */
+static bool
+append_frame(struct stream *s, uint8_t clsID, uint8_t msgID, void *payload, unsigned length, bool corrupt)
+{
+	uint8_t *frame = &s->data[s->length];
+	uint8_t ck_a = 0;
+	uint8_t ck_b = 0;
+
+	desync(payload, length);
+
+	frame[0] = UBX_SYNC1;
+	frame[1] = UBX_SYNC2;
+	frame[2] = clsID;
+	frame[3] = msgID;
+	frame[4] = length & 0xff;
+	frame[5] = length >> 8;
+	memcpy(&frame[6], payload, length);
+
+	for (unsigned i = 2; i < 6 + length; i++) {
+		ck_a += frame[i];
+		ck_b += ck_a;
+	}
+
+	frame[6 + length] = ck_a;
+	frame[7 + length] = ck_b;
+	s->length += length + UBX_FRAME_OVERHEAD;
+
+	if (!corrupt || rnd(100) >= CORRUPT_PERCENT)
+		return false;
+
+	unsigned pos = 4 + rnd(length + 4);
+
+	if (pos < 6) {
+		/* another length the parser could buffer, it has to wait for it and then give up */
+		unsigned bad_length;
+
+		do {
+			bad_length = rnd(UBX_MAX_PAYLOAD_LENGTH + 1);
+		} while (bad_length == length || (bad_length & 0xff) == UBX_SYNC1 || (bad_length >> 8) == UBX_SYNC1);
+
+		frame[4] = bad_length & 0xff;
+		frame[5] = bad_length >> 8;
+
+	} else {
+		do {
+			frame[pos] ^= 1 + rnd(255);
+		} while (frame[pos] == UBX_SYNC1);
+	}
+
+	s->corrupted++;
+	return true;
+}
+
+static void
+append_garbage(struct stream *s)
+{
+	static const char nmea[] = "$GPGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,*76\r\n";
+	static const uint8_t stray_sync[] = { UBX_SYNC1, 0x00, UBX_SYNC1, UBX_SYNC1 };
+	static const uint8_t huge_frame[] = { UBX_SYNC1, UBX_SYNC2, UBX_CLASS_NAV, UBX_MESSAGE_NAV_POSLLH, 0xff, 0xff };
+
+	switch (rnd(4)) {
+	case 0:
+		memcpy(&s->data[s->length], nmea, sizeof(nmea) - 1);
+		s->length += sizeof(nmea) - 1;
+		break;
+
+	case 1:
+		memcpy(&s->data[s->length], stray_sync, sizeof(stray_sync));
+		s->length += sizeof(stray_sync);
+		break;
+
+	case 2:
+		memcpy(&s->data[s->length], huge_frame, sizeof(huge_frame));
+		s->length += sizeof(huge_frame);
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ * Generate the output of a u-blox module configured as by UBX::configure().
+ */
+static void
+generate(struct stream *s, unsigned epochs, bool corrupt)
+{
+	uint8_t satellites_used = 0;
+	uint8_t satellite_prn = 0;
+
+	s->length = 0;
+	s->num_epochs = 0;
+	s->corrupted = 0;
+
+	for (unsigned e = 0; e < epochs; e++) {
+		uint32_t itow = 345600000 + 200 * e;
+		bool intact = true;
+
+		/* NAV-SVINFO once a second, sometimes with more channels announced than sent */
+		if ((e % 5) == 0) {
+			struct {
+				gps_bin_nav_svinfo_part1_packet_t part1;
+				gps_bin_nav_svinfo_part2_packet_t part2[SVINFO_CHANNELS];
+			} svinfo;
+
+			memset(&svinfo, 0, sizeof(svinfo));
+			svinfo.part1.time_milliseconds = itow;
+			svinfo.part1.numCh = (e % 10) ? SVINFO_CHANNELS : 30;
+
+			for (unsigned i = 0; i < SVINFO_CHANNELS; i++) {
+				svinfo.part2[i].chn = i;
+				svinfo.part2[i].svid = 1 + rnd(32);
+				svinfo.part2[i].flags = rnd(2) | (rnd(8) ? 0 : (1 << 4));
+				svinfo.part2[i].cno = 20 + rnd(30);
+				svinfo.part2[i].elev = rnd(90);
+				svinfo.part2[i].azim = rnd(360);
+			}
+
+			if (!append_frame(s, UBX_CLASS_NAV, UBX_MESSAGE_NAV_SVINFO, &svinfo, sizeof(svinfo), corrupt)) {
+				satellites_used = 0;
+				satellite_prn = svinfo.part2[0].svid;
+
+				for (unsigned i = 0; i < SVINFO_CHANNELS; i++) {
+					if ((svinfo.part2[i].flags & ((1 << 4) | 1)) == 1)
+						satellites_used++;
+				}
+			}
+		}
+
+		gps_bin_nav_posllh_packet_t posllh;
+		memset(&posllh, 0, sizeof(posllh));
+		posllh.time_milliseconds = itow;
+		posllh.lat = 473977420 + (int32_t)rnd(100000);
+		posllh.lon = 85455940 + (int32_t)rnd(100000);
+		posllh.height_msl = 488000 + rnd(10000);
+		posllh.hAcc = 1000 + rnd(2000);
+		intact &= !append_frame(s, UBX_CLASS_NAV, UBX_MESSAGE_NAV_POSLLH, &posllh, sizeof(posllh) - 2, corrupt);
+
+		/* NAV-DOP, not handled by the driver */
+		uint8_t dop[18];
+		for (unsigned i = 0; i < sizeof(dop); i++)
+			dop[i] = rnd(256);
+		append_frame(s, UBX_CLASS_NAV, 0x04, dop, sizeof(dop), corrupt);
+
+		gps_bin_nav_velned_packet_t velned;
+		memset(&velned, 0, sizeof(velned));
+		velned.time_milliseconds = itow;
+		velned.velN = (int32_t)rnd(4000) - 2000;
+		velned.velE = (int32_t)rnd(4000) - 2000;
+		velned.speed = rnd(3000);
+		velned.heading = rnd(36000000);
+		intact &= !append_frame(s, UBX_CLASS_NAV, UBX_MESSAGE_NAV_VELNED, &velned, sizeof(velned) - 2, corrupt);
+
+		gps_bin_nav_sol_packet_t sol;
+		memset(&sol, 0, sizeof(sol));
+		sol.time_milliseconds = itow;
+		sol.gpsFix = 2 + rnd(2);
+		sol.pAcc = rnd(1000);
+		intact &= !append_frame(s, UBX_CLASS_NAV, UBX_MESSAGE_NAV_SOL, &sol, sizeof(sol) - 2, corrupt);
+
+		gps_bin_nav_timeutc_packet_t timeutc;
+		memset(&timeutc, 0, sizeof(timeutc));
+		timeutc.time_milliseconds = itow;
+		timeutc.year = 2013;
+		timeutc.month = 3;
+		timeutc.day = 1 + rnd(28);
+		timeutc.hour = rnd(24);
+		timeutc.min = rnd(60);
+		timeutc.sec = rnd(60);
+		append_frame(s, UBX_CLASS_NAV, UBX_MESSAGE_NAV_TIMEUTC, &timeutc, sizeof(timeutc) - 2, corrupt);
+
+		/* a late ACK-ACK, ignored outside of the configuration */
+		if ((e % 7) == 0) {
+			gps_bin_ack_ack_packet_t ack;
+			ack.clsID = UBX_CLASS_CFG;
+			ack.msgID = UBX_MESSAGE_CFG_MSG;
+			append_frame(s, UBX_CLASS_ACK, UBX_MESSAGE_ACK_ACK, &ack, sizeof(ack) - 2, corrupt);
+		}
+
+		append_garbage(s);
+
+		if (intact) {
+			struct expected *x = &s->epochs[s->num_epochs++];
+
+			x->lat = posllh.lat;
+			x->lon = posllh.lon;
+			x->vel_n_m_s = (float)velned.velN * 1e-2f;
+			x->fix_type = sol.gpsFix;
+			x->satellites_used = satellites_used;
+			x->satellite_prn = satellite_prn;
+		}
+	}
+
+	/* so that a frame with a corrupted length at the end does not wait forever */
+	memset(&s->data[s->length], '\n', RECV_BUFFER_SIZE);
+	s->length += RECV_BUFFER_SIZE;
+}
+
+/**
+ * Feed a stream to the driver and check what it reports.
+ *
+ * @param chunk		bytes per write, 0 for random pieces
+ * @return		number of errors
+ */
+static unsigned
+replay(const struct stream *s, unsigned chunk, const char *name)
+{
+	struct vehicle_gps_position_s report;
+	unsigned reported = 0;
+	unsigned errors = 0;
+	int fds[2];
+
+	if (pipe(fds) != 0) {
+		perror("pipe");
+		exit(1);
+	}
+
+	memset(&report, 0, sizeof(report));
+	fake_time = 1000000;
+
+	UBX ubx(fds[0], &report);
+
+	for (unsigned pos = 0; pos < s->length;) {
+		unsigned n = chunk ? chunk : 1 + rnd(300);
+
+		if (n > s->length - pos)
+			n = s->length - pos;
+
+		if (write(fds[1], &s->data[pos], n) != (ssize_t)n) {
+			perror("write");
+			exit(1);
+		}
+
+		pos += n;
+
+		/* 38400 baud */
+		fake_time += n * 260;
+
+		/* drain the pipe, the driver returns for every epoch */
+		while (ubx.receive(0) > 0) {
+			if (reported >= s->num_epochs) {
+				fprintf(stderr, "%s: epoch reported beyond the %u intact ones\n", name, s->num_epochs);
+				errors++;
+				continue;
+			}
+
+			const struct expected *x = &s->epochs[reported++];
+
+			if (report.lat != x->lat || report.lon != x->lon ||
+			    report.vel_n_m_s != x->vel_n_m_s || report.fix_type != x->fix_type ||
+			    report.satellites_visible != x->satellites_used ||
+			    report.satellite_prn[0] != x->satellite_prn) {
+				fprintf(stderr, "%s: report %u: lat %d lon %d vn %.2f fix %u sats %u prn %u, "
+					"expected lat %d lon %d vn %.2f fix %u sats %u prn %u\n",
+					name, reported - 1, report.lat, report.lon, (double)report.vel_n_m_s,
+					report.fix_type, report.satellites_visible, report.satellite_prn[0],
+					x->lat, x->lon, (double)x->vel_n_m_s, x->fix_type, x->satellites_used,
+					x->satellite_prn);
+				errors++;
+			}
+		}
+	}
+
+	if (reported != s->num_epochs) {
+		fprintf(stderr, "%s: %u of %u intact epochs reported\n", name, reported, s->num_epochs);
+		errors++;
+	}
+
+	if (checksum_errors->event_count != s->corrupted) {
+		fprintf(stderr, "%s: %llu checksum errors for %u corrupted frames\n",
+			name, (unsigned long long)checksum_errors->event_count, s->corrupted);
+		errors++;
+	}
+
+	printf("ubx: %-24s %u/%u epochs, %u corrupted frames, %.1f ns/byte parsing\n",
+	       name, reported, s->num_epochs, s->corrupted, parse_perf->elapsed / s->length);
+
+	close(fds[0]);
+	close(fds[1]);
+
+	return errors;
+}
+
+static unsigned
+check(void)
+{
+	static struct stream s;
+	unsigned errors = 0;
+
+	generate(&s, EPOCHS, false);
+	errors += replay(&s, 1, "clean, bytewise");
+	errors += replay(&s, 0, "clean, random pieces");
+	errors += replay(&s, PIPE_CHUNK, "clean, large writes");
+
+	generate(&s, EPOCHS, true);
+	errors += replay(&s, 1, "corrupted, bytewise");
+	errors += replay(&s, 0, "corrupted, random pieces");
+	errors += replay(&s, PIPE_CHUNK, "corrupted, large writes");
+
+	return errors;
+}
+
+/**
+ * Parse cost on large writes, which the driver takes in its own chunked
+ * reads; the pipe is not timed, only parse_buffer() is.
+ */
+static void
+bench(void)
+{
+	static struct stream s;
+	double elapsed;
+	uint64_t bytes;
+
+	for (unsigned corrupt = 0; corrupt < 2; corrupt++) {
+		generate(&s, BENCH_EPOCHS, corrupt);
+		elapsed = 0;
+		bytes = 0;
+
+		for (unsigned run = 0; run < BENCH_RUNS; run++) {
+			struct vehicle_gps_position_s report;
+			int fds[2];
+
+			if (pipe(fds) != 0) {
+				perror("pipe");
+				exit(1);
+			}
+
+			UBX ubx(fds[0], &report);
+
+			for (unsigned pos = 0; pos < s.length; pos += PIPE_CHUNK) {
+				unsigned n = (s.length - pos < PIPE_CHUNK) ? s.length - pos : PIPE_CHUNK;
+
+				if (write(fds[1], &s.data[pos], n) != (ssize_t)n) {
+					perror("write");
+					exit(1);
+				}
+
+				while (ubx.receive(0) > 0)
+					;
+			}
+
+			elapsed += parse_perf->elapsed;
+			bytes += s.length;
+
+			close(fds[0]);
+			close(fds[1]);
+		}
+
+		printf("ubx: %s stream, %.1f ns/byte, %.2f us/epoch\n", corrupt ? "corrupted" : "clean",
+		       elapsed / bytes, elapsed / ((double)BENCH_RUNS * BENCH_EPOCHS) / 1e3);
+	}
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: ubx_test [-b]\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	srandom(29);
+
+	if (argc == 2 && !strcmp(argv[1], "-b")) {
+		bench();
+		return 0;
+	}
+
+	if (argc != 1)
+		usage();
+
+	unsigned errors = check();
+
+	if (errors)
+		fprintf(stderr, "ubx: %u errors\n", errors);
+
+	return errors ? 1 : 0;
+}
@@ -40,68 +40,117 @@
  */
 
 #include <math.h>
+#include <string.h>
 
 #include "calibration_routines.h"
 
 
-int sphere_fit_least_squares(const float x[], const float y[], const float z[],
-			     unsigned int size, unsigned int max_iterations, float delta, float *sphere_x, float *sphere_y, float *sphere_z, float *sphere_radius)
+void sphere_fit_init(struct sphere_fit_state *state)
 {
+	memset(state, 0, sizeof(*state));
+}
 
-	float x_sumplain = 0.0f;
-	float x_sumsq = 0.0f;
-	float x_sumcube = 0.0f;
+/*
+ * Direction bins are the 24 quarters of the faces of a cube around the
+ * centre: the dominant axis and its sign pick the face, the signs of the
+ * other two axes the quarter.
+ */
+static unsigned int sphere_fit_bin(float dx, float dy, float dz)
+{
+	float ax = fabsf(dx);
+	float ay = fabsf(dy);
+	float az = fabsf(dz);
+	unsigned int face;
+	float u, v, w;
+
+	if (ax >= ay && ax >= az) {
+		face = 0;
+		w = dx;
+		u = dy;
+		v = dz;
+
+	} else if (ay >= az) {
+		face = 1;
+		w = dy;
+		u = dx;
+		v = dz;
+
+	} else {
+		face = 2;
+		w = dz;
+		u = dx;
+		v = dy;
+	}
 
-	float y_sumplain = 0.0f;
-	float y_sumsq = 0.0f;
-	float y_sumcube = 0.0f;
+	return (face * 8) + ((w < 0.0f) ? 4 : 0) + ((u < 0.0f) ? 2 : 0) + ((v < 0.0f) ? 1 : 0);
+}
 
-	float z_sumplain = 0.0f;
-	float z_sumsq = 0.0f;
-	float z_sumcube = 0.0f;
+void sphere_fit_add(struct sphere_fit_state *state, float x, float y, float z)
+{
+	float x2 = x * x;
+	float y2 = y * y;
+	float z2 = z * z;
+
+	state->count++;
 
-	float xy_sum = 0.0f;
-	float xz_sum = 0.0f;
-	float yz_sum = 0.0f;
+	state->x_sumplain += x;
+	state->x_sumsq += x2;
+	state->x_sumcube += x2 * x;
 
-	float x2y_sum = 0.0f;
-	float x2z_sum = 0.0f;
-	float y2x_sum = 0.0f;
-	float y2z_sum = 0.0f;
-	float z2x_sum = 0.0f;
-	float z2y_sum = 0.0f;
+	state->y_sumplain += y;
+	state->y_sumsq += y2;
+	state->y_sumcube += y2 * y;
 
-	for (unsigned int i = 0; i < size; i++) {
+	state->z_sumplain += z;
+	state->z_sumsq += z2;
+	state->z_sumcube += z2 * z;
 
-		float x2 = x[i] * x[i];
-		float y2 = y[i] * y[i];
-		float z2 = z[i] * z[i];
+	state->xy_sum += x * y;
+	state->xz_sum += x * z;
+	state->yz_sum += y * z;
 
-		x_sumplain += x[i];
-		x_sumsq += x2;
-		x_sumcube += x2 * x[i];
+	state->x2y_sum += x2 * y;
+	state->x2z_sum += x2 * z;
 
-		y_sumplain += y[i];
-		y_sumsq += y2;
-		y_sumcube += y2 * y[i];
+	state->y2x_sum += y2 * x;
+	state->y2z_sum += y2 * z;
 
-		z_sumplain += z[i];
-		z_sumsq += z2;
-		z_sumcube += z2 * z[i];
+	state->z2x_sum += z2 * x;
+	state->z2y_sum += z2 * y;
 
-		xy_sum += x[i] * y[i];
-		xz_sum += x[i] * z[i];
-		yz_sum += y[i] * z[i];
+	state->coverage |= (1UL << sphere_fit_bin(x - state->center[0], y - state->center[1], z - state->center[2]));
+}
 
-		x2y_sum += x2 * y[i];
-		x2z_sum += x2 * z[i];
+unsigned int sphere_fit_coverage(const struct sphere_fit_state *state)
+{
+	unsigned int bins = 0;
 
-		y2x_sum += y2 * x[i];
-		y2z_sum += y2 * z[i];
+	for (uint32_t c = state->coverage; c != 0; c &= c - 1)
+		bins++;
 
-		z2x_sum += z2 * x[i];
-		z2y_sum += z2 * y[i];
-	}
+	return bins;
+}
+
+int sphere_fit_least_squares(const float x[], const float y[], const float z[],
+			     unsigned int size, unsigned int max_iterations, float delta, float *sphere_x, float *sphere_y, float *sphere_z, float *sphere_radius)
+{
+	struct sphere_fit_state state;
+
+	sphere_fit_init(&state);
+
+	for (unsigned int i = 0; i < size; i++)
+		sphere_fit_add(&state, x[i], y[i], z[i]);
+
+	return sphere_fit_solve(&state, max_iterations, delta, sphere_x, sphere_y, sphere_z, sphere_radius);
+}
+
+int sphere_fit_solve(struct sphere_fit_state *state, unsigned int max_iterations, float delta,
+		     float *sphere_x, float *sphere_y, float *sphere_z, float *sphere_radius)
+{
+	unsigned int size = state->count;
+
+	if (size == 0)
+		return 1;
 
 	//
 	//Least Squares Fit a sphere A,B,C with radius squared Rsq to 3D data
@@ -121,25 +170,25 @@ int sphere_fit_least_squares(const float x[], const float y[], const float z[],
 	//
 	//This method should converge; maybe 5-100 iterations or more.
 	//
-	float x_sum = x_sumplain / size;        //sum( X[n] )
-	float x_sum2 = x_sumsq / size;    //sum( X[n]^2 )
-	float x_sum3 = x_sumcube / size;    //sum( X[n]^3 )
-	float y_sum = y_sumplain / size;        //sum( Y[n] )
-	float y_sum2 = y_sumsq / size;    //sum( Y[n]^2 )
-	float y_sum3 = y_sumcube / size;    //sum( Y[n]^3 )
-	float z_sum = z_sumplain / size;        //sum( Z[n] )
-	float z_sum2 = z_sumsq / size;    //sum( Z[n]^2 )
-	float z_sum3 = z_sumcube / size;    //sum( Z[n]^3 )
-
-	float XY = xy_sum / size;        //sum( X[n] * Y[n] )
-	float XZ = xz_sum / size;        //sum( X[n] * Z[n] )
-	float YZ = yz_sum / size;        //sum( Y[n] * Z[n] )
-	float X2Y = x2y_sum / size;    //sum( X[n]^2 * Y[n] )
-	float X2Z = x2z_sum / size;    //sum( X[n]^2 * Z[n] )
-	float Y2X = y2x_sum / size;    //sum( Y[n]^2 * X[n] )
-	float Y2Z = y2z_sum / size;    //sum( Y[n]^2 * Z[n] )
-	float Z2X = z2x_sum / size;    //sum( Z[n]^2 * X[n] )
-	float Z2Y = z2y_sum / size;    //sum( Z[n]^2 * Y[n] )
+	float x_sum = state->x_sumplain / size;        //sum( X[n] )
+	float x_sum2 = state->x_sumsq / size;    //sum( X[n]^2 )
+	float x_sum3 = state->x_sumcube / size;    //sum( X[n]^3 )
+	float y_sum = state->y_sumplain / size;        //sum( Y[n] )
+	float y_sum2 = state->y_sumsq / size;    //sum( Y[n]^2 )
+	float y_sum3 = state->y_sumcube / size;    //sum( Y[n]^3 )
+	float z_sum = state->z_sumplain / size;        //sum( Z[n] )
+	float z_sum2 = state->z_sumsq / size;    //sum( Z[n]^2 )
+	float z_sum3 = state->z_sumcube / size;    //sum( Z[n]^3 )
+
+	float XY = state->xy_sum / size;        //sum( X[n] * Y[n] )
+	float XZ = state->xz_sum / size;        //sum( X[n] * Z[n] )
+	float YZ = state->yz_sum / size;        //sum( Y[n] * Z[n] )
+	float X2Y = state->x2y_sum / size;    //sum( X[n]^2 * Y[n] )
+	float X2Z = state->x2z_sum / size;    //sum( X[n]^2 * Z[n] )
+	float Y2X = state->y2x_sum / size;    //sum( Y[n]^2 * X[n] )
+	float Y2Z = state->y2z_sum / size;    //sum( Y[n]^2 * Z[n] )
+	float Z2X = state->z2x_sum / size;    //sum( Z[n]^2 * X[n] )
+	float Z2Y = state->z2y_sum / size;    //sum( Z[n]^2 * Y[n] )
 
 	//Reduction of multiplications
 	float F0 = x_sum2 + y_sum2 + z_sum2;
@@ -215,5 +264,25 @@ int sphere_fit_least_squares(const float x[], const float y[], const float z[],
 	*sphere_z = C;
 	*sphere_radius = sqrtf(Rsq);
 
+	if (!isfinite(A) || !isfinite(B) || !isfinite(C) || !isfinite(*sphere_radius))
+		return 1;
+
+	/*
+	 * Track how far the estimate moved. Coverage is judged from the
+	 * centre, so once it has moved by a good part of the radius the
+	 * bins filled so far no longer mean much; start them again.
+	 */
+	dA = A - state->center[0];
+	dB = B - state->center[1];
+	dC = C - state->center[2];
+	state->change = sqrtf(dA * dA + dB * dB + dC * dC);
+
+	if (state->change > 0.1f * *sphere_radius)
+		state->coverage = 0;
+
+	state->center[0] = A;
+	state->center[1] = B;
+	state->center[2] = C;
+
 	return 0;
 }
@@ -39,6 +39,95 @@
  * @author Lorenz Meier <lm@inf.ethz.ch>
  */
 
+#include <stdint.h>
+
+/**
+ * Number of direction bins used to judge how well the samples cover the sphere.
+ */
+#define SPHERE_FIT_COVERAGE_BINS	24
+
+/**
+ * Running state of a streaming sphere fit.
+ *
+ * Holds only the sums the least-squares fit needs, so samples can be added
+ * one at a time and the fit solved whenever an estimate is wanted.
+ */
+struct sphere_fit_state {
+	unsigned int count;		/**< samples added */
+
+	float x_sumplain;
+	float x_sumsq;
+	float x_sumcube;
+
+	float y_sumplain;
+	float y_sumsq;
+	float y_sumcube;
+
+	float z_sumplain;
+	float z_sumsq;
+	float z_sumcube;
+
+	float xy_sum;
+	float xz_sum;
+	float yz_sum;
+
+	float x2y_sum;
+	float x2z_sum;
+	float y2x_sum;
+	float y2z_sum;
+	float z2x_sum;
+	float z2y_sum;
+
+	float center[3];		/**< centre from the last solve, used to bin sample directions */
+	uint32_t coverage;		/**< bitmap of direction bins that have seen a sample */
+	float change;			/**< distance the centre moved at the last solve */
+};
+
+/**
+ * Reset a streaming sphere fit.
+ *
+ * @param state fit state
+ */
+void sphere_fit_init(struct sphere_fit_state *state);
+
+/**
+ * Add a point to a streaming sphere fit.
+ *
+ * @param state fit state
+ * @param x point coordinate on the X axis
+ * @param y point coordinate on the Y axis
+ * @param z point coordinate on the Z axis
+ */
+void sphere_fit_add(struct sphere_fit_state *state, float x, float y, float z);
+
+/**
+ * Solve a streaming sphere fit for the points added so far.
+ *
+ * Gives the same result as sphere_fit_least_squares over the same points.
+ * Cost does not depend on the number of points, so this can be called as
+ * often as a fresh estimate is wanted. A successful solve also moves the
+ * centre used to judge coverage.
+ *
+ * @param state fit state
+ * @param max_iterations abort if maximum number of iterations have been reached. If unsure, set to 100.
+ * @param delta abort if error is below delta. If unsure, set to 0 to run max_iterations times.
+ * @param sphere_x coordinate of the sphere center on the X axis
+ * @param sphere_y coordinate of the sphere center on the Y axis
+ * @param sphere_z coordinate of the sphere center on the Z axis
+ * @param sphere_radius sphere radius
+ *
+ * @return 0 on success, 1 on failure
+ */
+int sphere_fit_solve(struct sphere_fit_state *state, unsigned int max_iterations, float delta,
+		     float *sphere_x, float *sphere_y, float *sphere_z, float *sphere_radius);
+
+/**
+ * Number of direction bins, out of SPHERE_FIT_COVERAGE_BINS, that have seen a sample.
+ *
+ * @param state fit state
+ */
+unsigned int sphere_fit_coverage(const struct sphere_fit_state *state);
+
 /**
  * Least-squares fit of a sphere to a set of points.
  *
@@ -58,4 +147,4 @@
  * @return 0 on success, 1 on failure
  */
 int sphere_fit_least_squares(const float x[], const float y[], const float z[],
-			     unsigned int size, unsigned int max_iterations, float delta, float *sphere_x, float *sphere_y, float *sphere_z, float *sphere_radius);
\ No newline at end of file
+			     unsigned int size, unsigned int max_iterations, float delta, float *sphere_x, float *sphere_y, float *sphere_z, float *sphere_radius);
@@ -50,6 +50,7 @@
 
 #include <nuttx/config.h>
 #include <pthread.h>
+#include <semaphore.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -121,6 +122,8 @@ extern struct system_load_s system_load;
 #define GPS_QUALITY_GOOD_HYSTERIS_TIME_MS 5000
 #define GPS_QUALITY_GOOD_COUNTER_LIMIT (GPS_QUALITY_GOOD_HYSTERIS_TIME_MS*COMMANDER_MONITORING_LOOPSPERMSEC)
 
+#define MAG_CAL_SETTLED 0.005f	/* mag offset change per second below which the calibration has settled, in Ga */
+
 /* File descriptors */
 static int leds;
 static int buzzer;
@@ -140,6 +143,37 @@ static int daemon_task;				/**< Handle of daemon task / thread */
 
 /* pthread loops */
 static void *orb_receive_loop(void *arg);
+static void *commander_low_prio_loop(void *arg);
+
+/*
+ * Jobs for the low priority worker. Calibrations and parameter storage
+ * take seconds; running them on the worker keeps the state machine,
+ * failsafe checks and status publication in the main loop going.
+ */
+#define LOW_PRIO_JOB_GYRO_CAL		(1 << 0)
+#define LOW_PRIO_JOB_MAG_CAL		(1 << 1)
+#define LOW_PRIO_JOB_TRIM_CAL		(1 << 2)
+#define LOW_PRIO_JOB_ACCEL_CAL		(1 << 3)
+#define LOW_PRIO_JOB_AIRSPEED_CAL	(1 << 4)
+#define LOW_PRIO_JOB_PARAM_LOAD		(1 << 5)
+#define LOW_PRIO_JOB_PARAM_SAVE		(1 << 6)
+
+#define LOW_PRIO_JOB_CALIBRATIONS	(LOW_PRIO_JOB_GYRO_CAL | LOW_PRIO_JOB_MAG_CAL | LOW_PRIO_JOB_TRIM_CAL | \
+					 LOW_PRIO_JOB_ACCEL_CAL | LOW_PRIO_JOB_AIRSPEED_CAL)
+
+struct low_prio_job {
+	unsigned	job;
+	const char	*name;
+	void		(*run)(int status_pub, struct vehicle_status_s *status);
+};
+
+static pthread_mutex_t commander_mutex;		/**< held by the main loop while it works on current_status */
+static sem_t low_prio_sem;			/**< posted when a job is queued */
+static unsigned low_prio_queued;		/**< jobs waiting to run, protected by commander_mutex */
+static unsigned low_prio_order[8];		/**< the same jobs in the order they were queued */
+static unsigned low_prio_order_count;
+static const struct low_prio_job *low_prio_running;	/**< job being run, if any */
+static unsigned loop_overruns;			/**< main loop iterations that missed their deadline */
 
 __EXPORT int commander_main(int argc, char *argv[]);
 
@@ -159,6 +193,12 @@ static void do_gyro_calibration(int status_pub, struct vehicle_status_s *status)
 static void do_mag_calibration(int status_pub, struct vehicle_status_s *status);
 static void do_rc_calibration(int status_pub, struct vehicle_status_s *status);
 static void do_accel_calibration(int status_pub, struct vehicle_status_s *status);
+static void do_airspeed_calibration(int status_pub, struct vehicle_status_s *status);
+static void do_param_load(int status_pub, struct vehicle_status_s *status);
+static void do_param_save(int status_pub, struct vehicle_status_s *status);
+static void calibration_progress(const char *name, unsigned done, unsigned total);
+static bool low_prio_queue(int status_pub, struct vehicle_status_s *status, unsigned job);
+static uint8_t calibration_request(int status_pub, struct vehicle_status_s *status, unsigned job);
 static void handle_command(int status_pub, struct vehicle_status_s *current_status, struct vehicle_command_s *cmd);
 
 int trigger_audio_alarm(uint8_t old_mode, uint8_t old_state, uint8_t new_mode, uint8_t new_state);
@@ -281,9 +321,26 @@ void tune_error(void)
 	ioctl(buzzer, TONE_SET_ALARM, 4);
 }
 
+/**
+ * Report calibration progress in steps of a quarter.
+ */
+static void calibration_progress(const char *name, unsigned done, unsigned total)
+{
+	if ((done % (total / 4)) == 0 && done < total) {
+		char buf[50];
+		sprintf(buf, "%s: %u%%", name, (done * 100) / total);
+		mavlink_log_info(mavlink_fd, buf);
+	}
+}
+
 void do_rc_calibration(int status_pub, struct vehicle_status_s *status)
 {
-	if (current_status.offboard_control_signal_lost) {
+	/* the main loop updates the signal state */
+	pthread_mutex_lock(&commander_mutex);
+	bool signal_lost = status->offboard_control_signal_lost;
+	pthread_mutex_unlock(&commander_mutex);
+
+	if (signal_lost) {
 		mavlink_log_critical(mavlink_fd, "TRIM CAL: ABORT. No RC signal.");
 		return;
 	}
@@ -315,10 +372,6 @@ void do_rc_calibration(int status_pub, struct vehicle_status_s *status)
 void do_mag_calibration(int status_pub, struct vehicle_status_s *status)
 {
 
-	/* set to mag calibration mode */
-	status->flag_preflight_mag_calibration = true;
-	state_machine_publish(status_pub, status, mavlink_fd);
-
 	int sub_mag = orb_subscribe(ORB_ID(sensor_mag));
 	struct mag_report mag;
 
@@ -375,16 +428,22 @@ void do_mag_calibration(int status_pub, struct vehicle_status_s *status)
 	const char axislabels[3] = { 'X', 'Y', 'Z'};
 	int axis_index = -1;
 
-	float *x = (float *)malloc(sizeof(float) * calibration_maxcount);
-	float *y = (float *)malloc(sizeof(float) * calibration_maxcount);
-	float *z = (float *)malloc(sizeof(float) * calibration_maxcount);
+	/*
+	 * The fit is updated with each sample, so there is nothing to store
+	 * and an estimate is always at hand; report progress once a second
+	 * and stop early once the samples cover the sphere and the offsets
+	 * have settled.
+	 */
+	struct sphere_fit_state fit;
+	sphere_fit_init(&fit);
+
+	uint64_t report_deadline = hrt_absolute_time() + 1000000;
+	unsigned settled_reports = 0;
 
-	if (x == NULL || y == NULL || z == NULL) {
-		warnx("mag cal failed: out of memory");
-		mavlink_log_info(mavlink_fd, "mag cal failed: out of memory");
-		warnx("x:%p y:%p z:%p\n", x, y, z);
-		return;
-	}
+	float sphere_x;
+	float sphere_y;
+	float sphere_z;
+	float sphere_radius;
 
 	tune_confirm();
 	sleep(2);
@@ -414,6 +473,33 @@ void do_mag_calibration(int status_pub, struct vehicle_status_s *status)
 			break;
 		}
 
+		/* progress report and convergence check */
+		if (hrt_absolute_time() >= report_deadline) {
+
+			report_deadline += 1000000;
+
+			if (sphere_fit_solve(&fit, 100, 0.0f, &sphere_x, &sphere_y, &sphere_z, &sphere_radius) == 0) {
+				unsigned coverage = sphere_fit_coverage(&fit);
+
+				char buf[50];
+				snprintf(buf, sizeof(buf), "mag cal: %u%% covered, moved %.3f Ga",
+					(coverage * 100) / SPHERE_FIT_COVERAGE_BINS, (double)fit.change);
+				mavlink_log_info(mavlink_fd, buf);
+
+				if ((coverage == SPHERE_FIT_COVERAGE_BINS) && (fit.change < MAG_CAL_SETTLED)) {
+					settled_reports++;
+
+				} else {
+					settled_reports = 0;
+				}
+
+				if (settled_reports >= 3) {
+					mavlink_log_info(mavlink_fd, "mag cal: offsets settled");
+					break;
+				}
+			}
+		}
+
 		// int axis_left = (int64_t)axis_deadline - (int64_t)hrt_absolute_time();
 
 		// if ((axis_left / 1000) == 0 && axis_left > 0) {
@@ -427,9 +513,7 @@ void do_mag_calibration(int status_pub, struct vehicle_status_s *status)
 		if (poll_ret) {
 			orb_copy(ORB_ID(sensor_mag), sub_mag, &mag);
 
-			x[calibration_counter] = mag.x;
-			y[calibration_counter] = mag.y;
-			z[calibration_counter] = mag.z;
+			sphere_fit_add(&fit, mag.x, mag.y, mag.z);
 
 			/* get min/max values */
 
@@ -463,18 +547,7 @@ void do_mag_calibration(int status_pub, struct vehicle_status_s *status)
 		}
 	}
 
-	float sphere_x;
-	float sphere_y;
-	float sphere_z;
-	float sphere_radius;
-
-	sphere_fit_least_squares(x, y, z, calibration_counter, 100, 0.0f, &sphere_x, &sphere_y, &sphere_z, &sphere_radius);
-
-	free(x);
-	free(y);
-	free(z);
-
-	if (isfinite(sphere_x) && isfinite(sphere_y) && isfinite(sphere_z)) {
+	if (sphere_fit_solve(&fit, 100, 0.0f, &sphere_x, &sphere_y, &sphere_z, &sphere_radius) == 0) {
 
 		fd = open(MAG_DEVICE_PATH, 0);
 
@@ -551,19 +624,11 @@ void do_mag_calibration(int status_pub, struct vehicle_status_s *status)
 		mavlink_log_info(mavlink_fd, "mag calibration FAILED (NaN in sphere fit)");
 	}
 
-	/* disable calibration mode */
-	status->flag_preflight_mag_calibration = false;
-	state_machine_publish(status_pub, status, mavlink_fd);
-
 	close(sub_mag);
 }
 
 void do_gyro_calibration(int status_pub, struct vehicle_status_s *status)
 {
-	/* set to gyro calibration mode */
-	status->flag_preflight_gyro_calibration = true;
-	state_machine_publish(status_pub, status, mavlink_fd);
-
 	const int calibration_count = 5000;
 
 	int sub_sensor_combined = orb_subscribe(ORB_ID(sensor_combined));
@@ -601,10 +666,12 @@ void do_gyro_calibration(int status_pub, struct vehicle_status_s *status)
 			gyro_offset[1] += raw.gyro_rad_s[1];
 			gyro_offset[2] += raw.gyro_rad_s[2];
 			calibration_counter++;
+			calibration_progress("gyro cal", calibration_counter, calibration_count);
 
 		} else if (poll_ret == 0) {
 			/* any poll failure for 1s is a reason to abort */
 			mavlink_log_info(mavlink_fd, "gyro calibration aborted, retry");
+			close(sub_sensor_combined);
 			return;
 		}
 	}
@@ -613,10 +680,6 @@ void do_gyro_calibration(int status_pub, struct vehicle_status_s *status)
 	gyro_offset[1] = gyro_offset[1] / calibration_count;
 	gyro_offset[2] = gyro_offset[2] / calibration_count;
 
-	/* exit gyro calibration mode */
-	status->flag_preflight_gyro_calibration = false;
-	state_machine_publish(status_pub, status, mavlink_fd);
-
 	if (isfinite(gyro_offset[0]) && isfinite(gyro_offset[1]) && isfinite(gyro_offset[2])) {
 
 		if (param_set(param_find("SENS_GYRO_XOFF"), &(gyro_offset[0]))
@@ -671,9 +734,6 @@ void do_accel_calibration(int status_pub, struct vehicle_status_s *status)
 	/* announce change */
 
 	mavlink_log_info(mavlink_fd, "keep it level and still");
-	/* set to accel calibration mode */
-	status->flag_preflight_accel_calibration = true;
-	state_machine_publish(status_pub, status, mavlink_fd);
 
 	const int calibration_count = 2500;
 
@@ -711,10 +771,12 @@ void do_accel_calibration(int status_pub, struct vehicle_status_s *status)
 			accel_offset[1] += raw.accelerometer_m_s2[1];
 			accel_offset[2] += raw.accelerometer_m_s2[2];
 			calibration_counter++;
+			calibration_progress("accel cal", calibration_counter, calibration_count);
 
 		} else if (poll_ret == 0) {
 			/* any poll failure for 1s is a reason to abort */
 			mavlink_log_info(mavlink_fd, "acceleration calibration aborted");
+			close(sub_sensor_combined);
 			return;
 		}
 	}
@@ -779,10 +841,6 @@ void do_accel_calibration(int status_pub, struct vehicle_status_s *status)
 		mavlink_log_info(mavlink_fd, "accel calibration FAILED (NaN)");
 	}
 
-	/* exit accel calibration mode */
-	status->flag_preflight_accel_calibration = false;
-	state_machine_publish(status_pub, status, mavlink_fd);
-
 	close(sub_sensor_combined);
 }
 
@@ -791,9 +849,6 @@ void do_airspeed_calibration(int status_pub, struct vehicle_status_s *status)
 	/* announce change */
 
 	mavlink_log_info(mavlink_fd, "keep it still");
-	/* set to accel calibration mode */
-	status->flag_preflight_airspeed_calibration = true;
-	state_machine_publish(status_pub, status, mavlink_fd);
 
 	const int calibration_count = 2500;
 
@@ -814,10 +869,12 @@ void do_airspeed_calibration(int status_pub, struct vehicle_status_s *status)
 			orb_copy(ORB_ID(differential_pressure), sub_differential_pressure, &differential_pressure);
 			airspeed_offset += differential_pressure.voltage;
 			calibration_counter++;
+			calibration_progress("airspeed cal", calibration_counter, calibration_count);
 
 		} else if (poll_ret == 0) {
 			/* any poll failure for 1s is a reason to abort */
 			mavlink_log_info(mavlink_fd, "airspeed calibration aborted");
+			close(sub_differential_pressure);
 			return;
 		}
 	}
@@ -852,15 +909,174 @@ void do_airspeed_calibration(int status_pub, struct vehicle_status_s *status)
 		mavlink_log_info(mavlink_fd, "airspeed calibration FAILED (NaN)");
 	}
 
-	/* exit airspeed calibration mode */
-	status->flag_preflight_airspeed_calibration = false;
-	state_machine_publish(status_pub, status, mavlink_fd);
-
 	close(sub_differential_pressure);
 }
 
 
 
+void do_param_load(int status_pub, struct vehicle_status_s *status)
+{
+	/* read all parameters from EEPROM to RAM */
+	int read_ret = param_load_default();
+
+	if (read_ret == OK) {
+		mavlink_log_info(mavlink_fd, "OK loading params from");
+		mavlink_log_info(mavlink_fd, param_get_default_file());
+
+	} else if (read_ret == 1) {
+		mavlink_log_info(mavlink_fd, "OK no changes in");
+		mavlink_log_info(mavlink_fd, param_get_default_file());
+
+	} else {
+		if (read_ret < -1) {
+			mavlink_log_info(mavlink_fd, "ERR loading params from");
+			mavlink_log_info(mavlink_fd, param_get_default_file());
+
+		} else {
+			mavlink_log_info(mavlink_fd, "ERR no param file named");
+			mavlink_log_info(mavlink_fd, param_get_default_file());
+		}
+
+		tune_error();
+	}
+}
+
+void do_param_save(int status_pub, struct vehicle_status_s *status)
+{
+	/* write all parameters from RAM to EEPROM */
+	int write_ret = param_save_default();
+
+	if (write_ret == OK) {
+		mavlink_log_info(mavlink_fd, "OK saved param file");
+		mavlink_log_info(mavlink_fd, param_get_default_file());
+
+	} else {
+		if (write_ret < -1) {
+			mavlink_log_info(mavlink_fd, "ERR params file does not exit:");
+			mavlink_log_info(mavlink_fd, param_get_default_file());
+
+		} else {
+			mavlink_log_info(mavlink_fd, "ERR writing params to");
+			mavlink_log_info(mavlink_fd, param_get_default_file());
+		}
+
+		tune_error();
+	}
+}
+
+static const struct low_prio_job low_prio_jobs[] = {
+	{ LOW_PRIO_JOB_GYRO_CAL,	"gyro cal",	do_gyro_calibration },
+	{ LOW_PRIO_JOB_MAG_CAL,		"mag cal",	do_mag_calibration },
+	{ LOW_PRIO_JOB_TRIM_CAL,	"trim cal",	do_rc_calibration },
+	{ LOW_PRIO_JOB_ACCEL_CAL,	"accel cal",	do_accel_calibration },
+	{ LOW_PRIO_JOB_AIRSPEED_CAL,	"airspeed cal",	do_airspeed_calibration },
+	{ LOW_PRIO_JOB_PARAM_LOAD,	"param load",	do_param_load },
+	{ LOW_PRIO_JOB_PARAM_SAVE,	"param save",	do_param_save },
+};
+
+static const struct low_prio_job *low_prio_job_lookup(unsigned job)
+{
+	for (unsigned i = 0; i < sizeof(low_prio_jobs) / sizeof(low_prio_jobs[0]); i++) {
+		if (low_prio_jobs[i].job == job)
+			return &low_prio_jobs[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Status flag announcing a calibration job, NULL for other jobs.
+ */
+static bool *low_prio_job_flag(struct vehicle_status_s *status, unsigned job)
+{
+	switch (job) {
+	case LOW_PRIO_JOB_GYRO_CAL:
+		return &status->flag_preflight_gyro_calibration;
+
+	case LOW_PRIO_JOB_MAG_CAL:
+		return &status->flag_preflight_mag_calibration;
+
+	case LOW_PRIO_JOB_ACCEL_CAL:
+		return &status->flag_preflight_accel_calibration;
+
+	case LOW_PRIO_JOB_AIRSPEED_CAL:
+		return &status->flag_preflight_airspeed_calibration;
+
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * Hand a job to the low priority worker.
+ *
+ * Must be called with commander_mutex held. The calibration flag is raised
+ * here rather than by the worker so that the main loop does not drop out of
+ * PREFLIGHT before the job got to run.
+ *
+ * @return false if the job is already queued or running
+ */
+bool low_prio_queue(int status_pub, struct vehicle_status_s *status, unsigned job)
+{
+	const struct low_prio_job *running = low_prio_running;
+
+	if ((low_prio_queued & job) || (running != NULL && running->job == job))
+		return false;
+
+	bool *flag = low_prio_job_flag(status, job);
+
+	if (flag != NULL) {
+		*flag = true;
+		state_machine_publish(status_pub, status, mavlink_fd);
+	}
+
+	low_prio_queued |= job;
+	low_prio_order[low_prio_order_count++] = job;
+	sem_post(&low_prio_sem);
+
+	return true;
+}
+
+/**
+ * True while a calibration job is queued or running.
+ *
+ * Must be called with commander_mutex held.
+ */
+static bool low_prio_calibrating(void)
+{
+	const struct low_prio_job *running = low_prio_running;
+
+	return (low_prio_queued & LOW_PRIO_JOB_CALIBRATIONS) ||
+	       (running != NULL && (running->job & LOW_PRIO_JOB_CALIBRATIONS));
+}
+
+/**
+ * Switch to PREFLIGHT and queue a calibration job.
+ */
+uint8_t calibration_request(int status_pub, struct vehicle_status_s *status, unsigned job)
+{
+	const struct low_prio_job *j = low_prio_job_lookup(job);
+
+	/* transition to calibration state */
+	do_state_update(status_pub, status, mavlink_fd, SYSTEM_STATE_PREFLIGHT);
+
+	if (status->state_machine != SYSTEM_STATE_PREFLIGHT) {
+		char buf[50];
+		snprintf(buf, sizeof(buf), "REJECTING %s", j->name);
+		mavlink_log_critical(mavlink_fd, buf);
+		return VEHICLE_CMD_RESULT_DENIED;
+	}
+
+	if (!low_prio_queue(status_pub, status, job)) {
+		char buf[50];
+		snprintf(buf, sizeof(buf), "%s already in progress", j->name);
+		mavlink_log_info(mavlink_fd, buf);
+		return VEHICLE_CMD_RESULT_TEMPORARILY_REJECTED;
+	}
+
+	return VEHICLE_CMD_RESULT_ACCEPTED;
+}
+
 void handle_command(int status_pub, struct vehicle_status_s *current_vehicle_status, struct vehicle_command_s *cmd)
 {
 	/* result of the command */
@@ -951,45 +1167,13 @@ void handle_command(int status_pub, struct vehicle_status_s *current_vehicle_sta
 
 			/* gyro calibration */
 			if ((int)(cmd->param1) == 1) {
-				/* transition to calibration state */
-				do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_PREFLIGHT);
-
-				if (current_status.state_machine == SYSTEM_STATE_PREFLIGHT) {
-					mavlink_log_info(mavlink_fd, "starting gyro cal");
-					tune_confirm();
-					do_gyro_calibration(status_pub, &current_status);
-					mavlink_log_info(mavlink_fd, "finished gyro cal");
-					tune_confirm();
-					do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_STANDBY);
-					result = VEHICLE_CMD_RESULT_ACCEPTED;
-
-				} else {
-					mavlink_log_critical(mavlink_fd, "REJECTING gyro cal");
-					result = VEHICLE_CMD_RESULT_DENIED;
-				}
-
+				result = calibration_request(status_pub, &current_status, LOW_PRIO_JOB_GYRO_CAL);
 				handled = true;
 			}
 
 			/* magnetometer calibration */
 			if ((int)(cmd->param2) == 1) {
-				/* transition to calibration state */
-				do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_PREFLIGHT);
-
-				if (current_status.state_machine == SYSTEM_STATE_PREFLIGHT) {
-					mavlink_log_info(mavlink_fd, "starting mag cal");
-					tune_confirm();
-					do_mag_calibration(status_pub, &current_status);
-					mavlink_log_info(mavlink_fd, "finished mag cal");
-					tune_confirm();
-					do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_STANDBY);
-					result = VEHICLE_CMD_RESULT_ACCEPTED;
-
-				} else {
-					mavlink_log_critical(mavlink_fd, "REJECTING mag cal");
-					result = VEHICLE_CMD_RESULT_DENIED;
-				}
-
+				result = calibration_request(status_pub, &current_status, LOW_PRIO_JOB_MAG_CAL);
 				handled = true;
 			}
 
@@ -1012,67 +1196,19 @@ void handle_command(int status_pub, struct vehicle_status_s *current_vehicle_sta
 
 			/* trim calibration */
 			if ((int)(cmd->param4) == 1) {
-				/* transition to calibration state */
-				do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_PREFLIGHT);
-
-				if (current_status.state_machine == SYSTEM_STATE_PREFLIGHT) {
-					mavlink_log_info(mavlink_fd, "starting trim cal");
-					tune_confirm();
-					do_rc_calibration(status_pub, &current_status);
-					mavlink_log_info(mavlink_fd, "finished trim cal");
-					tune_confirm();
-					do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_STANDBY);
-					result = VEHICLE_CMD_RESULT_ACCEPTED;
-
-				} else {
-					mavlink_log_critical(mavlink_fd, "REJECTING trim cal");
-					result = VEHICLE_CMD_RESULT_DENIED;
-				}
-
+				result = calibration_request(status_pub, &current_status, LOW_PRIO_JOB_TRIM_CAL);
 				handled = true;
 			}
 
 			/* accel calibration */
 			if ((int)(cmd->param5) == 1) {
-				/* transition to calibration state */
-				do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_PREFLIGHT);
-
-				if (current_status.state_machine == SYSTEM_STATE_PREFLIGHT) {
-					mavlink_log_info(mavlink_fd, "CMD starting accel cal");
-					tune_confirm();
-					do_accel_calibration(status_pub, &current_status);
-					tune_confirm();
-					mavlink_log_info(mavlink_fd, "CMD finished accel cal");
-					do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_STANDBY);
-					result = VEHICLE_CMD_RESULT_ACCEPTED;
-
-				} else {
-					mavlink_log_critical(mavlink_fd, "REJECTING accel cal");
-					result = VEHICLE_CMD_RESULT_DENIED;
-				}
-
+				result = calibration_request(status_pub, &current_status, LOW_PRIO_JOB_ACCEL_CAL);
 				handled = true;
 			}
 
 			/* airspeed calibration */
 			if ((int)(cmd->param6) == 1) { //xxx: this is not defined by the mavlink protocol
-				/* transition to calibration state */
-				do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_PREFLIGHT);
-
-				if (current_status.state_machine == SYSTEM_STATE_PREFLIGHT) {
-					mavlink_log_info(mavlink_fd, "CMD starting airspeed cal");
-					tune_confirm();
-					do_airspeed_calibration(status_pub, &current_status);
-					tune_confirm();
-					mavlink_log_info(mavlink_fd, "CMD finished airspeed cal");
-					do_state_update(status_pub, &current_status, mavlink_fd, SYSTEM_STATE_STANDBY);
-					result = VEHICLE_CMD_RESULT_ACCEPTED;
-
-				} else {
-					mavlink_log_critical(mavlink_fd, "REJECTING airspeed cal");
-					result = VEHICLE_CMD_RESULT_DENIED;
-				}
-
+				result = calibration_request(status_pub, &current_status, LOW_PRIO_JOB_AIRSPEED_CAL);
 				handled = true;
 			}
 
@@ -1091,70 +1227,30 @@ void handle_command(int status_pub, struct vehicle_status_s *current_vehicle_sta
 			     (current_status.system_type == VEHICLE_TYPE_HEXAROTOR) ||
 			     (current_status.system_type == VEHICLE_TYPE_OCTOROTOR))) {
 				/* do not perform expensive memory tasks on multirotors in flight */
-				// XXX this is over-safe, as soon as cmd is in low prio thread this can be allowed
 				mavlink_log_info(mavlink_fd, "REJECTING save cmd while multicopter armed");
+				result = VEHICLE_CMD_RESULT_DENIED;
 
-			} else {
-
-				// XXX move this to LOW PRIO THREAD of commander app
-				/* Read all parameters from EEPROM to RAM */
-
-				if (((int)(cmd->param1)) == 0)	{
-
-					/* read all parameters from EEPROM to RAM */
-					int read_ret = param_load_default();
-
-					if (read_ret == OK) {
-						//warnx("[mavlink pm] Loaded EEPROM params in RAM\n");
-						mavlink_log_info(mavlink_fd, "OK loading params from");
-						mavlink_log_info(mavlink_fd, param_get_default_file());
-						result = VEHICLE_CMD_RESULT_ACCEPTED;
-
-					} else if (read_ret == 1) {
-						mavlink_log_info(mavlink_fd, "OK no changes in");
-						mavlink_log_info(mavlink_fd, param_get_default_file());
-						result = VEHICLE_CMD_RESULT_ACCEPTED;
-
-					} else {
-						if (read_ret < -1) {
-							mavlink_log_info(mavlink_fd, "ERR loading params from");
-							mavlink_log_info(mavlink_fd, param_get_default_file());
-
-						} else {
-							mavlink_log_info(mavlink_fd, "ERR no param file named");
-							mavlink_log_info(mavlink_fd, param_get_default_file());
-						}
-
-						result = VEHICLE_CMD_RESULT_FAILED;
-					}
-
-				} else if (((int)(cmd->param1)) == 1)	{
-
-					/* write all parameters from RAM to EEPROM */
-					int write_ret = param_save_default();
-
-					if (write_ret == OK) {
-						mavlink_log_info(mavlink_fd, "OK saved param file");
-						mavlink_log_info(mavlink_fd, param_get_default_file());
-						result = VEHICLE_CMD_RESULT_ACCEPTED;
-
-					} else {
-						if (write_ret < -1) {
-							mavlink_log_info(mavlink_fd, "ERR params file does not exit:");
-							mavlink_log_info(mavlink_fd, param_get_default_file());
+			} else if (((int)(cmd->param1)) == 0) {
+				/* read all parameters from EEPROM to RAM */
+				if (low_prio_queue(status_pub, &current_status, LOW_PRIO_JOB_PARAM_LOAD)) {
+					result = VEHICLE_CMD_RESULT_ACCEPTED;
 
-						} else {
-							mavlink_log_info(mavlink_fd, "ERR writing params to");
-							mavlink_log_info(mavlink_fd, param_get_default_file());
-						}
+				} else {
+					result = VEHICLE_CMD_RESULT_TEMPORARILY_REJECTED;
+				}
 
-						result = VEHICLE_CMD_RESULT_FAILED;
-					}
+			} else if (((int)(cmd->param1)) == 1) {
+				/* write all parameters from RAM to EEPROM */
+				if (low_prio_queue(status_pub, &current_status, LOW_PRIO_JOB_PARAM_SAVE)) {
+					result = VEHICLE_CMD_RESULT_ACCEPTED;
 
 				} else {
-					mavlink_log_info(mavlink_fd, "[pm] refusing unsupp. STOR request");
-					result = VEHICLE_CMD_RESULT_UNSUPPORTED;
+					result = VEHICLE_CMD_RESULT_TEMPORARILY_REJECTED;
 				}
+
+			} else {
+				mavlink_log_info(mavlink_fd, "[pm] refusing unsupp. STOR request");
+				result = VEHICLE_CMD_RESULT_UNSUPPORTED;
 			}
 		}
 		break;
@@ -1208,6 +1304,8 @@ static void *orb_receive_loop(void *arg)  //handles status information coming fr
 
 			warnx("Subsys changed: %d\n", (int)info.subsystem_type);
 
+			pthread_mutex_lock(&commander_mutex);
+
 			/* mark / unmark as present */
 			if (info.present) {
 				vstatus->onboard_control_sensors_present |= info.subsystem_type;
@@ -1231,6 +1329,8 @@ static void *orb_receive_loop(void *arg)  //handles status information coming fr
 			} else {
 				vstatus->onboard_control_sensors_health &= ~info.subsystem_type;
 			}
+
+			pthread_mutex_unlock(&commander_mutex);
 		}
 	}
 
@@ -1239,6 +1339,62 @@ static void *orb_receive_loop(void *arg)  //handles status information coming fr
 	return NULL;
 }
 
+static void *commander_low_prio_loop(void *arg)
+{
+	/* Set thread name */
+	prctl(PR_SET_NAME, "commander low prio", getpid());
+
+	struct vehicle_status_s *status = (struct vehicle_status_s *)arg;
+
+	while (!thread_should_exit) {
+		sem_wait(&low_prio_sem);
+
+		/* take the oldest job */
+		pthread_mutex_lock(&commander_mutex);
+		const struct low_prio_job *job = NULL;
+
+		if (low_prio_order_count > 0) {
+			job = low_prio_job_lookup(low_prio_order[0]);
+			low_prio_queued &= ~low_prio_order[0];
+			low_prio_order_count--;
+			memmove(&low_prio_order[0], &low_prio_order[1], low_prio_order_count * sizeof(low_prio_order[0]));
+		}
+
+		low_prio_running = job;
+		pthread_mutex_unlock(&commander_mutex);
+
+		if (job == NULL)
+			continue;
+
+		char buf[50];
+		snprintf(buf, sizeof(buf), "starting %s", job->name);
+		mavlink_log_info(mavlink_fd, buf);
+		tune_confirm();
+
+		uint64_t start = hrt_absolute_time();
+		job->run(stat_pub, status);
+
+		snprintf(buf, sizeof(buf), "finished %s (%us)", job->name, (unsigned)((hrt_absolute_time() - start) / 1000000));
+		mavlink_log_info(mavlink_fd, buf);
+		tune_confirm();
+
+		pthread_mutex_lock(&commander_mutex);
+		low_prio_running = NULL;
+
+		bool *flag = low_prio_job_flag(status, job->job);
+
+		if (flag != NULL) {
+			*flag = false;
+			state_machine_publish(stat_pub, status, mavlink_fd);
+		}
+
+		/* the main loop returns to STANDBY once no calibration is left */
+		pthread_mutex_unlock(&commander_mutex);
+	}
+
+	return NULL;
+}
+
 /*
  * Provides a coarse estimate of remaining battery power.
  *
@@ -1339,6 +1495,20 @@ int commander_main(int argc, char *argv[])
 		if (thread_running) {
 			warnx("\tcommander is running\n");
 
+			const struct low_prio_job *running = low_prio_running;
+			unsigned queued = 0;
+
+			for (unsigned i = 0; i < sizeof(low_prio_jobs) / sizeof(low_prio_jobs[0]); i++) {
+				if (low_prio_queued & low_prio_jobs[i].job)
+					queued++;
+			}
+
+			warnx("\tworker: %s, %u queued", (running != NULL) ? running->name : "idle", queued);
+
+			warnx("\tmain loop overruns: %u", loop_overruns);
+			warnx("\trecent state transitions:");
+			state_machine_trace_print();
+
 		} else {
 			warnx("\tcommander not started\n");
 		}
@@ -1356,6 +1526,13 @@ int commander_thread_main(int argc, char *argv[])
 	commander_initialized = false;
 	bool home_position_set = false;
 
+	pthread_mutex_init(&commander_mutex, NULL);
+	sem_init(&low_prio_sem, 0, 0);
+	low_prio_queued = 0;
+	low_prio_order_count = 0;
+	low_prio_running = NULL;
+	loop_overruns = 0;
+
 	/* set parameters */
 	failsafe_lowlevel_timeout_ms = 0;
 	param_get(param_find("SYS_FAILSAVE_LL"), &failsafe_lowlevel_timeout_ms);
@@ -1370,6 +1547,7 @@ int commander_thread_main(int argc, char *argv[])
 	/* pthreads for command and subsystem info handling */
 	// pthread_t command_handling_thread;
 	pthread_t subsystem_info_thread;
+	pthread_t low_prio_thread;
 
 	/* initialize */
 	if (led_init() != 0) {
@@ -1427,6 +1605,16 @@ int commander_thread_main(int argc, char *argv[])
 	pthread_attr_setstacksize(&subsystem_info_attr, 2048);
 	pthread_create(&subsystem_info_thread, &subsystem_info_attr, orb_receive_loop, &current_status);
 
+	/* calibrations and parameter storage run at low priority */
+	pthread_attr_t low_prio_attr;
+	pthread_attr_init(&low_prio_attr);
+	pthread_attr_setstacksize(&low_prio_attr, 3000);
+
+	struct sched_param low_prio_param;
+	low_prio_param.sched_priority = SCHED_PRIORITY_DEFAULT;
+	pthread_attr_setschedparam(&low_prio_attr, &low_prio_param);
+	pthread_create(&low_prio_thread, &low_prio_attr, commander_low_prio_loop, &current_status);
+
 	/* Start monitoring loop */
 	uint16_t counter = 0;
 	uint8_t flight_env;
@@ -1513,8 +1701,13 @@ int commander_thread_main(int argc, char *argv[])
 	bool state_changed = true;
 	bool param_init_forced = true;
 
+	/* run the loop on a fixed deadline, whatever the loop body costs */
+	uint64_t next_loop = hrt_absolute_time();
+
 	while (!thread_should_exit) {
 
+		pthread_mutex_lock(&commander_mutex);
+
 		/* Get current values */
 		bool new_data;
 		orb_check(sp_man_sub, &new_data);
@@ -2139,7 +2332,8 @@ int commander_thread_main(int argc, char *argv[])
 		if (current_status.state_machine == SYSTEM_STATE_PREFLIGHT &&
 		    current_status.flag_preflight_gyro_calibration == false &&
 		    current_status.flag_preflight_mag_calibration == false &&
-		    current_status.flag_preflight_accel_calibration == false) {
+		    current_status.flag_preflight_accel_calibration == false &&
+		    !low_prio_calibrating()) {
 			/* All ok, no calibration going on, go to standby */
 			do_state_update(stat_pub, &current_status, mavlink_fd, SYSTEM_STATE_STANDBY);
 		}
@@ -2154,14 +2348,33 @@ int commander_thread_main(int argc, char *argv[])
 		/* Store old modes to detect and act on state transitions */
 		voltage_previous = current_status.voltage_battery;
 
+		pthread_mutex_unlock(&commander_mutex);
+
 		fflush(stdout);
 		counter++;
-		usleep(COMMANDER_MONITORING_INTERVAL);
+
+		next_loop += COMMANDER_MONITORING_INTERVAL;
+		uint64_t now = hrt_absolute_time();
+
+		if (now < next_loop) {
+			usleep(next_loop - now);
+
+		} else {
+			/* missed the deadline, do not try to catch up */
+			loop_overruns++;
+			next_loop = now;
+		}
 	}
 
+	/* wake up the worker so it sees the exit flag */
+	sem_post(&low_prio_sem);
+
 	/* wait for threads to complete */
 	// pthread_join(command_handling_thread, NULL);
 	pthread_join(subsystem_info_thread, NULL);
+	pthread_join(low_prio_thread, NULL);
+	sem_destroy(&low_prio_sem);
+	pthread_mutex_destroy(&commander_mutex);
 
 	/* close fds */
 	led_deinit();
@@ -45,11 +45,17 @@
 #include <uORB/topics/vehicle_status.h>
 #include <uORB/topics/actuator_controls.h>
 #include <systemlib/systemlib.h>
+#include <systemlib/err.h>
 #include <drivers/drv_hrt.h>
 #include <mavlink/mavlink_log.h>
 
+#include "commander.h"
 #include "state_machine_helper.h"
 
+#define SM_STATE_COUNT	(SYSTEM_STATE_REBOOT + 1)
+#define SM_FROM(state)	(1 << (state))
+#define SM_FROM_ANY	((1 << SM_STATE_COUNT) - 1)
+
 static const char *system_state_txt[] = {
 	"SYSTEM_STATE_PREFLIGHT",
 	"SYSTEM_STATE_STANDBY",
@@ -65,155 +71,139 @@ static const char *system_state_txt[] = {
 
 };
 
+static const char *event_txt[] = {
+	"DIRECT",
+	"POSITION_FIX",
+	"POSITION_FIX_LOST",
+	"EMERGENCY",
+	"ARM",
+	"DISARM",
+	"MODE_MANUAL",
+	"MODE_STABILIZED",
+	"MODE_GUIDED",
+	"MODE_AUTO",
+	"CMD_ARM",
+	"CMD_DISARM",
+};
+
 /**
- * Transition from one state to another
+ * What it takes to enter a state, and what entering it implies.
  */
-int do_state_update(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd, commander_state_machine_t new_state)
-{
-	int invalid_state = false;
-	int ret = ERROR;
-
-	commander_state_machine_t old_state = current_status->state_machine;
-
-	switch (new_state) {
-	case SYSTEM_STATE_MISSION_ABORT: {
-			/* Indoor or outdoor */
-			// if (flight_environment_parameter == PX4_FLIGHT_ENVIRONMENT_OUTDOOR) {
-			ret = do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_EMCY_LANDING);
-
-			// } else {
-			// 	ret = do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_EMCY_CUTOFF);
-			// }
-		}
-		break;
-
-	case SYSTEM_STATE_EMCY_LANDING:
-		/* Tell the controller to land */
-
-		/* set system flags according to state */
-		current_status->flag_system_armed = true;
-
-		warnx("EMERGENCY LANDING!\n");
-		mavlink_log_critical(mavlink_fd, "EMERGENCY LANDING!");
-		break;
-
-	case SYSTEM_STATE_EMCY_CUTOFF:
-		/* Tell the controller to cutoff the motors (thrust = 0) */
-
-		/* set system flags according to state */
-		current_status->flag_system_armed = false;
-
-		warnx("EMERGENCY MOTOR CUTOFF!\n");
-		mavlink_log_critical(mavlink_fd, "EMERGENCY MOTOR CUTOFF!");
-		break;
-
-	case SYSTEM_STATE_GROUND_ERROR:
-
-		/* set system flags according to state */
-
-		/* prevent actuators from arming */
-		current_status->flag_system_armed = false;
-
-		warnx("GROUND ERROR, locking down propulsion system\n");
-		mavlink_log_critical(mavlink_fd, "GROUND ERROR, locking down system");
-		break;
-
-	case SYSTEM_STATE_PREFLIGHT:
-		if (current_status->state_machine == SYSTEM_STATE_STANDBY
-		    || current_status->state_machine == SYSTEM_STATE_PREFLIGHT) {
-			/* set system flags according to state */
-			current_status->flag_system_armed = false;
-			mavlink_log_critical(mavlink_fd, "Switched to PREFLIGHT state");
-
-		} else {
-			invalid_state = true;
-			mavlink_log_critical(mavlink_fd, "REFUSED to switch to PREFLIGHT state");
-		}
-
-		break;
-
-	case SYSTEM_STATE_REBOOT:
-		if (current_status->state_machine == SYSTEM_STATE_STANDBY
-			|| current_status->state_machine == SYSTEM_STATE_PREFLIGHT
-			|| current_status->flag_hil_enabled) {
-			invalid_state = false;
-			/* set system flags according to state */
-			current_status->flag_system_armed = false;
-			mavlink_log_critical(mavlink_fd, "REBOOTING SYSTEM");
-			usleep(500000);
-			up_systemreset();
-			/* SPECIAL CASE: NEVER RETURNS FROM THIS FUNCTION CALL */
-
-		} else {
-			invalid_state = true;
-			mavlink_log_critical(mavlink_fd, "REFUSED to REBOOT");
-		}
-
-		break;
+struct state_entry_s {
+	uint16_t	from;		/**< states this state may be entered from */
+	bool		from_hil;	/**< may be entered from any state in HIL */
+	bool		armed;		/**< flag_system_armed in this state */
+	bool		warn;		/**< also report on the console */
+	const char	*msg;		/**< MAVLink status text */
+};
 
-	case SYSTEM_STATE_STANDBY:
-		/* set system flags according to state */
+static const struct state_entry_s state_entry[SM_STATE_COUNT] = {
+	[SYSTEM_STATE_PREFLIGHT]	= { SM_FROM(SYSTEM_STATE_STANDBY) | SM_FROM(SYSTEM_STATE_PREFLIGHT), false, false, false, "Switched to PREFLIGHT state" },
+	[SYSTEM_STATE_STANDBY]		= { SM_FROM_ANY, false, false, false, "Switched to STANDBY state" },
+	[SYSTEM_STATE_GROUND_READY]	= { SM_FROM_ANY, false, true,  false, "Switched to GROUND READY state" },
+	[SYSTEM_STATE_MANUAL]		= { SM_FROM_ANY, false, true,  false, "Switched to FLYING / MANUAL mode" },
+	[SYSTEM_STATE_STABILIZED]	= { SM_FROM_ANY, false, true,  false, "Switched to FLYING / STABILIZED mode" },
+	[SYSTEM_STATE_AUTO]		= { SM_FROM_ANY, false, true,  false, "Switched to FLYING / AUTO mode" },
+	[SYSTEM_STATE_MISSION_ABORT]	= { SM_FROM_ANY, false, true,  true,  "EMERGENCY LANDING!" },
+	[SYSTEM_STATE_EMCY_LANDING]	= { SM_FROM_ANY, false, true,  true,  "EMERGENCY LANDING!" },
+	[SYSTEM_STATE_EMCY_CUTOFF]	= { SM_FROM_ANY, false, false, true,  "EMERGENCY MOTOR CUTOFF!" },
+	[SYSTEM_STATE_GROUND_ERROR]	= { SM_FROM_ANY, false, false, true,  "GROUND ERROR, locking down system" },
+	[SYSTEM_STATE_REBOOT]		= { SM_FROM(SYSTEM_STATE_STANDBY) | SM_FROM(SYSTEM_STATE_PREFLIGHT), true, false, false, "REBOOTING SYSTEM" },
+};
 
-		/* standby enforces disarmed */
-		current_status->flag_system_armed = false;
+/* ring of the most recent transitions, for post-flight analysis */
+static struct state_machine_trace_s trace_buffer[STATE_MACHINE_TRACE_LENGTH];
+static unsigned trace_count;
 
-		mavlink_log_critical(mavlink_fd, "Switched to STANDBY state");
-		break;
+static void trace_record(state_machine_event_t event, commander_state_machine_t from, commander_state_machine_t to, bool accepted)
+{
+	struct state_machine_trace_s *t = &trace_buffer[trace_count % STATE_MACHINE_TRACE_LENGTH];
+
+	t->timestamp = hrt_absolute_time();
+	t->event = event;
+	t->from = from;
+	t->to = to;
+	t->accepted = accepted;
+	trace_count++;
+}
 
-	case SYSTEM_STATE_GROUND_READY:
+unsigned state_machine_trace_get(struct state_machine_trace_s *trace, unsigned max)
+{
+	unsigned count = (trace_count < STATE_MACHINE_TRACE_LENGTH) ? trace_count : STATE_MACHINE_TRACE_LENGTH;
 
-		/* set system flags according to state */
+	if (count > max)
+		count = max;
 
-		/* ground ready has motors / actuators armed */
-		current_status->flag_system_armed = true;
+	for (unsigned i = 0; i < count; i++)
+		trace[i] = trace_buffer[(trace_count - count + i) % STATE_MACHINE_TRACE_LENGTH];
 
-		mavlink_log_critical(mavlink_fd, "Switched to GROUND READY state");
-		break;
-
-	case SYSTEM_STATE_AUTO:
+	return count;
+}
 
-		/* set system flags according to state */
+void state_machine_trace_print(void)
+{
+	struct state_machine_trace_s trace[STATE_MACHINE_TRACE_LENGTH];
+	unsigned count = state_machine_trace_get(trace, STATE_MACHINE_TRACE_LENGTH);
+
+	for (unsigned i = 0; i < count; i++) {
+		printf("%10.3fs %-17s %s -> %s%s\n",
+		       (double)trace[i].timestamp / 1e6,
+		       event_txt[trace[i].event],
+		       system_state_txt[trace[i].from],
+		       system_state_txt[trace[i].to],
+		       trace[i].accepted ? "" : " (refused)");
+	}
+}
 
-		/* auto is airborne and in auto mode, motors armed */
-		current_status->flag_system_armed = true;
+/**
+ * Enter a state if the entry table allows it from the current one.
+ */
+static int state_enter(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd,
+		       commander_state_machine_t new_state, state_machine_event_t event)
+{
+	commander_state_machine_t old_state = current_status->state_machine;
 
-		mavlink_log_critical(mavlink_fd, "Switched to FLYING / AUTO mode");
-		break;
+	if ((unsigned)new_state >= SM_STATE_COUNT)
+		return ERROR;
 
-	case SYSTEM_STATE_STABILIZED:
+	const struct state_entry_s *entry = &state_entry[new_state];
 
-		/* set system flags according to state */
-		current_status->flag_system_armed = true;
+	if (!(entry->from & SM_FROM(old_state)) &&
+	    !(entry->from_hil && current_status->flag_hil_enabled)) {
+		trace_record(event, old_state, new_state, false);
+		mavlink_log_critical(mavlink_fd, "REJECTING invalid state transition");
+		return ERROR;
+	}
 
-		mavlink_log_critical(mavlink_fd, "Switched to FLYING / STABILIZED mode");
-		break;
+	trace_record(event, old_state, new_state, true);
 
-	case SYSTEM_STATE_MANUAL:
+	/* set system flags according to state */
+	current_status->flag_system_armed = entry->armed;
+	current_status->state_machine = new_state;
 
-		/* set system flags according to state */
-		current_status->flag_system_armed = true;
+	if (entry->warn)
+		warnx("%s", entry->msg);
 
-		mavlink_log_critical(mavlink_fd, "Switched to FLYING / MANUAL mode");
-		break;
+	mavlink_log_critical(mavlink_fd, entry->msg);
 
-	default:
-		invalid_state = true;
-		break;
-	}
+	state_machine_publish(status_pub, current_status, mavlink_fd);
+	publish_armed_status(current_status);
 
-	if (invalid_state == false || old_state != new_state) {
-		current_status->state_machine = new_state;
-		state_machine_publish(status_pub, current_status, mavlink_fd);
-		publish_armed_status(current_status);
-		ret = OK;
+	if (new_state == SYSTEM_STATE_REBOOT) {
+		usleep(500000);
+		up_systemreset();
+		/* SPECIAL CASE: NEVER RETURNS FROM THIS FUNCTION CALL */
 	}
 
-	if (invalid_state) {
-		mavlink_log_critical(mavlink_fd, "REJECTING invalid state transition");
-		ret = ERROR;
-	}
+	return OK;
+}
 
-	return ret;
+/**
+ * Transition from one state to another
+ */
+int do_state_update(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd, commander_state_machine_t new_state)
+{
+	return state_enter(status_pub, current_status, mavlink_fd, new_state, SM_EVENT_NONE);
 }
 
 void state_machine_publish(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
@@ -251,8 +241,16 @@ void publish_armed_status(const struct vehicle_status_s *current_status)
 	armed.armed = current_status->flag_system_armed;
 	/* lock down actuators if required, only in HIL */
 	armed.lockdown = (current_status->flag_hil_enabled) ? true : false;
-	orb_advert_t armed_pub = orb_advertise(ORB_ID(actuator_armed), &armed);
-	orb_publish(ORB_ID(actuator_armed), armed_pub, &armed);
+
+	/* advertise once, advertising does a topic lookup every time */
+	static orb_advert_t armed_pub = -1;
+
+	if (armed_pub < 0) {
+		armed_pub = orb_advertise(ORB_ID(actuator_armed), &armed);
+
+	} else {
+		orb_publish(ORB_ID(actuator_armed), armed_pub, &armed);
+	}
 }
 
 
@@ -263,18 +261,7 @@ void state_machine_emergency_always_critical(int status_pub, struct vehicle_stat
 {
 	warnx("EMERGENCY HANDLER\n");
 	/* Depending on the current state go to one of the error states */
-
-	if (current_status->state_machine == SYSTEM_STATE_PREFLIGHT || current_status->state_machine == SYSTEM_STATE_STANDBY || current_status->state_machine == SYSTEM_STATE_GROUND_READY) {
-		do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_GROUND_ERROR);
-
-	} else if (current_status->state_machine == SYSTEM_STATE_AUTO || current_status->state_machine == SYSTEM_STATE_MANUAL) {
-
-		// DO NOT abort mission
-		//do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_MISSION_ABORT);
-
-	} else {
-		warnx("Unknown system state: #%d\n", current_status->state_machine);
-	}
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_EMERGENCY);
 }
 
 void state_machine_emergency(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd) //do not call state_machine_emergency_always_critical if we are in manual mode for these errors
@@ -489,43 +476,41 @@ void state_machine_emergency(int status_pub, struct vehicle_status_s *current_st
 /* END SUBSYSTEM/EMERGENCY FUNCTIONS*/
 
 
-void update_state_machine_got_position_fix(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+/*
+ * Transition guards, reject an event before anything is changed
+ */
+static bool guard_mode_stabilized(const struct vehicle_status_s *current_status, const int mavlink_fd)
 {
-	/* Depending on the current state switch state */
-	if (current_status->state_machine == SYSTEM_STATE_PREFLIGHT) {
-		do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_STANDBY);
-	}
+	/* only switch if not already in attitude stabilized manual mode */
+	return current_status->flight_mode != VEHICLE_FLIGHT_MODE_MANUAL ||
+	       current_status->manual_control_mode != VEHICLE_MANUAL_CONTROL_MODE_SAS;
 }
 
-void update_state_machine_no_position_fix(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+static bool guard_mode_guided(const struct vehicle_status_s *current_status, const int mavlink_fd)
 {
-	/* Depending on the current state switch state */
-	if (current_status->state_machine == SYSTEM_STATE_STANDBY || current_status->state_machine == SYSTEM_STATE_GROUND_READY || current_status->state_machine == SYSTEM_STATE_AUTO) {
-		state_machine_emergency(status_pub, current_status, mavlink_fd);
+	if (!current_status->flag_vector_flight_mode_ok) {
+		mavlink_log_critical(mavlink_fd, "NO POS LOCK, REJ. GUIDED MODE");
+		tune_error();
+		return false;
 	}
-}
 
-void update_state_machine_arm(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
-{
-	if (current_status->state_machine == SYSTEM_STATE_STANDBY) {
-		printf("[cmd] arming\n");
-		do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_GROUND_READY);
-	}
+	return true;
 }
 
-void update_state_machine_disarm(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+static bool guard_mode_auto(const struct vehicle_status_s *current_status, const int mavlink_fd)
 {
-	if (current_status->state_machine == SYSTEM_STATE_GROUND_READY || current_status->state_machine == SYSTEM_STATE_MANUAL || current_status->state_machine == SYSTEM_STATE_PREFLIGHT) {
-		printf("[cmd] going standby\n");
-		do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_STANDBY);
-
-	} else if (current_status->state_machine == SYSTEM_STATE_STABILIZED || current_status->state_machine == SYSTEM_STATE_AUTO) {
-		printf("[cmd] MISSION ABORT!\n");
-		do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_STANDBY);
+	if (!current_status->flag_vector_flight_mode_ok) {
+		mavlink_log_critical(mavlink_fd, "NO POS LOCK, REJ. AUTO MODE");
+		return false;
 	}
+
+	return true;
 }
 
-void update_state_machine_mode_manual(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+/*
+ * Transition actions, return true if they changed what is published
+ */
+static bool action_mode_manual(struct vehicle_status_s *current_status)
 {
 	int old_mode = current_status->flight_mode;
 	current_status->flight_mode = VEHICLE_FLIGHT_MODE_MANUAL;
@@ -550,75 +535,196 @@ void update_state_machine_mode_manual(int status_pub, struct vehicle_status_s *c
 		current_status->flag_control_rates_enabled = false;
 	}
 
-	if (old_mode != current_status->flight_mode) state_machine_publish(status_pub, current_status, mavlink_fd);
+	return old_mode != current_status->flight_mode;
+}
 
-	if (current_status->state_machine == SYSTEM_STATE_GROUND_READY || current_status->state_machine == SYSTEM_STATE_STABILIZED || current_status->state_machine == SYSTEM_STATE_AUTO) {
-		printf("[cmd] manual mode\n");
-		do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_MANUAL);
-	}
+static bool action_mode_stabilized(struct vehicle_status_s *current_status)
+{
+	current_status->flight_mode = VEHICLE_FLIGHT_MODE_MANUAL;
+	current_status->manual_control_mode = VEHICLE_MANUAL_CONTROL_MODE_SAS;
+	current_status->flag_control_attitude_enabled = true;
+	current_status->flag_control_rates_enabled = true;
+	current_status->flag_control_manual_enabled = true;
+
+	return true;
 }
 
-void update_state_machine_mode_stabilized(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+static bool action_mode_guided(struct vehicle_status_s *current_status)
 {
-	if (current_status->state_machine == SYSTEM_STATE_GROUND_READY || current_status->state_machine == SYSTEM_STATE_STABILIZED || current_status->state_machine == SYSTEM_STATE_MANUAL || current_status->state_machine == SYSTEM_STATE_AUTO) {
-		int old_mode = current_status->flight_mode;
-		int old_manual_control_mode = current_status->manual_control_mode;
-		current_status->flight_mode = VEHICLE_FLIGHT_MODE_MANUAL;
-		current_status->manual_control_mode = VEHICLE_MANUAL_CONTROL_MODE_SAS;
-		current_status->flag_control_attitude_enabled = true;
-		current_status->flag_control_rates_enabled = true;
-		current_status->flag_control_manual_enabled = true;
+	int old_mode = current_status->flight_mode;
+	current_status->flight_mode = VEHICLE_FLIGHT_MODE_STAB;
+	current_status->flag_control_manual_enabled = false;
+	current_status->flag_control_attitude_enabled = true;
+	current_status->flag_control_rates_enabled = true;
 
-		if (old_mode != current_status->flight_mode ||
-		    old_manual_control_mode != current_status->manual_control_mode) {
-			printf("[cmd] att stabilized mode\n");
-			do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_MANUAL);
-			state_machine_publish(status_pub, current_status, mavlink_fd);
-		}
+	return old_mode != current_status->flight_mode;
+}
 
-	}
+static bool action_mode_auto(struct vehicle_status_s *current_status)
+{
+	int old_mode = current_status->flight_mode;
+	current_status->flight_mode = VEHICLE_FLIGHT_MODE_AUTO;
+	current_status->flag_control_manual_enabled = false;
+	current_status->flag_control_attitude_enabled = true;
+	current_status->flag_control_rates_enabled = true;
+
+	return old_mode != current_status->flight_mode;
 }
 
-void update_state_machine_mode_guided(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+/**
+ * Entry of the transition table.
+ *
+ * An all-zero entry ignores the event in that state.
+ */
+struct state_transition_s {
+	bool		(*guard)(const struct vehicle_status_s *current_status, const int mavlink_fd);
+	bool		(*action)(struct vehicle_status_s *current_status);
+	uint8_t		next;		/**< SM_TO(state) or SM_STAY */
+	const char	*msg;		/**< console message when taken */
+};
+
+#define SM_STAY		0
+#define SM_TO(state)	((state) + 1)
+
+#define SM_MODE_MANUAL_ONLY	{ .action = action_mode_manual }
+
+static const struct state_transition_s transitions[SM_STATE_COUNT][SM_EVENT_MAX] = {
+	[SYSTEM_STATE_PREFLIGHT] = {
+		[SM_EVENT_POSITION_FIX]		= { .next = SM_TO(SYSTEM_STATE_STANDBY) },
+		[SM_EVENT_EMERGENCY]		= { .next = SM_TO(SYSTEM_STATE_GROUND_ERROR) },
+		[SM_EVENT_DISARM]		= { .next = SM_TO(SYSTEM_STATE_STANDBY), .msg = "going standby" },
+		[SM_EVENT_MODE_MANUAL]		= SM_MODE_MANUAL_ONLY,
+		// XXX REMOVE arming from preflight
+		[SM_EVENT_CMD_ARM]		= { .next = SM_TO(SYSTEM_STATE_GROUND_READY), .msg = "arming due to command request" },
+	},
+	[SYSTEM_STATE_STANDBY] = {
+		[SM_EVENT_POSITION_FIX_LOST]	= { .next = SM_TO(SYSTEM_STATE_GROUND_ERROR) },
+		[SM_EVENT_EMERGENCY]		= { .next = SM_TO(SYSTEM_STATE_GROUND_ERROR) },
+		[SM_EVENT_ARM]			= { .next = SM_TO(SYSTEM_STATE_GROUND_READY), .msg = "arming" },
+		[SM_EVENT_MODE_MANUAL]		= SM_MODE_MANUAL_ONLY,
+		[SM_EVENT_CMD_ARM]		= { .next = SM_TO(SYSTEM_STATE_GROUND_READY), .msg = "arming due to command request" },
+	},
+	[SYSTEM_STATE_GROUND_READY] = {
+		[SM_EVENT_POSITION_FIX_LOST]	= { .next = SM_TO(SYSTEM_STATE_GROUND_ERROR) },
+		[SM_EVENT_EMERGENCY]		= { .next = SM_TO(SYSTEM_STATE_GROUND_ERROR) },
+		[SM_EVENT_DISARM]		= { .next = SM_TO(SYSTEM_STATE_STANDBY), .msg = "going standby" },
+		[SM_EVENT_MODE_MANUAL]		= { NULL, action_mode_manual, SM_TO(SYSTEM_STATE_MANUAL), "manual mode" },
+		[SM_EVENT_MODE_STABILIZED]	= { guard_mode_stabilized, action_mode_stabilized, SM_TO(SYSTEM_STATE_MANUAL), "att stabilized mode" },
+		[SM_EVENT_MODE_GUIDED]		= { guard_mode_guided, action_mode_guided, SM_TO(SYSTEM_STATE_STABILIZED), "position guided mode" },
+		[SM_EVENT_MODE_AUTO]		= { guard_mode_auto, action_mode_auto, SM_TO(SYSTEM_STATE_AUTO), "auto mode" },
+		[SM_EVENT_CMD_DISARM]		= { .next = SM_TO(SYSTEM_STATE_STANDBY), .msg = "disarming due to command request" },
+	},
+	[SYSTEM_STATE_MANUAL] = {
+		[SM_EVENT_DISARM]		= { .next = SM_TO(SYSTEM_STATE_STANDBY), .msg = "going standby" },
+		[SM_EVENT_MODE_MANUAL]		= SM_MODE_MANUAL_ONLY,
+		[SM_EVENT_MODE_STABILIZED]	= { guard_mode_stabilized, action_mode_stabilized, SM_TO(SYSTEM_STATE_MANUAL), "att stabilized mode" },
+		[SM_EVENT_MODE_GUIDED]		= { guard_mode_guided, action_mode_guided, SM_TO(SYSTEM_STATE_STABILIZED), "position guided mode" },
+		[SM_EVENT_MODE_AUTO]		= { guard_mode_auto, action_mode_auto, SM_TO(SYSTEM_STATE_AUTO), "auto mode" },
+	},
+	[SYSTEM_STATE_STABILIZED] = {
+		[SM_EVENT_DISARM]		= { .next = SM_TO(SYSTEM_STATE_STANDBY), .msg = "MISSION ABORT!" },
+		[SM_EVENT_MODE_MANUAL]		= { NULL, action_mode_manual, SM_TO(SYSTEM_STATE_MANUAL), "manual mode" },
+		[SM_EVENT_MODE_STABILIZED]	= { guard_mode_stabilized, action_mode_stabilized, SM_TO(SYSTEM_STATE_MANUAL), "att stabilized mode" },
+		[SM_EVENT_MODE_AUTO]		= { guard_mode_auto, action_mode_auto, SM_TO(SYSTEM_STATE_AUTO), "auto mode" },
+	},
+	[SYSTEM_STATE_AUTO] = {
+		[SM_EVENT_DISARM]		= { .next = SM_TO(SYSTEM_STATE_STANDBY), .msg = "MISSION ABORT!" },
+		[SM_EVENT_MODE_MANUAL]		= { NULL, action_mode_manual, SM_TO(SYSTEM_STATE_MANUAL), "manual mode" },
+		[SM_EVENT_MODE_STABILIZED]	= { guard_mode_stabilized, action_mode_stabilized, SM_TO(SYSTEM_STATE_MANUAL), "att stabilized mode" },
+		[SM_EVENT_MODE_GUIDED]		= { guard_mode_guided, action_mode_guided, SM_TO(SYSTEM_STATE_STABILIZED), "position guided mode" },
+	},
+	[SYSTEM_STATE_MISSION_ABORT] = {
+		[SM_EVENT_MODE_MANUAL]		= SM_MODE_MANUAL_ONLY,
+	},
+	[SYSTEM_STATE_EMCY_LANDING] = {
+		[SM_EVENT_MODE_MANUAL]		= SM_MODE_MANUAL_ONLY,
+	},
+	[SYSTEM_STATE_EMCY_CUTOFF] = {
+		[SM_EVENT_MODE_MANUAL]		= SM_MODE_MANUAL_ONLY,
+	},
+	[SYSTEM_STATE_GROUND_ERROR] = {
+		[SM_EVENT_MODE_MANUAL]		= SM_MODE_MANUAL_ONLY,
+	},
+	[SYSTEM_STATE_REBOOT] = {
+		[SM_EVENT_MODE_MANUAL]		= SM_MODE_MANUAL_ONLY,
+	},
+};
+
+int state_machine_dispatch(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd, state_machine_event_t event)
 {
-	if (!current_status->flag_vector_flight_mode_ok) {
-		mavlink_log_critical(mavlink_fd, "NO POS LOCK, REJ. GUIDED MODE");
-		tune_error();
-		return;
-	}
+	commander_state_machine_t state = current_status->state_machine;
 
-	if (current_status->state_machine == SYSTEM_STATE_GROUND_READY || current_status->state_machine == SYSTEM_STATE_MANUAL || current_status->state_machine == SYSTEM_STATE_AUTO) {
-		printf("[cmd] position guided mode\n");
-		int old_mode = current_status->flight_mode;
-		current_status->flight_mode = VEHICLE_FLIGHT_MODE_STAB;
-		current_status->flag_control_manual_enabled = false;
-		current_status->flag_control_attitude_enabled = true;
-		current_status->flag_control_rates_enabled = true;
-		do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_STABILIZED);
+	if ((unsigned)state >= SM_STATE_COUNT || event <= SM_EVENT_NONE || event >= SM_EVENT_MAX)
+		return ERROR;
+
+	const struct state_transition_s *t = &transitions[state][event];
 
-		if (old_mode != current_status->flight_mode) state_machine_publish(status_pub, current_status, mavlink_fd);
+	/* not handled in this state */
+	if (t->action == NULL && t->next == SM_STAY)
+		return ERROR;
 
+	if (t->guard != NULL && !t->guard(current_status, mavlink_fd)) {
+		trace_record(event, state, state, false);
+		return ERROR;
 	}
+
+	if (t->msg != NULL)
+		printf("[cmd] %s\n", t->msg);
+
+	bool changed = false;
+
+	if (t->action != NULL)
+		changed = t->action(current_status);
+
+	/* entering a state publishes the status, do not publish it twice */
+	if (t->next != SM_STAY &&
+	    state_enter(status_pub, current_status, mavlink_fd, (commander_state_machine_t)(t->next - 1), event) == OK)
+		return OK;
+
+	if (changed)
+		state_machine_publish(status_pub, current_status, mavlink_fd);
+
+	return (t->next == SM_STAY) ? OK : ERROR;
 }
 
-void update_state_machine_mode_auto(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+void update_state_machine_got_position_fix(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
 {
-	if (!current_status->flag_vector_flight_mode_ok) {
-		mavlink_log_critical(mavlink_fd, "NO POS LOCK, REJ. AUTO MODE");
-		return;
-	}
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_POSITION_FIX);
+}
 
-	if (current_status->state_machine == SYSTEM_STATE_GROUND_READY || current_status->state_machine == SYSTEM_STATE_MANUAL || current_status->state_machine == SYSTEM_STATE_STABILIZED) {
-		printf("[cmd] auto mode\n");
-		int old_mode = current_status->flight_mode;
-		current_status->flight_mode = VEHICLE_FLIGHT_MODE_AUTO;
-		current_status->flag_control_manual_enabled = false;
-		current_status->flag_control_attitude_enabled = true;
-		current_status->flag_control_rates_enabled = true;
-		do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_AUTO);
+void update_state_machine_no_position_fix(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+{
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_POSITION_FIX_LOST);
+}
 
-		if (old_mode != current_status->flight_mode) state_machine_publish(status_pub, current_status, mavlink_fd);
-	}
+void update_state_machine_arm(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+{
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_ARM);
+}
+
+void update_state_machine_disarm(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+{
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_DISARM);
+}
+
+void update_state_machine_mode_manual(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+{
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_MODE_MANUAL);
+}
+
+void update_state_machine_mode_stabilized(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+{
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_MODE_STABILIZED);
+}
+
+void update_state_machine_mode_guided(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+{
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_MODE_GUIDED);
+}
+
+void update_state_machine_mode_auto(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd)
+{
+	state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_MODE_AUTO);
 }
 
 
@@ -665,22 +771,15 @@ uint8_t update_state_machine_mode_request(int status_pub, struct vehicle_status_
 	/* vehicle is disarmed, mode requests arming */
 	if (!(current_status->flag_system_armed) && (mode & VEHICLE_MODE_FLAG_SAFETY_ARMED)) {
 		/* only arm in standby state */
-		// XXX REMOVE
-		if (current_status->state_machine == SYSTEM_STATE_STANDBY || current_status->state_machine == SYSTEM_STATE_PREFLIGHT) {
-			do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_GROUND_READY);
+		if (state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_CMD_ARM) == OK)
 			ret = OK;
-			printf("[cmd] arming due to command request\n");
-		}
 	}
 
 	/* vehicle is armed, mode requests disarming */
 	if (current_status->flag_system_armed && !(mode & VEHICLE_MODE_FLAG_SAFETY_ARMED)) {
 		/* only disarm in ground ready */
-		if (current_status->state_machine == SYSTEM_STATE_GROUND_READY) {
-			do_state_update(status_pub, current_status, mavlink_fd, (commander_state_machine_t)SYSTEM_STATE_STANDBY);
+		if (state_machine_dispatch(status_pub, current_status, mavlink_fd, SM_EVENT_CMD_DISARM) == OK)
 			ret = OK;
-			printf("[cmd] disarming due to command request\n");
-		}
 	}
 
 	/* NEVER actually switch off HIL without reboot */
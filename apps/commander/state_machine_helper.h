@@ -47,6 +47,42 @@
 #include <uORB/uORB.h>
 #include <uORB/topics/vehicle_status.h>
 
+/**
+ * Events driving the state machine.
+ *
+ * Each (state, event) pair maps to one entry of a constant transition
+ * table, see state_machine_dispatch().
+ */
+typedef enum {
+	SM_EVENT_NONE = 0,		/**< direct call to do_state_update() */
+	SM_EVENT_POSITION_FIX,		/**< position fix obtained */
+	SM_EVENT_POSITION_FIX_LOST,	/**< position fix lost */
+	SM_EVENT_EMERGENCY,		/**< emergency reported */
+	SM_EVENT_ARM,			/**< arming requested from the sticks */
+	SM_EVENT_DISARM,		/**< disarming requested from the sticks */
+	SM_EVENT_MODE_MANUAL,		/**< mode switch in manual */
+	SM_EVENT_MODE_STABILIZED,	/**< mode switch in stabilized */
+	SM_EVENT_MODE_GUIDED,		/**< mode switch in guided */
+	SM_EVENT_MODE_AUTO,		/**< mode switch in auto */
+	SM_EVENT_CMD_ARM,		/**< arming requested by command */
+	SM_EVENT_CMD_DISARM,		/**< disarming requested by command */
+
+	SM_EVENT_MAX
+} state_machine_event_t;
+
+/**
+ * One recorded state transition.
+ */
+struct state_machine_trace_s {
+	uint64_t	timestamp;	/**< time of the transition */
+	uint8_t		event;		/**< state_machine_event_t that caused it */
+	uint8_t		from;		/**< state before */
+	uint8_t		to;		/**< state requested */
+	bool		accepted;	/**< false if the transition was refused */
+};
+
+#define STATE_MACHINE_TRACE_LENGTH	16	/**< number of transitions kept */
+
 /**
  * Switch to new state with no checking.
  *
@@ -197,6 +233,37 @@ void state_machine_emergency_always_critical(int status_pub, struct vehicle_stat
  */
 void state_machine_emergency(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd);
 
+/**
+ * Feed an event to the state machine.
+ *
+ * Looks up the transition for the current state and the event, checks its
+ * guard, runs its action and enters the next state. The vehicle status is
+ * published at most once per event.
+ *
+ * @param status_pub file descriptor for state update topic publication
+ * @param current_status pointer to the current state machine to operate on
+ * @param mavlink_fd file descriptor for MAVLink statustext messages
+ * @param event the event
+ *
+ * @return OK if the event was handled in the current state, ERROR if it was ignored or refused
+ */
+int state_machine_dispatch(int status_pub, struct vehicle_status_s *current_status, const int mavlink_fd, state_machine_event_t event);
+
+/**
+ * Copy the most recent transitions.
+ *
+ * @param trace buffer to copy to, oldest transition first
+ * @param max size of the buffer
+ *
+ * @return number of transitions copied
+ */
+unsigned state_machine_trace_get(struct state_machine_trace_s *trace, unsigned max);
+
+/**
+ * Print the most recent transitions to the console.
+ */
+void state_machine_trace_print(void);
+
 /**
  * Publish the armed state depending on the current system state
  *
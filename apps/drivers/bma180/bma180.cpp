@@ -261,6 +261,8 @@ BMA180::BMA180(int bus, spi_dev_e device) :
 	_accel_scale.y_scale  = 1.0f;
 	_accel_scale.z_offset = 0;
 	_accel_scale.z_scale  = 1.0f;
+
+	memset(&_call, 0, sizeof(_call));
 }
 
 BMA180::~BMA180()
@@ -657,7 +659,7 @@ BMA180::start()
 	_oldest_report = _next_report = 0;
 
 	/* start polling at the specified rate */
-	hrt_call_every(&_call, 1000, _call_interval, (hrt_callout)&BMA180::measure_trampoline, this);
+	hrt_call_every_deferred(&_call, 1000, _call_interval, (hrt_callout)&BMA180::measure_trampoline, this);
 }
 
 void
@@ -758,6 +760,7 @@ BMA180::print_info()
 	perf_print_counter(_sample_perf);
 	printf("report queue:   %u (%u/%u @ %p)\n",
 	       _num_reports, _oldest_report, _next_report, _reports);
+	hrt_call_print_info(&_call, "poll call");
 }
 
 /**
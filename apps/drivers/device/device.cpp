@@ -43,6 +43,12 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#ifdef CONFIG_ARCH_CHIP_STM32
+# include <arch/stm32/chip.h>
+# include <stm32_internal.h>
+# include <stm32_gpio.h>
+#endif
+
 namespace device
 {
 
@@ -82,6 +88,43 @@ static void	unregister_interrupt(int irq);
  */
 static int	interrupt(int irq, void *context);
 
+#ifdef CONFIG_ARCH_CHIP_STM32
+
+static const unsigned	drdy_nlines = 16;		/**< number of EXTI lines */
+static Device		*drdy_owners[drdy_nlines];	/**< data-ready dispatch table, indexed by EXTI line */
+
+/**
+ * Handle a data-ready interrupt.
+ *
+ * The EXTI layer does not tell us which line fired for the shared
+ * EXTI9_5/EXTI15_10 vectors, so there is one instance of this per line.
+ *
+ * @param irq		The interrupt being invoked.
+ * @param context	The interrupt register context.
+ * @return		Always returns OK.
+ */
+template <unsigned _line>
+static int
+drdy_isr(int irq, void *context)
+{
+	/* take the timestamp before anything else */
+	hrt_abstime now = hrt_absolute_time();
+
+	if (drdy_owners[_line] != nullptr)
+		drdy_owners[_line]->drdy_interrupt(now);
+
+	return OK;
+}
+
+static const xcpt_t	drdy_handlers[drdy_nlines] = {
+	drdy_isr<0>,  drdy_isr<1>,  drdy_isr<2>,  drdy_isr<3>,
+	drdy_isr<4>,  drdy_isr<5>,  drdy_isr<6>,  drdy_isr<7>,
+	drdy_isr<8>,  drdy_isr<9>,  drdy_isr<10>, drdy_isr<11>,
+	drdy_isr<12>, drdy_isr<13>, drdy_isr<14>, drdy_isr<15>
+};
+
+#endif /* CONFIG_ARCH_CHIP_STM32 */
+
 Device::Device(const char *name,
 	       int irq) :
 	// public
@@ -90,7 +133,9 @@ Device::Device(const char *name,
 	_debug_enabled(false),
 	// private
 	_irq(irq),
-	_irq_attached(false)
+	_irq_attached(false),
+	_drdy_pinset(0),
+	_drdy_attached(false)
 {
 	sem_init(&_lock, 0, 1);
 }
@@ -101,6 +146,8 @@ Device::~Device()
 
 	if (_irq_attached)
 		unregister_interrupt(_irq);
+
+	drdy_detach();
 }
 
 int
@@ -147,6 +194,62 @@ Device::interrupt(void *context)
 	interrupt_disable();
 }
 
+void
+Device::drdy_interrupt(hrt_abstime timestamp)
+{
+	// default action is to ignore the signal
+}
+
+int
+Device::drdy_attach(uint32_t pinset, bool rising)
+{
+#ifdef CONFIG_ARCH_CHIP_STM32
+	unsigned line = (pinset & GPIO_PIN_MASK) >> GPIO_PIN_SHIFT;
+
+	if (!(pinset & GPIO_EXTI))
+		return -EINVAL;
+
+	if (_drdy_attached)
+		drdy_detach();
+
+	irqstate_t flags = irqsave();
+
+	if (drdy_owners[line] != nullptr) {
+		irqrestore(flags);
+		return -EBUSY;
+	}
+
+	drdy_owners[line] = this;
+	irqrestore(flags);
+
+	stm32_configgpio(pinset);
+	stm32_gpiosetevent(pinset, rising, !rising, false, drdy_handlers[line]);
+
+	_drdy_pinset = pinset;
+	_drdy_attached = true;
+
+	return OK;
+#else
+	return -ENOSYS;
+#endif
+}
+
+void
+Device::drdy_detach()
+{
+#ifdef CONFIG_ARCH_CHIP_STM32
+
+	if (!_drdy_attached)
+		return;
+
+	unsigned line = (_drdy_pinset & GPIO_PIN_MASK) >> GPIO_PIN_SHIFT;
+
+	stm32_gpiosetevent(_drdy_pinset, false, false, false, nullptr);
+	drdy_owners[line] = nullptr;
+	_drdy_attached = false;
+#endif
+}
+
 void
 Device::log(const char *fmt, ...)
 {
@@ -53,6 +53,8 @@
 
 #include <nuttx/fs/fs.h>
 
+#include <drivers/drv_hrt.h>
+
 /**
  * Namespace encapsulating all device framework classes, functions and data.
  */
@@ -73,6 +75,16 @@ public:
 	 */
 	virtual void	interrupt(void *ctx);	/**< interrupt handler */
 
+	/**
+	 * Data-ready interrupt handler.
+	 *
+	 * Called in interrupt context when the data-ready line attached
+	 * with drdy_attach() signals. The default implementation does nothing.
+	 *
+	 * @param timestamp	The time at which the interrupt was taken.
+	 */
+	virtual void	drdy_interrupt(hrt_abstime timestamp);
+
 protected:
 	const char	*_name;			/**< driver name */
 	bool		_debug_enabled;		/**< if true, debug messages are printed */
@@ -104,6 +116,26 @@ protected:
 	 */
 	void		interrupt_disable();
 
+	/**
+	 * Attach a data-ready interrupt.
+	 *
+	 * Configures the given GPIO as an external interrupt source and
+	 * routes edges on it to drdy_interrupt().  Only one device may own
+	 * any given EXTI line.
+	 *
+	 * @param pinset	GPIO configuration for the data-ready pin; must
+	 *			include GPIO_EXTI.
+	 * @param rising	If true, trigger on the rising edge, otherwise
+	 *			on the falling edge.
+	 * @return		OK if the interrupt was attached, -errno otherwise.
+	 */
+	int		drdy_attach(uint32_t pinset, bool rising = true);
+
+	/**
+	 * Detach a previously-attached data-ready interrupt.
+	 */
+	void		drdy_detach();
+
 	/**
 	 * Take the driver lock.
 	 *
@@ -141,6 +173,8 @@ protected:
 private:
 	int		_irq;
 	bool		_irq_attached;
+	uint32_t	_drdy_pinset;
+	bool		_drdy_attached;
 	sem_t		_lock;
 
 	/** disable copy construction for this and all subclasses */
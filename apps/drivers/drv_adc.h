@@ -47,6 +47,31 @@
 
 #define ADC_DEVICE_PATH		"/dev/adc0"
 
+/**
+ * Maximum number of channels in an ADC report.
+ */
+#define ADC_REPORT_MAX_CHANNELS	8
+
+/**
+ * Block of averaged ADC conversions.
+ *
+ * The driver scans its channel set continuously; each report is the
+ * average of a block of consecutive scans.  read() returns the same data
+ * as an array of struct adc_msg_s for compatibility.
+ */
+struct adc_report {
+	uint64_t	timestamp;				/**< time the last scan in the block completed */
+	uint32_t	block_count;				/**< number of blocks completed since the driver started */
+	uint16_t	scans;					/**< number of scans averaged into the report */
+	uint16_t	channel_count;				/**< number of valid entries in channel/data */
+	uint8_t		channel[ADC_REPORT_MAX_CHANNELS];	/**< ADC channel number */
+	uint16_t	data[ADC_REPORT_MAX_CHANNELS];		/**< averaged conversion result, 12 bits */
+};
+
 /*
  * ioctl definitions
  */
+#define _ADC_BASE		0x2c00
+
+/** Fetch the latest report into (struct adc_report *)arg */
+#define ADC_GET_REPORT		_IOC(_ADC_BASE, 0)
@@ -45,6 +45,10 @@
 #include <time.h>
 #include <queue.h>
 
+#ifdef CONFIG_SCHED_WORKQUEUE
+# include <nuttx/wqueue.h>
+#endif
+
 __BEGIN_DECLS
 
 /*
@@ -61,19 +65,53 @@ typedef uint64_t	hrt_abstime;
  * Note that callouts run in the timer interrupt context, so
  * they are serialised with respect to each other, and must not
  * block.
+ *
+ * Deferred callouts (see hrt_call_every_deferred) run on the high
+ * priority work queue instead; they are serialised with other work
+ * queue items and may block briefly, e.g. on a bus lock.
  */
 typedef void	(* hrt_callout)(void *arg);
 
+/*
+ * Callout flags.
+ */
+#define HRT_CALL_DEFERRED	(1 << 0)	/* run from the work queue, not the interrupt */
+#define HRT_CALL_QUEUED		(1 << 1)	/* deferred run is waiting on the work queue */
+
 /*
  * Callout record.
+ *
+ * Must be zeroed before it is first passed to one of the hrt_call_*
+ * functions.
  */
+struct hrt_queue;
+
 typedef struct hrt_call {
-	struct sq_entry_s	link;
+	/* callout queue links, see hrt_queue.c */
+	struct hrt_queue	*queue_owner;	/* queue the call is in, NULL if not queued */
+	struct hrt_call		*queue_child;	/* first child in the heap */
+	struct hrt_call		*queue_next;	/* next sibling */
+	struct hrt_call		*queue_prev;	/* previous sibling, or parent of the first child */
+	uint32_t		queue_seq;	/* insertion order, orders equal deadlines */
 
 	hrt_abstime		deadline;
 	hrt_abstime		period;
 	hrt_callout		callout;
 	void			*arg;
+	unsigned		flags;
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+	struct work_s		work;		/* work queue entry for deferred runs */
+	hrt_abstime		work_deadline;	/* deadline of the queued run */
+#endif
+
+	/* statistics, reset whenever the call is (re)scheduled */
+	uint32_t		runs;		/* number of times the callout ran */
+	uint32_t		overruns;	/* deferred runs dropped, previous one still queued */
+	uint32_t		run_time_max;	/* longest callout run time, us */
+	uint32_t		latency_max;	/* longest deadline to callout start, us */
+	uint64_t		run_time_total;	/* total callout run time, us */
+	uint64_t		latency_total;	/* total deadline to callout start, us */
 } *hrt_call_t;
 
 /*
@@ -128,6 +166,18 @@ __EXPORT extern void	hrt_call_at(struct hrt_call *entry, hrt_abstime calltime, h
  */
 __EXPORT extern void	hrt_call_every(struct hrt_call *entry, hrt_abstime delay, hrt_abstime interval, hrt_callout callout, void *arg);
 
+/*
+ * Call callout(arg) after delay, and then after every interval, from the
+ * high priority work queue rather than the timer interrupt.
+ *
+ * The interrupt only queues the work, so the time spent in it does not grow
+ * with the work done by the callout. If the previous run is still queued when
+ * the next one is due, the new run is dropped and counted as an overrun.
+ *
+ * Without CONFIG_SCHED_WORKQUEUE this is the same as hrt_call_every.
+ */
+__EXPORT extern void	hrt_call_every_deferred(struct hrt_call *entry, hrt_abstime delay, hrt_abstime interval, hrt_callout callout, void *arg);
+
 /*
  * If this returns true, the entry has been invoked and removed from the callout list,
  * or it has never been entered.
@@ -138,9 +188,22 @@ __EXPORT extern bool	hrt_called(struct hrt_call *entry);
 
 /*
  * Remove the entry from the callout list.
+ *
+ * A deferred run that is still queued is cancelled as well; one that has
+ * already started runs to completion.
  */
 __EXPORT extern void	hrt_cancel(struct hrt_call *entry);
 
+/*
+ * Print the run time and latency statistics for a callout.
+ */
+__EXPORT extern void	hrt_call_print_info(struct hrt_call *entry, const char *name);
+
+/*
+ * Print the HRT interrupt latency histogram and jitter.
+ */
+__EXPORT extern void	hrt_print_latency(void);
+
 /*
  * Initialise the HRT.
  */
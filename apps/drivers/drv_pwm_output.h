@@ -64,6 +64,15 @@ __BEGIN_DECLS
  */
 #define PWM_OUTPUT_MAX_CHANNELS	16
 
+/**
+ * Update rate that selects oneshot output.
+ *
+ * Rather than repeating at a fixed rate, a pulse is started as soon as
+ * new values have been set (see up_pwm_servo_trigger), so that ESCs
+ * that accept it see new outputs without waiting for the next frame.
+ */
+#define PWM_RATE_ONESHOT	0
+
 /**
  * Servo output signal type, value is actual servo output pulse
  * width in microseconds.
@@ -100,7 +109,7 @@ ORB_DECLARE(output_pwm);
 /** disarm all servo outputs (stop generating pulses) */
 #define PWM_SERVO_DISARM	_IOC(_PWM_SERVO_BASE, 1)
 
-/** set alternate servo update rate */
+/** set alternate servo update rate, or PWM_RATE_ONESHOT */
 #define PWM_SERVO_SET_UPDATE_RATE _IOC(_PWM_SERVO_BASE, 2)
 
 /** get the number of servos in *(unsigned *)arg */
@@ -176,7 +185,7 @@ __EXPORT extern uint32_t up_pwm_servo_get_rate_group(unsigned group);
  * Set the update rate for a given rate group.
  *
  * @param group		The rate group whose update rate will be changed.
- * @param rate		The update rate in Hz.
+ * @param rate		The update rate in Hz, or PWM_RATE_ONESHOT.
  * @return		OK if the group was adjusted, -ERANGE if an unsupported update rate is set.
  */
 __EXPORT extern int	up_pwm_servo_set_rate_group_update(unsigned group, unsigned rate);
@@ -198,4 +207,25 @@ __EXPORT extern int	up_pwm_servo_set(unsigned channel, servo_position_t value);
  */
 __EXPORT extern servo_position_t up_pwm_servo_get(unsigned channel);
 
+/**
+ * Start a pulse with the current output values on all oneshot rate groups.
+ *
+ * Call this once all channels have been set. A group whose previous
+ * pulse is still in progress is left alone; its new values go out with
+ * the next trigger. Rate groups at a fixed rate are not affected.
+ */
+__EXPORT extern void	up_pwm_servo_trigger(void);
+
+/**
+ * Get the time until the next pulse starts on a channel.
+ *
+ * A value set with up_pwm_servo_set first appears in this pulse.
+ *
+ * @param channel	The channel to query.
+ * @return		Microseconds until the next pulse starts, or zero
+ *			if the channel is not configured or is in oneshot
+ *			mode (the pulse starts with up_pwm_servo_trigger).
+ */
+__EXPORT extern unsigned up_pwm_servo_next_pulse(unsigned channel);
+
 __END_DECLS
@@ -40,6 +40,7 @@
 #include <poll.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 #include <assert.h>
 #include <systemlib/err.h>
 #include <uORB/uORB.h>
@@ -50,16 +51,43 @@
 
 #define UBX_CONFIG_TIMEOUT 100
 
+#define UBX_READ_CHUNK 128
+
+/*
+ * Message dispatch table, searched linearly; keep the high-rate
+ * messages at the front.
+ */
+const UBX::dispatch_entry UBX::_dispatch_table[] = {
+	{UBX_CLASS_NAV, UBX_MESSAGE_NAV_POSLLH,  sizeof(gps_bin_nav_posllh_packet_t) - 2,       &UBX::handle_nav_posllh},
+	{UBX_CLASS_NAV, UBX_MESSAGE_NAV_VELNED,  sizeof(gps_bin_nav_velned_packet_t) - 2,       &UBX::handle_nav_velned},
+	{UBX_CLASS_NAV, UBX_MESSAGE_NAV_SOL,     sizeof(gps_bin_nav_sol_packet_t) - 2,          &UBX::handle_nav_sol},
+	{UBX_CLASS_NAV, UBX_MESSAGE_NAV_TIMEUTC, sizeof(gps_bin_nav_timeutc_packet_t) - 2,      &UBX::handle_nav_timeutc},
+	{UBX_CLASS_NAV, UBX_MESSAGE_NAV_SVINFO,  sizeof(gps_bin_nav_svinfo_part1_packet_t),     &UBX::handle_nav_svinfo},
+	{UBX_CLASS_ACK, UBX_MESSAGE_ACK_ACK,     sizeof(gps_bin_ack_ack_packet_t) - 2,          &UBX::handle_ack_ack},
+	{UBX_CLASS_ACK, UBX_MESSAGE_ACK_NAK,     sizeof(gps_bin_ack_nak_packet_t) - 2,          &UBX::handle_ack_nak},
+};
+
 UBX::UBX(const int &fd, struct vehicle_gps_position_s *gps_position) :
 _fd(fd),
 _gps_position(gps_position),
-_waiting_for_ack(false)
+_waiting_for_ack(false),
+_rx_count(0),
+_parse_perf(perf_alloc(PC_ELAPSED, "ubx parse")),
+_checksum_errors(perf_alloc(PC_COUNT, "ubx checksum errors")),
+_rx_time(0),
+_baudrate(0),
+_epoch_valid(false),
+_epoch_itow(0),
+_epoch_parts(0),
+_time_offset_valid(false),
+_time_offset(0)
 {
-	decode_init();
 }
 
 UBX::~UBX()
 {
+	perf_free(_parse_perf);
+	perf_free(_checksum_errors);
 }
 
 int
@@ -122,7 +150,7 @@ UBX::configure(unsigned &baudrate)
 			baudrate = UBX_CFG_PRT_PAYLOAD_BAUDRATE;
 		}
 
-		/* send a CFT-RATE message to define update rate */
+		/* send a CFG-RATE message to define update rate */
 		type_gps_bin_cfg_rate_packet_t cfg_rate_packet;
 		memset(&cfg_rate_packet, 0, sizeof(cfg_rate_packet));
 
@@ -132,14 +160,20 @@ UBX::configure(unsigned &baudrate)
 		cfg_rate_packet.clsID		= UBX_CLASS_CFG;
 		cfg_rate_packet.msgID		= UBX_MESSAGE_CFG_RATE;
 		cfg_rate_packet.length		= UBX_CFG_RATE_LENGTH;
-		cfg_rate_packet.measRate	= UBX_CFG_RATE_PAYLOAD_MEASRATE;
+		cfg_rate_packet.measRate	= UBX_CFG_RATE_PAYLOAD_MEASRATE_FAST;
 		cfg_rate_packet.navRate		= UBX_CFG_RATE_PAYLOAD_NAVRATE;
 		cfg_rate_packet.timeRef		= UBX_CFG_RATE_PAYLOAD_TIMEREF;
 
 		send_config_packet(_fd, (uint8_t*)&cfg_rate_packet, sizeof(cfg_rate_packet));
 		if (receive(UBX_CONFIG_TIMEOUT) < 0) {
-			/* try next baudrate */
-			continue;
+			/* module does not do the fast rate, fall back to 5Hz */
+			cfg_rate_packet.measRate	= UBX_CFG_RATE_PAYLOAD_MEASRATE;
+
+			send_config_packet(_fd, (uint8_t*)&cfg_rate_packet, sizeof(cfg_rate_packet));
+			if (receive(UBX_CONFIG_TIMEOUT) < 0) {
+				/* try next baudrate */
+				continue;
+			}
 		}
 
 		/* send a NAV5 message to set the options for the internal filter */
@@ -171,7 +205,7 @@ UBX::configure(unsigned &baudrate)
 		cfg_msg_packet.clsID        = UBX_CLASS_CFG;
 		cfg_msg_packet.msgID        = UBX_MESSAGE_CFG_MSG;
 		cfg_msg_packet.length       = UBX_CFG_MSG_LENGTH;
-		/* Choose fast 5Hz rate for all messages except SVINFO which is big and not important */
+		/* Send every navigation solution for all messages except SVINFO which is big and not important */
 		cfg_msg_packet.rate[1]      = UBX_CFG_MSG_PAYLOAD_RATE1_5HZ;
 
 		cfg_msg_packet.msgClass_payload = UBX_CLASS_NAV;
@@ -203,6 +237,9 @@ UBX::configure(unsigned &baudrate)
 			continue;
 		}
 
+		/* back to every solution, SOL and VELNED complete the epoch together with POSLLH */
+		cfg_msg_packet.rate[1] = UBX_CFG_MSG_PAYLOAD_RATE1_5HZ;
+
 		cfg_msg_packet.msgClass_payload = UBX_CLASS_NAV;
 		cfg_msg_packet.msgID_payload = UBX_MESSAGE_NAV_SOL;
 
@@ -226,6 +263,10 @@ UBX::configure(unsigned &baudrate)
 //		cfg_msg_packet.msgClass_payload = UBX_CLASS_RXM;
 //		cfg_msg_packet.msgID_payload = UBX_MESSAGE_RXM_SVSI;
 
+		_baudrate = baudrate;
+		_epoch_valid = false;
+		_time_offset_valid = false;
+
 		_waiting_for_ack = false;
 		return 0;
 	}
@@ -240,36 +281,27 @@ UBX::receive(unsigned timeout)
 	fds[0].fd = _fd;
 	fds[0].events = POLLIN;
 
-	uint8_t buf[32];
-
 	/* timeout additional to poll */
 	uint64_t time_started = hrt_absolute_time();
 
-	int j = 0;
-	ssize_t count = 0;
-
 	while (true) {
 
-		/* pass received bytes to the packet decoder */
-		while (j < count) {
-			if (parse_char(buf[j]) > 0) {
-				/* return to configure during configuration or to the gps driver during normal work
-				 * if a packet has arrived */
-				 if (handle_message() > 0)
-					return 1;
-			}
-			/* in case we keep trying but only get crap from GPS */
-			if (time_started + timeout*1000 < hrt_absolute_time() ) {
-				return -1;
-			}
-			j++;
+		/* handle any complete frames already buffered before waiting for more */
+		int ret = parse_buffer();
+
+		if (ret != 0) {
+			/* return to configure during configuration or to the gps driver during normal work
+			 * if an epoch or the awaited ACK has arrived, or the module refused the configuration */
+			return ret;
 		}
 
-		/* everything is read */
-		j = count = 0;
+		/* in case we keep trying but only get crap from GPS */
+		if (time_started + timeout * 1000 < hrt_absolute_time()) {
+			return -1;
+		}
 
 		/* then poll for new data */
-		int ret = ::poll(fds, sizeof(fds) / sizeof(fds[0]), timeout);
+		ret = ::poll(fds, sizeof(fds) / sizeof(fds[0]), timeout);
 
 		if (ret < 0) {
 			/* something went wrong when polling */
@@ -284,432 +316,370 @@ UBX::receive(unsigned timeout)
 			if (fds[0].revents & POLLIN) {
 				/*
 				 * We are here because poll says there is some data, so this
-				 * won't block even on a blocking device.  If more bytes are
-				 * available, we'll go back to poll() again...
+				 * won't block even on a blocking device. Read straight into
+				 * the frame buffer behind whatever partial frame is left.
 				 */
-				count = ::read(_fd, buf, sizeof(buf));
+				size_t space = RECV_BUFFER_SIZE - _rx_count;
+
+				if (space > UBX_READ_CHUNK)
+					space = UBX_READ_CHUNK;
+
+				ssize_t count = ::read(_fd, &_rx_buffer[_rx_count], space);
+
+				if (count > 0) {
+					_rx_count += count;
+					_rx_time = hrt_absolute_time();
+				}
 			}
 		}
 	}
 }
 
 int
-UBX::parse_char(uint8_t b)
+UBX::parse_buffer()
 {
-	switch (_decode_state) {
-		/* First, look for sync1 */
-		case UBX_DECODE_UNINIT:
-			if (b == UBX_SYNC1) {
-				_decode_state = UBX_DECODE_GOT_SYNC1;
-			}
+	int ret = 0;
+	unsigned pos = 0;
+
+	perf_begin(_parse_perf);
+
+	while (pos < _rx_count) {
+
+		/* skip to the next candidate frame start */
+		const uint8_t *frame = (const uint8_t *)memchr(&_rx_buffer[pos], UBX_SYNC1, _rx_count - pos);
+
+		if (frame == nullptr) {
+			pos = _rx_count;
 			break;
-		/* Second, look for sync2 */
-		case UBX_DECODE_GOT_SYNC1:
-			if (b == UBX_SYNC2) {
-				_decode_state = UBX_DECODE_GOT_SYNC2;
-			} else {
-				/* Second start symbol was wrong, reset state machine */
-				decode_init();
-			}
+		}
+
+		pos = frame - _rx_buffer;
+		unsigned avail = _rx_count - pos;
+
+		/* wait for the header */
+		if (avail < 2)
 			break;
-		/* Now look for class */
-		case UBX_DECODE_GOT_SYNC2:
-			/* everything except sync1 and sync2 needs to be added to the checksum */
-			add_byte_to_checksum(b);
-			/* check for known class */
-			switch (b) {
-				case UBX_CLASS_ACK:
-					_decode_state = UBX_DECODE_GOT_CLASS;
-					_message_class = ACK;
-					break;
-
-				case UBX_CLASS_NAV:
-					_decode_state = UBX_DECODE_GOT_CLASS;
-					_message_class = NAV;
-					break;
-
-//				case UBX_CLASS_RXM:
-//					_decode_state = UBX_DECODE_GOT_CLASS;
-//					_message_class = RXM;
-//					break;
-
-				case UBX_CLASS_CFG:
-					_decode_state = UBX_DECODE_GOT_CLASS;
-					_message_class = CFG;
-					break;
-				default: //unknown class: reset state machine
-					decode_init();
-					break;
-			}
+
+		if (frame[1] != UBX_SYNC2) {
+			pos++;
+			continue;
+		}
+
+		if (avail < 6)
 			break;
-		case UBX_DECODE_GOT_CLASS:
-			add_byte_to_checksum(b);
-			switch (_message_class) {
-				case NAV:
-					switch (b) {
-					case UBX_MESSAGE_NAV_POSLLH:
-						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-						_message_id = NAV_POSLLH;
-						break;
-
-					case UBX_MESSAGE_NAV_SOL:
-						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-						_message_id = NAV_SOL;
-						break;
-
-					case UBX_MESSAGE_NAV_TIMEUTC:
-						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-						_message_id = NAV_TIMEUTC;
-						break;
-
-//					case UBX_MESSAGE_NAV_DOP:
-//						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-//						_message_id = NAV_DOP;
-//						break;
-
-					case UBX_MESSAGE_NAV_SVINFO:
-						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-						_message_id = NAV_SVINFO;
-						break;
-
-					case UBX_MESSAGE_NAV_VELNED:
-						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-						_message_id = NAV_VELNED;
-						break;
-
-					default: //unknown class: reset state machine, should not happen
-						decode_init();
-						break;
-					}
-					break;
-//				case RXM:
-//					switch (b) {
-//					case UBX_MESSAGE_RXM_SVSI:
-//						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-//						_message_id = RXM_SVSI;
-//						break;
-//
-//					default: //unknown class: reset state machine, should not happen
-//						decode_init();
-//						break;
-//					}
-//					break;
-
-				case CFG:
-					switch (b) {
-					case UBX_MESSAGE_CFG_NAV5:
-						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-						_message_id = CFG_NAV5;
-						break;
-
-					default: //unknown class: reset state machine, should not happen
-						decode_init();
-						break;
-					}
-					break;
-
-				case ACK:
-					switch (b) {
-					case UBX_MESSAGE_ACK_ACK:
-						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-						_message_id = ACK_ACK;
-						break;
-					case UBX_MESSAGE_ACK_NAK:
-						_decode_state = UBX_DECODE_GOT_MESSAGEID;
-						_message_id = ACK_NAK;
-						break;
-					default: //unknown class: reset state machine, should not happen
-						decode_init();
-						break;
-					}
-					break;
-				default: //should not happen because we set the class
-					warnx("UBX Error, we set a class that we don't know");
-					decode_init();
-//					config_needed = true;
-					break;
-				}
-				break;
-			case UBX_DECODE_GOT_MESSAGEID:
-				add_byte_to_checksum(b);
-				_payload_size = b; //this is the first length byte
-				_decode_state = UBX_DECODE_GOT_LENGTH1;
-				break;
-			case UBX_DECODE_GOT_LENGTH1:
-				add_byte_to_checksum(b);
-				_payload_size += b << 8; // here comes the second byte of length
-				_decode_state = UBX_DECODE_GOT_LENGTH2;
-				break;
-			case UBX_DECODE_GOT_LENGTH2:
-				/* Add to checksum if not yet at checksum byte */
-				if (_rx_count < _payload_size)
-					add_byte_to_checksum(b);
-					_rx_buffer[_rx_count] = b;
-					/* once the payload has arrived, we can process the information */
-					if (_rx_count >= _payload_size + 1) { //+1 because of 2 checksum bytes
-
-						/* compare checksum */
-						if (_rx_ck_a == _rx_buffer[_rx_count-1] && _rx_ck_b == _rx_buffer[_rx_count]) {
-							return 1;
-						} else {
-							decode_init();
-							return -1;
-							warnx("ubx: Checksum wrong");
-						}
-
-						return 1;
-					} else if (_rx_count < RECV_BUFFER_SIZE) {
-						_rx_count++;
-					} else {
-						warnx("ubx: buffer full");
-						decode_init();
-						return -1;
-					}
-				break;
-		default:
+
+		unsigned length = frame[4] | (frame[5] << 8);
+
+		/* a length we could never buffer means this was not a real frame start */
+		if (length > UBX_MAX_PAYLOAD_LENGTH) {
+			pos++;
+			continue;
+		}
+
+		/* wait for the rest of the frame */
+		if (avail < length + UBX_FRAME_OVERHEAD)
 			break;
-	}
-	return 0; //XXX ?
-}
 
+		/* checksum covers class, id, length and payload */
+		uint8_t ck_a = 0;
+		uint8_t ck_b = 0;
+		const uint8_t *p = &frame[2];
+		const uint8_t *end = &frame[6 + length];
 
-int
-UBX::handle_message()
-{
-	int ret = 0;
+		while (p < end) {
+			ck_a += *p++;
+			ck_b += ck_a;
+		}
 
-	switch (_message_id) { //this enum is unique for all ids --> no need to check the class
-		case NAV_POSLLH: {
-//			printf("GOT NAV_POSLLH MESSAGE\n");
-			if (!_waiting_for_ack) {
-				gps_bin_nav_posllh_packet_t *packet = (gps_bin_nav_posllh_packet_t *) _rx_buffer;
+		if (ck_a != end[0] || ck_b != end[1]) {
+			/* resynchronise on the next sync byte */
+			perf_count(_checksum_errors);
+			pos++;
+			continue;
+		}
 
-				_gps_position->lat = packet->lat;
-				_gps_position->lon = packet->lon;
-				_gps_position->alt = packet->height_msl;
+		pos += length + UBX_FRAME_OVERHEAD;
 
-				_gps_position->eph_m = (float)packet->hAcc * 1e-3f; // from mm to m
-				_gps_position->epv_m = (float)packet->vAcc * 1e-3f; // from mm to m
+		ret = dispatch(frame[2], frame[3], &frame[6], length);
 
-				/* Add timestamp to finish the report */
-				_gps_position->timestamp_position = hrt_absolute_time();
-				/* only return 1 when new position is available */
-				ret = 1;
-			}
+		if (ret != 0)
 			break;
-		}
+	}
+
+	/* drop consumed bytes, keeping any partial frame at the front */
+	if (pos > 0) {
+		_rx_count -= pos;
+		memmove(&_rx_buffer[0], &_rx_buffer[pos], _rx_count);
+	}
+
+	perf_end(_parse_perf);
+
+	return ret;
+}
 
-		case NAV_SOL: {
-//			printf("GOT NAV_SOL MESSAGE\n");
-			if (!_waiting_for_ack) {
-				gps_bin_nav_sol_packet_t *packet = (gps_bin_nav_sol_packet_t *) _rx_buffer;
+int
+UBX::dispatch(uint8_t clsID, uint8_t msgID, const uint8_t *payload, unsigned length)
+{
+	for (unsigned i = 0; i < sizeof(_dispatch_table) / sizeof(_dispatch_table[0]); i++) {
+		const dispatch_entry &entry = _dispatch_table[i];
 
-				_gps_position->fix_type = packet->gpsFix;
-				_gps_position->s_variance_m_s = packet->sAcc;
-				_gps_position->p_variance_m = packet->pAcc;
+		if (entry.clsID == clsID && entry.msgID == msgID) {
 
-				_gps_position->timestamp_variance = hrt_absolute_time();
+			if (length < entry.min_length) {
+				warnx("ubx: short message %d-%d", clsID, msgID);
+				return 0;
 			}
-			break;
+
+			return (this->*entry.handler)(payload, length);
 		}
+	}
 
-//		case NAV_DOP: {
-////		printf("GOT NAV_DOP MESSAGE\n");
-//			gps_bin_nav_dop_packet_t *packet = (gps_bin_nav_dop_packet_t *) _rx_buffer;
-//
-//			_gps_position->eph_m =  packet->hDOP;
-//			_gps_position->epv =  packet->vDOP;
-//
-//			_gps_position->timestamp_posdilution = hrt_absolute_time();
-//
-//			_new_nav_dop = true;
-//
-//			break;
-//		}
-
-		case NAV_TIMEUTC: {
-//			printf("GOT NAV_TIMEUTC MESSAGE\n");
-
-			if (!_waiting_for_ack) {
-				gps_bin_nav_timeutc_packet_t *packet = (gps_bin_nav_timeutc_packet_t *) _rx_buffer;
-
-				//convert to unix timestamp
-				struct tm timeinfo;
-				timeinfo.tm_year = packet->year - 1900;
-				timeinfo.tm_mon = packet->month - 1;
-				timeinfo.tm_mday = packet->day;
-				timeinfo.tm_hour = packet->hour;
-				timeinfo.tm_min = packet->min;
-				timeinfo.tm_sec = packet->sec;
-
-				time_t epoch = mktime(&timeinfo);
-
-				_gps_position->time_gps_usec = (uint64_t)epoch * 1000000; //TODO: test this
-				_gps_position->time_gps_usec += (uint64_t)(packet->time_nanoseconds * 1e-3f);
-
-				_gps_position->timestamp_time = hrt_absolute_time();
-			}
-			break;
+	/* not a message we are interested in */
+	return 0;
+}
+
+bool
+UBX::epoch_add(uint32_t itow, unsigned part, unsigned length)
+{
+	if (!_epoch_valid || itow != _epoch_itow) {
+
+		/*
+		 * First message of a new epoch. Work back from the time the
+		 * read completed to when the frame started arriving; the
+		 * remaining latency (solution computation, queueing in the
+		 * UART) only ever adds to it, so track the minimum.
+		 */
+		hrt_abstime arrival = _rx_time;
+
+		if (_baudrate > 0)
+			arrival -= ((length + UBX_FRAME_OVERHEAD) * 10 * 1000000ULL) / _baudrate;
+
+		int64_t offset = (int64_t)arrival - (int64_t)itow * 1000;
+
+		if (!_time_offset_valid ||
+		    offset > _time_offset + UBX_TIME_OFFSET_RESET ||
+		    offset < _time_offset - UBX_TIME_OFFSET_RESET) {
+			/* first sample, week rollover or module restart */
+			_time_offset = offset;
+			_time_offset_valid = true;
+
+		} else if (offset < _time_offset) {
+			_time_offset = offset;
+
+		} else {
+			/* allow the estimate to rise slowly to follow clock drift */
+			_time_offset += UBX_TIME_OFFSET_SLEW;
+
+			if (_time_offset > offset)
+				_time_offset = offset;
 		}
 
-		case NAV_SVINFO: {
-//			printf("GOT NAV_SVINFO MESSAGE\n");
+		_epoch_itow = itow;
+		_epoch_parts = 0;
+		_epoch_valid = true;
+	}
 
-			if (!_waiting_for_ack) {
-				//this is a more complicated message: the length depends on the number of satellites. This number is extracted from the first part of the message
-				const int length_part1 = 8;
-				char _rx_buffer_part1[length_part1];
-				memcpy(_rx_buffer_part1, _rx_buffer, length_part1);
-				gps_bin_nav_svinfo_part1_packet_t *packet_part1 = (gps_bin_nav_svinfo_part1_packet_t *) _rx_buffer_part1;
+	bool was_complete = ((_epoch_parts & UBX_EPOCH_COMPLETE) == UBX_EPOCH_COMPLETE);
 
-				//read checksum
-				const int length_part3 = 2;
-				char _rx_buffer_part3[length_part3];
-				memcpy(_rx_buffer_part3, &(_rx_buffer[_rx_count - 1]), length_part3);
+	_epoch_parts |= part;
 
-				//definitions needed to read numCh elements from the buffer:
-				const int length_part2 = 12;
-				gps_bin_nav_svinfo_part2_packet_t *packet_part2;
-				char _rx_buffer_part2[length_part2]; //for temporal storage
+	/* report completion once, duplicates within an epoch don't count */
+	return !was_complete && ((_epoch_parts & UBX_EPOCH_COMPLETE) == UBX_EPOCH_COMPLETE);
+}
 
-				uint8_t satellites_used = 0;
-				int i;
+hrt_abstime
+UBX::epoch_time()
+{
+	return (hrt_abstime)((int64_t)_epoch_itow * 1000 + _time_offset);
+}
 
-				for (i = 0; i < packet_part1->numCh; i++) { //for each channel
+int
+UBX::handle_nav_posllh(const uint8_t *payload, unsigned length)
+{
+	if (_waiting_for_ack)
+		return 0;
 
-					/* Get satellite information from the buffer */
-					memcpy(_rx_buffer_part2, &(_rx_buffer[length_part1 + i * length_part2]), length_part2);
-					packet_part2 = (gps_bin_nav_svinfo_part2_packet_t *) _rx_buffer_part2;
+	const gps_bin_nav_posllh_packet_t *packet = (const gps_bin_nav_posllh_packet_t *)payload;
+	bool complete = epoch_add(packet->time_milliseconds, UBX_EPOCH_POSLLH, length);
 
+	_gps_position->lat = packet->lat;
+	_gps_position->lon = packet->lon;
+	_gps_position->alt = packet->height_msl;
 
-					/* Write satellite information in the global storage */
-					_gps_position->satellite_prn[i] = packet_part2->svid;
+	_gps_position->eph_m = (float)packet->hAcc * 1e-3f; // from mm to m
+	_gps_position->epv_m = (float)packet->vAcc * 1e-3f; // from mm to m
 
-					//if satellite information is healthy store the data
-					uint8_t unhealthy = packet_part2->flags & 1 << 4; //flags is a bitfield
+	_gps_position->timestamp_position = epoch_time();
 
-					if (!unhealthy) {
-						if ((packet_part2->flags) & 1) { //flags is a bitfield
-							_gps_position->satellite_used[i] = 1;
-							satellites_used++;
+	/* only return 1 once the whole epoch is available */
+	return complete ? 1 : 0;
+}
 
-						} else {
-							_gps_position->satellite_used[i] = 0;
-						}
+int
+UBX::handle_nav_sol(const uint8_t *payload, unsigned length)
+{
+	if (_waiting_for_ack)
+		return 0;
 
-						_gps_position->satellite_snr[i] = packet_part2->cno;
-						_gps_position->satellite_elevation[i] = (uint8_t)(packet_part2->elev);
-						_gps_position->satellite_azimuth[i] = (uint8_t)((float)packet_part2->azim * 255.0f / 360.0f);
+	const gps_bin_nav_sol_packet_t *packet = (const gps_bin_nav_sol_packet_t *)payload;
+	bool complete = epoch_add(packet->time_milliseconds, UBX_EPOCH_SOL, length);
 
-					} else {
-						_gps_position->satellite_used[i] = 0;
-						_gps_position->satellite_snr[i] = 0;
-						_gps_position->satellite_elevation[i] = 0;
-						_gps_position->satellite_azimuth[i] = 0;
-					}
+	_gps_position->fix_type = packet->gpsFix;
+	_gps_position->s_variance_m_s = packet->sAcc;
+	_gps_position->p_variance_m = packet->pAcc;
 
-				}
+	_gps_position->timestamp_variance = epoch_time();
 
-				for (i = packet_part1->numCh; i < 20; i++) { //these channels are unused
-					/* Unused channels have to be set to zero for e.g. MAVLink */
-					_gps_position->satellite_prn[i] = 0;
-					_gps_position->satellite_used[i] = 0;
-					_gps_position->satellite_snr[i] = 0;
-					_gps_position->satellite_elevation[i] = 0;
-					_gps_position->satellite_azimuth[i] = 0;
-				}
-				_gps_position->satellites_visible = satellites_used; // visible ~= used but we are interested in the used ones
+	return complete ? 1 : 0;
+}
 
-				/* set timestamp if any sat info is available */
-				if (packet_part1->numCh > 0) {
-					_gps_position->satellite_info_available = true;
-				} else {
-					_gps_position->satellite_info_available = false;
-				}
-				_gps_position->timestamp_satellites = hrt_absolute_time();
-			}
+int
+UBX::handle_nav_timeutc(const uint8_t *payload, unsigned length)
+{
+	if (_waiting_for_ack)
+		return 0;
 
-			break;
-		}
+	const gps_bin_nav_timeutc_packet_t *packet = (const gps_bin_nav_timeutc_packet_t *)payload;
+	bool complete = epoch_add(packet->time_milliseconds, UBX_EPOCH_TIMEUTC, length);
 
-		case NAV_VELNED: {
-//			printf("GOT NAV_VELNED MESSAGE\n");
+	//convert to unix timestamp; UTC has no daylight saving, leave tm_isdst at 0
+	struct tm timeinfo;
+	memset(&timeinfo, 0, sizeof(timeinfo));
+	timeinfo.tm_year = packet->year - 1900;
+	timeinfo.tm_mon = packet->month - 1;
+	timeinfo.tm_mday = packet->day;
+	timeinfo.tm_hour = packet->hour;
+	timeinfo.tm_min = packet->min;
+	timeinfo.tm_sec = packet->sec;
 
-			if (!_waiting_for_ack) {
-				gps_bin_nav_velned_packet_t *packet = (gps_bin_nav_velned_packet_t *) _rx_buffer;
+	time_t epoch = mktime(&timeinfo);
 
-				_gps_position->vel_m_s   = (float)packet->speed * 1e-2f;
-				_gps_position->vel_n_m_s = (float)packet->velN * 1e-2f;
-				_gps_position->vel_e_m_s = (float)packet->velE * 1e-2f;
-				_gps_position->vel_d_m_s = (float)packet->velD * 1e-2f;
-				_gps_position->cog_rad   = (float)packet->heading * M_DEG_TO_RAD_F * 1e-5f;
-				_gps_position->vel_ned_valid = true;
-				_gps_position->timestamp_velocity = hrt_absolute_time();
-			}
+	_gps_position->time_gps_usec = (uint64_t)epoch * 1000000; //TODO: test this
+	_gps_position->time_gps_usec += (uint64_t)(packet->time_nanoseconds * 1e-3f);
 
-			break;
-		}
+	_gps_position->timestamp_time = epoch_time();
 
-//		case RXM_SVSI: {
-//				printf("GOT RXM_SVSI MESSAGE\n");
-//				const int length_part1 = 7;
-//				char _rx_buffer_part1[length_part1];
-//				memcpy(_rx_buffer_part1, _rx_buffer, length_part1);
-//				gps_bin_rxm_svsi_packet_t *packet = (gps_bin_rxm_svsi_packet_t *) _rx_buffer_part1;
-//
-//				_gps_position->satellites_visible = packet->numVis;
-//				_gps_position->counter++;
-//				_last_message_timestamps[RXM_SVSI - 1] = hrt_absolute_time();
-//
-//			break;
-//		}
-		case ACK_ACK: {
-//			printf("GOT ACK_ACK\n");
-			gps_bin_ack_ack_packet_t *packet = (gps_bin_ack_ack_packet_t *) _rx_buffer;
-
-			if (_waiting_for_ack) {
-				if (packet->clsID == _clsID_needed && packet->msgID == _msgID_needed) {
-					ret = 1;
-				}
+	return complete ? 1 : 0;
+}
+
+int
+UBX::handle_nav_svinfo(const uint8_t *payload, unsigned length)
+{
+	if (_waiting_for_ack)
+		return 0;
+
+	/* the length depends on the number of channels, given in the first part of the message */
+	const gps_bin_nav_svinfo_part1_packet_t *packet_part1 = (const gps_bin_nav_svinfo_part1_packet_t *)payload;
+	const unsigned length_part1 = sizeof(gps_bin_nav_svinfo_part1_packet_t);
+	const unsigned length_part2 = sizeof(gps_bin_nav_svinfo_part2_packet_t);
+	const unsigned max_channels = sizeof(_gps_position->satellite_prn) / sizeof(_gps_position->satellite_prn[0]);
+
+	/* never trust numCh beyond what was actually received or what we can store */
+	unsigned channels = packet_part1->numCh;
+
+	if (channels > (length - length_part1) / length_part2)
+		channels = (length - length_part1) / length_part2;
+
+	if (channels > max_channels)
+		channels = max_channels;
+
+	uint8_t satellites_used = 0;
+	unsigned i;
+
+	for (i = 0; i < channels; i++) { //for each channel
+
+		const gps_bin_nav_svinfo_part2_packet_t *packet_part2 =
+			(const gps_bin_nav_svinfo_part2_packet_t *)&payload[length_part1 + i * length_part2];
+
+		/* Write satellite information in the global storage */
+		_gps_position->satellite_prn[i] = packet_part2->svid;
+
+		//if satellite information is healthy store the data
+		uint8_t unhealthy = packet_part2->flags & 1 << 4; //flags is a bitfield
+
+		if (!unhealthy) {
+			if ((packet_part2->flags) & 1) { //flags is a bitfield
+				_gps_position->satellite_used[i] = 1;
+				satellites_used++;
+
+			} else {
+				_gps_position->satellite_used[i] = 0;
 			}
-		}
-		break;
 
-		case ACK_NAK: {
-//			printf("GOT ACK_NAK\n");
-			warnx("UBX: Received: Not Acknowledged");
-			/* configuration obviously not successful */
-			ret = -1;
-			break;
-		}
+			_gps_position->satellite_snr[i] = packet_part2->cno;
+			_gps_position->satellite_elevation[i] = (uint8_t)(packet_part2->elev);
+			_gps_position->satellite_azimuth[i] = (uint8_t)((float)packet_part2->azim * 255.0f / 360.0f);
 
-		default: //we don't know the message
-			warnx("UBX: Unknown message received: %d-%d\n",_message_class,_message_id);
-			ret = -1;
-			break;
+		} else {
+			_gps_position->satellite_used[i] = 0;
+			_gps_position->satellite_snr[i] = 0;
+			_gps_position->satellite_elevation[i] = 0;
+			_gps_position->satellite_azimuth[i] = 0;
 		}
-	// end if _rx_count high enough
-	decode_init();
-	return ret; //XXX?
+	}
+
+	for (i = channels; i < max_channels; i++) { //these channels are unused
+		/* Unused channels have to be set to zero for e.g. MAVLink */
+		_gps_position->satellite_prn[i] = 0;
+		_gps_position->satellite_used[i] = 0;
+		_gps_position->satellite_snr[i] = 0;
+		_gps_position->satellite_elevation[i] = 0;
+		_gps_position->satellite_azimuth[i] = 0;
+	}
+
+	_gps_position->satellites_visible = satellites_used; // visible ~= used but we are interested in the used ones
+
+	/* set timestamp if any sat info is available */
+	_gps_position->satellite_info_available = (channels > 0);
+	_gps_position->timestamp_satellites = hrt_absolute_time();
+
+	return 0;
 }
 
-void
-UBX::decode_init(void)
+int
+UBX::handle_nav_velned(const uint8_t *payload, unsigned length)
 {
-	_rx_ck_a = 0;
-	_rx_ck_b = 0;
-	_rx_count = 0;
-	_decode_state = UBX_DECODE_UNINIT;
-	_message_class = CLASS_UNKNOWN;
-	_message_id = ID_UNKNOWN;
-	_payload_size = 0;
+	if (_waiting_for_ack)
+		return 0;
+
+	const gps_bin_nav_velned_packet_t *packet = (const gps_bin_nav_velned_packet_t *)payload;
+	bool complete = epoch_add(packet->time_milliseconds, UBX_EPOCH_VELNED, length);
+
+	_gps_position->vel_m_s   = (float)packet->speed * 1e-2f;
+	_gps_position->vel_n_m_s = (float)packet->velN * 1e-2f;
+	_gps_position->vel_e_m_s = (float)packet->velE * 1e-2f;
+	_gps_position->vel_d_m_s = (float)packet->velD * 1e-2f;
+	_gps_position->cog_rad   = (float)packet->heading * M_DEG_TO_RAD_F * 1e-5f;
+	_gps_position->vel_ned_valid = true;
+	_gps_position->timestamp_velocity = epoch_time();
+
+	return complete ? 1 : 0;
 }
 
-void
-UBX::add_byte_to_checksum(uint8_t b)
+int
+UBX::handle_ack_ack(const uint8_t *payload, unsigned length)
+{
+	const gps_bin_ack_ack_packet_t *packet = (const gps_bin_ack_ack_packet_t *)payload;
+
+	if (_waiting_for_ack && packet->clsID == _clsID_needed && packet->msgID == _msgID_needed)
+		return 1;
+
+	return 0;
+}
+
+int
+UBX::handle_ack_nak(const uint8_t *payload, unsigned length)
 {
-	_rx_ck_a = _rx_ck_a + b;
-	_rx_ck_b = _rx_ck_b + _rx_ck_a;
+	const gps_bin_ack_nak_packet_t *packet = (const gps_bin_ack_nak_packet_t *)payload;
+
+	if (_waiting_for_ack && packet->clsID == _clsID_needed && packet->msgID == _msgID_needed) {
+		warnx("UBX: Received: Not Acknowledged");
+
+		/* configuration obviously not successful */
+		return -1;
+	}
+
+	return 0;
 }
 
 void
@@ -38,6 +38,9 @@
 #ifndef UBX_H_
 #define UBX_H_
 
+#include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
+
 #include "gps_helper.h"
 
 #define UBX_SYNC1 0xB5
@@ -72,6 +75,7 @@
 #define UBX_CFG_PRT_PAYLOAD_OUTPROTOMASK 0x01   /**< UBX out */
 
 #define UBX_CFG_RATE_LENGTH 6
+#define UBX_CFG_RATE_PAYLOAD_MEASRATE_FAST 100	/**< 100ms for 10Hz, where the module supports it */
 #define UBX_CFG_RATE_PAYLOAD_MEASRATE 200		/**< 200ms for 5Hz */
 #define UBX_CFG_RATE_PAYLOAD_NAVRATE 1			/**< cannot be changed */
 #define UBX_CFG_RATE_PAYLOAD_TIMEREF 0			/**< 0: UTC, 1: GPS time */
@@ -298,43 +302,21 @@ typedef enum {
 	UBX_CONFIG_STATE_CONFIGURED
 } ubx_config_state_t;
 
-typedef enum {
-	CLASS_UNKNOWN = 0,
-	NAV = 1,
-	RXM = 2,
-	ACK = 3,
-	CFG = 4
-} ubx_message_class_t;
-
-typedef enum {
-	//these numbers do NOT correspond to the message id numbers of the ubx protocol
-	ID_UNKNOWN = 0,
-	NAV_POSLLH,
-	NAV_SOL,
-	NAV_TIMEUTC,
-//	NAV_DOP,
-	NAV_SVINFO,
-	NAV_VELNED,
-//	RXM_SVSI,
-	CFG_NAV5,
-	ACK_ACK,
-	ACK_NAK,
-} ubx_message_id_t;
-
-typedef enum {
-	UBX_DECODE_UNINIT = 0,
-	UBX_DECODE_GOT_SYNC1,
-	UBX_DECODE_GOT_SYNC2,
-	UBX_DECODE_GOT_CLASS,
-	UBX_DECODE_GOT_MESSAGEID,
-	UBX_DECODE_GOT_LENGTH1,
-	UBX_DECODE_GOT_LENGTH2
-} ubx_decode_state_t;
-
 //typedef type_gps_bin_ubx_state gps_bin_ubx_state_t;
 #pragma pack(pop)
 
-#define RECV_BUFFER_SIZE 500 //The NAV-SOL messages really need such a big buffer
+/* messages that make up a navigation epoch; the report is published once all of them carry the same iTOW */
+#define UBX_EPOCH_POSLLH	(1 << 0)
+#define UBX_EPOCH_VELNED	(1 << 1)
+#define UBX_EPOCH_SOL		(1 << 2)
+#define UBX_EPOCH_TIMEUTC	(1 << 3)	/**< optional, not needed to complete an epoch */
+#define UBX_EPOCH_COMPLETE	(UBX_EPOCH_POSLLH | UBX_EPOCH_VELNED | UBX_EPOCH_SOL)
+
+#define UBX_TIME_OFFSET_SLEW	50		/**< us per epoch the GPS to hrt offset may rise, covers clock drift */
+#define UBX_TIME_OFFSET_RESET	1000000		/**< us, re-initialise the offset on jumps larger than this */
+
+#define UBX_FRAME_OVERHEAD 8	/**< sync1, sync2, class, id, 2 length and 2 checksum bytes */
+#define RECV_BUFFER_SIZE (UBX_MAX_PAYLOAD_LENGTH + UBX_FRAME_OVERHEAD)	/**< always holds at least one complete frame */
 
 class UBX : public GPS_Helper
 {
@@ -347,24 +329,62 @@ public:
 private:
 
 	/**
-	 * Parse the binary MTK packet
+	 * Scan the receive buffer for complete frames, verify their checksums
+	 * and dispatch them to the message handlers.
+	 *
+	 * Consumed bytes are removed from the buffer; an incomplete frame at
+	 * the end is kept for the next call.
+	 *
+	 * @return		1 if a handler reported a message of interest, -1 if
+	 *			the module refused the configuration, 0 otherwise
+	 */
+	int					parse_buffer(void);
+
+	/**
+	 * Look up the handler for a verified frame and run it.
 	 */
-	int					parse_char(uint8_t b);
+	int					dispatch(uint8_t clsID, uint8_t msgID, const uint8_t *payload, unsigned length);
 
 	/**
-	 * Handle the package once it has arrived
+	 * Account a message to the navigation epoch it belongs to.
+	 *
+	 * The first message of each epoch also updates the GPS to hrt
+	 * time offset estimate.
+	 *
+	 * @param itow		GPS time of week of the message, ms
+	 * @param part		UBX_EPOCH_* bit of the message
+	 * @param length	Payload length, used to back out the transmission time
+	 * @return		true if this message completed the epoch
 	 */
-	int					handle_message(void);
+	bool				epoch_add(uint32_t itow, unsigned part, unsigned length);
 
 	/**
-	 * Reset the parse state machine for a fresh start
+	 * hrt time corresponding to the current epoch's time of week.
 	 */
-	void				decode_init(void);
+	hrt_abstime			epoch_time(void);
 
 	/**
-	 * While parsing add every byte (except the sync bytes) to the checksum
+	 * Message handlers, called with the verified payload.
 	 */
-	void				add_byte_to_checksum(uint8_t);
+	int					handle_nav_posllh(const uint8_t *payload, unsigned length);
+	int					handle_nav_sol(const uint8_t *payload, unsigned length);
+	int					handle_nav_timeutc(const uint8_t *payload, unsigned length);
+	int					handle_nav_svinfo(const uint8_t *payload, unsigned length);
+	int					handle_nav_velned(const uint8_t *payload, unsigned length);
+	int					handle_ack_ack(const uint8_t *payload, unsigned length);
+	int					handle_ack_nak(const uint8_t *payload, unsigned length);
+
+	/**
+	 * Entry in the message dispatch table.
+	 */
+	struct dispatch_entry {
+		uint8_t			clsID;
+		uint8_t			msgID;
+		unsigned		min_length;		/**< shortest acceptable payload */
+		int			(UBX::*handler)(const uint8_t *payload, unsigned length);
+	};
+
+	static const dispatch_entry	_dispatch_table[];
 
 	/**
 	 * Add the two checksum bytes to an outgoing message
@@ -382,14 +402,17 @@ private:
 	bool 				_waiting_for_ack;
 	uint8_t				_clsID_needed;
 	uint8_t				_msgID_needed;
-	ubx_decode_state_t	_decode_state;
 	uint8_t				_rx_buffer[RECV_BUFFER_SIZE];
 	unsigned			_rx_count;
-	uint8_t 			_rx_ck_a;
-	uint8_t				_rx_ck_b;
-	ubx_message_class_t _message_class;
-	ubx_message_id_t	_message_id;
-	unsigned			_payload_size;
+	perf_counter_t		_parse_perf;
+	perf_counter_t		_checksum_errors;
+	hrt_abstime			_rx_time;				/**< time of the read that completed the buffered data */
+	unsigned			_baudrate;
+	bool				_epoch_valid;
+	uint32_t			_epoch_itow;			/**< time of week of the epoch being assembled, ms */
+	unsigned			_epoch_parts;			/**< UBX_EPOCH_* bits received for this epoch */
+	bool				_time_offset_valid;
+	int64_t				_time_offset;			/**< hrt time minus GPS time of week, us */
 };
 
 #endif /* UBX_H_ */
@@ -142,12 +142,20 @@ public:
 	 */
 	void			print_info();
 
+	/**
+	 * Data-ready interrupt handler; schedules collection of the
+	 * measurement that just completed.
+	 */
+	virtual void		drdy_interrupt(hrt_abstime timestamp);
+
 protected:
 	virtual int		probe();
 
 private:
 	work_s			_work;
 	unsigned		_measure_ticks;
+	bool			_external;		/**< measurements are paced by the DRDY signal */
+	volatile hrt_abstime	_drdy_timestamp;	/**< time the last DRDY edge was taken, or zero */
 
 	unsigned		_num_reports;
 	volatile unsigned	_next_report;
@@ -161,8 +169,10 @@ private:
 	orb_advert_t		_mag_topic;
 
 	perf_counter_t		_sample_perf;
+	perf_counter_t		_sample_interval;
 	perf_counter_t		_comms_errors;
 	perf_counter_t		_buffer_overflows;
+	perf_counter_t		_drdy_timeouts;
 
 	/* status reporting */
 	bool			_sensor_ok;		/**< sensor was found and reports ok */
@@ -316,6 +326,8 @@ extern "C" __EXPORT int hmc5883_main(int argc, char *argv[]);
 HMC5883::HMC5883(int bus) :
 	I2C("HMC5883", MAG_DEVICE_PATH, bus, HMC5883L_ADDRESS, 400000),
 	_measure_ticks(0),
+	_external(false),
+	_drdy_timestamp(0),
 	_num_reports(0),
 	_next_report(0),
 	_oldest_report(0),
@@ -324,8 +336,10 @@ HMC5883::HMC5883(int bus) :
 	_range_ga(1.3f),
 	_mag_topic(-1),
 	_sample_perf(perf_alloc(PC_ELAPSED, "hmc5883_read")),
+	_sample_interval(perf_alloc(PC_INTERVAL, "hmc5883_interval")),
 	_comms_errors(perf_alloc(PC_COUNT, "hmc5883_comms_errors")),
 	_buffer_overflows(perf_alloc(PC_COUNT, "hmc5883_buffer_overflows")),
+	_drdy_timeouts(perf_alloc(PC_COUNT, "hmc5883_drdy_timeouts")),
 	_sensor_ok(false),
 	_calibrated(false)
 {
@@ -352,6 +366,13 @@ HMC5883::~HMC5883()
 	/* free any existing reports */
 	if (_reports != nullptr)
 		delete[] _reports;
+
+	/* free perf counters */
+	perf_free(_sample_perf);
+	perf_free(_sample_interval);
+	perf_free(_comms_errors);
+	perf_free(_buffer_overflows);
+	perf_free(_drdy_timeouts);
 }
 
 int
@@ -548,10 +569,20 @@ HMC5883::ioctl(struct file *filp, int cmd, unsigned long arg)
 			case SENSOR_POLLRATE_MANUAL:
 				stop();
 				_measure_ticks = 0;
+				_external = false;
 				return OK;
 
-				/* external signalling (DRDY) not supported */
+				/* measure back-to-back, collect when DRDY signals */
 			case SENSOR_POLLRATE_EXTERNAL:
+#ifdef GPIO_EXTI_HMC5883_DRDY
+				stop();
+				_measure_ticks = USEC2TICK(HMC5883_CONVERSION_INTERVAL);
+				_external = true;
+				start();
+				return OK;
+#else
+				return -EINVAL;
+#endif
 
 				/* zero would be bad */
 			case 0:
@@ -561,7 +592,13 @@ HMC5883::ioctl(struct file *filp, int cmd, unsigned long arg)
 			case SENSOR_POLLRATE_MAX:
 			case SENSOR_POLLRATE_DEFAULT: {
 					/* do we need to start internal polling? */
-					bool want_start = (_measure_ticks == 0);
+					bool want_start = (_measure_ticks == 0) || _external;
+
+					/* switch back to timed polling */
+					if (_external) {
+						stop();
+						_external = false;
+					}
 
 					/* set interval for next measurement to minimum legal value */
 					_measure_ticks = USEC2TICK(HMC5883_CONVERSION_INTERVAL);
@@ -576,7 +613,7 @@ HMC5883::ioctl(struct file *filp, int cmd, unsigned long arg)
 				/* adjust to a legal polling interval in Hz */
 			default: {
 					/* do we need to start internal polling? */
-					bool want_start = (_measure_ticks == 0);
+					bool want_start = (_measure_ticks == 0) || _external;
 
 					/* convert hz to tick interval via microseconds */
 					unsigned ticks = USEC2TICK(1000000 / arg);
@@ -585,6 +622,12 @@ HMC5883::ioctl(struct file *filp, int cmd, unsigned long arg)
 					if (ticks < USEC2TICK(HMC5883_CONVERSION_INTERVAL))
 						return -EINVAL;
 
+					/* switch back to timed polling */
+					if (_external) {
+						stop();
+						_external = false;
+					}
+
 					/* update interval for next measurement */
 					_measure_ticks = ticks;
 
@@ -601,6 +644,9 @@ HMC5883::ioctl(struct file *filp, int cmd, unsigned long arg)
 		if (_measure_ticks == 0)
 			return SENSOR_POLLRATE_MANUAL;
 
+		if (_external)
+			return SENSOR_POLLRATE_EXTERNAL;
+
 		return (1000 / _measure_ticks);
 
 	case SENSORIOCSQUEUEDEPTH: {
@@ -678,6 +724,15 @@ HMC5883::start()
 	/* reset the report ring and state machine */
 	_collect_phase = false;
 	_oldest_report = _next_report = 0;
+	_drdy_timestamp = 0;
+
+#ifdef GPIO_EXTI_HMC5883_DRDY
+	/* DRDY is pulled low for 250us when new data is available */
+	if (_external && (drdy_attach(GPIO_EXTI_HMC5883_DRDY, false) != OK)) {
+		log("DRDY attach failed, using timed polling");
+		_external = false;
+	}
+#endif
 
 	/* schedule a cycle to start things */
 	work_queue(HPWORK, &_work, (worker_t)&HMC5883::cycle_trampoline, this, 1);
@@ -686,9 +741,27 @@ HMC5883::start()
 void
 HMC5883::stop()
 {
+	drdy_detach();
 	work_cancel(HPWORK, &_work);
 }
 
+void
+HMC5883::drdy_interrupt(hrt_abstime timestamp)
+{
+	perf_count(_sample_interval);
+
+	/*
+	 * Only act on the edge if a measurement is pending and the cycle is
+	 * parked waiting for it; if the worker is busy it will pick up
+	 * the data on its own.
+	 */
+	if (_collect_phase && (_work.worker != nullptr)) {
+		_drdy_timestamp = timestamp;
+		work_cancel(HPWORK, &_work);
+		work_queue(HPWORK, &_work, (worker_t)&HMC5883::cycle_trampoline, this, 0);
+	}
+}
+
 void
 HMC5883::cycle_trampoline(void *arg)
 {
@@ -737,12 +810,15 @@ HMC5883::cycle()
 	/* next phase is collection */
 	_collect_phase = true;
 
-	/* schedule a fresh cycle call when the measurement is done */
+	/*
+	 * Schedule a fresh cycle call when the measurement is done; when DRDY
+	 * is in use this is only a fallback in case we miss the edge.
+	 */
 	work_queue(HPWORK,
 		   &_work,
 		   (worker_t)&HMC5883::cycle_trampoline,
 		   this,
-		   USEC2TICK(HMC5883_CONVERSION_INTERVAL));
+		   USEC2TICK(HMC5883_CONVERSION_INTERVAL) * (_external ? 2 : 1));
 }
 
 int
@@ -780,8 +856,23 @@ HMC5883::collect()
 
 	perf_begin(_sample_perf);
 
-	/* this should be fairly close to the end of the measurement, so the best approximation of the time */
-	_reports[_next_report].timestamp = hrt_absolute_time();
+	if (_external) {
+		/* DRDY tells us exactly when the measurement completed */
+		if (_drdy_timestamp != 0) {
+			_reports[_next_report].timestamp = _drdy_timestamp;
+
+		} else {
+			perf_count(_drdy_timeouts);
+			_reports[_next_report].timestamp = hrt_absolute_time();
+		}
+
+		_drdy_timestamp = 0;
+
+	} else {
+		/* this should be fairly close to the end of the measurement, so the best approximation of the time */
+		_reports[_next_report].timestamp = hrt_absolute_time();
+		perf_count(_sample_interval);
+	}
 
 	/*
 	 * @note  We could read the status register here, which could tell us that
@@ -1173,9 +1264,11 @@ void
 HMC5883::print_info()
 {
 	perf_print_counter(_sample_perf);
+	perf_print_counter(_sample_interval);
 	perf_print_counter(_comms_errors);
 	perf_print_counter(_buffer_overflows);
-	printf("poll interval:  %u ticks\n", _measure_ticks);
+	perf_print_counter(_drdy_timeouts);
+	printf("poll interval:  %u ticks%s\n", _measure_ticks, _external ? " (DRDY)" : "");
 	printf("report queue:   %u (%u/%u @ %p)\n",
 	       _num_reports, _oldest_report, _next_report, _reports);
 }
@@ -56,6 +56,7 @@
 
 #include <nuttx/arch.h>
 #include <nuttx/clock.h>
+#include <nuttx/wqueue.h>
 
 #include <drivers/drv_hrt.h>
 #include <arch/board/board.h>
@@ -124,6 +125,8 @@ static const int ERROR = -1;
 #define REG1_Y_ENABLE				(1<<1)
 #define REG1_X_ENABLE				(1<<0)
 
+#define REG3_I2_DRDY				(1<<3)
+
 #define REG4_BDU				(1<<7)
 #define REG4_BLE				(1<<6)
 //#define REG4_SPI_3WIRE			(1<<0)
@@ -164,6 +167,11 @@ public:
 	 */
 	void			print_info();
 
+	/**
+	 * Data-ready interrupt handler; queues a read of the new sample.
+	 */
+	virtual void		drdy_interrupt(hrt_abstime timestamp);
+
 protected:
 	virtual int		probe();
 
@@ -171,6 +179,9 @@ private:
 
 	struct hrt_call		_call;
 	unsigned		_call_interval;
+	bool			_external;	/**< sampling is paced by the data-ready interrupt */
+	work_s			_drdy_work;	/**< reads the sample a data-ready edge announced */
+	volatile hrt_abstime	_drdy_timestamp; /**< time of the last data-ready edge */
 
 	unsigned		_num_reports;
 	volatile unsigned	_next_report;
@@ -186,6 +197,7 @@ private:
 	unsigned		_current_range;
 
 	perf_counter_t		_sample_perf;
+	perf_counter_t		_sample_interval;
 
 	/**
 	 * Start automatic measurement.
@@ -208,10 +220,21 @@ private:
 	 */
 	static void		measure_trampoline(void *arg);
 
+	/**
+	 * Static trampoline from the work queue, reading the sample announced
+	 * by the last data-ready edge.
+	 *
+	 * @param arg		Instance pointer for the driver.
+	 */
+	static void		drdy_trampoline(void *arg);
+
 	/**
 	 * Fetch measurements from the sensor and update the report ring.
+	 *
+	 * @param timestamp	Time at which the sample became available, or
+	 *			zero to stamp it with the current time.
 	 */
-	void			measure();
+	void			measure(hrt_abstime timestamp = 0);
 
 	/**
 	 * Read a register from the L3GD20
@@ -268,6 +291,8 @@ private:
 L3GD20::L3GD20(int bus, const char* path, spi_dev_e device) :
 	SPI("L3GD20", path, bus, device, SPIDEV_MODE3, 8000000),
 	_call_interval(0),
+	_external(false),
+	_drdy_timestamp(0),
 	_num_reports(0),
 	_next_report(0),
 	_oldest_report(0),
@@ -277,7 +302,8 @@ L3GD20::L3GD20(int bus, const char* path, spi_dev_e device) :
 	_gyro_topic(-1),
 	_current_rate(0),
 	_current_range(0),
-	_sample_perf(perf_alloc(PC_ELAPSED, "l3gd20_read"))
+	_sample_perf(perf_alloc(PC_ELAPSED, "l3gd20_read")),
+	_sample_interval(perf_alloc(PC_INTERVAL, "l3gd20_interval"))
 {
 	// enable debug() calls
 	_debug_enabled = true;
@@ -289,6 +315,9 @@ L3GD20::L3GD20(int bus, const char* path, spi_dev_e device) :
 	_gyro_scale.y_scale  = 1.0f;
 	_gyro_scale.z_offset = 0;
 	_gyro_scale.z_scale  = 1.0f;
+
+	memset(&_call, 0, sizeof(_call));
+	memset(&_drdy_work, 0, sizeof(_drdy_work));
 }
 
 L3GD20::~L3GD20()
@@ -300,8 +329,9 @@ L3GD20::~L3GD20()
 	if (_reports != nullptr)
 		delete[] _reports;
 
-	/* delete the perf counter */
+	/* delete the perf counters */
 	perf_free(_sample_perf);
+	perf_free(_sample_interval);
 }
 
 int
@@ -409,10 +439,20 @@ L3GD20::ioctl(struct file *filp, int cmd, unsigned long arg)
 			case SENSOR_POLLRATE_MANUAL:
 				stop();
 				_call_interval = 0;
+				_external = false;
 				return OK;
 
-				/* external signalling not supported */
+				/* sample on the data-ready interrupt, at the internal sampling rate */
 			case SENSOR_POLLRATE_EXTERNAL:
+#ifdef GPIO_EXTI_L3GD20_DRDY
+				stop();
+				_call_interval = 1000000 / _current_rate;
+				_external = true;
+				start();
+				return OK;
+#else
+				return -EINVAL;
+#endif
 
 				/* zero would be bad */
 			case 0:
@@ -427,7 +467,7 @@ L3GD20::ioctl(struct file *filp, int cmd, unsigned long arg)
 				/* adjust to a legal polling interval in Hz */
 			default: {
 					/* do we need to start internal polling? */
-					bool want_start = (_call_interval == 0);
+					bool want_start = (_call_interval == 0) || _external;
 
 					/* convert hz to hrt interval via microseconds */
 					unsigned ticks = 1000000 / arg;
@@ -436,6 +476,12 @@ L3GD20::ioctl(struct file *filp, int cmd, unsigned long arg)
 					if (ticks < 1000)
 						return -EINVAL;
 
+					/* switch back to timed polling */
+					if (_external) {
+						stop();
+						_external = false;
+					}
+
 					/* update interval for next measurement */
 					/* XXX this is a bit shady, but no other way to adjust... */
 					_call.period = _call_interval = ticks;
@@ -453,6 +499,9 @@ L3GD20::ioctl(struct file *filp, int cmd, unsigned long arg)
 		if (_call_interval == 0)
 			return SENSOR_POLLRATE_MANUAL;
 
+		if (_external)
+			return SENSOR_POLLRATE_EXTERNAL;
+
 		return 1000000 / _call_interval;
 
 	case SENSORIOCSQUEUEDEPTH: {
@@ -626,16 +675,57 @@ L3GD20::start()
 	/* reset the report ring */
 	_oldest_report = _next_report = 0;
 
-	/* start polling at the specified rate */
-	hrt_call_every(&_call, 1000, _call_interval, (hrt_callout)&L3GD20::measure_trampoline, this);
+#ifdef GPIO_EXTI_L3GD20_DRDY
+	if (_external) {
+		/* route data-ready to DRDY/INT2 (active high) */
+		write_reg(ADDR_CTRL_REG3, REG3_I2_DRDY);
+
+		if (drdy_attach(GPIO_EXTI_L3GD20_DRDY, true) == OK) {
+			/* the edge may already have passed; fetch the pending sample to re-arm it */
+			measure();
+			return;
+		}
+
+		log("DRDY attach failed, using timed polling");
+		_external = false;
+	}
+#endif
+
+	/* start polling at the specified rate, outside the timer interrupt */
+	hrt_call_every_deferred(&_call, 1000, _call_interval, (hrt_callout)&L3GD20::measure_trampoline, this);
 }
 
 void
 L3GD20::stop()
 {
+	drdy_detach();
+	work_cancel(HPWORK, &_drdy_work);
 	hrt_cancel(&_call);
 }
 
+void
+L3GD20::drdy_interrupt(hrt_abstime timestamp)
+{
+	/*
+	 * No SPI transfers here: the pollers on the work queue hold the bus
+	 * lock across theirs, and this interrupt may have pre-empted one.
+	 * Read on the work queue instead, stamped with the edge time; if
+	 * a read is still queued, it picks up the newer sample.
+	 */
+	_drdy_timestamp = timestamp;
+
+	if (_drdy_work.worker == nullptr)
+		work_queue(HPWORK, &_drdy_work, (worker_t)&L3GD20::drdy_trampoline, this, 0);
+}
+
+void
+L3GD20::drdy_trampoline(void *arg)
+{
+	L3GD20 *dev = (L3GD20 *)arg;
+
+	dev->measure(dev->_drdy_timestamp);
+}
+
 void
 L3GD20::measure_trampoline(void *arg)
 {
@@ -646,7 +736,7 @@ L3GD20::measure_trampoline(void *arg)
 }
 
 void
-L3GD20::measure()
+L3GD20::measure(hrt_abstime timestamp)
 {
 	/* status register and data as read back from the device */
 #pragma pack(push, 1)
@@ -664,6 +754,7 @@ L3GD20::measure()
 
 	/* start the performance counter */
 	perf_begin(_sample_perf);
+	perf_count(_sample_interval);
 
 	/* fetch data from the sensor */
 	raw_report.cmd = ADDR_OUT_TEMP | DIR_READ | ADDR_INCREMENT;
@@ -683,7 +774,7 @@ L3GD20::measure()
 	 *	 	  the offset is 74 from the origin and subtracting
 	 *		  74 from all measurements centers them around zero.
 	 */
-	report->timestamp = hrt_absolute_time();
+	report->timestamp = (timestamp != 0) ? timestamp : hrt_absolute_time();
 	
 	/* swap x and y and negate y */
 	report->x_raw = raw_report.y;
@@ -717,8 +808,11 @@ void
 L3GD20::print_info()
 {
 	perf_print_counter(_sample_perf);
+	perf_print_counter(_sample_interval);
+	printf("poll interval:  %u us%s\n", _call_interval, _external ? " (DRDY)" : "");
 	printf("report queue:   %u (%u/%u @ %p)\n",
 	       _num_reports, _oldest_report, _next_report, _reports);
+	hrt_call_print_info(&_call, "poll call");
 }
 
 /**
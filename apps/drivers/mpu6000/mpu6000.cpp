@@ -59,6 +59,7 @@
 
 #include <nuttx/arch.h>
 #include <nuttx/clock.h>
+#include <nuttx/wqueue.h>
 
 #include <arch/board/board.h>
 #include <drivers/drv_hrt.h>
@@ -144,6 +145,9 @@
 #define MPU6000_REV_D9			0x59
 #define MPU6000_REV_D10			0x5A
 
+/* output data rate as configured by MPUREG_SMPLRT_DIV in init() */
+#define MPU6000_ODR_INTERVAL		(1000000 / 200)	/* microseconds */
+
 
 class MPU6000_gyro;
 
@@ -163,6 +167,11 @@ public:
 	 */
 	void			print_info();
 
+	/**
+	 * Data-ready interrupt handler; queues a read of the new sample.
+	 */
+	virtual void		drdy_interrupt(hrt_abstime timestamp);
+
 protected:
 	virtual int		probe();
 
@@ -177,6 +186,9 @@ private:
 
 	struct hrt_call		_call;
 	unsigned		_call_interval;
+	bool			_external;	/**< sampling is paced by the data-ready interrupt */
+	work_s			_drdy_work;	/**< reads the sample a data-ready edge announced */
+	volatile hrt_abstime	_drdy_timestamp; /**< time of the last data-ready edge */
 
 	struct accel_report	_accel_report;
 	struct accel_scale	_accel_scale;
@@ -192,6 +204,7 @@ private:
 
 	unsigned		_reads;
 	perf_counter_t		_sample_perf;
+	perf_counter_t		_sample_interval;
 
 	/**
 	 * Start automatic measurement.
@@ -214,10 +227,21 @@ private:
 	 */
 	static void		measure_trampoline(void *arg);
 
+	/**
+	 * Static trampoline from the work queue, reading the sample announced
+	 * by the last data-ready edge.
+	 *
+	 * @param arg		Instance pointer for the driver.
+	 */
+	static void		drdy_trampoline(void *arg);
+
 	/**
 	 * Fetch measurements from the sensor and update the report ring.
+	 *
+	 * @param timestamp	Time at which the sample became available, or
+	 *			zero to stamp it with the current time.
 	 */
-	void			measure();
+	void			measure(hrt_abstime timestamp = 0);
 
 	/**
 	 * Read a register from the MPU6000
@@ -302,6 +326,8 @@ MPU6000::MPU6000(int bus, spi_dev_e device) :
 	_gyro(new MPU6000_gyro(this)),
 	_product(0),
 	_call_interval(0),
+	_external(false),
+	_drdy_timestamp(0),
 	_accel_range_scale(0.0f),
 	_accel_range_m_s2(0.0f),
 	_accel_topic(-1),
@@ -309,7 +335,8 @@ MPU6000::MPU6000(int bus, spi_dev_e device) :
 	_gyro_range_rad_s(0.0f),
 	_gyro_topic(-1),
 	_reads(0),
-	_sample_perf(perf_alloc(PC_ELAPSED, "mpu6000_read"))
+	_sample_perf(perf_alloc(PC_ELAPSED, "mpu6000_read")),
+	_sample_interval(perf_alloc(PC_INTERVAL, "mpu6000_interval"))
 {
 	// disable debug() calls
 	_debug_enabled = false;
@@ -333,6 +360,7 @@ MPU6000::MPU6000(int bus, spi_dev_e device) :
 	memset(&_accel_report, 0, sizeof(_accel_report));
 	memset(&_gyro_report, 0, sizeof(_gyro_report));
 	memset(&_call, 0, sizeof(_call));
+	memset(&_drdy_work, 0, sizeof(_drdy_work));
 }
 
 MPU6000::~MPU6000()
@@ -343,8 +371,9 @@ MPU6000::~MPU6000()
 	/* delete the gyro subdriver */
 	delete _gyro;
 
-	/* delete the perf counter */
+	/* delete the perf counters */
 	perf_free(_sample_perf);
+	perf_free(_sample_interval);
 }
 
 int
@@ -587,10 +616,20 @@ MPU6000::ioctl(struct file *filp, int cmd, unsigned long arg)
 			case SENSOR_POLLRATE_MANUAL:
 				stop();
 				_call_interval = 0;
+				_external = false;
 				return OK;
 
-				/* external signalling not supported */
+				/* sample on the data-ready interrupt */
 			case SENSOR_POLLRATE_EXTERNAL:
+#ifdef GPIO_EXTI_MPU6000_DRDY
+				stop();
+				_call_interval = MPU6000_ODR_INTERVAL;
+				_external = true;
+				start();
+				return OK;
+#else
+				return -EINVAL;
+#endif
 
 				/* zero would be bad */
 			case 0:
@@ -605,7 +644,7 @@ MPU6000::ioctl(struct file *filp, int cmd, unsigned long arg)
 				/* adjust to a legal polling interval in Hz */
 			default: {
 					/* do we need to start internal polling? */
-					bool want_start = (_call_interval == 0);
+					bool want_start = (_call_interval == 0) || _external;
 
 					/* convert hz to hrt interval via microseconds */
 					unsigned ticks = 1000000 / arg;
@@ -614,6 +653,12 @@ MPU6000::ioctl(struct file *filp, int cmd, unsigned long arg)
 					if (ticks < 1000)
 						return -EINVAL;
 
+					/* switch back to timed polling */
+					if (_external) {
+						stop();
+						_external = false;
+					}
+
 					/* update interval for next measurement */
 					/* XXX this is a bit shady, but no other way to adjust... */
 					_call.period = _call_interval = ticks;
@@ -631,6 +676,9 @@ MPU6000::ioctl(struct file *filp, int cmd, unsigned long arg)
 		if (_call_interval == 0)
 			return SENSOR_POLLRATE_MANUAL;
 
+		if (_external)
+			return SENSOR_POLLRATE_EXTERNAL;
+
 		return 1000000 / _call_interval;
 
 	case SENSORIOCSQUEUEDEPTH:
@@ -831,16 +879,52 @@ MPU6000::start()
 	/* make sure we are stopped first */
 	stop();
 
+#ifdef GPIO_EXTI_MPU6000_DRDY
+	/* INT is configured active high, pulsed on raw data ready */
+	if (_external) {
+		if (drdy_attach(GPIO_EXTI_MPU6000_DRDY, true) == OK)
+			return;
+
+		log("DRDY attach failed, using timed polling");
+		_external = false;
+	}
+#endif
+
 	/* start polling at the specified rate */
-	hrt_call_every(&_call, 1000, _call_interval, (hrt_callout)&MPU6000::measure_trampoline, this);
+	hrt_call_every_deferred(&_call, 1000, _call_interval, (hrt_callout)&MPU6000::measure_trampoline, this);
 }
 
 void
 MPU6000::stop()
 {
+	drdy_detach();
+	work_cancel(HPWORK, &_drdy_work);
 	hrt_cancel(&_call);
 }
 
+void
+MPU6000::drdy_interrupt(hrt_abstime timestamp)
+{
+	/*
+	 * No SPI transfers here: the pollers on the work queue hold the bus
+	 * lock across theirs, and this interrupt may have pre-empted one.
+	 * Read on the work queue instead, stamped with the edge time; if
+	 * a read is still queued, it picks up the newer sample.
+	 */
+	_drdy_timestamp = timestamp;
+
+	if (_drdy_work.worker == nullptr)
+		work_queue(HPWORK, &_drdy_work, (worker_t)&MPU6000::drdy_trampoline, this, 0);
+}
+
+void
+MPU6000::drdy_trampoline(void *arg)
+{
+	MPU6000 *dev = (MPU6000 *)arg;
+
+	dev->measure(dev->_drdy_timestamp);
+}
+
 void
 MPU6000::measure_trampoline(void *arg)
 {
@@ -851,7 +935,7 @@ MPU6000::measure_trampoline(void *arg)
 }
 
 void
-MPU6000::measure()
+MPU6000::measure(hrt_abstime timestamp)
 {
 #pragma pack(push, 1)
 	/**
@@ -883,6 +967,7 @@ MPU6000::measure()
 
 	/* start measuring */
 	perf_begin(_sample_perf);
+	perf_count(_sample_interval);
 
 	/*
 	 * Fetch the full set of measurements from the MPU6000 in one pass.
@@ -928,7 +1013,7 @@ MPU6000::measure()
 	/*
 	 * Adjust and scale results to m/s^2.
 	 */
-	_gyro_report.timestamp = _accel_report.timestamp = hrt_absolute_time();
+	_gyro_report.timestamp = _accel_report.timestamp = (timestamp != 0) ? timestamp : hrt_absolute_time();
 
 
 	/*
@@ -992,7 +1077,11 @@ MPU6000::measure()
 void
 MPU6000::print_info()
 {
+	perf_print_counter(_sample_perf);
+	perf_print_counter(_sample_interval);
 	printf("reads:          %u\n", _reads);
+	printf("poll interval:  %u us%s\n", _call_interval, _external ? " (DRDY)" : "");
+	hrt_call_print_info(&_call, "poll call");
 }
 
 MPU6000_gyro::MPU6000_gyro(MPU6000 *parent) :
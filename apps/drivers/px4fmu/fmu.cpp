@@ -332,12 +332,12 @@ PX4FMU::set_pwm_rate(uint32_t rate_map, unsigned default_rate, unsigned alt_rate
 			} else {
 				// set it - errors here are unexpected
 				if (alt != 0) {
-					if (up_pwm_servo_set_rate_group_update(group, _pwm_alt_rate) != OK) {
+					if (up_pwm_servo_set_rate_group_update(group, alt_rate) != OK) {
 						warn("rate group set alt failed");
 						return -EINVAL;
 					}
 				} else {
-					if (up_pwm_servo_set_rate_group_update(group, _pwm_default_rate) != OK) {
+					if (up_pwm_servo_set_rate_group_update(group, default_rate) != OK) {
 						warn("rate group set default failed");
 						return -EINVAL;
 					}
@@ -420,6 +420,10 @@ PX4FMU::task_main()
 		 * We always mix at max rate; some channels may update slower.
 		 */
 		unsigned max_rate = (_pwm_default_rate > _pwm_alt_rate) ? _pwm_default_rate : _pwm_alt_rate;
+
+		/* oneshot outputs follow the controls as fast as we take them */
+		if ((_pwm_default_rate == PWM_RATE_ONESHOT) || (_pwm_alt_rate == PWM_RATE_ONESHOT))
+			max_rate = 500;
 		if (_current_update_rate != max_rate) {
 			_current_update_rate = max_rate;
 			int update_rate_in_ms = int(1000 / _current_update_rate);
@@ -492,6 +496,9 @@ PX4FMU::task_main()
 					up_pwm_servo_set(i, outputs.output[i]);
 				}
 
+				/* send the new values now on oneshot outputs */
+				up_pwm_servo_trigger();
+
 				/* and publish for anyone that cares to see */
 				orb_publish(_primary_pwm_device ? ORB_ID_VEHICLE_CONTROLS : ORB_ID(actuator_outputs_1), _t_outputs, &outputs);
 			}
@@ -626,6 +633,7 @@ PX4FMU::pwm_ioctl(file *filp, int cmd, unsigned long arg)
 	case PWM_SERVO_SET(1):
 		if (arg < 2100) {
 			up_pwm_servo_set(cmd - PWM_SERVO_SET(0), arg);
+			up_pwm_servo_trigger();
 		} else {
 			ret = -EINVAL;
 		}
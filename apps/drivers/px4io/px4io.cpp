@@ -84,15 +84,23 @@
 #include <px4io/protocol.h>
 #include <mavlink/mavlink_log.h>
 #include "uploader.h"
+#include "px4io_serial.h"
 #include <debug.h>
 
 #define PX4IO_SET_DEBUG			_IOC(0xff00, 0)
 #define PX4IO_INAIR_RESTART_ENABLE	_IOC(0xff00, 1)
 
+/* FMU port wired to the IO serial interface */
+#define PX4IO_SERIAL_DEVICE	"/dev/ttyS2"
+
 class PX4IO : public device::I2C
 {
 public:
-	PX4IO();
+	/**
+	 * @param serial_path	Serial port to talk to IO over, or nullptr
+	 *			to use I2C.
+	 */
+	PX4IO(const char *serial_path = nullptr);
 	virtual ~PX4IO();
 
 	virtual int		init();
@@ -129,11 +137,32 @@ private:
 	int			_mavlink_fd;
 
 	perf_counter_t		_perf_update;
+	perf_counter_t		_perf_transfers;
 
 	/* cached IO state */
 	uint16_t		_status;
 	uint16_t		_alarms;
 
+	/* registers fetched by the periodic status poll */
+	uint16_t		_poll_status[4];	///< STATUS_FLAGS, STATUS_ALARMS, STATUS_VBATT, STATUS_IBATT
+	uint16_t		_poll_raw_rc[1 + RC_INPUT_MAX_CHANNELS];	///< RAW_RC_COUNT and channel values
+	uint16_t		_poll_actuators[NUM_ACTUATOR_OUTPUTS];
+	uint16_t		_poll_servos[NUM_ACTUATOR_OUTPUTS];
+
+	/* multi-page transaction being built for the current cycle */
+	bool			_bulk_supported;	///< IO implements PX4IO_PAGE_BULK
+	uint16_t		_bulk_tx[64];		///< page/offset followed by the segments
+	unsigned		_bulk_tx_len;		///< bytes used in _bulk_tx
+	unsigned		_bulk_segments;		///< segments queued in _bulk_tx
+	uint16_t		_bulk_rx[1 + PX4IO_BULK_MAX_GET_REGS];
+	struct {
+		uint16_t	*values;
+		unsigned	num_values;
+	}			_bulk_get[PX4IO_BULK_MAX_GET_SEGMENTS];
+	unsigned		_bulk_get_count;	///< GET segments queued
+	unsigned		_bulk_get_regs;		///< registers the GET segments will return
+	int			_bulk_result;		///< first error since the last commit
+
 	/* subscribed topics */
 	int			_t_actuators;	///< actuator controls topic
 	int			_t_armed;	///< system armed control topic
@@ -151,6 +180,8 @@ private:
 
 	bool			_primary_pwm_device;	///< true if we are the default PWM output
 
+	PX4IO_serial		*_serial;		///< serial transport, nullptr when using I2C
+
 
 	/**
 	 * Trampoline to the worker task
@@ -178,14 +209,22 @@ private:
 	int			io_set_rc_config();
 
 	/**
-	 * Fetch status and alarms from IO
+	 * Queue the reads for the periodic status poll.
+	 *
+	 * The results are handled by io_get_status and the io_publish_*
+	 * functions once the transaction has been committed.
+	 */
+	void			io_poll_queue();
+
+	/**
+	 * Handle status and alarms fetched by the last poll
 	 *
 	 * Also publishes battery voltage/current.
 	 */
 	int			io_get_status();
 
 	/**
-	 * Fetch RC inputs from IO.
+	 * Decode RC inputs fetched by the last poll.
 	 *
 	 * @param input_rc	Input structure to populate.
 	 * @return		OK if data was returned.
@@ -193,17 +232,17 @@ private:
 	int			io_get_raw_rc_input(rc_input_values &input_rc);
 
 	/**
-	 * Fetch and publish raw RC input data.
+	 * Publish raw RC input data fetched by the last poll.
 	 */
 	int			io_publish_raw_rc();
 
 	/**
-	 * Fetch and publish the mixed control values.
+	 * Publish the mixed control values fetched by the last poll.
 	 */
 	int			io_publish_mixed_controls();
 
 	/**
-	 * Fetch and publish the PWM servo outputs.
+	 * Publish the PWM servo outputs fetched by the last poll.
 	 */
 	int			io_publish_pwm_outputs();
 
@@ -259,6 +298,76 @@ private:
 	 */
 	int			io_reg_modify(uint8_t page, uint8_t offset, uint16_t clearbits, uint16_t setbits);
 
+	/**
+	 * queue a register write in the current transaction
+	 *
+	 * Queued operations are packed into as few PX4IO_PAGE_BULK transfers
+	 * as _max_transfer allows; a full transaction is sent early to make room.
+	 * Against IO firmware without bulk support the operation is performed
+	 * immediately.
+	 *
+	 * @param page		Register page to write to.
+	 * @param offset	Register offset to start writing at.
+	 * @param values	Pointer to array of values to write, copied when queued.
+	 * @param num_values	The number of values to write.
+	 */
+	void			io_bulk_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num_values);
+
+	/**
+	 * queue a register modify in the current transaction
+	 *
+	 * IO applies the change itself, so this does not cost a read.
+	 *
+	 * @param page		Register page to modify.
+	 * @param offset	Register offset to modify.
+	 * @param clearbits	Bits to clear in the register.
+	 * @param setbits	Bits to set in the register.
+	 */
+	void			io_bulk_modify(uint8_t page, uint8_t offset, uint16_t clearbits, uint16_t setbits);
+
+	/**
+	 * queue a register read in the current transaction
+	 *
+	 * @param page		Register page to read from.
+	 * @param offset	Register offset to start reading from.
+	 * @param values	Pointer to array where values should be stored; valid
+	 *			once io_bulk_commit has returned OK.
+	 * @param num_values	The number of values to read.
+	 */
+	void			io_bulk_get(uint8_t page, uint8_t offset, uint16_t *values, unsigned num_values);
+
+	/**
+	 * send the remainder of the current transaction
+	 *
+	 * @return		Zero if every operation queued since the last commit
+	 *			succeeded, otherwise the first error.
+	 */
+	int			io_bulk_commit();
+
+	/**
+	 * append a segment header to the current transaction
+	 *
+	 * Sends the pending transaction first if the segment would not fit.
+	 *
+	 * @param op		PX4IO_BULK_OP_*
+	 * @param data_len	Bytes that will follow the header.
+	 * @param get_regs	Registers the segment will return.
+	 * @return		The header to fill in.
+	 */
+	px4io_bulk_segment	*io_bulk_segment(uint8_t op, unsigned data_len, unsigned get_regs);
+
+	/**
+	 * send the pending transaction
+	 */
+	void			io_bulk_flush();
+
+	/**
+	 * distribute the registers returned for the GET segments
+	 *
+	 * @return		Zero if IO served every GET segment.
+	 */
+	int			io_bulk_unpack();
+
 	/**
 	 * Send mixer definition text to IO
 	 */
@@ -292,7 +401,7 @@ PX4IO	*g_dev;
 
 }
 
-PX4IO::PX4IO() :
+PX4IO::PX4IO(const char *serial_path) :
 	I2C("px4io", "/dev/px4io", PX4_I2C_BUS_ONBOARD, PX4_I2C_OBDEV_PX4IO, 320000),
 	_max_actuators(0),
 	_max_controls(0),
@@ -304,8 +413,15 @@ PX4IO::PX4IO() :
 	_task_should_exit(false),
 	_mavlink_fd(-1),
 	_perf_update(perf_alloc(PC_ELAPSED, "px4io update")),
+	_perf_transfers(perf_alloc(PC_COUNT, "px4io transfers")),
 	_status(0),
 	_alarms(0),
+	_bulk_supported(false),
+	_bulk_tx_len(2),
+	_bulk_segments(0),
+	_bulk_get_count(0),
+	_bulk_get_regs(0),
+	_bulk_result(OK),
 	_t_actuators(-1),
 	_t_armed(-1),
 	_t_vstatus(-1),
@@ -314,8 +430,12 @@ PX4IO::PX4IO() :
 	_to_actuators_effective(0),
 	_to_outputs(0),
 	_to_battery(0),
-	_primary_pwm_device(false)
+	_primary_pwm_device(false),
+	_serial(nullptr)
 {
+	if (serial_path != nullptr)
+		_serial = new PX4IO_serial(serial_path);
+
 	/* we need this potentially before it could be set in task_main */
 	g_dev = this;
 
@@ -340,6 +460,9 @@ PX4IO::~PX4IO()
 	if (_task != -1)
 		task_delete(_task);
 
+	if (_serial != nullptr)
+		delete _serial;
+
 	g_dev = nullptr;
 }
 
@@ -363,6 +486,15 @@ PX4IO::init()
 	 */
 	_retries = 2;
 
+	/* bring up the serial link if we are using it */
+	if (_serial != nullptr) {
+		ret = _serial->init();
+		if (ret != OK) {
+			log("failed to open serial link");
+			return ret;
+		}
+	}
+
 	/* get some parameters */
 	_max_actuators = io_reg_get(PX4IO_PAGE_CONFIG, PX4IO_P_CONFIG_ACTUATOR_COUNT);
 	_max_controls = io_reg_get(PX4IO_PAGE_CONFIG, PX4IO_P_CONFIG_CONTROL_COUNT);
@@ -380,6 +512,12 @@ PX4IO::init()
 	}
 	if (_max_rc_input > RC_INPUT_MAX_CHANNELS)
 		_max_rc_input = RC_INPUT_MAX_CHANNELS;
+	if (_max_actuators > NUM_ACTUATOR_OUTPUTS)
+		_max_actuators = NUM_ACTUATOR_OUTPUTS;
+
+	/* older IO firmware gets one transfer per register operation */
+	uint32_t protocol = io_reg_get(PX4IO_PAGE_CONFIG, PX4IO_P_CONFIG_PROTOCOL_VERSION);
+	_bulk_supported = (protocol != _io_reg_get_error) && (protocol >= PX4IO_PROTOCOL_VERSION_BULK);
 
 	/*
 	 * Check for IO flight state - if FMU was flagged to be in
@@ -593,6 +731,11 @@ PX4IO::task_main()
 		perf_begin(_perf_update);
 		hrt_abstime now = hrt_absolute_time();
 
+		/*
+		 * Everything below is queued into one transaction, which
+		 * normally goes to IO as a single bus transfer.
+		 */
+
 		/* if we have new control data from the ORB, handle it */
 		if (fds[0].revents & POLLIN)
 			io_set_control_state();
@@ -603,42 +746,56 @@ PX4IO::task_main()
 
 		/*
 		 * If it's time for another tick of the polling status machine,
-		 * try it now.
+		 * fetch status, alarms, raw R/C input, mixed servo controls
+		 * and PWM outputs along with the updates above.
+		 *
+		 * XXX We could fetch outputs at a reduced rate in many/most cases.
 		 */
-		if ((now - last_poll_time) >= 20000) {
+		bool poll_tick = (now - last_poll_time) >= 20000;
+
+		if (poll_tick) {
+			last_poll_time = now;
+			io_poll_queue();
+		}
+
+		/* on failure, fresh values are fetched on the next poll tick */
+		ret = io_bulk_commit();
+
+		if (poll_tick && (ret == OK)) {
 
 			/*
-			 * Pull status and alarms from IO.
+			 * Handle status and alarms from IO.
 			 */
 			io_get_status();
 
 			/*
-			 * Get raw R/C input from IO.
+			 * Publish raw R/C input from IO.
 			 */
 			io_publish_raw_rc();
 
 			/*
-			 * Fetch mixed servo controls and PWM outputs from IO.
-			 *
-			 * XXX We could do this at a reduced rate in many/most cases.
+			 * Publish mixed servo controls and PWM outputs from IO.
 			 */
 			io_publish_mixed_controls();
 			io_publish_pwm_outputs();
+		}
 
-			/*
-			 * If parameters have changed, re-send RC mappings to IO
-			 *
-			 * XXX this may be a bit spammy
-			 */
-			if (fds[3].revents & POLLIN) {
-				parameter_update_s pupdate;
+		/*
+		 * If parameters have changed, re-send RC mappings to IO
+		 *
+		 * Handled on every cycle, not just poll ticks, as poll() keeps
+		 * returning until the update has been copied.
+		 *
+		 * XXX this may be a bit spammy
+		 */
+		if (fds[3].revents & POLLIN) {
+			parameter_update_s pupdate;
 
-				/* copy to reset the notification */
-				orb_copy(ORB_ID(parameter_update), _t_param, &pupdate);
+			/* copy to reset the notification */
+			orb_copy(ORB_ID(parameter_update), _t_param, &pupdate);
 
-				/* re-upload RC input config as it may have changed */
-				io_set_rc_config();
-			}
+			/* re-upload RC input config as it may have changed */
+			io_set_rc_config();
 		}
 
 		perf_end(_perf_update);
@@ -671,7 +828,8 @@ PX4IO::io_set_control_state()
 		regs[i] = FLOAT_TO_REG(controls.control[i]);
 
 	/* copy values to registers in IO */
-	return io_reg_set(PX4IO_PAGE_CONTROLS, 0, regs, _max_controls);
+	io_bulk_set(PX4IO_PAGE_CONTROLS, 0, regs, _max_controls);
+	return OK;
 }
 
 int
@@ -702,7 +860,8 @@ PX4IO::io_set_arming_state()
 		clear |= PX4IO_P_SETUP_ARMING_MANUAL_OVERRIDE_OK;
 	}
 
-	return io_reg_modify(PX4IO_PAGE_SETUP, PX4IO_P_SETUP_ARMING, clear, set);
+	io_bulk_modify(PX4IO_PAGE_SETUP, PX4IO_P_SETUP_ARMING, clear, set);
+	return OK;
 }
 
 int
@@ -861,16 +1020,24 @@ PX4IO::io_handle_alarms(uint16_t alarms)
 	return 0;
 }
 
+void
+PX4IO::io_poll_queue()
+{
+	/* get STATUS_FLAGS, STATUS_ALARMS, STATUS_VBATT, STATUS_IBATT in that order */
+	io_bulk_get(PX4IO_PAGE_STATUS, PX4IO_P_STATUS_FLAGS, &_poll_status[0], sizeof(_poll_status) / sizeof(_poll_status[0]));
+
+	/* channel count and channel data in one read, so they cannot be out of sync */
+	io_bulk_get(PX4IO_PAGE_RAW_RC_INPUT, PX4IO_P_RAW_RC_COUNT, &_poll_raw_rc[0], 1 + _max_rc_input);
+
+	io_bulk_get(PX4IO_PAGE_ACTUATORS, 0, &_poll_actuators[0], _max_actuators);
+	io_bulk_get(PX4IO_PAGE_SERVOS, 0, &_poll_servos[0], _max_actuators);
+}
+
 int
 PX4IO::io_get_status()
 {
-	uint16_t	regs[4];
-	int		ret;
-
-	/* get STATUS_FLAGS, STATUS_ALARMS, STATUS_VBATT, STATUS_IBATT in that order */
-	ret = io_reg_get(PX4IO_PAGE_STATUS, PX4IO_P_STATUS_FLAGS, &regs[0], sizeof(regs) / sizeof(regs[0]));
-	if (ret != OK)
-		return ret;
+	uint16_t	*regs = &_poll_status[0];
+	int		ret = OK;
 
 	io_handle_status(regs[0]);
 	io_handle_alarms(regs[1]);
@@ -910,30 +1077,17 @@ PX4IO::io_get_raw_rc_input(rc_input_values &input_rc)
 	input_rc.input_source = RC_INPUT_SOURCE_UNKNOWN;
 	
 	/*
-	 * XXX Because the channel count and channel data are fetched
-	 *     separately, there is a risk of a race between the two
-	 *     that could leave us with channel data and a count that 
-	 *     are out of sync.
-	 *     Fixing this would require a guarantee of atomicity from
-	 *     IO, and a single fetch for both count and channels.
-	 *
 	 * XXX Since IO has the input calibration info, we ought to be
 	 *     able to get the pre-fixed-up controls directly.
-	 *
-	 * XXX can we do this more cheaply? If we knew we had DMA, it would
-	 *     almost certainly be better to just get all the inputs...
 	 */
-	channel_count =  io_reg_get(PX4IO_PAGE_RAW_RC_INPUT, PX4IO_P_RAW_RC_COUNT);
-	if (channel_count == _io_reg_get_error)
-		return -EIO;
-	if (channel_count > RC_INPUT_MAX_CHANNELS)
-		channel_count = RC_INPUT_MAX_CHANNELS;
+	channel_count = _poll_raw_rc[PX4IO_P_RAW_RC_COUNT];
+	if (channel_count > _max_rc_input)
+		channel_count = _max_rc_input;
 	input_rc.channel_count = channel_count;
 
 	if (channel_count > 0) {
-		ret = io_reg_get(PX4IO_PAGE_RAW_RC_INPUT, PX4IO_P_RAW_RC_BASE, input_rc.values, channel_count);
-		if (ret == OK)
-			input_rc.timestamp = hrt_absolute_time();
+		memcpy(&input_rc.values[0], &_poll_raw_rc[PX4IO_P_RAW_RC_BASE], channel_count * sizeof(input_rc.values[0]));
+		input_rc.timestamp = hrt_absolute_time();
 	}
 
 	return ret;
@@ -990,11 +1144,8 @@ PX4IO::io_publish_mixed_controls()
 	actuator_controls_effective_s controls_effective;
 	controls_effective.timestamp = hrt_absolute_time();
 
-	/* get actuator controls from IO */
-	uint16_t act[_max_actuators];
-	int ret = io_reg_get(PX4IO_PAGE_ACTUATORS, 0, act, _max_actuators);
-	if (ret != OK)
-		return ret;
+	/* actuator controls fetched from IO */
+	uint16_t *act = &_poll_actuators[0];
 
 	/* convert from register format to float */
 	for (unsigned i = 0; i < _max_actuators; i++)
@@ -1028,11 +1179,8 @@ PX4IO::io_publish_pwm_outputs()
 	actuator_outputs_s outputs;
 	outputs.timestamp = hrt_absolute_time();
 
-	/* get servo values from IO */
-	uint16_t ctl[_max_actuators];
-	int ret = io_reg_get(PX4IO_PAGE_SERVOS, 0, ctl, _max_actuators);
-	if (ret != OK)
-		return ret;
+	/* servo values fetched from IO */
+	uint16_t *ctl = &_poll_servos[0];
 
 	/* convert from register format to float */
 	for (unsigned i = 0; i < _max_actuators; i++)
@@ -1059,6 +1207,12 @@ PX4IO::io_publish_pwm_outputs()
 int
 PX4IO::io_reg_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num_values)
 {
+	/* the serial transport splits long writes itself */
+	if (_serial != nullptr) {
+		perf_count(_perf_transfers);
+		return _serial->set_regs(page, offset, values, num_values);
+	}
+
 	/* range check the transfer */
 	if (num_values > ((_max_transfer) / sizeof(*values))) {
 		debug("io_reg_set: too many registers (%u, max %u)", num_values, _max_transfer / 2);
@@ -1080,6 +1234,7 @@ PX4IO::io_reg_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned
 	msgv[1].length = num_values * sizeof(*values);
 
 	/* perform the transfer */
+	perf_count(_perf_transfers);
 	int ret = transfer(msgv, 2);
 	if (ret != OK)
 		debug("io_reg_set: error %d", ret);
@@ -1095,6 +1250,11 @@ PX4IO::io_reg_set(uint8_t page, uint8_t offset, uint16_t value)
 int
 PX4IO::io_reg_get(uint8_t page, uint8_t offset, uint16_t *values, unsigned num_values)
 {
+	if (_serial != nullptr) {
+		perf_count(_perf_transfers);
+		return _serial->get_regs(page, offset, values, num_values);
+	}
+
 	/* set up the transfer */
 	uint8_t		addr[2] = {
 		page,
@@ -1110,6 +1270,7 @@ PX4IO::io_reg_get(uint8_t page, uint8_t offset, uint16_t *values, unsigned num_v
 	msgv[1].length = num_values * sizeof(*values);
 
 	/* perform the transfer */
+	perf_count(_perf_transfers);
 	int ret = transfer(msgv, 2);
 	if (ret != OK)
 		debug("io_reg_get: data error %d", ret);
@@ -1142,6 +1303,214 @@ PX4IO::io_reg_modify(uint8_t page, uint8_t offset, uint16_t clearbits, uint16_t
 	return io_reg_set(page, offset, value);
 }
 
+px4io_bulk_segment *
+PX4IO::io_bulk_segment(uint8_t op, unsigned data_len, unsigned get_regs)
+{
+	unsigned max_len = _max_transfer + 2;
+
+	if (max_len > sizeof(_bulk_tx))
+		max_len = sizeof(_bulk_tx);
+
+	/* won't fit even in an empty transaction */
+	if (((2 + sizeof(px4io_bulk_segment) + data_len) > max_len) ||
+	    (get_regs > PX4IO_BULK_MAX_GET_REGS))
+		return nullptr;
+
+	/* make room by sending what we have so far */
+	if (((_bulk_tx_len + sizeof(px4io_bulk_segment) + data_len) > max_len) ||
+	    ((op == PX4IO_BULK_OP_GET) && (_bulk_get_count >= PX4IO_BULK_MAX_GET_SEGMENTS)) ||
+	    ((_bulk_get_regs + get_regs) > PX4IO_BULK_MAX_GET_REGS))
+		io_bulk_flush();
+
+	px4io_bulk_segment *seg = (px4io_bulk_segment *)((uint8_t *)&_bulk_tx[0] + _bulk_tx_len);
+
+	seg->op = op;
+	_bulk_tx_len += sizeof(px4io_bulk_segment) + data_len;
+	_bulk_segments++;
+
+	return seg;
+}
+
+void
+PX4IO::io_bulk_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num_values)
+{
+	px4io_bulk_segment *seg = nullptr;
+
+	if (_bulk_supported)
+		seg = io_bulk_segment(PX4IO_BULK_OP_SET, num_values * sizeof(*values), 0);
+
+	if (seg == nullptr) {
+		int ret = io_reg_set(page, offset, values, num_values);
+
+		if (_bulk_result == OK)
+			_bulk_result = ret;
+
+		return;
+	}
+
+	seg->page = page;
+	seg->offset = offset;
+	seg->count = num_values;
+	memcpy(&seg->values[0], values, num_values * sizeof(*values));
+}
+
+void
+PX4IO::io_bulk_modify(uint8_t page, uint8_t offset, uint16_t clearbits, uint16_t setbits)
+{
+	px4io_bulk_segment *seg = nullptr;
+
+	if (_bulk_supported)
+		seg = io_bulk_segment(PX4IO_BULK_OP_MODIFY, 2 * sizeof(uint16_t), 0);
+
+	if (seg == nullptr) {
+		int ret = io_reg_modify(page, offset, clearbits, setbits);
+
+		if (_bulk_result == OK)
+			_bulk_result = ret;
+
+		return;
+	}
+
+	seg->page = page;
+	seg->offset = offset;
+	seg->count = 1;
+	seg->values[0] = clearbits;
+	seg->values[1] = setbits;
+}
+
+void
+PX4IO::io_bulk_get(uint8_t page, uint8_t offset, uint16_t *values, unsigned num_values)
+{
+	px4io_bulk_segment *seg = nullptr;
+
+	if (_bulk_supported)
+		seg = io_bulk_segment(PX4IO_BULK_OP_GET, 0, num_values);
+
+	if (seg == nullptr) {
+		int ret = io_reg_get(page, offset, values, num_values);
+
+		if (_bulk_result == OK)
+			_bulk_result = ret;
+
+		return;
+	}
+
+	seg->page = page;
+	seg->offset = offset;
+	seg->count = num_values;
+
+	_bulk_get[_bulk_get_count].values = values;
+	_bulk_get[_bulk_get_count].num_values = num_values;
+	_bulk_get_count++;
+	_bulk_get_regs += num_values;
+}
+
+int
+PX4IO::io_bulk_unpack()
+{
+	uint16_t failed = _bulk_rx[0];
+	unsigned index = 1;
+	int ret = OK;
+
+	for (unsigned i = 0; i < _bulk_get_count; i++) {
+		if (failed & (1 << i))
+			ret = -EIO;
+
+		memcpy(_bulk_get[i].values, &_bulk_rx[index], _bulk_get[i].num_values * sizeof(_bulk_rx[0]));
+		index += _bulk_get[i].num_values;
+	}
+
+	return ret;
+}
+
+void
+PX4IO::io_bulk_flush()
+{
+	int ret = OK;
+
+	if (_bulk_segments == 0)
+		return;
+
+	px4io_bulk_segment *seg = (px4io_bulk_segment *)((uint8_t *)&_bulk_tx[0] + 2);
+
+	if ((_bulk_segments == 1) && (seg->op == PX4IO_BULK_OP_SET)) {
+
+		/* a lone write is cheaper as a plain register write */
+		ret = io_reg_set(seg->page, seg->offset, &seg->values[0], seg->count);
+
+	} else if (_serial != nullptr) {
+		PX4IO_serial::Request rq[2];
+
+		/* the bulk write and the read of its GET segments, pipelined */
+		rq[0].write = true;
+		rq[0].page = PX4IO_PAGE_BULK;
+		rq[0].offset = 0;
+		rq[0].count = (_bulk_tx_len - 2) / 2;
+		rq[0].values = &_bulk_tx[1];
+
+		rq[1].write = false;
+		rq[1].page = PX4IO_PAGE_BULK;
+		rq[1].offset = 0;
+		rq[1].count = 1 + _bulk_get_regs;
+		rq[1].values = &_bulk_rx[0];
+
+		perf_count(_perf_transfers);
+		ret = _serial->transfer(&rq[0], (_bulk_get_count > 0) ? 2 : 1);
+
+		if ((ret == OK) && (_bulk_get_count > 0))
+			ret = io_bulk_unpack();
+
+	} else {
+		uint8_t *addr = (uint8_t *)&_bulk_tx[0];
+		i2c_msg_s msgv[2];
+		unsigned msgs = 1;
+
+		addr[0] = PX4IO_PAGE_BULK;
+		addr[1] = 0;
+
+		msgv[0].flags = 0;
+		msgv[0].buffer = addr;
+		msgv[0].length = _bulk_tx_len;
+
+		/* read back the failure mask and the GET segments */
+		if (_bulk_get_count > 0) {
+			msgv[1].flags = I2C_M_READ;
+			msgv[1].buffer = (uint8_t *)&_bulk_rx[0];
+			msgv[1].length = (1 + _bulk_get_regs) * sizeof(_bulk_rx[0]);
+			msgs++;
+		}
+
+		perf_count(_perf_transfers);
+		ret = transfer(msgv, msgs);
+
+		if (ret != OK) {
+			debug("io_bulk_flush: error %d", ret);
+
+		} else if (_bulk_get_count > 0) {
+			ret = io_bulk_unpack();
+		}
+	}
+
+	if (_bulk_result == OK)
+		_bulk_result = ret;
+
+	_bulk_tx_len = 2;
+	_bulk_segments = 0;
+	_bulk_get_count = 0;
+	_bulk_get_regs = 0;
+}
+
+int
+PX4IO::io_bulk_commit()
+{
+	io_bulk_flush();
+
+	int ret = _bulk_result;
+	_bulk_result = OK;
+
+	return ret;
+}
+
 int
 PX4IO::mixer_send(const char *buf, unsigned buflen)
 {
@@ -1211,6 +1580,9 @@ PX4IO::print_status()
 		io_reg_get(PX4IO_PAGE_CONFIG, PX4IO_P_CONFIG_SOFTWARE_VERSION),
 		io_reg_get(PX4IO_PAGE_CONFIG, PX4IO_P_CONFIG_BOOTLOADER_VERSION),
 		io_reg_get(PX4IO_PAGE_CONFIG, PX4IO_P_CONFIG_MAX_TRANSFER));
+	printf("%s transfers\n", _bulk_supported ? "bulk" : "per-register");
+	if (_serial != nullptr)
+		_serial->print_status();
 	printf("%u controls %u actuators %u R/C inputs %u analog inputs %u relays\n",
 		io_reg_get(PX4IO_PAGE_CONFIG, PX4IO_P_CONFIG_CONTROL_COUNT),
 		io_reg_get(PX4IO_PAGE_CONFIG, PX4IO_P_CONFIG_ACTUATOR_COUNT),
@@ -1336,7 +1708,7 @@ PX4IO::ioctl(file *filep, int cmd, unsigned long arg)
 
 	case PWM_SERVO_SET_UPDATE_RATE:
 		/* set the requested alternate rate */
-		if ((arg >= 50) && (arg <= 400)) {	/* TODO: we could go higher for e.g. TurboPWM */
+		if (((arg >= 50) && (arg <= 400)) || (arg == PWM_RATE_ONESHOT)) {	/* TODO: we could go higher for e.g. TurboPWM */
 			ret = io_reg_set(PX4IO_PAGE_SETUP, PX4IO_P_SETUP_PWM_ALTRATE, arg);
 		} else {
 			ret = -EINVAL;
@@ -1537,8 +1909,14 @@ start(int argc, char *argv[])
 	if (g_dev != nullptr)
 		errx(1, "already loaded");
 
+	const char *serial_path = nullptr;
+
+	/* px4io start serial [device] talks to IO over a UART instead of I2C */
+	if ((argc > 1) && !strcmp(argv[1], "serial"))
+		serial_path = (argc > 2) ? argv[2] : PX4IO_SERIAL_DEVICE;
+
 	/* create the driver - it will set g_dev */
-	(void)new PX4IO();
+	(void)new PX4IO(serial_path);
 
 	if (g_dev == nullptr)
 		errx(1, "driver alloc failed");
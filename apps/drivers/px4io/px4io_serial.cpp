@@ -0,0 +1,399 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file px4io_serial.cpp
+ *
+ * Serial transport for the PX4IO register protocol.
+ */
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <drivers/drv_hrt.h>
+
+#include "px4io_serial.h"
+
+/* time allowed for IO to answer a window of requests */
+#define PX4IO_SERIAL_TIMEOUT	10000	/* usec */
+
+PX4IO_serial::PX4IO_serial(const char *path) :
+	retries(2),
+	_path(strdup(path)),
+	_fd(-1),
+	_stream(nullptr),
+	_seq(0),
+	_window(nullptr),
+	_window_size(0),
+	_window_pending(0),
+	_pc_txns(perf_alloc(PC_ELAPSED, "px4io serial txn")),
+	_pc_timeouts(perf_alloc(PC_COUNT, "px4io serial timeouts")),
+	_pc_errors(perf_alloc(PC_COUNT, "px4io serial errors"))
+{
+	sem_init(&_lock, 0, 1);
+}
+
+PX4IO_serial::~PX4IO_serial()
+{
+	if (_stream != nullptr)
+		hx_stream_free(_stream);
+
+	if (_fd >= 0)
+		close(_fd);
+
+	perf_free(_pc_txns);
+	perf_free(_pc_timeouts);
+	perf_free(_pc_errors);
+
+	free((void *)_path);
+	sem_destroy(&_lock);
+}
+
+int
+PX4IO_serial::init()
+{
+	_fd = open(_path, O_RDWR | O_NOCTTY);
+
+	if (_fd < 0)
+		return -errno;
+
+	/* raw 8N1 at the link rate */
+	struct termios t;
+
+	tcgetattr(_fd, &t);
+	t.c_iflag &= ~(ICRNL | IGNCR | INLCR | IXON);
+	t.c_oflag &= ~(OPOST | ONLCR);
+	t.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+	t.c_cflag &= ~(CSTOPB | PARENB);
+	cfsetispeed(&t, B1500000);
+	cfsetospeed(&t, B1500000);
+
+	if (tcsetattr(_fd, TCSANOW, &t) < 0)
+		return -errno;
+
+	/* replies are decoded as they are read; see rx_callback */
+	_stream = hx_stream_init(_fd, &PX4IO_serial::rx_callback_trampoline, this);
+
+	if (_stream == nullptr)
+		return -ENOMEM;
+
+	hx_stream_set_counters(_stream,
+			       perf_alloc(PC_COUNT, "px4io serial tx frames"),
+			       perf_alloc(PC_COUNT, "px4io serial rx frames"),
+			       perf_alloc(PC_COUNT, "px4io serial rx errors"));
+
+	return OK;
+}
+
+int
+PX4IO_serial::transfer(Request *requests, unsigned num_requests)
+{
+	int ret = OK;
+
+	sem_wait(&_lock);
+	perf_begin(_pc_txns);
+
+	for (unsigned i = 0; i < num_requests; i++)
+		requests[i].result = -ETIMEDOUT;
+
+	for (unsigned attempt = 0; attempt <= retries; attempt++) {
+		Request *rq = requests;
+		unsigned resid = num_requests;
+		bool again = false;
+
+		/* skip over answered requests, batch up the rest */
+		while (resid > 0) {
+			if (rq->result != -ETIMEDOUT) {
+				rq++;
+				resid--;
+				continue;
+			}
+
+			unsigned sent = send_window(rq, resid);
+
+			/* cannot be encoded at all */
+			if (sent == 0) {
+				rq->result = -EINVAL;
+				continue;
+			}
+
+			wait_window();
+
+			/*
+			 * IO applies requests in the order it receives them, so a
+			 * lost request has to be repeated together with everything
+			 * sent after it, and nothing more may go out before that.
+			 */
+			for (unsigned i = 0; i < sent; i++) {
+				if (rq[i].result == -ETIMEDOUT) {
+					for (unsigned j = i + 1; j < sent; j++)
+						rq[j].result = -ETIMEDOUT;
+
+					again = true;
+					break;
+				}
+			}
+
+			if (again)
+				break;
+
+			rq += sent;
+			resid -= sent;
+		}
+
+		if (!again)
+			break;
+
+		perf_count(_pc_timeouts);
+	}
+
+	for (unsigned i = 0; i < num_requests; i++) {
+		if (requests[i].result != OK) {
+			ret = requests[i].result;
+			break;
+		}
+	}
+
+	perf_end(_pc_txns);
+	sem_post(&_lock);
+
+	return ret;
+}
+
+unsigned
+PX4IO_serial::send_window(Request *requests, unsigned num_requests)
+{
+	union {
+		px4io_serial_frame	frame;
+		uint8_t			bytes[sizeof(px4io_serial_frame) + PX4IO_SERIAL_MAX_REGS * 2];
+	} request;
+	unsigned tx_len = 0;
+	unsigned reply_len = 0;
+	unsigned sent = 0;
+
+	/*
+	 * Consecutive unanswered requests go out back to back as long as
+	 * IO has room to queue all of the replies and we have room to
+	 * encode them; an answered request ends the window.
+	 */
+	while ((sent < num_requests) && (requests[sent].result == -ETIMEDOUT)) {
+		Request &rq = requests[sent];
+		unsigned len = sizeof(request.frame);
+
+		if ((reply_len + reply_size(rq)) > PX4IO_SERIAL_REPLY_QUEUE)
+			break;
+
+		request.frame.seq = rq.seq = _seq++;
+		request.frame.page = rq.page;
+		request.frame.offset = rq.offset;
+
+		if (rq.write) {
+			request.frame.code = PX4IO_SERIAL_WRITE | rq.count;
+			memcpy(&request.frame.regs[0], rq.values, rq.count * 2);
+			len += rq.count * 2;
+
+		} else {
+			request.frame.code = PX4IO_SERIAL_READ | rq.count;
+		}
+
+		ssize_t enc = hx_stream_encode(&_tx_buf[tx_len], sizeof(_tx_buf) - tx_len, &request, len);
+
+		if (enc < 0)
+			break;
+
+		tx_len += enc;
+		reply_len += reply_size(rq);
+		sent++;
+	}
+
+	_window = requests;
+	_window_size = sent;
+	_window_pending = sent;
+
+	/* the whole window in one write, so the driver can DMA it out */
+	if (::write(_fd, &_tx_buf[0], tx_len) != (ssize_t)tx_len)
+		perf_count(_pc_errors);
+
+	return sent;
+}
+
+void
+PX4IO_serial::wait_window()
+{
+	hrt_abstime deadline = hrt_absolute_time() + PX4IO_SERIAL_TIMEOUT;
+
+	while (_window_pending > 0) {
+		hrt_abstime now = hrt_absolute_time();
+
+		if (now >= deadline)
+			break;
+
+		pollfd fds[1];
+		fds[0].fd = _fd;
+		fds[0].events = POLLIN;
+
+		/* round up, poll() would otherwise spin for the last millisecond */
+		if (::poll(&fds[0], 1, (deadline - now + 999) / 1000) <= 0)
+			continue;
+
+		uint8_t buf[64];
+		ssize_t count = ::read(_fd, &buf[0], sizeof(buf));
+
+		for (ssize_t i = 0; i < count; i++)
+			hx_stream_rx(_stream, buf[i]);
+	}
+
+	_window = nullptr;
+	_window_size = 0;
+	_window_pending = 0;
+}
+
+void
+PX4IO_serial::rx_callback_trampoline(void *arg, const void *data, size_t length)
+{
+	reinterpret_cast<PX4IO_serial *>(arg)->rx_callback(data, length);
+}
+
+void
+PX4IO_serial::rx_callback(const void *data, size_t length)
+{
+	const px4io_serial_frame *reply = (const px4io_serial_frame *)data;
+
+	if (length < sizeof(*reply))
+		return;
+
+	/* find the request this answers; stale replies match nothing */
+	for (unsigned i = 0; i < _window_size; i++) {
+		Request &rq = _window[i];
+
+		if ((rq.seq != reply->seq) || (rq.result != -ETIMEDOUT))
+			continue;
+
+		if ((reply->code & PX4IO_SERIAL_CODE_MASK) != PX4IO_SERIAL_OK) {
+			perf_count(_pc_errors);
+			rq.result = -EINVAL;
+
+		} else if (rq.write) {
+			rq.result = OK;
+
+		} else if (((reply->code & PX4IO_SERIAL_COUNT_MASK) != rq.count) ||
+			   (length != (sizeof(*reply) + rq.count * 2u))) {
+			perf_count(_pc_errors);
+			rq.result = -EIO;
+
+		} else {
+			memcpy(rq.values, &reply->regs[0], rq.count * 2);
+			rq.result = OK;
+		}
+
+		_window_pending--;
+		break;
+	}
+}
+
+unsigned
+PX4IO_serial::reply_size(const Request &rq)
+{
+	return HX_STREAM_MAX_ENCODED(sizeof(px4io_serial_frame) + (rq.write ? 0 : rq.count * 2));
+}
+
+int
+PX4IO_serial::set_regs(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num_values)
+{
+	Request requests[(255 + PX4IO_SERIAL_MAX_REGS - 1) / PX4IO_SERIAL_MAX_REGS];
+	unsigned n = 0;
+
+	while (num_values > 0) {
+		unsigned count = (num_values > PX4IO_SERIAL_MAX_REGS) ? PX4IO_SERIAL_MAX_REGS : num_values;
+
+		if ((n >= (sizeof(requests) / sizeof(requests[0]))) || ((offset + count) > 255))
+			return -EINVAL;
+
+		requests[n].write = true;
+		requests[n].page = page;
+		requests[n].offset = offset;
+		requests[n].count = count;
+		requests[n].values = const_cast<uint16_t *>(values);
+		n++;
+
+		offset += count;
+		values += count;
+		num_values -= count;
+	}
+
+	return transfer(&requests[0], n);
+}
+
+int
+PX4IO_serial::get_regs(uint8_t page, uint8_t offset, uint16_t *values, unsigned num_values)
+{
+	Request requests[(255 + PX4IO_SERIAL_MAX_REGS - 1) / PX4IO_SERIAL_MAX_REGS];
+	unsigned n = 0;
+
+	while (num_values > 0) {
+		unsigned count = (num_values > PX4IO_SERIAL_MAX_REGS) ? PX4IO_SERIAL_MAX_REGS : num_values;
+
+		if ((n >= (sizeof(requests) / sizeof(requests[0]))) || ((offset + count) > 255))
+			return -EINVAL;
+
+		requests[n].write = false;
+		requests[n].page = page;
+		requests[n].offset = offset;
+		requests[n].count = count;
+		requests[n].values = values;
+		n++;
+
+		offset += count;
+		values += count;
+		num_values -= count;
+	}
+
+	return transfer(&requests[0], n);
+}
+
+void
+PX4IO_serial::print_status()
+{
+	printf("serial link %s at %u bps\n", _path, PX4IO_SERIAL_BITRATE);
+	perf_print_counter(_pc_txns);
+	perf_print_counter(_pc_timeouts);
+	perf_print_counter(_pc_errors);
+}
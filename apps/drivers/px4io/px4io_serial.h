@@ -0,0 +1,159 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file px4io_serial.h
+ *
+ * Serial transport for the PX4IO register protocol.
+ *
+ * Register requests are carried in hx_stream frames (see
+ * struct px4io_serial_frame) and may be pipelined: a batch of requests
+ * is written in one go and the replies are matched by sequence number.
+ *
+ * Only POSIX file operations are used, so the transport can be exercised
+ * on a host over a pty pair.
+ */
+
+#ifndef _PX4IO_SERIAL_H
+#define _PX4IO_SERIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <semaphore.h>
+
+#include <systemlib/hx_stream.h>
+#include <systemlib/perf_counter.h>
+#include <px4io/protocol.h>
+
+class PX4IO_serial
+{
+public:
+	/**
+	 * One register request in a batch.
+	 */
+	struct Request {
+		bool		write;		/**< write values rather than read them */
+		uint8_t		page;
+		uint8_t		offset;
+		uint8_t		count;		/**< at most PX4IO_SERIAL_MAX_REGS */
+		uint16_t	*values;
+		int		result;		/**< OK, or -errno once transfer returns */
+		uint8_t		seq;		/**< internal */
+	};
+
+	/**
+	 * @param path		Serial port connected to IO.
+	 */
+	PX4IO_serial(const char *path);
+	virtual ~PX4IO_serial();
+
+	/**
+	 * Open and configure the serial port.
+	 *
+	 * @return		OK, or -errno on failure.
+	 */
+	int			init();
+
+	/**
+	 * Perform a batch of requests.
+	 *
+	 * Requests are sent back to back, as many at a time as IO can queue
+	 * replies for, and are applied by IO in order. A request that is not
+	 * answered is retried together with the requests sent after it, so
+	 * that the order is kept.
+	 *
+	 * @param requests	The requests; each result is updated.
+	 * @param num_requests	The number of requests.
+	 * @return		OK if all requests succeeded, otherwise the
+	 *			first error.
+	 */
+	int			transfer(Request *requests, unsigned num_requests);
+
+	/**
+	 * Write registers, split into as many pipelined requests as needed.
+	 */
+	int			set_regs(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num_values);
+
+	/**
+	 * Read registers, split into as many pipelined requests as needed.
+	 */
+	int			get_regs(uint8_t page, uint8_t offset, uint16_t *values, unsigned num_values);
+
+	/**
+	 * Print link statistics.
+	 */
+	void			print_status();
+
+	/** number of times a transfer resends lost requests before giving up */
+	unsigned		retries;
+
+private:
+	const char		*_path;
+	int			_fd;
+	hx_stream_t		_stream;
+	sem_t			_lock;
+	uint8_t			_seq;
+
+	/** requests currently waiting for a reply */
+	Request			*_window;
+	unsigned		_window_size;
+	unsigned		_window_pending;
+
+	uint8_t			_tx_buf[HX_STREAM_MAX_ENCODED(HX_STREAM_MAX_FRAME) * 4];
+
+	perf_counter_t		_pc_txns;
+	perf_counter_t		_pc_timeouts;
+	perf_counter_t		_pc_errors;
+
+	/**
+	 * Send up to num_requests requests and wait for their replies.
+	 *
+	 * @return		The number of requests that were sent.
+	 */
+	unsigned		send_window(Request *requests, unsigned num_requests);
+
+	/**
+	 * Wait until the current window has been answered or has timed out.
+	 */
+	void			wait_window();
+
+	static void		rx_callback_trampoline(void *arg, const void *data, size_t length);
+	void			rx_callback(const void *data, size_t length);
+
+	/**
+	 * Worst-case encoded size of the reply to a request.
+	 */
+	static unsigned		reply_size(const Request &rq);
+};
+
+#endif
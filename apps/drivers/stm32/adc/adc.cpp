@@ -38,6 +38,11 @@
  *
  * This is a low-rate driver, designed for sampling things like voltages
  * and so forth. It avoids the gross complexity of the NuttX ADC driver.
+ *
+ * The channel set is scanned continuously with the results DMA'd into a
+ * circular buffer; blocks of scans are averaged in the DMA completion
+ * handler, so readers get filtered, timestamped values without any
+ * per-sample work.
  */
 
 #include <nuttx/config.h>
@@ -60,10 +65,15 @@
 #include <arch/stm32/chip.h>
 #include <stm32_internal.h>
 #include <stm32_gpio.h>
+#include <stm32_dma.h>
 
 #include <systemlib/err.h>
 #include <systemlib/perf_counter.h>
 
+#ifndef DMAMAP_ADC1_1
+# error ADC1 DMA mapping not defined for this chip
+#endif
+
 /*
  * Register accessors.
  * For now, no reason not to just use ADC1.
@@ -95,6 +105,24 @@
 # define rCCR		REG(STM32_ADC_CCR_OFFSET)
 #endif
 
+/*
+ * Scan timing.
+ *
+ * A scan of the whole channel set is started every ADC_SCAN_INTERVAL and
+ * DMA'd into a circular buffer holding two blocks of ADC_BLOCK_SCANS scans.
+ * Each completed block is averaged into a report, giving 100Hz reports.
+ */
+#define ADC_SCAN_INTERVAL	1000	/* microseconds */
+#define ADC_BLOCK_SCANS		10
+
+/*
+ * DMA target buffer.
+ *
+ * Static so that it lands in main SRAM; the heap may include CCM, which
+ * the DMA controller cannot reach.
+ */
+static uint16_t	adc_dma_buffer[2 * ADC_BLOCK_SCANS * ADC_REPORT_MAX_CHANNELS];
+
 class ADC : public device::CDev
 {
 public:
@@ -106,72 +134,88 @@ public:
 	virtual int		ioctl(file *filp, int cmd, unsigned long arg);
 	virtual ssize_t		read(file *filp, char *buffer, size_t len);
 
+	/**
+	 * Diagnostics - print some basic information about the driver.
+	 */
+	void			print_info();
+
 protected:
 	virtual int		open_first(struct file *filp);
 	virtual int		close_last(struct file *filp);
 
 private:
-	static const hrt_abstime _tickrate = 10000;	/**< 100Hz base rate */
-	
 	hrt_call		_call;
-	perf_counter_t		_sample_perf;
+	DMA_HANDLE		_dma;
+	perf_counter_t		_block_perf;
+	perf_counter_t		_overruns;
 
 	unsigned		_channel_count;
-	adc_msg_s		*_samples;		/**< sample buffer */
+	adc_report		_report;		/**< latest averaged block */
 
-	/** work trampoline */
+	/** hrt trampoline */
 	static void		_tick_trampoline(void *arg);
 
-	/** worker function */
+	/** start a scan of the channel set */
 	void			_tick();
 
+	/** DMA completion trampoline */
+	static void		_dma_trampoline(DMA_HANDLE handle, uint8_t status, void *arg);
+
 	/**
-	 * Sample a single channel and return the measured value.
+	 * Average a completed block of scans into the report.
 	 *
-	 * @param channel		The channel to sample.
-	 * @return			The sampled value, or 0xffff if
-	 *				sampling failed.
+	 * @param block		The half of the DMA buffer (0 or 1) that was filled.
 	 */
-	uint16_t		_sample(unsigned channel);
+	void			_block_done(unsigned block);
+
+	/**
+	 * (Re)start the circular DMA transfer, aligned with the start of a scan.
+	 */
+	void			_dma_start();
 
 };
 
 ADC::ADC(uint32_t channels) :
 	CDev("adc", ADC_DEVICE_PATH),
-	_sample_perf(perf_alloc(PC_ELAPSED, "ADC samples")),
-	_channel_count(0),
-	_samples(nullptr)
+	_dma(nullptr),
+	_block_perf(perf_alloc(PC_ELAPSED, "ADC block")),
+	_overruns(perf_alloc(PC_COUNT, "ADC overruns")),
+	_channel_count(0)
 {
 	_debug_enabled = true;
 
+	memset(&_call, 0, sizeof(_call));
+	memset(&_report, 0, sizeof(_report));
+
 	/* always enable the temperature sensor */
 	channels |= 1 << 16;
 
-	/* allocate the sample array */
+	/* build the channel list, in scan order */
 	for (unsigned i = 0; i < 32; i++) {
 		if (channels & (1 << i)) {
-			_channel_count++;
-		}
-	}
-	_samples = new adc_msg_s[_channel_count];
-
-	/* prefill the channel numbers in the sample array */
-	if (_samples != nullptr) {
-		unsigned index = 0;
-		for (unsigned i = 0; i < 32; i++) {
-			if (channels & (1 << i)) {
-				_samples[index].am_channel = i;
-				_samples[index].am_data = 0;
-				index++;
+			if (_channel_count == ADC_REPORT_MAX_CHANNELS) {
+				log("too many channels, ignoring channel %u and up", i);
+				break;
 			}
+
+			_report.channel[_channel_count++] = i;
 		}
 	}
+
+	_report.channel_count = _channel_count;
 }
 
 ADC::~ADC()
 {
-	if (_samples != nullptr)
-		delete _samples;
+	hrt_cancel(&_call);
+
+	if (_dma != nullptr) {
+		stm32_dmastop(_dma);
+		stm32_dmafree(_dma);
+	}
+
+	perf_free(_block_perf);
+	perf_free(_overruns);
 }
 
 int
@@ -205,10 +249,10 @@ ADC::init()
 	rCCR = ADC_CCR_TSVREFE;
 #endif
 
-	/* configure for a single-channel sequence */
+	/* configure for a single-channel sequence for the self-test */
 	rSQR1 = 0;
 	rSQR2 = 0;
-	rSQR3 = 0;	/* will be updated with the channel each tick */ 
+	rSQR3 = 0;
 
 	/* power-cycle the ADC and turn it on */
 	rCR2 &= ~ADC_CR2_ADON;
@@ -227,10 +271,39 @@ ADC::init()
 		if ((hrt_absolute_time() - now) > 500) {
 			log("sample timeout");
 			return -1;
-			return 0xffff;
 		}
 	}
+	(void)rDR;
+
+	/* program the scan sequence, five bits per slot */
+	rSQR1 = (_channel_count - 1) << ADC_SQR1_L_SHIFT;
+	rSQR2 = 0;
+	rSQR3 = 0;
+
+	for (unsigned i = 0; i < _channel_count; i++) {
+		uint32_t channel = _report.channel[i];
 
+		if (i < 6) {
+			rSQR3 |= channel << (5 * i);
+
+		} else if (i < 12) {
+			rSQR2 |= channel << (5 * (i - 6));
+
+		} else {
+			rSQR1 |= channel << (5 * (i - 12));
+		}
+	}
+
+	/* scan the sequence on each trigger, hand each result to the DMA */
+	rCR1 = ADC_CR1_SCAN;
+	rCR2 |= ADC_CR2_DMA | ADC_CR2_DDS;
+
+	_dma = stm32_dmachannel(DMAMAP_ADC1_1);
+
+	if (_dma == nullptr) {
+		log("no DMA channel");
+		return -EBUSY;
+	}
 
 	debug("init done");
 
@@ -241,33 +314,58 @@ ADC::init()
 int
 ADC::ioctl(file *filp, int cmd, unsigned long arg)
 {
-	return -ENOTTY;
+	switch (cmd) {
+	case ADC_GET_REPORT: {
+			/* block interrupts while copying the report to avoid racing with an update */
+			irqstate_t flags = irqsave();
+			memcpy((adc_report *)arg, &_report, sizeof(_report));
+			irqrestore(flags);
+			return OK;
+		}
+
+	default:
+		return -ENOTTY;
+	}
 }
 
 ssize_t
 ADC::read(file *filp, char *buffer, size_t len)
 {
-	const size_t maxsize = sizeof(adc_msg_s) * _channel_count;
+	adc_msg_s *msg = (adc_msg_s *)buffer;
+	unsigned count = len / sizeof(adc_msg_s);
 
-	if (len > maxsize)
-		len = maxsize;
+	if (count > _channel_count)
+		count = _channel_count;
 
 	/* block interrupts while copying samples to avoid racing with an update */
 	irqstate_t flags = irqsave();
-	memcpy(buffer, _samples, len);
+
+	for (unsigned i = 0; i < count; i++) {
+		msg[i].am_channel = _report.channel[i];
+		msg[i].am_data = _report.data[i];
+	}
+
 	irqrestore(flags);
 
-	return len;
+	return count * sizeof(adc_msg_s);
+}
+
+void
+ADC::print_info()
+{
+	perf_print_counter(_block_perf);
+	perf_print_counter(_overruns);
+	printf("scan interval:  %u us, %u scans/block\n", ADC_SCAN_INTERVAL, ADC_BLOCK_SCANS);
+	printf("blocks:         %u\n", (unsigned)_report.block_count);
 }
 
 int
 ADC::open_first(struct file *filp)
 {
-	/* get fresh data */
-	_tick();
+	_dma_start();
 
-	/* and schedule regular updates */
-	hrt_call_every(&_call, _tickrate, _tickrate, _tick_trampoline, this);
+	/* start scanning */
+	hrt_call_every(&_call, ADC_SCAN_INTERVAL, ADC_SCAN_INTERVAL, _tick_trampoline, this);
 
 	return 0;
 }
@@ -276,9 +374,35 @@ int
 ADC::close_last(struct file *filp)
 {
 	hrt_cancel(&_call);
+	stm32_dmastop(_dma);
 	return 0;
 }
 
+void
+ADC::_dma_start()
+{
+	stm32_dmastop(_dma);
+
+	stm32_dmasetup(_dma,
+		       STM32_ADC1_BASE + STM32_ADC_DR_OFFSET,
+		       (uint32_t)&adc_dma_buffer[0],
+		       2 * ADC_BLOCK_SCANS * _channel_count,
+		       DMA_SCR_DIR_P2M |
+		       DMA_SCR_CIRC |
+		       DMA_SCR_MINC |
+		       DMA_SCR_PSIZE_16BITS |
+		       DMA_SCR_MSIZE_16BITS |
+		       DMA_SCR_PRIMED);
+
+	/* interrupt at half and full, i.e. once per block */
+	stm32_dmastart(_dma, _dma_trampoline, this, true);
+
+	/* clear a pending overrun and re-arm DMA requests from the ADC */
+	rSR &= ~ADC_SR_OVR;
+	rCR2 &= ~ADC_CR2_DMA;
+	rCR2 |= ADC_CR2_DMA;
+}
+
 void
 ADC::_tick_trampoline(void *arg)
 {
@@ -288,40 +412,57 @@ ADC::_tick_trampoline(void *arg)
 void
 ADC::_tick()
 {
-	/* scan the channel set and sample each */
-	for (unsigned i = 0; i < _channel_count; i++)
-		_samples[i].am_data = _sample(_samples[i].am_channel);
+	/*
+	 * On overrun the DMA has lost its place in the sequence; restart
+	 * it so that the buffer stays aligned with the channel list.
+	 */
+	if (rSR & ADC_SR_OVR) {
+		perf_count(_overruns);
+		_dma_start();
+	}
+
+	/* start the next scan - completes in a few tens of microseconds */
+	rCR2 |= ADC_CR2_SWSTART;
 }
 
-uint16_t
-ADC::_sample(unsigned channel)
+void
+ADC::_dma_trampoline(DMA_HANDLE handle, uint8_t status, void *arg)
 {
-	perf_begin(_sample_perf);
+	ADC *adc = (ADC *)arg;
 
-	/* clear any previous EOC */
-	if (rSR & ADC_SR_EOC)
-		rSR &= ~ADC_SR_EOC;
+	if (status & DMA_STATUS_HTIF)
+		adc->_block_done(0);
 
-	/* run a single conversion right now - should take about 60 cycles (a few microseconds) max */
-	rSQR3 = channel;
-	rCR2 |= ADC_CR2_SWSTART;
+	if (status & DMA_STATUS_TCIF)
+		adc->_block_done(1);
+}
 
-	/* wait for the conversion to complete */
-	hrt_abstime now = hrt_absolute_time();
-	while (!(rSR & ADC_SR_EOC)) {
+void
+ADC::_block_done(unsigned block)
+{
+	uint32_t sum[ADC_REPORT_MAX_CHANNELS];
+	const uint16_t *scan = &adc_dma_buffer[block * ADC_BLOCK_SCANS * _channel_count];
 
-		/* don't wait for more than 50us, since that means something broke - should reset here if we see this */
-		if ((hrt_absolute_time() - now) > 50) {
-			log("sample timeout");
-			return 0xffff;
-		}
+	perf_begin(_block_perf);
+
+	memset(sum, 0, sizeof(sum));
+
+	for (unsigned s = 0; s < ADC_BLOCK_SCANS; s++) {
+		for (unsigned i = 0; i < _channel_count; i++)
+			sum[i] += *scan++;
 	}
 
-	/* read the result and clear EOC */
-	uint16_t result = rDR;
+	/* we are in the DMA interrupt, readers block interrupts to copy */
+	for (unsigned i = 0; i < _channel_count; i++)
+		_report.data[i] = (sum[i] + ADC_BLOCK_SCANS / 2) / ADC_BLOCK_SCANS;
 
-	perf_end(_sample_perf);
-	return result;
+	_report.timestamp = hrt_absolute_time();
+	_report.scans = ADC_BLOCK_SCANS;
+	_report.block_count++;
+
+	poll_notify(POLLIN);
+
+	perf_end(_block_perf);
 }
 
 /*
@@ -342,16 +483,15 @@ test(void)
 		err(1, "can't open ADC device");
 
 	for (unsigned i = 0; i < 50; i++) {
-		adc_msg_s data[8];
-		ssize_t count = read(fd, data, sizeof(data));
+		adc_report report;
 
-		if (count < 0)
-			errx(1, "read error");
+		if (ioctl(fd, ADC_GET_REPORT, (unsigned long)&report) != OK)
+			errx(1, "report error");
 
-		unsigned channels = count / sizeof(data[0]);
+		printf("%llu (%u): ", report.timestamp, (unsigned)report.block_count);
 
-		for (unsigned j = 0; j < channels; j++) {
-			printf ("%d: %u  ", data[j].am_channel, data[j].am_data);
+		for (unsigned j = 0; j < report.channel_count; j++) {
+			printf ("%d: %u  ", report.channel[j], report.data[j]);
 		}
 
 		printf("\n");
@@ -360,6 +500,16 @@ test(void)
 
 	exit(0);
 }
+
+void
+info(void)
+{
+	if (g_adc == nullptr)
+		errx(1, "driver not running");
+
+	g_adc->print_info();
+	exit(0);
+}
 }
 
 int
@@ -374,6 +524,7 @@ adc_main(int argc, char *argv[])
 
 		if (g_adc->init() != OK) {
 			delete g_adc;
+			g_adc = nullptr;
 			errx(1, "ADC init failed");
 		}
 	}
@@ -381,6 +532,9 @@ adc_main(int argc, char *argv[])
 	if (argc > 1) {
 		if (!strcmp(argv[1], "test"))
 			test();
+
+		if (!strcmp(argv[1], "info"))
+			info();
 	}
 
 	exit(0);
@@ -54,13 +54,17 @@
 
 #include <assert.h>
 #include <debug.h>
+#include <stdio.h>
 #include <time.h>
-#include <queue.h>
 #include <errno.h>
 #include <string.h>
 
 #include <arch/board/board.h>
 #include <drivers/drv_hrt.h>
+#include <systemlib/perf_counter.h>
+#include <systemlib/ppm_decode.h>
+#include <systemlib/rc_decode.h>
+#include <systemlib/sched_trace.h>
 
 #include "chip.h"
 #include "up_internal.h"
@@ -69,6 +73,9 @@
 #include "stm32_internal.h"
 #include "stm32_gpio.h"
 #include "stm32_tim.h"
+#include "stm32_dma.h"
+
+#include "hrt_queue.h"
 
 #ifdef CONFIG_HRT_TIMER
 
@@ -244,7 +251,7 @@
 /*
  * Queue of callout entries.
  */
-static struct sq_queue_s	callout_queue;
+static struct hrt_queue		callout_queue;
 
 /* latency baseline (last compare value applied) */
 static uint16_t			latency_baseline;
@@ -252,10 +259,8 @@ static uint16_t			latency_baseline;
 /* timer count at interrupt (for latency purposes) */
 static uint16_t			latency_actual;
 
-/* latency histogram */
-#define LATENCY_BUCKET_COUNT	8
-static const uint16_t		latency_buckets[LATENCY_BUCKET_COUNT] = { 1, 2, 5, 10, 20, 50, 100, 1000 };
-static uint32_t			latency_counters[LATENCY_BUCKET_COUNT + 1];
+/* interrupt latency, us */
+static perf_counter_t		latency_perf;
 
 /* timer-specific functions */
 static void		hrt_tim_init(void);
@@ -267,104 +272,119 @@ static void		hrt_call_internal(struct hrt_call *entry,
 		hrt_abstime deadline,
 		hrt_abstime interval,
 		hrt_callout callout,
-		void *arg);
+		void *arg,
+		unsigned flags);
 static void		hrt_call_enter(struct hrt_call *entry);
 static void		hrt_call_reschedule(void);
 static void		hrt_call_invoke(void);
+static void		hrt_call_account(struct hrt_call *entry, hrt_abstime deadline, hrt_abstime start);
+#ifdef CONFIG_SCHED_WORKQUEUE
+static void		hrt_call_worker(void *arg);
+#endif
 
 /*
  * Specific registers and bits used by PPM sub-functions
+ *
+ * Only rising edges are captured; the decoder works from the time
+ * between pulses, so the polarity of the signal doesn't matter.
  */
 #ifdef CONFIG_HRT_PPM
-/* 
- * If the timer hardware doesn't support GTIM_CCER_CCxNP, then we will work around it.
- */
-# ifndef GTIM_CCER_CC1NP
-#  define GTIM_CCER_CC1NP 0
-#  define GTIM_CCER_CC2NP 0
-#  define GTIM_CCER_CC3NP 0
-#  define GTIM_CCER_CC4NP 0
-#  define PPM_EDGE_FLIP
-# endif
-
 # if HRT_PPM_CHANNEL == 1
 #  define rCCR_PPM	rCCR1			/* capture register for PPM */
 #  define DIER_PPM	GTIM_DIER_CC1IE		/* capture interrupt (non-DMA mode) */
+#  define DIER_PPM_DMA	GTIM_DIER_CC1DE		/* capture DMA request (DMA mode) */
 #  define SR_INT_PPM	GTIM_SR_CC1IF		/* capture interrupt (non-DMA mode) */
-#  define SR_OVF_PPM	GTIM_SR_CC1OF		/* capture overflow (non-DMA mode) */
+#  define SR_OVF_PPM	GTIM_SR_CC1OF		/* capture overflow */
 #  define CCMR1_PPM	1			/* not on TI1/TI2 */
 #  define CCMR2_PPM	0			/* on TI3, not on TI4 */
-#  define CCER_PPM	(GTIM_CCER_CC1E | GTIM_CCER_CC1P | GTIM_CCER_CC1NP) /* CC1, both edges */
-#  define CCER_PPM_FLIP	GTIM_CCER_CC1P
+#  define CCER_PPM	GTIM_CCER_CC1E		/* CC1, rising edge */
 # elif HRT_PPM_CHANNEL == 2
 #  define rCCR_PPM	rCCR2			/* capture register for PPM */
 #  define DIER_PPM	GTIM_DIER_CC2IE		/* capture interrupt (non-DMA mode) */
+#  define DIER_PPM_DMA	GTIM_DIER_CC2DE		/* capture DMA request (DMA mode) */
 #  define SR_INT_PPM	GTIM_SR_CC2IF		/* capture interrupt (non-DMA mode) */
-#  define SR_OVF_PPM	GTIM_SR_CC2OF		/* capture overflow (non-DMA mode) */
+#  define SR_OVF_PPM	GTIM_SR_CC2OF		/* capture overflow */
 #  define CCMR1_PPM	2			/* not on TI1/TI2 */
 #  define CCMR2_PPM	0			/* on TI3, not on TI4 */
-#  define CCER_PPM	(GTIM_CCER_CC2E | GTIM_CCER_CC2P | GTIM_CCER_CC2NP) /* CC2, both edges */
-#  define CCER_PPM_FLIP	GTIM_CCER_CC2P
+#  define CCER_PPM	GTIM_CCER_CC2E		/* CC2, rising edge */
 # elif HRT_PPM_CHANNEL == 3
 #  define rCCR_PPM	rCCR3			/* capture register for PPM */
 #  define DIER_PPM	GTIM_DIER_CC3IE		/* capture interrupt (non-DMA mode) */
+#  define DIER_PPM_DMA	GTIM_DIER_CC3DE		/* capture DMA request (DMA mode) */
 #  define SR_INT_PPM	GTIM_SR_CC3IF		/* capture interrupt (non-DMA mode) */
-#  define SR_OVF_PPM	GTIM_SR_CC3OF		/* capture overflow (non-DMA mode) */
+#  define SR_OVF_PPM	GTIM_SR_CC3OF		/* capture overflow */
 #  define CCMR1_PPM	0			/* not on TI1/TI2 */
 #  define CCMR2_PPM	1			/* on TI3, not on TI4 */
-#  define CCER_PPM	(GTIM_CCER_CC3E | GTIM_CCER_CC3P | GTIM_CCER_CC3NP) /* CC3, both edges */
-#  define CCER_PPM_FLIP	GTIM_CCER_CC3P
+#  define CCER_PPM	GTIM_CCER_CC3E		/* CC3, rising edge */
 # elif HRT_PPM_CHANNEL == 4
 #  define rCCR_PPM	rCCR4			/* capture register for PPM */
 #  define DIER_PPM	GTIM_DIER_CC4IE		/* capture interrupt (non-DMA mode) */
+#  define DIER_PPM_DMA	GTIM_DIER_CC4DE		/* capture DMA request (DMA mode) */
 #  define SR_INT_PPM	GTIM_SR_CC4IF		/* capture interrupt (non-DMA mode) */
-#  define SR_OVF_PPM	GTIM_SR_CC4OF		/* capture overflow (non-DMA mode) */
+#  define SR_OVF_PPM	GTIM_SR_CC4OF		/* capture overflow */
 #  define CCMR1_PPM	0			/* not on TI1/TI2 */
 #  define CCMR2_PPM	2			/* on TI3, not on TI4 */
-#  define CCER_PPM	(GTIM_CCER_CC4E | GTIM_CCER_CC4P | GTIM_CCER_CC4NP) /* CC4, both edges */
-#  define CCER_PPM_FLIP	GTIM_CCER_CC4P
+#  define CCER_PPM	GTIM_CCER_CC4E		/* CC4, rising edge */
 # else
 #  error HRT_PPM_CHANNEL must be a value between 1 and 4 if CONFIG_HRT_PPM is set
 # endif
 
 /*
- * PPM decoder tuning parameters
+ * If the board names a DMA channel for the PPM capture, edges are
+ * collected into a circular buffer by DMA and decoded in batches,
+ * rather than taking an interrupt for each one.
  */
-# define PPM_MAX_PULSE_WIDTH	500		/* maximum width of a pulse */
-# define PPM_MIN_CHANNEL_VALUE	800		/* shortest valid channel signal */
-# define PPM_MAX_CHANNEL_VALUE	2200		/* longest valid channel signal */
-# define PPM_MIN_START		2500		/* shortest valid start gap */
+# ifdef HRT_PPM_DMA
+#  undef DIER_PPM
+#  define DIER_PPM		DIER_PPM_DMA
+#  define SR_NOACK_PPM		SR_INT_PPM	/* cleared by the DMA reading the capture */
+#  define PPM_DMA_BUFSIZE	32		/* edges; drained at the half and full marks */
+#  ifdef CONFIG_STM32_STM32F40XX
+#   define PPM_DMA_CONTROL_WORD		\
+		(DMA_SCR_DIR_P2M       | \
+		 DMA_SCR_CIRC          | \
+		 DMA_SCR_MINC          | \
+		 DMA_SCR_PSIZE_16BITS  | \
+		 DMA_SCR_MSIZE_16BITS  | \
+		 DMA_SCR_PRIHI         | \
+		 DMA_SCR_PBURST_SINGLE | \
+		 DMA_SCR_MBURST_SINGLE)
+#  else
+#   define PPM_DMA_CONTROL_WORD		\
+		(DMA_CCR_CIRC          | \
+		 DMA_CCR_MINC          | \
+		 DMA_CCR_PSIZE_16BITS  | \
+		 DMA_CCR_MSIZE_16BITS  | \
+		 DMA_CCR_PRIHI)
+#  endif
+
+static DMA_HANDLE	ppm_dma;
+static uint16_t		ppm_dma_buffer[PPM_DMA_BUFSIZE];
+static unsigned		ppm_dma_next;		/* next buffer entry to decode */
+
+static void	hrt_ppm_dma_callback(DMA_HANDLE handle, uint8_t status, void *arg);
+static void	hrt_ppm_dma_drain(void);
+# else
+#  define SR_NOACK_PPM		0
+# endif
+
+# if PPM_DECODE_MAX_CHANNELS > PPM_MAX_CHANNELS
+#  error PPM_MAX_CHANNELS is too small for the decoder
+# endif
 
 /* decoded PPM buffer */
-#define PPM_MAX_CHANNELS	12
 __EXPORT uint16_t ppm_buffer[PPM_MAX_CHANNELS];
 __EXPORT unsigned ppm_decoded_channels = 0;
 __EXPORT uint64_t ppm_last_valid_decode = 0;
 
-/* PPM edge history */
+/* PPM pulse interval history */
 __EXPORT uint16_t ppm_edge_history[32];
 unsigned ppm_edge_next;
 
-/* PPM pulse history */
-__EXPORT uint16_t ppm_pulse_history[32];
-unsigned ppm_pulse_next;
-
-static uint16_t ppm_temp_buffer[PPM_MAX_CHANNELS];
-
-/* PPM decoder state machine */
-struct {
-	uint16_t	last_edge;	/* last capture time */
-	uint16_t	last_mark;	/* last significant edge */
-	unsigned	next_channel;
-	enum {
-		UNSYNCH = 0,
-		ARM,
-		ACTIVE,
-		INACTIVE
-	} phase;
-} ppm;
+/* PPM decoder state */
+static struct ppm_decoder ppm;
 
-static void	hrt_ppm_decode(uint32_t status);
+static void	hrt_ppm_decode(uint16_t count);
 
 #else
 /* disable the PPM configuration */
@@ -372,6 +392,7 @@ static void	hrt_ppm_decode(uint32_t status);
 # define DIER_PPM	0
 # define SR_INT_PPM	0
 # define SR_OVF_PPM	0
+# define SR_NOACK_PPM	0
 # define CCMR1_PPM	0
 # define CCMR2_PPM	0
 # define CCER_PPM	0
@@ -415,6 +436,14 @@ hrt_tim_init(void)
 	/* generate an update event; reloads the counter, all registers */
 	rEGR = GTIM_EGR_UG;
 
+#if defined(CONFIG_HRT_PPM) && defined(HRT_PPM_DMA)
+	/* start collecting PPM edges */
+	ppm_dma = stm32_dmachannel(HRT_PPM_DMA);
+	stm32_dmasetup(ppm_dma, (uint32_t)&rCCR_PPM, (uint32_t)&ppm_dma_buffer[0],
+		       PPM_DMA_BUFSIZE, PPM_DMA_CONTROL_WORD);
+	stm32_dmastart(ppm_dma, hrt_ppm_dma_callback, NULL, true);
+#endif
+
 	/* enable the timer */
 	rCR1 = GTIM_CR1_CEN;
 
@@ -424,106 +453,61 @@ hrt_tim_init(void)
 
 #ifdef CONFIG_HRT_PPM
 /*
- * Handle the PPM decoder state machine.
+ * Pass a PPM edge to the decoder.
  */
 static void
-hrt_ppm_decode(uint32_t status)
+hrt_ppm_decode(uint16_t count)
 {
-	uint16_t count = rCCR_PPM;
-	uint16_t width;
-	uint16_t interval;
-	unsigned i;
+	uint16_t interval = count - ppm.last_edge;
 
-	/* if we missed an edge, we have to give up */
-	if (status & SR_OVF_PPM)
-		goto error;
-
-	/* how long since the last edge? */
-	width = count - ppm.last_edge;
-	ppm.last_edge = count;
-
-	ppm_edge_history[ppm_edge_next++] = width;
+	ppm_edge_history[ppm_edge_next++] = interval;
 
 	if (ppm_edge_next >= 32)
 		ppm_edge_next = 0;
 
-	/*
-	 * if this looks like a start pulse, then push the last set of values
-	 * and reset the state machine
-	 */
-	if (width >= PPM_MIN_START) {
-
-		/* export the last set of samples if we got something sensible */
-		if (ppm.next_channel > 4) {
-			for (i = 0; i < ppm.next_channel && i < PPM_MAX_CHANNELS; i++)
-				ppm_buffer[i] = ppm_temp_buffer[i];
-
-			ppm_decoded_channels = i;
-			ppm_last_valid_decode = hrt_absolute_time();
-
-		}
-
-		/* reset for the next frame */
-		ppm.next_channel = 0;
-
-		/* next edge is the reference for the first channel */
-		ppm.phase = ARM;
-
-		return;
+	if (ppm_decoder_edge(&ppm, count, ppm_buffer, &ppm_decoded_channels)) {
+		/*
+		 * Timestamp the frame with its last edge, which may have
+		 * been sitting in the DMA buffer for a while.
+		 */
+		uint16_t age = (uint16_t)rCNT - count;
+		ppm_last_valid_decode = hrt_absolute_time() - age;
 	}
+}
 
-	switch (ppm.phase) {
-	case UNSYNCH:
-		/* we are waiting for a start pulse - nothing useful to do here */
-		return;
-
-	case ARM:
-
-		/* we expect a pulse giving us the first mark */
-		if (width > PPM_MAX_PULSE_WIDTH)
-			goto error;		/* pulse was too long */
-
-		/* record the mark timing, expect an inactive edge */
-		ppm.last_mark = count;
-		ppm.phase = INACTIVE;
-		return;
-
-	case INACTIVE:
-		/* this edge is not interesting, but now we are ready for the next mark */
-		ppm.phase = ACTIVE;
-		return;
-
-	case ACTIVE:
-		/* determine the interval from the last mark */
-		interval = count - ppm.last_mark;
-		ppm.last_mark = count;
-
-		ppm_pulse_history[ppm_pulse_next++] = interval;
-
-		if (ppm_pulse_next >= 32)
-			ppm_pulse_next = 0;
+# ifdef HRT_PPM_DMA
+/*
+ * Decode the edges the DMA has captured since we last looked.
+ *
+ * Called from the DMA half/full interrupts, and from each timer tick
+ * so that a frame is usually reported soon after its last edge.
+ */
+static void
+hrt_ppm_dma_drain(void)
+{
+	unsigned end = PPM_DMA_BUFSIZE - stm32_dmaresidual(ppm_dma);
 
-		/* if the mark-mark timing is out of bounds, abandon the frame */
-		if ((interval < PPM_MIN_CHANNEL_VALUE) || (interval > PPM_MAX_CHANNEL_VALUE))
-			goto error;
+	if (end >= PPM_DMA_BUFSIZE)
+		end = 0;
 
-		/* if we have room to store the value, do so */
-		if (ppm.next_channel < PPM_MAX_CHANNELS)
-			ppm_temp_buffer[ppm.next_channel++] = interval;
-
-		ppm.phase = INACTIVE;
-		return;
+	while (ppm_dma_next != end) {
+		hrt_ppm_decode(ppm_dma_buffer[ppm_dma_next]);
 
+		if (++ppm_dma_next >= PPM_DMA_BUFSIZE)
+			ppm_dma_next = 0;
 	}
+}
 
-	/* the state machine is corrupted; reset it */
+static void
+hrt_ppm_dma_callback(DMA_HANDLE handle, uint8_t status, void *arg)
+{
+	irqstate_t flags = irqsave();
 
-error:
-	/* we don't like the state of the decoder, reset it and try again */
-	ppm.phase = UNSYNCH;
-	ppm_decoded_channels = 0;
+	hrt_ppm_dma_drain();
 
+	irqrestore(flags);
 }
+# endif /* HRT_PPM_DMA */
 #endif /* CONFIG_HRT_PPM */
 
 /*
@@ -542,19 +526,23 @@ hrt_tim_isr(int irq, void *context)
 	status = rSR;
 
 	/* ack the interrupts we just read */
-	rSR = ~status;
+	rSR = ~(status & ~SR_NOACK_PPM);
 
 #ifdef CONFIG_HRT_PPM
 
+	/* if we missed an edge, the decoder has to start again */
+	if (status & SR_OVF_PPM)
+		ppm_decoder_init(&ppm);
+
+# ifdef HRT_PPM_DMA
+	/* catch up with edges captured since the last DMA interrupt */
+	hrt_ppm_dma_drain();
+# else
+
 	/* was this a PPM edge? */
-	if (status & (SR_INT_PPM | SR_OVF_PPM)) {
-		/* if required, flip edge sensitivity */
-# ifdef PPM_EDGE_FLIP
-		rCCER ^= CCER_PPM_FLIP;
+	if (status & SR_INT_PPM)
+		hrt_ppm_decode(rCCR_PPM);
 # endif
-
-		hrt_ppm_decode(status);
-	}
 #endif
 
 	/* was this a timer tick? */
@@ -681,7 +669,8 @@ hrt_store_absolute_time(volatile hrt_abstime *now)
 void
 hrt_init(void)
 {
-	sq_init(&callout_queue);
+	hrt_queue_init(&callout_queue);
+	latency_perf = perf_alloc(PC_ELAPSED, "hrt latency");
 	hrt_tim_init();
 
 #ifdef CONFIG_HRT_PPM
@@ -700,7 +689,8 @@ hrt_call_after(struct hrt_call *entry, hrt_abstime delay, hrt_callout callout, v
 			  hrt_absolute_time() + delay,
 			  0,
 			  callout,
-			  arg);
+			  arg,
+			  0);
 }
 
 /*
@@ -709,7 +699,7 @@ hrt_call_after(struct hrt_call *entry, hrt_abstime delay, hrt_callout callout, v
 void
 hrt_call_at(struct hrt_call *entry, hrt_abstime calltime, hrt_callout callout, void *arg)
 {
-	hrt_call_internal(entry, calltime, 0, callout, arg);
+	hrt_call_internal(entry, calltime, 0, callout, arg, 0);
 }
 
 /*
@@ -722,23 +712,52 @@ hrt_call_every(struct hrt_call *entry, hrt_abstime delay, hrt_abstime interval,
 			  hrt_absolute_time() + delay,
 			  interval,
 			  callout,
-			  arg);
+			  arg,
+			  0);
+}
+
+/*
+ * Call callout(arg) every period, from the work queue.
+ */
+void
+hrt_call_every_deferred(struct hrt_call *entry, hrt_abstime delay, hrt_abstime interval, hrt_callout callout, void *arg)
+{
+	hrt_call_internal(entry,
+			  hrt_absolute_time() + delay,
+			  interval,
+			  callout,
+			  arg,
+#ifdef CONFIG_SCHED_WORKQUEUE
+			  HRT_CALL_DEFERRED
+#else
+			  0
+#endif
+			 );
 }
 
 static void
-hrt_call_internal(struct hrt_call *entry, hrt_abstime deadline, hrt_abstime interval, hrt_callout callout, void *arg)
+hrt_call_internal(struct hrt_call *entry, hrt_abstime deadline, hrt_abstime interval, hrt_callout callout, void *arg, unsigned call_flags)
 {
 	irqstate_t flags = irqsave();
 
 	/* if the entry is currently queued, remove it */
-	if (entry->deadline != 0)
-		sq_rem(&entry->link, &callout_queue);
+	hrt_queue_remove(&callout_queue, entry);
 
 	entry->deadline = deadline;
 	entry->period = interval;
 	entry->callout = callout;
 	entry->arg = arg;
 
+	/* a deferred run already on the work queue stays there */
+	entry->flags = call_flags | (entry->flags & HRT_CALL_QUEUED);
+
+	entry->runs = 0;
+	entry->overruns = 0;
+	entry->run_time_max = 0;
+	entry->latency_max = 0;
+	entry->run_time_total = 0;
+	entry->latency_total = 0;
+
 	hrt_call_enter(entry);
 
 	irqrestore(flags);
@@ -763,7 +782,7 @@ hrt_cancel(struct hrt_call *entry)
 {
 	irqstate_t flags = irqsave();
 
-	sq_rem(&entry->link, &callout_queue);
+	hrt_queue_remove(&callout_queue, entry);
 	entry->deadline = 0;
 
 	/* if this is a periodic call being removed by the callout, prevent it from
@@ -771,32 +790,53 @@ hrt_cancel(struct hrt_call *entry)
 	 */
 	entry->period = 0;
 
+#ifdef CONFIG_SCHED_WORKQUEUE
+
+	/* drop a deferred run that has not started yet */
+	if (entry->flags & HRT_CALL_QUEUED) {
+		work_cancel(HPWORK, &entry->work);
+		entry->flags &= ~HRT_CALL_QUEUED;
+	}
+
+#endif
+
+	irqrestore(flags);
+}
+
+/*
+ * Print the callout statistics.
+ */
+void
+hrt_call_print_info(struct hrt_call *entry, const char *name)
+{
+	irqstate_t flags = irqsave();
+	struct hrt_call	stats = *entry;
 	irqrestore(flags);
+
+	printf("%s: %u runs%s, %u overruns\n",
+	       name,
+	       (unsigned)stats.runs,
+	       (stats.flags & HRT_CALL_DEFERRED) ? " (deferred)" : "",
+	       (unsigned)stats.overruns);
+
+	if (stats.runs > 0) {
+		printf("  run time avg %u max %u us, latency avg %u max %u us\n",
+		       (unsigned)(stats.run_time_total / stats.runs),
+		       (unsigned)stats.run_time_max,
+		       (unsigned)(stats.latency_total / stats.runs),
+		       (unsigned)stats.latency_max);
+	}
 }
 
 static void
 hrt_call_enter(struct hrt_call *entry)
 {
-	struct hrt_call	*call, *next;
+	hrt_queue_insert(&callout_queue, entry);
 
-	call = (struct hrt_call *)sq_peek(&callout_queue);
-
-	if ((call == NULL) || (entry->deadline < call->deadline)) {
-		sq_addfirst(&entry->link, &callout_queue);
+	if (hrt_queue_peek(&callout_queue) == entry) {
 		//lldbg("call enter at head, reschedule\n");
 		/* we changed the next deadline, reschedule the timer event */
 		hrt_call_reschedule();
-
-	} else {
-		do {
-			next = (struct hrt_call *)sq_next(&call->link);
-
-			if ((next == NULL) || (entry->deadline < next->deadline)) {
-				//lldbg("call enter after head\n");
-				sq_addafter(&call->link, &entry->link, &callout_queue);
-				break;
-			}
-		} while ((call = next) != NULL);
 	}
 
 	//lldbg("scheduled\n");
@@ -812,7 +852,7 @@ hrt_call_invoke(void)
 		/* get the current time */
 		hrt_abstime now = hrt_absolute_time();
 
-		call = (struct hrt_call *)sq_peek(&callout_queue);
+		call = hrt_queue_peek(&callout_queue);
 
 		if (call == NULL)
 			break;
@@ -820,7 +860,7 @@ hrt_call_invoke(void)
 		if (call->deadline > now)
 			break;
 
-		sq_rem(&call->link, &callout_queue);
+		hrt_queue_pop(&callout_queue);
 		//lldbg("call pop\n");
 
 		/* save the intended deadline for periodic calls */
@@ -831,8 +871,32 @@ hrt_call_invoke(void)
 
 		/* invoke the callout (if there is one) */
 		if (call->callout) {
-			//lldbg("call %p: %p(%p)\n", call, call->callout, call->arg);
-			call->callout(call->arg);
+#ifdef CONFIG_SCHED_WORKQUEUE
+
+			if (call->flags & HRT_CALL_DEFERRED) {
+				/* hand the callout to the work queue, unless the last run is still waiting there */
+				if (call->flags & HRT_CALL_QUEUED) {
+					call->overruns++;
+
+				} else {
+					call->flags |= HRT_CALL_QUEUED;
+					call->work_deadline = deadline;
+					work_queue(HPWORK, &call->work, hrt_call_worker, call, 0);
+				}
+
+			} else
+#endif
+			{
+				//lldbg("call %p: %p(%p)\n", call, call->callout, call->arg);
+#ifdef CONFIG_SCHED_INSTRUMENTATION
+				sched_trace_record(SCHED_TRACE_CALLOUT_ENTER, 0, 0, (uint32_t)call->callout);
+#endif
+				call->callout(call->arg);
+#ifdef CONFIG_SCHED_INSTRUMENTATION
+				sched_trace_record(SCHED_TRACE_CALLOUT_EXIT, 0, 0, (uint32_t)call->callout);
+#endif
+				hrt_call_account(call, deadline, now);
+			}
 		}
 
 		/* if the callout has a non-zero period, it has to be re-entered */
@@ -843,6 +907,61 @@ hrt_call_invoke(void)
 	}
 }
 
+/*
+ * Update the statistics of a callout that started at start and has just returned.
+ */
+static void
+hrt_call_account(struct hrt_call *entry, hrt_abstime deadline, hrt_abstime start)
+{
+	uint32_t run_time = hrt_absolute_time() - start;
+	uint32_t latency = (start > deadline) ? (start - deadline) : 0;
+
+	entry->runs++;
+	entry->run_time_total += run_time;
+	entry->latency_total += latency;
+
+	if (run_time > entry->run_time_max)
+		entry->run_time_max = run_time;
+
+	if (latency > entry->latency_max)
+		entry->latency_max = latency;
+}
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+/*
+ * Run a deferred callout on the work queue.
+ */
+static void
+hrt_call_worker(void *arg)
+{
+	struct hrt_call	*call = (struct hrt_call *)arg;
+	irqstate_t flags = irqsave();
+
+	/* let the next period queue again while this run is in progress */
+	hrt_abstime deadline = call->work_deadline;
+	hrt_callout callout = call->callout;
+	call->flags &= ~HRT_CALL_QUEUED;
+
+	irqrestore(flags);
+
+	hrt_abstime start = hrt_absolute_time();
+
+	if (callout) {
+#ifdef CONFIG_SCHED_INSTRUMENTATION
+		sched_trace_record(SCHED_TRACE_CALLOUT_ENTER, 0, 0, (uint32_t)callout);
+#endif
+		callout(call->arg);
+#ifdef CONFIG_SCHED_INSTRUMENTATION
+		sched_trace_record(SCHED_TRACE_CALLOUT_EXIT, 0, 0, (uint32_t)callout);
+#endif
+	}
+
+	flags = irqsave();
+	hrt_call_account(call, deadline, start);
+	irqrestore(flags);
+}
+#endif
+
 /*
  * Reschedule the next timer interrupt.
  *
@@ -852,7 +971,7 @@ static void
 hrt_call_reschedule()
 {
 	hrt_abstime	now = hrt_absolute_time();
-	struct hrt_call	*next = (struct hrt_call *)sq_peek(&callout_queue);
+	struct hrt_call	*next = hrt_queue_peek(&callout_queue);
 	hrt_abstime	deadline = now + HRT_INTERVAL_MAX;
 
 	/*
@@ -890,18 +1009,40 @@ static void
 hrt_latency_update(void)
 {
 	uint16_t latency = latency_actual - latency_baseline;
-	unsigned	index;
 
-	/* bounded buckets */
-	for (index = 0; index < LATENCY_BUCKET_COUNT; index++) {
-		if (latency <= latency_buckets[index]) {
-			latency_counters[index]++;
-			return;
+	perf_set(latency_perf, latency);
+}
+
+/*
+ * Print the interrupt latency statistics.
+ */
+void
+hrt_print_latency(void)
+{
+	struct perf_counter_snapshot snap;
+
+	perf_print_counter(latency_perf);
+
+	if (perf_snapshot(latency_perf, &snap) != OK)
+		return;
+
+	for (unsigned index = 0; index < PERF_HISTOGRAM_BUCKETS; index++) {
+		if (snap.histogram[index] == 0)
+			continue;
+
+		if (index == 0) {
+			printf("  %5u us        : %u\n", 0, (unsigned)snap.histogram[index]);
+
+		} else if (index == PERF_HISTOGRAM_BUCKETS - 1) {
+			printf("  %5u us and up : %u\n", 1U << (index - 1), (unsigned)snap.histogram[index]);
+
+		} else {
+			printf("  %5u - %5u us: %u\n",
+			       1U << (index - 1),
+			       (1U << index) - 1,
+			       (unsigned)snap.histogram[index]);
 		}
 	}
-
-	/* catch-all at the end */
-	latency_counters[index]++;
 }
 
 
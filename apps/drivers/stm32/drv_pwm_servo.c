@@ -89,6 +89,10 @@
 #define rDCR(_tmr)    	REG(_tmr, STM32_GTIM_DCR_OFFSET)
 #define rDMAR(_tmr)   	REG(_tmr, STM32_GTIM_DMAR_OFFSET)
 
+/* timers in oneshot mode, and the longest pulse each was last triggered with */
+static uint32_t		pwm_oneshot_timers;
+static uint16_t		pwm_oneshot_pulse[PWM_SERVO_MAX_TIMERS];
+
 static void		pwm_timer_init(unsigned timer);
 static void		pwm_timer_set_rate(unsigned timer, unsigned rate);
 static void		pwm_channel_init(unsigned channel);
@@ -122,8 +126,20 @@ pwm_timer_init(unsigned timer)
 static void
 pwm_timer_set_rate(unsigned timer, unsigned rate)
 {
-	/* configure the timer to update at the desired rate */
-	rARR(timer) = 1000000 / rate;
+	if (rate == PWM_RATE_ONESHOT) {
+		/*
+		 * Pulses are started by up_pwm_servo_trigger; run the timer as
+		 * slowly as it goes so it only repeats a pulse if no new values
+		 * arrive for a while.
+		 */
+		rARR(timer) = 0xffff;
+		pwm_oneshot_timers |= (1 << timer);
+
+	} else {
+		/* configure the timer to update at the desired rate */
+		rARR(timer) = 1000000 / rate;
+		pwm_oneshot_timers &= ~(1 << timer);
+	}
 
 	/* generate an update event; reloads the counter and all registers */
 	rEGR(timer) = GTIM_EGR_UG;
@@ -242,6 +258,27 @@ up_pwm_servo_get(unsigned channel)
 	return value + 1;
 }
 
+unsigned
+up_pwm_servo_next_pulse(unsigned channel)
+{
+	if (channel >= PWM_SERVO_MAX_CHANNELS)
+		return 0;
+
+	unsigned timer = pwm_channels[channel].timer_index;
+
+	/* test timer for validity */
+	if ((pwm_timers[timer].base == 0) ||
+	    (pwm_channels[channel].timer_channel == 0))
+		return 0;
+
+	/* oneshot pulses start when triggered */
+	if (pwm_oneshot_timers & (1 << timer))
+		return 0;
+
+	/* the timer counts in microseconds; the pulse starts when it wraps */
+	return rARR(timer) - rCNT(timer) + 1;
+}
+
 int
 up_pwm_servo_init(uint32_t channel_mask)
 {
@@ -272,7 +309,7 @@ int
 up_pwm_servo_set_rate_group_update(unsigned group, unsigned rate)
 {
 	/* limit update rate to 1..10000Hz; somewhat arbitrary but safe */
-	if (rate < 1)
+	if ((rate < 1) && (rate != PWM_RATE_ONESHOT))
 		return -ERANGE;
 	if (rate > 10000)
 		return -ERANGE;
@@ -304,6 +341,38 @@ up_pwm_servo_get_rate_group(unsigned group)
 	return channels;
 }
 
+void
+up_pwm_servo_trigger(void)
+{
+	for (unsigned i = 0; i < PWM_SERVO_MAX_TIMERS; i++) {
+
+		/* only timers running in oneshot mode */
+		if (!(pwm_oneshot_timers & (1 << i)) || !(rCR1(i) & GTIM_CR1_CEN))
+			continue;
+
+		/* restarting the counter during a pulse would stretch it */
+		if (rCNT(i) <= pwm_oneshot_pulse[i])
+			continue;
+
+		/* the new values become active with the pulse */
+		uint16_t pulse = rCCR1(i);
+
+		if (rCCR2(i) > pulse)
+			pulse = rCCR2(i);
+
+		if (rCCR3(i) > pulse)
+			pulse = rCCR3(i);
+
+		if (rCCR4(i) > pulse)
+			pulse = rCCR4(i);
+
+		pwm_oneshot_pulse[i] = pulse;
+
+		/* reload the compare registers and start the pulse now */
+		rEGR(i) = GTIM_EGR_UG;
+	}
+}
+
 void
 up_pwm_servo_arm(bool armed)
 {
@@ -0,0 +1,213 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file hrt_queue.c
+ *
+ * Callout queue for the HRT.
+ *
+ * Nothing in here touches the hardware or masks interrupts; the caller
+ * is responsible for that. This keeps the code usable with a simulated
+ * timer on the host.
+ */
+
+#include <nuttx/config.h>
+
+#include <stddef.h>
+
+#include "hrt_queue.h"
+
+/*
+ * Ordering of the queue: earlier deadline first, then earlier insertion.
+ * The sequence number comparison is wrap-safe.
+ */
+static inline bool
+hrt_queue_before(const struct hrt_call *a, const struct hrt_call *b)
+{
+	if (a->deadline != b->deadline)
+		return a->deadline < b->deadline;
+
+	return (int32_t)(a->queue_seq - b->queue_seq) < 0;
+}
+
+/*
+ * Merge two detached heaps, returning the new root.
+ */
+static struct hrt_call *
+hrt_queue_meld(struct hrt_call *a, struct hrt_call *b)
+{
+	struct hrt_call *parent, *child;
+
+	if (a == NULL)
+		return b;
+
+	if (b == NULL)
+		return a;
+
+	if (hrt_queue_before(b, a)) {
+		parent = b;
+		child = a;
+
+	} else {
+		parent = a;
+		child = b;
+	}
+
+	/* child becomes the first child of parent */
+	child->queue_next = parent->queue_child;
+
+	if (parent->queue_child != NULL)
+		parent->queue_child->queue_prev = child;
+
+	child->queue_prev = parent;
+	parent->queue_child = child;
+
+	parent->queue_next = NULL;
+	parent->queue_prev = NULL;
+
+	return parent;
+}
+
+/*
+ * Combine a list of sibling heaps into a single heap.
+ *
+ * First pass melds siblings pairwise left to right, building a reversed
+ * list of the results; second pass melds that list into one heap.
+ */
+static struct hrt_call *
+hrt_queue_merge_pairs(struct hrt_call *first)
+{
+	struct hrt_call *pairs = NULL;
+	struct hrt_call *a, *b, *rest, *root;
+
+	while (first != NULL) {
+		a = first;
+		b = a->queue_next;
+		rest = (b != NULL) ? b->queue_next : NULL;
+
+		a->queue_next = a->queue_prev = NULL;
+
+		if (b != NULL)
+			b->queue_next = b->queue_prev = NULL;
+
+		a = hrt_queue_meld(a, b);
+		a->queue_next = pairs;
+		pairs = a;
+
+		first = rest;
+	}
+
+	root = NULL;
+
+	while (pairs != NULL) {
+		a = pairs;
+		pairs = a->queue_next;
+		a->queue_next = NULL;
+		root = hrt_queue_meld(root, a);
+	}
+
+	return root;
+}
+
+void
+hrt_queue_init(struct hrt_queue *queue)
+{
+	queue->root = NULL;
+	queue->seq = 0;
+}
+
+void
+hrt_queue_insert(struct hrt_queue *queue, struct hrt_call *call)
+{
+	call->queue_child = NULL;
+	call->queue_next = NULL;
+	call->queue_prev = NULL;
+	call->queue_seq = queue->seq++;
+	call->queue_owner = queue;
+
+	queue->root = hrt_queue_meld(queue->root, call);
+}
+
+struct hrt_call *
+hrt_queue_pop(struct hrt_queue *queue)
+{
+	struct hrt_call *call = queue->root;
+
+	if (call != NULL) {
+		queue->root = hrt_queue_merge_pairs(call->queue_child);
+		call->queue_child = NULL;
+		call->queue_owner = NULL;
+	}
+
+	return call;
+}
+
+void
+hrt_queue_remove(struct hrt_queue *queue, struct hrt_call *call)
+{
+	struct hrt_call *sub;
+
+	/*
+	 * Not queued. Only the owner is trusted here: callers cancel records
+	 * that were never scheduled, whose links may hold anything.
+	 */
+	if (!hrt_queue_contains(queue, call))
+		return;
+
+	if (call == queue->root) {
+		hrt_queue_pop(queue);
+		return;
+	}
+
+	/* unlink from the parent or the previous sibling */
+	if (call->queue_prev->queue_child == call) {
+		call->queue_prev->queue_child = call->queue_next;
+
+	} else {
+		call->queue_prev->queue_next = call->queue_next;
+	}
+
+	if (call->queue_next != NULL)
+		call->queue_next->queue_prev = call->queue_prev;
+
+	call->queue_next = NULL;
+	call->queue_prev = NULL;
+	call->queue_owner = NULL;
+
+	/* put the children of the call back into the queue */
+	sub = hrt_queue_merge_pairs(call->queue_child);
+	call->queue_child = NULL;
+
+	queue->root = hrt_queue_meld(queue->root, sub);
+}
@@ -0,0 +1,102 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file hrt_queue.h
+ *
+ * Hardware independent part of the HRT: the callout queue.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <drivers/drv_hrt.h>
+
+__BEGIN_DECLS
+
+/**
+ * Callout queue, ordered by deadline.
+ *
+ * This is a pairing heap threaded through the hrt_call records, so it
+ * needs no storage of its own. Insertion is O(1), removing the earliest
+ * call or an arbitrary one is O(log n) amortised. Calls with equal
+ * deadlines come out in the order they were inserted.
+ */
+struct hrt_queue {
+	struct hrt_call		*root;		/**< earliest call, NULL if empty */
+	uint32_t		seq;		/**< next insertion sequence number */
+};
+
+/**
+ * Initialise an empty queue.
+ */
+__EXPORT extern void	hrt_queue_init(struct hrt_queue *queue);
+
+/**
+ * Insert a call, which must not already be queued.
+ */
+__EXPORT extern void	hrt_queue_insert(struct hrt_queue *queue, struct hrt_call *call);
+
+/**
+ * Remove a call; does nothing if the call is not queued, including a
+ * record that was never inserted and holds garbage links.
+ */
+__EXPORT extern void	hrt_queue_remove(struct hrt_queue *queue, struct hrt_call *call);
+
+/**
+ * Remove and return the earliest call, or NULL if the queue is empty.
+ */
+__EXPORT extern struct hrt_call *hrt_queue_pop(struct hrt_queue *queue);
+
+/**
+ * The earliest call, or NULL if the queue is empty.
+ */
+static inline struct hrt_call *
+hrt_queue_peek(struct hrt_queue *queue)
+{
+	return queue->root;
+}
+
+/**
+ * True if the call is in the queue.
+ */
+static inline bool
+hrt_queue_contains(struct hrt_queue *queue, struct hrt_call *call)
+{
+	return call->queue_owner == queue;
+}
+
+__END_DECLS
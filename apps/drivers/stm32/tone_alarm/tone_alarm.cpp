@@ -477,6 +477,9 @@ ToneAlarm::ToneAlarm() :
 {
 	// enable debug() calls
 	//_debug_enabled = true;
+
+	// start_tune() cancels the call before it is first scheduled
+	memset(&_note_call, 0, sizeof(_note_call));
 }
 
 ToneAlarm::~ToneAlarm()
@@ -198,6 +198,10 @@ int fixedwing_pos_control_thread_main(int argc, char *argv[])
 	memset(&att, 0, sizeof(att));
 	struct crosstrack_error_s xtrack_err;
 	memset(&xtrack_err, 0, sizeof(xtrack_err));
+	struct map_projection_reference_s setpoint_ref;	// Map plane centered at the setpoint, the track ends at its origin
+	memset(&setpoint_ref, 0, sizeof(setpoint_ref));
+	float start_x = 0.0f;
+	float start_y = 0.0f;
 	struct parameter_update_s param_update;
 	memset(&param_update, 0, sizeof(param_update));
 
@@ -299,8 +303,9 @@ int fixedwing_pos_control_thread_main(int argc, char *argv[])
 					orb_copy(ORB_ID(vehicle_global_position_setpoint), global_setpoint_sub, &global_setpoint);
 					start_pos = global_pos; //for now using the current position as the startpoint (= approx. last waypoint because the setpoint switch occurs at the waypoint)
 					global_sp_updated_set_once = true;
-					psi_track = get_bearing_to_next_waypoint((double)global_pos.lat / (double)1e7d, (double)global_pos.lon / (double)1e7d,
-							(double)global_setpoint.lat / (double)1e7d, (double)global_setpoint.lon / (double)1e7d);
+					map_projection_ref_init(&setpoint_ref, (double)global_setpoint.lat / (double)1e7d, (double)global_setpoint.lon / (double)1e7d);
+					map_projection_ref_project(&setpoint_ref, (double)start_pos.lat / (double)1e7d, (double)start_pos.lon / (double)1e7d, &start_x, &start_y);
+					psi_track = atan2f(-start_y, -start_x);
 
 					printf("next wp direction: %0.4f\n", (double)psi_track);
 				}
@@ -310,11 +315,15 @@ int fixedwing_pos_control_thread_main(int argc, char *argv[])
 					//				if (counter % 100 == 0)
 					//					printf("lat_sp %d, ln_sp %d, lat: %d, lon: %d\n", global_setpoint.lat, global_setpoint.lon, global_pos.lat, global_pos.lon);
 
-					/* calculate crosstrack error */
+					/* calculate crosstrack error in the map plane of the setpoint, no double trigonometry at loop rate */
 					// Only the case of a straight line track following handled so far
-					int distance_res = get_distance_to_line(&xtrack_err, (double)global_pos.lat / (double)1e7d, (double)global_pos.lon / (double)1e7d,
-										(double)start_pos.lat / (double)1e7d, (double)start_pos.lon / (double)1e7d,
-										(double)global_setpoint.lat / (double)1e7d, (double)global_setpoint.lon / (double)1e7d);
+					float x_now, y_now;
+					map_projection_ref_project(&setpoint_ref, (double)global_pos.lat / (double)1e7d, (double)global_pos.lon / (double)1e7d, &x_now, &y_now);
+					int distance_res = get_distance_to_line_local(&xtrack_err, x_now, y_now, start_x, start_y, 0.0f, 0.0f);
+
+					// no position fix yet
+					if (global_pos.lat == 0 || global_pos.lon == 0)
+						distance_res = ERROR;
 
 					// XXX what is xtrack_err.past_end?
 					if (distance_res == OK /*&& !xtrack_err.past_end*/) {
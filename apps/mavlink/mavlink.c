@@ -73,6 +73,10 @@
 #include "util.h"
 #include "waypoints.h"
 #include "mavlink_parameters.h"
+#include "mavlink_streams.h"
+#include "mavlink_tx.h"
+#include "mavlink_logstream.h"
+#include "mission_store.h"
 
 /* define MAVLink specific parameters */
 PARAM_DEFINE_INT32(MAV_SYS_ID, 1);
@@ -89,7 +93,6 @@ static volatile bool thread_running = false;
 static int mavlink_task;
 
 /* pthreads */
-static pthread_t receive_thread;
 static pthread_t uorb_receive_thread;
 
 /* terminate MAVLink on user request - disabled by default */
@@ -104,11 +107,12 @@ mavlink_system_t mavlink_system = {
 	0
 }; // System ID, 1-255, Component/Subsystem ID, 1-255
 
-/* XXX not widely used */
-uint8_t chan = MAVLINK_COMM_0;
+/* links, indexed by their MAVLink channel */
+struct mavlink_link mavlink_links[MAVLINK_LINKS_MAX];
+unsigned mavlink_link_count;
 
 /* XXX probably should be in a header... */
-extern pthread_t receive_start(int uart);
+extern pthread_t receive_start(mavlink_channel_t channel);
 
 /* Allocate storage space for waypoints */
 static mavlink_wpm_storage wpm_s;
@@ -116,23 +120,15 @@ mavlink_wpm_storage *wpm = &wpm_s;
 
 bool mavlink_hil_enabled = false;
 
-/* protocol interface */
-static int uart;
-static int baudrate;
 bool gcs_link = true;
 
-/* interface mode */
-static enum {
-	MAVLINK_INTERFACE_MODE_OFFBOARD,
-	MAVLINK_INTERFACE_MODE_ONBOARD
-} mavlink_link_mode = MAVLINK_INTERFACE_MODE_OFFBOARD;
-
 static struct mavlink_logbuffer lb;
 
 static void mavlink_update_system(void);
 static int mavlink_open_uart(int baudrate, const char *uart_name, struct termios *uart_config_original, bool *is_usb);
+static void mavlink_link_set_rates(mavlink_channel_t channel);
 static void usage(void);
-int set_mavlink_interval_limit(struct mavlink_subscriptions *subs, int mavlink_msg_id, int min_interval);
+int set_mavlink_interval_limit(struct mavlink_subscriptions *subs, mavlink_channel_t channel, int mavlink_msg_id, int min_interval);
 
 
 
@@ -154,33 +150,47 @@ set_hil_on_off(bool hil_enabled)
 
 		mavlink_hil_enabled = true;
 
-		/* ramp up some HIL-related subscriptions */
-		unsigned hil_rate_interval;
+		/* ramp up some HIL-related streams on the telemetry links */
+		for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+			unsigned baudrate = mavlink_links[ch].baudrate;
+			unsigned hil_rate_interval;
 
-		if (baudrate < 19200) {
-			/* 10 Hz */
-			hil_rate_interval = 100;
+			if (mavlink_links[ch].onboard)
+				continue;
 
-		} else if (baudrate < 38400) {
-			/* 10 Hz */
-			hil_rate_interval = 100;
+			if (baudrate < 19200) {
+				/* 10 Hz */
+				hil_rate_interval = 100;
 
-		} else if (baudrate < 115200) {
-			/* 20 Hz */
-			hil_rate_interval = 50;
+			} else if (baudrate < 38400) {
+				/* 10 Hz */
+				hil_rate_interval = 100;
 
-		} else {
-			/* 200 Hz */
-			hil_rate_interval = 5;
+			} else if (baudrate < 115200) {
+				/* 20 Hz */
+				hil_rate_interval = 50;
+
+			} else {
+				/* 200 Hz */
+				hil_rate_interval = 5;
+			}
+
+			mavlink_stream_set_interval(ch, MAVLINK_STREAM_ATTITUDE_SETPOINT, hil_rate_interval);
+			set_mavlink_interval_limit(&mavlink_subs, ch, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, hil_rate_interval);
 		}
 
-		orb_set_interval(mavlink_subs.spa_sub, hil_rate_interval);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, hil_rate_interval);
+		orb_set_interval(mavlink_subs.spa_sub, mavlink_stream_min_interval(MAVLINK_STREAM_ATTITUDE_SETPOINT));
 	}
 
 	if (!hil_enabled && mavlink_hil_enabled) {
 		mavlink_hil_enabled = false;
-		orb_set_interval(mavlink_subs.spa_sub, 200);
+
+		for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+			if (!mavlink_links[ch].onboard)
+				mavlink_stream_set_interval(ch, MAVLINK_STREAM_ATTITUDE_SETPOINT, 200);
+		}
+
+		orb_set_interval(mavlink_subs.spa_sub, mavlink_stream_min_interval(MAVLINK_STREAM_ATTITUDE_SETPOINT));
 
 	} else {
 		ret = ERROR;
@@ -289,47 +299,61 @@ get_mavlink_mode_and_state(uint8_t *mavlink_state, uint8_t *mavlink_mode)
 }
 
 
-int set_mavlink_interval_limit(struct mavlink_subscriptions *subs, int mavlink_msg_id, int min_interval)
+/**
+ * Set the rate of a message on one link.
+ *
+ * The uORB subscriptions are shared by all links, so the topic feeding the
+ * message is throttled to the fastest rate any link asks for; each link's
+ * stream table then thins that out to its own rate.
+ */
+int set_mavlink_interval_limit(struct mavlink_subscriptions *subs, mavlink_channel_t channel, int mavlink_msg_id, int min_interval)
 {
 	int ret = OK;
 
 	switch (mavlink_msg_id) {
 	case MAVLINK_MSG_ID_SCALED_IMU:
-		/* sensor sub triggers scaled IMU */
-		orb_set_interval(subs->sensor_sub, min_interval);
-		break;
-
 	case MAVLINK_MSG_ID_HIGHRES_IMU:
-		/* sensor sub triggers highres IMU */
-		orb_set_interval(subs->sensor_sub, min_interval);
-		break;
-
 	case MAVLINK_MSG_ID_RAW_IMU:
-		/* sensor sub triggers RAW IMU */
-		orb_set_interval(subs->sensor_sub, min_interval);
+		/* sensor sub triggers scaled, highres and raw IMU */
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_HIGHRES_IMU, min_interval);
+		orb_set_interval(subs->sensor_sub, mavlink_stream_min_interval(MAVLINK_STREAM_HIGHRES_IMU));
 		break;
 
 	case MAVLINK_MSG_ID_ATTITUDE:
 		/* attitude sub triggers attitude */
-		orb_set_interval(subs->att_sub, min_interval);
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_ATTITUDE, min_interval);
+		orb_set_interval(subs->att_sub, mavlink_stream_min_interval(MAVLINK_STREAM_ATTITUDE));
+		break;
+
+	case MAVLINK_MSG_ID_GPS_RAW_INT:
+		/* vehicle_gps_position triggers this message */
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_GPS_RAW_INT, min_interval);
+		orb_set_interval(subs->gps_sub, mavlink_stream_min_interval(MAVLINK_STREAM_GPS_RAW_INT));
 		break;
 
 	case MAVLINK_MSG_ID_SERVO_OUTPUT_RAW:
 		/* actuator_outputs triggers this message */
-		orb_set_interval(subs->act_0_sub, min_interval);
-		orb_set_interval(subs->act_1_sub, min_interval);
-		orb_set_interval(subs->act_2_sub, min_interval);
-		orb_set_interval(subs->act_3_sub, min_interval);
-		orb_set_interval(subs->actuators_sub, min_interval);
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_SERVO_OUTPUT_RAW_0, min_interval);
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_SERVO_OUTPUT_RAW_1, min_interval);
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_SERVO_OUTPUT_RAW_2, min_interval);
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_SERVO_OUTPUT_RAW_3, min_interval);
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_CONTROLS_EFFECTIVE, min_interval);
+		orb_set_interval(subs->act_0_sub, mavlink_stream_min_interval(MAVLINK_STREAM_SERVO_OUTPUT_RAW_0));
+		orb_set_interval(subs->act_1_sub, mavlink_stream_min_interval(MAVLINK_STREAM_SERVO_OUTPUT_RAW_1));
+		orb_set_interval(subs->act_2_sub, mavlink_stream_min_interval(MAVLINK_STREAM_SERVO_OUTPUT_RAW_2));
+		orb_set_interval(subs->act_3_sub, mavlink_stream_min_interval(MAVLINK_STREAM_SERVO_OUTPUT_RAW_3));
+		orb_set_interval(subs->actuators_sub, mavlink_stream_min_interval(MAVLINK_STREAM_CONTROLS_EFFECTIVE));
 		break;
 
 	case MAVLINK_MSG_ID_MANUAL_CONTROL:
 		/* manual_control_setpoint triggers this message */
-		orb_set_interval(subs->man_control_sp_sub, min_interval);
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_MANUAL_CONTROL, min_interval);
+		orb_set_interval(subs->man_control_sp_sub, mavlink_stream_min_interval(MAVLINK_STREAM_MANUAL_CONTROL));
 		break;
 
 	case MAVLINK_MSG_ID_NAMED_VALUE_FLOAT:
-		orb_set_interval(subs->debug_key_value, min_interval);
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_DEBUG, min_interval);
+		orb_set_interval(subs->debug_key_value, mavlink_stream_min_interval(MAVLINK_STREAM_DEBUG));
 		break;
 
 	default:
@@ -346,12 +370,21 @@ int set_mavlink_interval_limit(struct mavlink_subscriptions *subs, int mavlink_m
  * MAVLink text message logger
  ****************************************************************************/
 
+static ssize_t	mavlink_dev_write(struct file *filep, const char *buffer, size_t buflen);
 static int	mavlink_dev_ioctl(struct file *filep, int cmd, unsigned long arg);
 
 static const struct file_operations mavlink_fops = {
+	.write = mavlink_dev_write,
 	.ioctl = mavlink_dev_ioctl
 };
 
+/* data written to the device goes to the log stream */
+static ssize_t
+mavlink_dev_write(struct file *filep, const char *buffer, size_t buflen)
+{
+	return mavlink_logstream_write((const uint8_t *)buffer, buflen);
+}
+
 static int
 mavlink_dev_ioctl(struct file *filep, int cmd, unsigned long arg)
 {
@@ -369,6 +402,13 @@ mavlink_dev_ioctl(struct file *filep, int cmd, unsigned long arg)
 			return OK;
 		}
 
+	case (int)MAVLINK_IOC_LOGSTREAM_START:
+		return mavlink_logstream_start((uint32_t)arg);
+
+	case (int)MAVLINK_IOC_LOGSTREAM_STOP:
+		mavlink_logstream_stop();
+		return OK;
+
 	default:
 		return ENOTTY;
 	}
@@ -376,6 +416,9 @@ mavlink_dev_ioctl(struct file *filep, int cmd, unsigned long arg)
 
 #define MAVLINK_OFFBOARD_CONTROL_FLAG_ARMED 0x10
 
+/* main loop tick; streams driven from the main loop can not run faster than this */
+#define MAVLINK_MAIN_LOOP_INTERVAL 10000
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -435,7 +478,7 @@ int mavlink_open_uart(int baud, const char *uart_name, struct termios *uart_conf
 
 	/* open uart */
 	printf("[mavlink] UART is %s, baudrate is %d\n", uart_name, baud);
-	uart = open(uart_name, O_RDWR | O_NOCTTY);
+	int uart = open(uart_name, O_RDWR | O_NOCTTY);
 
 	/* Try to set baud rate */
 	struct termios uart_config;
@@ -478,12 +521,6 @@ int mavlink_open_uart(int baud, const char *uart_name, struct termios *uart_conf
 	return uart;
 }
 
-void
-mavlink_send_uart_bytes(mavlink_channel_t channel, uint8_t *ch, int length)
-{
-	write(uart, ch, (size_t)(sizeof(uint8_t) * length));
-}
-
 /*
  * Internal function to give access to the channel status for each channel
  */
@@ -539,6 +576,87 @@ void mavlink_update_system(void)
 	}
 }
 
+/**
+ * Set up the initial stream rates of a link from its speed.
+ */
+void mavlink_link_set_rates(mavlink_channel_t channel)
+{
+	struct mavlink_link *link = &mavlink_links[channel];
+	unsigned baudrate = link->baudrate;
+
+	if (link->onboard) {
+		/* a companion computer only needs to know we are alive */
+		for (unsigned i = 0; i < MAVLINK_STREAM_COUNT; i++) {
+			if (i != MAVLINK_STREAM_HEARTBEAT && i != MAVLINK_STREAM_SYS_STATUS && i != MAVLINK_STREAM_FORWARD)
+				mavlink_stream_set_interval(channel, i, MAVLINK_STREAM_OFF);
+		}
+
+		return;
+	}
+
+	/* the log stream needs the bandwidth of USB */
+	if (!link->is_usb)
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_LOG, MAVLINK_STREAM_OFF);
+
+	if (baudrate > 57600)
+		mavlink_stream_set_interval(channel, MAVLINK_STREAM_PARAM_VALUE, 25);
+
+	if (baudrate >= 230400) {
+		/* 200 Hz / 5 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_HIGHRES_IMU, 20);
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_RAW_IMU, 20);
+		/* 50 Hz / 20 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_ATTITUDE, 30);
+		/* 20 Hz / 50 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 10);
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, 50);
+		/* 10 Hz */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_GPS_RAW_INT, 100);
+		/* 10 Hz */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_MANUAL_CONTROL, 100);
+
+	} else if (baudrate >= 115200) {
+		/* 20 Hz / 50 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_HIGHRES_IMU, 50);
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_RAW_IMU, 50);
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_ATTITUDE, 50);
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 50);
+		/* 5 Hz / 200 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, 200);
+		/* 5 Hz / 200 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_GPS_RAW_INT, 200);
+		/* 2 Hz */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_MANUAL_CONTROL, 500);
+
+	} else if (baudrate >= 57600) {
+		/* 10 Hz / 100 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_RAW_IMU, 300);
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_HIGHRES_IMU, 300);
+		/* 10 Hz / 100 ms ATTITUDE */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_ATTITUDE, 200);
+		/* 5 Hz / 200 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 200);
+		/* 5 Hz / 200 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, 500);
+		/* 2 Hz */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_MANUAL_CONTROL, 500);
+		/* 2 Hz */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_GPS_RAW_INT, 500);
+
+	} else {
+		/* very low baud rate, limit to 1 Hz / 1000 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_RAW_IMU, 1000);
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_ATTITUDE, 1000);
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_HIGHRES_IMU, 1000);
+		/* 1 Hz / 1000 ms */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 1000);
+		/* 0.5 Hz */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, 2000);
+		/* 0.1 Hz */
+		set_mavlink_interval_limit(&mavlink_subs, channel, MAVLINK_MSG_ID_MANUAL_CONTROL, 10000);
+	}
+}
+
 /**
  * MAVLink Protocol main function.
  */
@@ -548,33 +666,52 @@ int mavlink_thread_main(int argc, char *argv[])
 	mavlink_logbuffer_init(&lb, 5);
 
 	int ch;
-	char *device_name = "/dev/ttyS1";
-	baudrate = 57600;
+
+	/* the first link has defaults, every further -d adds a link; -b, -o and -f apply to the last one */
+	struct mavlink_link *link = &mavlink_links[0];
+	memset(mavlink_links, 0, sizeof(mavlink_links));
+	link->device = "/dev/ttyS1";
+	link->baudrate = 57600;
+	mavlink_link_count = 1;
+	bool device_given = false;
 
 	/* work around some stupidity in task_create's argv handling */
 	argc -= 2;
 	argv += 2;
 
-	while ((ch = getopt(argc, argv, "b:d:eo")) != EOF) {
+	while ((ch = getopt(argc, argv, "b:d:efo")) != EOF) {
 		switch (ch) {
 		case 'b':
-			baudrate = strtoul(optarg, NULL, 10);
+			link->baudrate = strtoul(optarg, NULL, 10);
 
-			if (baudrate == 0)
+			if (link->baudrate == 0)
 				errx(1, "invalid baud rate '%s'", optarg);
 
 			break;
 
 		case 'd':
-			device_name = optarg;
+			if (device_given) {
+				if (mavlink_link_count == MAVLINK_LINKS_MAX)
+					errx(1, "at most %d links", MAVLINK_LINKS_MAX);
+
+				link = &mavlink_links[mavlink_link_count++];
+				link->baudrate = 57600;
+			}
+
+			link->device = optarg;
+			device_given = true;
 			break;
 
 		case 'e':
 			mavlink_link_termination_allowed = true;
 			break;
 
+		case 'f':
+			link->forward = true;
+			break;
+
 		case 'o':
-			mavlink_link_mode = MAVLINK_INTERFACE_MODE_ONBOARD;
+			link->onboard = true;
 			break;
 
 		default:
@@ -582,181 +719,150 @@ int mavlink_thread_main(int argc, char *argv[])
 		}
 	}
 
-	struct termios uart_config_original;
-
-	bool usb_uart;
-
 	/* print welcome text */
 	warnx("MAVLink v1.0 serial interface starting...");
 
-	/* inform about mode */
-	warnx((mavlink_link_mode == MAVLINK_INTERFACE_MODE_ONBOARD) ? "ONBOARD MODE" : "DOWNLINK MODE");
-
 	/* Flush stdout in case MAVLink is about to take it over */
 	fflush(stdout);
 
-	/* default values for arguments */
-	uart = mavlink_open_uart(baudrate, device_name, &uart_config_original, &usb_uart);
+	for (unsigned i = 0; i < mavlink_link_count; i++) {
+		link = &mavlink_links[i];
+
+		/* inform about mode */
+		warnx("link %u: %s %s", i, link->device, link->onboard ? "ONBOARD MODE" : "DOWNLINK MODE");
+
+		link->fd = mavlink_open_uart(link->baudrate, link->device, &link->uart_config_original, &link->is_usb);
 
-	if (uart < 0)
-		err(1, "could not open %s", device_name);
+		if (link->fd < 0)
+			err(1, "could not open %s", link->device);
+
+		/* budget the streams by the line rate; USB is not limited by the baud rate */
+		mavlink_streams_init(i, link->is_usb ? 0 : link->baudrate);
+
+		/* start the writer before anything is sent */
+		link->tx_thread = mavlink_tx_start(i, link->fd, link->is_usb ? MAVLINK_TX_QUEUE_SIZE_USB : MAVLINK_TX_QUEUE_SIZE);
+	}
 
 	/* create the device node that's used for sending text log messages, etc. */
+	mavlink_logstream_init();
 	register_driver(MAVLINK_LOG_DEVICE, &mavlink_fops, 0666, NULL);
 
 	/* Initialize system properties */
 	mavlink_update_system();
 
-	/* start the MAVLink receiver */
-	receive_thread = receive_start(uart);
+	/* initialize waypoint manager and restore the stored mission before any mission message arrives */
+	mavlink_wpm_init(wpm);
+
+	/* start the MAVLink receivers */
+	for (unsigned i = 0; i < mavlink_link_count; i++)
+		mavlink_links[i].receive_thread = receive_start(i);
 
 	/* start the ORB receiver */
 	uorb_receive_thread = uorb_receive_start();
 
-	/* initialize waypoint manager */
-	mavlink_wpm_init(wpm);
-
 	/* all subscriptions are now active, set up initial guess about rate limits */
-	if (baudrate >= 230400) {
-		/* 200 Hz / 5 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_HIGHRES_IMU, 20);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_RAW_IMU, 20);
-		/* 50 Hz / 20 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_ATTITUDE, 30);
-		/* 20 Hz / 50 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 10);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, 50);
-		/* 10 Hz */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_GPS_RAW_INT, 100);
-		/* 10 Hz */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_MANUAL_CONTROL, 100);
-
-	} else if (baudrate >= 115200) {
-		/* 20 Hz / 50 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_HIGHRES_IMU, 50);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_RAW_IMU, 50);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_ATTITUDE, 50);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 50);
-		/* 5 Hz / 200 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, 200);
-		/* 5 Hz / 200 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_GPS_RAW_INT, 200);
-		/* 2 Hz */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_MANUAL_CONTROL, 500);
-
-	} else if (baudrate >= 57600) {
-		/* 10 Hz / 100 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_RAW_IMU, 300);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_HIGHRES_IMU, 300);
-		/* 10 Hz / 100 ms ATTITUDE */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_ATTITUDE, 200);
-		/* 5 Hz / 200 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 200);
-		/* 5 Hz / 200 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, 500);
-		/* 2 Hz */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_MANUAL_CONTROL, 500);
-		/* 2 Hz */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_GPS_RAW_INT, 500);
-
-	} else {
-		/* very low baud rate, limit to 1 Hz / 1000 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_RAW_IMU, 1000);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_ATTITUDE, 1000);
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_HIGHRES_IMU, 1000);
-		/* 1 Hz / 1000 ms */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_NAMED_VALUE_FLOAT, 1000);
-		/* 0.5 Hz */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_SERVO_OUTPUT_RAW, 2000);
-		/* 0.1 Hz */
-		set_mavlink_interval_limit(&mavlink_subs, MAVLINK_MSG_ID_MANUAL_CONTROL, 10000);
-	}
+	for (unsigned i = 0; i < mavlink_link_count; i++)
+		mavlink_link_set_rates(i);
 
 	thread_running = true;
 
-	/* arm counter to go off immediately */
-	unsigned lowspeed_counter = 10;
+	hrt_abstime last_system_update = 0;
+	hrt_abstime last_waypoint_check = 0;
 
 	while (!thread_should_exit) {
 
+		hrt_abstime now = hrt_absolute_time();
+
 		/* 1 Hz */
-		if (lowspeed_counter == 10) {
+		if (now - last_system_update >= 1000000) {
 			mavlink_update_system();
 
-			/* translate the current system state to mavlink state and mode */
-			uint8_t mavlink_state = 0;
-			uint8_t mavlink_mode = 0;
-			get_mavlink_mode_and_state(&mavlink_state, &mavlink_mode);
-
-			/* send heartbeat */
-			mavlink_msg_heartbeat_send(chan, mavlink_system.type, MAV_AUTOPILOT_PX4, mavlink_mode, v_status.state_machine, mavlink_state);
-
 			/* switch HIL mode if required */
 			set_hil_on_off(v_status.flag_hil_enabled);
 
-			/* send status (values already copied in the section above) */
-			mavlink_msg_sys_status_send(chan,
-						    v_status.onboard_control_sensors_present,
-						    v_status.onboard_control_sensors_enabled,
-						    v_status.onboard_control_sensors_health,
-						    v_status.load,
-						    v_status.voltage_battery * 1000.0f,
-						    v_status.current_battery * 1000.0f,
-						    v_status.battery_remaining,
-						    v_status.drop_rate_comm,
-						    v_status.errors_comm,
-						    v_status.errors_count1,
-						    v_status.errors_count2,
-						    v_status.errors_count3,
-						    v_status.errors_count4);
-			lowspeed_counter = 0;
+			last_system_update = now;
 		}
 
-		lowspeed_counter++;
-
-		/* sleep quarter the time */
-		usleep(25000);
-
-		/* check if waypoint has been reached against the last positions */
-		mavlink_waypoint_eventloop(mavlink_missionlib_get_system_timestamp(), &global_pos, &local_pos);
-
-		/* sleep quarter the time */
-		usleep(25000);
-
-		/* send parameters at 20 Hz (if queued for sending) */
-		mavlink_pm_queued_send();
+		/* translate the current system state to mavlink state and mode */
+		uint8_t mavlink_state = 0;
+		uint8_t mavlink_mode = 0;
+		get_mavlink_mode_and_state(&mavlink_state, &mavlink_mode);
 
-		/* sleep quarter the time */
-		usleep(25000);
+		for (unsigned i = 0; i < mavlink_link_count; i++) {
+			/* send heartbeat */
+			if (mavlink_stream_permit(i, MAVLINK_STREAM_HEARTBEAT))
+				mavlink_msg_heartbeat_send(i, mavlink_system.type, MAV_AUTOPILOT_PX4, mavlink_mode, v_status.state_machine, mavlink_state);
+
+			if (mavlink_stream_permit(i, MAVLINK_STREAM_SYS_STATUS)) {
+				/* send status (values already copied by the uORB listener) */
+				mavlink_msg_sys_status_send(i,
+							    v_status.onboard_control_sensors_present,
+							    v_status.onboard_control_sensors_enabled,
+							    v_status.onboard_control_sensors_health,
+							    v_status.load,
+							    v_status.voltage_battery * 1000.0f,
+							    v_status.current_battery * 1000.0f,
+							    v_status.battery_remaining,
+							    v_status.drop_rate_comm,
+							    v_status.errors_comm,
+							    v_status.errors_count1,
+							    v_status.errors_count2,
+							    v_status.errors_count3,
+							    v_status.errors_count4);
+			}
+		}
 
-		if (baudrate > 57600) {
-			mavlink_pm_queued_send();
+		/* check if waypoint has been reached against the last positions, 10 Hz */
+		if (now - last_waypoint_check >= 100000) {
+			mavlink_waypoint_eventloop(mavlink_missionlib_get_system_timestamp(), &global_pos, &local_pos);
+			last_waypoint_check = now;
 		}
 
-		/* sleep 10 ms */
-		usleep(10000);
+		/* send parameters if queued for sending, on the link that asked for them */
+		if (mavlink_stream_permit(mavlink_pm_queued_channel(), MAVLINK_STREAM_PARAM_VALUE))
+			mavlink_pm_queued_send();
 
-		/* send one string at 10 Hz */
+		/* send one string at a time, to all links that have room for it */
 		if (!mavlink_logbuffer_is_empty(&lb)) {
+			unsigned due = 0;
+
+			for (unsigned i = 0; i < mavlink_link_count; i++) {
+				if (mavlink_stream_permit(i, MAVLINK_STREAM_STATUSTEXT))
+					due |= (1 << i);
+			}
+
 			struct mavlink_logmessage msg;
-			int lb_ret = mavlink_logbuffer_read(&lb, &msg);
 
-			if (lb_ret == OK) {
-				mavlink_missionlib_send_gcs_string(msg.text);
+			if (due != 0 && mavlink_logbuffer_read(&lb, &msg) == OK) {
+				for (unsigned i = 0; i < mavlink_link_count; i++) {
+					if (due & (1 << i))
+						mavlink_msg_statustext_send(i, 0, msg.text);
+				}
 			}
 		}
 
-		/* sleep 15 ms */
-		usleep(15000);
+		mavlink_streams_update(now);
+
+		usleep(MAVLINK_MAIN_LOOP_INTERVAL);
 	}
 
 	/* wait for threads to complete */
-	pthread_join(receive_thread, NULL);
+	for (unsigned i = 0; i < mavlink_link_count; i++)
+		pthread_join(mavlink_links[i].receive_thread, NULL);
+
 	pthread_join(uorb_receive_thread, NULL);
 
-	/* Reset the UART flags to original state */
-	if (!usb_uart)
-		tcsetattr(uart, TCSANOW, &uart_config_original);
+	for (unsigned i = 0; i < mavlink_link_count; i++) {
+		link = &mavlink_links[i];
+
+		mavlink_tx_stop(i);
+		pthread_join(link->tx_thread, NULL);
+		mavlink_tx_free(i);
+
+		/* Reset the UART flags to original state */
+		if (!link->is_usb)
+			tcsetattr(link->fd, TCSANOW, &link->uart_config_original);
+	}
 
 	thread_running = false;
 
@@ -766,9 +872,12 @@ int mavlink_thread_main(int argc, char *argv[])
 static void
 usage()
 {
-	fprintf(stderr, "usage: mavlink start [-d <devicename>] [-b <baud rate>]\n"
+	fprintf(stderr, "usage: mavlink start [-d <devicename>] [-b <baud rate>] [-o] [-f] [-d <devicename> ...]\n"
 		"       mavlink stop\n"
-		"       mavlink status\n");
+		"       mavlink status\n"
+		"\t-d\tadd a link on the device; -b, -o and -f apply to the last link given\n"
+		"\t-o\tonboard (companion computer) link, heartbeat and status only\n"
+		"\t-f\tforward received messages to the other links started with -f\n");
 	exit(1);
 }
 
@@ -810,6 +919,17 @@ int mavlink_main(int argc, char *argv[])
 
 	if (!strcmp(argv[1], "status")) {
 		if (thread_running) {
+			for (unsigned i = 0; i < mavlink_link_count; i++) {
+				printf("link %u: %s%s%s\n", i, mavlink_links[i].device,
+				       mavlink_links[i].onboard ? ", onboard" : "",
+				       mavlink_links[i].forward ? ", forwarding" : "");
+				mavlink_streams_print(i);
+				mavlink_tx_print(i);
+			}
+
+			mavlink_logstream_print();
+			mission_store_print();
+
 			errx(0, "running");
 
 		} else {
@@ -48,6 +48,10 @@
 /* use efficient approach, see mavlink_helpers.h */
 #define MAVLINK_SEND_UART_BYTES mavlink_send_uart_bytes
 
+/* queue each message whole, see mavlink_tx.c */
+#define MAVLINK_START_UART_SEND mavlink_start_uart_send
+#define MAVLINK_END_UART_SEND mavlink_end_uart_send
+
 #define MAVLINK_GET_CHANNEL_BUFFER mavlink_get_channel_buffer
 #define MAVLINK_GET_CHANNEL_STATUS mavlink_get_channel_status
 
@@ -75,6 +79,12 @@ extern mavlink_system_t mavlink_system;
  */
 extern void mavlink_send_uart_bytes(mavlink_channel_t chan, uint8_t *ch, int length);
 
+/**
+ * @brief Bracket a message of the given length sent with mavlink_send_uart_bytes
+ */
+extern void mavlink_start_uart_send(mavlink_channel_t chan, int length);
+extern void mavlink_end_uart_send(mavlink_channel_t chan, int length);
+
 mavlink_status_t *mavlink_get_channel_status(uint8_t chan);
 mavlink_message_t *mavlink_get_channel_buffer(uint8_t chan);
 
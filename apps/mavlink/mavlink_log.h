@@ -57,6 +57,14 @@
 #define MAVLINK_IOC_SEND_TEXT_CRITICAL		_IOC(0x1100, 2)
 #define MAVLINK_IOC_SEND_TEXT_EMERGENCY		_IOC(0x1100, 3)
 
+/*
+ * Log streaming: data written to the device after MAVLINK_IOC_LOGSTREAM_START
+ * (argument: record size in bytes) is streamed to the host over MAVLink,
+ * until MAVLINK_IOC_LOGSTREAM_STOP.
+ */
+#define MAVLINK_IOC_LOGSTREAM_START		_IOC(0x1100, 4)
+#define MAVLINK_IOC_LOGSTREAM_STOP		_IOC(0x1100, 5)
+
 /**
  * Send a mavlink emergency message.
  *
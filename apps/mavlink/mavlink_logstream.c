@@ -0,0 +1,239 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *   Author: Lorenz Meier <lm@inf.ethz.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_logstream.c
+ * Streaming of the onboard log over MAVLink.
+ *
+ * Log data is written straight into the window slot of the packet being
+ * filled; a full slot is sent and stays in the window until its slot is
+ * reused MAVLINK_LOGSTREAM_WINDOW packets later. Writes come from the
+ * logging task, resend requests from the receive threads, both under
+ * one lock. Sending only queues into the link's transmit ring, so the lock
+ * is never held across serial I/O.
+ */
+
+#include <nuttx/config.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "mavlink_logstream.h"
+#include "mavlink_streams.h"
+#include "waypoints.h"
+#include "util.h"
+
+struct logstream_slot {
+	uint16_t	seqnr;
+	bool		valid;			/**< packet complete and sent */
+	uint8_t		data[MAVLINK_LOGSTREAM_PAYLOAD];
+};
+
+static pthread_mutex_t logstream_lock;
+static struct logstream_slot *window;
+
+static bool active;
+static uint16_t seqnr;				/**< packet being filled */
+static unsigned fill;				/**< bytes in the packet being filled */
+static uint32_t record_size;
+static uint32_t stream_bytes;
+
+/* statistics */
+static unsigned packets_sent;
+static unsigned packets_resent;
+static unsigned resend_missed;
+
+static void
+logstream_handshake(uint32_t size)
+{
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (mavlink_stream_permit(ch, MAVLINK_STREAM_LOG))
+			mavlink_msg_data_transmission_handshake_send(ch, MAVLINK_LOGSTREAM_DATA_TYPE, size,
+					record_size, 0, MAVLINK_LOGSTREAM_WINDOW, MAVLINK_LOGSTREAM_PAYLOAD, 0);
+	}
+}
+
+/* must be called with the lock held */
+static void
+logstream_complete(struct logstream_slot *slot)
+{
+	slot->valid = true;
+
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		/* a packet the link had no room for shows up as a gap at the host */
+		if (mavlink_stream_permit(ch, MAVLINK_STREAM_LOG))
+			mavlink_msg_encapsulated_data_send(ch, slot->seqnr, slot->data);
+	}
+
+	packets_sent++;
+	seqnr = (seqnr + 1) & MAVLINK_LOGSTREAM_SEQ_MASK;
+	fill = 0;
+}
+
+void
+mavlink_logstream_init(void)
+{
+	pthread_mutex_init(&logstream_lock, NULL);
+}
+
+int
+mavlink_logstream_start(uint32_t size)
+{
+	pthread_mutex_lock(&logstream_lock);
+
+	if (window == NULL)
+		window = (struct logstream_slot *)malloc(MAVLINK_LOGSTREAM_WINDOW * sizeof(struct logstream_slot));
+
+	if (window == NULL) {
+		pthread_mutex_unlock(&logstream_lock);
+		return -ENOMEM;
+	}
+
+	memset(window, 0, MAVLINK_LOGSTREAM_WINDOW * sizeof(struct logstream_slot));
+	seqnr = 0;
+	fill = 0;
+	record_size = size;
+	stream_bytes = 0;
+	packets_sent = 0;
+	packets_resent = 0;
+	resend_missed = 0;
+	active = true;
+
+	logstream_handshake(0);
+
+	pthread_mutex_unlock(&logstream_lock);
+	return OK;
+}
+
+ssize_t
+mavlink_logstream_write(const uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+
+	pthread_mutex_lock(&logstream_lock);
+
+	if (!active) {
+		pthread_mutex_unlock(&logstream_lock);
+		return -EPIPE;
+	}
+
+	while (done < len) {
+		struct logstream_slot *slot = &window[seqnr % MAVLINK_LOGSTREAM_WINDOW];
+
+		if (fill == 0) {
+			/* reuse the slot of the oldest packet */
+			slot->seqnr = seqnr;
+			slot->valid = false;
+		}
+
+		size_t n = MAVLINK_LOGSTREAM_PAYLOAD - fill;
+
+		if (n > len - done)
+			n = len - done;
+
+		memcpy(&slot->data[fill], &buf[done], n);
+		fill += n;
+		done += n;
+
+		if (fill == MAVLINK_LOGSTREAM_PAYLOAD)
+			logstream_complete(slot);
+	}
+
+	stream_bytes += len;
+
+	pthread_mutex_unlock(&logstream_lock);
+	return len;
+}
+
+void
+mavlink_logstream_stop(void)
+{
+	pthread_mutex_lock(&logstream_lock);
+
+	if (active) {
+		if (fill > 0) {
+			struct logstream_slot *slot = &window[seqnr % MAVLINK_LOGSTREAM_WINDOW];
+			memset(&slot->data[fill], 0, MAVLINK_LOGSTREAM_PAYLOAD - fill);
+			logstream_complete(slot);
+		}
+
+		logstream_handshake(stream_bytes);
+		active = false;
+	}
+
+	pthread_mutex_unlock(&logstream_lock);
+}
+
+void
+mavlink_logstream_resend(mavlink_channel_t channel, uint16_t first, uint16_t count)
+{
+	pthread_mutex_lock(&logstream_lock);
+
+	if (window != NULL) {
+		/* more than the window can not be in it */
+		if (count > MAVLINK_LOGSTREAM_WINDOW) {
+			resend_missed += count - MAVLINK_LOGSTREAM_WINDOW;
+			first += count - MAVLINK_LOGSTREAM_WINDOW;
+			count = MAVLINK_LOGSTREAM_WINDOW;
+		}
+
+		for (uint16_t i = 0; i < count; i++) {
+			uint16_t n = (first + i) & MAVLINK_LOGSTREAM_SEQ_MASK;
+			const struct logstream_slot *slot = &window[n % MAVLINK_LOGSTREAM_WINDOW];
+
+			if (slot->valid && slot->seqnr == n) {
+				mavlink_msg_encapsulated_data_send(channel, n, slot->data);
+				packets_resent++;
+
+			} else {
+				resend_missed++;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&logstream_lock);
+}
+
+void
+mavlink_logstream_print(void)
+{
+	if (window == NULL)
+		return;
+
+	printf("log stream: %s, %u bytes in %u packets, %u resent, %u requested packets no longer available\n",
+	       active ? "active" : "stopped", (unsigned)stream_bytes, packets_sent, packets_resent, resend_missed);
+}
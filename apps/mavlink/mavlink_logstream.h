@@ -0,0 +1,139 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *   Author: Lorenz Meier <lm@inf.ethz.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_logstream.h
+ * Streaming of the onboard log over MAVLink.
+ *
+ * When the vehicle is tethered, sdlog writes its records to the MAVLink
+ * log device instead of the microSD card. The byte stream is cut into
+ * ENCAPSULATED_DATA packets numbered by seqnr and sent on every link that
+ * has the log stream enabled (USB links by default). The most recent
+ * packets are kept in a window so the host can ask again for the ones it
+ * missed.
+ *
+ * Packet n carries stream bytes n * MAVLINK_LOGSTREAM_PAYLOAD onwards, so
+ * the host can place every packet it receives and drop only the records
+ * touched by a packet that could not be recovered. The stream uses the low
+ * 15 bits of seqnr; packets with bit 15 set are parameter blocks (see
+ * mavlink_parameters.h).
+ *
+ * The stream is controlled with DATA_TRANSMISSION_HANDSHAKE messages of
+ * type MAVLINK_LOGSTREAM_DATA_TYPE:
+ *  - stream start (vehicle): size 0, width record size, packets window
+ *    length, payload bytes per packet
+ *  - stream end (vehicle): size total stream bytes, width record size
+ *  - resend request (host): width first seqnr, height number of packets
+ *
+ * Both messages are part of the pixhawk dialect only; the receiver adds the
+ * handshake to its tables.
+ */
+
+#ifndef MAVLINK_LOGSTREAM_H
+#define MAVLINK_LOGSTREAM_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "mavlink_bridge_header.h"
+#include <v1.0/common/mavlink.h>
+#include <v1.0/pixhawk/mavlink_msg_data_transmission_handshake.h>
+#include <v1.0/pixhawk/mavlink_msg_encapsulated_data.h>
+
+/** handshake type of the log stream, outside the range of DATA_TYPES */
+#define MAVLINK_LOGSTREAM_DATA_TYPE		16
+
+/** CRC extra byte of DATA_TRANSMISSION_HANDSHAKE in the pixhawk dialect */
+#define MAVLINK_LOGSTREAM_HANDSHAKE_CRC_EXTRA	23
+
+/** stream bytes per packet */
+#define MAVLINK_LOGSTREAM_PAYLOAD		MAVLINK_MSG_ENCAPSULATED_DATA_FIELD_DATA_LEN
+
+/** sequence numbers of the log stream wrap at 32768 */
+#define MAVLINK_LOGSTREAM_SEQ_MASK		0x7fff
+
+/** packets kept for resending, must divide 32768 */
+#define MAVLINK_LOGSTREAM_WINDOW		64
+
+/**
+ * Set up the log stream state; call once before the log device is registered.
+ */
+void mavlink_logstream_init(void);
+
+/**
+ * Start a new log stream.
+ *
+ * Resets the sequence numbers and announces the stream to the host.
+ *
+ * @param record_size	Size of one log record in bytes, passed on to the
+ *			host so it can split the stream.
+ * @return		OK, or -ENOMEM if the resend window could not be allocated.
+ */
+int mavlink_logstream_start(uint32_t record_size);
+
+/**
+ * Append log data to the stream.
+ *
+ * Complete packets are sent immediately; the data is copied, the caller
+ * never blocks on a link.
+ *
+ * @return		Number of bytes accepted, or -EPIPE if no stream is started.
+ */
+ssize_t mavlink_logstream_write(const uint8_t *buf, size_t len);
+
+/**
+ * End the log stream.
+ *
+ * Sends the last, zero-padded packet and announces the stream length. The
+ * window stays available for resend requests until the next start.
+ */
+void mavlink_logstream_stop(void);
+
+/**
+ * Resend packets from the window.
+ *
+ * Packets that already left the window are skipped; the host has to treat
+ * them as lost.
+ *
+ * @param channel	The link the request came in on.
+ * @param first		Sequence number of the first packet.
+ * @param count		Number of packets.
+ */
+void mavlink_logstream_resend(mavlink_channel_t channel, uint16_t first, uint16_t count);
+
+/**
+ * Print the stream statistics.
+ */
+void mavlink_logstream_print(void);
+
+#endif /* MAVLINK_LOGSTREAM_H */
@@ -42,6 +42,7 @@
 #include "mavlink_bridge_header.h"
 #include <v1.0/common/mavlink.h>
 #include "mavlink_parameters.h"
+#include "mavlink_logstream.h"
 #include <uORB/uORB.h>
 #include "math.h" /* isinf / isnan checks */
 #include <assert.h>
@@ -57,8 +58,8 @@
 
 extern mavlink_system_t mavlink_system;
 
-extern int mavlink_missionlib_send_message(mavlink_message_t *msg);
-extern int mavlink_missionlib_send_gcs_string(const char *string);
+extern int mavlink_missionlib_send_message(mavlink_channel_t chan, mavlink_message_t *msg);
+extern int mavlink_missionlib_send_gcs_string(mavlink_channel_t chan, const char *string);
 
 /**
  * If the queue index is not at 0, the queue sending
@@ -67,27 +68,264 @@ extern int mavlink_missionlib_send_gcs_string(const char *string);
  */
 static unsigned int mavlink_param_queue_index = 0;
 
+/**
+ * The hash goes out ahead of the queued list.
+ */
+static bool mavlink_param_hash_pending = false;
+
+/**
+ * The link the queue and the bulk blocks go out on, the one that asked for them.
+ */
+static mavlink_channel_t mavlink_param_queue_chan = MAVLINK_COMM_0;
+
+/**
+ * Bulk transfer: first parameter index of every block, and the range of
+ * blocks still to send.
+ */
+static uint16_t bulk_block_start[MAVLINK_PM_BULK_MAX_BLOCKS + 1];
+static unsigned bulk_blocks = 0;
+static unsigned bulk_next = 0;
+static unsigned bulk_end = 0;
+
+/* FNV-1a */
+static uint32_t
+hash_bytes(uint32_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+static void
+mavlink_pm_hash_callback(void *arg, param_t param)
+{
+	uint32_t *hash = (uint32_t *)arg;
+	const char *name = param_name(param);
+	uint8_t type = param_type(param);
+
+	*hash = hash_bytes(*hash, name, strlen(name) + 1);
+	*hash = hash_bytes(*hash, &type, sizeof(type));
+
+	if (param_type(param) == PARAM_TYPE_INT32 || param_type(param) == PARAM_TYPE_FLOAT) {
+		uint32_t val;
+
+		if (param_get(param, &val) == OK)
+			*hash = hash_bytes(*hash, &val, sizeof(val));
+	}
+}
+
+uint32_t
+mavlink_pm_hash(void)
+{
+	uint32_t hash = 2166136261u;
+	param_foreach(&mavlink_pm_hash_callback, &hash, false);
+	return hash;
+}
+
+static int
+mavlink_pm_send_hash(mavlink_channel_t chan)
+{
+	char name_buf[MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN];
+	uint32_t hash = mavlink_pm_hash();
+	float val_buf;
+	mavlink_message_t tx_msg;
+
+	strncpy(name_buf, MAVLINK_PM_HASH_CHECK, sizeof(name_buf));
+
+	/* as with int32 parameters, the bits travel in the float field */
+	memcpy(&val_buf, &hash, sizeof(val_buf));
+
+	mavlink_msg_param_value_pack_chan(mavlink_system.sysid,
+					  mavlink_system.compid,
+					  chan,
+					  &tx_msg,
+					  name_buf,
+					  val_buf,
+					  MAVLINK_TYPE_UINT32_T,
+					  param_count(),
+					  UINT16_MAX);
+	return mavlink_missionlib_send_message(chan, &tx_msg);
+}
+
+/* bytes a parameter takes in a block, 0 for types MAVLink can not carry */
+static unsigned
+bulk_entry_size(param_t param)
+{
+	if (param_type(param) != PARAM_TYPE_INT32 && param_type(param) != PARAM_TYPE_FLOAT)
+		return 0;
+
+	size_t len = strlen(param_name(param));
+
+	if (len > MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN)
+		len = MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN;
+
+	return 8 + len;
+}
+
+/**
+ * Split the parameter list into blocks.
+ *
+ * Parameters beyond MAVLINK_PM_BULK_MAX_BLOCKS blocks are left to the
+ * single parameter protocol.
+ */
+static void
+mavlink_pm_bulk_layout(void)
+{
+	unsigned count = param_count();
+	unsigned fill = 0;
+	unsigned i;
+
+	bulk_blocks = 0;
+	bulk_block_start[0] = 0;
+
+	for (i = 0; i < count; i++) {
+		unsigned size = bulk_entry_size(param_for_index(i));
+
+		if (fill + size > MAVLINK_MSG_ENCAPSULATED_DATA_FIELD_DATA_LEN) {
+			if (bulk_blocks + 1 == MAVLINK_PM_BULK_MAX_BLOCKS)
+				break;
+
+			bulk_block_start[++bulk_blocks] = i;
+			fill = 0;
+		}
+
+		fill += size;
+	}
+
+	bulk_block_start[++bulk_blocks] = i;
+}
+
+static int
+mavlink_pm_send_block(mavlink_channel_t chan, unsigned block)
+{
+	uint8_t data[MAVLINK_MSG_ENCAPSULATED_DATA_FIELD_DATA_LEN];
+	unsigned pos = 0;
+	mavlink_message_t tx_msg;
+
+	memset(data, 0, sizeof(data));
+
+	for (unsigned i = bulk_block_start[block]; i < bulk_block_start[block + 1]; i++) {
+		param_t param = param_for_index(i);
+		unsigned size = bulk_entry_size(param);
+
+		if (size == 0)
+			continue;
+
+		data[pos + 0] = i & 0xff;
+		data[pos + 1] = i >> 8;
+		data[pos + 2] = (param_type(param) == PARAM_TYPE_INT32) ? MAVLINK_TYPE_INT32_T : MAVLINK_TYPE_FLOAT;
+		data[pos + 3] = size - 8;
+		param_get(param, &data[pos + 4]);
+		memcpy(&data[pos + 8], param_name(param), size - 8);
+		pos += size;
+	}
+
+	mavlink_msg_encapsulated_data_pack_chan(mavlink_system.sysid,
+						mavlink_system.compid,
+						chan,
+						&tx_msg,
+						MAVLINK_PM_BULK_SEQ_FLAG | block,
+						data);
+	return mavlink_missionlib_send_message(chan, &tx_msg);
+}
+
+static int
+mavlink_pm_send_bulk_handshake(mavlink_channel_t chan, uint32_t hash, unsigned blocks)
+{
+	mavlink_message_t tx_msg;
+
+	mavlink_msg_data_transmission_handshake_pack_chan(mavlink_system.sysid,
+							  mavlink_system.compid,
+							  chan,
+							  &tx_msg,
+							  MAVLINK_PM_BULK_DATA_TYPE,
+							  hash,
+							  bulk_block_start[bulk_blocks],
+							  0,
+							  blocks,
+							  MAVLINK_MSG_ENCAPSULATED_DATA_FIELD_DATA_LEN,
+							  0);
+	return mavlink_missionlib_send_message(chan, &tx_msg);
+}
+
+void mavlink_pm_bulk_request(mavlink_channel_t chan, uint32_t cached_hash, uint16_t first, uint16_t count)
+{
+	mavlink_param_queue_chan = chan;
+
+	if (count == 0) {
+		uint32_t hash = mavlink_pm_hash();
+
+		mavlink_pm_bulk_layout();
+
+		if (hash == cached_hash) {
+			/* the GCS copy is current, nothing to send */
+			bulk_next = bulk_end = 0;
+			mavlink_pm_send_bulk_handshake(chan, hash, 0);
+			return;
+		}
+
+		mavlink_pm_send_bulk_handshake(chan, hash, bulk_blocks);
+		bulk_next = 0;
+		bulk_end = bulk_blocks;
+
+		/* the blocks replace a list in progress */
+		mavlink_param_queue_index = param_count();
+		mavlink_param_hash_pending = false;
+
+	} else if (first < bulk_blocks) {
+		/* resend blocks the GCS missed */
+		bulk_next = first;
+		bulk_end = (first + count < bulk_blocks) ? first + count : bulk_blocks;
+	}
+}
+
 /**
  * Callback for param interface.
  */
 void mavlink_pm_callback(void *arg, param_t param);
 
+struct mavlink_pm_send_all {
+	mavlink_channel_t	chan;
+	unsigned int		delay;
+};
+
 void mavlink_pm_callback(void *arg, param_t param)
 {
-	mavlink_pm_send_param(param);
-	usleep(*(unsigned int *)arg);
+	struct mavlink_pm_send_all *all = (struct mavlink_pm_send_all *)arg;
+
+	mavlink_pm_send_param(all->chan, param);
+	usleep(all->delay);
 }
 
-void mavlink_pm_send_all_params(unsigned int delay)
+void mavlink_pm_send_all_params(mavlink_channel_t chan, unsigned int delay)
 {
-	unsigned int dbuf = delay;
-	param_foreach(&mavlink_pm_callback, &dbuf, false);
+	struct mavlink_pm_send_all all = { chan, delay };
+	param_foreach(&mavlink_pm_callback, &all, false);
 }
 
 int mavlink_pm_queued_send()
 {
+	mavlink_channel_t chan = mavlink_param_queue_chan;
+
+	if (bulk_next < bulk_end) {
+		mavlink_pm_send_block(chan, bulk_next);
+		bulk_next++;
+		return 0;
+	}
+
+	if (mavlink_param_hash_pending) {
+		mavlink_param_hash_pending = false;
+		mavlink_pm_send_hash(chan);
+		return 0;
+	}
+
 	if (mavlink_param_queue_index < param_count()) {
-		mavlink_pm_send_param(param_for_index(mavlink_param_queue_index));
+		mavlink_pm_send_param(chan, param_for_index(mavlink_param_queue_index));
 		mavlink_param_queue_index++;
 		return 0;
 
@@ -96,29 +334,36 @@ int mavlink_pm_queued_send()
 	}
 }
 
-void mavlink_pm_start_queued_send()
+mavlink_channel_t mavlink_pm_queued_channel()
+{
+	return mavlink_param_queue_chan;
+}
+
+void mavlink_pm_start_queued_send(mavlink_channel_t chan)
 {
+	mavlink_param_queue_chan = chan;
 	mavlink_param_queue_index = 0;
+	mavlink_param_hash_pending = true;
 }
 
-int mavlink_pm_send_param_for_index(uint16_t index)
+int mavlink_pm_send_param_for_index(mavlink_channel_t chan, uint16_t index)
 {
-	return mavlink_pm_send_param(param_for_index(index));
+	return mavlink_pm_send_param(chan, param_for_index(index));
 }
 
-int mavlink_pm_send_param_for_name(const char *name)
+int mavlink_pm_send_param_for_name(mavlink_channel_t chan, const char *name)
 {
-	return mavlink_pm_send_param(param_find(name));
+	return mavlink_pm_send_param(chan, param_find(name));
 }
 
-int mavlink_pm_send_param(param_t param)
+int mavlink_pm_send_param(mavlink_channel_t chan, param_t param)
 {
 	if (param == PARAM_INVALID) return 1;
 
-	/* buffers for param transmission */
-	static char name_buf[MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN];
+	/* buffers for param transmission, on the stack as links answer concurrently */
+	char name_buf[MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN];
 	float val_buf;
-	static mavlink_message_t tx_msg;
+	mavlink_message_t tx_msg;
 
 	/* query parameter type */
 	param_type_t type = param_type(param);
@@ -154,14 +399,14 @@ int mavlink_pm_send_param(param_t param)
 
 	mavlink_msg_param_value_pack_chan(mavlink_system.sysid,
 					  mavlink_system.compid,
-					  MAVLINK_COMM_0,
+					  chan,
 					  &tx_msg,
 					  name_buf,
 					  val_buf,
 					  mavlink_type,
 					  param_count(),
 					  param_get_index(param));
-	ret = mavlink_missionlib_send_message(&tx_msg);
+	ret = mavlink_missionlib_send_message(chan, &tx_msg);
 	return ret;
 }
 
@@ -170,8 +415,8 @@ void mavlink_pm_message_handler(const mavlink_channel_t chan, const mavlink_mess
 	switch (msg->msgid) {
 	case MAVLINK_MSG_ID_PARAM_REQUEST_LIST: {
 			/* Start sending parameters */
-			mavlink_pm_start_queued_send();
-			mavlink_missionlib_send_gcs_string("[mavlink pm] sending list");
+			mavlink_pm_start_queued_send(chan);
+			mavlink_missionlib_send_gcs_string(chan, "[mavlink pm] sending list");
 		} break;
 
 	case MAVLINK_MSG_ID_PARAM_SET: {
@@ -191,15 +436,28 @@ void mavlink_pm_message_handler(const mavlink_channel_t chan, const mavlink_mess
 					/* attempt to find parameter, set and send it */
 					param_t param = param_find(name);
 
-					if (param == PARAM_INVALID) {
+					if (!strcmp(name, MAVLINK_PM_HASH_CHECK)) {
+						uint32_t hash;
+						memcpy(&hash, &mavlink_param_set.param_value, sizeof(hash));
+
+						/* the GCS has the current set cached, stop the list */
+						if (hash == mavlink_pm_hash()) {
+							mavlink_param_queue_index = param_count();
+							mavlink_param_hash_pending = false;
+						}
+
+						/* like any PARAM_SET, answer with the value now held */
+						mavlink_pm_send_hash(chan);
+
+					} else if (param == PARAM_INVALID) {
 						char buf[MAVLINK_MSG_STATUSTEXT_FIELD_TEXT_LEN];
 						sprintf(buf, "[mavlink pm] unknown: %s", name);
-						mavlink_missionlib_send_gcs_string(buf);
+						mavlink_missionlib_send_gcs_string(chan, buf);
 
 					} else {
 						/* set and send parameter */
 						param_set(param, &(mavlink_param_set.param_value));
-						mavlink_pm_send_param(param);
+						mavlink_pm_send_param(chan, param);
 					}
 				}
 			}
@@ -218,11 +476,16 @@ void mavlink_pm_message_handler(const mavlink_channel_t chan, const mavlink_mess
 					/* enforce null termination */
 					name[MAVLINK_MSG_PARAM_VALUE_FIELD_PARAM_ID_LEN] = '\0';
 					/* attempt to find parameter and send it */
-					mavlink_pm_send_param_for_name(name);
+					if (!strcmp(name, MAVLINK_PM_HASH_CHECK)) {
+						mavlink_pm_send_hash(chan);
+
+					} else {
+						mavlink_pm_send_param_for_name(chan, name);
+					}
 
 				} else {
 					/* when index is >= 0, send this parameter again */
-					mavlink_pm_send_param_for_index(mavlink_param_request_read.param_index);
+					mavlink_pm_send_param_for_index(chan, mavlink_param_request_read.param_index);
 				}
 			}
 
@@ -45,8 +45,47 @@
 
 #include <v1.0/mavlink_types.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <systemlib/param/param.h>
 
+/*
+ * Parameter set hash
+ *
+ * The hash covers the names, types and values of all parameters. It is
+ * readable as the pseudo parameter _HASH_CHECK (type UINT32, index 65535)
+ * and is sent first when the list is requested; a GCS that holds a copy
+ * with the same hash writes it back with PARAM_SET to cut the list short.
+ * Either way the PARAM_SET is answered with the current hash.
+ *
+ * Bulk transfer
+ *
+ * A GCS sends DATA_TRANSMISSION_HANDSHAKE with type
+ * MAVLINK_PM_BULK_DATA_TYPE, size set to the hash of its cached copy (or 0),
+ * width to the first block and height to the number of blocks, 0 for all.
+ * For a full request the answer is a handshake with size the current hash,
+ * width the number of parameters covered and packets the number of blocks;
+ * packets 0 means the cached copy is current. The blocks follow as
+ * ENCAPSULATED_DATA with seqnr MAVLINK_PM_BULK_SEQ_FLAG | block, paced
+ * like the PARAM_VALUE stream. Missing blocks are requested again by
+ * number.
+ *
+ * A block holds consecutive parameters, each packed as
+ * uint16 index, uint8 MAVLink type, uint8 name length, 4 value bytes and
+ * the name without terminator; a zero type ends the block.
+ */
+
+/** name of the pseudo parameter carrying the parameter set hash */
+#define MAVLINK_PM_HASH_CHECK		"_HASH_CHECK"
+
+/** handshake type of the bulk parameter transfer */
+#define MAVLINK_PM_BULK_DATA_TYPE	17
+
+/** seqnr bit marking parameter blocks */
+#define MAVLINK_PM_BULK_SEQ_FLAG	0x8000
+
+/** most blocks in one transfer */
+#define MAVLINK_PM_BULK_MAX_BLOCKS	64
+
 /**
  * Handle parameter related messages.
  */
@@ -58,41 +97,70 @@ void mavlink_pm_message_handler(const mavlink_channel_t chan, const mavlink_mess
  * This function blocks until all parameters have been sent.
  * it delays each parameter by the passed amount of microseconds.
  *
+ * @param chan		The link to send on.
  * @param delay		The delay in us between sending all parameters.
  */
-void mavlink_pm_send_all_params(unsigned int delay);
+void mavlink_pm_send_all_params(mavlink_channel_t chan, unsigned int delay);
 
 /**
  * Send one parameter.
  *
+ * @param chan		The link to send on.
  * @param param		The parameter id to send.
  * @return		zero on success, nonzero on failure.
  */
-int mavlink_pm_send_param(param_t param);
+int mavlink_pm_send_param(mavlink_channel_t chan, param_t param);
 
 /**
  * Send one parameter identified by index.
  *
+ * @param chan		The link to send on.
  * @param index		The index of the parameter to send.
  * @return		zero on success, nonzero else.
  */
-int mavlink_pm_send_param_for_index(uint16_t index);
+int mavlink_pm_send_param_for_index(mavlink_channel_t chan, uint16_t index);
 
 /**
  * Send one parameter identified by name.
  *
+ * @param chan		The link to send on.
  * @param name		The index of the parameter to send.
  * @return		zero on success, nonzero else.
  */
-int mavlink_pm_send_param_for_name(const char *name);
+int mavlink_pm_send_param_for_name(mavlink_channel_t chan, const char *name);
+
+/**
+ * Hash over the names, types and values of all parameters.
+ */
+uint32_t mavlink_pm_hash(void);
+
+/**
+ * Handle a bulk transfer request.
+ *
+ * Answers a full request at once and queues the blocks to be sent by
+ * mavlink_pm_queued_send().
+ *
+ * @param chan		The link the request came in on; the blocks go out on it.
+ * @param cached_hash	Hash of the copy the GCS holds, 0 if none.
+ * @param first		First block for a resend.
+ * @param count		Number of blocks for a resend, 0 for the full set.
+ */
+void mavlink_pm_bulk_request(mavlink_channel_t chan, uint32_t cached_hash, uint16_t first, uint16_t count);
 
 /**
- * Send a queue of parameters, one parameter per function call.
+ * Send a queue of parameters, one parameter or block per function call.
+ *
+ * The queue goes out on the link that last started it.
  *
  * @return		zero on success, nonzero on failure
  */
 int mavlink_pm_queued_send(void);
 
+/**
+ * The link the parameter queue goes out on.
+ */
+mavlink_channel_t mavlink_pm_queued_channel(void);
+
 /**
  * Start sending the parameter queue.
  *
@@ -100,5 +168,7 @@ int mavlink_pm_queued_send(void);
  * activate the sending of one parameter on each call of
  * mavlink_pm_queued_send().
  * @see 		mavlink_pm_queued_send()
+ *
+ * @param chan		The link to send the queue on.
  */
-void mavlink_pm_start_queued_send(void);
+void mavlink_pm_start_queued_send(mavlink_channel_t chan);
@@ -64,6 +64,7 @@
 
 #include <systemlib/param/param.h>
 #include <systemlib/systemlib.h>
+#include <systemlib/perf_counter.h>
 
 #include "waypoints.h"
 #include "mavlink_log.h"
@@ -71,15 +72,45 @@
 #include "missionlib.h"
 #include "mavlink_hil.h"
 #include "mavlink_parameters.h"
+#include "mavlink_streams.h"
+#include "mavlink_logstream.h"
 #include "util.h"
 
 /* XXX should be in a header somewhere */
-pthread_t receive_start(int uart);
+pthread_t receive_start(mavlink_channel_t channel);
+
+/**
+ * Receive buffer size.
+ *
+ * Large enough to always hold the unparsed tail of the previous read
+ * (at most one partial frame) plus another full frame, so a single
+ * read() can be placed directly behind the leftover bytes.
+ */
+#define MAVLINK_RX_BUFFER_SIZE	(2 * MAVLINK_MAX_PACKET_LEN)
+
+/** message handler table flag: only dispatch while HIL is enabled */
+#define MAVLINK_RX_HIL_ONLY	(1 << 0)
+
+struct mavlink_rx_handler {
+	uint8_t		msgid;
+	uint8_t		flags;
+	void		(*handler)(mavlink_channel_t chan, const mavlink_message_t *msg);
+};
+
+/** per-link receiver state */
+struct mavlink_receiver {
+	mavlink_channel_t	channel;
+	unsigned		len;
+	uint8_t			buf[MAVLINK_RX_BUFFER_SIZE];
+	mavlink_status_t	status;
+	mavlink_message_t	msg;
+};
 
-static void handle_message(mavlink_message_t *msg);
 static void *receive_thread(void *arg);
+static unsigned receive_parse(struct mavlink_receiver *r);
+static void receive_forward(struct mavlink_receiver *r, const uint8_t *frame, unsigned len);
+static void receive_dispatch(struct mavlink_receiver *r);
 
-static mavlink_status_t status;
 static struct vehicle_vicon_position_s vicon_position;
 static struct vehicle_command_s vcmd;
 static struct offboard_control_setpoint_s offboard_control_sp;
@@ -99,558 +130,775 @@ static orb_advert_t flow_pub = -1;
 static orb_advert_t offboard_control_sp_pub = -1;
 static orb_advert_t vicon_position_pub = -1;
 
+static struct mavlink_receiver receivers[MAVLINK_LINKS_MAX];
+static uint8_t rx_msg_lengths[256] = MAVLINK_MESSAGE_LENGTHS;
+static uint8_t rx_msg_crcs[256] = MAVLINK_MESSAGE_CRCS;
+
+/** handler table index by message ID, 0 means no handler */
+static uint8_t rx_handler_index[256];
+
+static perf_counter_t rx_parse_perf;
+static perf_counter_t rx_error_perf;
+
+/* TODO, set ground_press/ temp during calib */
+static const float hil_ground_press = 1013.25f; // mbar
+static const float hil_ground_tempC = 21.0f;
+static const float hil_ground_alt = 0.0f;
+static const float hil_T0 = 273.15;
+static const float hil_R = 287.05f;
+static const float hil_g = 9.806f;
+
 extern bool gcs_link;
 
 static void
-handle_message(mavlink_message_t *msg)
+handle_message_command_long(mavlink_channel_t chan, const mavlink_message_t *msg)
 {
-	if (msg->msgid == MAVLINK_MSG_ID_COMMAND_LONG) {
-
-		mavlink_command_long_t cmd_mavlink;
-		mavlink_msg_command_long_decode(msg, &cmd_mavlink);
-
-		if (cmd_mavlink.target_system == mavlink_system.sysid && ((cmd_mavlink.target_component == mavlink_system.compid)
-				|| (cmd_mavlink.target_component == MAV_COMP_ID_ALL))) {
-			//check for MAVLINK terminate command
-			if (cmd_mavlink.command == MAV_CMD_PREFLIGHT_REBOOT_SHUTDOWN && ((int)cmd_mavlink.param1) == 3) {
-				/* This is the link shutdown command, terminate mavlink */
-				printf("[mavlink] Terminating .. \n");
-				fflush(stdout);
-				usleep(50000);
-
-				/* terminate other threads and this thread */
-				thread_should_exit = true;
-
-			} else {
-
-				/* Copy the content of mavlink_command_long_t cmd_mavlink into command_t cmd */
-				vcmd.param1 = cmd_mavlink.param1;
-				vcmd.param2 = cmd_mavlink.param2;
-				vcmd.param3 = cmd_mavlink.param3;
-				vcmd.param4 = cmd_mavlink.param4;
-				vcmd.param5 = cmd_mavlink.param5;
-				vcmd.param6 = cmd_mavlink.param6;
-				vcmd.param7 = cmd_mavlink.param7;
-				vcmd.command = cmd_mavlink.command;
-				vcmd.target_system = cmd_mavlink.target_system;
-				vcmd.target_component = cmd_mavlink.target_component;
-				vcmd.source_system = msg->sysid;
-				vcmd.source_component = msg->compid;
-				vcmd.confirmation =  cmd_mavlink.confirmation;
-
-				/* check if topic is advertised */
-				if (cmd_pub <= 0) {
-					cmd_pub = orb_advertise(ORB_ID(vehicle_command), &vcmd);
-				}
-
-				/* publish */
-				orb_publish(ORB_ID(vehicle_command), cmd_pub, &vcmd);
+	mavlink_command_long_t cmd_mavlink;
+	mavlink_msg_command_long_decode(msg, &cmd_mavlink);
+
+	if (cmd_mavlink.target_system == mavlink_system.sysid && ((cmd_mavlink.target_component == mavlink_system.compid)
+			|| (cmd_mavlink.target_component == MAV_COMP_ID_ALL))) {
+		//check for MAVLINK terminate command
+		if (cmd_mavlink.command == MAV_CMD_PREFLIGHT_REBOOT_SHUTDOWN && ((int)cmd_mavlink.param1) == 3) {
+			/* This is the link shutdown command, terminate mavlink */
+			printf("[mavlink] Terminating .. \n");
+			fflush(stdout);
+			usleep(50000);
+
+			/* terminate other threads and this thread */
+			thread_should_exit = true;
+
+		} else {
+
+			/* Copy the content of mavlink_command_long_t cmd_mavlink into command_t cmd */
+			vcmd.param1 = cmd_mavlink.param1;
+			vcmd.param2 = cmd_mavlink.param2;
+			vcmd.param3 = cmd_mavlink.param3;
+			vcmd.param4 = cmd_mavlink.param4;
+			vcmd.param5 = cmd_mavlink.param5;
+			vcmd.param6 = cmd_mavlink.param6;
+			vcmd.param7 = cmd_mavlink.param7;
+			vcmd.command = cmd_mavlink.command;
+			vcmd.target_system = cmd_mavlink.target_system;
+			vcmd.target_component = cmd_mavlink.target_component;
+			vcmd.source_system = msg->sysid;
+			vcmd.source_component = msg->compid;
+			vcmd.confirmation =  cmd_mavlink.confirmation;
+
+			/* check if topic is advertised */
+			if (cmd_pub <= 0) {
+				cmd_pub = orb_advertise(ORB_ID(vehicle_command), &vcmd);
 			}
+
+			/* publish */
+			orb_publish(ORB_ID(vehicle_command), cmd_pub, &vcmd);
 		}
 	}
+}
 
-	if (msg->msgid == MAVLINK_MSG_ID_OPTICAL_FLOW) {
-		mavlink_optical_flow_t flow;
-		mavlink_msg_optical_flow_decode(msg, &flow);
+static void
+handle_message_optical_flow(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	mavlink_optical_flow_t flow;
+	mavlink_msg_optical_flow_decode(msg, &flow);
+
+	struct optical_flow_s f;
+
+	f.timestamp = flow.time_usec;
+	f.flow_raw_x = flow.flow_x;
+	f.flow_raw_y = flow.flow_y;
+	f.flow_comp_x_m = flow.flow_comp_m_x;
+	f.flow_comp_y_m = flow.flow_comp_m_y;
+	f.ground_distance_m = flow.ground_distance;
+	f.quality = flow.quality;
+	f.sensor_id = flow.sensor_id;
+
+	/* check if topic is advertised */
+	if (flow_pub <= 0) {
+		flow_pub = orb_advertise(ORB_ID(optical_flow), &f);
+
+	} else {
+		/* publish */
+		orb_publish(ORB_ID(optical_flow), flow_pub, &f);
+	}
+}
+
+static void
+handle_message_set_mode(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	/* Set mode on request */
+	mavlink_set_mode_t new_mode;
+	mavlink_msg_set_mode_decode(msg, &new_mode);
+
+	/* Copy the content of mavlink_command_long_t cmd_mavlink into command_t cmd */
+	vcmd.param1 = new_mode.base_mode;
+	vcmd.param2 = new_mode.custom_mode;
+	vcmd.param3 = 0;
+	vcmd.param4 = 0;
+	vcmd.param5 = 0;
+	vcmd.param6 = 0;
+	vcmd.param7 = 0;
+	vcmd.command = MAV_CMD_DO_SET_MODE;
+	vcmd.target_system = new_mode.target_system;
+	vcmd.target_component = MAV_COMP_ID_ALL;
+	vcmd.source_system = msg->sysid;
+	vcmd.source_component = msg->compid;
+	vcmd.confirmation = 1;
+
+	/* check if topic is advertised */
+	if (cmd_pub <= 0) {
+		cmd_pub = orb_advertise(ORB_ID(vehicle_command), &vcmd);
+
+	} else {
+		/* create command */
+		orb_publish(ORB_ID(vehicle_command), cmd_pub, &vcmd);
+	}
+}
+
+/**
+ * Handle Vicon position estimates.
+ */
+static void
+handle_message_vicon_position_estimate(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	mavlink_vicon_position_estimate_t pos;
+	mavlink_msg_vicon_position_estimate_decode(msg, &pos);
 
-		struct optical_flow_s f;
+	vicon_position.timestamp = hrt_absolute_time();
 
-		f.timestamp = flow.time_usec;
-		f.flow_raw_x = flow.flow_x;
-		f.flow_raw_y = flow.flow_y;
-		f.flow_comp_x_m = flow.flow_comp_m_x;
-		f.flow_comp_y_m = flow.flow_comp_m_y;
-		f.ground_distance_m = flow.ground_distance;
-		f.quality = flow.quality;
-		f.sensor_id = flow.sensor_id;
+	vicon_position.x = pos.x;
+	vicon_position.y = pos.y;
+	vicon_position.z = pos.z;
 
-		/* check if topic is advertised */
-		if (flow_pub <= 0) {
-			flow_pub = orb_advertise(ORB_ID(optical_flow), &f);
+	vicon_position.roll = pos.roll;
+	vicon_position.pitch = pos.pitch;
+	vicon_position.yaw = pos.yaw;
 
-		} else {
-			/* publish */
-			orb_publish(ORB_ID(optical_flow), flow_pub, &f);
-		}
+	if (vicon_position_pub <= 0) {
+		vicon_position_pub = orb_advertise(ORB_ID(vehicle_vicon_position), &vicon_position);
+
+	} else {
+		orb_publish(ORB_ID(vehicle_vicon_position), vicon_position_pub, &vicon_position);
 	}
+}
 
-	if (msg->msgid == MAVLINK_MSG_ID_SET_MODE) {
-		/* Set mode on request */
-		mavlink_set_mode_t new_mode;
-		mavlink_msg_set_mode_decode(msg, &new_mode);
-
-		/* Copy the content of mavlink_command_long_t cmd_mavlink into command_t cmd */
-		vcmd.param1 = new_mode.base_mode;
-		vcmd.param2 = new_mode.custom_mode;
-		vcmd.param3 = 0;
-		vcmd.param4 = 0;
-		vcmd.param5 = 0;
-		vcmd.param6 = 0;
-		vcmd.param7 = 0;
-		vcmd.command = MAV_CMD_DO_SET_MODE;
-		vcmd.target_system = new_mode.target_system;
-		vcmd.target_component = MAV_COMP_ID_ALL;
-		vcmd.source_system = msg->sysid;
-		vcmd.source_component = msg->compid;
-		vcmd.confirmation = 1;
-
-		/* check if topic is advertised */
-		if (cmd_pub <= 0) {
-			cmd_pub = orb_advertise(ORB_ID(vehicle_command), &vcmd);
+/**
+ * Handle quadrotor motor setpoints.
+ */
+static void
+handle_message_set_quad_swarm_roll_pitch_yaw_thrust(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	mavlink_set_quad_swarm_roll_pitch_yaw_thrust_t quad_motors_setpoint;
+	mavlink_msg_set_quad_swarm_roll_pitch_yaw_thrust_decode(msg, &quad_motors_setpoint);
 
-		} else {
-			/* create command */
-			orb_publish(ORB_ID(vehicle_command), cmd_pub, &vcmd);
+	if (mavlink_system.sysid < 4) {
+
+		/* switch to a receiving link mode */
+		gcs_link = false;
+
+		/*
+		 * rate control mode - defined by MAVLink
+		 */
+
+		uint8_t ml_mode = 0;
+		bool ml_armed = false;
+
+		switch (quad_motors_setpoint.mode) {
+		case 0:
+			ml_armed = false;
+			break;
+
+		case 1:
+			ml_mode = OFFBOARD_CONTROL_MODE_DIRECT_RATES;
+			ml_armed = true;
+
+			break;
+
+		case 2:
+			ml_mode = OFFBOARD_CONTROL_MODE_DIRECT_ATTITUDE;
+			ml_armed = true;
+
+			break;
+
+		case 3:
+			ml_mode = OFFBOARD_CONTROL_MODE_DIRECT_VELOCITY;
+			break;
+
+		case 4:
+			ml_mode = OFFBOARD_CONTROL_MODE_DIRECT_POSITION;
+			break;
 		}
-	}
 
-	/* Handle Vicon position estimates */
-	if (msg->msgid == MAVLINK_MSG_ID_VICON_POSITION_ESTIMATE) {
-		mavlink_vicon_position_estimate_t pos;
-		mavlink_msg_vicon_position_estimate_decode(msg, &pos);
+		offboard_control_sp.p1 = (float)quad_motors_setpoint.roll[mavlink_system.sysid - 1]   / (float)INT16_MAX;
+		offboard_control_sp.p2 = (float)quad_motors_setpoint.pitch[mavlink_system.sysid - 1]  / (float)INT16_MAX;
+		offboard_control_sp.p3 = (float)quad_motors_setpoint.yaw[mavlink_system.sysid - 1]    / (float)INT16_MAX;
+		offboard_control_sp.p4 = (float)quad_motors_setpoint.thrust[mavlink_system.sysid - 1] / (float)UINT16_MAX;
 
-		vicon_position.timestamp = hrt_absolute_time();
+		if (quad_motors_setpoint.thrust[mavlink_system.sysid - 1] == 0) {
+			ml_armed = false;
+		}
 
-		vicon_position.x = pos.x;
-		vicon_position.y = pos.y;
-		vicon_position.z = pos.z;
+		offboard_control_sp.armed = ml_armed;
+		offboard_control_sp.mode = ml_mode;
 
-		vicon_position.roll = pos.roll;
-		vicon_position.pitch = pos.pitch;
-		vicon_position.yaw = pos.yaw;
+		offboard_control_sp.timestamp = hrt_absolute_time();
 
-		if (vicon_position_pub <= 0) {
-			vicon_position_pub = orb_advertise(ORB_ID(vehicle_vicon_position), &vicon_position);
+		/* check if topic has to be advertised */
+		if (offboard_control_sp_pub <= 0) {
+			offboard_control_sp_pub = orb_advertise(ORB_ID(offboard_control_setpoint), &offboard_control_sp);
 
 		} else {
-			orb_publish(ORB_ID(vehicle_vicon_position), vicon_position_pub, &vicon_position);
+			/* Publish */
+			orb_publish(ORB_ID(offboard_control_setpoint), offboard_control_sp_pub, &offboard_control_sp);
 		}
 	}
+}
 
-	/* Handle quadrotor motor setpoints */
-
-	if (msg->msgid == MAVLINK_MSG_ID_SET_QUAD_SWARM_ROLL_PITCH_YAW_THRUST) {
-		mavlink_set_quad_swarm_roll_pitch_yaw_thrust_t quad_motors_setpoint;
-		mavlink_msg_set_quad_swarm_roll_pitch_yaw_thrust_decode(msg, &quad_motors_setpoint);
+static void
+handle_message_hil_raw_imu(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	uint64_t timestamp = hrt_absolute_time();
+	mavlink_raw_imu_t imu;
+	mavlink_msg_raw_imu_decode(msg, &imu);
+
+	/* packet counter */
+	static uint16_t hil_counter = 0;
+	static uint16_t hil_frames = 0;
+	static uint64_t old_timestamp = 0;
+
+	/* sensors general */
+	hil_sensors.timestamp = imu.time_usec;
+
+	/* hil gyro */
+	static const float mrad2rad = 1.0e-3f;
+	hil_sensors.gyro_counter = hil_counter;
+	hil_sensors.gyro_raw[0] = imu.xgyro;
+	hil_sensors.gyro_raw[1] = imu.ygyro;
+	hil_sensors.gyro_raw[2] = imu.zgyro;
+	hil_sensors.gyro_rad_s[0] = imu.xgyro * mrad2rad;
+	hil_sensors.gyro_rad_s[1] = imu.ygyro * mrad2rad;
+	hil_sensors.gyro_rad_s[2] = imu.zgyro * mrad2rad;
+
+	/* accelerometer */
+	hil_sensors.accelerometer_counter = hil_counter;
+	static const float mg2ms2 = 9.8f / 1000.0f;
+	hil_sensors.accelerometer_raw[0] = imu.xacc;
+	hil_sensors.accelerometer_raw[1] = imu.yacc;
+	hil_sensors.accelerometer_raw[2] = imu.zacc;
+	hil_sensors.accelerometer_m_s2[0] = mg2ms2 * imu.xacc;
+	hil_sensors.accelerometer_m_s2[1] = mg2ms2 * imu.yacc;
+	hil_sensors.accelerometer_m_s2[2] = mg2ms2 * imu.zacc;
+	hil_sensors.accelerometer_mode = 0; // TODO what is this?
+	hil_sensors.accelerometer_range_m_s2 = 32.7f; // int16
+
+	/* adc */
+	hil_sensors.adc_voltage_v[0] = 0;
+	hil_sensors.adc_voltage_v[1] = 0;
+	hil_sensors.adc_voltage_v[2] = 0;
+
+	/* magnetometer */
+	float mga2ga = 1.0e-3f;
+	hil_sensors.magnetometer_counter = hil_counter;
+	hil_sensors.magnetometer_raw[0] = imu.xmag;
+	hil_sensors.magnetometer_raw[1] = imu.ymag;
+	hil_sensors.magnetometer_raw[2] = imu.zmag;
+	hil_sensors.magnetometer_ga[0] = imu.xmag * mga2ga;
+	hil_sensors.magnetometer_ga[1] = imu.ymag * mga2ga;
+	hil_sensors.magnetometer_ga[2] = imu.zmag * mga2ga;
+	hil_sensors.magnetometer_range_ga = 32.7f; // int16
+	hil_sensors.magnetometer_mode = 0; // TODO what is this
+	hil_sensors.magnetometer_cuttoff_freq_hz = 50.0f;
+
+	/* publish */
+	orb_publish(ORB_ID(sensor_combined), pub_hil_sensors, &hil_sensors);
+
+	// increment counters
+	hil_counter += 1 ;
+	hil_frames += 1 ;
+
+	// output
+	if ((timestamp - old_timestamp) > 10000000) {
+		printf("receiving hil imu at %d hz\n", hil_frames/10);
+		old_timestamp = timestamp;
+		hil_frames = 0;
+	}
+}
 
-		if (mavlink_system.sysid < 4) {
+static void
+handle_message_hil_highres_imu(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	uint64_t timestamp = hrt_absolute_time();
+
+	mavlink_highres_imu_t imu;
+	mavlink_msg_highres_imu_decode(msg, &imu);
+
+	/* packet counter */
+	static uint16_t hil_counter = 0;
+	static uint16_t hil_frames = 0;
+	static uint64_t old_timestamp = 0;
+
+	/* sensors general */
+	hil_sensors.timestamp = hrt_absolute_time();
+
+	/* hil gyro */
+	static const float mrad2rad = 1.0e-3f;
+	hil_sensors.gyro_counter = hil_counter;
+	hil_sensors.gyro_raw[0] = imu.xgyro / mrad2rad;
+	hil_sensors.gyro_raw[1] = imu.ygyro / mrad2rad;
+	hil_sensors.gyro_raw[2] = imu.zgyro / mrad2rad;
+	hil_sensors.gyro_rad_s[0] = imu.xgyro;
+	hil_sensors.gyro_rad_s[1] = imu.ygyro;
+	hil_sensors.gyro_rad_s[2] = imu.zgyro;
+
+	/* accelerometer */
+	hil_sensors.accelerometer_counter = hil_counter;
+	static const float mg2ms2 = 9.8f / 1000.0f;
+	hil_sensors.accelerometer_raw[0] = imu.xacc / mg2ms2;
+	hil_sensors.accelerometer_raw[1] = imu.yacc / mg2ms2;
+	hil_sensors.accelerometer_raw[2] = imu.zacc / mg2ms2;
+	hil_sensors.accelerometer_m_s2[0] = imu.xacc;
+	hil_sensors.accelerometer_m_s2[1] = imu.yacc;
+	hil_sensors.accelerometer_m_s2[2] = imu.zacc;
+	hil_sensors.accelerometer_mode = 0; // TODO what is this?
+	hil_sensors.accelerometer_range_m_s2 = 32.7f; // int16
+
+	/* adc */
+	hil_sensors.adc_voltage_v[0] = 0;
+	hil_sensors.adc_voltage_v[1] = 0;
+	hil_sensors.adc_voltage_v[2] = 0;
+
+	/* magnetometer */
+	float mga2ga = 1.0e-3f;
+	hil_sensors.magnetometer_counter = hil_counter;
+	hil_sensors.magnetometer_raw[0] = imu.xmag / mga2ga;
+	hil_sensors.magnetometer_raw[1] = imu.ymag / mga2ga;
+	hil_sensors.magnetometer_raw[2] = imu.zmag / mga2ga;
+	hil_sensors.magnetometer_ga[0] = imu.xmag;
+	hil_sensors.magnetometer_ga[1] = imu.ymag;
+	hil_sensors.magnetometer_ga[2] = imu.zmag;
+	hil_sensors.magnetometer_range_ga = 32.7f; // int16
+	hil_sensors.magnetometer_mode = 0; // TODO what is this
+	hil_sensors.magnetometer_cuttoff_freq_hz = 50.0f;
+
+	hil_sensors.baro_pres_mbar = imu.abs_pressure;
+
+	float tempC =  imu.temperature;
+	float tempAvgK = hil_T0 + (tempC + hil_ground_tempC) / 2.0f;
+	float h =  hil_ground_alt + (hil_R / hil_g) * tempAvgK * logf(hil_ground_press / imu.abs_pressure);
+
+	hil_sensors.baro_alt_meter = h;
+	hil_sensors.baro_temp_celcius = imu.temperature;
+
+	hil_sensors.gyro_counter = hil_counter;
+	hil_sensors.magnetometer_counter = hil_counter;
+	hil_sensors.accelerometer_counter = hil_counter;
+
+	/* publish */
+	orb_publish(ORB_ID(sensor_combined), pub_hil_sensors, &hil_sensors);
+
+	// increment counters
+	hil_counter++;
+	hil_frames++;
+
+	// output
+	if ((timestamp - old_timestamp) > 10000000) {
+		printf("receiving hil imu at %d hz\n", hil_frames/10);
+		old_timestamp = timestamp;
+		hil_frames = 0;
+	}
+}
 
-			/* switch to a receiving link mode */
-			gcs_link = false;
+static void
+handle_message_hil_gps_raw_int(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	uint64_t timestamp = hrt_absolute_time();
+	mavlink_gps_raw_int_t gps;
+	mavlink_msg_gps_raw_int_decode(msg, &gps);
+
+	/* packet counter */
+	static uint16_t hil_counter = 0;
+	static uint16_t hil_frames = 0;
+	static uint64_t old_timestamp = 0;
+
+	/* gps */
+	hil_gps.timestamp_position = gps.time_usec;
+//	hil_gps.counter = hil_counter++;
+	hil_gps.time_gps_usec = gps.time_usec;
+	hil_gps.lat = gps.lat;
+	hil_gps.lon = gps.lon;
+	hil_gps.alt = gps.alt;
+//	hil_gps.counter_pos_valid = hil_counter++;
+	hil_gps.eph_m = (float)gps.eph * 1e-2f; // from cm to m
+	hil_gps.epv_m = (float)gps.epv * 1e-2f; // from cm to m
+	hil_gps.s_variance_m_s = 5.0f;
+	hil_gps.p_variance_m = hil_gps.eph_m * hil_gps.eph_m;
+	hil_gps.vel_m_s = (float)gps.vel * 1e-2f; // from cm/s to m/s
+
+	/* gps.cog is in degrees 0..360 * 100, heading is -PI..PI */
+	float heading_rad = gps.cog * M_DEG_TO_RAD_F * 1e-2f - M_PI_F;
+	hil_gps.vel_n_m_s = (float)gps.vel * 1e-2f * cosf(heading_rad);
+	hil_gps.vel_e_m_s = (float)gps.vel * 1e-2f * sinf(heading_rad);
+	hil_gps.vel_d_m_s = 0.0f;
+	/* COG (course over ground) is speced as 0..360 degrees (compass) */
+	hil_gps.cog_rad = heading_rad + M_PI_F; // from deg*100 to rad
+	hil_gps.fix_type = gps.fix_type;
+	hil_gps.satellites_visible = gps.satellites_visible;
+
+	/* publish */
+	orb_publish(ORB_ID(vehicle_gps_position), pub_hil_gps, &hil_gps);
+
+	// increment counters
+	hil_counter += 1 ;
+	hil_frames += 1 ;
+
+	// output
+	if ((timestamp - old_timestamp) > 10000000) {
+		printf("receiving hil gps at %d hz\n", hil_frames/10);
+		old_timestamp = timestamp;
+		hil_frames = 0;
+	}
+}
 
-			/*
-			 * rate control mode - defined by MAVLink
-			 */
+static void
+handle_message_hil_raw_pressure(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	uint64_t timestamp = hrt_absolute_time();
 
-			uint8_t ml_mode = 0;
-			bool ml_armed = false;
+	mavlink_raw_pressure_t press;
+	mavlink_msg_raw_pressure_decode(msg, &press);
 
-			switch (quad_motors_setpoint.mode) {
-			case 0:
-				ml_armed = false;
-				break;
+	/* packet counter */
+	static uint16_t hil_counter = 0;
+	static uint16_t hil_frames = 0;
+	static uint64_t old_timestamp = 0;
 
-			case 1:
-				ml_mode = OFFBOARD_CONTROL_MODE_DIRECT_RATES;
-				ml_armed = true;
+	/* sensors general */
+	hil_sensors.timestamp = press.time_usec;
 
-				break;
+	/* baro */
 
-			case 2:
-				ml_mode = OFFBOARD_CONTROL_MODE_DIRECT_ATTITUDE;
-				ml_armed = true;
+	float tempC =  press.temperature / 100.0f;
+	float tempAvgK = hil_T0 + (tempC + hil_ground_tempC) / 2.0f;
+	float h =  hil_ground_alt + (hil_R / hil_g) * tempAvgK * logf(hil_ground_press / press.press_abs);
+	hil_sensors.baro_counter = hil_counter;
+	hil_sensors.baro_pres_mbar = press.press_abs;
+	hil_sensors.baro_alt_meter = h;
+	hil_sensors.baro_temp_celcius = tempC;
 
-				break;
+	/* publish */
+	orb_publish(ORB_ID(sensor_combined), pub_hil_sensors, &hil_sensors);
 
-			case 3:
-				ml_mode = OFFBOARD_CONTROL_MODE_DIRECT_VELOCITY;
-				break;
+	// increment counters
+	hil_counter += 1 ;
+	hil_frames += 1 ;
 
-			case 4:
-				ml_mode = OFFBOARD_CONTROL_MODE_DIRECT_POSITION;
-				break;
-			}
+	// output
+	if ((timestamp - old_timestamp) > 10000000) {
+		printf("receiving hil pressure at %d hz\n", hil_frames/10);
+		old_timestamp = timestamp;
+		hil_frames = 0;
+	}
+}
 
-			offboard_control_sp.p1 = (float)quad_motors_setpoint.roll[mavlink_system.sysid - 1]   / (float)INT16_MAX;
-			offboard_control_sp.p2 = (float)quad_motors_setpoint.pitch[mavlink_system.sysid - 1]  / (float)INT16_MAX;
-			offboard_control_sp.p3 = (float)quad_motors_setpoint.yaw[mavlink_system.sysid - 1]    / (float)INT16_MAX;
-			offboard_control_sp.p4 = (float)quad_motors_setpoint.thrust[mavlink_system.sysid - 1] / (float)UINT16_MAX;
+static void
+handle_message_hil_state(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	mavlink_hil_state_t hil_state;
+	mavlink_msg_hil_state_decode(msg, &hil_state);
 
-			if (quad_motors_setpoint.thrust[mavlink_system.sysid - 1] == 0) {
-				ml_armed = false;
-			}
+	/* Calculate Rotation Matrix */
+	//TODO: better clarification which app does this, atm we have a ekf for quadrotors which does this, but there is no such thing if fly in fixed wing mode
 
-			offboard_control_sp.armed = ml_armed;
-			offboard_control_sp.mode = ml_mode;
+	if (mavlink_system.type == MAV_TYPE_FIXED_WING) {
+		//TODO: assuming low pitch and roll values for now
+		hil_attitude.R[0][0] = cosf(hil_state.yaw);
+		hil_attitude.R[0][1] = sinf(hil_state.yaw);
+		hil_attitude.R[0][2] = 0.0f;
 
-			offboard_control_sp.timestamp = hrt_absolute_time();
+		hil_attitude.R[1][0] = -sinf(hil_state.yaw);
+		hil_attitude.R[1][1] = cosf(hil_state.yaw);
+		hil_attitude.R[1][2] = 0.0f;
 
-			/* check if topic has to be advertised */
-			if (offboard_control_sp_pub <= 0) {
-				offboard_control_sp_pub = orb_advertise(ORB_ID(offboard_control_setpoint), &offboard_control_sp);
+		hil_attitude.R[2][0] = 0.0f;
+		hil_attitude.R[2][1] = 0.0f;
+		hil_attitude.R[2][2] = 1.0f;
 
-			} else {
-				/* Publish */
-				orb_publish(ORB_ID(offboard_control_setpoint), offboard_control_sp_pub, &offboard_control_sp);
-			}
-		}
+		hil_attitude.R_valid = true;
 	}
 
-	/*
-	 * Only decode hil messages in HIL mode.
-	 *
-	 * The HIL mode is enabled by the HIL bit flag
-	 * in the system mode. Either send a set mode
-	 * COMMAND_LONG message or a SET_MODE message
-	 */
-
-	if (mavlink_hil_enabled) {
-
-		uint64_t timestamp = hrt_absolute_time();
-
-		/* TODO, set ground_press/ temp during calib */
-		static const float ground_press = 1013.25f; // mbar
-		static const float ground_tempC = 21.0f;
-		static const float ground_alt = 0.0f;
-		static const float T0 = 273.15;
-		static const float R = 287.05f;
-		static const float g = 9.806f;
-
-		if (msg->msgid == MAVLINK_MSG_ID_RAW_IMU) {
-
-			mavlink_raw_imu_t imu;
-			mavlink_msg_raw_imu_decode(msg, &imu);
-
-			/* packet counter */
-			static uint16_t hil_counter = 0;
-			static uint16_t hil_frames = 0;
-			static uint64_t old_timestamp = 0;
-
-			/* sensors general */
-			hil_sensors.timestamp = imu.time_usec;
-
-			/* hil gyro */
-			static const float mrad2rad = 1.0e-3f;
-			hil_sensors.gyro_counter = hil_counter;
-			hil_sensors.gyro_raw[0] = imu.xgyro;
-			hil_sensors.gyro_raw[1] = imu.ygyro;
-			hil_sensors.gyro_raw[2] = imu.zgyro;
-			hil_sensors.gyro_rad_s[0] = imu.xgyro * mrad2rad;
-			hil_sensors.gyro_rad_s[1] = imu.ygyro * mrad2rad;
-			hil_sensors.gyro_rad_s[2] = imu.zgyro * mrad2rad;
-
-			/* accelerometer */
-			hil_sensors.accelerometer_counter = hil_counter;
-			static const float mg2ms2 = 9.8f / 1000.0f;
-			hil_sensors.accelerometer_raw[0] = imu.xacc;
-			hil_sensors.accelerometer_raw[1] = imu.yacc;
-			hil_sensors.accelerometer_raw[2] = imu.zacc;
-			hil_sensors.accelerometer_m_s2[0] = mg2ms2 * imu.xacc;
-			hil_sensors.accelerometer_m_s2[1] = mg2ms2 * imu.yacc;
-			hil_sensors.accelerometer_m_s2[2] = mg2ms2 * imu.zacc;
-			hil_sensors.accelerometer_mode = 0; // TODO what is this?
-			hil_sensors.accelerometer_range_m_s2 = 32.7f; // int16
-
-			/* adc */
-			hil_sensors.adc_voltage_v[0] = 0;
-			hil_sensors.adc_voltage_v[1] = 0;
-			hil_sensors.adc_voltage_v[2] = 0;
-
-			/* magnetometer */
-			float mga2ga = 1.0e-3f;
-			hil_sensors.magnetometer_counter = hil_counter;
-			hil_sensors.magnetometer_raw[0] = imu.xmag;
-			hil_sensors.magnetometer_raw[1] = imu.ymag;
-			hil_sensors.magnetometer_raw[2] = imu.zmag;
-			hil_sensors.magnetometer_ga[0] = imu.xmag * mga2ga;
-			hil_sensors.magnetometer_ga[1] = imu.ymag * mga2ga;
-			hil_sensors.magnetometer_ga[2] = imu.zmag * mga2ga;
-			hil_sensors.magnetometer_range_ga = 32.7f; // int16
-			hil_sensors.magnetometer_mode = 0; // TODO what is this
-			hil_sensors.magnetometer_cuttoff_freq_hz = 50.0f;
+	hil_global_pos.lat = hil_state.lat;
+	hil_global_pos.lon = hil_state.lon;
+	hil_global_pos.alt = hil_state.alt / 1000.0f;
+	hil_global_pos.vx = hil_state.vx / 100.0f;
+	hil_global_pos.vy = hil_state.vy / 100.0f;
+	hil_global_pos.vz = hil_state.vz / 100.0f;
 
-			/* publish */
-			orb_publish(ORB_ID(sensor_combined), pub_hil_sensors, &hil_sensors);
 
-			// increment counters
-			hil_counter += 1 ;
-			hil_frames += 1 ;
+	/* set timestamp and notify processes (broadcast) */
+	hil_global_pos.timestamp = hrt_absolute_time();
+	orb_publish(ORB_ID(vehicle_global_position), pub_hil_global_pos, &hil_global_pos);
 
-			// output
-			if ((timestamp - old_timestamp) > 10000000) {
-				printf("receiving hil imu at %d hz\n", hil_frames/10);
-				old_timestamp = timestamp;
-				hil_frames = 0;
-			}
-		}
+	hil_attitude.roll = hil_state.roll;
+	hil_attitude.pitch = hil_state.pitch;
+	hil_attitude.yaw = hil_state.yaw;
+	hil_attitude.rollspeed = hil_state.rollspeed;
+	hil_attitude.pitchspeed = hil_state.pitchspeed;
+	hil_attitude.yawspeed = hil_state.yawspeed;
+
+	/* set timestamp and notify processes (broadcast) */
+	hil_attitude.timestamp = hrt_absolute_time();
+	orb_publish(ORB_ID(vehicle_attitude), pub_hil_attitude, &hil_attitude);
+}
 
-		if (msg->msgid == MAVLINK_MSG_ID_HIGHRES_IMU) {
-
-			mavlink_highres_imu_t imu;
-			mavlink_msg_highres_imu_decode(msg, &imu);
-
-			/* packet counter */
-			static uint16_t hil_counter = 0;
-			static uint16_t hil_frames = 0;
-			static uint64_t old_timestamp = 0;
-
-			/* sensors general */
-			hil_sensors.timestamp = hrt_absolute_time();
-
-			/* hil gyro */
-			static const float mrad2rad = 1.0e-3f;
-			hil_sensors.gyro_counter = hil_counter;
-			hil_sensors.gyro_raw[0] = imu.xgyro / mrad2rad;
-			hil_sensors.gyro_raw[1] = imu.ygyro / mrad2rad;
-			hil_sensors.gyro_raw[2] = imu.zgyro / mrad2rad;
-			hil_sensors.gyro_rad_s[0] = imu.xgyro;
-			hil_sensors.gyro_rad_s[1] = imu.ygyro;
-			hil_sensors.gyro_rad_s[2] = imu.zgyro;
-
-			/* accelerometer */
-			hil_sensors.accelerometer_counter = hil_counter;
-			static const float mg2ms2 = 9.8f / 1000.0f;
-			hil_sensors.accelerometer_raw[0] = imu.xacc / mg2ms2;
-			hil_sensors.accelerometer_raw[1] = imu.yacc / mg2ms2;
-			hil_sensors.accelerometer_raw[2] = imu.zacc / mg2ms2;
-			hil_sensors.accelerometer_m_s2[0] = imu.xacc;
-			hil_sensors.accelerometer_m_s2[1] = imu.yacc;
-			hil_sensors.accelerometer_m_s2[2] = imu.zacc;
-			hil_sensors.accelerometer_mode = 0; // TODO what is this?
-			hil_sensors.accelerometer_range_m_s2 = 32.7f; // int16
-
-			/* adc */
-			hil_sensors.adc_voltage_v[0] = 0;
-			hil_sensors.adc_voltage_v[1] = 0;
-			hil_sensors.adc_voltage_v[2] = 0;
-
-			/* magnetometer */
-			float mga2ga = 1.0e-3f;
-			hil_sensors.magnetometer_counter = hil_counter;
-			hil_sensors.magnetometer_raw[0] = imu.xmag / mga2ga;
-			hil_sensors.magnetometer_raw[1] = imu.ymag / mga2ga;
-			hil_sensors.magnetometer_raw[2] = imu.zmag / mga2ga;
-			hil_sensors.magnetometer_ga[0] = imu.xmag;
-			hil_sensors.magnetometer_ga[1] = imu.ymag;
-			hil_sensors.magnetometer_ga[2] = imu.zmag;
-			hil_sensors.magnetometer_range_ga = 32.7f; // int16
-			hil_sensors.magnetometer_mode = 0; // TODO what is this
-			hil_sensors.magnetometer_cuttoff_freq_hz = 50.0f;
-
-			hil_sensors.baro_pres_mbar = imu.abs_pressure;
-
-			float tempC =  imu.temperature;
-			float tempAvgK = T0 + (tempC + ground_tempC) / 2.0f;
-			float h =  ground_alt + (R / g) * tempAvgK * logf(ground_press / imu.abs_pressure);
-
-			hil_sensors.baro_alt_meter = h;
-			hil_sensors.baro_temp_celcius = imu.temperature;
-
-			hil_sensors.gyro_counter = hil_counter;
-			hil_sensors.magnetometer_counter = hil_counter;
-			hil_sensors.accelerometer_counter = hil_counter;
+static void
+handle_message_hil_manual_control(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	mavlink_manual_control_t man;
+	mavlink_msg_manual_control_decode(msg, &man);
 
-			/* publish */
-			orb_publish(ORB_ID(sensor_combined), pub_hil_sensors, &hil_sensors);
+	struct rc_channels_s rc_hil;
+	memset(&rc_hil, 0, sizeof(rc_hil));
+	static orb_advert_t rc_pub = 0;
 
-			// increment counters
-			hil_counter++;
-			hil_frames++;
+	rc_hil.timestamp = hrt_absolute_time();
+	rc_hil.chan_count = 4;
 
-			// output
-			if ((timestamp - old_timestamp) > 10000000) {
-				printf("receiving hil imu at %d hz\n", hil_frames/10);
-				old_timestamp = timestamp;
-				hil_frames = 0;
-			}
-		}
+	rc_hil.chan[0].scaled = man.x / 1000.0f;
+	rc_hil.chan[1].scaled = man.y / 1000.0f;
+	rc_hil.chan[2].scaled = man.r / 1000.0f;
+	rc_hil.chan[3].scaled = man.z / 1000.0f;
 
-		if (msg->msgid == MAVLINK_MSG_ID_GPS_RAW_INT) {
-
-			mavlink_gps_raw_int_t gps;
-			mavlink_msg_gps_raw_int_decode(msg, &gps);
-
-			/* packet counter */
-			static uint16_t hil_counter = 0;
-			static uint16_t hil_frames = 0;
-			static uint64_t old_timestamp = 0;
-
-			/* gps */
-			hil_gps.timestamp_position = gps.time_usec;
-//			hil_gps.counter = hil_counter++;
-			hil_gps.time_gps_usec = gps.time_usec;
-			hil_gps.lat = gps.lat;
-			hil_gps.lon = gps.lon;
-			hil_gps.alt = gps.alt;
-//			hil_gps.counter_pos_valid = hil_counter++;
-			hil_gps.eph_m = (float)gps.eph * 1e-2f; // from cm to m
-			hil_gps.epv_m = (float)gps.epv * 1e-2f; // from cm to m
-			hil_gps.s_variance_m_s = 5.0f;
-			hil_gps.p_variance_m = hil_gps.eph_m * hil_gps.eph_m;
-			hil_gps.vel_m_s = (float)gps.vel * 1e-2f; // from cm/s to m/s
-
-			/* gps.cog is in degrees 0..360 * 100, heading is -PI..PI */
-			float heading_rad = gps.cog * M_DEG_TO_RAD_F * 1e-2f - M_PI_F;
-			hil_gps.vel_n_m_s = (float)gps.vel * 1e-2f * cosf(heading_rad);
-			hil_gps.vel_e_m_s = (float)gps.vel * 1e-2f * sinf(heading_rad);
-			hil_gps.vel_d_m_s = 0.0f;
-			/* COG (course over ground) is speced as 0..360 degrees (compass) */
-			hil_gps.cog_rad = heading_rad + M_PI_F; // from deg*100 to rad
-			hil_gps.fix_type = gps.fix_type;
-			hil_gps.satellites_visible = gps.satellites_visible;
+	struct manual_control_setpoint_s mc;
+	static orb_advert_t mc_pub = 0;
 
-			/* publish */
-			orb_publish(ORB_ID(vehicle_gps_position), pub_hil_gps, &hil_gps);
+	int manual_sub = orb_subscribe(ORB_ID(manual_control_setpoint));
 
-			// increment counters
-			hil_counter += 1 ;
-			hil_frames += 1 ;
+	/* get a copy first, to prevent altering values that are not sent by the mavlink command */
+	orb_copy(ORB_ID(manual_control_setpoint), manual_sub, &mc);
 
-			// output
-			if ((timestamp - old_timestamp) > 10000000) {
-				printf("receiving hil gps at %d hz\n", hil_frames/10);
-				old_timestamp = timestamp;
-				hil_frames = 0;
-			}
-		}
+	mc.timestamp = rc_hil.timestamp;
+	mc.roll = man.x / 1000.0f;
+	mc.pitch = man.y / 1000.0f;
+	mc.yaw = man.r / 1000.0f;
+	mc.throttle = man.z / 1000.0f;
 
-		if (msg->msgid == MAVLINK_MSG_ID_RAW_PRESSURE) {
+	/* fake RC channels with manual control input from simulator */
 
-			mavlink_raw_pressure_t press;
-			mavlink_msg_raw_pressure_decode(msg, &press);
 
-			/* packet counter */
-			static uint16_t hil_counter = 0;
-			static uint16_t hil_frames = 0;
-			static uint64_t old_timestamp = 0;
+	if (rc_pub == 0) {
+		rc_pub = orb_advertise(ORB_ID(rc_channels), &rc_hil);
 
-			/* sensors general */
-			hil_sensors.timestamp = press.time_usec;
+	} else {
+		orb_publish(ORB_ID(rc_channels), rc_pub, &rc_hil);
+	}
 
-			/* baro */
+	if (mc_pub == 0) {
+		mc_pub = orb_advertise(ORB_ID(manual_control_setpoint), &mc);
 
-			float tempC =  press.temperature / 100.0f;
-			float tempAvgK = T0 + (tempC + ground_tempC) / 2.0f;
-			float h =  ground_alt + (R / g) * tempAvgK * logf(ground_press / press.press_abs);
-			hil_sensors.baro_counter = hil_counter;
-			hil_sensors.baro_pres_mbar = press.press_abs;
-			hil_sensors.baro_alt_meter = h;
-			hil_sensors.baro_temp_celcius = tempC;
+	} else {
+		orb_publish(ORB_ID(manual_control_setpoint), mc_pub, &mc);
+	}
+}
+static void
+handle_message_mission(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	mavlink_wpm_message_handler(chan, msg, &global_pos, &local_pos);
+}
 
-			/* publish */
-			orb_publish(ORB_ID(sensor_combined), pub_hil_sensors, &hil_sensors);
+static void
+handle_message_param(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	mavlink_pm_message_handler(chan, msg);
+}
 
-			// increment counters
-			hil_counter += 1 ;
-			hil_frames += 1 ;
+static void
+handle_message_data_transmission_handshake(mavlink_channel_t chan, const mavlink_message_t *msg)
+{
+	mavlink_data_transmission_handshake_t handshake;
+	mavlink_msg_data_transmission_handshake_decode(msg, &handshake);
 
-			// output
-			if ((timestamp - old_timestamp) > 10000000) {
-				printf("receiving hil pressure at %d hz\n", hil_frames/10);
-				old_timestamp = timestamp;
-				hil_frames = 0;
-			}
-		}
+	if (handshake.type == MAVLINK_LOGSTREAM_DATA_TYPE) {
+		/* the host asks for log stream packets it missed */
+		mavlink_logstream_resend(chan, handshake.width, handshake.height);
 
-		if (msg->msgid == MAVLINK_MSG_ID_HIL_STATE) {
+	} else if (handshake.type == MAVLINK_PM_BULK_DATA_TYPE) {
+		mavlink_pm_bulk_request(chan, handshake.size, handshake.width, handshake.height);
+	}
+}
+
+/**
+ * Message handler table.
+ *
+ * HIL messages are only decoded in HIL mode. The HIL mode is enabled
+ * by the HIL bit flag in the system mode. Either send a set mode
+ * COMMAND_LONG message or a SET_MODE message.
+ *
+ * Every handler gets the link the message came in on, mission and
+ * parameter transfers are answered on it.
+ */
+static const struct mavlink_rx_handler rx_handlers[] = {
+	{ MAVLINK_MSG_ID_COMMAND_LONG,				0,			handle_message_command_long },
+	{ MAVLINK_MSG_ID_OPTICAL_FLOW,				0,			handle_message_optical_flow },
+	{ MAVLINK_MSG_ID_SET_MODE,				0,			handle_message_set_mode },
+	{ MAVLINK_MSG_ID_VICON_POSITION_ESTIMATE,		0,			handle_message_vicon_position_estimate },
+	{ MAVLINK_MSG_ID_SET_QUAD_SWARM_ROLL_PITCH_YAW_THRUST,	0,			handle_message_set_quad_swarm_roll_pitch_yaw_thrust },
+	{ MAVLINK_MSG_ID_RAW_IMU,				MAVLINK_RX_HIL_ONLY,	handle_message_hil_raw_imu },
+	{ MAVLINK_MSG_ID_HIGHRES_IMU,				MAVLINK_RX_HIL_ONLY,	handle_message_hil_highres_imu },
+	{ MAVLINK_MSG_ID_GPS_RAW_INT,				MAVLINK_RX_HIL_ONLY,	handle_message_hil_gps_raw_int },
+	{ MAVLINK_MSG_ID_RAW_PRESSURE,				MAVLINK_RX_HIL_ONLY,	handle_message_hil_raw_pressure },
+	{ MAVLINK_MSG_ID_HIL_STATE,				MAVLINK_RX_HIL_ONLY,	handle_message_hil_state },
+	{ MAVLINK_MSG_ID_MANUAL_CONTROL,			MAVLINK_RX_HIL_ONLY,	handle_message_hil_manual_control },
+	{ MAVLINK_MSG_ID_MISSION_ACK,				0,			handle_message_mission },
+	{ MAVLINK_MSG_ID_MISSION_SET_CURRENT,			0,			handle_message_mission },
+	{ MAVLINK_MSG_ID_MISSION_REQUEST_LIST,			0,			handle_message_mission },
+	{ MAVLINK_MSG_ID_MISSION_REQUEST,			0,			handle_message_mission },
+	{ MAVLINK_MSG_ID_MISSION_COUNT,				0,			handle_message_mission },
+	{ MAVLINK_MSG_ID_MISSION_ITEM,				0,			handle_message_mission },
+	{ MAVLINK_MSG_ID_MISSION_CLEAR_ALL,			0,			handle_message_mission },
+	{ MAVLINK_MSG_ID_PARAM_REQUEST_LIST,			0,			handle_message_param },
+	{ MAVLINK_MSG_ID_PARAM_REQUEST_READ,			0,			handle_message_param },
+	{ MAVLINK_MSG_ID_PARAM_SET,				0,			handle_message_param },
+	{ MAVLINK_MSG_ID_DATA_TRANSMISSION_HANDSHAKE,		0,			handle_message_data_transmission_handshake },
+};
 
-			mavlink_hil_state_t hil_state;
-			mavlink_msg_hil_state_decode(msg, &hil_state);
+static void
+receive_dispatch(struct mavlink_receiver *r)
+{
+	const mavlink_message_t *msg = &r->msg;
+	unsigned index = rx_handler_index[msg->msgid];
 
-			/* Calculate Rotation Matrix */
-			//TODO: better clarification which app does this, atm we have a ekf for quadrotors which does this, but there is no such thing if fly in fixed wing mode
+	if (index == 0)
+		return;
 
-			if (mavlink_system.type == MAV_TYPE_FIXED_WING) {
-				//TODO: assuming low pitch and roll values for now
-				hil_attitude.R[0][0] = cosf(hil_state.yaw);
-				hil_attitude.R[0][1] = sinf(hil_state.yaw);
-				hil_attitude.R[0][2] = 0.0f;
+	const struct mavlink_rx_handler *h = &rx_handlers[index - 1];
 
-				hil_attitude.R[1][0] = -sinf(hil_state.yaw);
-				hil_attitude.R[1][1] = cosf(hil_state.yaw);
-				hil_attitude.R[1][2] = 0.0f;
+	if ((h->flags & MAVLINK_RX_HIL_ONLY) && !mavlink_hil_enabled)
+		return;
 
-				hil_attitude.R[2][0] = 0.0f;
-				hil_attitude.R[2][1] = 0.0f;
-				hil_attitude.R[2][2] = 1.0f;
+	h->handler(r->channel, msg);
+}
 
-				hil_attitude.R_valid = true;
-			}
+/**
+ * Pass a received frame on unchanged to the other forwarding links.
+ *
+ * Forwarded traffic is charged to the outgoing link's budget at the
+ * lowest priority, so a busy link forwarding into a slow one can never
+ * crowd out the slow link's own telemetry.
+ */
+static void
+receive_forward(struct mavlink_receiver *r, const uint8_t *frame, unsigned len)
+{
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (ch == r->channel || !mavlink_links[ch].forward)
+			continue;
 
-			hil_global_pos.lat = hil_state.lat;
-			hil_global_pos.lon = hil_state.lon;
-			hil_global_pos.alt = hil_state.alt / 1000.0f;
-			hil_global_pos.vx = hil_state.vx / 100.0f;
-			hil_global_pos.vy = hil_state.vy / 100.0f;
-			hil_global_pos.vz = hil_state.vz / 100.0f;
+		if (mavlink_stream_permit(ch, MAVLINK_STREAM_FORWARD))
+			mavlink_send_uart_bytes(ch, (uint8_t *)frame, len);
+	}
+}
 
+/**
+ * Parse and dispatch all complete frames in a receiver's buffer.
+ *
+ * Frames are located by scanning for the start byte, then validated as a
+ * whole: the payload length must match the length expected for the
+ * message ID, and the checksum (including the per-message CRC_EXTRA seed)
+ * is computed over the complete span in one pass. If validation fails
+ * the start byte is treated as noise and the scan resumes at the next
+ * byte, so a false start inside a payload cannot swallow a real frame.
+ *
+ * @param r		The receiver.
+ * @return		Number of bytes consumed; the remainder is an
+ *			incomplete frame that must be retained.
+ */
+static unsigned
+receive_parse(struct mavlink_receiver *r)
+{
+	const uint8_t *buf = r->buf;
+	const unsigned len = r->len;
+	mavlink_status_t *status = &r->status;
+	mavlink_message_t *msg = &r->msg;
+	unsigned pos = 0;
+	while (pos < len) {
 
-			/* set timestamp and notify processes (broadcast) */
-			hil_global_pos.timestamp = hrt_absolute_time();
-			orb_publish(ORB_ID(vehicle_global_position), pub_hil_global_pos, &hil_global_pos);
+		/* find the next frame start */
+		if (buf[pos] != MAVLINK_STX) {
+			const uint8_t *stx = memchr(&buf[pos], MAVLINK_STX, len - pos);
 
-			hil_attitude.roll = hil_state.roll;
-			hil_attitude.pitch = hil_state.pitch;
-			hil_attitude.yaw = hil_state.yaw;
-			hil_attitude.rollspeed = hil_state.rollspeed;
-			hil_attitude.pitchspeed = hil_state.pitchspeed;
-			hil_attitude.yawspeed = hil_state.yawspeed;
+			if (stx == NULL)
+				return len;
 
-			/* set timestamp and notify processes (broadcast) */
-			hil_attitude.timestamp = hrt_absolute_time();
-			orb_publish(ORB_ID(vehicle_attitude), pub_hil_attitude, &hil_attitude);
+			pos = stx - buf;
 		}
 
-		if (msg->msgid == MAVLINK_MSG_ID_MANUAL_CONTROL) {
-			mavlink_manual_control_t man;
-			mavlink_msg_manual_control_decode(msg, &man);
+		/* wait for the header */
+		if (len - pos < MAVLINK_NUM_HEADER_BYTES)
+			break;
 
-			struct rc_channels_s rc_hil;
-			memset(&rc_hil, 0, sizeof(rc_hil));
-			static orb_advert_t rc_pub = 0;
+		const uint8_t *frame = &buf[pos];
+		uint8_t payload_len = frame[1];
+		uint8_t msgid = frame[5];
 
-			rc_hil.timestamp = hrt_absolute_time();
-			rc_hil.chan_count = 4;
+		/* known messages have a fixed length in MAVLink 1.0 */
+		if (rx_msg_lengths[msgid] != 0 && rx_msg_lengths[msgid] != payload_len) {
+			status->parse_error++;
+			perf_count(rx_error_perf);
+			pos++;
+			continue;
+		}
 
-			rc_hil.chan[0].scaled = man.x / 1000.0f;
-			rc_hil.chan[1].scaled = man.y / 1000.0f;
-			rc_hil.chan[2].scaled = man.r / 1000.0f;
-			rc_hil.chan[3].scaled = man.z / 1000.0f;
+		/* wait for the whole frame */
+		unsigned frame_len = payload_len + MAVLINK_NUM_NON_PAYLOAD_BYTES;
 
-			struct manual_control_setpoint_s mc;
-			static orb_advert_t mc_pub = 0;
+		if (len - pos < frame_len)
+			break;
 
-			int manual_sub = orb_subscribe(ORB_ID(manual_control_setpoint));
+		/* checksum covers the header after STX and the payload */
+		uint16_t crc;
+		crc_init(&crc);
 
-			/* get a copy first, to prevent altering values that are not sent by the mavlink command */
-			orb_copy(ORB_ID(manual_control_setpoint), manual_sub, &mc);
+		for (unsigned i = 1; i < MAVLINK_NUM_HEADER_BYTES + payload_len; i++)
+			crc_accumulate(frame[i], &crc);
 
-			mc.timestamp = rc_hil.timestamp;
-			mc.roll = man.x / 1000.0f;
-			mc.pitch = man.y / 1000.0f;
-			mc.yaw = man.r / 1000.0f;
-			mc.throttle = man.z / 1000.0f;
+		crc_accumulate(rx_msg_crcs[msgid], &crc);
 
-			/* fake RC channels with manual control input from simulator */
+		const uint8_t *ck = &frame[MAVLINK_NUM_HEADER_BYTES + payload_len];
 
+		if (ck[0] != (crc & 0xff) || ck[1] != (crc >> 8)) {
+			status->parse_error++;
+			perf_count(rx_error_perf);
+			pos++;
+			continue;
+		}
 
-			if (rc_pub == 0) {
-				rc_pub = orb_advertise(ORB_ID(rc_channels), &rc_hil);
+		/* unpack; the checksum bytes follow the payload as with mavlink_parse_char */
+		msg->magic = MAVLINK_STX;
+		msg->len = payload_len;
+		msg->seq = frame[2];
+		msg->sysid = frame[3];
+		msg->compid = frame[4];
+		msg->msgid = msgid;
+		msg->checksum = crc;
+		memcpy(_MAV_PAYLOAD_NON_CONST(msg), &frame[MAVLINK_NUM_HEADER_BYTES], payload_len + MAVLINK_NUM_CHECKSUM_BYTES);
 
-			} else {
-				orb_publish(ORB_ID(rc_channels), rc_pub, &rc_hil);
-			}
+		/* account for sequence gaps */
+		if (status->packet_rx_success_count > 0)
+			status->packet_rx_drop_count += (uint8_t)(msg->seq - status->current_rx_seq - 1);
 
-			if (mc_pub == 0) {
-				mc_pub = orb_advertise(ORB_ID(manual_control_setpoint), &mc);
+		status->current_rx_seq = msg->seq;
+		status->packet_rx_success_count++;
+		status->msg_received++;
 
-			} else {
-				orb_publish(ORB_ID(manual_control_setpoint), mc_pub, &mc);
-			}
-		}
+		pos += frame_len;
+
+		if (mavlink_links[r->channel].forward)
+			receive_forward(r, frame, frame_len);
+
+		receive_dispatch(r);
 	}
-}
 
+	return pos;
+}
 
 /**
  * Receive data from UART.
@@ -658,12 +906,10 @@ handle_message(mavlink_message_t *msg)
 static void *
 receive_thread(void *arg)
 {
-	int uart_fd = *((int *)arg);
+	struct mavlink_receiver *r = (struct mavlink_receiver *)arg;
+	int uart_fd = mavlink_links[r->channel].fd;
 
 	const int timeout = 1000;
-	uint8_t buf[32];
-
-	mavlink_message_t msg;
 
 	prctl(PR_SET_NAME, "mavlink uart rcv", getpid());
 
@@ -672,21 +918,22 @@ receive_thread(void *arg)
 		struct pollfd fds[] = { { .fd = uart_fd, .events = POLLIN } };
 
 		if (poll(fds, 1, timeout) > 0) {
-			/* non-blocking read. read may return negative values */
-			ssize_t nread = read(uart_fd, buf, sizeof(buf));
+			/* non-blocking read straight behind any partial frame, may return negative values */
+			ssize_t nread = read(uart_fd, &r->buf[r->len], sizeof(r->buf) - r->len);
+
+			if (nread <= 0)
+				continue;
 
-			/* if read failed, this loop won't execute */
-			for (ssize_t i = 0; i < nread; i++) {
-				if (mavlink_parse_char(chan, buf[i], &msg, &status)) {
-					/* handle generic messages and commands */
-					handle_message(&msg);
+			r->len += nread;
 
-					/* Handle packet with waypoint component */
-					mavlink_wpm_message_handler(&msg, &global_pos, &local_pos);
+			perf_begin(rx_parse_perf);
+			unsigned consumed = receive_parse(r);
+			perf_end(rx_parse_perf);
 
-					/* Handle packet with parameter component */
-					mavlink_pm_message_handler(MAVLINK_COMM_0, &msg);
-				}
+			/* retain the incomplete frame, if any */
+			if (consumed > 0) {
+				r->len -= consumed;
+				memmove(r->buf, &r->buf[consumed], r->len);
 			}
 		}
 	}
@@ -695,8 +942,28 @@ receive_thread(void *arg)
 }
 
 pthread_t
-receive_start(int uart)
+receive_start(mavlink_channel_t channel)
 {
+	struct mavlink_receiver *r = &receivers[channel];
+	int uart = mavlink_links[channel].fd;
+
+	memset(r, 0, sizeof(*r));
+	r->channel = channel;
+
+	/* shared by all links, set up by the first */
+	if (rx_parse_perf == NULL) {
+		/* build the message ID lookup for the handler table */
+		for (unsigned i = 0; i < sizeof(rx_handlers) / sizeof(rx_handlers[0]); i++)
+			rx_handler_index[rx_handlers[i].msgid] = i + 1;
+
+		/* the log stream control message is not in the common dialect */
+		rx_msg_lengths[MAVLINK_MSG_ID_DATA_TRANSMISSION_HANDSHAKE] = MAVLINK_MSG_ID_DATA_TRANSMISSION_HANDSHAKE_LEN;
+		rx_msg_crcs[MAVLINK_MSG_ID_DATA_TRANSMISSION_HANDSHAKE] = MAVLINK_LOGSTREAM_HANDSHAKE_CRC_EXTRA;
+
+		rx_parse_perf = perf_alloc(PC_ELAPSED, "mavlink rx parse");
+		rx_error_perf = perf_alloc(PC_COUNT, "mavlink rx errors");
+	}
+
 	pthread_attr_t receiveloop_attr;
 	pthread_attr_init(&receiveloop_attr);
 
@@ -708,9 +975,9 @@ receive_start(int uart)
 	param.sched_priority = SCHED_PRIORITY_MAX - 40;
 	(void)pthread_attr_setschedparam(&receiveloop_attr, &param);
 
-	pthread_attr_setstacksize(&receiveloop_attr, 2048);
+	pthread_attr_setstacksize(&receiveloop_attr, 3072);
 
 	pthread_t thread;
-	pthread_create(&thread, &receiveloop_attr, receive_thread, &uart);
+	pthread_create(&thread, &receiveloop_attr, receive_thread, r);
 	return thread;
 }
@@ -0,0 +1,314 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *   Author: Lorenz Meier <lm@inf.ethz.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_streams.c
+ * Rate and bandwidth scheduling of outgoing MAVLink streams.
+ *
+ * The link budget is a token bucket in bytes, refilled at the share of the
+ * line rate given to streams. Priority 0 streams may always send; a stream
+ * of priority p only sends while the bucket holds more than p quarters of
+ * its capacity, so as the link saturates the lowest priorities back off
+ * first and higher priorities keep their rate.
+ *
+ * Stream tables and budgets are kept per link, each with its own lock, so
+ * senders on different links never contend.
+ */
+
+#include <nuttx/config.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "mavlink_streams.h"
+
+/** share of the line rate given to streams, the rest is left for parameter and mission transfers */
+#define MAVLINK_STREAM_LINK_SHARE	0.8f
+
+/** bucket capacity in seconds of link time */
+#define MAVLINK_STREAM_BURST_TIME	0.1f
+
+/** smallest useful bucket, a couple of maximum-size packets */
+#define MAVLINK_STREAM_MIN_BURST	(2 * 263)
+
+struct mavlink_stream_info {
+	const char	*name;
+	uint8_t		priority;
+	unsigned	interval;		/**< default interval, us */
+};
+
+static const struct mavlink_stream_info stream_info[MAVLINK_STREAM_COUNT] = {
+	[MAVLINK_STREAM_HEARTBEAT]			= {"HEARTBEAT",			0, 1000000},
+	[MAVLINK_STREAM_SYS_STATUS]			= {"SYS_STATUS",		0, 1000000},
+	[MAVLINK_STREAM_STATUSTEXT]			= {"STATUSTEXT",		1,  100000},
+	[MAVLINK_STREAM_ATTITUDE]			= {"ATTITUDE",			1,  200000},
+	[MAVLINK_STREAM_GLOBAL_POSITION_INT]		= {"GLOBAL_POSITION_INT",	1,  100000},
+	[MAVLINK_STREAM_GPS_RAW_INT]			= {"GPS_RAW_INT",		1,  200000},
+	[MAVLINK_STREAM_HIL_CONTROLS]			= {"HIL_CONTROLS",		1,       0},
+	[MAVLINK_STREAM_HIGHRES_IMU]			= {"HIGHRES_IMU",		2,  200000},
+	[MAVLINK_STREAM_RC_CHANNELS_RAW]		= {"RC_CHANNELS_RAW",		2,  100000},
+	[MAVLINK_STREAM_SERVO_OUTPUT_RAW_0]		= {"SERVO_OUTPUT_RAW_0",	2,  100000},
+	[MAVLINK_STREAM_SERVO_OUTPUT_RAW_1]		= {"SERVO_OUTPUT_RAW_1",	2,  100000},
+	[MAVLINK_STREAM_SERVO_OUTPUT_RAW_2]		= {"SERVO_OUTPUT_RAW_2",	2,  100000},
+	[MAVLINK_STREAM_SERVO_OUTPUT_RAW_3]		= {"SERVO_OUTPUT_RAW_3",	2,  100000},
+	[MAVLINK_STREAM_MANUAL_CONTROL]			= {"MANUAL_CONTROL",		2,  100000},
+	[MAVLINK_STREAM_PARAM_VALUE]			= {"PARAM_VALUE",		2,   50000},
+	[MAVLINK_STREAM_GPS_STATUS]			= {"GPS_STATUS",		3, 1000000},
+	[MAVLINK_STREAM_LOCAL_POSITION_NED]		= {"LOCAL_POSITION_NED",	3, 1000000},
+	[MAVLINK_STREAM_GLOBAL_POSITION_SETPOINT]	= {"GLOBAL_POS_SETPOINT",	3, 2000000},
+	[MAVLINK_STREAM_LOCAL_POSITION_SETPOINT]	= {"LOCAL_POS_SETPOINT",	3, 2000000},
+	[MAVLINK_STREAM_ATTITUDE_SETPOINT]		= {"ATTITUDE_SETPOINT",		3, 2000000},
+	[MAVLINK_STREAM_RATES_SETPOINT]			= {"RATES_SETPOINT",		3, 2000000},
+	[MAVLINK_STREAM_CONTROLS_EFFECTIVE]		= {"CONTROLS_EFFECTIVE",	3,  100000},
+	[MAVLINK_STREAM_DEBUG]				= {"DEBUG",			3,  100000},
+	[MAVLINK_STREAM_OPTICAL_FLOW]			= {"OPTICAL_FLOW",		3,  200000},
+	[MAVLINK_STREAM_GPS_GLOBAL_ORIGIN]		= {"GPS_GLOBAL_ORIGIN",		3, 1000000},
+	[MAVLINK_STREAM_FORWARD]			= {"(forwarded)",		3,       0},
+	[MAVLINK_STREAM_LOG]				= {"(log stream)",		3,       0},
+};
+
+struct mavlink_stream {
+	bool		enabled;
+	unsigned	interval;		/**< target interval, us */
+	hrt_abstime	last_sent;
+	unsigned	sent;			/**< messages sent in the current rate window */
+	unsigned	suppressed;		/**< updates held back by the budget, total */
+	float		rate;			/**< effective rate over the last window, Hz */
+};
+
+struct mavlink_stream_link {
+	bool			active;
+	pthread_mutex_t		mutex;
+	struct mavlink_stream	streams[MAVLINK_STREAM_COUNT];
+
+	float			bytes_per_us;	/**< budget refill rate, 0 for unlimited */
+	float			capacity;	/**< bucket size, bytes */
+	float			tokens;		/**< bytes currently available */
+	hrt_abstime		last_refill;
+	unsigned		bytes;		/**< bytes written in the current rate window */
+	float			rate;		/**< bytes/s over the last window */
+	hrt_abstime		window_start;
+};
+
+static struct mavlink_stream_link links[MAVLINK_COMM_NUM_BUFFERS];
+
+/* must be called with the link mutex held */
+static void
+refill(struct mavlink_stream_link *link, hrt_abstime now)
+{
+	link->tokens += (now - link->last_refill) * link->bytes_per_us;
+	link->last_refill = now;
+
+	if (link->tokens > link->capacity)
+		link->tokens = link->capacity;
+}
+
+void
+mavlink_streams_init(mavlink_channel_t channel, unsigned baudrate)
+{
+	struct mavlink_stream_link *link = &links[channel];
+
+	memset(link, 0, sizeof(*link));
+	pthread_mutex_init(&link->mutex, NULL);
+
+	for (unsigned i = 0; i < MAVLINK_STREAM_COUNT; i++) {
+		link->streams[i].enabled = true;
+		link->streams[i].interval = stream_info[i].interval;
+	}
+
+	if (baudrate > 0) {
+		/* 10 bits on the wire per byte */
+		float bytes_per_second = baudrate / 10.0f * MAVLINK_STREAM_LINK_SHARE;
+
+		link->bytes_per_us = bytes_per_second / 1e6f;
+		link->capacity = bytes_per_second * MAVLINK_STREAM_BURST_TIME;
+
+		if (link->capacity < MAVLINK_STREAM_MIN_BURST)
+			link->capacity = MAVLINK_STREAM_MIN_BURST;
+	}
+
+	link->tokens = link->capacity;
+	link->last_refill = hrt_absolute_time();
+	link->window_start = link->last_refill;
+	link->active = true;
+}
+
+void
+mavlink_stream_set_interval(mavlink_channel_t channel, enum mavlink_stream_id stream, unsigned interval_ms)
+{
+	if (stream >= MAVLINK_STREAM_COUNT)
+		return;
+
+	struct mavlink_stream *s = &links[channel].streams[stream];
+
+	if (interval_ms == MAVLINK_STREAM_OFF) {
+		s->enabled = false;
+
+	} else {
+		s->interval = interval_ms * 1000;
+		s->enabled = true;
+	}
+}
+
+unsigned
+mavlink_stream_min_interval(enum mavlink_stream_id stream)
+{
+	unsigned interval = UINT32_MAX;
+
+	for (unsigned i = 0; i < MAVLINK_COMM_NUM_BUFFERS; i++) {
+		const struct mavlink_stream *s = &links[i].streams[stream];
+
+		if (links[i].active && s->enabled && s->interval < interval)
+			interval = s->interval;
+	}
+
+	return (interval == UINT32_MAX) ? 0 : interval / 1000;
+}
+
+bool
+mavlink_stream_permit(mavlink_channel_t channel, enum mavlink_stream_id stream)
+{
+	struct mavlink_stream_link *link = &links[channel];
+	struct mavlink_stream *s = &link->streams[stream];
+	hrt_abstime now = hrt_absolute_time();
+	bool permit = false;
+
+	if (!link->active || !s->enabled)
+		return false;
+
+	pthread_mutex_lock(&link->mutex);
+
+	/* allow a quarter interval of jitter in the updates that drive the stream */
+	if (s->last_sent != 0 && (now - s->last_sent) + s->interval / 4 < s->interval)
+		goto out;
+
+	if (link->bytes_per_us > 0.0f && stream_info[stream].priority > 0) {
+		refill(link, now);
+
+		/* keep back the share of the bucket reserved for higher priorities */
+		if (link->tokens < (link->capacity * stream_info[stream].priority) / MAVLINK_STREAM_PRIORITIES) {
+			s->suppressed++;
+			goto out;
+		}
+	}
+
+	s->last_sent = now;
+	s->sent++;
+	permit = true;
+
+out:
+	pthread_mutex_unlock(&link->mutex);
+	return permit;
+}
+
+void
+mavlink_streams_charge(mavlink_channel_t channel, unsigned bytes)
+{
+	struct mavlink_stream_link *link = &links[channel];
+
+	if (!link->active)
+		return;
+
+	pthread_mutex_lock(&link->mutex);
+
+	link->bytes += bytes;
+
+	if (link->bytes_per_us > 0.0f) {
+		refill(link, hrt_absolute_time());
+
+		/* may go negative, the debt holds back everything but priority 0 until repaid */
+		link->tokens -= bytes;
+	}
+
+	pthread_mutex_unlock(&link->mutex);
+}
+
+void
+mavlink_streams_update(hrt_abstime now)
+{
+	for (unsigned l = 0; l < MAVLINK_COMM_NUM_BUFFERS; l++) {
+		struct mavlink_stream_link *link = &links[l];
+
+		if (!link->active || now - link->window_start < 1000000)
+			continue;
+
+		pthread_mutex_lock(&link->mutex);
+
+		float dt = (now - link->window_start) / 1e6f;
+
+		for (unsigned i = 0; i < MAVLINK_STREAM_COUNT; i++) {
+			link->streams[i].rate = link->streams[i].sent / dt;
+			link->streams[i].sent = 0;
+		}
+
+		link->rate = link->bytes / dt;
+		link->bytes = 0;
+		link->window_start = now;
+
+		pthread_mutex_unlock(&link->mutex);
+	}
+}
+
+void
+mavlink_streams_print(mavlink_channel_t channel)
+{
+	const struct mavlink_stream_link *link = &links[channel];
+
+	if (!link->active)
+		return;
+
+	if (link->bytes_per_us > 0.0f) {
+		printf("link budget %u B/s, using %u B/s\n",
+		       (unsigned)(link->bytes_per_us * 1e6f), (unsigned)link->rate);
+
+	} else {
+		printf("link budget unlimited, using %u B/s\n", (unsigned)link->rate);
+	}
+
+	printf("%-22s prio  target Hz  actual Hz  suppressed\n", "stream");
+
+	for (unsigned i = 0; i < MAVLINK_STREAM_COUNT; i++) {
+		const struct mavlink_stream *s = &link->streams[i];
+
+		if (!s->enabled)
+			continue;
+
+		printf("%-22s %4u  %9.2f  %9.2f  %10u\n",
+		       stream_info[i].name,
+		       (unsigned)stream_info[i].priority,
+		       (s->interval > 0) ? (double)(1e6f / s->interval) : 0.0,
+		       (double)s->rate,
+		       s->suppressed);
+	}
+}
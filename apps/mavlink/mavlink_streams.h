@@ -0,0 +1,155 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *   Author: Lorenz Meier <lm@inf.ethz.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_streams.h
+ * Rate and bandwidth scheduling of outgoing MAVLink streams.
+ *
+ * Every periodic message belongs to a stream with a target interval and a
+ * priority. Bytes written to the link are charged against a budget derived
+ * from the baud rate; when the link saturates, lower-priority streams are
+ * held back first so heartbeat, status and attitude keep flowing.
+ *
+ * Each link (MAVLink channel) has its own stream table and budget, so a
+ * fast link does not take bandwidth or rate from a slow one.
+ */
+
+#ifndef MAVLINK_STREAMS_H
+#define MAVLINK_STREAMS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <drivers/drv_hrt.h>
+
+#include "mavlink_bridge_header.h"
+
+enum mavlink_stream_id {
+	/* priority 0, never held back by the budget */
+	MAVLINK_STREAM_HEARTBEAT = 0,
+	MAVLINK_STREAM_SYS_STATUS,
+
+	/* priority 1 */
+	MAVLINK_STREAM_STATUSTEXT,
+	MAVLINK_STREAM_ATTITUDE,
+	MAVLINK_STREAM_GLOBAL_POSITION_INT,
+	MAVLINK_STREAM_GPS_RAW_INT,
+	MAVLINK_STREAM_HIL_CONTROLS,
+
+	/* priority 2 */
+	MAVLINK_STREAM_HIGHRES_IMU,
+	MAVLINK_STREAM_RC_CHANNELS_RAW,
+	MAVLINK_STREAM_SERVO_OUTPUT_RAW_0,
+	MAVLINK_STREAM_SERVO_OUTPUT_RAW_1,
+	MAVLINK_STREAM_SERVO_OUTPUT_RAW_2,
+	MAVLINK_STREAM_SERVO_OUTPUT_RAW_3,
+	MAVLINK_STREAM_MANUAL_CONTROL,
+	MAVLINK_STREAM_PARAM_VALUE,
+
+	/* priority 3 */
+	MAVLINK_STREAM_GPS_STATUS,
+	MAVLINK_STREAM_LOCAL_POSITION_NED,
+	MAVLINK_STREAM_GLOBAL_POSITION_SETPOINT,
+	MAVLINK_STREAM_LOCAL_POSITION_SETPOINT,
+	MAVLINK_STREAM_ATTITUDE_SETPOINT,
+	MAVLINK_STREAM_RATES_SETPOINT,
+	MAVLINK_STREAM_CONTROLS_EFFECTIVE,
+	MAVLINK_STREAM_DEBUG,
+	MAVLINK_STREAM_OPTICAL_FLOW,
+	MAVLINK_STREAM_GPS_GLOBAL_ORIGIN,
+	MAVLINK_STREAM_FORWARD,
+	MAVLINK_STREAM_LOG,
+
+	MAVLINK_STREAM_COUNT
+};
+
+#define MAVLINK_STREAM_PRIORITIES	4
+
+/** interval that switches a stream off */
+#define MAVLINK_STREAM_OFF		UINT32_MAX
+
+/**
+ * Initialise the stream table and budget of a link.
+ *
+ * @param channel	The link.
+ * @param baudrate	Link speed in bits/s, or 0 for links without a
+ *			meaningful limit (USB).
+ */
+void mavlink_streams_init(mavlink_channel_t channel, unsigned baudrate);
+
+/**
+ * Set the target interval of a stream on a link.
+ *
+ * @param channel	The link.
+ * @param stream	The stream.
+ * @param interval_ms	Minimum interval between messages, in milliseconds;
+ *			0 sends every update, MAVLINK_STREAM_OFF never sends.
+ */
+void mavlink_stream_set_interval(mavlink_channel_t channel, enum mavlink_stream_id stream, unsigned interval_ms);
+
+/**
+ * Shortest interval of a stream over all links.
+ *
+ * This is the rate the data source feeding the stream has to run at.
+ *
+ * @return		Interval in milliseconds, or 0 if any link wants
+ *			every update or no link has the stream enabled.
+ */
+unsigned mavlink_stream_min_interval(enum mavlink_stream_id stream);
+
+/**
+ * Decide whether a stream may send on a link now.
+ *
+ * Returns true if the stream is due and the link budget has room for its
+ * priority; the caller must then send the message. Returns false if the
+ * update should be skipped.
+ */
+bool mavlink_stream_permit(mavlink_channel_t channel, enum mavlink_stream_id stream);
+
+/**
+ * Charge bytes written to a link against its budget.
+ */
+void mavlink_streams_charge(mavlink_channel_t channel, unsigned bytes);
+
+/**
+ * Recompute effective stream rates of all links; call regularly, acts
+ * once a second.
+ */
+void mavlink_streams_update(hrt_abstime now);
+
+/**
+ * Print the stream table of a link with target and effective rates.
+ */
+void mavlink_streams_print(mavlink_channel_t channel);
+
+#endif /* MAVLINK_STREAMS_H */
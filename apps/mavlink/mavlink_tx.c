@@ -0,0 +1,276 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *   Author: Lorenz Meier <lm@inf.ethz.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mavlink_tx.c
+ * Buffered MAVLink transmit path.
+ *
+ * The generated send helpers bracket every message with
+ * MAVLINK_START_UART_SEND / MAVLINK_END_UART_SEND. The start call takes the
+ * queue lock and reserves room for the whole message (or marks it to be
+ * dropped), the byte calls copy into the ring, and the end call commits the
+ * message and wakes the writer. Messages from different threads therefore
+ * never interleave, and the lock is only held for the copy.
+ */
+
+#include <nuttx/config.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <sys/prctl.h>
+
+#include "mavlink_tx.h"
+#include "mavlink_streams.h"
+#include "waypoints.h"
+#include "util.h"
+
+struct mavlink_txq {
+	uint8_t			*buf;
+	unsigned		size;
+	int			fd;
+	volatile unsigned	head;		/**< end of committed data, advanced by senders */
+	volatile unsigned	tail;		/**< next byte to write, advanced by the writer */
+	pthread_mutex_t		lock;
+	sem_t			ready;		/**< posted when data is committed */
+
+	/* message being assembled, valid while the lock is held */
+	bool			in_message;
+	bool			dropping;
+	pthread_t		owner;
+	unsigned		pending;	/**< head including the message being assembled */
+
+	/* statistics */
+	unsigned		messages;
+	unsigned		bytes;
+	unsigned		dropped;
+	unsigned		dropped_bytes;
+	unsigned		writes;
+	unsigned		max_fill;
+};
+
+static struct mavlink_txq txq[MAVLINK_COMM_NUM_BUFFERS];
+
+static unsigned
+txq_fill(const struct mavlink_txq *q)
+{
+	return (q->head + q->size - q->tail) % q->size;
+}
+
+static void *
+tx_thread(void *arg)
+{
+	struct mavlink_txq *q = (struct mavlink_txq *)arg;
+
+	/* Set thread name */
+	prctl(PR_SET_NAME, "mavlink tx", getpid());
+
+	while (!thread_should_exit) {
+		unsigned head = q->head;
+		unsigned tail = q->tail;
+
+		if (head == tail) {
+			/* nothing queued, wait for a sender */
+			sem_wait(&q->ready);
+			continue;
+		}
+
+		/* write as much as is contiguous in the ring */
+		unsigned span = (head > tail) ? (head - tail) : (q->size - tail);
+		ssize_t ret = write(q->fd, &q->buf[tail], span);
+
+		if (ret > 0) {
+			q->tail = (tail + ret) % q->size;
+			q->writes++;
+
+		} else {
+			/* the port is shared with the non-blocking receiver; wait for room */
+			struct pollfd fds;
+			fds.fd = q->fd;
+			fds.events = POLLOUT;
+			poll(&fds, 1, 10);
+		}
+	}
+
+	return NULL;
+}
+
+pthread_t
+mavlink_tx_start(mavlink_channel_t channel, int fd, unsigned size)
+{
+	struct mavlink_txq *q = &txq[channel];
+
+	memset(q, 0, sizeof(*q));
+	q->fd = fd;
+	q->size = size;
+	q->buf = (uint8_t *)malloc(size);
+	pthread_mutex_init(&q->lock, NULL);
+	sem_init(&q->ready, 0, 0);
+
+	pthread_attr_t tx_attr;
+	pthread_attr_init(&tx_attr);
+	pthread_attr_setstacksize(&tx_attr, 1024);
+
+	pthread_t thread;
+	pthread_create(&thread, &tx_attr, tx_thread, q);
+	return thread;
+}
+
+void
+mavlink_tx_stop(mavlink_channel_t channel)
+{
+	sem_post(&txq[channel].ready);
+}
+
+void
+mavlink_tx_free(mavlink_channel_t channel)
+{
+	struct mavlink_txq *q = &txq[channel];
+
+	if (q->buf == NULL)
+		return;
+
+	/* senders check buf before taking the lock; drop it under the lock */
+	pthread_mutex_lock(&q->lock);
+	uint8_t *buf = q->buf;
+	q->buf = NULL;
+	pthread_mutex_unlock(&q->lock);
+
+	free(buf);
+	pthread_mutex_destroy(&q->lock);
+	sem_destroy(&q->ready);
+}
+
+void
+mavlink_start_uart_send(mavlink_channel_t channel, int length)
+{
+	struct mavlink_txq *q = &txq[channel];
+
+	if (q->buf == NULL)
+		return;
+
+	pthread_mutex_lock(&q->lock);
+
+	q->in_message = true;
+	q->owner = pthread_self();
+	q->pending = q->head;
+
+	/* one slot stays free so that a full ring is distinguishable from an empty one */
+	q->dropping = (txq_fill(q) + length >= q->size);
+}
+
+void
+mavlink_send_uart_bytes(mavlink_channel_t channel, uint8_t *ch, int length)
+{
+	struct mavlink_txq *q = &txq[channel];
+
+	if (q->buf == NULL)
+		return;
+
+	if (!q->in_message || !pthread_equal(q->owner, pthread_self())) {
+		/* not bracketed by the send helpers, queue it as a message of its own */
+		mavlink_start_uart_send(channel, length);
+		mavlink_send_uart_bytes(channel, ch, length);
+		mavlink_end_uart_send(channel, length);
+		return;
+	}
+
+	if (q->dropping)
+		return;
+
+	/* copy in at most two pieces around the end of the ring */
+	unsigned first = q->size - q->pending;
+
+	if (first > (unsigned)length)
+		first = length;
+
+	memcpy(&q->buf[q->pending], ch, first);
+	memcpy(&q->buf[0], ch + first, length - first);
+
+	q->pending = (q->pending + length) % q->size;
+}
+
+void
+mavlink_end_uart_send(mavlink_channel_t channel, int length)
+{
+	struct mavlink_txq *q = &txq[channel];
+
+	if (q->buf == NULL)
+		return;
+
+	if (q->dropping) {
+		q->dropped++;
+		q->dropped_bytes += length;
+
+	} else {
+		q->head = q->pending;
+		q->messages++;
+		q->bytes += length;
+
+		unsigned fill = txq_fill(q);
+
+		if (fill > q->max_fill)
+			q->max_fill = fill;
+
+		mavlink_streams_charge(channel, length);
+
+		/* wake the writer unless a wakeup is already pending */
+		int value;
+		sem_getvalue(&q->ready, &value);
+
+		if (value < 1)
+			sem_post(&q->ready);
+	}
+
+	q->in_message = false;
+
+	pthread_mutex_unlock(&q->lock);
+}
+
+void
+mavlink_tx_print(mavlink_channel_t channel)
+{
+	const struct mavlink_txq *q = &txq[channel];
+
+	if (q->buf == NULL)
+		return;
+
+	printf("tx queue: %u msgs, %u bytes in %u writes, %u msgs / %u bytes dropped, fill %u max %u of %u\n",
+	       q->messages, q->bytes, q->writes,
+	       q->dropped, q->dropped_bytes,
+	       txq_fill(q), q->max_fill, q->size);
+}
@@ -33,49 +33,50 @@
  ****************************************************************************/
 
 /**
- * @file mavlink_bridge_header
- * MAVLink bridge header for UART access.
+ * @file mavlink_tx.h
+ * Buffered MAVLink transmit path.
  *
- * @author Lorenz Meier <lm@inf.ethz.ch>
+ * Messages are queued whole into a per-channel ring by the sending threads
+ * and written out by a single writer thread in large chunks. Senders never
+ * block on the serial driver; a message that does not fit is dropped and
+ * counted.
  */
 
-/* MAVLink adapter header */
-#ifndef MAVLINK_BRIDGE_HEADER_H
-#define MAVLINK_BRIDGE_HEADER_H
+#ifndef MAVLINK_TX_H
+#define MAVLINK_TX_H
 
-#define MAVLINK_USE_CONVENIENCE_FUNCTIONS
+#include <pthread.h>
+#include "mavlink_bridge_header.h"
 
-/* use efficient approach, see mavlink_helpers.h */
-#define MAVLINK_SEND_UART_BYTES mavlink_send_uart_bytes
+/** ring size of serial links, bytes */
+#define MAVLINK_TX_QUEUE_SIZE		2048
 
-#define MAVLINK_GET_CHANNEL_BUFFER mavlink_get_channel_buffer
-#define MAVLINK_GET_CHANNEL_STATUS mavlink_get_channel_status
+/** ring size of USB links, large enough to ride out bursts of the log stream */
+#define MAVLINK_TX_QUEUE_SIZE_USB	8192
 
-#include "v1.0/mavlink_types.h"
-#include <unistd.h>
-
-
-/* Struct that stores the communication settings of this system.
-   you can also define / alter these settings elsewhere, as long
-   as they're included BEFORE mavlink.h.
-   So you can set the
-
-   mavlink_system.sysid = 100; // System ID, 1-255
-   mavlink_system.compid = 50; // Component/Subsystem ID, 1-255
+/**
+ * Set up the transmit queue for a channel and start its writer thread.
+ *
+ * @param channel	The MAVLink channel.
+ * @param fd		File descriptor the channel writes to.
+ * @param size		Ring size in bytes.
+ * @return		The writer thread.
+ */
+pthread_t mavlink_tx_start(mavlink_channel_t channel, int fd, unsigned size);
 
-   Lines also in your main.c, e.g. by reading these parameter from EEPROM.
+/**
+ * Wake the writer so it notices thread_should_exit.
  */
-extern mavlink_system_t mavlink_system;
+void mavlink_tx_stop(mavlink_channel_t channel);
 
 /**
- * @brief Send multiple chars (uint8_t) over a comm channel
- *
- * @param chan MAVLink channel to use, usually MAVLINK_COMM_0 = UART0
- * @param ch Character to send
+ * Free the queue of a channel, once its writer thread has been joined.
  */
-extern void mavlink_send_uart_bytes(mavlink_channel_t chan, uint8_t *ch, int length);
+void mavlink_tx_free(mavlink_channel_t channel);
 
-mavlink_status_t* mavlink_get_channel_status(uint8_t chan);
-mavlink_message_t* mavlink_get_channel_buffer(uint8_t chan);
+/**
+ * Print the queue statistics of a channel.
+ */
+void mavlink_tx_print(mavlink_channel_t channel);
 
-#endif /* MAVLINK_BRIDGE_HEADER_H */
+#endif /* MAVLINK_TX_H */
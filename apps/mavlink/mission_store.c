@@ -0,0 +1,426 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *   Author: Lorenz Meier <lm@inf.ethz.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mission_store.c
+ * Persistent, indexed storage of the mission.
+ *
+ * A slot is a header followed by one record per item; every record and the
+ * header carry a CRC so a damaged card shows up as a failed read instead of
+ * a wrong waypoint. Reads of the active slot go through a small
+ * direct-mapped cache, which covers the active leg and the neighbouring
+ * items that are sent around it.
+ */
+
+#include <nuttx/config.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mission_store.h"
+
+#define MISSION_STORE_MAGIC		0x4d534e31	/* "MSN1" */
+#define MISSION_STORE_CACHE		4		/* must be a power of two */
+
+struct mission_store_header {
+	uint32_t	magic;
+	uint32_t	generation;		/**< incremented on every commit */
+	uint16_t	count;
+	int16_t		current;
+	uint16_t	crc;			/**< over the fields above */
+	uint16_t	reserved;
+};
+
+struct mission_store_record {
+	mavlink_mission_item_t item;
+	uint16_t	crc;			/**< over item */
+};
+
+struct mission_store_cache_entry {
+	bool		valid;
+	uint16_t	seq;
+	mavlink_mission_item_t item;
+};
+
+static pthread_mutex_t store_lock;
+
+/* backing of the two slots, a file each or a RAM array each */
+static int slot_fd[2] = { -1, -1 };
+static struct mission_store_record *slot_ram[2];
+static struct mission_store_header slot_ram_header[2];
+static unsigned capacity;
+
+static int active = -1;				/**< slot holding the active mission */
+static struct mission_store_header active_header;
+static struct mission_store_cache_entry cache[MISSION_STORE_CACHE];
+static unsigned staged_count;			/**< items of the mission being written */
+
+/* statistics */
+static unsigned cache_misses;
+static unsigned read_errors;
+static unsigned write_errors;
+
+static uint16_t
+header_crc(const struct mission_store_header *h)
+{
+	return crc_calculate((const uint8_t *)h, offsetof(struct mission_store_header, crc));
+}
+
+static int
+slot_pread(int slot, off_t offset, void *buf, size_t len)
+{
+	if (slot_fd[slot] < 0)
+		return ERROR;
+
+	if (lseek(slot_fd[slot], offset, SEEK_SET) != offset)
+		return ERROR;
+
+	return (read(slot_fd[slot], buf, len) == (ssize_t)len) ? OK : ERROR;
+}
+
+static int
+slot_pwrite(int slot, off_t offset, const void *buf, size_t len)
+{
+	if (slot_fd[slot] < 0)
+		return ERROR;
+
+	if (lseek(slot_fd[slot], offset, SEEK_SET) != offset)
+		return ERROR;
+
+	return (write(slot_fd[slot], buf, len) == (ssize_t)len) ? OK : ERROR;
+}
+
+static int
+slot_read_header(int slot, struct mission_store_header *h)
+{
+	if (slot_ram[slot] != NULL) {
+		*h = slot_ram_header[slot];
+
+	} else if (slot_pread(slot, 0, h, sizeof(*h)) != OK) {
+		return ERROR;
+	}
+
+	if (h->magic != MISSION_STORE_MAGIC || h->crc != header_crc(h) || h->count > capacity)
+		return ERROR;
+
+	return OK;
+}
+
+static int
+slot_write_header(int slot, struct mission_store_header *h)
+{
+	h->crc = header_crc(h);
+
+	if (slot_ram[slot] != NULL) {
+		slot_ram_header[slot] = *h;
+		return OK;
+	}
+
+	if (slot_pwrite(slot, 0, h, sizeof(*h)) != OK)
+		return ERROR;
+
+	/* the header makes the slot valid, it has to be on the card before anything relies on it */
+	return fsync(slot_fd[slot]);
+}
+
+static int
+slot_read_record(int slot, uint16_t seq, mavlink_mission_item_t *item)
+{
+	struct mission_store_record r;
+
+	if (slot_ram[slot] != NULL) {
+		r = slot_ram[slot][seq];
+
+	} else if (slot_pread(slot, sizeof(struct mission_store_header) + seq * sizeof(r), &r, sizeof(r)) != OK) {
+		return ERROR;
+	}
+
+	if (r.crc != crc_calculate((const uint8_t *)&r.item, sizeof(r.item)))
+		return ERROR;
+
+	memcpy(item, &r.item, sizeof(r.item));
+	return OK;
+}
+
+static int
+slot_write_record(int slot, uint16_t seq, const mavlink_mission_item_t *item)
+{
+	struct mission_store_record r;
+
+	memset(&r, 0, sizeof(r));
+	memcpy(&r.item, item, sizeof(r.item));
+	r.crc = crc_calculate((const uint8_t *)&r.item, sizeof(r.item));
+
+	if (slot_ram[slot] != NULL) {
+		slot_ram[slot][seq] = r;
+		return OK;
+	}
+
+	return slot_pwrite(slot, sizeof(struct mission_store_header) + seq * sizeof(r), &r, sizeof(r));
+}
+
+/* must be called with the lock held */
+static void
+cache_flush(void)
+{
+	for (unsigned i = 0; i < MISSION_STORE_CACHE; i++)
+		cache[i].valid = false;
+}
+
+/* must be called with the lock held */
+static int
+store_commit(unsigned count, int current)
+{
+	int slot = (active == 0) ? 1 : 0;
+	struct mission_store_header h;
+
+	memset(&h, 0, sizeof(h));
+	h.magic = MISSION_STORE_MAGIC;
+	h.generation = (active < 0) ? 1 : active_header.generation + 1;
+	h.count = count;
+	h.current = current;
+
+	/* the records must be on the card before the header points at them */
+	if ((slot_fd[slot] >= 0 && fsync(slot_fd[slot]) != OK) || slot_write_header(slot, &h) != OK) {
+		write_errors++;
+		return ERROR;
+	}
+
+	active = slot;
+	active_header = h;
+	cache_flush();
+	return OK;
+}
+
+unsigned
+mission_store_init(void)
+{
+	static const char *const paths[2] = { MISSION_STORE_SLOT0, MISSION_STORE_SLOT1 };
+
+	pthread_mutex_init(&store_lock, NULL);
+
+	for (unsigned i = 0; i < 2; i++)
+		slot_fd[i] = open(paths[i], O_RDWR | O_CREAT);
+
+	if (slot_fd[0] >= 0 && slot_fd[1] >= 0) {
+		capacity = MISSION_STORE_MAX_ITEMS;
+
+	} else {
+		/* no card, keep a small mission in RAM */
+		for (unsigned i = 0; i < 2; i++) {
+			if (slot_fd[i] >= 0) {
+				close(slot_fd[i]);
+				slot_fd[i] = -1;
+			}
+
+			slot_ram[i] = (struct mission_store_record *)calloc(MISSION_STORE_RAM_ITEMS, sizeof(struct mission_store_record));
+		}
+
+		capacity = (slot_ram[0] != NULL && slot_ram[1] != NULL) ? MISSION_STORE_RAM_ITEMS : 0;
+	}
+
+	/* restore the newest valid slot */
+	for (unsigned i = 0; i < 2; i++) {
+		struct mission_store_header h;
+
+		if (slot_read_header(i, &h) == OK && (active < 0 || h.generation > active_header.generation)) {
+			active = i;
+			active_header = h;
+		}
+	}
+
+	if (active < 0)
+		memset(&active_header, 0, sizeof(active_header));
+
+	return active_header.count;
+}
+
+unsigned
+mission_store_capacity(void)
+{
+	return capacity;
+}
+
+unsigned
+mission_store_count(void)
+{
+	return (active < 0) ? 0 : active_header.count;
+}
+
+int
+mission_store_current(void)
+{
+	if (active < 0 || active_header.current < 0 || active_header.current >= active_header.count)
+		return -1;
+
+	return active_header.current;
+}
+
+int
+mission_store_read(uint16_t seq, mavlink_mission_item_t *item)
+{
+	int ret = OK;
+
+	pthread_mutex_lock(&store_lock);
+
+	if (active < 0 || seq >= active_header.count) {
+		ret = ERROR;
+
+	} else {
+		struct mission_store_cache_entry *e = &cache[seq & (MISSION_STORE_CACHE - 1)];
+
+		if (!e->valid || e->seq != seq) {
+			cache_misses++;
+			e->valid = (slot_read_record(active, seq, &e->item) == OK);
+			e->seq = seq;
+		}
+
+		if (e->valid) {
+			memcpy(item, &e->item, sizeof(e->item));
+
+		} else {
+			read_errors++;
+			ret = ERROR;
+		}
+	}
+
+	pthread_mutex_unlock(&store_lock);
+	return ret;
+}
+
+int
+mission_store_set_current(int seq)
+{
+	int ret = OK;
+
+	pthread_mutex_lock(&store_lock);
+
+	if (active >= 0 && active_header.current != seq) {
+		struct mission_store_header h = active_header;
+
+		h.current = seq;
+
+		if (slot_write_header(active, &h) == OK) {
+			active_header = h;
+
+		} else {
+			write_errors++;
+			ret = ERROR;
+		}
+	}
+
+	pthread_mutex_unlock(&store_lock);
+	return ret;
+}
+
+int
+mission_store_begin(unsigned count)
+{
+	int slot;
+	struct mission_store_header h;
+	int ret = OK;
+
+	pthread_mutex_lock(&store_lock);
+
+	slot = (active == 0) ? 1 : 0;
+
+	/* the slot is overwritten from here on, it must not be mistaken for a mission */
+	memset(&h, 0, sizeof(h));
+
+	if (count > capacity || slot_write_header(slot, &h) != OK)
+		ret = ERROR;
+
+	staged_count = (ret == OK) ? count : 0;
+
+	pthread_mutex_unlock(&store_lock);
+	return ret;
+}
+
+int
+mission_store_write(uint16_t seq, const mavlink_mission_item_t *item)
+{
+	int ret;
+
+	pthread_mutex_lock(&store_lock);
+
+	if (seq >= capacity) {
+		ret = ERROR;
+
+	} else {
+		ret = slot_write_record((active == 0) ? 1 : 0, seq, item);
+
+		if (ret != OK)
+			write_errors++;
+	}
+
+	pthread_mutex_unlock(&store_lock);
+	return ret;
+}
+
+int
+mission_store_commit(int current)
+{
+	int ret;
+
+	pthread_mutex_lock(&store_lock);
+	ret = store_commit(staged_count, current);
+	pthread_mutex_unlock(&store_lock);
+
+	return ret;
+}
+
+int
+mission_store_clear(void)
+{
+	int ret;
+
+	pthread_mutex_lock(&store_lock);
+	ret = store_commit(0, -1);
+	pthread_mutex_unlock(&store_lock);
+
+	return ret;
+}
+
+void
+mission_store_print(void)
+{
+	printf("mission: %u of %u items%s, current %d, generation %u, %u cache misses, %u read errors, %u write errors\n",
+	       mission_store_count(), capacity, (slot_ram[0] != NULL) ? " (RAM, no card)" : "",
+	       mission_store_current(), (unsigned)active_header.generation, cache_misses, read_errors, write_errors);
+}
@@ -0,0 +1,144 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *   Author: Lorenz Meier <lm@inf.ethz.ch>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file mission_store.h
+ * Persistent, indexed storage of the mission.
+ *
+ * The mission lives on the microSD card in two slot files. Each slot holds
+ * a header followed by fixed-size records, so item n is found at a fixed
+ * offset and never has to be held in RAM. An upload is written into the
+ * slot that is not active and becomes active only when its header is
+ * written last; a mission interrupted by a reset or a failed upload leaves
+ * the previous mission intact. The slot with the highest generation and a
+ * valid header wins on startup.
+ *
+ * Without a card the same slots are kept in RAM, limited to
+ * MISSION_STORE_RAM_ITEMS items, and the mission is lost on reset.
+ *
+ * All functions may be called from the receive threads and the main loop.
+ */
+
+#ifndef MISSION_STORE_H
+#define MISSION_STORE_H
+
+#include <stdint.h>
+#include "mavlink_bridge_header.h"
+#include <v1.0/common/mavlink.h>
+
+#define MISSION_STORE_SLOT0		"/fs/microsd/mission0.dat"
+#define MISSION_STORE_SLOT1		"/fs/microsd/mission1.dat"
+
+/** items a slot file may hold, bounded by the uint16 sequence number */
+#define MISSION_STORE_MAX_ITEMS		4096
+
+/** items per slot without a card */
+#define MISSION_STORE_RAM_ITEMS		15
+
+/**
+ * Open the slots and restore the last mission.
+ *
+ * @return		Number of items in the restored mission.
+ */
+unsigned mission_store_init(void);
+
+/**
+ * Number of items a mission may have.
+ */
+unsigned mission_store_capacity(void);
+
+/**
+ * Number of items in the active mission.
+ */
+unsigned mission_store_count(void);
+
+/**
+ * The item that was current when the mission was last saved.
+ *
+ * @return		Sequence number, or -1 if no item is current.
+ */
+int mission_store_current(void);
+
+/**
+ * Read an item of the active mission.
+ *
+ * Recently read items are cached, so the items around the active leg cost
+ * no card access.
+ *
+ * @return		OK, or ERROR if seq is out of range or the record is damaged.
+ */
+int mission_store_read(uint16_t seq, mavlink_mission_item_t *item);
+
+/**
+ * Remember the current item of the active mission across resets.
+ *
+ * @param seq		Sequence number, or -1 for none.
+ */
+int mission_store_set_current(int seq);
+
+/**
+ * Start writing a new mission.
+ *
+ * The active mission stays readable until mission_store_commit().
+ *
+ * @param count		Number of items that will be written.
+ * @return		OK, or ERROR if the mission does not fit.
+ */
+int mission_store_begin(unsigned count);
+
+/**
+ * Write an item of the mission being uploaded, in any order.
+ */
+int mission_store_write(uint16_t seq, const mavlink_mission_item_t *item);
+
+/**
+ * Make the uploaded mission the active one.
+ *
+ * @param current	Sequence number of the current item, or -1 for none.
+ * @return		OK, or ERROR if the slot could not be written; the
+ *			previous mission then stays active.
+ */
+int mission_store_commit(int current);
+
+/**
+ * Replace the active mission with an empty one.
+ */
+int mission_store_clear(void);
+
+/**
+ * Print the storage state.
+ */
+void mission_store_print(void);
+
+#endif /* MISSION_STORE_H */
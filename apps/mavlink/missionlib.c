@@ -72,11 +72,11 @@
 #include "waypoints.h"
 #include "mavlink_parameters.h"
 
-static uint8_t missionlib_msg_buf[MAVLINK_MAX_PACKET_LEN];
-
 int
-mavlink_missionlib_send_message(mavlink_message_t *msg)
+mavlink_missionlib_send_message(mavlink_channel_t chan, mavlink_message_t *msg)
 {
+	/* on the stack, the receivers of several links may answer at once */
+	uint8_t missionlib_msg_buf[MAVLINK_MAX_PACKET_LEN];
 	uint16_t len = mavlink_msg_to_send_buffer(missionlib_msg_buf, msg);
 
 	mavlink_send_uart_bytes(chan, missionlib_msg_buf, len);
@@ -84,7 +84,7 @@ mavlink_missionlib_send_message(mavlink_message_t *msg)
 }
 
 int
-mavlink_missionlib_send_gcs_string(const char *string)
+mavlink_missionlib_send_gcs_string(mavlink_channel_t chan, const char *string)
 {
 	const int len = MAVLINK_MSG_STATUSTEXT_FIELD_TEXT_LEN;
 	mavlink_statustext_t statustext;
@@ -105,7 +105,7 @@ mavlink_missionlib_send_gcs_string(const char *string)
 		mavlink_message_t msg;
 
 		mavlink_msg_statustext_encode(mavlink_system.sysid, mavlink_system.compid, &msg, &statustext);
-		return mavlink_missionlib_send_message(&msg);
+		return mavlink_missionlib_send_message(chan, &msg);
 
 	} else {
 		return 1;
@@ -128,7 +128,7 @@ uint64_t mavlink_missionlib_get_system_timestamp()
  * It publishes the vehicle_global_position_setpoint_s or the
  * vehicle_local_position_setpoint_s topic, depending on the type of waypoint
  */
-void mavlink_missionlib_current_waypoint_changed(uint16_t index, float param1,
+void mavlink_missionlib_current_waypoint_changed(mavlink_channel_t chan, uint16_t index, float param1,
 		float param2, float param3, float param4, float param5_lat_x,
 		float param6_lon_y, float param7_alt_z, uint8_t frame, uint16_t command)
 {
@@ -194,7 +194,7 @@ void mavlink_missionlib_current_waypoint_changed(uint16_t index, float param1,
 		sprintf(buf, "[mp] WP#%i (x: %f/y %f/z %f/hdg %f\n", (int)index, (double)param5_lat_x, (double)param6_lon_y, (double)param7_alt_z, (double)param4);
 	}
 
-	mavlink_missionlib_send_gcs_string(buf);
+	mavlink_missionlib_send_gcs_string(chan, buf);
 	printf("%s\n", buf);
 	//printf("[mavlink mp] new setpoint\n");//: frame: %d, lat: %d, lon: %d, alt: %d, yaw: %d\n", frame, param5_lat_x*1000, param6_lon_y*1000, param7_alt_z*1000, param4*1000);
 }
@@ -61,6 +61,7 @@
 #include "orb_topics.h"
 #include "missionlib.h"
 #include "mavlink_hil.h"
+#include "mavlink_streams.h"
 #include "util.h"
 
 extern bool gcs_link;
@@ -184,16 +185,18 @@ l_sensor_combined(const struct listener *l)
 		baro_counter = raw.baro_counter;
 	}
 
-	if (gcs_link)
-		mavlink_msg_highres_imu_send(MAVLINK_COMM_0, last_sensor_timestamp,
-					     raw.accelerometer_m_s2[0], raw.accelerometer_m_s2[1],
-					     raw.accelerometer_m_s2[2], raw.gyro_rad_s[0],
-					     raw.gyro_rad_s[1], raw.gyro_rad_s[2],
-					     raw.magnetometer_ga[0],
-					     raw.magnetometer_ga[1], raw.magnetometer_ga[2],
-					     raw.baro_pres_mbar, 0 /* no diff pressure yet */,
-					     raw.baro_alt_meter, raw.baro_temp_celcius,
-					     fields_updated);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_HIGHRES_IMU))
+			mavlink_msg_highres_imu_send(ch, last_sensor_timestamp,
+						     raw.accelerometer_m_s2[0], raw.accelerometer_m_s2[1],
+						     raw.accelerometer_m_s2[2], raw.gyro_rad_s[0],
+						     raw.gyro_rad_s[1], raw.gyro_rad_s[2],
+						     raw.magnetometer_ga[0],
+						     raw.magnetometer_ga[1], raw.magnetometer_ga[2],
+						     raw.baro_pres_mbar, 0 /* no diff pressure yet */,
+						     raw.baro_alt_meter, raw.baro_temp_celcius,
+						     fields_updated);
+	}
 
 	sensors_raw_counter++;
 }
@@ -207,16 +210,18 @@ l_vehicle_attitude(const struct listener *l)
 	/* copy attitude data into local buffer */
 	orb_copy(ORB_ID(vehicle_attitude), mavlink_subs.att_sub, &att);
 
-	if (gcs_link)
-		/* send sensor values */
-		mavlink_msg_attitude_send(MAVLINK_COMM_0,
-					  last_sensor_timestamp / 1000,
-					  att.roll,
-					  att.pitch,
-					  att.yaw,
-					  att.rollspeed,
-					  att.pitchspeed,
-					  att.yawspeed);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_ATTITUDE))
+			/* send sensor values */
+			mavlink_msg_attitude_send(ch,
+						  last_sensor_timestamp / 1000,
+						  att.roll,
+						  att.pitch,
+						  att.yaw,
+						  att.rollspeed,
+						  att.pitchspeed,
+						  att.yawspeed);
+	}
 
 	attitude_counter++;
 }
@@ -230,26 +235,31 @@ l_vehicle_gps_position(const struct listener *l)
 	orb_copy(ORB_ID(vehicle_gps_position), mavlink_subs.gps_sub, &gps);
 
 	/* GPS position */
-	mavlink_msg_gps_raw_int_send(MAVLINK_COMM_0,
-				     gps.timestamp_position,
-				     gps.fix_type,
-				     gps.lat,
-				     gps.lon,
-				     gps.alt,
-				     (uint16_t)(gps.eph_m * 1e2f), // from m to cm
-				     (uint16_t)(gps.epv_m * 1e2f), // from m to cm
-				     (uint16_t)(gps.vel_m_s * 1e2f), // from m/s to cm/s
-				     (uint16_t)(gps.cog_rad * M_RAD_TO_DEG_F * 1e2f), // from rad to deg * 100
-				     gps.satellites_visible);
-
-	if (gps.satellite_info_available && (gps_counter % 4 == 0)) {
-		mavlink_msg_gps_status_send(MAVLINK_COMM_0,
-					    gps.satellites_visible,
-					    gps.satellite_prn,
-					    gps.satellite_used,
-					    gps.satellite_elevation,
-					    gps.satellite_azimuth,
-					    gps.satellite_snr);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (mavlink_stream_permit(ch, MAVLINK_STREAM_GPS_RAW_INT))
+			mavlink_msg_gps_raw_int_send(ch,
+						     gps.timestamp_position,
+						     gps.fix_type,
+						     gps.lat,
+						     gps.lon,
+						     gps.alt,
+						     (uint16_t)(gps.eph_m * 1e2f), // from m to cm
+						     (uint16_t)(gps.epv_m * 1e2f), // from m to cm
+						     (uint16_t)(gps.vel_m_s * 1e2f), // from m/s to cm/s
+						     (uint16_t)(gps.cog_rad * M_RAD_TO_DEG_F * 1e2f), // from rad to deg * 100
+						     gps.satellites_visible);
+	}
+
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gps.satellite_info_available && mavlink_stream_permit(ch, MAVLINK_STREAM_GPS_STATUS)) {
+			mavlink_msg_gps_status_send(ch,
+						    gps.satellites_visible,
+						    gps.satellite_prn,
+						    gps.satellite_used,
+						    gps.satellite_elevation,
+						    gps.satellite_azimuth,
+						    gps.satellite_snr);
+		}
 	}
 
 	gps_counter++;
@@ -270,13 +280,14 @@ l_vehicle_status(const struct listener *l)
 	uint8_t mavlink_mode = 0;
 	get_mavlink_mode_and_state(&mavlink_state, &mavlink_mode);
 
-	/* send heartbeat */
-	mavlink_msg_heartbeat_send(chan,
-				   mavlink_system.type,
-				   MAV_AUTOPILOT_PX4,
-				   mavlink_mode,
-				   v_status.state_machine,
-				   mavlink_state);
+	/* send heartbeat on every link */
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++)
+		mavlink_msg_heartbeat_send(ch,
+					   mavlink_system.type,
+					   MAV_AUTOPILOT_PX4,
+					   mavlink_mode,
+					   v_status.state_machine,
+					   mavlink_state);
 }
 
 void
@@ -293,20 +304,21 @@ l_input_rc(const struct listener *l)
 	/* copy rc channels into local buffer */
 	orb_copy(ORB_ID(input_rc), mavlink_subs.input_rc_sub, &rc_raw);
 
-	if (gcs_link)
-		/* Channels are sent in MAVLink main loop at a fixed interval */
-		mavlink_msg_rc_channels_raw_send(chan,
-						 rc_raw.timestamp / 1000,
-						 0,
-						 (rc_raw.channel_count > 0) ? rc_raw.values[0] : UINT16_MAX,
-						 (rc_raw.channel_count > 1) ? rc_raw.values[1] : UINT16_MAX,
-						 (rc_raw.channel_count > 2) ? rc_raw.values[2] : UINT16_MAX,
-						 (rc_raw.channel_count > 3) ? rc_raw.values[3] : UINT16_MAX,
-						 (rc_raw.channel_count > 4) ? rc_raw.values[4] : UINT16_MAX,
-						 (rc_raw.channel_count > 5) ? rc_raw.values[5] : UINT16_MAX,
-						 (rc_raw.channel_count > 6) ? rc_raw.values[6] : UINT16_MAX,
-						 (rc_raw.channel_count > 7) ? rc_raw.values[7] : UINT16_MAX,
-						 255);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_RC_CHANNELS_RAW))
+			mavlink_msg_rc_channels_raw_send(ch,
+							 rc_raw.timestamp / 1000,
+							 0,
+							 (rc_raw.channel_count > 0) ? rc_raw.values[0] : UINT16_MAX,
+							 (rc_raw.channel_count > 1) ? rc_raw.values[1] : UINT16_MAX,
+							 (rc_raw.channel_count > 2) ? rc_raw.values[2] : UINT16_MAX,
+							 (rc_raw.channel_count > 3) ? rc_raw.values[3] : UINT16_MAX,
+							 (rc_raw.channel_count > 4) ? rc_raw.values[4] : UINT16_MAX,
+							 (rc_raw.channel_count > 5) ? rc_raw.values[5] : UINT16_MAX,
+							 (rc_raw.channel_count > 6) ? rc_raw.values[6] : UINT16_MAX,
+							 (rc_raw.channel_count > 7) ? rc_raw.values[7] : UINT16_MAX,
+							 255);
+	}
 }
 
 void
@@ -327,16 +339,19 @@ l_global_position(const struct listener *l)
 	/* heading in degrees * 10, from 0 to 36.000) */
 	uint16_t hdg = (global_pos.hdg / M_PI_F) * (180.0f * 10.0f) + (180.0f * 10.0f);
 
-	mavlink_msg_global_position_int_send(MAVLINK_COMM_0,
-					     timestamp / 1000,
-					     lat,
-					     lon,
-					     alt,
-					     relative_alt,
-					     vx,
-					     vy,
-					     vz,
-					     hdg);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (mavlink_stream_permit(ch, MAVLINK_STREAM_GLOBAL_POSITION_INT))
+			mavlink_msg_global_position_int_send(ch,
+							     timestamp / 1000,
+							     lat,
+							     lon,
+							     alt,
+							     relative_alt,
+							     vx,
+							     vy,
+							     vz,
+							     hdg);
+	}
 }
 
 void
@@ -345,15 +360,17 @@ l_local_position(const struct listener *l)
 	/* copy local position data into local buffer */
 	orb_copy(ORB_ID(vehicle_local_position), mavlink_subs.local_pos_sub, &local_pos);
 
-	if (gcs_link)
-		mavlink_msg_local_position_ned_send(MAVLINK_COMM_0,
-						    local_pos.timestamp / 1000,
-						    local_pos.x,
-						    local_pos.y,
-						    local_pos.z,
-						    local_pos.vx,
-						    local_pos.vy,
-						    local_pos.vz);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_LOCAL_POSITION_NED))
+			mavlink_msg_local_position_ned_send(ch,
+							    local_pos.timestamp / 1000,
+							    local_pos.x,
+							    local_pos.y,
+							    local_pos.z,
+							    local_pos.vx,
+							    local_pos.vy,
+							    local_pos.vz);
+	}
 }
 
 void
@@ -369,13 +386,15 @@ l_global_position_setpoint(const struct listener *l)
 	if (global_sp.altitude_is_relative)
 		coordinate_frame = MAV_FRAME_GLOBAL_RELATIVE_ALT;
 
-	if (gcs_link)
-		mavlink_msg_global_position_setpoint_int_send(MAVLINK_COMM_0,
-				coordinate_frame,
-				global_sp.lat,
-				global_sp.lon,
-				global_sp.altitude,
-				global_sp.yaw);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_GLOBAL_POSITION_SETPOINT))
+			mavlink_msg_global_position_setpoint_int_send(ch,
+					coordinate_frame,
+					global_sp.lat,
+					global_sp.lon,
+					global_sp.altitude,
+					global_sp.yaw);
+	}
 }
 
 void
@@ -386,13 +405,15 @@ l_local_position_setpoint(const struct listener *l)
 	/* copy local position data into local buffer */
 	orb_copy(ORB_ID(vehicle_local_position_setpoint), mavlink_subs.spl_sub, &local_sp);
 
-	if (gcs_link)
-		mavlink_msg_local_position_setpoint_send(MAVLINK_COMM_0,
-				MAV_FRAME_LOCAL_NED,
-				local_sp.x,
-				local_sp.y,
-				local_sp.z,
-				local_sp.yaw);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_LOCAL_POSITION_SETPOINT))
+			mavlink_msg_local_position_setpoint_send(ch,
+					MAV_FRAME_LOCAL_NED,
+					local_sp.x,
+					local_sp.y,
+					local_sp.z,
+					local_sp.yaw);
+	}
 }
 
 void
@@ -403,13 +424,15 @@ l_attitude_setpoint(const struct listener *l)
 	/* copy local position data into local buffer */
 	orb_copy(ORB_ID(vehicle_attitude_setpoint), mavlink_subs.spa_sub, &att_sp);
 
-	if (gcs_link)
-		mavlink_msg_roll_pitch_yaw_thrust_setpoint_send(MAVLINK_COMM_0,
-				att_sp.timestamp / 1000,
-				att_sp.roll_body,
-				att_sp.pitch_body,
-				att_sp.yaw_body,
-				att_sp.thrust);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_ATTITUDE_SETPOINT))
+			mavlink_msg_roll_pitch_yaw_thrust_setpoint_send(ch,
+					att_sp.timestamp / 1000,
+					att_sp.roll_body,
+					att_sp.pitch_body,
+					att_sp.yaw_body,
+					att_sp.thrust);
+	}
 }
 
 void
@@ -420,13 +443,15 @@ l_vehicle_rates_setpoint(const struct listener *l)
 	/* copy local position data into local buffer */
 	orb_copy(ORB_ID(vehicle_rates_setpoint), mavlink_subs.rates_setpoint_sub, &rates_sp);
 
-	if (gcs_link)
-		mavlink_msg_roll_pitch_yaw_rates_thrust_setpoint_send(MAVLINK_COMM_0,
-				rates_sp.timestamp / 1000,
-				rates_sp.roll,
-				rates_sp.pitch,
-				rates_sp.yaw,
-				rates_sp.thrust);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_RATES_SETPOINT))
+			mavlink_msg_roll_pitch_yaw_rates_thrust_setpoint_send(ch,
+					rates_sp.timestamp / 1000,
+					rates_sp.roll,
+					rates_sp.pitch,
+					rates_sp.yaw,
+					rates_sp.thrust);
+	}
 }
 
 void
@@ -445,84 +470,89 @@ l_actuator_outputs(const struct listener *l)
 	orb_copy(ids[l->arg], *l->subp, &act_outputs);
 
 	if (gcs_link) {
-		mavlink_msg_servo_output_raw_send(MAVLINK_COMM_0, last_sensor_timestamp / 1000,
-						  l->arg /* port number */,
-						  act_outputs.output[0],
-						  act_outputs.output[1],
-						  act_outputs.output[2],
-						  act_outputs.output[3],
-						  act_outputs.output[4],
-						  act_outputs.output[5],
-						  act_outputs.output[6],
-						  act_outputs.output[7]);
+		for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+			if (mavlink_stream_permit(ch, MAVLINK_STREAM_SERVO_OUTPUT_RAW_0 + l->arg))
+				mavlink_msg_servo_output_raw_send(ch, last_sensor_timestamp / 1000,
+								  l->arg /* port number */,
+								  act_outputs.output[0],
+								  act_outputs.output[1],
+								  act_outputs.output[2],
+								  act_outputs.output[3],
+								  act_outputs.output[4],
+								  act_outputs.output[5],
+								  act_outputs.output[6],
+								  act_outputs.output[7]);
+		}
 
 		/* only send in HIL mode */
-		if (mavlink_hil_enabled && armed.armed) {
-
-			/* translate the current syste state to mavlink state and mode */
-			uint8_t mavlink_state = 0;
-			uint8_t mavlink_mode = 0;
-			get_mavlink_mode_and_state(&mavlink_state, &mavlink_mode);
-
-			/* HIL message as per MAVLink spec */
-
-			/* scale / assign outputs depending on system type */
-
-			if (mavlink_system.type == MAV_TYPE_QUADROTOR) {
-				mavlink_msg_hil_controls_send(chan,
-							      hrt_absolute_time(),
-							      ((act_outputs.output[0] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[1] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[2] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[3] - 900.0f) / 600.0f) / 2.0f,
-							      -1,
-							      -1,
-							      -1,
-							      -1,
-							      mavlink_mode,
-							      0);
-
-			} else if (mavlink_system.type == MAV_TYPE_HEXAROTOR) {
-				mavlink_msg_hil_controls_send(chan,
-							      hrt_absolute_time(),
-							      ((act_outputs.output[0] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[1] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[2] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[3] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[4] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[5] - 900.0f) / 600.0f) / 2.0f,
-							      -1,
-							      -1,
-							      mavlink_mode,
-							      0);
-
-			} else if (mavlink_system.type == MAV_TYPE_OCTOROTOR) {
-				mavlink_msg_hil_controls_send(chan,
-							      hrt_absolute_time(),
-							      ((act_outputs.output[0] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[1] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[2] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[3] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[4] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[5] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[6] - 900.0f) / 600.0f) / 2.0f,
-							      ((act_outputs.output[7] - 900.0f) / 600.0f) / 2.0f,
-							      mavlink_mode,
-							      0);
-
-			} else {
-				mavlink_msg_hil_controls_send(chan,
-							      hrt_absolute_time(),
-							      (act_outputs.output[0] - 1500.0f) / 500.0f,
-							      (act_outputs.output[1] - 1500.0f) / 500.0f,
-							      (act_outputs.output[2] - 1500.0f) / 500.0f,
-							      (act_outputs.output[3] - 1000.0f) / 1000.0f,
-							      (act_outputs.output[4] - 1500.0f) / 500.0f,
-							      (act_outputs.output[5] - 1500.0f) / 500.0f,
-							      (act_outputs.output[6] - 1500.0f) / 500.0f,
-							      (act_outputs.output[7] - 1500.0f) / 500.0f,
-							      mavlink_mode,
-							      0);
+		for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+			if (mavlink_hil_enabled && armed.armed && mavlink_stream_permit(ch, MAVLINK_STREAM_HIL_CONTROLS)) {
+
+				/* translate the current syste state to mavlink state and mode */
+				uint8_t mavlink_state = 0;
+				uint8_t mavlink_mode = 0;
+				get_mavlink_mode_and_state(&mavlink_state, &mavlink_mode);
+
+				/* HIL message as per MAVLink spec */
+
+				/* scale / assign outputs depending on system type */
+
+				if (mavlink_system.type == MAV_TYPE_QUADROTOR) {
+					mavlink_msg_hil_controls_send(ch,
+								      hrt_absolute_time(),
+								      ((act_outputs.output[0] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[1] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[2] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[3] - 900.0f) / 600.0f) / 2.0f,
+								      -1,
+								      -1,
+								      -1,
+								      -1,
+								      mavlink_mode,
+								      0);
+
+				} else if (mavlink_system.type == MAV_TYPE_HEXAROTOR) {
+					mavlink_msg_hil_controls_send(ch,
+								      hrt_absolute_time(),
+								      ((act_outputs.output[0] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[1] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[2] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[3] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[4] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[5] - 900.0f) / 600.0f) / 2.0f,
+								      -1,
+								      -1,
+								      mavlink_mode,
+								      0);
+
+				} else if (mavlink_system.type == MAV_TYPE_OCTOROTOR) {
+					mavlink_msg_hil_controls_send(ch,
+								      hrt_absolute_time(),
+								      ((act_outputs.output[0] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[1] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[2] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[3] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[4] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[5] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[6] - 900.0f) / 600.0f) / 2.0f,
+								      ((act_outputs.output[7] - 900.0f) / 600.0f) / 2.0f,
+								      mavlink_mode,
+								      0);
+
+				} else {
+					mavlink_msg_hil_controls_send(ch,
+								      hrt_absolute_time(),
+								      (act_outputs.output[0] - 1500.0f) / 500.0f,
+								      (act_outputs.output[1] - 1500.0f) / 500.0f,
+								      (act_outputs.output[2] - 1500.0f) / 500.0f,
+								      (act_outputs.output[3] - 1000.0f) / 1000.0f,
+								      (act_outputs.output[4] - 1500.0f) / 500.0f,
+								      (act_outputs.output[5] - 1500.0f) / 500.0f,
+								      (act_outputs.output[6] - 1500.0f) / 500.0f,
+								      (act_outputs.output[7] - 1500.0f) / 500.0f,
+								      mavlink_mode,
+								      0);
+				}
 			}
 		}
 	}
@@ -542,14 +572,16 @@ l_manual_control_setpoint(const struct listener *l)
 	/* copy manual control data into local buffer */
 	orb_copy(ORB_ID(manual_control_setpoint), mavlink_subs.man_control_sp_sub, &man_control);
 
-	if (gcs_link)
-		mavlink_msg_manual_control_send(MAVLINK_COMM_0,
-						mavlink_system.sysid,
-						man_control.roll * 1000,
-						man_control.pitch * 1000,
-						man_control.yaw * 1000,
-						man_control.throttle * 1000,
-						0);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_MANUAL_CONTROL))
+			mavlink_msg_manual_control_send(ch,
+							mavlink_system.sysid,
+							man_control.roll * 1000,
+							man_control.pitch * 1000,
+							man_control.yaw * 1000,
+							man_control.throttle * 1000,
+							0);
+	}
 }
 
 void
@@ -559,24 +591,26 @@ l_vehicle_attitude_controls(const struct listener *l)
 
 	orb_copy(ORB_ID_VEHICLE_ATTITUDE_CONTROLS_EFFECTIVE, mavlink_subs.actuators_sub, &actuators);
 
-	if (gcs_link) {
-		/* send, add spaces so that string buffer is at least 10 chars long */
-		mavlink_msg_named_value_float_send(MAVLINK_COMM_0,
-						   last_sensor_timestamp / 1000,
-						   "eff ctrl0    ",
-						   actuators.control_effective[0]);
-		mavlink_msg_named_value_float_send(MAVLINK_COMM_0,
-						   last_sensor_timestamp / 1000,
-						   "eff ctrl1    ",
-						   actuators.control_effective[1]);
-		mavlink_msg_named_value_float_send(MAVLINK_COMM_0,
-						   last_sensor_timestamp / 1000,
-						   "eff ctrl2     ",
-						   actuators.control_effective[2]);
-		mavlink_msg_named_value_float_send(MAVLINK_COMM_0,
-						   last_sensor_timestamp / 1000,
-						   "eff ctrl3     ",
-						   actuators.control_effective[3]);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (gcs_link && mavlink_stream_permit(ch, MAVLINK_STREAM_CONTROLS_EFFECTIVE)) {
+			/* send, add spaces so that string buffer is at least 10 chars long */
+			mavlink_msg_named_value_float_send(ch,
+							   last_sensor_timestamp / 1000,
+							   "eff ctrl0    ",
+							   actuators.control_effective[0]);
+			mavlink_msg_named_value_float_send(ch,
+							   last_sensor_timestamp / 1000,
+							   "eff ctrl1    ",
+							   actuators.control_effective[1]);
+			mavlink_msg_named_value_float_send(ch,
+							   last_sensor_timestamp / 1000,
+							   "eff ctrl2     ",
+							   actuators.control_effective[2]);
+			mavlink_msg_named_value_float_send(ch,
+							   last_sensor_timestamp / 1000,
+							   "eff ctrl3     ",
+							   actuators.control_effective[3]);
+		}
 	}
 }
 
@@ -590,10 +624,13 @@ l_debug_key_value(const struct listener *l)
 	/* Enforce null termination */
 	debug.key[sizeof(debug.key) - 1] = '\0';
 
-	mavlink_msg_named_value_float_send(MAVLINK_COMM_0,
-					   last_sensor_timestamp / 1000,
-					   debug.key,
-					   debug.value);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (mavlink_stream_permit(ch, MAVLINK_STREAM_DEBUG))
+			mavlink_msg_named_value_float_send(ch,
+							   last_sensor_timestamp / 1000,
+							   debug.key,
+							   debug.value);
+	}
 }
 
 void
@@ -603,8 +640,11 @@ l_optical_flow(const struct listener *l)
 
 	orb_copy(ORB_ID(optical_flow), mavlink_subs.optical_flow, &flow);
 
-	mavlink_msg_optical_flow_send(MAVLINK_COMM_0, flow.timestamp, flow.sensor_id, flow.flow_raw_x, flow.flow_raw_y,
-				      flow.flow_comp_x_m, flow.flow_comp_y_m, flow.quality, flow.ground_distance_m);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (mavlink_stream_permit(ch, MAVLINK_STREAM_OPTICAL_FLOW))
+			mavlink_msg_optical_flow_send(ch, flow.timestamp, flow.sensor_id, flow.flow_raw_x, flow.flow_raw_y,
+						      flow.flow_comp_x_m, flow.flow_comp_y_m, flow.quality, flow.ground_distance_m);
+	}
 }
 
 void
@@ -614,7 +654,10 @@ l_home(const struct listener *l)
 
 	orb_copy(ORB_ID(home_position), mavlink_subs.home_sub, &home);
 
-	mavlink_msg_gps_global_origin_send(MAVLINK_COMM_0, home.lat, home.lon, home.alt);
+	for (unsigned ch = 0; ch < mavlink_link_count; ch++) {
+		if (mavlink_stream_permit(ch, MAVLINK_STREAM_GPS_GLOBAL_ORIGIN))
+			mavlink_msg_gps_global_origin_send(ch, home.lat, home.lon, home.alt);
+	}
 }
 
 static void *
@@ -650,10 +693,12 @@ uorb_receive_thread(void *arg)
 
 		/* handle the poll result */
 		if (poll_ret == 0) {
-			mavlink_missionlib_send_gcs_string("[mavlink] No telemetry data for 1 s");
+			for (unsigned ch = 0; ch < mavlink_link_count; ch++)
+				mavlink_missionlib_send_gcs_string(ch, "[mavlink] No telemetry data for 1 s");
 
 		} else if (poll_ret < 0) {
-			mavlink_missionlib_send_gcs_string("[mavlink] ERROR reading uORB data");
+			for (unsigned ch = 0; ch < mavlink_link_count; ch++)
+				mavlink_missionlib_send_gcs_string(ch, "[mavlink] ERROR reading uORB data");
 
 		} else {
 
@@ -39,8 +39,34 @@
 
 #pragma once
 
-/** MAVLink communications channel */
-extern uint8_t chan;
+#include <pthread.h>
+#include <termios.h>
+
+/** maximum number of simultaneous links, one MAVLink channel each */
+#define MAVLINK_LINKS_MAX	3
+
+/**
+ * A MAVLink link.
+ *
+ * The link index is its MAVLink channel. All links share the uORB
+ * subscriptions; each has its own receiver, transmit queue and stream
+ * table.
+ */
+struct mavlink_link {
+	const char	*device;
+	int		fd;
+	unsigned	baudrate;
+	bool		is_usb;
+	bool		onboard;		/**< companion link, heartbeat and status only */
+	bool		forward;		/**< forward received messages to other forwarding links */
+	struct termios	uart_config_original;
+	pthread_t	receive_thread;
+	pthread_t	tx_thread;
+};
+
+/** Active links */
+extern struct mavlink_link mavlink_links[MAVLINK_LINKS_MAX];
+extern unsigned mavlink_link_count;
 
 /** Shutdown marker */
 extern volatile bool thread_should_exit;
@@ -46,6 +46,7 @@
 #include <stdio.h>
 
 #include "missionlib.h"
+#include "mission_store.h"
 #include "waypoints.h"
 #include "util.h"
 
@@ -61,16 +62,17 @@ bool verbose = false;
 
 uint8_t mavlink_wpm_comp_id = MAV_COMP_ID_MISSIONPLANNER;
 
+static void mavlink_wpm_set_active(mavlink_channel_t chan, uint16_t seq);
+
 void mavlink_wpm_init(mavlink_wpm_storage *state)
 {
-	// Set all waypoints to zero
-
-	// Set count to zero
-	state->size = 0;
-	state->max_size = MAVLINK_WPM_MAX_WP_COUNT;
+	// Restore the mission of the last run
+	state->size = mission_store_init();
+	state->max_size = mission_store_capacity();
 	state->current_state = MAVLINK_WPM_STATE_IDLE;
 	state->current_partner_sysid = 0;
 	state->current_partner_compid = 0;
+	state->current_partner_chan = MAVLINK_COMM_0;
 	state->timestamp_lastaction = 0;
 	state->timestamp_last_send_setpoint = 0;
 	state->timeout = MAVLINK_WPM_PROTOCOL_TIMEOUT_DEFAULT;
@@ -82,12 +84,16 @@ void mavlink_wpm_init(mavlink_wpm_storage *state)
 	state->timestamp_lastoutside_orbit = 0;///< timestamp when the MAV was last outside the orbit or had the wrong yaw value
 	state->timestamp_firstinside_orbit = 0;///< timestamp when the MAV was the first time after a waypoint change inside the orbit and had the correct yaw value
 
+	// Continue with the waypoint that was active before the reset
+	if (mission_store_current() >= 0) {
+		mavlink_wpm_set_active(state->current_partner_chan, mission_store_current());
+	}
 }
 
 /*
  *  @brief Sends an waypoint ack message
  */
-void mavlink_wpm_send_waypoint_ack(uint8_t sysid, uint8_t compid, uint8_t type)
+void mavlink_wpm_send_waypoint_ack(mavlink_channel_t chan, uint8_t sysid, uint8_t compid, uint8_t type)
 {
 	mavlink_message_t msg;
 	mavlink_mission_ack_t wpa;
@@ -97,19 +103,19 @@ void mavlink_wpm_send_waypoint_ack(uint8_t sysid, uint8_t compid, uint8_t type)
 	wpa.type = type;
 
 	mavlink_msg_mission_ack_encode(mavlink_system.sysid, mavlink_wpm_comp_id, &msg, &wpa);
-	mavlink_missionlib_send_message(&msg);
+	mavlink_missionlib_send_message(chan, &msg);
 
 	// FIXME TIMING usleep(paramClient->getParamValue("PROTOCOLDELAY"));
 
 	if (MAVLINK_WPM_TEXT_FEEDBACK) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-		mavlink_missionlib_send_gcs_string("Sent waypoint ACK");
+		mavlink_missionlib_send_gcs_string(chan, "Sent waypoint ACK");
 #else
 
 		if (MAVLINK_WPM_VERBOSE) printf("Sent waypoint ack (%u) to ID %u\n", wpa.type, wpa.target_system);
 
 #endif
-		mavlink_missionlib_send_gcs_string("Sent waypoint ACK");
+		mavlink_missionlib_send_gcs_string(chan, "Sent waypoint ACK");
 	}
 }
 
@@ -122,25 +128,23 @@ void mavlink_wpm_send_waypoint_ack(uint8_t sysid, uint8_t compid, uint8_t type)
  *
  *  @param seq The waypoint sequence number the MAV should fly to.
  */
-void mavlink_wpm_send_waypoint_current(uint16_t seq)
+void mavlink_wpm_send_waypoint_current(mavlink_channel_t chan, uint16_t seq)
 {
 	if (seq < wpm->size) {
-		mavlink_mission_item_t *cur = &(wpm->waypoints[seq]);
-
 		mavlink_message_t msg;
 		mavlink_mission_current_t wpc;
 
-		wpc.seq = cur->seq;
+		wpc.seq = seq;
 
 		mavlink_msg_mission_current_encode(mavlink_system.sysid, mavlink_wpm_comp_id, &msg, &wpc);
-		mavlink_missionlib_send_message(&msg);
+		mavlink_missionlib_send_message(chan, &msg);
 
 		// FIXME TIMING usleep(paramClient->getParamValue("PROTOCOLDELAY"));
 
-		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("Set current waypoint\n"); //// printf("Broadcasted new current waypoint %u\n", wpc.seq);
+		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "Set current waypoint\n"); //// printf("Broadcasted new current waypoint %u\n", wpc.seq);
 
 	} else {
-		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("ERROR: wp index out of bounds\n");
+		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "ERROR: wp index out of bounds\n");
 	}
 }
 
@@ -152,22 +156,23 @@ void mavlink_wpm_send_waypoint_current(uint16_t seq)
  *
  *  @param seq The waypoint sequence number the MAV should fly to.
  */
-void mavlink_wpm_send_setpoint(uint16_t seq)
+void mavlink_wpm_send_setpoint(mavlink_channel_t chan, uint16_t seq)
 {
-	if (seq < wpm->size) {
-		mavlink_mission_item_t *cur = &(wpm->waypoints[seq]);
-		mavlink_missionlib_current_waypoint_changed(cur->seq, cur->param1,
-				cur->param2, cur->param3, cur->param4, cur->x,
-				cur->y, cur->z, cur->frame, cur->command);
+	mavlink_mission_item_t cur;
+
+	if (seq < wpm->size && mission_store_read(seq, &cur) == OK) {
+		mavlink_missionlib_current_waypoint_changed(chan, cur.seq, cur.param1,
+				cur.param2, cur.param3, cur.param4, cur.x,
+				cur.y, cur.z, cur.frame, cur.command);
 
 		wpm->timestamp_last_send_setpoint = mavlink_missionlib_get_system_timestamp();
 
 	} else {
-		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("ERROR: Waypoint index out of bounds\n"); //// if (verbose) // printf("ERROR: index out of bounds\n");
+		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "ERROR: Waypoint index out of bounds\n"); //// if (verbose) // printf("ERROR: index out of bounds\n");
 	}
 }
 
-void mavlink_wpm_send_waypoint_count(uint8_t sysid, uint8_t compid, uint16_t count)
+void mavlink_wpm_send_waypoint_count(mavlink_channel_t chan, uint8_t sysid, uint8_t compid, uint16_t count)
 {
 	mavlink_message_t msg;
 	mavlink_mission_count_t wpc;
@@ -177,33 +182,35 @@ void mavlink_wpm_send_waypoint_count(uint8_t sysid, uint8_t compid, uint16_t cou
 	wpc.count = count;
 
 	mavlink_msg_mission_count_encode(mavlink_system.sysid, mavlink_wpm_comp_id, &msg, &wpc);
-	mavlink_missionlib_send_message(&msg);
+	mavlink_missionlib_send_message(chan, &msg);
 
-	if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("Sent waypoint count"); //// if (verbose) // printf("Sent waypoint count (%u) to ID %u\n", wpc.count, wpc.target_system);
+	if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "Sent waypoint count"); //// if (verbose) // printf("Sent waypoint count (%u) to ID %u\n", wpc.count, wpc.target_system);
 
 	// FIXME TIMING usleep(paramClient->getParamValue("PROTOCOLDELAY"));
 }
 
-void mavlink_wpm_send_waypoint(uint8_t sysid, uint8_t compid, uint16_t seq)
+void mavlink_wpm_send_waypoint(mavlink_channel_t chan, uint8_t sysid, uint8_t compid, uint16_t seq)
 {
-	if (seq < wpm->size) {
+	mavlink_mission_item_t wp;
+
+	if (seq < wpm->size && mission_store_read(seq, &wp) == OK) {
 		mavlink_message_t msg;
-		mavlink_mission_item_t *wp = &(wpm->waypoints[seq]);
-		wp->target_system = wpm->current_partner_sysid;
-		wp->target_component = wpm->current_partner_compid;
-		mavlink_msg_mission_item_encode(mavlink_system.sysid, mavlink_wpm_comp_id, &msg, wp);
-		mavlink_missionlib_send_message(&msg);
+		wp.target_system = wpm->current_partner_sysid;
+		wp.target_component = wpm->current_partner_compid;
+		wp.current = (seq == wpm->current_active_wp_id);
+		mavlink_msg_mission_item_encode(mavlink_system.sysid, mavlink_wpm_comp_id, &msg, &wp);
+		mavlink_missionlib_send_message(chan, &msg);
 
-		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("Sent waypoint"); //// if (verbose) // printf("Sent waypoint %u to ID %u\n", wp->seq, wp->target_system);
+		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "Sent waypoint"); //// if (verbose) // printf("Sent waypoint %u to ID %u\n", wp.seq, wp.target_system);
 
 		// FIXME TIMING usleep(paramClient->getParamValue("PROTOCOLDELAY"));
 
 	} else {
-		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("ERROR: Waypoint index out of bounds\n");
+		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "ERROR: Waypoint index out of bounds\n");
 	}
 }
 
-void mavlink_wpm_send_waypoint_request(uint8_t sysid, uint8_t compid, uint16_t seq)
+void mavlink_wpm_send_waypoint_request(mavlink_channel_t chan, uint8_t sysid, uint8_t compid, uint16_t seq)
 {
 	if (seq < wpm->max_size) {
 		mavlink_message_t msg;
@@ -212,14 +219,14 @@ void mavlink_wpm_send_waypoint_request(uint8_t sysid, uint8_t compid, uint16_t s
 		wpr.target_component = wpm->current_partner_compid;
 		wpr.seq = seq;
 		mavlink_msg_mission_request_encode(mavlink_system.sysid, mavlink_wpm_comp_id, &msg, &wpr);
-		mavlink_missionlib_send_message(&msg);
+		mavlink_missionlib_send_message(chan, &msg);
 
-		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("Sent waypoint request"); //// if (verbose) // printf("Sent waypoint request %u to ID %u\n", wpr.seq, wpr.target_system);
+		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "Sent waypoint request"); //// if (verbose) // printf("Sent waypoint request %u to ID %u\n", wpr.seq, wpr.target_system);
 
 		// FIXME TIMING usleep(paramClient->getParamValue("PROTOCOLDELAY"));
 
 	} else {
-		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("ERROR: Waypoint index exceeds list capacity\n");
+		if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "ERROR: Waypoint index exceeds list capacity\n");
 	}
 }
 
@@ -230,7 +237,7 @@ void mavlink_wpm_send_waypoint_request(uint8_t sysid, uint8_t compid, uint16_t s
  *
  *  @param seq The waypoint sequence number the MAV has reached.
  */
-void mavlink_wpm_send_waypoint_reached(uint16_t seq)
+void mavlink_wpm_send_waypoint_reached(mavlink_channel_t chan, uint16_t seq)
 {
 	mavlink_message_t msg;
 	mavlink_mission_item_reached_t wp_reached;
@@ -238,9 +245,9 @@ void mavlink_wpm_send_waypoint_reached(uint16_t seq)
 	wp_reached.seq = seq;
 
 	mavlink_msg_mission_item_reached_encode(mavlink_system.sysid, mavlink_wpm_comp_id, &msg, &wp_reached);
-	mavlink_missionlib_send_message(&msg);
+	mavlink_missionlib_send_message(chan, &msg);
 
-	if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string("Sent waypoint reached message"); //// if (verbose) // printf("Sent waypoint %u reached message\n", wp_reached.seq);
+	if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "Sent waypoint reached message"); //// if (verbose) // printf("Sent waypoint %u reached message\n", wp_reached.seq);
 
 	// FIXME TIMING usleep(paramClient->getParamValue("PROTOCOLDELAY"));
 }
@@ -287,65 +294,189 @@ void mavlink_wpm_send_waypoint_reached(uint16_t seq)
 //}
 
 /*
- * Calculate distance in global frame.
+ *  @brief Precomputes the leg towards a waypoint
  *
- * The distance calculation is based on the WGS84 geoid (GPS)
+ *  @param prev The waypoint the leg starts at, NULL if there is none.
+ *  @param wp The waypoint the leg ends at.
  */
-float mavlink_wpm_distance_to_point_global_wgs84(uint16_t seq, float lat, float lon, float alt)
+static void mavlink_wpm_leg_init(struct mavlink_wpm_leg *leg, const mavlink_mission_item_t *prev, const mavlink_mission_item_t *wp)
 {
-	//TODO: implement for z once altidude contoller is implemented
+	float prev_n = 0.0f;
+	float prev_e = 0.0f;
+	bool has_prev = false;
 
-	static uint16_t counter;
+	memset(leg, 0, sizeof(*leg));
+	leg->frame = wp->frame;
 
-//	if(counter % 10 == 0) printf(" x = %.10f, y = %.10f\n", x, y);
-	if (seq < wpm->size) {
-		mavlink_mission_item_t *cur = &(wpm->waypoints[seq]);
+	if (wp->frame == (int)MAV_FRAME_GLOBAL || wp->frame == (int)MAV_FRAME_GLOBAL_RELATIVE_ALT) {
+		map_projection_ref_init(&leg->ref, wp->x, wp->y);
 
-		double current_x_rad = cur->x / 180.0 * M_PI;
-		double current_y_rad = cur->y / 180.0 * M_PI;
-		double x_rad = lat / 180.0 * M_PI;
-		double y_rad = lon / 180.0 * M_PI;
+		if (prev != NULL && (prev->frame == (int)MAV_FRAME_GLOBAL || prev->frame == (int)MAV_FRAME_GLOBAL_RELATIVE_ALT)) {
+			map_projection_ref_project(&leg->ref, prev->x, prev->y, &prev_n, &prev_e);
+			has_prev = true;
+		}
 
-		double d_lat = x_rad - current_x_rad;
-		double d_lon = y_rad - current_y_rad;
+	} else if (wp->frame == (int)MAV_FRAME_LOCAL_ENU || wp->frame == (int)MAV_FRAME_LOCAL_NED) {
+		leg->x = wp->x;
+		leg->y = wp->y;
+		leg->z = wp->z;
 
-		double a = sin(d_lat / 2.0) * sin(d_lat / 2.0) + sin(d_lon / 2.0) * sin(d_lon / 2.0f) * cos(current_x_rad) * cos(x_rad);
-		double c = 2 * atan2(sqrt(a), sqrt(1 - a));
+		if (prev != NULL && prev->frame == wp->frame) {
+			prev_n = prev->x - wp->x;
+			prev_e = prev->y - wp->y;
+			has_prev = true;
+		}
+	}
 
-		const double radius_earth = 6371000.0;
+	if (has_prev) {
+		leg->length = sqrtf(prev_n * prev_n + prev_e * prev_e);
 
-		return radius_earth * c;
+		if (leg->length > 0.0f) {
+			leg->dir_n = -prev_n / leg->length;
+			leg->dir_e = -prev_e / leg->length;
+			leg->bearing = atan2f(leg->dir_e, leg->dir_n);
+		}
+	}
+}
+
+/*
+ *  @brief Updates the position relative to the leg
+ *
+ *  Global waypoints are compared in the horizontal plane only, local
+ *  waypoints in all three axes.
+ *
+ *  @return The distance to the waypoint, -1 if the frame is not supported.
+ */
+static float mavlink_wpm_leg_update(struct mavlink_wpm_leg *leg, const struct vehicle_global_position_s *global_pos, const struct vehicle_local_position_s *local_pos)
+{
+	float n, e;
+	float d = 0.0f;
+
+	if (leg->frame == (int)MAV_FRAME_GLOBAL || leg->frame == (int)MAV_FRAME_GLOBAL_RELATIVE_ALT) {
+		map_projection_ref_project(&leg->ref, global_pos->lat * 1e-7, global_pos->lon * 1e-7, &n, &e);
+
+	} else if (leg->frame == (int)MAV_FRAME_LOCAL_ENU || leg->frame == (int)MAV_FRAME_LOCAL_NED) {
+		n = local_pos->x - leg->x;
+		e = local_pos->y - leg->y;
+		d = local_pos->z - leg->z;
 
 	} else {
+		/* MAV_FRAME_MISSION: check if conditions of mission item are satisfied */
+		// XXX TODO
 		return -1.0f;
 	}
 
-	counter++;
+	leg->distance = sqrtf(n * n + e * e + d * d);
+	leg->along_track = -(n * leg->dir_n + e * leg->dir_e);
+	leg->cross_track = e * leg->dir_n - n * leg->dir_e;
 
+	return leg->distance;
 }
 
 /*
- * Calculate distance in local frame (NED)
+ *  @brief Makes a waypoint the one the MAV is heading towards
+ *
+ *  Loads the waypoint from the mission store, precomputes the leg from the
+ *  previous waypoint and directs the MAV to fly there.
+ *
+ *  @param seq The waypoint sequence number the MAV should fly to.
  */
-float mavlink_wpm_distance_to_point_local(uint16_t seq, float x, float y, float z)
+static void mavlink_wpm_set_active(mavlink_channel_t chan, uint16_t seq)
 {
-	if (seq < wpm->size) {
-		mavlink_mission_item_t *cur = &(wpm->waypoints[seq]);
+	mavlink_mission_item_t prev;
+	bool has_prev = (seq > 0 && mission_store_read(seq - 1, &prev) == OK);
+
+	wpm->yaw_reached = false;
+	wpm->pos_reached = false;
+	wpm->timestamp_firstinside_orbit = 0;
+
+	if (mission_store_read(seq, &wpm->active_wp) != OK) {
+		mavlink_missionlib_send_gcs_string(chan, "ERROR: Waypoint not readable");
+		wpm->current_active_wp_id = -1;
+		return;
+	}
+
+	wpm->current_active_wp_id = seq;
+	wpm->active_wp.current = true;
+	mavlink_wpm_leg_init(&wpm->leg, has_prev ? &prev : NULL, &wpm->active_wp);
+	mission_store_set_current(seq);
+
+	mavlink_wpm_send_waypoint_current(chan, seq);
+	mavlink_wpm_send_setpoint(chan, seq);
+}
+
+static void mavlink_wpm_clear_active(void)
+{
+	wpm->current_active_wp_id = -1;
+	wpm->yaw_reached = false;
+	wpm->pos_reached = false;
+	wpm->timestamp_firstinside_orbit = 0;
+	mission_store_set_current(-1);
+}
+
+/*
+ *  @brief Requests the waypoints of the upload window
+ *
+ *  Waypoints are requested up to MAVLINK_WPM_UPLOAD_WINDOW ahead of the
+ *  first one still missing, so the partner can send them back to back
+ *  instead of waiting for one request per waypoint.
+ *
+ *  @param retry Also request again the waypoints of the window that did not arrive.
+ */
+static void mavlink_wpm_request_window(mavlink_channel_t chan, uint64_t now, bool retry)
+{
+	uint16_t end = wpm->current_wp_id + MAVLINK_WPM_UPLOAD_WINDOW;
+
+	if (end > wpm->current_count) {
+		end = wpm->current_count;
+	}
+
+	if (retry) {
+		for (uint16_t seq = wpm->current_wp_id; seq < wpm->rcv_requested; seq++) {
+			if (!(wpm->rcv_window & (1UL << (seq - wpm->current_wp_id)))) {
+				mavlink_wpm_send_waypoint_request(chan, wpm->current_partner_sysid, wpm->current_partner_compid, seq);
+			}
+		}
+	}
+
+	while (wpm->rcv_requested < end) {
+		mavlink_wpm_send_waypoint_request(chan, wpm->current_partner_sysid, wpm->current_partner_compid, wpm->rcv_requested);
+		wpm->rcv_requested++;
+	}
+
+	wpm->timestamp_lastrequest = now;
+}
+
+/*
+ *  @brief Switches to the uploaded mission once all waypoints arrived
+ */
+static void mavlink_wpm_upload_complete(mavlink_channel_t chan)
+{
+	wpm->current_state = MAVLINK_WPM_STATE_IDLE;
 
-		float dx = (cur->x - x);
-		float dy = (cur->y - y);
-		float dz = (cur->z - z);
+	if (mission_store_commit(wpm->rcv_current_wp_id) != OK) {
+		mavlink_missionlib_send_gcs_string(chan, "ERROR: Mission not stored");
+		mavlink_wpm_send_waypoint_ack(chan, wpm->current_partner_sysid, wpm->current_partner_compid, MAV_MISSION_ERROR);
+		return;
+	}
+
+	mavlink_wpm_send_waypoint_ack(chan, wpm->current_partner_sysid, wpm->current_partner_compid, MAV_MISSION_ACCEPTED);
 
-		return sqrt(dx * dx + dy * dy + dz * dz);
+	wpm->size = wpm->current_count;
+
+	//get the new current waypoint
+	if (wpm->rcv_current_wp_id >= 0) {
+		mavlink_wpm_set_active(chan, wpm->rcv_current_wp_id);
 
 	} else {
-		return -1.0f;
+		mavlink_wpm_clear_active();
 	}
 }
 
 void check_waypoints_reached(uint64_t now, const struct vehicle_global_position_s *global_pos, struct vehicle_local_position_s *local_pos)
 {
 	static uint16_t counter;
+	mavlink_channel_t chan = wpm->current_partner_chan;
 
 	// Do not flood the precious wireless link with debug data
 	// if (wpm->size > 0 && counter % 10 == 0) {
@@ -353,25 +484,10 @@ void check_waypoints_reached(uint64_t now, const struct vehicle_global_position_
 	// }
 
 
-	if (wpm->current_active_wp_id < wpm->size) {
+	if (wpm->current_active_wp_id >= 0 && wpm->current_active_wp_id < wpm->size) {
 
-		float orbit = wpm->waypoints[wpm->current_active_wp_id].param2;
-		int coordinate_frame = wpm->waypoints[wpm->current_active_wp_id].frame;
-		float dist = -1.0f;
-
-		if (coordinate_frame == (int)MAV_FRAME_GLOBAL) {
-			dist = mavlink_wpm_distance_to_point_global_wgs84(wpm->current_active_wp_id, (float)global_pos->lat * 1e-7f, (float)global_pos->lon * 1e-7f, global_pos->alt);
-
-		} else if (coordinate_frame == (int)MAV_FRAME_GLOBAL_RELATIVE_ALT) {
-			dist = mavlink_wpm_distance_to_point_global_wgs84(wpm->current_active_wp_id, global_pos->lat, global_pos->lon, global_pos->relative_alt);
-
-		} else if (coordinate_frame == (int)MAV_FRAME_LOCAL_ENU || coordinate_frame == (int)MAV_FRAME_LOCAL_NED) {
-			dist = mavlink_wpm_distance_to_point_local(wpm->current_active_wp_id, local_pos->x, local_pos->y, local_pos->z);
-
-		} else if (coordinate_frame == (int)MAV_FRAME_MISSION) {
-			/* Check if conditions of mission item are satisfied */
-			// XXX TODO
-		}
+		float orbit = wpm->active_wp.param2;
+		float dist = mavlink_wpm_leg_update(&wpm->leg, global_pos, local_pos);
 
 		if (dist >= 0.f && dist <= orbit /*&& wpm->yaw_reached*/) { //TODO implement yaw
 			wpm->pos_reached = true;
@@ -389,13 +505,13 @@ void check_waypoints_reached(uint64_t now, const struct vehicle_global_position_
 
 	//check if the current waypoint was reached
 	if (wpm->pos_reached /*wpm->yaw_reached &&*/ && !wpm->idle) {
-		if (wpm->current_active_wp_id < wpm->size) {
-			mavlink_mission_item_t *cur_wp = &(wpm->waypoints[wpm->current_active_wp_id]);
+		if (wpm->current_active_wp_id >= 0 && wpm->current_active_wp_id < wpm->size) {
+			mavlink_mission_item_t *cur_wp = &(wpm->active_wp);
 
 			if (wpm->timestamp_firstinside_orbit == 0) {
 				// Announce that last waypoint was reached
 				printf("Reached waypoint %u for the first time \n", cur_wp->seq);
-				mavlink_wpm_send_waypoint_reached(cur_wp->seq);
+				mavlink_wpm_send_waypoint_reached(chan, cur_wp->seq);
 				wpm->timestamp_firstinside_orbit = now;
 			}
 
@@ -405,26 +521,21 @@ void check_waypoints_reached(uint64_t now, const struct vehicle_global_position_
 				printf("Reached waypoint %u long enough \n", cur_wp->seq);
 
 				if (cur_wp->autocontinue) {
-					cur_wp->current = 0;
+					uint16_t next = wpm->current_active_wp_id;
 
 					if (wpm->current_active_wp_id == wpm->size - 1 && wpm->size > 1) {
 						/* the last waypoint was reached, if auto continue is
 						 * activated restart the waypoint list from the beginning
 						 */
-						wpm->current_active_wp_id = 0;
+						next = 0;
 
 					} else {
 						if ((uint16_t)(wpm->current_active_wp_id + 1) < wpm->size)
-							wpm->current_active_wp_id++;
+							next++;
 					}
 
 					// Fly to next waypoint
-					wpm->timestamp_firstinside_orbit = 0;
-					mavlink_wpm_send_waypoint_current(wpm->current_active_wp_id);
-					mavlink_wpm_send_setpoint(wpm->current_active_wp_id);
-					wpm->waypoints[wpm->current_active_wp_id].current = true;
-					wpm->pos_reached = false;
-					wpm->yaw_reached = false;
+					mavlink_wpm_set_active(chan, next);
 					printf("Set new waypoint (%u)\n", wpm->current_active_wp_id);
 				}
 			}
@@ -440,11 +551,19 @@ void check_waypoints_reached(uint64_t now, const struct vehicle_global_position_
 
 int mavlink_waypoint_eventloop(uint64_t now, const struct vehicle_global_position_s *global_position, struct vehicle_local_position_s *local_position)
 {
+	mavlink_channel_t chan = wpm->current_partner_chan;
+
+	/* request the waypoints of the upload window that did not arrive */
+	if ((wpm->current_state == MAVLINK_WPM_STATE_GETLIST || wpm->current_state == MAVLINK_WPM_STATE_GETLIST_GETWPS) &&
+	    now - wpm->timestamp_lastrequest > MAVLINK_WPM_RETRY_DELAY_DEFAULT) {
+		mavlink_wpm_request_window(chan, now, true);
+	}
+
 	/* check for timed-out operations */
 	if (now - wpm->timestamp_lastaction > wpm->timeout && wpm->current_state != MAVLINK_WPM_STATE_IDLE) {
 
 #ifdef MAVLINK_WPM_NO_PRINTF
-		mavlink_missionlib_send_gcs_string("Operation timeout switching -> IDLE");
+		mavlink_missionlib_send_gcs_string(chan, "Operation timeout switching -> IDLE");
 #else
 
 		if (MAVLINK_WPM_VERBOSE) printf("Last operation (state=%u) timed out, changing state to MAVLINK_WPM_STATE_IDLE\n", wpm->current_state);
@@ -472,7 +591,7 @@ int mavlink_waypoint_eventloop(uint64_t now, const struct vehicle_global_positio
 }
 
 
-void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehicle_global_position_s *global_pos , struct vehicle_local_position_s *local_pos)
+void mavlink_wpm_message_handler(mavlink_channel_t chan, const mavlink_message_t *msg, const struct vehicle_global_position_s *global_pos , struct vehicle_local_position_s *local_pos)
 {
 	uint64_t now = mavlink_missionlib_get_system_timestamp();
 
@@ -597,7 +716,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 				if (wpm->current_state == MAVLINK_WPM_STATE_SENDLIST || wpm->current_state == MAVLINK_WPM_STATE_SENDLIST_SENDWPS) {
 					if (wpm->current_wp_id == wpm->size - 1) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("Got last WP ACK state -> IDLE");
+						mavlink_missionlib_send_gcs_string(chan, "Got last WP ACK state -> IDLE");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Received ACK after having sent last waypoint, going to state MAVLINK_WPM_STATE_IDLE\n");
@@ -610,7 +729,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 			} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-				mavlink_missionlib_send_gcs_string("REJ. WP CMD: curr partner id mismatch");
+				mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: curr partner id mismatch");
 #else
 
 				if (MAVLINK_WPM_VERBOSE) printf("IGNORED WAYPOINT COMMAND BECAUSE TARGET SYSTEM AND COMPONENT OR COMM PARTNER ID MISMATCH\n");
@@ -631,34 +750,18 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 				if (wpm->current_state == MAVLINK_WPM_STATE_IDLE) {
 					if (wpc.seq < wpm->size) {
 						// if (verbose) // printf("Received MAVLINK_MSG_ID_MISSION_ITEM_SET_CURRENT\n");
-						wpm->current_active_wp_id = wpc.seq;
-						uint32_t i;
-
-						for (i = 0; i < wpm->size; i++) {
-							if (i == wpm->current_active_wp_id) {
-								wpm->waypoints[i].current = true;
-
-							} else {
-								wpm->waypoints[i].current = false;
-							}
-						}
-
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("NEW WP SET");
+						mavlink_missionlib_send_gcs_string(chan, "NEW WP SET");
 #else
 
-						if (MAVLINK_WPM_VERBOSE) printf("New current waypoint %u\n", wpm->current_active_wp_id);
+						if (MAVLINK_WPM_VERBOSE) printf("New current waypoint %u\n", wpc.seq);
 
 #endif
-						wpm->yaw_reached = false;
-						wpm->pos_reached = false;
-						mavlink_wpm_send_waypoint_current(wpm->current_active_wp_id);
-						mavlink_wpm_send_setpoint(wpm->current_active_wp_id);
-						wpm->timestamp_firstinside_orbit = 0;
+						mavlink_wpm_set_active(chan, wpc.seq);
 
 					} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("IGN WP CURR CMD: Not in list");
+						mavlink_missionlib_send_gcs_string(chan, "IGN WP CURR CMD: Not in list");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_SET_CURRENT: Index out of bounds\n");
@@ -668,7 +771,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 				} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-					mavlink_missionlib_send_gcs_string("IGN WP CURR CMD: Busy");
+					mavlink_missionlib_send_gcs_string(chan, "IGN WP CURR CMD: Busy");
 #else
 
 					if (MAVLINK_WPM_VERBOSE) printf("IGNORED WAYPOINT COMMAND BECAUSE NOT IN IDLE STATE\n");
@@ -678,7 +781,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 			} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-				mavlink_missionlib_send_gcs_string("REJ. WP CMD: target id mismatch");
+				mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: target id mismatch");
 #else
 
 				if (MAVLINK_WPM_VERBOSE) printf("IGNORED WAYPOINT COMMAND BECAUSE TARGET SYSTEM AND COMPONENT OR COMM PARTNER ID MISMATCH\n");
@@ -704,13 +807,14 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 						wpm->current_wp_id = 0;
 						wpm->current_partner_sysid = msg->sysid;
 						wpm->current_partner_compid = msg->compid;
+						wpm->current_partner_chan = chan;
 
 					} else {
 						// if (verbose) // printf("Got MAVLINK_MSG_ID_MISSION_ITEM_REQUEST_LIST from %u but have no waypoints, staying in \n", msg->sysid);
 					}
 
 					wpm->current_count = wpm->size;
-					mavlink_wpm_send_waypoint_count(msg->sysid, msg->compid, wpm->current_count);
+					mavlink_wpm_send_waypoint_count(chan, msg->sysid, msg->compid, wpm->current_count);
 
 				} else {
 					// if (verbose) // printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_REQUEST_LIST because i'm doing something else already (state=%i).\n", wpm->current_state);
@@ -729,11 +833,11 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 			if (msg->sysid == wpm->current_partner_sysid && msg->compid == wpm->current_partner_compid && wpr.target_system == mavlink_system.sysid /*&& wpr.target_component == mavlink_wpm_comp_id*/) {
 				wpm->timestamp_lastaction = now;
 
-				//ensure that we are in the correct state and that the first request has id 0 and the following requests have either the last id (re-send last waypoint) or last_id+1 (next waypoint)
-				if ((wpm->current_state == MAVLINK_WPM_STATE_SENDLIST && wpr.seq == 0) || (wpm->current_state == MAVLINK_WPM_STATE_SENDLIST_SENDWPS && (wpr.seq == wpm->current_wp_id || wpr.seq == wpm->current_wp_id + 1) && wpr.seq < wpm->size)) {
+				//ensure that we are in the correct state and that the first request has id 0; after that any waypoint of the list may be requested, so the partner can pipeline its requests and re-request lost ones
+				if ((wpm->current_state == MAVLINK_WPM_STATE_SENDLIST && wpr.seq == 0) || (wpm->current_state == MAVLINK_WPM_STATE_SENDLIST_SENDWPS && wpr.seq < wpm->size)) {
 					if (wpm->current_state == MAVLINK_WPM_STATE_SENDLIST) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("GOT WP REQ, state -> SEND");
+						mavlink_missionlib_send_gcs_string(chan, "GOT WP REQ, state -> SEND");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Got MAVLINK_MSG_ID_MISSION_ITEM_REQUEST of waypoint %u from %u changing state to MAVLINK_WPM_STATE_SENDLIST_SENDWPS\n", wpr.seq, msg->sysid);
@@ -743,7 +847,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 					if (wpm->current_state == MAVLINK_WPM_STATE_SENDLIST_SENDWPS && wpr.seq == wpm->current_wp_id + 1) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("GOT 2nd WP REQ");
+						mavlink_missionlib_send_gcs_string(chan, "GOT 2nd WP REQ");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Got MAVLINK_MSG_ID_MISSION_ITEM_REQUEST of waypoint %u from %u staying in state MAVLINK_WPM_STATE_SENDLIST_SENDWPS\n", wpr.seq, msg->sysid);
@@ -753,7 +857,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 					if (wpm->current_state == MAVLINK_WPM_STATE_SENDLIST_SENDWPS && wpr.seq == wpm->current_wp_id) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("GOT 2nd WP REQ");
+						mavlink_missionlib_send_gcs_string(chan, "GOT 2nd WP REQ");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Got MAVLINK_MSG_ID_MISSION_ITEM_REQUEST of waypoint %u (again) from %u staying in state MAVLINK_WPM_STATE_SENDLIST_SENDWPS\n", wpr.seq, msg->sysid);
@@ -763,14 +867,14 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 					wpm->current_state = MAVLINK_WPM_STATE_SENDLIST_SENDWPS;
 					wpm->current_wp_id = wpr.seq;
-					mavlink_wpm_send_waypoint(wpm->current_partner_sysid, wpm->current_partner_compid, wpr.seq);
+					mavlink_wpm_send_waypoint(chan, wpm->current_partner_sysid, wpm->current_partner_compid, wpr.seq);
 
 				} else {
 					// if (verbose)
 					{
 						if (!(wpm->current_state == MAVLINK_WPM_STATE_SENDLIST || wpm->current_state == MAVLINK_WPM_STATE_SENDLIST_SENDWPS)) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-							mavlink_missionlib_send_gcs_string("REJ. WP CMD: Busy");
+							mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: Busy");
 #else
 
 							if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_REQUEST because i'm doing something else already (state=%i).\n", wpm->current_state);
@@ -781,7 +885,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 						} else if (wpm->current_state == MAVLINK_WPM_STATE_SENDLIST) {
 							if (wpr.seq != 0) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-								mavlink_missionlib_send_gcs_string("REJ. WP CMD: First id != 0");
+								mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: First id != 0");
 #else
 
 								if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_REQUEST because the first requested waypoint ID (%u) was not 0.\n", wpr.seq);
@@ -790,18 +894,9 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 							}
 
 						} else if (wpm->current_state == MAVLINK_WPM_STATE_SENDLIST_SENDWPS) {
-							if (wpr.seq != wpm->current_wp_id && wpr.seq != wpm->current_wp_id + 1) {
-#ifdef MAVLINK_WPM_NO_PRINTF
-								mavlink_missionlib_send_gcs_string("REJ. WP CMD: Req. WP was unexpected");
-#else
-
-								if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_REQUEST because the requested waypoint ID (%u) was not the expected (%u or %u).\n", wpr.seq, wpm->current_wp_id, wpm->current_wp_id + 1);
-
-#endif
-
-							} else if (wpr.seq >= wpm->size) {
+							if (wpr.seq >= wpm->size) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-								mavlink_missionlib_send_gcs_string("REJ. WP CMD: Req. WP not in list");
+								mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: Req. WP not in list");
 #else
 
 								if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_REQUEST because the requested waypoint ID (%u) was out of bounds.\n", wpr.seq);
@@ -811,7 +906,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 						} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-							mavlink_missionlib_send_gcs_string("REJ. WP CMD: ?");
+							mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: ?");
 #else
 
 							if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_REQUEST - FIXME: missed error description\n");
@@ -825,7 +920,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 				//we we're target but already communicating with someone else
 				if ((wpr.target_system == mavlink_system.sysid /*&& wpr.target_component == mavlink_wpm_comp_id*/) && !(msg->sysid == wpm->current_partner_sysid && msg->compid == wpm->current_partner_compid)) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-					mavlink_missionlib_send_gcs_string("REJ. WP CMD: Busy");
+					mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: Busy");
 #else
 
 					if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_REQUEST from ID %u because i'm already talking to ID %u.\n", msg->sysid, wpm->current_partner_sysid);
@@ -834,7 +929,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 				} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-					mavlink_missionlib_send_gcs_string("REJ. WP CMD: target id mismatch");
+					mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: target id mismatch");
 #else
 
 					if (MAVLINK_WPM_VERBOSE) printf("IGNORED WAYPOINT COMMAND BECAUSE TARGET SYSTEM AND COMPONENT OR COMM PARTNER ID MISMATCH\n");
@@ -859,10 +954,24 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 //                	printf("Comp id: %d\n",msg->compid);
 //                	printf("Current partner sysid: %d\n",wpm->current_partner_sysid);
 
-					if (wpc.count > 0) {
+					if (wpc.count > wpm->max_size || (wpc.count > 0 && mission_store_begin(wpc.count) != OK)) {
+#ifdef MAVLINK_WPM_NO_PRINTF
+						mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: No space");
+#else
+
+						if (MAVLINK_WPM_VERBOSE) printf("Rejected MAVLINK_MSG_ID_MISSION_ITEM_COUNT (%u) from %u, mission store holds %u\n", wpc.count, msg->sysid, wpm->max_size);
+
+#endif
+						wpm->current_partner_sysid = msg->sysid;
+						wpm->current_partner_compid = msg->compid;
+						wpm->current_partner_chan = chan;
+						wpm->current_state = MAVLINK_WPM_STATE_IDLE;
+						mavlink_wpm_send_waypoint_ack(chan, wpm->current_partner_sysid, wpm->current_partner_compid, MAV_MISSION_NO_SPACE);
+
+					} else if (wpc.count > 0) {
 						if (wpm->current_state == MAVLINK_WPM_STATE_IDLE) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-							mavlink_missionlib_send_gcs_string("WP CMD OK: state -> GETLIST");
+							mavlink_missionlib_send_gcs_string(chan, "WP CMD OK: state -> GETLIST");
 #else
 
 							if (MAVLINK_WPM_VERBOSE) printf("Got MAVLINK_MSG_ID_MISSION_ITEM_COUNT (%u) from %u changing state to MAVLINK_WPM_STATE_GETLIST\n", wpc.count, msg->sysid);
@@ -872,7 +981,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 						if (wpm->current_state == MAVLINK_WPM_STATE_GETLIST) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-							mavlink_missionlib_send_gcs_string("WP CMD OK AGAIN");
+							mavlink_missionlib_send_gcs_string(chan, "WP CMD OK AGAIN");
 #else
 
 							if (MAVLINK_WPM_VERBOSE) printf("Got MAVLINK_MSG_ID_MISSION_ITEM_COUNT (%u) again from %u\n", wpc.count, msg->sysid);
@@ -884,46 +993,42 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 						wpm->current_wp_id = 0;
 						wpm->current_partner_sysid = msg->sysid;
 						wpm->current_partner_compid = msg->compid;
+						wpm->current_partner_chan = chan;
 						wpm->current_count = wpc.count;
 
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("CLR RCV BUF: READY");
+						mavlink_missionlib_send_gcs_string(chan, "CLR RCV BUF: READY");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("clearing receive buffer and readying for receiving waypoints\n");
 
 #endif
-						wpm->rcv_size = 0;
-						//while(waypoints_receive_buffer->size() > 0)
-//                        {
-//                            delete waypoints_receive_buffer->back();
-//                            waypoints_receive_buffer->pop_back();
-//                        }
+						wpm->rcv_requested = 0;
+						wpm->rcv_window = 0;
+						wpm->rcv_current_wp_id = -1;
 
-						mavlink_wpm_send_waypoint_request(wpm->current_partner_sysid, wpm->current_partner_compid, wpm->current_wp_id);
+						mavlink_wpm_request_window(chan, now, false);
 
 					} else if (wpc.count == 0) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("COUNT 0");
+						mavlink_missionlib_send_gcs_string(chan, "COUNT 0");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("got waypoint count of 0, clearing waypoint list and staying in state MAVLINK_WPM_STATE_IDLE\n");
 
 #endif
-						wpm->rcv_size = 0;
-						//while(waypoints_receive_buffer->size() > 0)
-//                        {
-//                            delete waypoints->back();
-//                            waypoints->pop_back();
-//                        }
-						wpm->current_active_wp_id = -1;
-						wpm->yaw_reached = false;
-						wpm->pos_reached = false;
+						mission_store_clear();
+						wpm->size = 0;
+						mavlink_wpm_clear_active();
+						wpm->current_partner_sysid = msg->sysid;
+						wpm->current_partner_compid = msg->compid;
+						wpm->current_partner_chan = chan;
+						mavlink_wpm_send_waypoint_ack(chan, wpm->current_partner_sysid, wpm->current_partner_compid, MAV_MISSION_ACCEPTED);
 						break;
 
 					} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("IGN WP CMD");
+						mavlink_missionlib_send_gcs_string(chan, "IGN WP CMD");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Ignoring MAVLINK_MSG_ID_MISSION_ITEM_COUNT from %u with count of %u\n", msg->sysid, wpc.count);
@@ -934,7 +1039,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 				} else {
 					if (!(wpm->current_state == MAVLINK_WPM_STATE_IDLE || wpm->current_state == MAVLINK_WPM_STATE_GETLIST)) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("REJ. WP CMD: Busy");
+						mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: Busy");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_COUNT because i'm doing something else already (state=%i).\n", wpm->current_state);
@@ -943,7 +1048,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 					} else if (wpm->current_state == MAVLINK_WPM_STATE_GETLIST && wpm->current_wp_id != 0) {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("REJ. WP CMD: Busy");
+						mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: Busy");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_COUNT because i'm already receiving waypoint %u.\n", wpm->current_wp_id);
@@ -952,7 +1057,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 					} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-						mavlink_missionlib_send_gcs_string("REJ. WP CMD: ?");
+						mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: ?");
 #else
 
 						if (MAVLINK_WPM_VERBOSE) printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_COUNT - FIXME: missed error description\n");
@@ -963,7 +1068,7 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 			} else {
 #ifdef MAVLINK_WPM_NO_PRINTF
-				mavlink_missionlib_send_gcs_string("REJ. WP CMD: target id mismatch");
+				mavlink_missionlib_send_gcs_string(chan, "REJ. WP CMD: target id mismatch");
 #else
 
 				if (MAVLINK_WPM_VERBOSE) printf("IGNORED WAYPOINT COMMAND BECAUSE TARGET SYSTEM AND COMPONENT OR COMM PARTNER ID MISMATCH\n");
@@ -978,89 +1083,59 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 			mavlink_mission_item_t wp;
 			mavlink_msg_mission_item_decode(msg, &wp);
 
-			mavlink_missionlib_send_gcs_string("GOT WP");
-//			printf("sysid=%d, current_partner_sysid=%d\n", msg->sysid, wpm->current_partner_sysid);
-//			printf("compid=%d, current_partner_compid=%d\n", msg->compid, wpm->current_partner_compid);
+			if (MAVLINK_WPM_TEXT_FEEDBACK) mavlink_missionlib_send_gcs_string(chan, "GOT WP");
 
 //            if((msg->sysid == wpm->current_partner_sysid && msg->compid == wpm->current_partner_compid) && (wp.target_system == mavlink_system.sysid /*&& wp.target_component == mavlink_wpm_comp_id*/))
 			if (wp.target_system == mavlink_system.sysid && wp.target_component == mavlink_wpm_comp_id) {
 
 				wpm->timestamp_lastaction = now;
 
-//                printf("wpm->current_state=%u, wp.seq = %d, wpm->current_wp_id=%d\n", wpm->current_state, wp.seq, wpm->current_wp_id);
-
-//                wpm->current_state = MAVLINK_WPM_STATE_GETLIST;//removeme debug XXX TODO
+				//ensure that we are in the correct state and that the waypoint was requested; the waypoints of the window may arrive in any order
+				if ((wpm->current_state == MAVLINK_WPM_STATE_GETLIST || wpm->current_state == MAVLINK_WPM_STATE_GETLIST_GETWPS) && wp.seq >= wpm->current_wp_id && wp.seq < wpm->rcv_requested) {
+					uint32_t bit = 1UL << (wp.seq - wpm->current_wp_id);
 
-				//ensure that we are in the correct state and that the first waypoint has id 0 and the following waypoints have the correct ids
-				if ((wpm->current_state == MAVLINK_WPM_STATE_GETLIST && wp.seq == 0) || (wpm->current_state == MAVLINK_WPM_STATE_GETLIST_GETWPS && wp.seq == wpm->current_wp_id && wp.seq < wpm->current_count)) {
-					//mavlink_missionlib_send_gcs_string("DEBUG 2");
-
-//                    if (verbose && wpm->current_state == MAVLINK_WPM_STATE_GETLIST) // printf("Got MAVLINK_MSG_ID_MISSION_ITEM %u from %u changing state to MAVLINK_WPM_STATE_GETLIST_GETWPS\n", wp.seq, msg->sysid);
-//                    if (verbose && wpm->current_state == MAVLINK_WPM_STATE_GETLIST_GETWPS && wp.seq == wpm->current_wp_id) // printf("Got MAVLINK_MSG_ID_MISSION_ITEM %u from %u\n", wp.seq, msg->sysid);
-//                    if (verbose && wpm->current_state == MAVLINK_WPM_STATE_GETLIST_GETWPS && wp.seq-1 == wpm->current_wp_id) // printf("Got MAVLINK_MSG_ID_MISSION_ITEM %u (again) from %u\n", wp.seq, msg->sysid);
-//
 					wpm->current_state = MAVLINK_WPM_STATE_GETLIST_GETWPS;
-					mavlink_mission_item_t *newwp = &(wpm->rcv_waypoints[wp.seq]);
-					memcpy(newwp, &wp, sizeof(mavlink_mission_item_t));
-//                    printf("WP seq: %d\n",wp.seq);
-					wpm->current_wp_id = wp.seq + 1;
 
-					// if (verbose) // printf ("Added new waypoint to list. X= %f\t Y= %f\t Z= %f\t Yaw= %f\n", newwp->x, newwp->y, newwp->z, newwp->param4);
-//					printf ("Added new waypoint to list. X= %f\t Y= %f\t Z= %f\t Yaw= %f\n", newwp->x, newwp->y, newwp->z, newwp->param4);
-
-//					printf ("wpm->current_wp_id =%d, wpm->current_count=%d\n\n", wpm->current_wp_id, wpm->current_count);
-					if (wpm->current_wp_id == wpm->current_count && wpm->current_state == MAVLINK_WPM_STATE_GETLIST_GETWPS) {
-						mavlink_missionlib_send_gcs_string("GOT ALL WPS");
-						// if (verbose) // printf("Got all %u waypoints, changing state to MAVLINK_WPM_STATE_IDLE\n", wpm->current_count);
-
-						mavlink_wpm_send_waypoint_ack(wpm->current_partner_sysid, wpm->current_partner_compid, 0);
-
-						if (wpm->current_active_wp_id > wpm->rcv_size - 1) {
-							wpm->current_active_wp_id = wpm->rcv_size - 1;
-						}
-
-						// switch the waypoints list
-						// FIXME CHECK!!!
-						uint32_t i;
+					if (wpm->rcv_window & bit) {
+						// answer to a repeated request, already stored
+						break;
+					}
 
-						for (i = 0; i < wpm->current_count; ++i) {
-							wpm->waypoints[i] = wpm->rcv_waypoints[i];
-						}
+					if (mission_store_write(wp.seq, &wp) != OK) {
+						mavlink_missionlib_send_gcs_string(chan, "ERROR: Mission not stored");
+						mavlink_wpm_send_waypoint_ack(chan, wpm->current_partner_sysid, wpm->current_partner_compid, MAV_MISSION_ERROR);
+						wpm->current_state = MAVLINK_WPM_STATE_IDLE;
+						break;
+					}
 
-						wpm->size = wpm->current_count;
+					if (wp.current && (wpm->rcv_current_wp_id < 0 || wp.seq < wpm->rcv_current_wp_id)) {
+						wpm->rcv_current_wp_id = wp.seq;
+					}
 
-						//get the new current waypoint
+					// slide the window past the waypoints that arrived in sequence
+					wpm->rcv_window |= bit;
 
-						for (i = 0; i < wpm->size; i++) {
-							if (wpm->waypoints[i].current == 1) {
-								wpm->current_active_wp_id = i;
-								//// if (verbose) // printf("New current waypoint %u\n", current_active_wp_id);
-								wpm->yaw_reached = false;
-								wpm->pos_reached = false;
-								mavlink_wpm_send_waypoint_current(wpm->current_active_wp_id);
-								mavlink_wpm_send_setpoint(wpm->current_active_wp_id);
-								wpm->timestamp_firstinside_orbit = 0;
-								break;
-							}
-						}
+					while (wpm->rcv_window & 1) {
+						wpm->rcv_window >>= 1;
+						wpm->current_wp_id++;
+					}
 
-						if (i == wpm->size) {
-							wpm->current_active_wp_id = -1;
-							wpm->yaw_reached = false;
-							wpm->pos_reached = false;
-							wpm->timestamp_firstinside_orbit = 0;
-						}
+					if (wpm->current_wp_id == wpm->current_count) {
+						mavlink_missionlib_send_gcs_string(chan, "GOT ALL WPS");
+						// if (verbose) // printf("Got all %u waypoints, changing state to MAVLINK_WPM_STATE_IDLE\n", wpm->current_count);
 
-						wpm->current_state = MAVLINK_WPM_STATE_IDLE;
+						mavlink_wpm_upload_complete(chan);
 
 					} else {
-						mavlink_wpm_send_waypoint_request(wpm->current_partner_sysid, wpm->current_partner_compid, wpm->current_wp_id);
+						// once the last requested waypoint is in, the ones still missing before it were lost; do not wait for the retry delay
+						mavlink_wpm_request_window(chan, now, wpm->rcv_requested > wpm->current_wp_id &&
+									   (wpm->rcv_window & (1UL << (wpm->rcv_requested - 1 - wpm->current_wp_id))));
 					}
 
 				} else {
 					if (wpm->current_state == MAVLINK_WPM_STATE_IDLE) {
 						//we're done receiving waypoints, answer with ack.
-						mavlink_wpm_send_waypoint_ack(wpm->current_partner_sysid, wpm->current_partner_compid, 0);
+						mavlink_wpm_send_waypoint_ack(chan, wpm->current_partner_sysid, wpm->current_partner_compid, 0);
 						printf("Received MAVLINK_MSG_ID_MISSION_ITEM while state=MAVLINK_WPM_STATE_IDLE, answered with WAYPOINT_ACK.\n");
 					}
 
@@ -1070,24 +1145,12 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 //							 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM %u because i'm doing something else already (state=%i).\n", wp.seq, wpm->current_state);
 							break;
 
-						} else if (wpm->current_state == MAVLINK_WPM_STATE_GETLIST) {
-							if (!(wp.seq == 0)) {
-//								 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM because the first waypoint ID (%u) was not 0.\n", wp.seq);
-							} else {
-//								 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM %u - FIXME: missed error description\n", wp.seq);
-							}
-						} else if (wpm->current_state == MAVLINK_WPM_STATE_GETLIST_GETWPS) {
-							if (!(wp.seq == wpm->current_wp_id)) {
-//								 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM because the waypoint ID (%u) was not the expected %u.\n", wp.seq, wpm->current_wp_id);
-								mavlink_wpm_send_waypoint_request(wpm->current_partner_sysid, wpm->current_partner_compid, wpm->current_wp_id);
-
-							} else if (!(wp.seq < wpm->current_count)) {
-//								 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM because the waypoint ID (%u) was out of bounds.\n", wp.seq);
-							} else {
-//								 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM %u - FIXME: missed error description\n", wp.seq);
-							}
+						} else if (wp.seq < wpm->current_wp_id) {
+//							 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM %u because it was already received.\n", wp.seq);
+						} else if (!(wp.seq < wpm->current_count)) {
+//							 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM because the waypoint ID (%u) was out of bounds.\n", wp.seq);
 						} else {
-//							 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM %u - FIXME: missed error description\n", wp.seq);
+//							 printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM %u because it was not requested yet.\n", wp.seq);
 						}
 					}
 				}
@@ -1112,10 +1175,9 @@ void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehi
 
 				// if (verbose) // printf("Got MAVLINK_MSG_ID_MISSION_ITEM_CLEAR_LIST from %u deleting all waypoints\n", msg->sysid);
 				// Delete all waypoints
+				mission_store_clear();
 				wpm->size = 0;
-				wpm->current_active_wp_id = -1;
-				wpm->yaw_reached = false;
-				wpm->pos_reached = false;
+				mavlink_wpm_clear_active();
 
 			} else if (wpca.target_system == mavlink_system.sysid /*&& wpca.target_component == mavlink_wpm_comp_id */ && wpm->current_state != MAVLINK_WPM_STATE_IDLE) {
 				// if (verbose) // printf("Ignored MAVLINK_MSG_ID_MISSION_ITEM_CLEAR_LIST from %u because i'm doing something else already (state=%i).\n", msg->sysid, wpm->current_state);
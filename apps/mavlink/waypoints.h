@@ -55,6 +55,7 @@ extern mavlink_system_t mavlink_system;
 #include <stdbool.h>
 #include <uORB/topics/vehicle_global_position.h>
 #include <uORB/topics/vehicle_local_position.h>
+#include <systemlib/geo/geo.h>
 
 // FIXME XXX - TO BE MOVED TO XML
 enum MAVLINK_WPM_STATES {
@@ -79,34 +80,59 @@ enum MAVLINK_WPM_CODES {
 
 /* WAYPOINT MANAGER - MISSION LIB */
 
-#define MAVLINK_WPM_MAX_WP_COUNT 15
-#define MAVLINK_WPM_CONFIG_IN_FLIGHT_UPDATE				  ///< Enable double buffer and in-flight updates
+#define MAVLINK_WPM_UPLOAD_WINDOW 8						  ///< Items requested ahead during an upload, at most 32
 #ifndef MAVLINK_WPM_TEXT_FEEDBACK
 #define MAVLINK_WPM_TEXT_FEEDBACK 0						  ///< Report back status information as text
 #endif
 #define MAVLINK_WPM_PROTOCOL_TIMEOUT_DEFAULT 5000000         ///< Protocol communication timeout in useconds
 #define MAVLINK_WPM_SETPOINT_DELAY_DEFAULT 1000000           ///< When to send a new setpoint
 #define MAVLINK_WPM_PROTOCOL_DELAY_DEFAULT 40000
+#define MAVLINK_WPM_RETRY_DELAY_DEFAULT 500000             ///< Request missing items again after this many useconds without progress
 
+/**
+ * Geometry of the leg towards the active waypoint.
+ *
+ * Computed once when the waypoint becomes active. Global positions are
+ * projected into the map plane centered at the waypoint, so the reaching
+ * check needs no double precision trigonometry.
+ */
+struct mavlink_wpm_leg {
+	uint8_t frame;
+	struct map_projection_reference_s ref;	///< Centered at the waypoint, global frames
+	float x, y, z;					///< Waypoint, local frames
+	float length;					///< Distance from the previous waypoint, 0 without one
+	float bearing;					///< Direction of the leg, radians clockwise from north
+	float dir_n, dir_e;				///< Unit vector along the leg; (-dir_e, dir_n) points to its right
+	float distance;					///< Last position: distance to the waypoint
+	float along_track;				///< Last position: distance to go along the leg
+	float cross_track;				///< Last position: offset to the right of the leg
+};
 
+
+/**
+ * State of the waypoint manager. The waypoints themselves are kept by the
+ * mission store (mission_store.h), only the active one is held here.
+ */
 struct mavlink_wpm_storage {
-	mavlink_mission_item_t waypoints[MAVLINK_WPM_MAX_WP_COUNT];      ///< Currently active waypoints
-#ifdef MAVLINK_WPM_CONFIG_IN_FLIGHT_UPDATE
-	mavlink_mission_item_t rcv_waypoints[MAVLINK_WPM_MAX_WP_COUNT];  ///< Receive buffer for next waypoints
-#endif
+	mavlink_mission_item_t active_wp;				///< Copy of the waypoint the system is heading towards
+	struct mavlink_wpm_leg leg;						///< Leg towards active_wp
 	uint16_t size;
 	uint16_t max_size;
-	uint16_t rcv_size;
 	enum MAVLINK_WPM_STATES current_state;
-	int16_t current_wp_id;							///< Waypoint in current transmission
+	int16_t current_wp_id;							///< Waypoint in current transmission; on upload the first one not yet received
 	int16_t current_active_wp_id;					///< Waypoint the system is currently heading towards
 	uint16_t current_count;
+	uint16_t rcv_requested;							///< Upload: items up to here have been requested
+	int16_t rcv_current_wp_id;						///< Upload: first item marked current
+	uint32_t rcv_window;							///< Upload: bit n set if item current_wp_id + n arrived
 	uint8_t current_partner_sysid;
 	uint8_t current_partner_compid;
+	mavlink_channel_t current_partner_chan;			///< Link of the last transfer, mission status goes out on it
 	uint64_t timestamp_lastaction;
 	uint64_t timestamp_last_send_setpoint;
 	uint64_t timestamp_firstinside_orbit;
 	uint64_t timestamp_lastoutside_orbit;
+	uint64_t timestamp_lastrequest;
 	uint32_t timeout;
 	uint32_t delay_setpoint;
 	float accept_range_yaw;
@@ -121,10 +147,10 @@ typedef struct mavlink_wpm_storage mavlink_wpm_storage;
 void mavlink_wpm_init(mavlink_wpm_storage *state);
 int mavlink_waypoint_eventloop(uint64_t now, const struct vehicle_global_position_s *global_position,
 			       struct vehicle_local_position_s *local_pos);
-void mavlink_wpm_message_handler(const mavlink_message_t *msg, const struct vehicle_global_position_s *global_pos ,
+void mavlink_wpm_message_handler(mavlink_channel_t chan, const mavlink_message_t *msg, const struct vehicle_global_position_s *global_pos ,
 				 struct vehicle_local_position_s *local_pos);
 
-extern void mavlink_missionlib_current_waypoint_changed(uint16_t index, float param1,
+extern void mavlink_missionlib_current_waypoint_changed(mavlink_channel_t chan, uint16_t index, float param1,
 		float param2, float param3, float param4, float param5_lat_x,
 		float param6_lon_y, float param7_alt_z, uint8_t frame, uint16_t command);
 
@@ -43,6 +43,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -54,6 +55,7 @@
 #include <drivers/drv_hrt.h>
 #include <drivers/drv_tone_alarm.h>
 
+#include <nuttx/arch.h>
 #include <nuttx/spi.h>
 
 #include "tests.h"
@@ -74,6 +76,9 @@
  * Private Data
  ****************************************************************************/
 
+static volatile unsigned deferred_calls;
+static volatile unsigned deferred_in_interrupt;
+
 /****************************************************************************
  * Public Data
  ****************************************************************************/
@@ -82,6 +87,14 @@
  * Private Functions
  ****************************************************************************/
 
+static void deferred_callout(void *arg)
+{
+	deferred_calls++;
+
+	if (up_interrupt_context())
+		deferred_in_interrupt++;
+}
+
 
 /****************************************************************************
  * Public Functions
@@ -90,7 +103,6 @@
 extern uint16_t ppm_buffer[];
 extern unsigned ppm_decoded_channels;
 extern uint16_t ppm_edge_history[];
-extern uint16_t ppm_pulse_history[];
 
 int test_ppm(int argc, char *argv[])
 {
@@ -102,16 +114,11 @@ int test_ppm(int argc, char *argv[])
 	for (i = 0; i < ppm_decoded_channels; i++)
 		printf("  %u\n", ppm_buffer[i]);
 
-	printf("edges\n");
+	printf("pulse intervals\n");
 
 	for (i = 0; i < 32; i++)
 		printf("  %u\n", ppm_edge_history[i]);
 
-	printf("pulses\n");
-
-	for (i = 0; i < 32; i++)
-		printf("  %u\n", ppm_pulse_history[i]);
-
 	fflush(stdout);
 #else
 	printf("PPM not configured\n");
@@ -184,6 +191,8 @@ int test_hrt(int argc, char *argv[])
 	int i;
 	struct timeval tv1, tv2;
 
+	memset(&call, 0, sizeof(call));
+
 	printf("start-time (hrt, sec/usec), end-time (hrt, sec/usec), microseconds per half second\n");
 
 	for (i = 0; i < 10; i++) {
@@ -214,5 +223,25 @@ int test_hrt(int argc, char *argv[])
 		fflush(stdout);
 	}
 
+	printf("deferred 100Hz callout for one second\n");
+
+	deferred_calls = 0;
+	deferred_in_interrupt = 0;
+	hrt_call_every_deferred(&call, 1000, 10000, deferred_callout, NULL);
+	usleep(1000000);
+	hrt_cancel(&call);
+
+	hrt_call_print_info(&call, "deferred");
+	printf("%u calls, %u from interrupt context\n", deferred_calls, deferred_in_interrupt);
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+
+	if (deferred_calls == 0 || deferred_in_interrupt != 0) {
+		printf("deferred callout FAILED\n");
+		return 1;
+	}
+
+#endif
+
 	return 0;
 }
@@ -236,6 +236,28 @@ test_perf(int argc, char *argv[])
 	printf("perf: expect at least two counters\n");
 	perf_print_all();
 
+	/* known samples, check the derived statistics */
+	perf_reset(ec);
+
+	for (unsigned i = 1; i <= 100; i++)
+		perf_set(ec, i);
+
+	struct perf_counter_snapshot snap;
+
+	if (perf_snapshot(ec, &snap) != OK) {
+		printf("perf: snapshot failed\n");
+		return 1;
+	}
+
+	if ((snap.samples != 100) || (snap.time_least != 1) || (snap.time_most != 100) ||
+	    (perf_snapshot_mean(&snap) != 50) || (perf_snapshot_stddev(&snap) != 28)) {
+		printf("perf: bad statistics\n");
+		return 1;
+	}
+
+	printf("perf: expect p50 near 50us, p99 near 99us\n");
+	perf_print_counter(ec);
+
 	perf_free(cc);
 	perf_free(ec);
 
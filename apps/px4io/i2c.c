@@ -265,10 +265,15 @@ i2c_rx_complete(void)
 
 		/* work out how many registers are being written */
 		unsigned count = (rx_len - 2) / 2;
-		if (count > 0) {
+		if (count > 0)
 			registers_set(selected_page, selected_offset, (const uint16_t *)&rx_buf[2], count);
-		} else {
-			/* no registers written, must be an address cycle */
+
+		/*
+		 * No registers written, must be an address cycle. A bulk write is
+		 * normally followed by a read of its GET segments, so prepare that
+		 * as well.
+		 */
+		if ((count == 0) || (selected_page == PX4IO_PAGE_BULK)) {
 			uint16_t *regs;
 			unsigned reg_count;
 
@@ -197,6 +197,9 @@ mixer_tick(void)
 		/* update the servo outputs. */
 		for (unsigned i = 0; i < IO_SERVO_COUNT; i++)
 			up_pwm_servo_set(i, r_page_servos[i]);
+
+		/* and send them now on oneshot outputs */
+		up_pwm_servo_trigger();
 	}
 }
 
@@ -152,7 +152,7 @@
 
 #define PX4IO_P_SETUP_PWM_RATES			2	/* bitmask, 0 = low rate, 1 = high rate */
 #define PX4IO_P_SETUP_PWM_DEFAULTRATE		3	/* 'low' PWM frame output rate in Hz */
-#define PX4IO_P_SETUP_PWM_ALTRATE		4	/* 'high' PWM frame output rate in Hz */
+#define PX4IO_P_SETUP_PWM_ALTRATE		4	/* 'high' PWM frame output rate in Hz, 0 = oneshot */
 #define PX4IO_P_SETUP_RELAYS			5	/* bitmask of relay/switch outputs, 0 = off, 1 = on */
 #define PX4IO_P_SETUP_VBATT_SCALE		6	/* battery voltage correction factor (float) */
 #define PX4IO_P_SETUP_IBATT_SCALE		7	/* battery current scaling factor (float) */
@@ -183,6 +183,12 @@
 /* PWM failsafe values - zero disables the output */
 #define PX4IO_PAGE_FAILSAFE_PWM			105	/* 0..CONFIG_ACTUATOR_COUNT-1 */
 
+/* multi-page transfer, see struct px4io_bulk_segment */
+#define PX4IO_PAGE_BULK				106
+
+/* first CONFIG_PROTOCOL_VERSION that implements PX4IO_PAGE_BULK */
+#define PX4IO_PROTOCOL_VERSION_BULK		2
+
 /**
  * As-needed mixer data upload.
  *
@@ -202,3 +208,73 @@ struct px4io_mixdata {
 };
 #pragma pack(pop)
 
+/**
+ * Multi-page transfer.
+ *
+ * A write to PX4IO_PAGE_BULK carries a sequence of segments, each
+ * addressing a run of registers in another page. SET segments are
+ * followed by count values, MODIFY segments by a clear and a set
+ * bitmask that IO applies to a single register, and GET segments by
+ * nothing. Segments are applied in order.
+ *
+ * A read from PX4IO_PAGE_BULK returns a bitmask of the GET segments
+ * that could not be served (bit n for the n-th GET segment), followed
+ * by count registers for each GET segment of the last write, in order.
+ * Registers of a failed segment read as zero.
+ *
+ * Writes and the following read are normally issued as a single
+ * write/restart/read transfer, so that all of the register traffic
+ * for one FMU update cycle costs one bus transaction.
+ */
+#pragma pack(push, 1)
+struct px4io_bulk_segment {
+	uint8_t		page;
+	uint8_t		offset;
+	uint8_t		count;
+	uint8_t		op;
+#define PX4IO_BULK_OP_SET			0
+#define PX4IO_BULK_OP_MODIFY			1
+#define PX4IO_BULK_OP_GET			2
+
+	uint16_t	values[0];	/* SET/MODIFY data */
+};
+#pragma pack(pop)
+
+#define PX4IO_BULK_MAX_GET_SEGMENTS	16	/* GET segments per transfer */
+#define PX4IO_BULK_MAX_GET_REGS		48	/* registers returned per transfer, excluding the failure mask */
+
+/**
+ * Serial transport.
+ *
+ * As an alternative to I2C, register reads and writes may be carried
+ * in hx_stream frames over a UART. Each request frame addresses one
+ * run of registers in one page, exactly as an I2C transfer would, and
+ * is answered by a reply frame echoing its sequence number. Requests
+ * are answered in order, so the FMU may send several before waiting
+ * for the replies.
+ *
+ * A write reply carries no registers; a read reply carries count
+ * registers. A request that cannot be handled is answered with
+ * PX4IO_SERIAL_ERROR.
+ */
+#pragma pack(push, 1)
+struct px4io_serial_frame {
+	uint8_t		seq;		/* echoed in the reply */
+	uint8_t		code;		/* PX4IO_SERIAL_* | register count */
+#define PX4IO_SERIAL_CODE_MASK			0xc0
+#define PX4IO_SERIAL_COUNT_MASK			0x3f
+#define PX4IO_SERIAL_READ			0x00	/* request */
+#define PX4IO_SERIAL_WRITE			0x40	/* request */
+#define PX4IO_SERIAL_OK				0x80	/* reply */
+#define PX4IO_SERIAL_ERROR			0xc0	/* reply */
+
+	uint8_t		page;
+	uint8_t		offset;
+	uint16_t	regs[0];	/* write data or read reply */
+};
+#pragma pack(pop)
+
+#define PX4IO_SERIAL_MAX_REGS		50	/* registers per frame, must fit in HX_STREAM_MAX_FRAME */
+#define PX4IO_SERIAL_REPLY_QUEUE	256	/* encoded reply bytes IO can queue; bounds requests in flight */
+#define PX4IO_SERIAL_BITRATE		1500000	/* divides the IO and FMU USART clocks exactly */
+
@@ -45,6 +45,7 @@
 #include <string.h>
 #include <poll.h>
 #include <signal.h>
+#include <semaphore.h>
 
 #include <drivers/drv_pwm_output.h>
 #include <drivers/drv_hrt.h>
@@ -64,6 +65,27 @@ struct sys_state_s 	system_state;
 
 static struct hrt_call serial_dma_call;
 
+/*
+ * The main loop sleeps until there is something to do: FMU has written
+ * controls, or it is time to look for R/C input.
+ *
+ * R/C input is gathered every CONTROLS_INTERVAL; this is faster than any
+ * receiver sends frames, and short enough that the DSM and S.bus decoders
+ * still see the gap between frames.
+ */
+#define CONTROLS_INTERVAL	2000
+
+/*
+ * Without new controls, mix at this interval anyway so that failsafe,
+ * R/C override and safety switch changes are applied.
+ */
+#define MIX_IDLE_INTERVAL	20000
+
+static struct hrt_call	controls_call;
+static sem_t		loop_sem;
+static volatile bool	mix_pending;
+static volatile bool	controls_pending;
+
 /* store i2c reset count XXX this should be a register, together with other error counters */
 volatile uint32_t i2c_loop_resets = 0;
 
@@ -117,6 +139,34 @@ show_debug_messages(void)
 	}
 }
 
+/*
+ * wake the main loop, if it is not already going to run
+ */
+static void
+loop_wakeup(void)
+{
+	int value;
+
+	sem_getvalue(&loop_sem, &value);
+
+	if (value <= 0)
+		sem_post(&loop_sem);
+}
+
+void
+mixer_schedule(void)
+{
+	mix_pending = true;
+	loop_wakeup();
+}
+
+static void
+controls_schedule(void *arg)
+{
+	controls_pending = true;
+	loop_wakeup();
+}
+
 int
 user_start(int argc, char *argv[])
 {
@@ -155,8 +205,13 @@ user_start(int argc, char *argv[])
 	/* initialise the control inputs */
 	controls_init();
 
+#ifdef CONFIG_PX4IO_SERIAL
+	/* start the serial handler */
+	serial_init();
+#else
 	/* start the i2c handler */
 	i2c_init();
+#endif
 
 	/* add a performance counter for mixing */
 	perf_counter_t mixer_perf = perf_alloc(PC_ELAPSED, "mix");
@@ -167,6 +222,10 @@ user_start(int argc, char *argv[])
 	/* and one for measuring the loop rate */
 	perf_counter_t loop_perf = perf_alloc(PC_INTERVAL, "loop");
 
+	/* FMU control write to new outputs, and to the pulse that carries them */
+	perf_counter_t output_latency_perf = perf_alloc(PC_ELAPSED, "ctl->output");
+	perf_counter_t pulse_latency_perf = perf_alloc(PC_ELAPSED, "ctl->pulse");
+
 	struct mallinfo minfo = mallinfo();
 	lowsyslog("MEM: free %u, largest %u\n", minfo.mxordblk, minfo.fordblks);
 
@@ -190,24 +249,55 @@ user_start(int argc, char *argv[])
 #endif
 
 	/*
-	 * Run everything in a tight loop.
+	 * Run the mixer and the control inputs when there is work for them.
 	 */
+	sem_init(&loop_sem, 0, 0);
+	hrt_call_every(&controls_call, CONTROLS_INTERVAL, CONTROLS_INTERVAL, controls_schedule, NULL);
 
 	uint64_t last_debug_time = 0;
+	uint64_t last_mix_time = 0;
+	uint64_t last_rc_time = 0;
 	for (;;) {
 
+		/* sleep until FMU writes controls or the control input tick */
+		sem_wait(&loop_sem);
+
 		/* track the rate at which the loop is running */
 		perf_count(loop_perf);
 
-		/* kick the mixer */
-		perf_begin(mixer_perf);
-		mixer_tick();
-		perf_end(mixer_perf);
-
 		/* kick the control inputs */
-		perf_begin(controls_perf);
-		controls_tick();
-		perf_end(controls_perf);
+		if (controls_pending) {
+			controls_pending = false;
+
+			perf_begin(controls_perf);
+			controls_tick();
+			perf_end(controls_perf);
+		}
+
+		/* new R/C input may change the outputs when overriding */
+		bool rc_updated = (system_state.rc_channels_timestamp != last_rc_time);
+		last_rc_time = system_state.rc_channels_timestamp;
+
+		if (mix_pending || rc_updated || (hrt_elapsed_time(&last_mix_time) > MIX_IDLE_INTERVAL)) {
+			uint64_t fmu_time = system_state.fmu_data_received_time;
+			bool fmu_update = (fmu_time > last_mix_time);
+			mix_pending = false;
+
+			/* kick the mixer */
+			perf_begin(mixer_perf);
+			mixer_tick();
+			perf_end(mixer_perf);
+
+			last_mix_time = hrt_absolute_time();
+
+			/* how long the last control write took to reach the outputs */
+			if (fmu_update) {
+				uint64_t latency = last_mix_time - fmu_time;
+
+				perf_set(output_latency_perf, latency);
+				perf_set(pulse_latency_perf, latency + up_pwm_servo_next_pulse(0));
+			}
+		}
 
 		/* check for debug activity */
 		show_debug_messages();
@@ -222,7 +312,11 @@ user_start(int argc, char *argv[])
 				  (unsigned)r_status_flags,
 				  (unsigned)r_setup_arming,
 				  (unsigned)r_setup_features,
+#ifdef CONFIG_PX4IO_SERIAL
+				  serial_errors,
+#else
 				  (unsigned)i2c_loop_resets,
+#endif
 				  (unsigned)minfo.mxordblk);
 			last_debug_time = hrt_absolute_time();
 		}
@@ -141,6 +141,7 @@ extern struct sys_state_s system_state;
  * Mixer
  */
 extern void	mixer_tick(void);
+extern void	mixer_schedule(void);	/* run mixer_tick soon; safe from interrupt context */
 extern void	mixer_handle_text(const void *buffer, size_t length);
 
 /**
@@ -152,6 +153,8 @@ extern void	safety_init(void);
  * FMU communications
  */
 extern void	i2c_init(void);
+extern void	serial_init(void);
+extern unsigned	serial_errors;
 
 /**
  * Register space
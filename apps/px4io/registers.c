@@ -41,13 +41,17 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <drivers/drv_hrt.h>
+#include <drivers/drv_pwm_output.h>
 
 #include "px4io.h"
 #include "protocol.h"
 
 static int	registers_set_one(uint8_t page, uint8_t offset, uint16_t value);
+static void	registers_set_bulk(const uint16_t *values, unsigned num_values);
+static unsigned	registers_get_bulk(void);
 static void	pwm_configure_rates(uint16_t map, uint16_t defaultrate, uint16_t altrate);
 
 /**
@@ -56,7 +60,7 @@ static void	pwm_configure_rates(uint16_t map, uint16_t defaultrate, uint16_t alt
  * Static configuration parameters.
  */
 static const uint16_t	r_page_config[] = {
-	[PX4IO_P_CONFIG_PROTOCOL_VERSION]	= 1,	/* XXX hardcoded magic number */
+	[PX4IO_P_CONFIG_PROTOCOL_VERSION]	= PX4IO_PROTOCOL_VERSION_BULK,
 	[PX4IO_P_CONFIG_SOFTWARE_VERSION]	= 1,	/* XXX hardcoded magic number */
 	[PX4IO_P_CONFIG_BOOTLOADER_VERSION]	= 3,	/* XXX hardcoded magic number */
 	[PX4IO_P_CONFIG_MAX_TRANSFER]		= 64,	/* XXX hardcoded magic number */
@@ -182,6 +186,21 @@ uint16_t		r_page_rc_input_config[MAX_CONTROL_CHANNELS * PX4IO_P_RC_CONFIG_STRIDE
  */
 uint16_t		r_page_servo_failsafe[IO_SERVO_COUNT];
 
+/**
+ * PAGE 106
+ *
+ * Multi-page transfer; GET segments are recorded when the page is
+ * written and gathered into r_page_bulk when it is read.
+ */
+static struct {
+	uint8_t		page;
+	uint8_t		offset;
+	uint8_t		count;
+} bulk_get[PX4IO_BULK_MAX_GET_SEGMENTS];
+static unsigned		bulk_get_count;
+
+static uint16_t		r_page_bulk[1 + PX4IO_BULK_MAX_GET_REGS];
+
 void
 registers_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num_values)
 {
@@ -206,7 +225,9 @@ registers_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num
 		r_status_flags |= PX4IO_P_STATUS_FLAGS_FMU_OK;
         	r_status_alarms &= ~PX4IO_P_STATUS_ALARMS_FMU_LOST;
 		r_status_flags &= ~PX4IO_P_STATUS_FLAGS_RAW_PWM;
-		
+
+		/* apply the new controls right away */
+		mixer_schedule();
 		break;
 
 		/* handle raw PWM input */
@@ -226,6 +247,8 @@ registers_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num
 		system_state.fmu_data_received_time = hrt_absolute_time();
 		r_status_flags |= PX4IO_P_STATUS_FLAGS_FMU_OK | PX4IO_P_STATUS_FLAGS_RAW_PWM;
 
+		/* output the new values right away */
+		mixer_schedule();
 		break;
 
 		/* handle setup for servo failsafe values */
@@ -248,6 +271,11 @@ registers_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num
 		mixer_handle_text(values, num_values * sizeof(*values));
 		break;
 
+		/* handle a multi-page transfer */
+	case PX4IO_PAGE_BULK:
+		registers_set_bulk(values, num_values);
+		break;
+
 	default:
 		/* avoid offset wrap */
 		if ((offset + num_values) > 255)
@@ -263,6 +291,65 @@ registers_set(uint8_t page, uint8_t offset, const uint16_t *values, unsigned num
 	}
 }
 
+static void
+registers_set_bulk(const uint16_t *values, unsigned num_values)
+{
+	bulk_get_count = 0;
+
+	while (num_values >= (sizeof(struct px4io_bulk_segment) / sizeof(*values))) {
+		const struct px4io_bulk_segment *seg = (const struct px4io_bulk_segment *)values;
+
+		values += sizeof(*seg) / sizeof(*values);
+		num_values -= sizeof(*seg) / sizeof(*values);
+
+		switch (seg->op) {
+		case PX4IO_BULK_OP_SET:
+			/* a truncated segment means the rest of the transfer is garbage */
+			if (seg->count > num_values)
+				return;
+
+			/* no nesting */
+			if (seg->page != PX4IO_PAGE_BULK)
+				registers_set(seg->page, seg->offset, values, seg->count);
+
+			values += seg->count;
+			num_values -= seg->count;
+			break;
+
+		case PX4IO_BULK_OP_MODIFY:
+			if (num_values < 2)
+				return;
+
+			if (seg->page != PX4IO_PAGE_BULK) {
+				uint16_t *regs;
+				unsigned reg_count;
+
+				if (registers_get(seg->page, seg->offset, &regs, &reg_count) == 0) {
+					uint16_t value = (regs[0] & ~values[0]) | values[1];
+					registers_set(seg->page, seg->offset, &value, 1);
+				}
+			}
+
+			values += 2;
+			num_values -= 2;
+			break;
+
+		case PX4IO_BULK_OP_GET:
+			if (bulk_get_count < PX4IO_BULK_MAX_GET_SEGMENTS) {
+				bulk_get[bulk_get_count].page = seg->page;
+				bulk_get[bulk_get_count].offset = seg->offset;
+				bulk_get[bulk_get_count].count = seg->count;
+				bulk_get_count++;
+			}
+			break;
+
+		default:
+			/* unknown operation, we cannot tell how long it is */
+			return;
+		}
+	}
+}
+
 static int
 registers_set_one(uint8_t page, uint8_t offset, uint16_t value)
 {
@@ -319,6 +406,8 @@ registers_set_one(uint8_t page, uint8_t offset, uint16_t value)
 
 			r_setup_arming = value;
 
+			/* arm or disarm the outputs right away */
+			mixer_schedule();
 			break;
 
 		case PX4IO_P_SETUP_PWM_RATES:
@@ -335,7 +424,8 @@ registers_set_one(uint8_t page, uint8_t offset, uint16_t value)
 			break;
 
 		case PX4IO_P_SETUP_PWM_ALTRATE:
-			if (value < 50)
+			/* the alternate rate may also be oneshot */
+			if ((value < 50) && (value != PWM_RATE_ONESHOT))
 				value = 50;
 			if (value > 400)
 				value = 400;
@@ -581,6 +671,12 @@ registers_get(uint8_t page, uint8_t offset, uint16_t **values, unsigned *num_val
 		SELECT_PAGE(r_page_servo_failsafe);
 		break;
 
+	/* gathered from the pages requested by the last bulk write */
+	case PX4IO_PAGE_BULK:
+		*values = &r_page_bulk[0];
+		*num_values = registers_get_bulk();
+		break;
+
 	default:
 		return -1;
 	}
@@ -602,6 +698,45 @@ last_offset = offset;
 	return 0;
 }
 
+/*
+ * Gather the registers requested by the GET segments of the last bulk
+ * write into r_page_bulk, returning the number of registers filled.
+ */
+static unsigned
+registers_get_bulk(void)
+{
+	uint16_t failed = 0;
+	unsigned total = 1;
+
+	for (unsigned i = 0; i < bulk_get_count; i++) {
+		unsigned count = bulk_get[i].count;
+		uint16_t *regs;
+		unsigned reg_count;
+
+		/* never overrun the gather buffer */
+		if ((total + count) > (sizeof(r_page_bulk) / sizeof(r_page_bulk[0]))) {
+			failed |= (1 << i);
+			count = (sizeof(r_page_bulk) / sizeof(r_page_bulk[0])) - total;
+		}
+
+		if ((bulk_get[i].page == PX4IO_PAGE_BULK) ||
+		    registers_get(bulk_get[i].page, bulk_get[i].offset, &regs, &reg_count)) {
+			failed |= (1 << i);
+			reg_count = 0;
+		}
+
+		/* short pages are padded with zeroes */
+		for (unsigned j = 0; j < count; j++)
+			r_page_bulk[total + j] = (j < reg_count) ? regs[j] : 0;
+
+		total += count;
+	}
+
+	r_page_bulk[0] = failed;
+
+	return total;
+}
+
 /*
  * Helper function to handle changes to the PWM rate control registers.
  */
@@ -629,10 +764,10 @@ pwm_configure_rates(uint16_t map, uint16_t defaultrate, uint16_t altrate)
 			} else {
 				/* set it - errors here are unexpected */
 				if (alt != 0) {
-					if (up_pwm_servo_set_rate_group_update(group, r_setup_pwm_altrate) != OK)
+					if (up_pwm_servo_set_rate_group_update(group, altrate) != OK)
 						r_status_alarms |= PX4IO_P_STATUS_ALARMS_PWM_ERROR;
 				} else {
-					if (up_pwm_servo_set_rate_group_update(group, r_setup_pwm_defaultrate) != OK)
+					if (up_pwm_servo_set_rate_group_update(group, defaultrate) != OK)
 						r_status_alarms |= PX4IO_P_STATUS_ALARMS_PWM_ERROR;
 				}
 			}
@@ -0,0 +1,316 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/**
+ * @file serial.c
+ *
+ * Serial communication for the PX4IO module.
+ *
+ * Register requests from FMU arrive as hx_stream frames on USART2, which
+ * is driven directly with DMA in both directions. Replies are queued in
+ * request order, so FMU may have several requests in flight.
+ *
+ * USART2 shares its DMA channels with I2C1, so this replaces the I2C
+ * interface rather than running alongside it (see CONFIG_PX4IO_SERIAL).
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <nuttx/arch.h>
+#include <arch/board/board.h>
+#include <stm32_uart.h>
+#include <stm32_dma.h>
+
+#include <systemlib/hx_stream.h>
+
+//#define DEBUG
+#include "px4io.h"
+
+/*
+ * USART register definitions.
+ */
+#define SERIAL_BASE	STM32_USART2_BASE
+
+#define REG(_reg)	(*(volatile uint32_t *)(SERIAL_BASE + _reg))
+
+#define rSR		REG(STM32_USART_SR_OFFSET)
+#define rDR		REG(STM32_USART_DR_OFFSET)
+#define rBRR		REG(STM32_USART_BRR_OFFSET)
+#define rCR1		REG(STM32_USART_CR1_OFFSET)
+#define rCR2		REG(STM32_USART_CR2_OFFSET)
+#define rCR3		REG(STM32_USART_CR3_OFFSET)
+
+static int		serial_interrupt(int irq, void *context);
+static void		serial_rx_setup(void);
+static void		serial_rx_dma_callback(DMA_HANDLE handle, uint8_t status, void *arg);
+static void		serial_rx_drain(void);
+static void		serial_rx_frame(void *arg, const void *data, size_t length);
+static void		serial_tx_queue(const void *data, size_t length);
+static void		serial_tx_start(void);
+static void		serial_tx_dma_callback(DMA_HANDLE handle, uint8_t status, void *arg);
+
+static DMA_HANDLE	rx_dma;
+static DMA_HANDLE	tx_dma;
+
+static hx_stream_t	stream;
+
+/* raw bytes from the line, drained on idle and every half buffer */
+static uint8_t		rx_buf[128];
+static unsigned		rx_tail;
+
+/* encoded replies, appended to while DMA sends the earlier ones */
+static uint8_t		tx_buf[PX4IO_SERIAL_REPLY_QUEUE];
+static unsigned		tx_head;		/* end of the queued bytes */
+static unsigned		tx_sent;		/* end of the bytes already sent */
+static unsigned		tx_pending;		/* end of the bytes handed to DMA */
+static bool		tx_busy;
+
+/* reply under construction */
+static union {
+	struct px4io_serial_frame	frame;
+	uint8_t				bytes[sizeof(struct px4io_serial_frame) + PX4IO_SERIAL_MAX_REGS * 2];
+} reply;
+
+/* requests answered with PX4IO_SERIAL_ERROR or dropped for lack of tx space */
+unsigned		serial_errors;
+
+void
+serial_init(void)
+{
+	debug("serial init");
+
+	/* frames are decoded in interrupt context and handed to serial_rx_frame */
+	stream = hx_stream_init(-1, serial_rx_frame, NULL);
+
+	/* allocate DMA handles */
+	rx_dma = stm32_dmachannel(DMACHAN_USART2_RX);
+	tx_dma = stm32_dmachannel(DMACHAN_USART2_TX);
+
+	/* enable the USART block clock and reset it */
+	modifyreg32(STM32_RCC_APB1ENR, 0, RCC_APB1ENR_USART2EN);
+	modifyreg32(STM32_RCC_APB1RSTR, 0, RCC_APB1RSTR_USART2RST);
+	modifyreg32(STM32_RCC_APB1RSTR, RCC_APB1RSTR_USART2RST, 0);
+
+	/* configure the USART GPIOs */
+	stm32_configgpio(GPIO_USART2_TX);
+	stm32_configgpio(GPIO_USART2_RX);
+
+	/* 8N1 at the link rate; with 16x oversampling BRR is simply the divisor */
+	rCR2 = 0;
+	rBRR = STM32_PCLK1_FREQUENCY / PX4IO_SERIAL_BITRATE;
+
+	/* move data by DMA, interrupt when the line goes idle */
+	rCR3 = USART_CR3_DMAR | USART_CR3_DMAT;
+
+	serial_rx_setup();
+
+	irq_attach(STM32_IRQ_USART2, serial_interrupt);
+	up_enable_irq(STM32_IRQ_USART2);
+
+	/* and enable the USART */
+	rCR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE;
+}
+
+static int
+serial_interrupt(int irq, void *context)
+{
+	uint32_t sr = rSR;
+
+	if (sr & (USART_SR_IDLE | USART_SR_ORE | USART_SR_NE | USART_SR_FE)) {
+		/* reading DR after SR clears the idle and error flags */
+		(void)rDR;
+
+		/* a frame (or a burst of them) has ended */
+		serial_rx_drain();
+	}
+
+	return 0;
+}
+
+static void
+serial_rx_setup(void)
+{
+	/*
+	 * Receive continuously into a circular buffer; bytes are handed to the
+	 * frame decoder when the line goes idle, and at the half and full marks
+	 * so that long bursts never overrun it.
+	 */
+	rx_tail = 0;
+	stm32_dmasetup(rx_dma, (uintptr_t)&rDR, (uintptr_t)&rx_buf[0], sizeof(rx_buf),
+		DMA_CCR_CIRC |
+		DMA_CCR_MINC |
+		DMA_CCR_PSIZE_32BITS |
+		DMA_CCR_MSIZE_8BITS |
+		DMA_CCR_PRIMED);
+
+	stm32_dmastart(rx_dma, serial_rx_dma_callback, NULL, true);
+}
+
+static void
+serial_rx_dma_callback(DMA_HANDLE handle, uint8_t status, void *arg)
+{
+	serial_rx_drain();
+}
+
+static void
+serial_rx_drain(void)
+{
+	/* interrupts from the USART and the DMA channel both get here */
+	irqstate_t flags = irqsave();
+
+	unsigned head = sizeof(rx_buf) - stm32_dmaresidual(rx_dma);
+
+	if (head >= sizeof(rx_buf))
+		head = 0;
+
+	while (rx_tail != head) {
+		hx_stream_rx(stream, rx_buf[rx_tail]);
+
+		if (++rx_tail >= sizeof(rx_buf))
+			rx_tail = 0;
+	}
+
+	irqrestore(flags);
+}
+
+static void
+serial_rx_frame(void *arg, const void *data, size_t length)
+{
+	const struct px4io_serial_frame *request = (const struct px4io_serial_frame *)data;
+	unsigned count;
+	unsigned reply_len = sizeof(reply.frame);
+
+	if (length < sizeof(*request))
+		return;
+
+	count = request->code & PX4IO_SERIAL_COUNT_MASK;
+
+	reply.frame.seq = request->seq;
+	reply.frame.code = PX4IO_SERIAL_ERROR;
+	reply.frame.page = request->page;
+	reply.frame.offset = request->offset;
+
+	switch (request->code & PX4IO_SERIAL_CODE_MASK) {
+
+	case PX4IO_SERIAL_WRITE:
+		if (length != (sizeof(*request) + count * 2))
+			break;
+
+		registers_set(request->page, request->offset, &request->regs[0], count);
+
+		reply.frame.code = PX4IO_SERIAL_OK;
+		break;
+
+	case PX4IO_SERIAL_READ: {
+			uint16_t *regs;
+			unsigned reg_count;
+
+			if ((count > PX4IO_SERIAL_MAX_REGS) ||
+			    registers_get(request->page, request->offset, &regs, &reg_count))
+				break;
+
+			/* short pages are padded with zeroes */
+			for (unsigned i = 0; i < count; i++)
+				reply.frame.regs[i] = (i < reg_count) ? regs[i] : 0;
+
+			reply.frame.code = PX4IO_SERIAL_OK | count;
+			reply_len += count * 2;
+			break;
+		}
+
+	default:
+		break;
+	}
+
+	if (reply.frame.code == PX4IO_SERIAL_ERROR)
+		serial_errors++;
+
+	serial_tx_queue(&reply, reply_len);
+}
+
+static void
+serial_tx_queue(const void *data, size_t length)
+{
+	irqstate_t flags = irqsave();
+
+	ssize_t len = hx_stream_encode(&tx_buf[tx_head], sizeof(tx_buf) - tx_head, data, length);
+
+	if (len > 0) {
+		tx_head += len;
+
+		if (!tx_busy)
+			serial_tx_start();
+
+	} else {
+		/* no room; FMU will time out and retry the request */
+		serial_errors++;
+	}
+
+	irqrestore(flags);
+}
+
+static void
+serial_tx_start(void)
+{
+	tx_busy = true;
+	tx_pending = tx_head;
+
+	stm32_dmasetup(tx_dma, (uintptr_t)&rDR, (uintptr_t)&tx_buf[tx_sent], tx_pending - tx_sent,
+		DMA_CCR_DIR |
+		DMA_CCR_MINC |
+		DMA_CCR_PSIZE_8BITS |
+		DMA_CCR_MSIZE_8BITS |
+		DMA_CCR_PRIMED);
+
+	stm32_dmastart(tx_dma, serial_tx_dma_callback, NULL, false);
+}
+
+static void
+serial_tx_dma_callback(DMA_HANDLE handle, uint8_t status, void *arg)
+{
+	stm32_dmastop(tx_dma);
+
+	tx_sent = tx_pending;
+
+	if (tx_sent < tx_head) {
+		/* more replies were queued while this batch was going out */
+		serial_tx_start();
+
+	} else {
+		/* all sent, start over at the front of the buffer */
+		tx_head = 0;
+		tx_sent = 0;
+		tx_busy = false;
+	}
+}
@@ -140,7 +140,7 @@ usage(const char *reason)
 	if (reason)
 		fprintf(stderr, "%s\n", reason);
 
-	errx(1, "usage: sdlog {start|stop|status} [-s <number of skipped lines>]\n\n");
+	errx(1, "usage: sdlog {start|stop|status} [-s <number of skipped lines>] [-r] [-t]\n\n");
 }
 
 // XXX turn this into a C++ class
@@ -154,6 +154,9 @@ uint64_t starttime = 0;
 /* logging on or off, default to true */
 bool logging_enabled = true;
 
+/* stream the records over MAVLink instead of writing them to the SD card */
+static bool tethered = false;
+
 /**
  * The sd log deamon app only briefly exists to start
  * the background job. The stack size assigned in the
@@ -292,14 +295,15 @@ sdlog_sysvector_write_thread(void *arg)
 			sysvector_bytes += write(sysvector_file, (const char *)&sysvect, sizeof(sysvect));
 		}
 
-		if (poll_count % 100 == 0) {
+		if (poll_count % 100 == 0 && !tethered) {
 			fsync(sysvector_file);
 		}
 
 		poll_count++;
 	}
 
-	fsync(sysvector_file);
+	if (!tethered)
+		fsync(sysvector_file);
 
 	return OK;
 }
@@ -341,15 +345,15 @@ int sdlog_thread_main(int argc, char *argv[])
 	argv += 2;
 	int ch;
 
-	while ((ch = getopt(argc, argv, "s:r")) != EOF) {
+	while ((ch = getopt(argc, argv, "s:rt")) != EOF) {
 		switch (ch) {
 		case 's':
 			{
-			/* log only every n'th (gyro clocked) value */
+			/* log only every n'th (gyro clocked) value, 0 logs every value */
 			unsigned s = strtoul(optarg, NULL, 10);
 
-			if (s < 1 || s > 250) {
-				errx(1, "Wrong skip value of %d, out of range (1..250)\n", s);
+			if (s > 250) {
+				errx(1, "Wrong skip value of %d, out of range (0..250)\n", s);
 			} else {
 				skip_value = s;
 			}
@@ -361,6 +365,11 @@ int sdlog_thread_main(int argc, char *argv[])
 			logging_enabled = false;
 			break;
 
+		case 't':
+			/* tethered, stream over MAVLink (USB) instead of logging to the SD card */
+			tethered = true;
+			break;
+
 		case '?':
 			if (optopt == 'c') {
 				warnx("Option -%c requires an argument.\n", optopt);
@@ -376,49 +385,61 @@ int sdlog_thread_main(int argc, char *argv[])
 		}
 	}
 
-	if (file_exist(mountpoint) != OK) {
-		errx(1, "logging mount point %s not present, exiting.", mountpoint);
-	}
+	FILE *gpsfile = NULL;
+	FILE *blackbox_file = NULL;
 
-	char folder_path[64];
+	if (tethered) {
+		/* records go to the MAVLink log stream, the SD card is not touched */
+		sysvector_file = open(MAVLINK_LOG_DEVICE, O_WRONLY);
 
-	if (create_logfolder(folder_path))
-		errx(1, "unable to create logging folder, exiting.");
+		if (sysvector_file < 0 || ioctl(sysvector_file, MAVLINK_IOC_LOGSTREAM_START, sizeof(struct sdlog_sysvector)) != OK) {
+			errx(1, "starting the MAVLink log stream failed, start mavlink app first.");
+		}
 
-	FILE *gpsfile;
-	FILE *blackbox_file;
+		warnx("streaming to MAVLink\n");
 
-	/* string to hold the path to the sensorfile */
-	char path_buf[64] = "";
+	} else {
+		if (file_exist(mountpoint) != OK) {
+			errx(1, "logging mount point %s not present, exiting.", mountpoint);
+		}
 
-	/* only print logging path, important to find log file later */
-	warnx("logging to directory %s\n", folder_path);
+		char folder_path[64];
 
-	/* set up file path: e.g. /mnt/sdcard/session0001/actuator_controls0.bin */
-	sprintf(path_buf, "%s/%s.bin", folder_path, "sysvector");
+		if (create_logfolder(folder_path))
+			errx(1, "unable to create logging folder, exiting.");
 
-	if (0 == (sysvector_file = open(path_buf, O_CREAT | O_WRONLY | O_DSYNC))) {
-		errx(1, "opening %s failed.\n", path_buf);
-	}
+		/* string to hold the path to the sensorfile */
+		char path_buf[64] = "";
 
-	/* set up file path: e.g. /mnt/sdcard/session0001/gps.txt */
-	sprintf(path_buf, "%s/%s.txt", folder_path, "gps");
+		/* only print logging path, important to find log file later */
+		warnx("logging to directory %s\n", folder_path);
 
-	if (NULL == (gpsfile = fopen(path_buf, "w"))) {
-		errx(1, "opening %s failed.\n", path_buf);
-	}
+		/* set up file path: e.g. /mnt/sdcard/session0001/actuator_controls0.bin */
+		sprintf(path_buf, "%s/%s.bin", folder_path, "sysvector");
+
+		if (0 == (sysvector_file = open(path_buf, O_CREAT | O_WRONLY | O_DSYNC))) {
+			errx(1, "opening %s failed.\n", path_buf);
+		}
 
-	int gpsfile_no = fileno(gpsfile);
+		/* set up file path: e.g. /mnt/sdcard/session0001/gps.txt */
+		sprintf(path_buf, "%s/%s.txt", folder_path, "gps");
 
-	/* set up file path: e.g. /mnt/sdcard/session0001/blackbox.txt */
-	sprintf(path_buf, "%s/%s.txt", folder_path, "blackbox");
+		if (NULL == (gpsfile = fopen(path_buf, "w"))) {
+			errx(1, "opening %s failed.\n", path_buf);
+		}
 
-	if (NULL == (blackbox_file = fopen(path_buf, "w"))) {
-		errx(1, "opening %s failed.\n", path_buf);
-	}
+		int gpsfile_no = fileno(gpsfile);
 
-	// XXX for fsync() calls
-	int blackbox_file_no = fileno(blackbox_file);
+		/* set up file path: e.g. /mnt/sdcard/session0001/blackbox.txt */
+		sprintf(path_buf, "%s/%s.txt", folder_path, "blackbox");
+
+		if (NULL == (blackbox_file = fopen(path_buf, "w"))) {
+			errx(1, "opening %s failed.\n", path_buf);
+		}
+
+		// XXX for fsync() calls
+		int blackbox_file_no = fileno(blackbox_file);
+	}
 
 	/* --- IMPORTANT: DEFINE NUMBER OF ORB STRUCTS TO WAIT FOR HERE --- */
 	/* number of messages */
@@ -580,8 +601,8 @@ int sdlog_thread_main(int argc, char *argv[])
 
 	thread_running = true;
 
-	/* initialize log buffer with a size of 10 */
-	sdlog_logbuffer_init(&lb, 10);
+	/* initialize log buffer with a size of 10, more when streaming at full sensor rate */
+	sdlog_logbuffer_init(&lb, tethered ? 32 : 10);
 
 	/* initialize thread synchronization */
 	pthread_mutex_init(&sysvector_mutex, NULL);
@@ -615,9 +636,10 @@ int sdlog_thread_main(int argc, char *argv[])
 				orb_copy(ORB_ID(vehicle_command), subs.cmd_sub, &buf.cmd);
 
 				/* always log to blackbox, even when logging disabled */
-				blackbox_file_bytes += fprintf(blackbox_file, "[%10.4f\tVCMD] CMD #%d [%f\t%f\t%f\t%f\t%f\t%f\t%f]\n", hrt_absolute_time()/1000000.0d,
-					buf.cmd.command, (double)buf.cmd.param1, (double)buf.cmd.param2, (double)buf.cmd.param3, (double)buf.cmd.param4,
-					(double)buf.cmd.param5, (double)buf.cmd.param6, (double)buf.cmd.param7);
+				if (blackbox_file != NULL)
+					blackbox_file_bytes += fprintf(blackbox_file, "[%10.4f\tVCMD] CMD #%d [%f\t%f\t%f\t%f\t%f\t%f\t%f]\n", hrt_absolute_time()/1000000.0d,
+						buf.cmd.command, (double)buf.cmd.param1, (double)buf.cmd.param2, (double)buf.cmd.param3, (double)buf.cmd.param4,
+						(double)buf.cmd.param5, (double)buf.cmd.param6, (double)buf.cmd.param7);
 
 				handle_command(&buf.cmd);
 			}
@@ -728,10 +750,17 @@ int sdlog_thread_main(int argc, char *argv[])
 
 	warnx("exiting.\n\n");
 
-	/* finish KML file */
-	// XXX
-	fclose(gpsfile);
-	fclose(blackbox_file);
+	if (tethered) {
+		/* send the rest and announce the stream length */
+		ioctl(sysvector_file, MAVLINK_IOC_LOGSTREAM_STOP, 0);
+		close(sysvector_file);
+
+	} else {
+		/* finish KML file */
+		// XXX
+		fclose(gpsfile);
+		fclose(blackbox_file);
+	}
 
 	thread_running = false;
 
@@ -109,6 +109,116 @@
  */
 extern "C" __EXPORT int sensors_main(int argc, char *argv[]);
 
+/**
+ * Short history of timestamped three-axis samples from one sensor.
+ *
+ * Used to align sensors that are not sampled together with the gyro
+ * to the gyro sample time.
+ */
+class SampleHistory
+{
+public:
+	SampleHistory() : _count(0), _next(0) {}
+
+	/**
+	 * Add a sample to the history, discarding the oldest if full.
+	 *
+	 * Samples must be added in timestamp order; a sample that is not newer
+	 * than the latest one is ignored.
+	 */
+	void		push(hrt_abstime t, float x, float y, float z);
+
+	/**
+	 * Estimate the sensor value at a given time.
+	 *
+	 * Interpolates linearly between the samples bracketing t. Outside the
+	 * span of the history the nearest sample is held.
+	 *
+	 * @param t		The time for which a value is wanted.
+	 * @param v		Returns the estimated value, untouched if there is no history.
+	 * @param age		Returns t minus the effective time of the estimate in
+	 *			microseconds; zero if interpolated, negative if the value
+	 *			is newer than t.
+	 * @return		True if there was any history to work from.
+	 */
+	bool		sample_at(hrt_abstime t, float v[3], int32_t &age) const;
+
+private:
+	static const unsigned	_size = 4;	/**< must be a power of two */
+
+	struct sample {
+		hrt_abstime	t;
+		float		v[3];
+	};
+
+	sample		_samples[_size];
+	unsigned	_count;
+	unsigned	_next;
+
+	/** n-th oldest sample in the history */
+	const sample	&entry(unsigned n) const { return _samples[(_next - _count + n) & (_size - 1)]; }
+};
+
+void
+SampleHistory::push(hrt_abstime t, float x, float y, float z)
+{
+	if ((_count > 0) && (t <= entry(_count - 1).t))
+		return;
+
+	_samples[_next].t = t;
+	_samples[_next].v[0] = x;
+	_samples[_next].v[1] = y;
+	_samples[_next].v[2] = z;
+	_next = (_next + 1) & (_size - 1);
+
+	if (_count < _size)
+		_count++;
+}
+
+bool
+SampleHistory::sample_at(hrt_abstime t, float v[3], int32_t &age) const
+{
+	const sample *before = nullptr;
+	const sample *after = nullptr;
+
+	if (_count == 0)
+		return false;
+
+	/* find the newest sample at or before t and the first one after it */
+	for (unsigned i = 0; i < _count; i++) {
+		const sample &s = entry(i);
+
+		if (s.t <= t) {
+			before = &s;
+
+		} else {
+			after = &s;
+			break;
+		}
+	}
+
+	if ((before != nullptr) && (after != nullptr)) {
+		float k = (float)(t - before->t) / (float)(after->t - before->t);
+
+		for (unsigned i = 0; i < 3; i++)
+			v[i] = before->v[i] + k * (after->v[i] - before->v[i]);
+
+		age = 0;
+
+	} else {
+		const sample *nearest = (before != nullptr) ? before : after;
+		int64_t delta = (int64_t)t - (int64_t)nearest->t;
+
+		for (unsigned i = 0; i < 3; i++)
+			v[i] = nearest->v[i];
+
+		/* saturate, a sensor that has stopped reporting can get very old */
+		age = (delta > INT32_MAX) ? INT32_MAX : (int32_t)delta;
+	}
+
+	return true;
+}
+
 class Sensors
 {
 public:
@@ -143,7 +253,7 @@ private:
 
 	/* XXX should not be here - should be own driver */
 	int 		_fd_adc;			/**< ADC driver handle */
-	hrt_abstime	_last_adc;			/**< last time we took input from the ADC */
+	hrt_abstime	_last_adc;			/**< timestamp of the last ADC report processed */
 
 	bool 		_task_should_exit;		/**< if true, sensor task should exit */
 	int 		_sensors_task;			/**< task handle for sensor task */
@@ -173,6 +283,10 @@ private:
 	struct baro_report _barometer;			/**< barometer data */
 	struct differential_pressure_s _differential_pressure;
 
+	SampleHistory	_accel_history;			/**< recent accel samples, m/s^2 */
+	SampleHistory	_mag_history;			/**< recent mag samples, Ga */
+	SampleHistory	_baro_history;			/**< recent baro samples, mbar / m / degC */
+
 	struct {
 		float min[_rc_max_chan_count];
 		float trim[_rc_max_chan_count];
@@ -330,6 +444,17 @@ private:
 	 */
 	void		baro_poll(struct sensor_combined_s &raw);
 
+	/**
+	 * Align the accel, mag and baro values to the gyro sample time.
+	 *
+	 * Fills the SI accel, mag and baro fields and their ages from the
+	 * sample histories, based on the timestamp of the latest gyro sample.
+	 *
+	 * @param raw			Combined sensor data structure into which
+	 *				data should be returned.
+	 */
+	void		align_samples(struct sensor_combined_s &raw);
+
 	/**
 	 * Check for changes in vehicle status.
 	 */
@@ -811,9 +936,8 @@ Sensors::accel_poll(struct sensor_combined_s &raw)
 
 		orb_copy(ORB_ID(sensor_accel), _accel_sub, &accel_report);
 
-		raw.accelerometer_m_s2[0] = accel_report.x;
-		raw.accelerometer_m_s2[1] = accel_report.y;
-		raw.accelerometer_m_s2[2] = accel_report.z;
+		/* SI values are filled in by align_samples() */
+		_accel_history.push(accel_report.timestamp, accel_report.x, accel_report.y, accel_report.z);
 
 		raw.accelerometer_raw[0] = accel_report.x_raw;
 		raw.accelerometer_raw[1] = accel_report.y_raw;
@@ -834,6 +958,9 @@ Sensors::gyro_poll(struct sensor_combined_s &raw)
 
 		orb_copy(ORB_ID(sensor_gyro), _gyro_sub, &gyro_report);
 
+		/* the gyro paces the output, everything else is aligned to it */
+		raw.timestamp = gyro_report.timestamp;
+
 		raw.gyro_rad_s[0] = gyro_report.x;
 		raw.gyro_rad_s[1] = gyro_report.y;
 		raw.gyro_rad_s[2] = gyro_report.z;
@@ -857,9 +984,8 @@ Sensors::mag_poll(struct sensor_combined_s &raw)
 
 		orb_copy(ORB_ID(sensor_mag), _mag_sub, &mag_report);
 
-		raw.magnetometer_ga[0] = mag_report.x;
-		raw.magnetometer_ga[1] = mag_report.y;
-		raw.magnetometer_ga[2] = mag_report.z;
+		/* SI values are filled in by align_samples() */
+		_mag_history.push(mag_report.timestamp, mag_report.x, mag_report.y, mag_report.z);
 
 		raw.magnetometer_raw[0] = mag_report.x_raw;
 		raw.magnetometer_raw[1] = mag_report.y_raw;
@@ -879,14 +1005,28 @@ Sensors::baro_poll(struct sensor_combined_s &raw)
 
 		orb_copy(ORB_ID(sensor_baro), _baro_sub, &_barometer);
 
-		raw.baro_pres_mbar = _barometer.pressure; // Pressure in mbar
-		raw.baro_alt_meter = _barometer.altitude; // Altitude in meters
-		raw.baro_temp_celcius = _barometer.temperature; // Temperature in degrees celcius
+		/* pressure in mbar, altitude in meters, temperature in degrees celsius; filled in by align_samples() */
+		_baro_history.push(_barometer.timestamp, _barometer.pressure, _barometer.altitude, _barometer.temperature);
 
 		raw.baro_counter++;
 	}
 }
 
+void
+Sensors::align_samples(struct sensor_combined_s &raw)
+{
+	float baro[3];
+
+	_accel_history.sample_at(raw.timestamp, raw.accelerometer_m_s2, raw.accelerometer_age_us);
+	_mag_history.sample_at(raw.timestamp, raw.magnetometer_ga, raw.magnetometer_age_us);
+
+	if (_baro_history.sample_at(raw.timestamp, baro, raw.baro_age_us)) {
+		raw.baro_pres_mbar = baro[0];
+		raw.baro_alt_meter = baro[1];
+		raw.baro_temp_celcius = baro[2];
+	}
+}
+
 void
 Sensors::vehicle_status_poll()
 {
@@ -991,92 +1131,91 @@ void
 Sensors::adc_poll(struct sensor_combined_s &raw)
 {
 
-	/* rate limit to 100 Hz */
-	if (hrt_absolute_time() - _last_adc >= 10000) {
-		/* make space for a maximum of eight channels */
-		struct adc_msg_s buf_adc[8];
-		/* read all channels available */
-		int ret = read(_fd_adc, &buf_adc, sizeof(buf_adc));
+	struct adc_report report;
 
-		for (unsigned i = 0; i < sizeof(buf_adc) / sizeof(buf_adc[0]); i++) {
-			
-			if (ret >= (int)sizeof(buf_adc[0])) {
+	/* fetch the latest block average; the driver produces one every 10 ms */
+	if (ioctl(_fd_adc, ADC_GET_REPORT, (unsigned long)&report) != OK)
+		return;
 
-				/* Save raw voltage values */
-				if (i < (sizeof(raw.adc_voltage_v)) / sizeof(raw.adc_voltage_v[0])) {
-					 raw.adc_voltage_v[i] = buf_adc[i].am_data / (4096.0f / 3.3f);
-				}
+	/* only act on a block we have not seen yet */
+	if (report.timestamp != _last_adc) {
 
-				/* look for specific channels and process the raw voltage to measurement data */
-				if (ADC_BATTERY_VOLTAGE_CHANNEL == buf_adc[i].am_channel) {
-					/* Voltage in volts */
-					float voltage = (buf_adc[i].am_data * _parameters.battery_voltage_scaling);
+		for (unsigned i = 0; i < report.channel_count; i++) {
 
-					if (voltage > VOLTAGE_BATTERY_IGNORE_THRESHOLD_VOLTS) {
+			/* Save raw voltage values */
+			if (i < (sizeof(raw.adc_voltage_v)) / sizeof(raw.adc_voltage_v[0])) {
+				 raw.adc_voltage_v[i] = report.data[i] / (4096.0f / 3.3f);
+			}
+
+			/* look for specific channels and process the raw voltage to measurement data */
+			if (ADC_BATTERY_VOLTAGE_CHANNEL == report.channel[i]) {
+				/* Voltage in volts */
+				float voltage = (report.data[i] * _parameters.battery_voltage_scaling);
 
-						/* one-time initialization of low-pass value to avoid long init delays */
-						if (_battery_status.voltage_v < 3.0f) {
-							_battery_status.voltage_v = voltage;
-						}
+				if (voltage > VOLTAGE_BATTERY_IGNORE_THRESHOLD_VOLTS) {
 
-						_battery_status.timestamp = hrt_absolute_time();
-						_battery_status.voltage_v = (BAT_VOL_LOWPASS_1 * (_battery_status.voltage_v + BAT_VOL_LOWPASS_2 * voltage));;
-						/* current and discharge are unknown */
-						_battery_status.current_a = -1.0f;
-						_battery_status.discharged_mah = -1.0f;
+					/* one-time initialization of low-pass value to avoid long init delays */
+					if (_battery_status.voltage_v < 3.0f) {
+						_battery_status.voltage_v = voltage;
+					}
 
-						/* announce the battery voltage if needed, just publish else */
-						if (_battery_pub > 0) {
-							orb_publish(ORB_ID(battery_status), _battery_pub, &_battery_status);
+					_battery_status.timestamp = report.timestamp;
+					_battery_status.voltage_v = (BAT_VOL_LOWPASS_1 * (_battery_status.voltage_v + BAT_VOL_LOWPASS_2 * voltage));;
+					/* current and discharge are unknown */
+					_battery_status.current_a = -1.0f;
+					_battery_status.discharged_mah = -1.0f;
 
-						} else {
-							_battery_pub = orb_advertise(ORB_ID(battery_status), &_battery_status);
-						}
-					} 
+					/* announce the battery voltage if needed, just publish else */
+					if (_battery_pub > 0) {
+						orb_publish(ORB_ID(battery_status), _battery_pub, &_battery_status);
+
+					} else {
+						_battery_pub = orb_advertise(ORB_ID(battery_status), &_battery_status);
+					}
+				} 
 
-				} else if (ADC_AIRSPEED_VOLTAGE_CHANNEL == buf_adc[i].am_channel) {
+			} else if (ADC_AIRSPEED_VOLTAGE_CHANNEL == report.channel[i]) {
 
-					/* calculate airspeed, raw is the difference from */
-					float voltage = (float)(buf_adc[i].am_data ) * 3.3f / 4096.0f * 2.0f; //V_ref/4096 * (voltage divider factor)
+				/* calculate airspeed, raw is the difference from */
+				float voltage = (float)(report.data[i] ) * 3.3f / 4096.0f * 2.0f; //V_ref/4096 * (voltage divider factor)
 
-					/**
-					 * The voltage divider pulls the signal down, only act on
-					 * a valid voltage from a connected sensor
-					 */
-					if (voltage > 0.4f) {
+				/**
+				 * The voltage divider pulls the signal down, only act on
+				 * a valid voltage from a connected sensor
+				 */
+				if (voltage > 0.4f) {
 
-						float diff_pres_pa = (voltage - _parameters.airspeed_offset) * 1000.0f; //for MPXV7002DP sensor
+					float diff_pres_pa = (voltage - _parameters.airspeed_offset) * 1000.0f; //for MPXV7002DP sensor
 
-						float airspeed_true = calc_true_airspeed(diff_pres_pa + _barometer.pressure*1e2f,
-							_barometer.pressure*1e2f, _barometer.temperature - 5.0f); //factor 1e2 for conversion from mBar to Pa
-						// XXX HACK - true temperature is much less than indicated temperature in baro,
-						// subtract 5 degrees in an attempt to account for the electrical upheating of the PCB
+					float airspeed_true = calc_true_airspeed(diff_pres_pa + _barometer.pressure*1e2f,
+						_barometer.pressure*1e2f, _barometer.temperature - 5.0f); //factor 1e2 for conversion from mBar to Pa
+					// XXX HACK - true temperature is much less than indicated temperature in baro,
+					// subtract 5 degrees in an attempt to account for the electrical upheating of the PCB
 
-						float airspeed_indicated = calc_indicated_airspeed(diff_pres_pa);
+					float airspeed_indicated = calc_indicated_airspeed(diff_pres_pa);
 
-						//printf("voltage: %.4f, diff_pres_pa %.4f, baro press %.4f Pa, v_ind %.4f, v_true %.4f\n", (double)voltage, (double)diff_pres_pa, (double)_barometer.pressure*1e2f, (double)airspeed_indicated, (double)airspeed_true);
+					//printf("voltage: %.4f, diff_pres_pa %.4f, baro press %.4f Pa, v_ind %.4f, v_true %.4f\n", (double)voltage, (double)diff_pres_pa, (double)_barometer.pressure*1e2f, (double)airspeed_indicated, (double)airspeed_true);
 
-						_differential_pressure.timestamp = hrt_absolute_time();
-						_differential_pressure.static_pressure_mbar = _barometer.pressure;
-						_differential_pressure.differential_pressure_mbar = diff_pres_pa*1e-2f;
-						_differential_pressure.temperature_celcius = _barometer.temperature;
-						_differential_pressure.indicated_airspeed_m_s = airspeed_indicated;
-						_differential_pressure.true_airspeed_m_s = airspeed_true;
-						_differential_pressure.voltage = voltage;
+					_differential_pressure.timestamp = report.timestamp;
+					_differential_pressure.static_pressure_mbar = _barometer.pressure;
+					_differential_pressure.differential_pressure_mbar = diff_pres_pa*1e-2f;
+					_differential_pressure.temperature_celcius = _barometer.temperature;
+					_differential_pressure.indicated_airspeed_m_s = airspeed_indicated;
+					_differential_pressure.true_airspeed_m_s = airspeed_true;
+					_differential_pressure.voltage = voltage;
 
-						/* announce the airspeed if needed, just publish else */
-						if (_airspeed_pub > 0) {
-							orb_publish(ORB_ID(differential_pressure), _airspeed_pub, &_differential_pressure);
+					/* announce the airspeed if needed, just publish else */
+					if (_airspeed_pub > 0) {
+						orb_publish(ORB_ID(differential_pressure), _airspeed_pub, &_differential_pressure);
 
-						} else {
-							_airspeed_pub = orb_advertise(ORB_ID(differential_pressure), &_differential_pressure);
-						}
+					} else {
+						_airspeed_pub = orb_advertise(ORB_ID(differential_pressure), &_differential_pressure);
 					}
 				}
-
-				_last_adc = hrt_absolute_time();
 			}
 		}
+
+		_last_adc = report.timestamp;
 	}
 }
 
@@ -1334,6 +1473,7 @@ Sensors::task_main()
 	gyro_poll(raw);
 	mag_poll(raw);
 	baro_poll(raw);
+	align_samples(raw);
 
 	parameter_update_poll(true /* forced */);
 
@@ -1370,15 +1510,15 @@ Sensors::task_main()
 		/* check parameters for updates */
 		parameter_update_poll();
 
-		/* store the time closest to all measurements (this is bogus, sensor timestamps should be propagated...) */
-		raw.timestamp = hrt_absolute_time();
-
-		/* copy most recent sensor data */
+		/* copy most recent sensor data; the gyro sample time becomes the timestamp */
 		gyro_poll(raw);
 		accel_poll(raw);
 		mag_poll(raw);
 		baro_poll(raw);
 
+		/* bring everything else to the gyro sample time */
+		align_samples(raw);
+
 		/* check battery voltage */
 		adc_poll(raw);
 
@@ -41,6 +41,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <drivers/drv_hrt.h>
+
 #include "systemlib/perf_counter.h"
 
 
@@ -69,7 +71,12 @@ int perf_main(int argc, char *argv[])
 			perf_reset_all();
 			return 0;
 		}
-		printf("Usage: perf <reset>\n");
+		if (strcmp(argv[1], "latency") == 0) {
+			hrt_print_latency();
+			fflush(stdout);
+			return 0;
+		}
+		printf("Usage: perf <reset|latency>\n");
 		return -1;
 	}
 
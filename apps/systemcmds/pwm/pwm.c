@@ -71,10 +71,11 @@ usage(const char *reason)
 		warnx("%s", reason);
 	errx(1, 
 		"usage:\n"
-		"pwm [-v] [-d <device>] [-u <alt_rate>] [-c <channel group>] [arm|disarm] [<channel_value> ...]\n"
+		"pwm [-v] [-d <device>] [-u <alt_rate>|oneshot] [-c <channel group>] [arm|disarm] [<channel_value> ...]\n"
 		"  -v                 Print information about the PWM device\n"
 		"  <device>           PWM output device (defaults to " PWM_OUTPUT_DEVICE_PATH ")\n"
 		"  <alt_rate>         PWM update rate for channels in <alt_channel_mask>\n"
+		"  oneshot            Send a pulse on those channels whenever new values are set\n"
 		"  <channel_group>    Channel group that should update at the alternate rate (may be specified more than once)\n"
 		"  arm | disarm       Arm or disarm the ouptut\n"
 		"  <channel_value>... PWM output values in microseconds to assign to the PWM outputs\n"
@@ -89,6 +90,7 @@ pwm_main(int argc, char *argv[])
 {
 	const char *dev = PWM_OUTPUT_DEVICE_PATH;
 	unsigned alt_rate = 0;
+	bool alt_rate_set = false;
 	uint32_t alt_channel_groups = 0;
 	bool alt_channels_set = false;
 	bool print_info = false;
@@ -115,9 +117,14 @@ pwm_main(int argc, char *argv[])
 			break;
 
 		case 'u':
-			alt_rate = strtol(optarg, &ep, 0);
-			if (*ep != '\0')
-				usage("bad alt_rate value");
+			if (!strcmp(optarg, "oneshot")) {
+				alt_rate = PWM_RATE_ONESHOT;
+			} else {
+				alt_rate = strtol(optarg, &ep, 0);
+				if ((*ep != '\0') || (alt_rate == 0))
+					usage("bad alt_rate value");
+			}
+			alt_rate_set = true;
 			break;
 
 		case 'v':
@@ -137,7 +144,7 @@ pwm_main(int argc, char *argv[])
 		err(1, "can't open %s", dev);
 
 	/* change alternate PWM rate */
-	if (alt_rate > 0) {
+	if (alt_rate_set) {
 		ret = ioctl(fd, PWM_SERVO_SET_UPDATE_RATE, alt_rate);
 		if (ret != OK)
 			err(1, "PWM_SERVO_SET_UPDATE_RATE (check rate for sanity)");
@@ -0,0 +1,122 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file sched_trace.c
+ *
+ * Scheduler trace control.
+ */
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "systemlib/sched_trace.h"
+#include "systemlib/err.h"
+
+__EXPORT int sched_trace_main(int argc, char *argv[]);
+
+#define SCHED_TRACE_DEFAULT_EVENTS	2048
+#define SCHED_TRACE_DEFAULT_FILE	"/fs/microsd/sched.trc"
+
+static void
+usage(void)
+{
+	errx(1, "usage: sched_trace start [-w] [-n <events>] | stop | status | dump [<file>]\n"
+	     "  -w   keep the latest events instead of stopping when full\n"
+	     "  -n   ring size, default %u events, at most %u",
+	     SCHED_TRACE_DEFAULT_EVENTS, SCHED_TRACE_MAX_EVENTS);
+}
+
+int
+sched_trace_main(int argc, char *argv[])
+{
+	if (argc < 2)
+		usage();
+
+	if (!strcmp(argv[1], "start")) {
+		unsigned events = SCHED_TRACE_DEFAULT_EVENTS;
+		bool wrap = false;
+
+		for (int i = 2; i < argc; i++) {
+			if (!strcmp(argv[i], "-w")) {
+				wrap = true;
+
+			} else if (!strcmp(argv[i], "-n") && (i + 1) < argc) {
+				events = strtoul(argv[++i], NULL, 0);
+
+				if ((events == 0) || (events > SCHED_TRACE_MAX_EVENTS))
+					errx(1, "ring size must be 1 to %u events", SCHED_TRACE_MAX_EVENTS);
+
+			} else {
+				usage();
+			}
+		}
+
+		int ret = sched_trace_start(events, wrap);
+
+		if (ret != OK)
+			errx(1, "could not start: %s", strerror(-ret));
+
+		exit(0);
+	}
+
+	if (!strcmp(argv[1], "stop")) {
+		sched_trace_stop();
+		sched_trace_status();
+		exit(0);
+	}
+
+	if (!strcmp(argv[1], "status")) {
+		sched_trace_status();
+		exit(0);
+	}
+
+	if (!strcmp(argv[1], "dump")) {
+		const char *path = (argc > 2) ? argv[2] : SCHED_TRACE_DEFAULT_FILE;
+		int ret = sched_trace_dump(path);
+
+		if (ret != OK)
+			errx(1, "could not write %s: %s", path, strerror(-ret));
+
+		warnx("wrote %s", path);
+		exit(0);
+	}
+
+	usage();
+	return 1;
+}
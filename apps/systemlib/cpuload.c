@@ -51,6 +51,7 @@
 #include <drivers/drv_hrt.h>
 
 #include "cpuload.h"
+#include "sched_trace.h"
 
 #ifdef CONFIG_SCHED_INSTRUMENTATION
 
@@ -111,6 +112,8 @@ void cpuload_initialize_once()
 
 void sched_note_start(FAR _TCB *tcb)
 {
+	sched_trace_start_task(tcb);
+
 	/* search first free slot */
 	int i;
 
@@ -130,6 +133,8 @@ void sched_note_start(FAR _TCB *tcb)
 
 void sched_note_stop(FAR _TCB *tcb)
 {
+	sched_trace_stop_task(tcb);
+
 	int i;
 
 	for (i = 1; i < CONFIG_MAX_TASKS; i++) {
@@ -149,6 +154,8 @@ void sched_note_switch(FAR _TCB *pFromTcb, FAR _TCB *pToTcb)
 {
 	uint64_t new_time = hrt_absolute_time();
 
+	sched_trace_switch(pFromTcb, pToTcb);
+
 	/* Kind of inefficient: find both tasks and update times */
 	uint8_t both_found = 0;
 
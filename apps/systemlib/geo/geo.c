@@ -53,124 +53,105 @@
 #include <stdbool.h>
 
 
-/* values for map projection */
-static double phi_1;
-static double sin_phi_1;
-static double cos_phi_1;
-static double lambda_0;
-static double scale;
+/* mean earth radius, the same as in get_distance_to_next_waypoint() */
+#define GEO_RADIUS_EARTH	6371000.0
 
-__EXPORT void map_projection_init(double lat_0, double lon_0) //lat_0, lon_0 are expected to be in correct format: -> 47.1234567 and not 471234567
+/* reference of map_projection_init() */
+static struct map_projection_reference_s mp_ref;
+
+__EXPORT void map_projection_ref_init(struct map_projection_reference_s *ref, double lat_0, double lon_0) //lat_0, lon_0 are expected to be in correct format: -> 47.1234567 and not 471234567
 {
-	/* notation and formulas according to: http://mathworld.wolfram.com/AzimuthalEquidistantProjection.html */
-	phi_1 = lat_0 / 180.0 * M_PI;
-	lambda_0 = lon_0 / 180.0 * M_PI;
+	ref->lat = lat_0;
+	ref->lon = lon_0;
+	ref->sin_lat = sin(lat_0 * M_DEG_TO_RAD);
+	ref->cos_lat = cos(lat_0 * M_DEG_TO_RAD);
+	ref->init_done = true;
+}
 
-	sin_phi_1 = sin(phi_1);
-	cos_phi_1 = cos(phi_1);
+__EXPORT void map_projection_ref_project(const struct map_projection_reference_s *ref, double lat, double lon, float *x, float *y)
+{
+	/* notation and formulas according to: http://mathworld.wolfram.com/AzimuthalEquidistantProjection.html */
 
-	/* calculate local scale by using the relation of true distance and the distance on plane */ //TODO: this is a quick solution, there are probably easier ways to determine the scale
+	/* offsets from the reference are small, as float they still resolve millimeters */
+	double d_lon_deg = lon - ref->lon;
 
-	/* 1) calculate true distance d on sphere to a point: http://www.movable-type.co.uk/scripts/latlong.html */
-	const double r_earth = 6371000;
+	/* across the antimeridian the difference is close to 360 degrees, which float cannot resolve */
+	if (d_lon_deg > 180.0) {
+		d_lon_deg -= 360.0;
 
-	double lat1 = phi_1;
-	double lon1 = lambda_0;
+	} else if (d_lon_deg < -180.0) {
+		d_lon_deg += 360.0;
+	}
 
-	double lat2 = phi_1 + 0.5 / 180 * M_PI;
-	double lon2 = lambda_0 + 0.5 / 180 * M_PI;
-	double sin_lat_2 = sin(lat2);
-	double cos_lat_2 = cos(lat2);
-	double d = acos(sin(lat1) * sin_lat_2 + cos(lat1) * cos_lat_2 * cos(lon2 - lon1)) * r_earth;
+	float d_lat = (float)(lat - ref->lat) * M_DEG_TO_RAD_F;
+	float d_lon = (float)d_lon_deg * M_DEG_TO_RAD_F;
+	float sin_lat_0 = ref->sin_lat;
+	float cos_lat_0 = ref->cos_lat;
 
-	/* 2) calculate distance rho on plane */
-	double k_bar = 0;
-	double c =  acos(sin_phi_1 * sin_lat_2 + cos_phi_1 * cos_lat_2 * cos(lon2 - lambda_0));
+	float sin_d_lat = sinf(d_lat);
+	float sin_half_d_lon = sinf(0.5f * d_lon);
+	float one_minus_cos_d_lon = 2.0f * sin_half_d_lon * sin_half_d_lon; // 1 - cos(d_lon) without cancellation
 
-	if (0 != c)
-		k_bar = c / sin(c);
+	float cos_lat = cos_lat_0 * cosf(d_lat) - sin_lat_0 * sin_d_lat;
 
-	double x2 = k_bar * (cos_lat_2 * sin(lon2 - lambda_0)); //Projection of point 2 on plane
-	double y2 = k_bar * ((cos_phi_1 * sin_lat_2 - sin_phi_1 * cos_lat_2 * cos(lon2 - lambda_0)));
-	double rho = sqrt(pow(x2, 2) + pow(y2, 2));
+	/* cos(phi_1) * sin(phi) - sin(phi_1) * cos(phi) * cos(lambda - lambda_0), rewritten in terms of the small offsets */
+	float x_sin_c = sin_d_lat + sin_lat_0 * cos_lat * one_minus_cos_d_lon;
+	float y_sin_c = cos_lat * sinf(d_lon);
 
-	scale = d / rho;
+	/* k' = c / sin(c), series in sin(c); the next term is below 0.1 ppm within 1000 km */
+	float sin_c_sq = x_sin_c * x_sin_c + y_sin_c * y_sin_c;
+	float k_bar = 1.0f + sin_c_sq * (1.0f / 6.0f + sin_c_sq * (3.0f / 40.0f + sin_c_sq * (5.0f / 112.0f)));
 
+	*x = k_bar * x_sin_c * (float)GEO_RADIUS_EARTH;
+	*y = k_bar * y_sin_c * (float)GEO_RADIUS_EARTH;
 }
 
-__EXPORT void map_projection_project(double lat, double lon, float *x, float *y)
+__EXPORT void map_projection_ref_project_batch(const struct map_projection_reference_s *ref, const double *lat, const double *lon,
+		float *x, float *y, unsigned n)
 {
-	/* notation and formulas accoring to: http://mathworld.wolfram.com/AzimuthalEquidistantProjection.html */
-	double phi = lat / 180.0 * M_PI;
-	double lambda = lon / 180.0 * M_PI;
-
-	double sin_phi = sin(phi);
-	double cos_phi = cos(phi);
-
-	double k_bar = 0;
-	/* using small angle approximation (formula in comment is without aproximation) */
-	double c =  acos(sin_phi_1 * sin_phi + cos_phi_1 * cos_phi * (1 - pow((lambda - lambda_0), 2) / 2)); //double c =  acos( sin_phi_1 * sin_phi + cos_phi_1 * cos_phi * cos(lambda - lambda_0) );
-
-	if (0 != c)
-		k_bar = c / sin(c);
-
-	/* using small angle approximation (formula in comment is without aproximation) */
-	*y = k_bar * (cos_phi * (lambda - lambda_0)) * scale;//*y = k_bar * (cos_phi * sin(lambda - lambda_0)) * scale;
-	*x = k_bar * ((cos_phi_1 * sin_phi - sin_phi_1 * cos_phi * (1 - pow((lambda - lambda_0), 2) / 2))) * scale; //	*x = k_bar * ((cos_phi_1 * sin_phi - sin_phi_1 * cos_phi * cos(lambda - lambda_0))) * scale;
-
-//	printf("%phi_1=%.10f, lambda_0 =%.10f\n", phi_1, lambda_0);
+	for (unsigned i = 0; i < n; i++) {
+		map_projection_ref_project(ref, lat[i], lon[i], &x[i], &y[i]);
+	}
 }
 
-__EXPORT void map_projection_reproject(float x, float y, double *lat, double *lon)
+__EXPORT void map_projection_ref_reproject(const struct map_projection_reference_s *ref, float x, float y, double *lat, double *lon)
 {
 	/* notation and formulas accoring to: http://mathworld.wolfram.com/AzimuthalEquidistantProjection.html */
 
-	double x_descaled = x / scale;
-	double y_descaled = y / scale;
-
-	double c = sqrt(pow(x_descaled, 2) + pow(y_descaled, 2));
-	double sin_c = sin(c);
-	double cos_c = cos(c);
-
-	double lat_sphere = 0;
-
-	if (c != 0)
-		lat_sphere = asin(cos_c * sin_phi_1 + (x_descaled * sin_c * cos_phi_1) / c);
-	else
-		lat_sphere = asin(cos_c * sin_phi_1);
-
-//	printf("lat_sphere = %.10f\n",lat_sphere);
+	double x_descaled = x / GEO_RADIUS_EARTH;
+	double y_descaled = y / GEO_RADIUS_EARTH;
 
-	double lon_sphere = 0;
+	double c = sqrt(x_descaled * x_descaled + y_descaled * y_descaled);
 
-	if (phi_1  == M_PI / 2) {
-		//using small angle approximation (formula in comment is without aproximation)
-		lon_sphere = (lambda_0 - y_descaled / x_descaled); //lon_sphere = (lambda_0 + atan2(-y_descaled, x_descaled));
+	if (c == 0) {
+		*lat = ref->lat;
+		*lon = ref->lon;
+		return;
+	}
 
-	} else if (phi_1 == -M_PI / 2) {
-		//using small angle approximation (formula in comment is without aproximation)
-		lon_sphere = (lambda_0 + y_descaled / x_descaled); //lon_sphere = (lambda_0 + atan2(y_descaled, x_descaled));
+	double sin_c = sin(c);
+	double cos_c = cos(c);
 
-	} else {
+	double lat_sphere = asin(cos_c * ref->sin_lat + (x_descaled * sin_c * ref->cos_lat) / c);
+	double lon_sphere = atan2(y_descaled * sin_c, c * ref->cos_lat * cos_c - x_descaled * ref->sin_lat * sin_c);
 
-		lon_sphere = (lambda_0 + atan2(y_descaled * sin_c , c * cos_phi_1 * cos_c - x_descaled * sin_phi_1 * sin_c));
-		//using small angle approximation
-//    	double denominator = (c * cos_phi_1 * cos_c - x_descaled * sin_phi_1 * sin_c);
-//    	if(denominator != 0)
-//    	{
-//    		lon_sphere = (lambda_0 + (y_descaled * sin_c) / denominator);
-//    	}
-//    	else
-//    	{
-//    	...
-//    	}
-	}
+	*lat = lat_sphere * M_RAD_TO_DEG;
+	*lon = ref->lon + lon_sphere * M_RAD_TO_DEG;
+}
 
-//	printf("lon_sphere = %.10f\n",lon_sphere);
+__EXPORT void map_projection_init(double lat_0, double lon_0) //lat_0, lon_0 are expected to be in correct format: -> 47.1234567 and not 471234567
+{
+	map_projection_ref_init(&mp_ref, lat_0, lon_0);
+}
 
-	*lat = lat_sphere * 180.0 / M_PI;
-	*lon = lon_sphere * 180.0 / M_PI;
+__EXPORT void map_projection_project(double lat, double lon, float *x, float *y)
+{
+	map_projection_ref_project(&mp_ref, lat, lon, x, y);
+}
 
+__EXPORT void map_projection_reproject(float x, float y, double *lat, double *lon)
+{
+	map_projection_ref_reproject(&mp_ref, x, y, lat, lon);
 }
 
 
@@ -261,6 +242,48 @@ __EXPORT int get_distance_to_line(struct crosstrack_error_s * crosstrack_error,
 }
 
 
+__EXPORT int get_distance_to_line_local(struct crosstrack_error_s * crosstrack_error, float x_now, float y_now,
+		float x_start, float y_start, float x_end, float y_end)
+{
+	// Planar version of get_distance_to_line(): the sine of the bearing difference is the cross product of the
+	// track direction and the vector to the end point, past the end is a negative dot product.
+
+	float track_x = x_end - x_start;
+	float track_y = y_end - y_start;
+	float track_length = sqrtf(track_x * track_x + track_y * track_y);
+	float to_end_x = x_end - x_now;
+	float to_end_y = y_end - y_now;
+	float bearing_track;
+
+	crosstrack_error->past_end = false;
+	crosstrack_error->distance = 0.0f;
+	crosstrack_error->bearing = 0.0f;
+
+	// Return error if the track has no direction
+	if (!(track_length > 0.0f)) return ERROR;
+
+	track_x /= track_length;
+	track_y /= track_length;
+
+	// Return past_end = true if past end point of line
+	if (track_x * to_end_x + track_y * to_end_y < 0.0f) {
+		crosstrack_error->past_end = true;
+		return OK;
+	}
+
+	bearing_track = atan2f(track_y, track_x);
+	crosstrack_error->distance = track_y * to_end_x - track_x * to_end_y;
+
+	if (crosstrack_error->distance >= 0) {
+		crosstrack_error->bearing = _wrap_pi(bearing_track - M_PI_2_F);
+
+	} else {
+		crosstrack_error->bearing = _wrap_pi(bearing_track + M_PI_2_F);
+	}
+
+	return OK;
+}
+
 __EXPORT int get_distance_to_arc(struct crosstrack_error_s * crosstrack_error, double lat_now, double lon_now, double lat_center, double lon_center,
 		float radius, float arc_start_bearing, float arc_sweep)
 {
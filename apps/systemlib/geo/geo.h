@@ -54,6 +54,62 @@ struct crosstrack_error_s {
 	float bearing;		// Bearing in radians to closest point on line/arc
 } ;
 
+/**
+ * Reference point of a local azimuthal equidistant projection.
+ *
+ * Holds the trigonometry of the reference point, so projecting a point
+ * costs a handful of float operations instead of double precision
+ * trigonometry. Distances and bearings from the reference point are those
+ * on the sphere; within 1000 km of the reference the projection agrees
+ * with get_distance_to_next_waypoint() to better than 1 ppm.
+ */
+struct map_projection_reference_s {
+	double lat;		// Reference latitude in degrees
+	double lon;		// Reference longitude in degrees
+	double sin_lat;
+	double cos_lat;
+	bool init_done;
+};
+
+/**
+ * Initializes a map projection reference.
+ *
+ * @param lat_0 in degrees (47.1234567°, not 471234567°)
+ * @param lon_0 in degrees (8.1234567°, not 81234567°)
+ */
+__EXPORT void map_projection_ref_init(struct map_projection_reference_s *ref, double lat_0, double lon_0);
+
+/**
+ * Transforms a point in the geographic coordinate system to the local azimuthal equidistant plane of ref
+ *
+ * @param lat in degrees (47.1234567°, not 471234567°)
+ * @param lon in degrees (8.1234567°, not 81234567°)
+ * @param x north
+ * @param y east
+ */
+__EXPORT void map_projection_ref_project(const struct map_projection_reference_s *ref, double lat, double lon, float *x, float *y);
+
+/**
+ * Transforms n points to the local azimuthal equidistant plane of ref, e.g. all waypoints of a mission
+ *
+ * @param lat n latitudes in degrees
+ * @param lon n longitudes in degrees
+ * @param x n north coordinates
+ * @param y n east coordinates
+ */
+__EXPORT void map_projection_ref_project_batch(const struct map_projection_reference_s *ref, const double *lat, const double *lon,
+		float *x, float *y, unsigned n);
+
+/**
+ * Transforms a point in the local azimuthal equidistant plane of ref to the geographic coordinate system
+ *
+ * @param x north
+ * @param y east
+ * @param lat in degrees (47.1234567°, not 471234567°)
+ * @param lon in degrees (8.1234567°, not 81234567°)
+ */
+__EXPORT void map_projection_ref_reproject(const struct map_projection_reference_s *ref, float x, float y, double *lat, double *lon);
+
 /**
  * Initializes the map transformation.
  *
@@ -88,6 +144,17 @@ __EXPORT float get_bearing_to_next_waypoint(double lat_now, double lon_now, doub
 
 __EXPORT int get_distance_to_line(struct crosstrack_error_s * crosstrack_error, double lat_now, double lon_now, double lat_start, double lon_start, double lat_end, double lon_end);
 
+/**
+ * Crosstrack error to the line from start to end, in a local plane (see map_projection_ref_project())
+ *
+ * Same conventions as get_distance_to_line(), without any trigonometry but atan2f of the track.
+ *
+ * @param x_now north
+ * @param y_now east
+ */
+__EXPORT int get_distance_to_line_local(struct crosstrack_error_s * crosstrack_error, float x_now, float y_now,
+		float x_start, float y_start, float x_end, float y_end);
+
 __EXPORT int get_distance_to_arc(struct crosstrack_error_s * crosstrack_error, double lat_now, double lon_now, double lat_center, double lon_center,
 		float radius, float arc_start_bearing, float arc_sweep);
 
@@ -73,29 +73,22 @@ struct hx_stream {
 #define FBO	0x7e	/**< Frame Boundary Octet */
 #define CEO	0x7c	/**< Control Escape Octet */
 
-static void	hx_tx_raw(hx_stream_t stream, uint8_t c);
-static void	hx_tx_raw(hx_stream_t stream, uint8_t c);
+static unsigned	hx_encode_byte(uint8_t *p, uint8_t c);
 static int	hx_rx_frame(hx_stream_t stream);
 
-static void
-hx_tx_raw(hx_stream_t stream, uint8_t c)
-{
-	if (write(stream->fd, &c, 1) != 1)
-		stream->txerror = true;
-}
-
-static void
-hx_tx_byte(hx_stream_t stream, uint8_t c)
+static unsigned
+hx_encode_byte(uint8_t *p, uint8_t c)
 {
 	switch (c) {
 	case FBO:
 	case CEO:
-		hx_tx_raw(stream, CEO);
-		c ^= 0x20;
-		break;
+		p[0] = CEO;
+		p[1] = c ^ 0x20;
+		return 2;
 	}
 
-	hx_tx_raw(stream, c);
+	p[0] = c;
+	return 1;
 }
 
 static int
@@ -179,40 +172,62 @@ hx_stream_set_counters(hx_stream_t stream,
 	stream->pc_rx_errors = rx_errors;
 }
 
-int
-hx_stream_send(hx_stream_t stream,
-	       const void *data,
-	       size_t count)
+ssize_t
+hx_stream_encode(void *buf,
+		 size_t bufsize,
+		 const void *data,
+		 size_t count)
 {
 	union {
 		uint8_t	b[4];
 		uint32_t w;
 	} u;
 	const uint8_t *p = (const uint8_t *)data;
-	unsigned resid = count;
+	uint8_t *out = (uint8_t *)buf;
+	unsigned len = 0;
 
-	if (resid > HX_STREAM_MAX_FRAME)
+	if (count > HX_STREAM_MAX_FRAME)
 		return -EINVAL;
 
+	/* encoding can at most double the size, avoid checking every byte */
+	if (bufsize < HX_STREAM_MAX_ENCODED(count))
+		return -ENOSPC;
+
 	/* start the frame */
-	hx_tx_raw(stream, FBO);
+	out[len++] = FBO;
 
-	/* transmit the data */
-	while (resid--)
-		hx_tx_byte(stream, *p++);
+	/* encode the data */
+	for (unsigned i = 0; i < count; i++)
+		len += hx_encode_byte(&out[len], p[i]);
 
-	/* compute the CRC */
+	/* compute and encode the CRC */
 	u.w = crc32(data, count);
 
-	/* send the CRC */
-	p = &u.b[0];
-	resid = 4;
-
-	while (resid--)
-		hx_tx_byte(stream, *p++);
+	for (unsigned i = 0; i < 4; i++)
+		len += hx_encode_byte(&out[len], u.b[i]);
 
 	/* and the trailing frame separator */
-	hx_tx_raw(stream, FBO);
+	out[len++] = FBO;
+
+	return len;
+}
+
+int
+hx_stream_send(hx_stream_t stream,
+	       const void *data,
+	       size_t count)
+{
+	uint8_t buf[HX_STREAM_MAX_ENCODED(HX_STREAM_MAX_FRAME)];
+	ssize_t len;
+
+	len = hx_stream_encode(buf, sizeof(buf), data, count);
+
+	if (len < 0)
+		return len;
+
+	/* hand the whole frame to the driver at once */
+	if (write(stream->fd, buf, len) != len)
+		stream->txerror = true;
 
 	/* check for transmit error */
 	if (stream->txerror) {
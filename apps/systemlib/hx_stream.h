@@ -48,7 +48,10 @@
 struct hx_stream;
 typedef struct hx_stream *hx_stream_t;
 
-#define HX_STREAM_MAX_FRAME	64
+#define HX_STREAM_MAX_FRAME	128
+
+/** worst-case size of an encoded frame carrying _count bytes */
+#define HX_STREAM_MAX_ENCODED(_count)	(2 * ((_count) + 4) + 2)
 
 typedef void (* hx_stream_rx_callback)(void *arg, const void *data, size_t length);
 
@@ -108,6 +111,24 @@ __EXPORT extern int		hx_stream_send(hx_stream_t stream,
 		const void *data,
 		size_t count);
 
+/**
+ * Encode a frame into a buffer.
+ *
+ * Produces the same bytes hx_stream_send would transmit, so that
+ * several frames can be handed to a driver (or DMA) in one go.
+ *
+ * @param buf		Buffer to encode into.
+ * @param bufsize	Size of the buffer; HX_STREAM_MAX_ENCODED(count)
+ *			is always sufficient.
+ * @param data		Pointer to the data to encode.
+ * @param count		The number of bytes to encode.
+ * @return		The number of bytes encoded, or -errno on error.
+ */
+__EXPORT extern ssize_t		hx_stream_encode(void *buf,
+		size_t bufsize,
+		const void *data,
+		size_t count);
+
 /**
  * Handle a byte from the stream.
  *
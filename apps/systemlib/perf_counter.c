@@ -35,10 +35,20 @@
  * @file perf_counter.c
  *
  * @brief Performance measuring tools.
+ *
+ * Counters are updated with interrupts disabled for the few instructions
+ * the update takes, so they can be used from interrupt handlers and a
+ * snapshot is always consistent. The list of counters is protected by a
+ * semaphore, so it can be walked while counters come and go.
  */
 
+#include <nuttx/config.h>
+#include <nuttx/irq.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <semaphore.h>
 #include <sys/queue.h>
 #include <drivers/drv_hrt.h>
 
@@ -53,6 +63,18 @@ struct perf_ctr_header {
 	const char		*name;	/**< counter name */
 };
 
+/**
+ * Statistics of the measured times of a counter.
+ */
+struct perf_ctr_samples {
+	uint64_t		samples;
+	uint64_t		time_total;
+	uint64_t		time_sq_total;
+	uint64_t		time_least;
+	uint64_t		time_most;
+	uint32_t		histogram[PERF_HISTOGRAM_BUCKETS];
+};
+
 /**
  * PC_EVENT counter.
  */
@@ -68,9 +90,7 @@ struct perf_ctr_elapsed {
 	struct perf_ctr_header	hdr;
 	uint64_t		event_count;
 	uint64_t		time_start;
-	uint64_t		time_total;
-	uint64_t		time_least;
-	uint64_t		time_most;
+	struct perf_ctr_samples	elapsed;
 };
 
 /**
@@ -79,12 +99,9 @@ struct perf_ctr_elapsed {
 struct perf_ctr_interval {
 	struct perf_ctr_header	hdr;
 	uint64_t		event_count;
-	uint64_t		time_event;
 	uint64_t		time_first;
 	uint64_t		time_last;
-	uint64_t		time_least;
-	uint64_t		time_most;
-
+	struct perf_ctr_samples	interval;
 };
 
 /**
@@ -92,6 +109,44 @@ struct perf_ctr_interval {
  */
 static sq_queue_t	perf_counters;
 
+/**
+ * Lock for the list of counters.
+ */
+static sem_t		perf_counters_lock = SEM_INITIALIZER(1);
+
+/**
+ * Histogram bucket for a time.
+ */
+static unsigned
+perf_bucket(uint64_t time)
+{
+	unsigned index = 0;
+
+	while ((index < (PERF_HISTOGRAM_BUCKETS - 1)) && (time >= ((uint64_t)1 << index)))
+		index++;
+
+	return index;
+}
+
+/**
+ * Add a time to the statistics.
+ *
+ * Must be called with interrupts disabled.
+ */
+static void
+perf_samples_add(struct perf_ctr_samples *s, uint64_t time, unsigned bucket)
+{
+	if ((s->samples == 0) || (time < s->time_least))
+		s->time_least = time;
+
+	if (time > s->time_most)
+		s->time_most = time;
+
+	s->samples++;
+	s->time_total += time;
+	s->time_sq_total += time * time;
+	s->histogram[bucket]++;
+}
 
 perf_counter_t
 perf_alloc(enum perf_counter_type type, const char *name)
@@ -118,7 +173,10 @@ perf_alloc(enum perf_counter_type type, const char *name)
 	if (ctr != NULL) {
 		ctr->type = type;
 		ctr->name = name;
+
+		sem_wait(&perf_counters_lock);
 		sq_addfirst(&ctr->link, &perf_counters);
+		sem_post(&perf_counters_lock);
 	}
 
 	return ctr;
@@ -130,44 +188,46 @@ perf_free(perf_counter_t handle)
 	if (handle == NULL)
 		return;
 
+	sem_wait(&perf_counters_lock);
 	sq_rem(&handle->link, &perf_counters);
+	sem_post(&perf_counters_lock);
+
 	free(handle);
 }
 
 void
 perf_count(perf_counter_t handle)
 {
+	irqstate_t flags;
+
 	if (handle == NULL)
 		return;
 
 	switch (handle->type) {
 	case PC_COUNT:
+		flags = irqsave();
 		((struct perf_ctr_count *)handle)->event_count++;
+		irqrestore(flags);
 		break;
 
 	case PC_INTERVAL: {
 		struct perf_ctr_interval *pci = (struct perf_ctr_interval *)handle;
 		hrt_abstime now = hrt_absolute_time();
 
-		switch (pci->event_count) {
-		case 0:
+		flags = irqsave();
+
+		if (pci->event_count == 0) {
 			pci->time_first = now;
-			break;
-		case 1:
-			pci->time_least = now - pci->time_last;
-			pci->time_most = now - pci->time_last;
-			break;
-		default: {
+
+		} else {
 			hrt_abstime interval = now - pci->time_last;
-			if (interval < pci->time_least)
-				pci->time_least = interval;
-			if (interval > pci->time_most)
-				pci->time_most = interval;
-			break;
-		}
+			perf_samples_add(&pci->interval, interval, perf_bucket(interval));
 		}
+
 		pci->time_last = now;
 		pci->event_count++;
+
+		irqrestore(flags);
 		break;
 	}
 
@@ -201,16 +261,33 @@ perf_end(perf_counter_t handle)
 	switch (handle->type) {
 	case PC_ELAPSED: {
 			struct perf_ctr_elapsed *pce = (struct perf_ctr_elapsed *)handle;
-			hrt_abstime elapsed = hrt_absolute_time() - pce->time_start;
 
-			pce->event_count++;
-			pce->time_total += elapsed;
+			perf_set(handle, hrt_absolute_time() - pce->time_start);
+			break;
+		}
 
-			if ((pce->time_least > elapsed) || (pce->time_least == 0))
-				pce->time_least = elapsed;
+	default:
+		break;
+	}
+}
 
-			if (pce->time_most < elapsed)
-				pce->time_most = elapsed;
+void
+perf_set(perf_counter_t handle, uint64_t elapsed)
+{
+	if (handle == NULL)
+		return;
+
+	switch (handle->type) {
+	case PC_ELAPSED: {
+			struct perf_ctr_elapsed *pce = (struct perf_ctr_elapsed *)handle;
+			unsigned bucket = perf_bucket(elapsed);
+			irqstate_t flags = irqsave();
+
+			pce->event_count++;
+			perf_samples_add(&pce->elapsed, elapsed, bucket);
+
+			irqrestore(flags);
+			break;
 		}
 
 	default:
@@ -221,9 +298,13 @@ perf_end(perf_counter_t handle)
 void
 perf_reset(perf_counter_t handle)
 {
+	irqstate_t flags;
+
 	if (handle == NULL)
 		return;
 
+	flags = irqsave();
+
 	switch (handle->type) {
 	case PC_COUNT:
 		((struct perf_ctr_count *)handle)->event_count = 0;
@@ -233,85 +314,251 @@ perf_reset(perf_counter_t handle)
 		struct perf_ctr_elapsed *pce = (struct perf_ctr_elapsed *)handle;
 		pce->event_count = 0;
 		pce->time_start = 0;
-		pce->time_total = 0;
-		pce->time_least = 0;
-		pce->time_most = 0;
+		memset(&pce->elapsed, 0, sizeof(pce->elapsed));
 		break;
 	}
 
 	case PC_INTERVAL: {
 		struct perf_ctr_interval *pci = (struct perf_ctr_interval *)handle;
 		pci->event_count = 0;
-		pci->time_event = 0;
 		pci->time_first = 0;
 		pci->time_last = 0;
-		pci->time_least = 0;
-		pci->time_most = 0;
+		memset(&pci->interval, 0, sizeof(pci->interval));
 		break;
 	}
 	}
+
+	irqrestore(flags);
 }
 
-void
-perf_print_counter(perf_counter_t handle)
+int
+perf_snapshot(perf_counter_t handle, struct perf_counter_snapshot *snap)
 {
+	const struct perf_ctr_samples *s = NULL;
+	irqstate_t flags;
+
 	if (handle == NULL)
-		return;
+		return -EINVAL;
+
+	memset(snap, 0, sizeof(*snap));
+	snap->type = handle->type;
+
+	flags = irqsave();
+
+	snap->timestamp = hrt_absolute_time();
 
 	switch (handle->type) {
 	case PC_COUNT:
-		printf("%s: %llu events\n",
-		       handle->name,
-		       ((struct perf_ctr_count *)handle)->event_count);
+		snap->event_count = ((struct perf_ctr_count *)handle)->event_count;
 		break;
 
-	case PC_ELAPSED: {
-		struct perf_ctr_elapsed *pce = (struct perf_ctr_elapsed *)handle;
+	case PC_ELAPSED:
+		snap->event_count = ((struct perf_ctr_elapsed *)handle)->event_count;
+		s = &((struct perf_ctr_elapsed *)handle)->elapsed;
+		break;
 
-		printf("%s: %llu events, %lluus elapsed, min %lluus max %lluus\n",
-		       handle->name,
-		       pce->event_count,
-		       pce->time_total,
-		       pce->time_least,
-		       pce->time_most);
+	case PC_INTERVAL:
+		snap->event_count = ((struct perf_ctr_interval *)handle)->event_count;
+		s = &((struct perf_ctr_interval *)handle)->interval;
 		break;
 	}
 
-	case PC_INTERVAL: {
-		struct perf_ctr_interval *pci = (struct perf_ctr_interval *)handle;
+	if (s != NULL) {
+		snap->samples = s->samples;
+		snap->time_total = s->time_total;
+		snap->time_sq_total = s->time_sq_total;
+		snap->time_least = s->time_least;
+		snap->time_most = s->time_most;
+		memcpy(snap->histogram, s->histogram, sizeof(snap->histogram));
+	}
 
-		printf("%s: %llu events, %llu avg, min %lluus max %lluus\n",
-		       handle->name,
-		       pci->event_count,
-		       (pci->time_last - pci->time_first) / pci->event_count,
-		       pci->time_least,
-		       pci->time_most);
-		break;
+	irqrestore(flags);
+
+	return OK;
+}
+
+uint64_t
+perf_snapshot_mean(const struct perf_counter_snapshot *snap)
+{
+	if (snap->samples == 0)
+		return 0;
+
+	return snap->time_total / snap->samples;
+}
+
+uint64_t
+perf_snapshot_stddev(const struct perf_counter_snapshot *snap)
+{
+	if (snap->samples < 2)
+		return 0;
+
+	/* the sum squared overflows 64 bits quickly, so work in double */
+	double n = snap->samples;
+	double sum = snap->time_total;
+	double var = ((double)snap->time_sq_total - (sum * sum) / n) / n;
+
+	if (var <= 0.0)
+		return 0;
+
+	/* integer square root, no libm on IO */
+	uint64_t v = (uint64_t)(var + 0.5);
+	uint64_t root = 0;
+	uint64_t bit = (uint64_t)1 << 62;
+
+	while (bit > v)
+		bit >>= 2;
+
+	while (bit != 0) {
+		if (v >= root + bit) {
+			v -= root + bit;
+			root = (root >> 1) + bit;
+
+		} else {
+			root >>= 1;
+		}
+
+		bit >>= 2;
 	}
 
-	default:
-		break;
+	return root;
+}
+
+uint64_t
+perf_snapshot_percentile(const struct perf_counter_snapshot *snap, unsigned percent)
+{
+	uint64_t rank, seen = 0;
+	unsigned index;
+
+	if (snap->samples == 0)
+		return 0;
+
+	if (percent > 100)
+		percent = 100;
+
+	/* the sample we want, counting from 1 */
+	rank = (snap->samples * percent + 99) / 100;
+
+	if (rank == 0)
+		rank = 1;
+
+	for (index = 0; index < PERF_HISTOGRAM_BUCKETS; index++) {
+		uint64_t count = snap->histogram[index];
+
+		if ((seen + count) >= rank) {
+			/* interpolate within the bucket, bounded by what was actually seen */
+			uint64_t lo = (index == 0) ? 0 : ((uint64_t)1 << (index - 1));
+			uint64_t hi = (index == (PERF_HISTOGRAM_BUCKETS - 1)) ? snap->time_most : (((uint64_t)1 << index) - 1);
+			uint64_t value;
+
+			if (lo < snap->time_least)
+				lo = snap->time_least;
+
+			if (hi > snap->time_most)
+				hi = snap->time_most;
+
+			value = lo + ((hi - lo) * (rank - seen)) / count;
+
+			return (value > hi) ? hi : value;
+		}
+
+		seen += count;
 	}
+
+	return snap->time_most;
+}
+
+const char *
+perf_name(perf_counter_t handle)
+{
+	if (handle == NULL)
+		return NULL;
+
+	return handle->name;
 }
 
 void
-perf_print_all(void)
+perf_iterate_all(perf_callback cb, void *user)
 {
+	sem_wait(&perf_counters_lock);
+
 	perf_counter_t handle = (perf_counter_t)sq_peek(&perf_counters);
 
 	while (handle != NULL) {
-		perf_print_counter(handle);
+		cb(handle, user);
 		handle = (perf_counter_t)sq_next(&handle->link);
 	}
+
+	sem_post(&perf_counters_lock);
 }
 
 void
-perf_reset_all(void)
+perf_print_counter(perf_counter_t handle)
 {
-	perf_counter_t handle = (perf_counter_t)sq_peek(&perf_counters);
+	struct perf_counter_snapshot snap;
 
-	while (handle != NULL) {
-		perf_reset(handle);
-		handle = (perf_counter_t)sq_next(&handle->link);
+	if (perf_snapshot(handle, &snap) != OK)
+		return;
+
+	switch (handle->type) {
+	case PC_COUNT:
+		printf("%s: %llu events\n",
+		       handle->name,
+		       snap.event_count);
+		break;
+
+	case PC_ELAPSED:
+		printf("%s: %llu events, %lluus elapsed, %lluus avg, min %lluus max %lluus, %lluus stddev\n",
+		       handle->name,
+		       snap.event_count,
+		       snap.time_total,
+		       perf_snapshot_mean(&snap),
+		       snap.time_least,
+		       snap.time_most,
+		       perf_snapshot_stddev(&snap));
+		break;
+
+	case PC_INTERVAL:
+		printf("%s: %llu events, %lluus avg, min %lluus max %lluus, %lluus stddev\n",
+		       handle->name,
+		       snap.event_count,
+		       perf_snapshot_mean(&snap),
+		       snap.time_least,
+		       snap.time_most,
+		       perf_snapshot_stddev(&snap));
+		break;
+
+	default:
+		break;
 	}
+
+	if (snap.samples > 0) {
+		printf("    p50 %lluus p90 %lluus p99 %lluus\n",
+		       perf_snapshot_percentile(&snap, 50),
+		       perf_snapshot_percentile(&snap, 90),
+		       perf_snapshot_percentile(&snap, 99));
+	}
+}
+
+static void
+perf_print_cb(perf_counter_t handle, void *user)
+{
+	perf_print_counter(handle);
+}
+
+static void
+perf_reset_cb(perf_counter_t handle, void *user)
+{
+	perf_reset(handle);
+}
+
+void
+perf_print_all(void)
+{
+	perf_iterate_all(perf_print_cb, NULL);
+}
+
+void
+perf_reset_all(void)
+{
+	perf_iterate_all(perf_reset_cb, NULL);
 }
@@ -39,6 +39,9 @@
 #ifndef _SYSTEMLIB_PERF_COUNTER_H
 #define _SYSTEMLIB_PERF_COUNTER_H value
 
+#include <nuttx/config.h>
+#include <stdint.h>
+
 /**
  * Counter types.
  */
@@ -51,6 +54,41 @@ enum perf_counter_type {
 struct perf_ctr_header;
 typedef struct perf_ctr_header	*perf_counter_t;
 
+/**
+ * Number of histogram buckets kept by PC_ELAPSED and PC_INTERVAL counters.
+ *
+ * Bucket 0 counts samples of 0us, bucket n counts samples from 2^(n-1) to
+ * 2^n - 1 us, and the last bucket also counts everything larger. IO has
+ * very little RAM and keeps a shorter histogram.
+ */
+#ifdef CONFIG_ARCH_BOARD_PX4IO
+# define PERF_HISTOGRAM_BUCKETS	12
+#else
+# define PERF_HISTOGRAM_BUCKETS	18
+#endif
+
+/**
+ * Copy of the state of a counter.
+ *
+ * This is plain data, so it can be logged or sent as it is.
+ */
+struct perf_counter_snapshot {
+	uint64_t	timestamp;	/**< time the snapshot was taken */
+	uint64_t	event_count;	/**< number of events */
+	uint64_t	samples;	/**< number of elapsed times or intervals measured */
+	uint64_t	time_total;	/**< sum of the samples, us */
+	uint64_t	time_sq_total;	/**< sum of the squared samples, us^2 */
+	uint64_t	time_least;	/**< smallest sample, us */
+	uint64_t	time_most;	/**< largest sample, us */
+	uint32_t	histogram[PERF_HISTOGRAM_BUCKETS];
+	uint8_t		type;		/**< enum perf_counter_type */
+};
+
+/**
+ * Callback for perf_iterate_all.
+ */
+typedef void	(*perf_callback)(perf_counter_t handle, void *user);
+
 __BEGIN_DECLS
 
 /**
@@ -75,6 +113,9 @@ __EXPORT extern void		perf_free(perf_counter_t handle);
  *
  * This call only affects counters that take single events; PC_COUNT etc.
  *
+ * Counters may be updated from interrupt handlers; the update only keeps
+ * interrupts disabled for a few instructions and never blocks.
+ *
  * @param handle		The handle returned from perf_alloc.
  */
 __EXPORT extern void		perf_count(perf_counter_t handle);
@@ -97,6 +138,17 @@ __EXPORT extern void		perf_begin(perf_counter_t handle);
  */
 __EXPORT extern void		perf_end(perf_counter_t handle);
 
+/**
+ * Record an event whose elapsed time was measured by the caller.
+ *
+ * This call applies to PC_ELAPSED counters, for intervals that do not
+ * begin and end in the same context.
+ *
+ * @param handle		The handle returned from perf_alloc.
+ * @param elapsed		The time the event took, in microseconds.
+ */
+__EXPORT extern void		perf_set(perf_counter_t handle, uint64_t elapsed);
+
 /**
  * Reset a performance event.
  *
@@ -106,6 +158,62 @@ __EXPORT extern void		perf_end(perf_counter_t handle);
  */
 __EXPORT extern void		perf_reset(perf_counter_t handle);
 
+/**
+ * Take a consistent copy of a counter.
+ *
+ * This is safe to call while the counter is being updated, including
+ * from an interrupt handler.
+ *
+ * @param handle		The handle returned from perf_alloc.
+ * @param snap			Buffer for the copy.
+ * @return			OK, or -EINVAL if handle is NULL.
+ */
+__EXPORT extern int		perf_snapshot(perf_counter_t handle, struct perf_counter_snapshot *snap);
+
+/**
+ * Mean of the samples in a snapshot.
+ *
+ * @param snap			The snapshot.
+ * @return			Mean elapsed time or interval, in us.
+ */
+__EXPORT extern uint64_t	perf_snapshot_mean(const struct perf_counter_snapshot *snap);
+
+/**
+ * Standard deviation of the samples in a snapshot, i.e. the jitter.
+ *
+ * @param snap			The snapshot.
+ * @return			Standard deviation, in us.
+ */
+__EXPORT extern uint64_t	perf_snapshot_stddev(const struct perf_counter_snapshot *snap);
+
+/**
+ * Estimate a percentile of the samples in a snapshot from its histogram.
+ *
+ * @param snap			The snapshot.
+ * @param percent		The percentile, 0 to 100.
+ * @return			Estimated percentile, in us.
+ */
+__EXPORT extern uint64_t	perf_snapshot_percentile(const struct perf_counter_snapshot *snap, unsigned percent);
+
+/**
+ * Name of a counter.
+ *
+ * @param handle		The handle returned from perf_alloc.
+ * @return			The name passed to perf_alloc.
+ */
+__EXPORT extern const char	*perf_name(perf_counter_t handle);
+
+/**
+ * Call a function for each counter.
+ *
+ * Counters cannot be allocated or freed while this runs, so the callback
+ * must not do either. Not callable from interrupt context.
+ *
+ * @param cb			The function to call.
+ * @param user			Passed to cb.
+ */
+__EXPORT extern void		perf_iterate_all(perf_callback cb, void *user);
+
 /**
  * Print one performance counter.
  *
@@ -0,0 +1,563 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file rc_decode.c
+ *
+ * R/C input decoders for PPM, Spektrum DSM and Futaba S.bus.
+ */
+
+#include <string.h>
+
+#include "rc_decode.h"
+
+/*
+ * PPM decoder tuning parameters
+ */
+#define PPM_MIN_CHANNEL_VALUE	800		/* shortest valid channel signal */
+#define PPM_MAX_CHANNEL_VALUE	2200		/* longest valid channel signal */
+#define PPM_MIN_START		2500		/* shortest valid start gap */
+#define PPM_MIN_CHANNELS	5		/* fewest channels in a sensible frame */
+#define PPM_CHANNEL_LOCK	3		/* frames with the same channel count before locking */
+
+#define DSM_FRAME_CHANNELS	7
+#define DSM_FRAME_GAP		5000		/* minimum gap between DSM frames */
+
+#define SBUS_INPUT_CHANNELS	16
+#define SBUS_FRAME_GAP		3000		/* minimum gap between S.bus frames */
+
+static bool	ppm_decoder_publish(struct ppm_decoder *dec, uint16_t *values, unsigned *num_values);
+static bool	dsm_decode_channel(uint16_t raw, unsigned shift, unsigned *channel, unsigned *value);
+static void	dsm_guess_format(struct dsm_decoder *dec, bool reset);
+static bool	dsm_decode(struct dsm_decoder *dec, hrt_abstime frame_time,
+			   uint16_t *values, uint16_t *num_values, unsigned max_values);
+static bool	sbus_decode(struct sbus_decoder *dec, hrt_abstime frame_time,
+			    uint16_t *values, uint16_t *num_values, unsigned max_values);
+
+void
+ppm_decoder_init(struct ppm_decoder *dec)
+{
+	memset(dec, 0, sizeof(*dec));
+}
+
+bool
+ppm_decoder_edge(struct ppm_decoder *dec, uint16_t count, uint16_t *values, unsigned *num_values)
+{
+	uint16_t interval = count - dec->last_edge;
+	dec->last_edge = count;
+
+	/*
+	 * A long interval is the gap between frames; this edge is the
+	 * reference for the first channel of the next one.
+	 */
+	if (interval >= PPM_MIN_START) {
+		bool published = false;
+
+		if (dec->synched && (dec->next_channel >= PPM_MIN_CHANNELS)) {
+
+			if (dec->next_channel != dec->channels) {
+				/*
+				 * Either we are not locked yet, or the channel count
+				 * changed and we have to look for a new lock. Report
+				 * the frame now, unless it ran long and its first
+				 * channels were reported already.
+				 */
+				bool reported = (dec->channels != 0) && (dec->next_channel > dec->channels);
+
+				if (dec->channels != 0)
+					dec->frame_drops++;
+
+				dec->channels = 0;
+
+				if (!reported)
+					published = ppm_decoder_publish(dec, values, num_values);
+			}
+
+			/* lock to the channel count once it has been steady for a few frames */
+			if (dec->next_channel != dec->new_channels) {
+				dec->new_channels = dec->next_channel;
+				dec->holdoff = PPM_CHANNEL_LOCK;
+
+			} else if ((dec->holdoff > 0) && (--dec->holdoff == 0)) {
+				dec->channels = dec->new_channels;
+			}
+		}
+
+		dec->synched = true;
+		dec->next_channel = 0;
+		return published;
+	}
+
+	/* nothing useful to do until we have seen a frame start */
+	if (!dec->synched)
+		return false;
+
+	/* if the mark-mark timing is out of bounds, abandon the frame */
+	if ((interval < PPM_MIN_CHANNEL_VALUE) || (interval > PPM_MAX_CHANNEL_VALUE)) {
+		dec->synched = false;
+		dec->frame_drops++;
+		*num_values = 0;
+		return false;
+	}
+
+	/* if we have room to store the value, do so */
+	if (dec->next_channel < PPM_DECODE_MAX_CHANNELS) {
+		dec->values[dec->next_channel++] = interval;
+
+		/* once locked, the frame is complete as soon as its last channel arrives */
+		if (dec->next_channel == dec->channels)
+			return ppm_decoder_publish(dec, values, num_values);
+	}
+
+	return false;
+}
+
+static bool
+ppm_decoder_publish(struct ppm_decoder *dec, uint16_t *values, unsigned *num_values)
+{
+	for (unsigned i = 0; i < dec->next_channel; i++)
+		values[i] = dec->values[i];
+
+	*num_values = dec->next_channel;
+	return true;
+}
+
+void
+dsm_decoder_init(struct dsm_decoder *dec, hrt_abstime now)
+{
+	memset(dec, 0, sizeof(*dec));
+	dec->last_rx_time = now;
+
+	/* reset the format detector */
+	dsm_guess_format(dec, true);
+}
+
+bool
+dsm_decoder_input(struct dsm_decoder *dec, hrt_abstime now, const uint8_t *bytes, unsigned count,
+		  uint16_t *values, uint16_t *num_values, unsigned max_values)
+{
+	bool decoded = false;
+
+	/*
+	 * The DSM* protocol doesn't provide any explicit framing,
+	 * so we detect frame boundaries by the inter-frame delay.
+	 *
+	 * The minimum frame spacing is 11ms; with 16 bytes at 115200bps
+	 * frame transmission time is ~1.4ms.
+	 *
+	 * If an interval of more than 5ms passes between calls, the
+	 * first byte we are given will be the first byte of a frame.
+	 *
+	 * In the case where byte(s) are dropped from a frame, this also
+	 * provides a degree of protection. Of course, it would be better
+	 * if we didn't drop bytes...
+	 */
+	if ((now - dec->last_rx_time) > DSM_FRAME_GAP) {
+		if (dec->partial_frame_count > 0) {
+			dec->frame_drops++;
+			dec->partial_frame_count = 0;
+		}
+	}
+
+	if (count == 0)
+		return false;
+
+	dec->last_rx_time = now;
+
+	while (count > 0) {
+		unsigned n = DSM_FRAME_SIZE - dec->partial_frame_count;
+
+		if (n > count)
+			n = count;
+
+		/* add bytes to the current frame */
+		memcpy(&dec->frame[dec->partial_frame_count], bytes, n);
+		dec->partial_frame_count += n;
+		bytes += n;
+		count -= n;
+
+		/* decode as soon as the frame is complete */
+		if (dec->partial_frame_count == DSM_FRAME_SIZE) {
+			dec->partial_frame_count = 0;
+
+			if (dsm_decode(dec, now, values, num_values, max_values))
+				decoded = true;
+		}
+	}
+
+	return decoded;
+}
+
+static bool
+dsm_decode_channel(uint16_t raw, unsigned shift, unsigned *channel, unsigned *value)
+{
+
+	if (raw == 0xffff)
+		return false;
+
+	*channel = (raw >> shift) & 0xf;
+
+	uint16_t data_mask = (1 << shift) - 1;
+	*value = raw & data_mask;
+
+	return true;
+}
+
+static void
+dsm_guess_format(struct dsm_decoder *dec, bool reset)
+{
+	/* reset the 10/11 bit sniffed channel masks */
+	if (reset) {
+		dec->cs10 = 0;
+		dec->cs11 = 0;
+		dec->samples = 0;
+		dec->channel_shift = 0;
+		return;
+	}
+
+	/* scan the channels in the current frame in both 10- and 11-bit mode */
+	for (unsigned i = 0; i < DSM_FRAME_CHANNELS; i++) {
+
+		uint8_t *dp = &dec->frame[2 + (2 * i)];
+		uint16_t raw = (dp[0] << 8) | dp[1];
+		unsigned channel, value;
+
+		/* if the channel decodes, remember the assigned number */
+		if (dsm_decode_channel(raw, 10, &channel, &value) && (channel < 31))
+			dec->cs10 |= (1 << channel);
+
+		if (dsm_decode_channel(raw, 11, &channel, &value) && (channel < 31))
+			dec->cs11 |= (1 << channel);
+
+		/* XXX if we cared, we could look for the phase bit here to decide 1 vs. 2-frame format */
+	}
+
+	/* wait until we have seen plenty of frames - 2 should normally be enough */
+	if (dec->samples++ < 5)
+		return;
+
+	/*
+	 * Iterate the set of sensible sniffed channel sets and see whether
+	 * decoding in 10 or 11-bit mode has yielded anything we recognise.
+	 *
+	 * XXX Note that due to what seem to be bugs in the DSM2 high-resolution
+	 *     stream, we may want to sniff for longer in some cases when we think we
+	 *     are talking to a DSM2 receiver in high-resolution mode (so that we can
+	 *     reject it, ideally).
+	 *     See e.g. http://git.openpilot.org/cru/OPReview-116 for a discussion
+	 *     of this issue.
+	 */
+	static const uint32_t masks[] = {
+		0x3f,	/* 6 channels (DX6) */
+		0x7f,	/* 7 channels (DX7) */
+		0xff,	/* 8 channels (DX8) */
+		0x1ff,	/* 9 channels (DX9, etc.) */
+		0x3ff,	/* 10 channels (DX10) */
+		0x3fff	/* 18 channels (DX10) */
+	};
+	unsigned votes10 = 0;
+	unsigned votes11 = 0;
+
+	for (unsigned i = 0; i < (sizeof(masks) / sizeof(masks[0])); i++) {
+
+		if (dec->cs10 == masks[i])
+			votes10++;
+
+		if (dec->cs11 == masks[i])
+			votes11++;
+	}
+
+	if ((votes11 == 1) && (votes10 == 0)) {
+		dec->channel_shift = 11;
+		return;
+	}
+
+	if ((votes10 == 1) && (votes11 == 0)) {
+		dec->channel_shift = 10;
+		return;
+	}
+
+	/* reset our state ... we have to try again */
+	dsm_guess_format(dec, true);
+}
+
+static bool
+dsm_decode(struct dsm_decoder *dec, hrt_abstime frame_time,
+	   uint16_t *values, uint16_t *num_values, unsigned max_values)
+{
+	/*
+	 * If we have lost signal for at least a second, reset the
+	 * format guessing heuristic.
+	 */
+	if (((frame_time - dec->last_frame_time) > 1000000) && (dec->channel_shift != 0))
+		dsm_guess_format(dec, true);
+
+	/* we have received something we think is a frame */
+	dec->last_frame_time = frame_time;
+
+	/* if we don't know the frame format, update the guessing state machine */
+	if (dec->channel_shift == 0) {
+		dsm_guess_format(dec, false);
+		return false;
+	}
+
+	/*
+	 * The encoding of the first two bytes is uncertain, so we're
+	 * going to ignore them for now.
+	 *
+	 * Each channel is a 16-bit unsigned value containing either a 10-
+	 * or 11-bit channel value and a 4-bit channel number, shifted
+	 * either 10 or 11 bits. The MSB may also be set to indicate the
+	 * second frame in variants of the protocol where more than
+	 * seven channels are being transmitted.
+	 */
+
+	for (unsigned i = 0; i < DSM_FRAME_CHANNELS; i++) {
+
+		uint8_t *dp = &dec->frame[2 + (2 * i)];
+		uint16_t raw = (dp[0] << 8) | dp[1];
+		unsigned channel, value;
+
+		if (!dsm_decode_channel(raw, dec->channel_shift, &channel, &value))
+			continue;
+
+		/* convert 0-1024 / 0-2048 values to 1000-2000 ppm encoding in a very sloppy fashion */
+		if (dec->channel_shift == 11)
+			value /= 2;
+
+		value += 998;
+
+		/*
+		 * Store the decoded channel into the R/C input buffer, taking into
+		 * account the different ideas about channel assignement that we have.
+		 *
+		 * Specifically, the first four channels in rc_channel_data are roll, pitch, thrust, yaw,
+		 * but the first four channels from the DSM receiver are thrust, roll, pitch, yaw.
+		 */
+		switch (channel) {
+		case 0:
+			channel = 2;
+			break;
+
+		case 1:
+			channel = 0;
+			break;
+
+		case 2:
+			channel = 1;
+
+		default:
+			break;
+		}
+
+		/* ignore channels out of range */
+		if (channel >= max_values)
+			continue;
+
+		/* update the decoded channel count */
+		if (channel >= *num_values)
+			*num_values = channel + 1;
+
+		values[channel] = value;
+	}
+
+	/*
+	 * XXX Note that we may be in failsafe here; we need to work out how to detect that.
+	 */
+	return true;
+}
+
+void
+sbus_decoder_init(struct sbus_decoder *dec, hrt_abstime now)
+{
+	memset(dec, 0, sizeof(*dec));
+	dec->last_rx_time = now;
+}
+
+bool
+sbus_decoder_input(struct sbus_decoder *dec, hrt_abstime now, const uint8_t *bytes, unsigned count,
+		   uint16_t *values, uint16_t *num_values, unsigned max_values)
+{
+	bool decoded = false;
+
+	/*
+	 * The S.bus protocol doesn't provide reliable framing,
+	 * so we detect frame boundaries by the inter-frame delay.
+	 *
+	 * The minimum frame spacing is 7ms; with 25 bytes at 100000bps
+	 * frame transmission time is ~2ms.
+	 *
+	 * If an interval of more than 3ms passes between calls, the
+	 * first byte we are given will be the first byte of a frame.
+	 *
+	 * In the case where byte(s) are dropped from a frame, this also
+	 * provides a degree of protection. Of course, it would be better
+	 * if we didn't drop bytes...
+	 */
+	if ((now - dec->last_rx_time) > SBUS_FRAME_GAP) {
+		if (dec->partial_frame_count > 0) {
+			dec->frame_drops++;
+			dec->partial_frame_count = 0;
+		}
+	}
+
+	if (count == 0)
+		return false;
+
+	dec->last_rx_time = now;
+
+	while (count > 0) {
+		unsigned n = SBUS_FRAME_SIZE - dec->partial_frame_count;
+
+		if (n > count)
+			n = count;
+
+		/* add bytes to the current frame */
+		memcpy(&dec->frame[dec->partial_frame_count], bytes, n);
+		dec->partial_frame_count += n;
+		bytes += n;
+		count -= n;
+
+		/* decode as soon as the frame is complete */
+		if (dec->partial_frame_count == SBUS_FRAME_SIZE) {
+			dec->partial_frame_count = 0;
+
+			if (sbus_decode(dec, now, values, num_values, max_values))
+				decoded = true;
+		}
+	}
+
+	return decoded;
+}
+
+/*
+ * S.bus decoder matrix.
+ *
+ * Each channel value can come from up to 3 input bytes. Each row in the
+ * matrix describes up to three bytes, and each entry gives:
+ *
+ * - byte offset in the data portion of the frame
+ * - right shift applied to the data byte
+ * - mask for the data byte
+ * - left shift applied to the result into the channel value
+ */
+struct sbus_bit_pick {
+	uint8_t byte;
+	uint8_t rshift;
+	uint8_t mask;
+	uint8_t lshift;
+};
+static const struct sbus_bit_pick sbus_decoder[SBUS_INPUT_CHANNELS][3] = {
+	/*  0 */ { { 0, 0, 0xff, 0}, { 1, 0, 0x07, 8}, { 0, 0, 0x00,  0} },
+	/*  1 */ { { 1, 3, 0x1f, 0}, { 2, 0, 0x3f, 5}, { 0, 0, 0x00,  0} },
+	/*  2 */ { { 2, 6, 0x03, 0}, { 3, 0, 0xff, 2}, { 4, 0, 0x01, 10} },
+	/*  3 */ { { 4, 1, 0x7f, 0}, { 5, 0, 0x0f, 7}, { 0, 0, 0x00,  0} },
+	/*  4 */ { { 5, 4, 0x0f, 0}, { 6, 0, 0x7f, 4}, { 0, 0, 0x00,  0} },
+	/*  5 */ { { 6, 7, 0x01, 0}, { 7, 0, 0xff, 1}, { 8, 0, 0x03,  9} },
+	/*  6 */ { { 8, 2, 0x3f, 0}, { 9, 0, 0x1f, 6}, { 0, 0, 0x00,  0} },
+	/*  7 */ { { 9, 5, 0x07, 0}, {10, 0, 0xff, 3}, { 0, 0, 0x00,  0} },
+	/*  8 */ { {11, 0, 0xff, 0}, {12, 0, 0x07, 8}, { 0, 0, 0x00,  0} },
+	/*  9 */ { {12, 3, 0x1f, 0}, {13, 0, 0x3f, 5}, { 0, 0, 0x00,  0} },
+	/* 10 */ { {13, 6, 0x03, 0}, {14, 0, 0xff, 2}, {15, 0, 0x01, 10} },
+	/* 11 */ { {15, 1, 0x7f, 0}, {16, 0, 0x0f, 7}, { 0, 0, 0x00,  0} },
+	/* 12 */ { {16, 4, 0x0f, 0}, {17, 0, 0x7f, 4}, { 0, 0, 0x00,  0} },
+	/* 13 */ { {17, 7, 0x01, 0}, {18, 0, 0xff, 1}, {19, 0, 0x03,  9} },
+	/* 14 */ { {19, 2, 0x3f, 0}, {20, 0, 0x1f, 6}, { 0, 0, 0x00,  0} },
+	/* 15 */ { {20, 5, 0x07, 0}, {21, 0, 0xff, 3}, { 0, 0, 0x00,  0} }
+};
+
+static bool
+sbus_decode(struct sbus_decoder *dec, hrt_abstime frame_time,
+	    uint16_t *values, uint16_t *num_values, unsigned max_values)
+{
+	const uint8_t *frame = dec->frame;
+
+	/* check frame boundary markers to avoid out-of-sync cases */
+	if ((frame[0] != 0x0f) || (frame[24] != 0x00)) {
+		dec->frame_drops++;
+		return false;
+	}
+
+	/* if the failsafe or connection lost bit is set, we consider the frame invalid */
+	if ((frame[23] & (1 << 2)) && /* signal lost */
+	    (frame[23] & (1 << 3))) { /* failsafe */
+
+		/* actively announce signal loss */
+		if (max_values > 0)
+			values[0] = 0;
+		return false;
+	}
+
+	/* we have received something we think is a frame */
+	dec->last_frame_time = frame_time;
+
+	unsigned chancount = (max_values > SBUS_INPUT_CHANNELS) ?
+			     SBUS_INPUT_CHANNELS : max_values;
+
+	/* use the decoder matrix to extract channel data */
+	for (unsigned channel = 0; channel < chancount; channel++) {
+		unsigned value = 0;
+
+		for (unsigned pick = 0; pick < 3; pick++) {
+			const struct sbus_bit_pick *decode = &sbus_decoder[channel][pick];
+
+			if (decode->mask != 0) {
+				unsigned piece = frame[1 + decode->byte];
+				piece >>= decode->rshift;
+				piece &= decode->mask;
+				piece <<= decode->lshift;
+
+				value |= piece;
+			}
+		}
+
+		/* convert 0-2048 values to 1000-2000 ppm encoding in a very sloppy fashion */
+		values[channel] = (value / 2) + 998;
+	}
+
+	/* decode switch channels if data fields are wide enough */
+	if (max_values > 17 && chancount > 15) {
+		chancount = 18;
+
+		/* channel 17 (index 16) */
+		values[16] = ((frame[23] & (1 << 0)) ? 1000 : 0) + 998;
+		/* channel 18 (index 17) */
+		values[17] = ((frame[23] & (1 << 1)) ? 1000 : 0) + 998;
+	}
+
+	/* note the number of channels decoded */
+	*num_values = chancount;
+
+	return true;
+}
@@ -0,0 +1,194 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file rc_decode.h
+ *
+ * R/C input decoders.
+ *
+ * The PPM, Spektrum DSM and Futaba S.bus decoders share one model: the
+ * caller feeds in raw input as it arrives (capture times for PPM, bytes
+ * for the serial protocols) and the decoder reports a frame as soon as
+ * its last piece has been seen.
+ *
+ * Decoders keep their state in the structure passed to them and do no
+ * I/O of their own, so they can be run from interrupt context, and on a
+ * host against recorded input.
+ */
+
+#ifndef _SYSTEMLIB_RC_DECODE_H
+#define _SYSTEMLIB_RC_DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <drivers/drv_hrt.h>
+
+/**
+ * Maximum number of PPM channels that will be decoded.
+ */
+#define PPM_DECODE_MAX_CHANNELS	12
+
+#define DSM_FRAME_SIZE		16
+#define SBUS_FRAME_SIZE		25
+
+/**
+ * PPM decoder state.
+ *
+ * Only one edge of each pulse is needed; a channel value is the time
+ * from one pulse to the next, and a frame starts after a gap of at
+ * least PPM_MIN_START.
+ */
+struct ppm_decoder {
+	uint16_t	last_edge;	/**< capture time of the last pulse */
+	bool		synched;	/**< seen the start of a frame */
+	unsigned	next_channel;
+	unsigned	channels;	/**< channels per frame once locked, else zero */
+	unsigned	new_channels;	/**< channel count we are trying to lock to */
+	unsigned	holdoff;	/**< frames still to see before locking */
+	unsigned	frame_drops;	/**< frames abandoned part way */
+	uint16_t	values[PPM_DECODE_MAX_CHANNELS];
+};
+
+/**
+ * DSM decoder state.
+ */
+struct dsm_decoder {
+	hrt_abstime	last_rx_time;
+	hrt_abstime	last_frame_time;
+	uint8_t		frame[DSM_FRAME_SIZE];
+	unsigned	partial_frame_count;
+	unsigned	channel_shift;	/**< 10 or 11 once the format is known */
+	uint32_t	cs10;		/**< channels seen decoding as 10-bit */
+	uint32_t	cs11;		/**< channels seen decoding as 11-bit */
+	unsigned	samples;
+	unsigned	frame_drops;
+};
+
+/**
+ * S.bus decoder state.
+ */
+struct sbus_decoder {
+	hrt_abstime	last_rx_time;
+	hrt_abstime	last_frame_time;
+	uint8_t		frame[SBUS_FRAME_SIZE];
+	unsigned	partial_frame_count;
+	unsigned	frame_drops;
+};
+
+__BEGIN_DECLS
+
+/**
+ * Initialise or reset a PPM decoder.
+ *
+ * Also call this if the capture hardware has missed edges.
+ */
+__EXPORT extern void	ppm_decoder_init(struct ppm_decoder *dec);
+
+/**
+ * Pass a pulse to the PPM decoder.
+ *
+ * Once the decoder has seen the same number of channels in a few
+ * consecutive frames, each frame is reported with its last pulse rather
+ * than with the start of the next frame.
+ *
+ * @param dec		The decoder.
+ * @param count		Capture time of the pulse in microseconds; expected
+ *			to wrap at 16 bits.
+ * @param values	Receives the channel values when a frame completes.
+ * @param num_values	Receives the number of channels when a frame completes.
+ * @return		True if a frame was completed.
+ */
+__EXPORT extern bool	ppm_decoder_edge(struct ppm_decoder *dec, uint16_t count,
+					 uint16_t *values, unsigned *num_values);
+
+/**
+ * Initialise or reset a DSM decoder.
+ *
+ * @param now		The current time.
+ */
+__EXPORT extern void	dsm_decoder_init(struct dsm_decoder *dec, hrt_abstime now);
+
+/**
+ * Pass received bytes to the DSM decoder.
+ *
+ * DSM has no explicit framing; a frame is taken to start with the first
+ * byte received after a pause of more than 5ms.
+ *
+ * @param dec		The decoder.
+ * @param now		The time the bytes were received.
+ * @param bytes		The received bytes.
+ * @param count		The number of bytes.
+ * @param values	Channel values; updated for the channels present in a
+ *			completed frame.
+ * @param num_values	Number of channels; raised to cover the channels
+ *			present in a completed frame.
+ * @param max_values	The number of entries in values.
+ * @return		True if a frame was completed.
+ */
+__EXPORT extern bool	dsm_decoder_input(struct dsm_decoder *dec, hrt_abstime now,
+					  const uint8_t *bytes, unsigned count,
+					  uint16_t *values, uint16_t *num_values, unsigned max_values);
+
+/**
+ * Initialise or reset an S.bus decoder.
+ *
+ * @param now		The current time.
+ */
+__EXPORT extern void	sbus_decoder_init(struct sbus_decoder *dec, hrt_abstime now);
+
+/**
+ * Pass received bytes to the S.bus decoder.
+ *
+ * A frame is taken to start with the first byte received after a pause
+ * of more than 3ms.
+ *
+ * @param dec		The decoder.
+ * @param now		The time the bytes were received.
+ * @param bytes		The received bytes.
+ * @param count		The number of bytes.
+ * @param values	Receives the channel values when a frame completes;
+ *			the first is zeroed when the receiver reports
+ *			failsafe.
+ * @param num_values	Receives the number of channels when a frame completes.
+ * @param max_values	The number of entries in values.
+ * @return		True if a frame was completed.
+ */
+__EXPORT extern bool	sbus_decoder_input(struct sbus_decoder *dec, hrt_abstime now,
+					   const uint8_t *bytes, unsigned count,
+					   uint16_t *values, uint16_t *num_values, unsigned max_values);
+
+__END_DECLS
+
+#endif
@@ -0,0 +1,389 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file sched_trace.c
+ *
+ * Scheduler event trace ring.
+ *
+ * The ring is only allocated when tracing is started, so this costs no
+ * RAM until it is used. Recording an event takes a few dozen cycles with
+ * interrupts disabled.
+ */
+
+#include <nuttx/config.h>
+#include <nuttx/irq.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include <arch/board/board.h>
+#include <drivers/drv_hrt.h>
+
+#include "sched_trace.h"
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION
+
+/* Cortex-M debug cycle counter */
+#define DEMCR			(*(volatile uint32_t *)0xe000edfc)
+#define DEMCR_TRCENA		(1 << 24)
+#define DWT_CTRL		(*(volatile uint32_t *)0xe0001000)
+#define DWT_CTRL_CYCCNTENA	(1 << 0)
+#define DWT_CYCCNT		(*(volatile uint32_t *)0xe0001004)
+
+/* number of task names remembered; tasks that come and go reuse slots */
+#define SCHED_TRACE_TASKS	(CONFIG_MAX_TASKS * 2)
+
+static struct {
+	struct sched_trace_event *ring;
+	struct sched_trace_task	*tasks;
+	unsigned		size;		/* ring size, events */
+	unsigned		next;		/* next slot to write */
+	unsigned		count;		/* events in the ring */
+	unsigned		task_next;	/* next task slot to reuse */
+	uint32_t		dropped;
+	bool			wrap;
+	volatile bool		running;
+} trace;
+
+#ifdef CONFIG_PRIORITY_INHERITANCE
+# define BASE_PRIORITY(_tcb)	((_tcb)->base_priority)
+#else
+# define BASE_PRIORITY(_tcb)	((_tcb)->sched_priority)
+#endif
+
+void
+sched_trace_record(uint8_t type, uint8_t priority, int16_t id, uint32_t arg)
+{
+	struct sched_trace_event *ev;
+	irqstate_t flags;
+
+	if (!trace.running)
+		return;
+
+	flags = irqsave();
+
+	/* stopped, and the ring possibly freed, since the check above */
+	if (!trace.running) {
+		irqrestore(flags);
+		return;
+	}
+
+	if (trace.count == trace.size) {
+		trace.dropped++;
+
+		if (!trace.wrap) {
+			irqrestore(flags);
+			return;
+		}
+
+	} else {
+		trace.count++;
+	}
+
+	ev = &trace.ring[trace.next];
+
+	if (++trace.next == trace.size)
+		trace.next = 0;
+
+	ev->cycles = DWT_CYCCNT;
+	ev->type = type;
+	ev->priority = priority;
+	ev->id = id;
+	ev->arg = arg;
+
+	irqrestore(flags);
+}
+
+/*
+ * Remember the name of a task. Called with interrupts disabled.
+ */
+static void
+sched_trace_name(FAR _TCB *tcb)
+{
+	struct sched_trace_task *slot = NULL;
+
+	for (unsigned i = 0; i < SCHED_TRACE_TASKS; i++) {
+		if (trace.tasks[i].pid == tcb->pid) {
+			slot = &trace.tasks[i];
+			break;
+		}
+	}
+
+	if (slot == NULL) {
+		slot = &trace.tasks[trace.task_next];
+		trace.task_next = (trace.task_next + 1) % SCHED_TRACE_TASKS;
+	}
+
+	slot->pid = tcb->pid;
+	slot->priority = BASE_PRIORITY(tcb);
+#if CONFIG_TASK_NAME_SIZE > 0
+	strncpy(slot->name, tcb->name, SCHED_TRACE_NAME_LEN - 1);
+	slot->name[SCHED_TRACE_NAME_LEN - 1] = '\0';
+#else
+	snprintf(slot->name, SCHED_TRACE_NAME_LEN, "pid%d", tcb->pid);
+#endif
+}
+
+void
+sched_trace_start_task(FAR _TCB *tcb)
+{
+	if (!trace.running)
+		return;
+
+	irqstate_t flags = irqsave();
+
+	if (trace.running)
+		sched_trace_name(tcb);
+
+	irqrestore(flags);
+
+	sched_trace_record(SCHED_TRACE_START, tcb->sched_priority, tcb->pid, 0);
+}
+
+void
+sched_trace_stop_task(FAR _TCB *tcb)
+{
+	sched_trace_record(SCHED_TRACE_STOP, tcb->sched_priority, tcb->pid, 0);
+}
+
+void
+sched_trace_switch(FAR _TCB *from, FAR _TCB *to)
+{
+	sched_trace_record(SCHED_TRACE_SWITCH,
+			   to->sched_priority,
+			   to->pid,
+			   ((uint32_t)from->pid & 0xffff) |
+			   ((uint32_t)from->sched_priority << 16) |
+			   ((uint32_t)BASE_PRIORITY(to) << 24));
+}
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION_IRQHANDLER
+void
+sched_note_irqhandler(int irq, bool enter)
+{
+	sched_trace_record(enter ? SCHED_TRACE_IRQ_ENTER : SCHED_TRACE_IRQ_EXIT, 0, irq, 0);
+}
+#endif
+
+static void
+sched_trace_name_cb(FAR _TCB *tcb, FAR void *arg)
+{
+	sched_trace_name(tcb);
+}
+
+int
+sched_trace_start(unsigned events, bool wrap)
+{
+	sched_trace_stop();
+
+	if ((events == 0) || (events > SCHED_TRACE_MAX_EVENTS))
+		return -EINVAL;
+
+	/* keep the old ring if it is the right size */
+	if (events != trace.size) {
+		/* detach the ring before freeing it, recording checks under the same lock */
+		irqstate_t flags = irqsave();
+		struct sched_trace_event *old = trace.ring;
+
+		trace.ring = NULL;
+		trace.size = 0;
+		trace.next = 0;
+		trace.count = 0;
+
+		irqrestore(flags);
+
+		free(old);
+
+		trace.ring = malloc(events * sizeof(struct sched_trace_event));
+
+		if (trace.ring == NULL)
+			return -ENOMEM;
+
+		trace.size = events;
+	}
+
+	if (trace.tasks == NULL) {
+		trace.tasks = malloc(SCHED_TRACE_TASKS * sizeof(struct sched_trace_task));
+
+		if (trace.tasks == NULL)
+			return -ENOMEM;
+	}
+
+	memset(trace.tasks, 0, SCHED_TRACE_TASKS * sizeof(struct sched_trace_task));
+
+	for (unsigned i = 0; i < SCHED_TRACE_TASKS; i++)
+		trace.tasks[i].pid = -1;
+
+	/* start the cycle counter */
+	DEMCR |= DEMCR_TRCENA;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+
+	irqstate_t flags = irqsave();
+
+	trace.next = 0;
+	trace.count = 0;
+	trace.task_next = 0;
+	trace.dropped = 0;
+	trace.wrap = wrap;
+
+	/* name the tasks that are already running */
+	sched_foreach(sched_trace_name_cb, NULL);
+
+	trace.running = true;
+
+	irqrestore(flags);
+
+	return OK;
+}
+
+void
+sched_trace_stop(void)
+{
+	irqstate_t flags = irqsave();
+	trace.running = false;
+	irqrestore(flags);
+}
+
+void
+sched_trace_status(void)
+{
+	if (trace.ring == NULL) {
+		printf("sched_trace: not started\n");
+		return;
+	}
+
+	printf("sched_trace: %s, %u/%u events (%u bytes), %u dropped, %s\n",
+	       trace.running ? "running" : "stopped",
+	       trace.count,
+	       trace.size,
+	       trace.size * sizeof(struct sched_trace_event),
+	       (unsigned)trace.dropped,
+	       trace.wrap ? "wrapping" : "one shot");
+}
+
+static int
+sched_trace_write(int fd, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+
+	while (len > 0) {
+		ssize_t ret = write(fd, p, len);
+
+		if (ret <= 0)
+			return -errno;
+
+		p += ret;
+		len -= ret;
+	}
+
+	return OK;
+}
+
+int
+sched_trace_dump(const char *path)
+{
+	struct sched_trace_header hdr;
+	unsigned task_count = 0;
+	unsigned first;
+	int fd, ret;
+
+	if (trace.ring == NULL)
+		return -ENODATA;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+
+	if (fd < 0)
+		return -errno;
+
+	/* pause recording so that the ring holds still */
+	bool was_running = trace.running;
+	trace.running = false;
+
+	for (unsigned i = 0; i < SCHED_TRACE_TASKS; i++) {
+		if (trace.tasks[i].pid >= 0)
+			task_count++;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = SCHED_TRACE_MAGIC;
+	hdr.version = SCHED_TRACE_VERSION;
+	hdr.event_size = sizeof(struct sched_trace_event);
+	hdr.cycles_per_second = STM32_SYSCLK_FREQUENCY;
+	hdr.event_count = trace.count;
+	hdr.dropped = trace.dropped;
+	hdr.task_count = task_count;
+
+	irqstate_t flags = irqsave();
+	hdr.sync_time = hrt_absolute_time();
+	hdr.sync_cycles = DWT_CYCCNT;
+	irqrestore(flags);
+
+	ret = sched_trace_write(fd, &hdr, sizeof(hdr));
+
+	for (unsigned i = 0; (ret == OK) && (i < SCHED_TRACE_TASKS); i++) {
+		if (trace.tasks[i].pid >= 0)
+			ret = sched_trace_write(fd, &trace.tasks[i], sizeof(trace.tasks[i]));
+	}
+
+	/* oldest event first */
+	first = (trace.next + trace.size - trace.count) % trace.size;
+
+	if (ret == OK) {
+		if ((first + trace.count) > trace.size) {
+			ret = sched_trace_write(fd, &trace.ring[first], (trace.size - first) * sizeof(struct sched_trace_event));
+
+			if (ret == OK)
+				ret = sched_trace_write(fd, &trace.ring[0], trace.next * sizeof(struct sched_trace_event));
+
+		} else {
+			ret = sched_trace_write(fd, &trace.ring[first], trace.count * sizeof(struct sched_trace_event));
+		}
+	}
+
+	close(fd);
+
+	trace.running = was_running;
+
+	return ret;
+}
+
+#endif /* CONFIG_SCHED_INSTRUMENTATION */
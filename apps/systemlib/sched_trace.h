@@ -0,0 +1,159 @@
+/****************************************************************************
+ *
+ *   Copyright (C) 2012 PX4 Development Team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name PX4 nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/**
+ * @file sched_trace.h
+ *
+ * Scheduler event trace.
+ *
+ * Context switches, task start/stop, interrupt handlers and HRT callouts
+ * are recorded with cycle counter timestamps in a RAM ring, which can be
+ * written to a file and turned into a timeline with Tools/sched_trace.py.
+ */
+
+#pragma once
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef CONFIG_SCHED_INSTRUMENTATION
+
+#include <nuttx/sched.h>
+
+__BEGIN_DECLS
+
+/**
+ * Trace event types.
+ */
+enum sched_trace_type {
+	SCHED_TRACE_START = 1,		/**< task started */
+	SCHED_TRACE_STOP,		/**< task stopped */
+	SCHED_TRACE_SWITCH,		/**< context switch */
+	SCHED_TRACE_IRQ_ENTER,		/**< interrupt handler entered */
+	SCHED_TRACE_IRQ_EXIT,		/**< interrupt handler returned */
+	SCHED_TRACE_CALLOUT_ENTER,	/**< HRT callout entered */
+	SCHED_TRACE_CALLOUT_EXIT	/**< HRT callout returned */
+};
+
+/**
+ * One trace event, as stored in the ring and in the file.
+ */
+struct sched_trace_event {
+	uint32_t	cycles;		/**< cycle counter */
+	uint8_t		type;		/**< enum sched_trace_type */
+	uint8_t		priority;	/**< priority of the task switched in, started or stopped */
+	int16_t		id;		/**< pid switched in, started or stopped; IRQ number */
+	uint32_t	arg;		/**< switch: pid switched out | its priority << 16 | base priority of
+					     the pid switched in << 24; callout: callout address */
+};
+
+#define SCHED_TRACE_MAGIC	0x43525453	/* "STRC" */
+#define SCHED_TRACE_VERSION	1
+#define SCHED_TRACE_NAME_LEN	24
+#define SCHED_TRACE_MAX_EVENTS	8192		/* 96KiB of ring, half the FMU RAM */
+
+/**
+ * File header; followed by task_count task records and event_count events.
+ */
+struct sched_trace_header {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	event_size;	/**< sizeof(struct sched_trace_event) */
+	uint32_t	cycles_per_second;
+	uint32_t	event_count;
+	uint32_t	dropped;	/**< events lost to a full or wrapped ring */
+	uint32_t	task_count;
+	uint64_t	sync_time;	/**< hrt_absolute_time() when the file was written */
+	uint32_t	sync_cycles;	/**< cycle counter at sync_time */
+	uint32_t	reserved;
+};
+
+/**
+ * Task record in the file.
+ */
+struct sched_trace_task {
+	int16_t		pid;
+	uint8_t		priority;	/**< base priority */
+	uint8_t		reserved;
+	char		name[SCHED_TRACE_NAME_LEN];
+};
+
+/**
+ * Start tracing, discarding any previous trace.
+ *
+ * @param events		Size of the ring in events, at most
+ *				SCHED_TRACE_MAX_EVENTS.
+ * @param wrap			If true, overwrite the oldest events when the ring
+ *				is full; otherwise stop recording.
+ * @return			OK, -EINVAL if events is out of range, or -ENOMEM.
+ */
+__EXPORT int	sched_trace_start(unsigned events, bool wrap);
+
+/**
+ * Stop tracing; the trace is kept until the next start.
+ */
+__EXPORT void	sched_trace_stop(void);
+
+/**
+ * Print the state of the trace.
+ */
+__EXPORT void	sched_trace_status(void);
+
+/**
+ * Write the trace to a file, oldest event first.
+ *
+ * Tracing is paused while the file is written.
+ *
+ * @param path			The file to write.
+ * @return			OK, or a negative errno value.
+ */
+__EXPORT int	sched_trace_dump(const char *path);
+
+/**
+ * Record an event. Callable from any context.
+ */
+__EXPORT void	sched_trace_record(uint8_t type, uint8_t priority, int16_t id, uint32_t arg);
+
+/**
+ * Record a task start, stop or a context switch.
+ */
+__EXPORT void	sched_trace_start_task(FAR _TCB *tcb);
+__EXPORT void	sched_trace_stop_task(FAR _TCB *tcb);
+__EXPORT void	sched_trace_switch(FAR _TCB *from, FAR _TCB *to);
+
+__END_DECLS
+
+#endif /* CONFIG_SCHED_INSTRUMENTATION */
@@ -103,6 +103,16 @@ struct sensor_combined_s {
 	float mcu_temp_celcius;			/**< Internal temperature measurement of MCU */
 	uint32_t baro_counter;			/**< Number of raw baro measurements taken        */
 
+	/*
+	 * Sample alignment. The SI accel, mag and baro values are aligned to the gyro
+	 * sample time in timestamp; these fields give the remaining age of each, i.e.
+	 * timestamp minus the effective sample time. Zero means the value was sampled
+	 * or interpolated at exactly the gyro time, negative means it is newer.
+	 */
+	int32_t accelerometer_age_us;		/**< Age of the accelerometer values, in microseconds */
+	int32_t magnetometer_age_us;		/**< Age of the magnetometer values, in microseconds */
+	int32_t baro_age_us;			/**< Age of the barometer values, in microseconds */
+
 };
 
 /**
@@ -52,10 +52,14 @@
 
 /**
  * GPS position in WGS84 coordinates.
+ *
+ * Where the receiver provides the GPS time of week, position, velocity and
+ * variance all belong to the same navigation epoch and their timestamps are
+ * the hrt time of that epoch's measurement, not of message arrival.
  */
 struct vehicle_gps_position_s
 {
-	uint64_t timestamp_position;		/**< Timestamp for position information */
+	uint64_t timestamp_position;		/**< Timestamp for position information (measurement time) */
 	int32_t lat;						/**< Latitude in 1E7 degrees */
 	int32_t lon;						/**< Longitude in 1E7 degrees */
 	int32_t alt;						/**< Altitude in 1E3 meters (millimeters) above MSL  */
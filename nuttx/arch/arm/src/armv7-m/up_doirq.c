@@ -41,6 +41,7 @@
 
 #include <stdint.h>
 #include <assert.h>
+#include <sched.h>
 
 #include <nuttx/irq.h>
 #include <nuttx/arch.h>
@@ -99,7 +100,9 @@ uint32_t *up_doirq(int irq, uint32_t *regs)
 
   /* Deliver the IRQ */
 
+  sched_note_irqhandler(irq, true);
   irq_dispatch(irq, regs);
+  sched_note_irqhandler(irq, false);
 
   /* If a context switch occurred while processing the interrupt then
    * current_regs may have change value.  If we return any value different
@@ -244,11 +244,15 @@
 /*
  * PPM
  *
- * PPM input is handled by the HRT timer.
+ * PPM input is handled by the HRT timer, with the edge captures
+ * collected by DMA if HRT_PPM_DMA is set.
  */
 #if defined(CONFIG_HRT_TIMER) && defined (CONFIG_HRT_PPM)
 # define HRT_PPM_CHANNEL	3	/* use capture/compare channel 3 */
 # define GPIO_PPM_IN	(GPIO_ALT|GPIO_AF1|GPIO_SPEED_50MHz|GPIO_PULLUP|GPIO_PORTA|GPIO_PIN10)
+# ifdef CONFIG_STM32_DMA2
+#  define HRT_PPM_DMA	DMAMAP_TIM1_CH3_1	/* capture edges by DMA */
+# endif
 #endif
 
 /* 
@@ -321,6 +325,15 @@
 #define PX4_SPIDEV_ACCEL	2
 #define PX4_SPIDEV_MPU		3
 
+/*
+ * Sensor data-ready interrupts
+ *
+ * Drivers that find one of these defined may use it to pace sampling
+ * (SENSOR_POLLRATE_EXTERNAL).  The MPU6000 (GPIO_EXTI_MPU6000_DRDY)
+ * and L3GD20 (GPIO_EXTI_L3GD20_DRDY) lines are not routed on this board.
+ */
+#define GPIO_EXTI_HMC5883_DRDY	(GPIO_INPUT|GPIO_FLOAT|GPIO_EXTI|GPIO_PORTB|GPIO_PIN1)
+
 /*
  * Tone alarm output
  */
@@ -119,13 +119,17 @@
 /*
  * PPM
  *
- * PPM input is handled by the HRT timer.
+ * PPM input is handled by the HRT timer, with the edge captures
+ * collected by DMA if HRT_PPM_DMA is set.
  *
  * Pin is PA8, timer 1, channel 1
  */
 #if defined(CONFIG_HRT_TIMER) && defined (CONFIG_HRT_PPM)
 # define HRT_PPM_CHANNEL	1	/* use capture/compare channel 1 */
 # define GPIO_PPM_IN		GPIO_TIM1_CH1IN
+# ifdef CONFIG_STM32_DMA1
+#  define HRT_PPM_DMA		DMACHAN_TIM1_CH1	/* capture edges by DMA */
+# endif
 #endif
 
 /************************************************************************************
@@ -44,6 +44,7 @@
 
 #include <sys/types.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <nuttx/sched.h>
 
 /********************************************************************************
@@ -162,6 +163,12 @@ void   sched_note_switch(FAR _TCB *pFromTcb, FAR _TCB *pToTcb);
 # define sched_note_switch(t1, t2)
 #endif /* CONFIG_SCHED_INSTRUMENTATION */
 
+#ifdef CONFIG_SCHED_INSTRUMENTATION_IRQHANDLER
+void   sched_note_irqhandler(int irq, bool enter);
+#else
+# define sched_note_irqhandler(i, e)
+#endif /* CONFIG_SCHED_INSTRUMENTATION_IRQHANDLER */
+
 #undef EXTERN
 #if defined(__cplusplus)
 }